@@ -0,0 +1,235 @@
+/*
+ * a2d_data_cb cadence statistics
+ *
+ * Bluedroid drives the whole output side by calling a2d_data_cb from its media
+ * task. Buffer sizing depends on how regular those calls are and on the sizes
+ * requested, so every call is timestamped and folded into two sets of running
+ * totals: one since the last "cadence reset" for the console, and one per
+ * telemetry period. Long-run bytes per second against the nominal rate gives
+ * the clock drift between Bluetooth and our 44.1 kHz assumption.
+ */
+
+#include "a2d_cadence.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "log_ring.h"
+#include "telemetry.h"
+
+#define CADENCE_LEN_SLOTS       8       // Distinct request sizes tracked
+#define CADENCE_INTERVAL_BINS   9       // <1, 1-2, 2-4, ... 64-128, >=128 ms
+#define CADENCE_LATE_FACTOR     4       // Late: this many times the average interval...
+#define CADENCE_LATE_MIN_US     20000   // ...and at least this long
+#define CADENCE_EWMA_SHIFT      5       // Average interval smoothing, 1/32 per call
+#define CADENCE_DRIFT_MIN_S     10      // Shortest span worth a drift estimate
+
+typedef struct {
+    int64_t first_call_us;
+    int64_t last_call_us;
+    uint32_t calls;
+    uint64_t bytes;
+    int32_t last_len;
+    uint32_t interval_min_us;
+    uint32_t interval_max_us;
+    uint64_t interval_sum_us;
+    uint64_t interval_sq_sum;       // us^2
+    uint32_t late_calls;
+    uint32_t interval_hist[CADENCE_INTERVAL_BINS];
+    int32_t len_value[CADENCE_LEN_SLOTS];
+    uint32_t len_count[CADENCE_LEN_SLOTS];
+    uint32_t len_other;
+} cadence_stats_t;
+
+static cadence_stats_t s_total;     // Since the last reset
+static cadence_stats_t s_period;    // Since the last telemetry read
+static int64_t s_last_call_us = 0;
+static uint32_t s_avg_interval_us = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void stats_clear(cadence_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    st->interval_min_us = UINT32_MAX;
+}
+
+static int interval_bin(uint32_t interval_us) {
+    int bin = 0;
+    for (uint32_t edge = 1000; bin < CADENCE_INTERVAL_BINS - 1 && interval_us >= edge; edge <<= 1) {
+        bin++;
+    }
+    return bin;
+}
+
+static void stats_add(cadence_stats_t *st, int64_t now, int32_t len, int64_t interval, int bin, bool late) {
+    if (st->calls == 0) {
+        st->first_call_us = now;
+    } else if (interval >= 0) {
+        // The first call of a set has no interval inside that set.
+        if (interval < st->interval_min_us) {
+            st->interval_min_us = interval;
+        }
+        if (interval > st->interval_max_us) {
+            st->interval_max_us = interval;
+        }
+        st->interval_sum_us += interval;
+        st->interval_sq_sum += (uint64_t)interval * interval;
+        st->interval_hist[bin]++;
+        st->late_calls += late;
+    }
+    st->last_call_us = now;
+    st->calls++;
+    st->bytes += len;
+    st->last_len = len;
+
+    int slot;
+    for (slot = 0; slot < CADENCE_LEN_SLOTS; slot++) {
+        if (st->len_count[slot] == 0 || st->len_value[slot] == len) {
+            break;
+        }
+    }
+    if (slot < CADENCE_LEN_SLOTS) {
+        st->len_value[slot] = len;
+        st->len_count[slot]++;
+    } else {
+        st->len_other++;
+    }
+}
+
+void a2d_cadence_record(int32_t len) {
+    int64_t now = esp_timer_get_time();
+    int64_t interval = -1;
+    bool late = false;
+    int bin = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_last_call_us != 0) {
+        interval = now - s_last_call_us;
+        bin = interval_bin(interval);
+        late = interval >= CADENCE_LATE_MIN_US &&
+               interval > (int64_t)s_avg_interval_us * CADENCE_LATE_FACTOR;
+        // Moving average in integer math; seeded by the first interval.
+        if (s_avg_interval_us == 0) {
+            s_avg_interval_us = interval;
+        } else {
+            s_avg_interval_us += ((int32_t)interval - (int32_t)s_avg_interval_us) >> CADENCE_EWMA_SHIFT;
+        }
+    }
+    s_last_call_us = now;
+    stats_add(&s_total, now, len, interval, bin, late);
+    stats_add(&s_period, now, len, interval, bin, late);
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (late) {
+        log_ring_write(LR_A2D_LATE_CALL, interval / 1000, s_avg_interval_us, len);
+    }
+}
+
+void a2d_cadence_reset(void) {
+    taskENTER_CRITICAL(&s_lock);
+    stats_clear(&s_total);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t a2d_cadence_interval_us(void) {
+    return s_avg_interval_us;
+}
+
+// Bytes handed out before the last call cover the measured span.
+static double stats_rate(const cadence_stats_t *st) {
+    double span_s = (st->last_call_us - st->first_call_us) / 1e6;
+    return span_s > 0 ? (st->bytes - st->last_len) / span_s : 0.0;
+}
+
+static double stats_jitter_us(const cadence_stats_t *st, double mean) {
+    uint32_t intervals = st->calls - 1;
+    double var = (double)st->interval_sq_sum / intervals - mean * mean;
+    return var > 0 ? sqrt(var) : 0.0;
+}
+
+void a2d_cadence_report(void) {
+    static const char *const bin_names[CADENCE_INTERVAL_BINS] = {
+        "<1", "1-2", "2-4", "4-8", "8-16", "16-32", "32-64", "64-128", ">=128",
+    };
+    cadence_stats_t st;
+    taskENTER_CRITICAL(&s_lock);
+    st = s_total;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (st.calls < 2) {
+        console_printf("cadence: not enough calls yet\n");
+        return;
+    }
+    uint32_t intervals = st.calls - 1;
+    double mean = (double)st.interval_sum_us / intervals;
+    double span_s = (st.last_call_us - st.first_call_us) / 1e6;
+    double rate = stats_rate(&st);
+
+    console_printf("cadence: %lu calls over %.1f s, interval mean %.2f ms, min %.2f, max %.2f, jitter (stddev) %.2f ms\n",
+                   (unsigned long)st.calls, span_s, mean / 1000, st.interval_min_us / 1000.0,
+                   st.interval_max_us / 1000.0, stats_jitter_us(&st, mean) / 1000);
+    console_printf("cadence: %.0f bytes/s pulled (nominal %u, %+.0f ppm), %lu late calls\n",
+                   rate, (unsigned)AUDIO_BYTES_PER_SEC, (rate / AUDIO_BYTES_PER_SEC - 1.0) * 1e6,
+                   (unsigned long)st.late_calls);
+    console_printf("  interval histogram (ms):");
+    for (int i = 0; i < CADENCE_INTERVAL_BINS; i++) {
+        console_printf(" %s:%lu", bin_names[i], (unsigned long)st.interval_hist[i]);
+    }
+    console_printf("\n");
+    for (int i = 0; i < CADENCE_LEN_SLOTS && st.len_count[i] > 0; i++) {
+        console_printf("  len %6ld: %lu calls (%.1f%%)\n", (long)st.len_value[i],
+                       (unsigned long)st.len_count[i], 100.0 * st.len_count[i] / st.calls);
+    }
+    if (st.len_other > 0) {
+        console_printf("  other len: %lu calls\n", (unsigned long)st.len_other);
+    }
+}
+
+static int cadence_telemetry(char *buf, size_t len) {
+    cadence_stats_t period, total;
+    taskENTER_CRITICAL(&s_lock);
+    period = s_period;
+    total = s_total;
+    stats_clear(&s_period);
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (period.calls < 2) {
+        return snprintf(buf, len, "calls=%lu", (unsigned long)period.calls);
+    }
+    double mean = (double)period.interval_sum_us / (period.calls - 1);
+    // Drift needs a long baseline; a one-second window only shows scheduling.
+    double total_span_s = (total.last_call_us - total.first_call_us) / 1e6;
+    long drift_ppm = total_span_s >= CADENCE_DRIFT_MIN_S ?
+                     lround((stats_rate(&total) / AUDIO_BYTES_PER_SEC - 1.0) * 1e6) : 0;
+
+    int n = snprintf(buf, len, "calls=%lu mean_us=%.0f jitter_us=%.0f max_us=%lu late=%lu rate=%.0f drift_ppm=%ld len=",
+                     (unsigned long)period.calls, mean, stats_jitter_us(&period, mean),
+                     (unsigned long)period.interval_max_us, (unsigned long)period.late_calls,
+                     stats_rate(&period), drift_ppm);
+    for (int i = 0; i < CADENCE_LEN_SLOTS && period.len_count[i] > 0 && n < (int)len; i++) {
+        n += snprintf(buf + n, len - n, "%s%ld:%lu", i ? "," : "", (long)period.len_value[i],
+                      (unsigned long)period.len_count[i]);
+    }
+    for (int i = 0; i < CADENCE_INTERVAL_BINS && n < (int)len; i++) {
+        n += snprintf(buf + n, len - n, "%s%lu", i ? "," : " hist=", (unsigned long)period.interval_hist[i]);
+    }
+    return n;
+}
+
+static int cmd_cadence(int argc, char **argv) {
+    a2d_cadence_report();
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        a2d_cadence_reset();
+    }
+    return 0;
+}
+
+void a2d_cadence_init(void) {
+    stats_clear(&s_total);
+    stats_clear(&s_period);
+    console_register("cadence", "a2d_data_cb call cadence and request sizes: cadence [reset]", cmd_cadence);
+    telemetry_register("cadence", cadence_telemetry);
+}
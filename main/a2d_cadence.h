@@ -0,0 +1,21 @@
+/*
+ * a2d_data_cb cadence: how often Bluedroid pulls audio and how much it asks for.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Called at the top of a2d_data_cb with the requested length.
+void a2d_cadence_record(int32_t len);
+
+// Prints call interval, jitter and the requested-length distribution.
+void a2d_cadence_report(void);
+
+void a2d_cadence_reset(void);
+
+// Average time between calls, in microseconds; 0 before the second call.
+uint32_t a2d_cadence_interval_us(void);
+
+// Registers the "cadence" console command.
+void a2d_cadence_init(void);
@@ -0,0 +1,993 @@
+/*
+ * AAC-LC decoder (ISO/IEC 14496-3, subpart 4)
+ *
+ * A frame is parsed element by element into per-channel quantised spectra,
+ * which are then dequantised in place to Q(AAC_SPEC_BITS):
+ *   x = sign(q) |q|^(4/3) 2^((sf - 100) / 4)
+ * |q|^(4/3) comes from a table for the common small values and from an
+ * integer cube root for escapes; the gain is split into a Q30 mantissa
+ * 2^((sf & 3) / 4) and a shift. Noise (PNS) bands are filled from an LCG and
+ * scaled to the transmitted energy, then M/S and intensity stereo are undone,
+ * TNS filters run, and the shared IMDCT (imdct.h) produces time samples that
+ * are windowed and overlapped with the previous frame.
+ *
+ * Nothing is written to the decoder's overlap until the whole frame has
+ * parsed, so a damaged frame leaves the state as it was and the caller can
+ * conceal it. The ADTS CRC is not checked: the parser's own consistency
+ * checks catch damage that matters, and most encoders omit the CRC.
+ *
+ * Huffman codes are decoded by binary search over each book's codewords
+ * sorted as left-aligned 32-bit keys. Every AAC book is a complete prefix
+ * code, so the largest key not above the next 32 input bits is the match.
+ */
+
+#include "aac_decoder.h"
+
+#include <math.h>
+#include <string.h>
+#include "aac_tables.h"
+#include "imdct.h"
+
+#define AAC_SPEC_BITS       4           // Fraction bits of dequantised spectra
+#define AAC_OUT_BITS        8           // Fraction bits of time samples (PCM LSB = 1)
+#define SPEC_LIMIT          (1 << 29)   // Spectral clamp; M/S sums stay in range
+#define POW43_BITS          13
+#define POW43_TABLE         17          // |q| up to 16 from the table
+#define LPC_BITS            20
+
+#define MAX_WINDOWS         8
+#define SHORT_LEN           128
+#define TNS_MAX_FILTERS     3
+#define TNS_MAX_ORDER       12          // Long windows; 7 for short
+#define TNS_MAX_ORDER_SHORT 7
+#define ESCAPE_MAX_PREFIX   8           // Escaped values stay below 8192
+
+enum { ONLY_LONG, LONG_START, EIGHT_SHORT, LONG_STOP };
+enum { BOOK_ZERO = 0, BOOK_ESCAPE = 11, BOOK_RESERVED = 12, BOOK_NOISE = 13, BOOK_INTENSITY2 = 14, BOOK_INTENSITY = 15 };
+enum { ID_SCE, ID_CPE, ID_CCE, ID_LFE, ID_DSE, ID_PCE, ID_FIL, ID_END };
+
+typedef struct {
+    uint8_t filters;
+    uint8_t coef_res;                   // 0: 3-bit coefficients, 1: 4-bit
+    uint8_t length[TNS_MAX_FILTERS];
+    uint8_t order[TNS_MAX_FILTERS];
+    bool downward[TNS_MAX_FILTERS];
+    int8_t coef[TNS_MAX_FILTERS][TNS_MAX_ORDER];
+} tns_t;
+
+// One individual channel stream. Per-band arrays are indexed by
+// group * AAC_SWB_LONG + sfb.
+typedef struct {
+    uint8_t window_sequence;
+    uint8_t window_shape;               // 0: sine, 1: KBD
+    uint8_t max_sfb;
+    uint8_t num_windows;
+    uint8_t num_groups;
+    uint8_t group_len[MAX_WINDOWS];
+    uint8_t num_swb;
+    const uint16_t *swb;
+    uint8_t band_type[MAX_WINDOWS * AAC_SWB_LONG];
+    int16_t sf[MAX_WINDOWS * AAC_SWB_LONG];
+    bool tns_present;
+    tns_t tns[MAX_WINDOWS];
+} ics_t;
+
+struct aac_decoder {
+    imdct_t imdct;
+    int32_t sine_table[IMDCT_TABLE_LEN(2 * AAC_FRAME_SAMPLES)];
+    int32_t window_long[2][AAC_FRAME_SAMPLES];  // Rising halves, Q31; [shape]
+    int32_t window_short[2][SHORT_LEN];
+    int32_t pow43[POW43_TABLE];                 // Q(POW43_BITS)
+    int32_t tns_sin[2][16];                     // Parcor by [coef_res][value + 8], Q31
+    ics_t ics[AAC_MAX_CHANNELS];
+    uint8_t ms_used[MAX_WINDOWS * AAC_SWB_LONG];
+    int32_t spec[AAC_MAX_CHANNELS][AAC_FRAME_SAMPLES];
+    int32_t overlap[AAC_MAX_CHANNELS][AAC_FRAME_SAMPLES];  // Q(AAC_OUT_BITS)
+    uint8_t prev_shape[AAC_MAX_CHANNELS];
+    int32_t work[AAC_FRAME_SAMPLES];
+    int16_t pcm[AAC_FRAME_SAMPLES * AAC_MAX_CHANNELS];
+    int channels;
+    int tns_max_bands;                          // Long windows at this rate
+    uint32_t noise;
+};
+
+// 2^(i / 4), Q30
+static const int32_t s_pow2_quarter[4] = { 1073741824, 1276901417, 1518500250, 1805811301 };
+
+static const uint32_t s_sample_rates[13] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350,
+};
+
+// Codebook indexes of each book sorted by left-aligned codeword. Built once;
+// the books are constant.
+static uint16_t s_sf_order[AAC_SCALEFACTOR_ENTRIES];
+static uint16_t s_spec_order[6 * 81 + 2 * 64 + 2 * 169 + 289];
+static uint16_t s_spec_start[AAC_SPECTRAL_BOOKS];
+static bool s_orders_built;
+
+// --- ADTS ---
+int aac_parse_adts(const uint8_t *d, size_t len, aac_adts_t *h) {
+    if (len < AAC_ADTS_HEADER_LEN || d[0] != 0xFF || (d[1] & 0xF6) != 0xF0) {
+        return -1;
+    }
+    h->has_crc = !(d[1] & 1);
+    h->profile = d[2] >> 6;
+    h->rate_index = (d[2] >> 2) & 0xF;
+    h->channel_config = ((d[2] & 1) << 2) | (d[3] >> 6);
+    h->frame_len = ((d[3] & 3) << 11) | (d[4] << 3) | (d[5] >> 5);
+    h->raw_blocks = d[6] & 3;
+    if (h->rate_index >= 13 || h->frame_len < AAC_ADTS_HEADER_LEN + (h->has_crc ? 2 : 0)) {
+        return -1;
+    }
+    return h->frame_len;
+}
+
+uint32_t aac_sample_rate(const aac_adts_t *h) {
+    return h->rate_index < 13 ? s_sample_rates[h->rate_index] : 0;
+}
+
+bool aac_supported(const aac_adts_t *h) {
+    // The band tables here are the 44.1/48 kHz ones.
+    return h->profile == 1 && (h->rate_index == 3 || h->rate_index == 4) && h->channel_config >= 1 &&
+           h->channel_config <= AAC_MAX_CHANNELS && h->raw_blocks == 0 && h->frame_len <= AAC_MAX_FRAME_LEN;
+}
+
+// --- Bit Reader ---
+// MSB first. Reads past the end return zeros-or-padding and are caught by
+// bits_overrun() afterwards.
+typedef struct {
+    const uint8_t *data;
+    size_t pos;                         // In bits
+    size_t end;
+} bits_t;
+
+static inline uint32_t bits_show32(const bits_t *b) {
+    if (b->pos > b->end) {
+        return 0;
+    }
+    const uint8_t *p = b->data + (b->pos >> 3);
+    uint32_t v = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    int r = b->pos & 7;
+    return r ? (v << r) | (p[4] >> (8 - r)) : v;
+}
+
+// 1 <= n <= 32
+static inline uint32_t bits_get(bits_t *b, int n) {
+    uint32_t v = bits_show32(b) >> (32 - n);
+    b->pos += n;
+    return v;
+}
+
+static inline bool bits_overrun(const bits_t *b) {
+    return b->pos > b->end;
+}
+
+// --- Huffman ---
+static inline uint32_t sf_key(int i) {
+    return aac_scalefactor_codes[i] << (32 - aac_scalefactor_bits[i]);
+}
+
+static inline uint32_t spec_key(const aac_spectral_book_t *book, int i) {
+    return (uint32_t)book->codes[i] << (32 - book->bits[i]);
+}
+
+static void build_orders(void) {
+    for (int i = 0; i < AAC_SCALEFACTOR_ENTRIES; i++) {
+        int j = i;
+        for (; j > 0 && sf_key(s_sf_order[j - 1]) > sf_key(i); j--) {
+            s_sf_order[j] = s_sf_order[j - 1];
+        }
+        s_sf_order[j] = i;
+    }
+    int start = 0;
+    for (int b = 0; b < AAC_SPECTRAL_BOOKS; b++) {
+        const aac_spectral_book_t *book = &aac_spectral_books[b];
+        uint16_t *order = s_spec_order + start;
+        for (int i = 0; i < book->entries; i++) {
+            int j = i;
+            for (; j > 0 && spec_key(book, order[j - 1]) > spec_key(book, i); j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = i;
+        }
+        s_spec_start[b] = start;
+        start += book->entries;
+    }
+    s_orders_built = true;
+}
+
+// Scalefactor difference, -60..60.
+static int huff_sf(bits_t *b) {
+    uint32_t v = bits_show32(b);
+    int lo = 0, hi = AAC_SCALEFACTOR_ENTRIES - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (sf_key(s_sf_order[mid]) <= v) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    int i = s_sf_order[lo];
+    b->pos += aac_scalefactor_bits[i];
+    return i - 60;
+}
+
+// Codebook index in book (1..11).
+static int huff_spec(bits_t *b, int book_id) {
+    const aac_spectral_book_t *book = &aac_spectral_books[book_id - 1];
+    const uint16_t *order = s_spec_order + s_spec_start[book_id - 1];
+    uint32_t v = bits_show32(b);
+    int lo = 0, hi = book->entries - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (spec_key(book, order[mid]) <= v) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    int i = order[lo];
+    b->pos += book->bits[i];
+    return i;
+}
+
+// --- Fixed-Point Helpers ---
+static inline int32_t mul31(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 31);
+}
+
+static inline int32_t clamp_spec(int64_t v) {
+    return v > SPEC_LIMIT ? SPEC_LIMIT : (v < -SPEC_LIMIT ? -SPEC_LIMIT : (int32_t)v);
+}
+
+// v * 2^-shift, clamped to the spectral range.
+static inline int32_t scale_down(int64_t v, int shift) {
+    if (shift >= 63) {
+        return 0;
+    }
+    if (shift <= 0) {
+        return v == 0 ? 0 : (v > 0 ? SPEC_LIMIT : -SPEC_LIMIT);
+    }
+    return clamp_spec(v >> shift);
+}
+
+// floor(cbrt(x)), bit by bit.
+static uint32_t icbrt64(uint64_t x) {
+    uint64_t y = 0;
+    for (int s = 63; s >= 0; s -= 3) {
+        y <<= 1;
+        uint64_t b = 3 * y * (y + 1) + 1;
+        if ((x >> s) >= b) {
+            x -= b << s;
+            y++;
+        }
+    }
+    return (uint32_t)y;
+}
+
+// |q|^(4/3) in Q(POW43_BITS), q < 8192 + 16 * 15 (escape plus pulses).
+static inline int32_t pow43(const aac_decoder_t *dec, uint32_t q) {
+    if (q < POW43_TABLE) {
+        return dec->pow43[q];
+    }
+    // cbrt(q) in Q16, times q, down to Q13.
+    uint64_t r = icbrt64((uint64_t)q << 48);
+    return (int32_t)((q * r) >> (16 - POW43_BITS));
+}
+
+// --- Setup ---
+static int32_t q31(double x) {
+    double v = x * 2147483648.0;
+    return v >= 2147483647.0 ? INT32_MAX : (int32_t)lrint(v);
+}
+
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / 2) / k;
+        sum += term * term;
+    }
+    return sum;
+}
+
+// Rising halves of the sine and Kaiser-Bessel-derived windows of n points.
+static void make_windows(int32_t *sine, int32_t *kbd, int n, double alpha) {
+    int half = n / 2;
+    double total = 0;
+    for (int j = 0; j <= half; j++) {
+        double r = (j - n / 4.0) / (n / 4.0);
+        total += bessel_i0(M_PI * alpha * sqrt(1 - r * r));
+    }
+    double sum = 0;
+    for (int j = 0; j < half; j++) {
+        double r = (j - n / 4.0) / (n / 4.0);
+        sum += bessel_i0(M_PI * alpha * sqrt(1 - r * r));
+        kbd[j] = q31(sqrt(sum / total));
+        sine[j] = q31(sin(M_PI / n * (j + 0.5)));
+    }
+}
+
+size_t aac_decoder_size(void) {
+    return sizeof(aac_decoder_t);
+}
+
+aac_decoder_t *aac_decoder_create(void *mem) {
+    aac_decoder_t *dec = mem;
+    memset(dec, 0, sizeof(*dec));
+    if (!s_orders_built) {
+        build_orders();
+    }
+    imdct_init(&dec->imdct, dec->sine_table, 2 * AAC_FRAME_SAMPLES);
+    make_windows(dec->window_long[0], dec->window_long[1], 2 * AAC_FRAME_SAMPLES, 4);
+    make_windows(dec->window_short[0], dec->window_short[1], 2 * SHORT_LEN, 6);
+    for (int i = 0; i < POW43_TABLE; i++) {
+        dec->pow43[i] = lrint(pow(i, 4.0 / 3) * (1 << POW43_BITS));
+    }
+    // Inverse quantisation of the parcor coefficients, 3 or 4 bits.
+    for (int res = 0; res < 2; res++) {
+        double half = 1 << (res + 2);
+        for (int v = -8; v < 8; v++) {
+            double iq = (v >= 0 ? half - 0.5 : half + 0.5) / (M_PI / 2);
+            dec->tns_sin[res][v + 8] = q31(sin(v / iq));
+        }
+    }
+    dec->noise = 0x1F2E3D4C;
+    return dec;
+}
+
+int aac_channels(const aac_decoder_t *dec) {
+    return dec->channels;
+}
+
+// --- Individual Channel Stream ---
+static bool ics_info(bits_t *b, ics_t *ics) {
+    bits_get(b, 1);     // Reserved
+    ics->window_sequence = bits_get(b, 2);
+    ics->window_shape = bits_get(b, 1);
+    if (ics->window_sequence == EIGHT_SHORT) {
+        ics->max_sfb = bits_get(b, 4);
+        uint32_t grouping = bits_get(b, 7);
+        ics->num_windows = 8;
+        ics->num_groups = 1;
+        ics->group_len[0] = 1;
+        for (int i = 6; i >= 0; i--) {
+            if (grouping & (1 << i)) {
+                ics->group_len[ics->num_groups - 1]++;
+            } else {
+                ics->group_len[ics->num_groups++] = 1;
+            }
+        }
+        ics->num_swb = AAC_SWB_SHORT;
+        ics->swb = aac_swb_offset_short;
+    } else {
+        ics->max_sfb = bits_get(b, 6);
+        if (bits_get(b, 1)) {
+            return false;   // Prediction: main profile only
+        }
+        ics->num_windows = 1;
+        ics->num_groups = 1;
+        ics->group_len[0] = 1;
+        ics->num_swb = AAC_SWB_LONG;
+        ics->swb = aac_swb_offset_long;
+    }
+    return ics->max_sfb <= ics->num_swb;
+}
+
+static bool section_data(bits_t *b, ics_t *ics) {
+    int len_bits = ics->window_sequence == EIGHT_SHORT ? 3 : 5;
+    uint32_t escape = (1 << len_bits) - 1;
+    for (int g = 0; g < ics->num_groups; g++) {
+        uint8_t *band_type = &ics->band_type[g * AAC_SWB_LONG];
+        int k = 0;
+        while (k < ics->max_sfb) {
+            int book = bits_get(b, 4);
+            if (book == BOOK_RESERVED) {
+                return false;
+            }
+            int len = 0;
+            uint32_t incr;
+            do {
+                incr = bits_get(b, len_bits);
+                len += incr;
+            } while (incr == escape && !bits_overrun(b));
+            if (bits_overrun(b) || k + len > ics->max_sfb) {
+                return false;
+            }
+            memset(band_type + k, book, len);
+            k += len;
+        }
+        memset(band_type + k, BOOK_ZERO, AAC_SWB_LONG - k);
+    }
+    return true;
+}
+
+static bool scale_factor_data(bits_t *b, ics_t *ics, int global_gain) {
+    int offset[3] = { global_gain, global_gain - 90, 0 };
+    bool first_noise = true;
+    for (int g = 0; g < ics->num_groups; g++) {
+        for (int sfb = 0; sfb < ics->max_sfb; sfb++) {
+            int i = g * AAC_SWB_LONG + sfb;
+            switch (ics->band_type[i]) {
+                case BOOK_ZERO:
+                    ics->sf[i] = 0;
+                    break;
+                case BOOK_INTENSITY:
+                case BOOK_INTENSITY2:
+                    offset[2] += huff_sf(b);
+                    if (offset[2] < -155 || offset[2] > 100) {
+                        return false;
+                    }
+                    ics->sf[i] = offset[2];
+                    break;
+                case BOOK_NOISE:
+                    if (first_noise) {
+                        offset[1] += (int)bits_get(b, 9) - 256;
+                        first_noise = false;
+                    } else {
+                        offset[1] += huff_sf(b);
+                    }
+                    if (offset[1] < -100 || offset[1] > 155) {
+                        return false;
+                    }
+                    ics->sf[i] = offset[1];
+                    break;
+                default:
+                    offset[0] += huff_sf(b);
+                    if (offset[0] < 0 || offset[0] > 255) {
+                        return false;
+                    }
+                    ics->sf[i] = offset[0];
+                    break;
+            }
+        }
+    }
+    return true;
+}
+
+static bool tns_data(bits_t *b, ics_t *ics) {
+    bool is_short = ics->window_sequence == EIGHT_SHORT;
+    int max_order = is_short ? TNS_MAX_ORDER_SHORT : TNS_MAX_ORDER;
+    for (int w = 0; w < ics->num_windows; w++) {
+        tns_t *t = &ics->tns[w];
+        t->filters = bits_get(b, is_short ? 1 : 2);
+        if (t->filters) {
+            t->coef_res = bits_get(b, 1);
+        }
+        for (int f = 0; f < t->filters; f++) {
+            t->length[f] = bits_get(b, is_short ? 4 : 6);
+            t->order[f] = bits_get(b, is_short ? 3 : 5);
+            if (t->order[f] > max_order) {
+                return false;
+            }
+            if (t->order[f]) {
+                t->downward[f] = bits_get(b, 1);
+                int coef_bits = 3 + t->coef_res - bits_get(b, 1);
+                int sign = 1 << (coef_bits - 1);
+                for (int i = 0; i < t->order[f]; i++) {
+                    t->coef[f][i] = (int)(bits_get(b, coef_bits) ^ sign) - sign;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Reads one escape sequence; value is 16 on entry.
+static bool escape_value(bits_t *b, int *value) {
+    int prefix = __builtin_clz(~bits_show32(b));
+    if (prefix > ESCAPE_MAX_PREFIX) {
+        return false;
+    }
+    b->pos += prefix + 1;
+    *value = (1 << (prefix + 4)) + bits_get(b, prefix + 4);
+    return true;
+}
+
+// Quantised values into q[] (the channel's spectrum), window-major.
+static bool spectral_data(bits_t *b, const ics_t *ics, int32_t *q) {
+    memset(q, 0, AAC_FRAME_SAMPLES * sizeof(*q));
+    int win = 0;
+    for (int g = 0; g < ics->num_groups; win += ics->group_len[g], g++) {
+        for (int sfb = 0; sfb < ics->max_sfb; sfb++) {
+            int book_id = ics->band_type[g * AAC_SWB_LONG + sfb];
+            if (book_id == BOOK_ZERO || book_id >= BOOK_NOISE) {
+                continue;
+            }
+            const aac_spectral_book_t *book = &aac_spectral_books[book_id - 1];
+            int dim = book->dimension;
+            int base = book->is_unsigned ? book->lav + 1 : 2 * book->lav + 1;
+            int bias = book->is_unsigned ? 0 : book->lav;
+            for (int w = win; w < win + ics->group_len[g]; w++) {
+                int32_t *out = q + w * SHORT_LEN;
+                for (int k = ics->swb[sfb]; k < ics->swb[sfb + 1]; k += dim) {
+                    int idx = huff_spec(b, book_id);
+                    int v[4];
+                    for (int i = dim; i-- > 0;) {
+                        v[i] = idx % base - bias;
+                        idx /= base;
+                    }
+                    if (book->is_unsigned) {
+                        for (int i = 0; i < dim; i++) {
+                            if (v[i] && bits_get(b, 1)) {
+                                v[i] = -v[i];
+                            }
+                        }
+                        if (book_id == BOOK_ESCAPE) {
+                            for (int i = 0; i < 2; i++) {
+                                if (v[i] == 16 || v[i] == -16) {
+                                    int mag;
+                                    if (!escape_value(b, &mag)) {
+                                        return false;
+                                    }
+                                    v[i] = v[i] < 0 ? -mag : mag;
+                                }
+                            }
+                        }
+                    }
+                    for (int i = 0; i < dim; i++) {
+                        out[k + i] = v[i];
+                    }
+                }
+                if (bits_overrun(b)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Fills a noise band of one window with energy 2^(sf / 2).
+static void noise_band(aac_decoder_t *dec, int32_t *x, int width, int sf) {
+    int64_t energy = 0;
+    for (int k = 0; k < width; k++) {
+        dec->noise = dec->noise * 1664525 + 1013904223;
+        x[k] = (int32_t)dec->noise >> 16;
+        energy += (int64_t)x[k] * x[k];
+    }
+    uint32_t root = 0;
+    for (uint32_t bit = 1u << 31; bit; bit >>= 1) {
+        uint64_t t = root | bit;
+        if (t * t <= (uint64_t)energy) {
+            root = t;
+        }
+    }
+    if (root == 0) {
+        memset(x, 0, width * sizeof(*x));
+        return;
+    }
+    // x * mantissa / root is below 2^31 since |x| <= root.
+    int64_t factor = ((int64_t)s_pow2_quarter[sf & 3] << 16) / root;
+    int shift = 46 - AAC_SPEC_BITS - (sf >> 2);
+    for (int k = 0; k < width; k++) {
+        x[k] = scale_down(x[k] * factor, shift);
+    }
+}
+
+// Turns quantised values into Q(AAC_SPEC_BITS) spectra, noise included.
+static void dequantize(aac_decoder_t *dec, const ics_t *ics, int32_t *x) {
+    int win = 0;
+    for (int g = 0; g < ics->num_groups; win += ics->group_len[g], g++) {
+        for (int sfb = 0; sfb < ics->max_sfb; sfb++) {
+            int i = g * AAC_SWB_LONG + sfb;
+            int book_id = ics->band_type[i];
+            int start = ics->swb[sfb];
+            int width = ics->swb[sfb + 1] - start;
+            if (book_id == BOOK_ZERO || book_id == BOOK_INTENSITY || book_id == BOOK_INTENSITY2) {
+                continue;
+            }
+            for (int w = win; w < win + ics->group_len[g]; w++) {
+                int32_t *band = x + w * SHORT_LEN + start;
+                if (book_id == BOOK_NOISE) {
+                    noise_band(dec, band, width, ics->sf[i]);
+                    continue;
+                }
+                int e = ics->sf[i] - 100;
+                int32_t mantissa = s_pow2_quarter[e & 3];
+                int shift = 30 + POW43_BITS - AAC_SPEC_BITS - (e >> 2);
+                for (int k = 0; k < width; k++) {
+                    int32_t q = band[k];
+                    if (q) {
+                        int64_t v = (int64_t)pow43(dec, q < 0 ? -q : q) * mantissa;
+                        band[k] = scale_down(q < 0 ? -v : v, shift);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static bool decode_ics(aac_decoder_t *dec, bits_t *b, ics_t *ics, int32_t *x, bool common_window) {
+    int global_gain = bits_get(b, 8);
+    if (!common_window && !ics_info(b, ics)) {
+        return false;
+    }
+    if (!section_data(b, ics) || !scale_factor_data(b, ics, global_gain)) {
+        return false;
+    }
+
+    int pulses = 0;
+    int pulse_pos[4], pulse_amp[4];
+    if (bits_get(b, 1)) {
+        if (ics->window_sequence == EIGHT_SHORT) {
+            return false;
+        }
+        pulses = bits_get(b, 2) + 1;
+        int start_sfb = bits_get(b, 6);
+        if (start_sfb >= ics->num_swb) {
+            return false;
+        }
+        int pos = ics->swb[start_sfb];
+        for (int i = 0; i < pulses; i++) {
+            pos += bits_get(b, 5);
+            pulse_pos[i] = pos;
+            pulse_amp[i] = bits_get(b, 4);
+        }
+        if (pos >= AAC_FRAME_SAMPLES) {
+            return false;
+        }
+    }
+    ics->tns_present = bits_get(b, 1);
+    if (ics->tns_present && !tns_data(b, ics)) {
+        return false;
+    }
+    if (bits_get(b, 1)) {
+        return false;   // Gain control: SSR profile only
+    }
+    if (!spectral_data(b, ics, x)) {
+        return false;
+    }
+    for (int i = 0; i < pulses; i++) {
+        int32_t *q = &x[pulse_pos[i]];
+        *q += *q > 0 ? pulse_amp[i] : -pulse_amp[i];
+    }
+    dequantize(dec, ics, x);
+    return true;
+}
+
+// --- Stereo ---
+static void mid_side(aac_decoder_t *dec) {
+    const ics_t *ics = &dec->ics[0];
+    int win = 0;
+    for (int g = 0; g < ics->num_groups; win += ics->group_len[g], g++) {
+        for (int sfb = 0; sfb < ics->max_sfb; sfb++) {
+            int i = g * AAC_SWB_LONG + sfb;
+            if (!dec->ms_used[i] || dec->ics[0].band_type[i] >= BOOK_NOISE || dec->ics[1].band_type[i] >= BOOK_NOISE) {
+                continue;
+            }
+            for (int w = win; w < win + ics->group_len[g]; w++) {
+                int32_t *l = dec->spec[0] + w * SHORT_LEN;
+                int32_t *r = dec->spec[1] + w * SHORT_LEN;
+                for (int k = ics->swb[sfb]; k < ics->swb[sfb + 1]; k++) {
+                    int32_t m = l[k], s = r[k];
+                    l[k] = clamp_spec((int64_t)m + s);
+                    r[k] = clamp_spec((int64_t)m - s);
+                }
+            }
+        }
+    }
+}
+
+static void intensity(aac_decoder_t *dec, bool ms_present) {
+    const ics_t *ics = &dec->ics[1];
+    int win = 0;
+    for (int g = 0; g < ics->num_groups; win += ics->group_len[g], g++) {
+        for (int sfb = 0; sfb < ics->max_sfb; sfb++) {
+            int i = g * AAC_SWB_LONG + sfb;
+            int book_id = ics->band_type[i];
+            if (book_id != BOOK_INTENSITY && book_id != BOOK_INTENSITY2) {
+                continue;
+            }
+            bool invert = (book_id == BOOK_INTENSITY2) != (ms_present && dec->ms_used[i]);
+            int e = -ics->sf[i];
+            int32_t mantissa = s_pow2_quarter[e & 3];
+            int shift = 30 - (e >> 2);
+            for (int w = win; w < win + ics->group_len[g]; w++) {
+                const int32_t *l = dec->spec[0] + w * SHORT_LEN;
+                int32_t *r = dec->spec[1] + w * SHORT_LEN;
+                for (int k = ics->swb[sfb]; k < ics->swb[sfb + 1]; k++) {
+                    int64_t v = (int64_t)l[k] * mantissa;
+                    r[k] = scale_down(invert ? -v : v, shift);
+                }
+            }
+        }
+    }
+}
+
+// --- TNS ---
+static void tns_apply(const aac_decoder_t *dec, const ics_t *ics, int32_t *x) {
+    bool is_short = ics->window_sequence == EIGHT_SHORT;
+    int max_band = is_short ? AAC_SWB_SHORT : dec->tns_max_bands;
+    if (max_band > ics->max_sfb) {
+        max_band = ics->max_sfb;
+    }
+    for (int w = 0; w < ics->num_windows; w++) {
+        const tns_t *t = &ics->tns[w];
+        int bottom = ics->num_swb;
+        for (int f = 0; f < t->filters; f++) {
+            int top = bottom;
+            bottom = top - t->length[f] > 0 ? top - t->length[f] : 0;
+            int order = t->order[f];
+            if (order == 0) {
+                continue;
+            }
+            // Parcor to direct-form coefficients, Q(LPC_BITS).
+            int32_t lpc[TNS_MAX_ORDER + 1], tmp[TNS_MAX_ORDER + 1];
+            for (int m = 1; m <= order; m++) {
+                int32_t k = dec->tns_sin[t->coef_res][t->coef[f][m - 1] + 8];
+                for (int i = 1; i < m; i++) {
+                    tmp[i] = lpc[i] + mul31(k, lpc[m - i]);
+                }
+                for (int i = 1; i < m; i++) {
+                    lpc[i] = tmp[i];
+                }
+                lpc[m] = k >> (31 - LPC_BITS);
+            }
+
+            int start = ics->swb[bottom < max_band ? bottom : max_band];
+            int end = ics->swb[top < max_band ? top : max_band];
+            int size = end - start;
+            if (size <= 0) {
+                continue;
+            }
+            int inc = 1;
+            int32_t *p = x + w * SHORT_LEN + start;
+            if (t->downward[f]) {
+                inc = -1;
+                p += size - 1;
+            }
+            for (int n = 0; n < size; n++, p += inc) {
+                int64_t acc = 0;
+                for (int i = 1; i <= order && i <= n; i++) {
+                    acc += (int64_t)lpc[i] * p[-i * inc];
+                }
+                *p = clamp_spec(*p - (acc >> LPC_BITS));
+            }
+        }
+    }
+}
+
+// --- Synthesis ---
+static inline int16_t to_pcm(int32_t v) {
+    v = (v + (1 << (AAC_OUT_BITS - 1))) >> AAC_OUT_BITS;
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+}
+
+// Sample j (448 <= j < 1600) of the eight overlapping short windows, whose
+// folded IMDCT outputs are in x[w * 128].
+static inline int32_t short_sample(const aac_decoder_t *dec, const int32_t *x, int j, int prev, int cur) {
+    int t = j - 448;
+    int w = t >> 7;
+    int i = t & (SHORT_LEN - 1);
+    int32_t v = 0;
+    if (w < MAX_WINDOWS) {
+        v += mul31(imdct_sample(x + w * SHORT_LEN, 2 * SHORT_LEN, i), dec->window_short[w ? cur : prev][i]);
+    }
+    if (w > 0) {
+        v += mul31(imdct_sample(x + (w - 1) * SHORT_LEN, 2 * SHORT_LEN, i + SHORT_LEN),
+                   dec->window_short[cur][SHORT_LEN - 1 - i]);
+    }
+    return v;
+}
+
+// Long-window weight of sample j (0 <= j < 2048) for the given sequence.
+static inline int32_t long_weight(const aac_decoder_t *dec, int seq, int j, int prev, int cur) {
+    const int n = AAC_FRAME_SAMPLES;
+    if (j < n) {
+        if (seq != LONG_STOP) {
+            return dec->window_long[prev][j];
+        }
+        return j < 448 ? 0 : (j < 576 ? dec->window_short[prev][j - 448] : INT32_MAX);
+    }
+    if (seq != LONG_START) {
+        return dec->window_long[cur][2 * n - 1 - j];
+    }
+    return j < 1472 ? INT32_MAX : (j < 1600 ? dec->window_short[cur][1599 - j] : 0);
+}
+
+static void synthesize(aac_decoder_t *dec, int ch, int channels) {
+    const ics_t *ics = &dec->ics[ch];
+    int32_t *x = dec->spec[ch];
+    int32_t *overlap = dec->overlap[ch];
+    int16_t *out = dec->pcm + ch;
+    int prev = dec->prev_shape[ch];
+    int cur = ics->window_shape;
+    const int n = AAC_FRAME_SAMPLES;
+
+    if (ics->window_sequence == EIGHT_SHORT) {
+        for (int w = 0; w < MAX_WINDOWS; w++) {
+            imdct_folded(&dec->imdct, x + w * SHORT_LEN, 2 * SHORT_LEN, AAC_SPEC_BITS + 7, AAC_OUT_BITS, dec->work);
+        }
+        for (int j = 0; j < n; j++) {
+            int32_t v = overlap[j];
+            if (j >= 448) {
+                v += short_sample(dec, x, j, prev, cur);
+            }
+            out[j * channels] = to_pcm(v);
+        }
+        for (int j = n; j < 2 * n; j++) {
+            overlap[j - n] = j < 1600 ? short_sample(dec, x, j, prev, cur) : 0;
+        }
+    } else {
+        imdct_folded(&dec->imdct, x, 2 * n, AAC_SPEC_BITS + 10, AAC_OUT_BITS, dec->work);
+        int seq = ics->window_sequence;
+        for (int j = 0; j < n; j++) {
+            int32_t v = overlap[j] + mul31(imdct_sample(x, 2 * n, j), long_weight(dec, seq, j, prev, cur));
+            out[j * channels] = to_pcm(v);
+        }
+        for (int j = n; j < 2 * n; j++) {
+            overlap[j - n] = mul31(imdct_sample(x, 2 * n, j), long_weight(dec, seq, j, prev, cur));
+        }
+    }
+    dec->prev_shape[ch] = cur;
+}
+
+// --- Frames ---
+static void skip_bytes(bits_t *b, int n) {
+    b->pos += 8 * n;
+}
+
+static bool skip_pce(bits_t *b) {
+    bits_get(b, 4 + 2 + 4);     // Tag, object type, rate index
+    int front = bits_get(b, 4);
+    int side = bits_get(b, 4);
+    int back = bits_get(b, 4);
+    int lfe = bits_get(b, 2);
+    int assoc = bits_get(b, 3);
+    int cc = bits_get(b, 4);
+    for (int i = 0; i < 3; i++) {
+        if (bits_get(b, 1)) {
+            bits_get(b, i < 2 ? 4 : 3);     // Mono, stereo, matrix mixdown
+        }
+    }
+    b->pos += 5 * (front + side + back) + 4 * (lfe + assoc) + 5 * cc;
+    b->pos = (b->pos + 7) & ~(size_t)7;
+    skip_bytes(b, bits_get(b, 8));
+    return !bits_overrun(b);
+}
+
+static int decode_cpe(aac_decoder_t *dec, bits_t *b) {
+    bool common_window = bits_get(b, 1);
+    int ms_mask = 0;
+    memset(dec->ms_used, 0, sizeof(dec->ms_used));
+    if (common_window) {
+        if (!ics_info(b, &dec->ics[0])) {
+            return AAC_ERR_FRAME;
+        }
+        dec->ics[1] = dec->ics[0];
+        ms_mask = bits_get(b, 2);
+        if (ms_mask == 3) {
+            return AAC_ERR_FRAME;
+        }
+        const ics_t *ics = &dec->ics[0];
+        for (int g = 0; ms_mask && g < ics->num_groups; g++) {
+            for (int sfb = 0; sfb < ics->max_sfb; sfb++) {
+                dec->ms_used[g * AAC_SWB_LONG + sfb] = ms_mask == 2 ? 1 : bits_get(b, 1);
+            }
+        }
+    }
+    for (int ch = 0; ch < 2; ch++) {
+        if (!decode_ics(dec, b, &dec->ics[ch], dec->spec[ch], common_window)) {
+            return AAC_ERR_FRAME;
+        }
+    }
+    if (common_window && ms_mask) {
+        mid_side(dec);
+    }
+    intensity(dec, ms_mask != 0);
+    return AAC_OK;
+}
+
+int aac_decode_frame(aac_decoder_t *dec, const uint8_t *frame, size_t len, const int16_t **pcm) {
+    aac_adts_t h;
+    int flen = aac_parse_adts(frame, len, &h);
+    if (flen < 0 || (size_t)flen > len) {
+        return AAC_ERR_FRAME;
+    }
+    if (!aac_supported(&h)) {
+        return AAC_ERR_UNSUPPORTED;
+    }
+    dec->tns_max_bands = h.rate_index == 3 ? 40 : 42;
+
+    bits_t b = { frame, 8 * (AAC_ADTS_HEADER_LEN + (h.has_crc ? 2 : 0)), 8 * (size_t)flen };
+    int channels = 0;
+    while (1) {
+        int id = bits_get(&b, 3);
+        if (id == ID_END) {
+            break;
+        }
+        int status = AAC_OK;
+        bool align;
+        int n;
+        switch (id) {
+            case ID_SCE:
+                if (channels + 1 > AAC_MAX_CHANNELS) {
+                    return AAC_ERR_UNSUPPORTED;
+                }
+                bits_get(&b, 4);
+                if (!decode_ics(dec, &b, &dec->ics[channels], dec->spec[channels], false)) {
+                    status = AAC_ERR_FRAME;
+                }
+                channels++;
+                break;
+            case ID_CPE:
+                if (channels + 2 > AAC_MAX_CHANNELS) {
+                    return AAC_ERR_UNSUPPORTED;
+                }
+                bits_get(&b, 4);
+                status = decode_cpe(dec, &b);
+                channels += 2;
+                break;
+            case ID_DSE:
+                bits_get(&b, 4);
+                align = bits_get(&b, 1);
+                n = bits_get(&b, 8);
+                if (n == 255) {
+                    n += bits_get(&b, 8);
+                }
+                if (align) {
+                    b.pos = (b.pos + 7) & ~(size_t)7;
+                }
+                skip_bytes(&b, n);
+                break;
+            case ID_PCE:
+                if (!skip_pce(&b)) {
+                    status = AAC_ERR_FRAME;
+                }
+                break;
+            case ID_FIL:
+                n = bits_get(&b, 4);
+                if (n == 15) {
+                    n += bits_get(&b, 8) - 1;
+                }
+                skip_bytes(&b, n);
+                break;
+            default:
+                // Coupling channels and LFE do not occur in mono or stereo
+                // configurations.
+                return AAC_ERR_UNSUPPORTED;
+        }
+        if (status != AAC_OK) {
+            return status;
+        }
+        if (bits_overrun(&b)) {
+            return AAC_ERR_FRAME;
+        }
+    }
+    if (channels != h.channel_config) {
+        return AAC_ERR_FRAME;
+    }
+
+    if (channels != dec->channels) {
+        memset(dec->overlap, 0, sizeof(dec->overlap));
+        dec->channels = channels;
+    }
+    for (int ch = 0; ch < channels; ch++) {
+        if (dec->ics[ch].tns_present) {
+            tns_apply(dec, &dec->ics[ch], dec->spec[ch]);
+        }
+        synthesize(dec, ch, channels);
+    }
+    *pcm = dec->pcm;
+    return AAC_FRAME_SAMPLES;
+}
+
+void aac_decoder_restart(aac_decoder_t *dec) {
+    memset(dec->overlap, 0, sizeof(dec->overlap));
+    memset(dec->prev_shape, 0, sizeof(dec->prev_shape));
+}
+
+int aac_conceal(aac_decoder_t *dec, const int16_t **pcm) {
+    if (dec->channels == 0) {
+        return 0;
+    }
+    for (int ch = 0; ch < dec->channels; ch++) {
+        for (int j = 0; j < AAC_FRAME_SAMPLES; j++) {
+            dec->pcm[j * dec->channels + ch] = to_pcm(dec->overlap[ch][j]);
+        }
+    }
+    memset(dec->overlap, 0, sizeof(dec->overlap));
+    *pcm = dec->pcm;
+    return AAC_FRAME_SAMPLES;
+}
@@ -0,0 +1,75 @@
+/*
+ * AAC-LC decoder for ADTS streams, integer only.
+ *
+ * Handles what music encoders put in a 44.1 or 48 kHz mono or stereo LC
+ * stream: long and short windows, sine and KBD window shapes, M/S and
+ * intensity stereo, perceptual noise substitution, TNS and pulse data.
+ * SBR/PS (HE-AAC), coupling channels, main-profile prediction and streams
+ * with several raw data blocks per ADTS frame are refused.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AAC_FRAME_SAMPLES       1024
+#define AAC_MAX_CHANNELS        2
+#define AAC_ADTS_HEADER_LEN     7       // Plus 2 CRC bytes when protected
+#define AAC_MAX_FRAME_LEN       2048    // 6144 bits per channel at most, plus headers
+#define AAC_INPUT_PADDING       8       // Readable bytes required after each frame
+
+typedef enum {
+    AAC_OK = 0,
+    AAC_ERR_FRAME = -1,             // Damaged frame; nothing was decoded
+    AAC_ERR_UNSUPPORTED = -2,       // Legal but not handled here (see above)
+} aac_status_t;
+
+typedef struct {
+    uint8_t profile;                // Audio object type minus one: 1 is LC
+    uint8_t rate_index;             // Sampling frequency index
+    uint8_t channel_config;
+    bool has_crc;                   // A CRC follows the fixed header
+    uint8_t raw_blocks;             // Raw data blocks in the frame, minus one
+    uint16_t frame_len;             // Header included
+} aac_adts_t;
+
+typedef struct aac_decoder aac_decoder_t;
+
+// Parses the ADTS header at data (len >= AAC_ADTS_HEADER_LEN). Returns the
+// frame length or -1 if this is not a plausible header.
+int aac_parse_adts(const uint8_t *data, size_t len, aac_adts_t *h);
+
+// 0 for reserved indexes.
+uint32_t aac_sample_rate(const aac_adts_t *h);
+
+// True if the decoder handles streams with this header.
+bool aac_supported(const aac_adts_t *h);
+
+// Bytes of memory a decoder needs.
+size_t aac_decoder_size(void);
+
+// Places a decoder in mem (aac_decoder_size() bytes, aligned as malloc's)
+// and builds its tables.
+aac_decoder_t *aac_decoder_create(void *mem);
+
+// Decodes one whole ADTS frame, header included, which must be followed by
+// AAC_INPUT_PADDING readable bytes. Returns AAC_FRAME_SAMPLES frames of
+// interleaved PCM through *pcm (channel_config samples each; valid until the
+// next call), or an aac_status_t.
+int aac_decode_frame(aac_decoder_t *dec, const uint8_t *frame, size_t len, const int16_t **pcm);
+
+// Forgets the previous frame's overlap, for decoding from a new position
+// after a seek; the first frame then fades in. The tables are kept.
+void aac_decoder_restart(aac_decoder_t *dec);
+
+// Stands in for a frame that was lost: plays out the pending overlap, which
+// fades to silence, and clears it. Returns AAC_FRAME_SAMPLES, or 0 if no
+// frame has been decoded yet.
+int aac_conceal(aac_decoder_t *dec, const int16_t **pcm);
+
+// Channels of the last decoded frame.
+int aac_channels(const aac_decoder_t *dec);
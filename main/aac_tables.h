@@ -0,0 +1,34 @@
+/*
+ * Constant tables for the AAC-LC decoder: Huffman codebooks and the
+ * scalefactor band layout for 44.1 kHz (shared with 48 kHz).
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AAC_SCALEFACTOR_ENTRIES     121     // Index 60 is a difference of 0
+#define AAC_SPECTRAL_BOOKS          11      // Codebooks 1..11
+#define AAC_SWB_LONG                49
+#define AAC_SWB_SHORT               14
+
+typedef struct {
+    const uint16_t *codes;
+    const uint8_t *bits;
+    uint16_t entries;
+    uint8_t dimension;          // Values per codeword: 4 or 2
+    bool is_unsigned;           // Signs follow the codeword as separate bits
+    uint8_t lav;                // Largest absolute value; 16 escapes in book 11
+} aac_spectral_book_t;
+
+extern const uint32_t aac_scalefactor_codes[AAC_SCALEFACTOR_ENTRIES];
+extern const uint8_t aac_scalefactor_bits[AAC_SCALEFACTOR_ENTRIES];
+
+// Book n is aac_spectral_books[n - 1].
+extern const aac_spectral_book_t aac_spectral_books[AAC_SPECTRAL_BOOKS];
+
+extern const uint16_t aac_swb_offset_long[AAC_SWB_LONG + 1];
+extern const uint16_t aac_swb_offset_short[AAC_SWB_SHORT + 1];
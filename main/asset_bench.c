@@ -0,0 +1,89 @@
+/*
+ * Asset start-up benchmark
+ *
+ * Start latency on the device is the wait for the next a2d_data_cb plus the
+ * work that call does to start the sound: the name lookup and the first
+ * block, decoded from the mapped partition with a cold flash cache. The
+ * benchmark times those two on the cycle counter with a private voice, so
+ * nothing is heard, then the rest of the sound block by block for the
+ * steady cost. The wait itself is the average callback interval.
+ */
+
+#include "asset_bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "a2d_cadence.h"
+#include "asset_mix.h"
+#include "asset_player.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+
+#define ASSET_BENCH_BLOCK   128     // Frames in a typical a2d_data_cb request (512 bytes)
+
+static void asset_bench(void) {
+    size_t size;
+    const void *image = asset_player_image(&size);
+    const asset_image_entry_t *entries;
+    int count = image ? asset_image_entries(image, size, &entries) : 0;
+    if (count == 0) {
+        console_printf("asset: no asset image to time (see tools/asset_pack.py)\n");
+        return;
+    }
+    int16_t *pcm = malloc(ASSET_BENCH_BLOCK * AUDIO_BYTES_PER_FRAME);
+    if (!pcm) {
+        console_printf("asset: out of memory\n");
+        return;
+    }
+
+    double mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    for (int i = 0; i < count; i++) {
+        if (!asset_entry_valid(&entries[i], size)) {
+            continue;
+        }
+        char name[ASSET_NAME_LEN + 1];
+        memcpy(name, entries[i].name, ASSET_NAME_LEN);
+        name[ASSET_NAME_LEN] = '\0';
+
+        asset_voice_t v;
+        memset(pcm, 0, ASSET_BENCH_BLOCK * AUDIO_BYTES_PER_FRAME);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        const asset_image_entry_t *e = asset_find(image, size, name);
+        uint32_t t1 = esp_cpu_get_cycle_count();
+        asset_voice_start(&v, image, e, 32768);
+        asset_voice_mix(&v, pcm, ASSET_BENCH_BLOCK);
+        uint32_t t2 = esp_cpu_get_cycle_count();
+
+        uint32_t total = 0, worst = 0, frames = 0;
+        bool more = v.pos < e->frames;
+        while (more) {
+            uint32_t start = v.pos;
+            uint32_t t = esp_cpu_get_cycle_count();
+            more = asset_voice_mix(&v, pcm, ASSET_BENCH_BLOCK);
+            uint32_t cycles = esp_cpu_get_cycle_count() - t;
+            total += cycles;
+            worst = cycles > worst ? cycles : worst;
+            frames += v.pos - start;
+        }
+        double per_frame = frames ? (double)total / frames : 0;
+        console_printf("%-16s %s %s: lookup %lu cycles, first block %lu, %.0f us to start; then %.1f per frame "
+                       "(worst block %lu), %.2f%% cpu@%dMHz\n",
+                       name, e->channels == 1 ? "mono" : "stereo", e->coding == ASSET_CODING_PCM16 ? "pcm16" : "adpcm",
+                       (unsigned long)(t1 - t0), (unsigned long)(t2 - t1), (t2 - t0) / mhz, per_frame,
+                       (unsigned long)worst, per_frame * AUDIO_SAMPLE_RATE / (mhz * 1e6) * 100,
+                       CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    }
+    uint32_t interval_us = a2d_cadence_interval_us();
+    if (interval_us > 0) {
+        console_printf("Plus the wait for the next a2d_data_cb: %.1f ms on average, %.1f ms at most\n",
+                       interval_us / 2000.0, interval_us / 1000.0);
+    } else {
+        console_printf("Plus the wait for the next a2d_data_cb (not streaming now, so not measured)\n");
+    }
+    free(pcm);
+}
+
+void asset_bench_init(void) {
+    console_register_bench("asset", asset_bench);
+}
@@ -0,0 +1,10 @@
+/*
+ * Asset start-up benchmark ("bench asset"): for each sound in the asset
+ * partition, cycles to find it by name and to mix its first a2d_data_cb
+ * block straight from flash, then the steady mixing cost per frame.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void asset_bench_init(void);
@@ -0,0 +1,133 @@
+/*
+ * Audio asset decoding and mixing
+ *
+ * Nothing is copied out of the image: a voice keeps a pointer into it and
+ * decodes as it mixes, so starting a sound costs a name lookup and a few
+ * stores, and the first samples come out of the next mix call. The loops
+ * are split by coding and channel count so the per-frame work has no
+ * branches beyond the ADPCM decode itself.
+ */
+
+#include "asset_mix.h"
+
+#include <string.h>
+
+static const int16_t s_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+    4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t s_index_step[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+int asset_image_entries(const void *base, size_t size, const asset_image_entry_t **entries) {
+    const asset_image_header_t *hdr = base;
+    if (size < sizeof(*hdr) || hdr->magic != ASSET_IMAGE_MAGIC) {
+        return 0;
+    }
+    size_t max = (size - sizeof(*hdr)) / sizeof(asset_image_entry_t);
+    *entries = (const asset_image_entry_t *)(hdr + 1);
+    return hdr->count < max ? hdr->count : max;
+}
+
+bool asset_entry_valid(const asset_image_entry_t *e, size_t image_size) {
+    if (e->rate != ASSET_RATE || (e->channels != 1 && e->channels != 2) || (e->offset & 3) ||
+        (uint64_t)e->offset + e->bytes > image_size) {
+        return false;
+    }
+    uint64_t samples = (uint64_t)e->frames * e->channels;
+    switch (e->coding) {
+        case ASSET_CODING_PCM16:
+            return samples * 2 <= e->bytes;
+        case ASSET_CODING_IMA_ADPCM:
+            return (samples + 1) / 2 <= e->bytes;
+        default:
+            return false;
+    }
+}
+
+const asset_image_entry_t *asset_find(const void *base, size_t size, const char *name) {
+    const asset_image_entry_t *entries;
+    int count = asset_image_entries(base, size, &entries);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(entries[i].name, name, ASSET_NAME_LEN) == 0 && asset_entry_valid(&entries[i], size)) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+void asset_voice_start(asset_voice_t *v, const void *base, const asset_image_entry_t *e, int32_t gain) {
+    memset(v, 0, sizeof(*v));
+    v->entry = e;
+    v->data = (const uint8_t *)base + e->offset;
+    v->gain = gain;
+}
+
+static inline int32_t ima_decode(int32_t *predictor, int32_t *step_index, uint32_t nibble) {
+    int32_t step = s_steps[*step_index];
+    int32_t diff = step >> 3;
+    if (nibble & 4) {
+        diff += step;
+    }
+    if (nibble & 2) {
+        diff += step >> 1;
+    }
+    if (nibble & 1) {
+        diff += step >> 2;
+    }
+    int32_t p = *predictor + ((nibble & 8) ? -diff : diff);
+    p = p > 32767 ? 32767 : (p < -32768 ? -32768 : p);
+    *predictor = p;
+    int32_t i = *step_index + s_index_step[nibble & 7];
+    *step_index = i < 0 ? 0 : (i > 88 ? 88 : i);
+    return p;
+}
+
+static inline void mix_frame(int16_t *out, int32_t left, int32_t right, int32_t gain) {
+    int32_t l = out[0] + ((left * gain) >> 15);
+    int32_t r = out[1] + ((right * gain) >> 15);
+    out[0] = l > 32767 ? 32767 : (l < -32768 ? -32768 : l);
+    out[1] = r > 32767 ? 32767 : (r < -32768 ? -32768 : r);
+}
+
+bool asset_voice_mix(asset_voice_t *v, int16_t *pcm, size_t frames) {
+    const asset_image_entry_t *e = v->entry;
+    uint32_t left = e->frames - v->pos;
+    uint32_t n = frames < left ? frames : left;
+    int32_t gain = v->gain;
+
+    if (e->coding == ASSET_CODING_PCM16) {
+        const int16_t *src = (const int16_t *)v->data + (size_t)v->pos * e->channels;
+        if (e->channels == 2) {
+            for (uint32_t i = 0; i < n; i++) {
+                mix_frame(pcm + 2 * i, src[2 * i], src[2 * i + 1], gain);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                mix_frame(pcm + 2 * i, src[i], src[i], gain);
+            }
+        }
+    } else if (e->channels == 2) {
+        const uint8_t *src = v->data + v->pos;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t byte = src[i];
+            int32_t l = ima_decode(&v->predictor[0], &v->step_index[0], byte & 15);
+            int32_t r = ima_decode(&v->predictor[1], &v->step_index[1], byte >> 4);
+            mix_frame(pcm + 2 * i, l, r, gain);
+        }
+    } else {
+        const uint8_t *src = v->data + v->pos / 2;
+        bool odd = v->pos & 1;              // Next sample is a high nibble
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t nibble = odd ? *src++ >> 4 : *src & 15;
+            odd = !odd;
+            int32_t s = ima_decode(&v->predictor[0], &v->step_index[0], nibble);
+            mix_frame(pcm + 2 * i, s, s, gain);
+        }
+    }
+    v->pos += n;
+    return v->pos < e->frames;
+}
@@ -0,0 +1,72 @@
+/*
+ * Audio assets: short pre-encoded sounds in a flash image (see
+ * tools/asset_pack.py), decoded straight from where the image is mapped and
+ * mixed into 16-bit stereo PCM.
+ *
+ * Assets are 44.1 kHz, mono or stereo, either 16-bit PCM or 4-bit IMA
+ * ADPCM (a quarter of the size, a few operations per sample to decode).
+ * ADPCM assets are one continuous stream starting from a zero predictor and
+ * step index; in stereo each byte holds a left nibble (low) and a right one,
+ * in mono two samples, low nibble first.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASSET_IMAGE_MAGIC   0x31534141  // "AAS1" little endian
+#define ASSET_NAME_LEN      16
+#define ASSET_RATE          44100
+
+typedef enum {
+    ASSET_CODING_PCM16,
+    ASSET_CODING_IMA_ADPCM,
+} asset_coding_t;
+
+// The image starts with this header and count entries.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t count;
+} asset_image_header_t;
+
+typedef struct __attribute__((packed)) {
+    char name[ASSET_NAME_LEN];              // NUL padded
+    uint32_t rate;
+    uint32_t frames;
+    uint32_t offset;                        // From the start of the image, 4-byte aligned
+    uint32_t bytes;
+    uint8_t coding;                         // asset_coding_t
+    uint8_t channels;                       // 1 or 2
+    uint16_t reserved;
+} asset_image_entry_t;
+
+typedef struct {
+    const asset_image_entry_t *entry;
+    const uint8_t *data;
+    uint32_t pos;                           // Frames played
+    int32_t gain;                           // Q15
+    int32_t predictor[2];                   // ADPCM decoder state per channel
+    int32_t step_index[2];
+} asset_voice_t;
+
+// Entries of the image at base, size bytes long; returns how many there are
+// (0 if it is not an asset image) and sets *entries. Check each one with
+// asset_entry_valid() before playing it.
+int asset_image_entries(const void *base, size_t size, const asset_image_entry_t **entries);
+
+bool asset_entry_valid(const asset_image_entry_t *e, size_t image_size);
+
+// The entry called name, or NULL.
+const asset_image_entry_t *asset_find(const void *base, size_t size, const char *name);
+
+// Starts v at the beginning of e, a valid entry of the image at base. gain
+// is Q15, 32768 for unity.
+void asset_voice_start(asset_voice_t *v, const void *base, const asset_image_entry_t *e, int32_t gain);
+
+// Adds up to frames frames of v to interleaved stereo pcm, saturating;
+// returns false once v has finished.
+bool asset_voice_mix(asset_voice_t *v, int16_t *pcm, size_t frames);
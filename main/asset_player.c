@@ -0,0 +1,222 @@
+/*
+ * Asset player
+ *
+ * Requests go through a short queue that a2d_data_cb drains without
+ * waiting; an atomic count of waiting requests keeps that to one load per
+ * call while nothing is asked for. The voices belong to a2d_data_cb alone.
+ * Each request carries the time it was made, so the delay until its first
+ * samples were mixed is measured on the device rather than assumed.
+ *
+ * The whole partition stays mapped through the flash cache: an asset's
+ * first block costs a few cache misses, after which decoding runs from the
+ * cache like any other constant data.
+ */
+
+#include "asset_player.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "asset_mix.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "telemetry.h"
+
+#define ASSET_QUEUE_LEN     4
+#define ASSET_MIN_GAIN_DB   -60
+
+static const char *TAG = "ASSETS";
+
+typedef struct {
+    const asset_image_entry_t *entry;       // NULL stops everything
+    int32_t gain;
+    int64_t requested_us;
+} asset_request_t;
+
+static const esp_partition_t *s_partition = NULL;
+static const void *s_base = NULL;
+static size_t s_size = 0;
+static esp_partition_mmap_handle_t s_mmap;
+static QueueHandle_t s_requests = NULL;
+static atomic_int s_waiting;                // Requests in s_requests
+
+// a2d_data_cb only.
+static asset_voice_t s_voices[ASSET_PLAYER_VOICES];
+static bool s_playing[ASSET_PLAYER_VOICES];
+
+// Written by a2d_data_cb, read by the console and telemetry.
+static atomic_uint s_started;
+static atomic_uint s_cut_short;             // Stopped or replaced before the end
+static atomic_uint s_start_us;              // Request to first samples, last sound
+static atomic_uint s_start_max_us;
+static atomic_uint s_refused;               // Queue full
+
+const void *asset_player_image(size_t *size) {
+    *size = s_size;
+    return s_base;
+}
+
+static bool post(const asset_request_t *req) {
+    if (s_requests == NULL || xQueueSend(s_requests, req, 0) != pdTRUE) {
+        atomic_fetch_add(&s_refused, 1);
+        return false;
+    }
+    atomic_fetch_add(&s_waiting, 1);
+    return true;
+}
+
+bool asset_player_play(const char *name, int gain_db) {
+    const asset_image_entry_t *e = s_base ? asset_find(s_base, s_size, name) : NULL;
+    if (e == NULL) {
+        return false;
+    }
+    gain_db = gain_db > 0 ? 0 : (gain_db < ASSET_MIN_GAIN_DB ? ASSET_MIN_GAIN_DB : gain_db);
+    asset_request_t req = {
+        .entry = e,
+        .gain = (int32_t)lrintf(32768 * powf(10, gain_db / 20.0f)),
+        .requested_us = esp_timer_get_time(),
+    };
+    return post(&req);
+}
+
+void asset_player_stop(void) {
+    asset_request_t req = { .entry = NULL };
+    post(&req);
+}
+
+// --- Mixing ---
+// A free voice, or failing that the one furthest into its sound.
+static int pick_voice(void) {
+    int best = 0;
+    for (int i = 0; i < ASSET_PLAYER_VOICES; i++) {
+        if (!s_playing[i]) {
+            return i;
+        }
+        if (s_voices[i].pos > s_voices[best].pos) {
+            best = i;
+        }
+    }
+    atomic_fetch_add_explicit(&s_cut_short, 1, memory_order_relaxed);
+    return best;
+}
+
+static void take_requests(int64_t now) {
+    asset_request_t req;
+    while (atomic_load_explicit(&s_waiting, memory_order_acquire) > 0 && xQueueReceive(s_requests, &req, 0) == pdTRUE) {
+        atomic_fetch_sub_explicit(&s_waiting, 1, memory_order_relaxed);
+        if (req.entry == NULL) {
+            for (int i = 0; i < ASSET_PLAYER_VOICES; i++) {
+                if (s_playing[i]) {
+                    s_playing[i] = false;
+                    atomic_fetch_add_explicit(&s_cut_short, 1, memory_order_relaxed);
+                }
+            }
+            continue;
+        }
+        int v = pick_voice();
+        asset_voice_start(&s_voices[v], s_base, req.entry, req.gain);
+        s_playing[v] = true;
+        uint32_t us = now - req.requested_us;
+        atomic_store_explicit(&s_start_us, us, memory_order_relaxed);
+        if (us > atomic_load_explicit(&s_start_max_us, memory_order_relaxed)) {
+            atomic_store_explicit(&s_start_max_us, us, memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&s_started, 1, memory_order_relaxed);
+    }
+}
+
+void asset_player_mix(uint8_t *data, size_t len) {
+    if (atomic_load_explicit(&s_waiting, memory_order_acquire) > 0) {
+        take_requests(esp_timer_get_time());
+    }
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+    for (int i = 0; i < ASSET_PLAYER_VOICES; i++) {
+        if (s_playing[i]) {
+            s_playing[i] = asset_voice_mix(&s_voices[i], (int16_t *)data, frames);
+        }
+    }
+}
+
+// --- Console and telemetry ---
+static int asset_telemetry(char *buf, size_t len) {
+    return snprintf(buf, len, "started=%u cut_short=%u refused=%u start_us=%u start_max_us=%u",
+                    atomic_load(&s_started), atomic_load(&s_cut_short), atomic_load(&s_refused),
+                    atomic_load(&s_start_us), atomic_load(&s_start_max_us));
+}
+
+static void list_assets(void) {
+    const asset_image_entry_t *entries;
+    int count = s_base ? asset_image_entries(s_base, s_size, &entries) : 0;
+    if (count == 0) {
+        console_printf("No asset image in the %s partition (see tools/asset_pack.py)\n", ASSET_PARTITION_LABEL);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const asset_image_entry_t *e = &entries[i];
+        if (!asset_entry_valid(e, s_size)) {
+            console_printf("  entry %d is damaged\n", i);
+            continue;
+        }
+        console_printf("  %-16.16s  %6.0f ms  %s %s  %lu bytes\n", e->name, e->frames * 1000.0 / e->rate,
+                       e->channels == 1 ? "mono" : "stereo", e->coding == ASSET_CODING_PCM16 ? "pcm16" : "adpcm",
+                       (unsigned long)e->bytes);
+    }
+}
+
+static int cmd_asset(int argc, char **argv) {
+    if (argc < 2) {
+        if (s_partition == NULL) {
+            console_printf("No '%s' partition in the partition table\n", ASSET_PARTITION_LABEL);
+            return 0;
+        }
+        list_assets();
+        console_printf("%u started, %u cut short; last start %u us after the request, worst %u us\n",
+                       atomic_load(&s_started), atomic_load(&s_cut_short), atomic_load(&s_start_us),
+                       atomic_load(&s_start_max_us));
+        console_printf("Usage: asset play <name> [gain dB] | asset stop\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "stop") == 0) {
+        asset_player_stop();
+        return 0;
+    }
+    if (strcmp(argv[1], "play") != 0 || argc < 3) {
+        console_printf("Expected play <name> [gain dB] or stop\n");
+        return -1;
+    }
+    int gain_db = argc > 3 ? atoi(argv[3]) : 0;
+    if (gain_db > 0 || gain_db < ASSET_MIN_GAIN_DB) {
+        console_printf("Gain must be from %d to 0 dB\n", ASSET_MIN_GAIN_DB);
+        return -1;
+    }
+    if (!asset_player_play(argv[2], gain_db)) {
+        console_printf("No asset '%s', or too many requests waiting\n", argv[2]);
+        return -1;
+    }
+    return 0;
+}
+
+void asset_player_init(void) {
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ASSET_PARTITION_SUBTYPE, ASSET_PARTITION_LABEL);
+    if (s_partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition; local sounds are unavailable", ASSET_PARTITION_LABEL);
+    } else if (esp_partition_mmap(s_partition, 0, s_partition->size, ESP_PARTITION_MMAP_DATA, &s_base, &s_mmap) !=
+               ESP_OK) {
+        ESP_LOGE(TAG, "Unable to map the '%s' partition", ASSET_PARTITION_LABEL);
+        s_base = NULL;
+    } else {
+        s_size = s_partition->size;
+        s_requests = xQueueCreate(ASSET_QUEUE_LEN, sizeof(asset_request_t));
+        const asset_image_entry_t *entries;
+        ESP_LOGI(TAG, "%d sounds in flash", asset_image_entries(s_base, s_size, &entries));
+    }
+    console_register("asset", "Mix a sound from flash into the output: asset [play <name> [dB] | stop]", cmd_asset);
+    telemetry_register("asset", asset_telemetry);
+}
@@ -0,0 +1,37 @@
+/*
+ * Asset player: mixes sounds from the "assets" flash partition (see
+ * tools/asset_pack.py) into the Bluetooth output, on top of whatever is
+ * streaming. The partition is memory-mapped once at start-up and sounds
+ * are decoded from flash as they play, so a sound starts at the next
+ * a2d_data_cb call after it is requested, without touching Wi-Fi or the
+ * playback buffer. Plays "startup" (if the image has one) when Bluetooth
+ * audio starts.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASSET_PARTITION_LABEL       "assets"
+#define ASSET_PARTITION_SUBTYPE     0x41
+#define ASSET_PLAYER_VOICES         2       // Sounds mixed at once
+#define ASSET_STARTUP_NAME          "startup"
+
+// Maps the partition and registers the "asset" command and telemetry.
+void asset_player_init(void);
+
+// The mapped image and its size, or NULL without a partition.
+const void *asset_player_image(size_t *size);
+
+// Queues name to start at gain_db (at most 0). Returns false if there is
+// no such asset or too many requests are already waiting. Any task.
+bool asset_player_play(const char *name, int gain_db);
+
+// Stops every sound playing. Any task.
+void asset_player_stop(void);
+
+// Called from a2d_data_cb with the block handed to Bluetooth: starts
+// requested sounds and mixes the playing ones in. Never blocks.
+void asset_player_mix(uint8_t *data, size_t len);
@@ -0,0 +1,66 @@
+/*
+ * Shared definitions for the Wi-Fi to Bluetooth A2DP audio bridge.
+ *
+ * The playback buffer and the TCP client live in blu_moudle.c; other modules
+ * reach them only through the functions declared here.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// --- Audio Format ---
+// Bluedroid's A2DP source pulls 16-bit stereo PCM at 44.1 kHz from a2d_data_cb.
+#define AUDIO_SAMPLE_RATE       44100
+#define AUDIO_CHANNELS          2
+#define AUDIO_BYTES_PER_FRAME   (AUDIO_CHANNELS * sizeof(int16_t))
+#define AUDIO_BYTES_PER_SEC     (AUDIO_SAMPLE_RATE * AUDIO_BYTES_PER_FRAME)
+
+#define STREAM_BUFFER_SIZE      (16 * 1024)
+
+// Producers that can own the playback buffer.
+typedef enum {
+    AUDIO_SOURCE_NETWORK,       // TCP sender on port 8080
+    AUDIO_SOURCE_GENERATOR,     // Built-in test signals
+    AUDIO_SOURCE_QUEUE,         // Items fetched by the play queue
+} audio_source_t;
+
+// Takes PCM on its way to the playback buffer; returns bytes accepted.
+// Filters in the playback path pass their output to one of these.
+typedef size_t (*audio_sink_t)(const void *data, size_t len, void *ctx);
+
+// Hands the playback buffer to source. The network owns it by default and
+// gives way to the generator or the play queue, which keeps it until it
+// releases it; the other one is refused meanwhile. Returns whether source
+// owns the buffer now.
+bool audio_bridge_claim(audio_source_t source);
+
+// Hands the playback buffer back to the network, if source owns it.
+void audio_bridge_release(audio_source_t source);
+
+// Queues PCM for a2d_data_cb. Data from a producer that does not own the
+// buffer is discarded (and reported as written); only the network sender
+// writes that way, so it keeps draining its input.
+size_t audio_bridge_write(audio_source_t source, const void *data, size_t len, TickType_t wait);
+
+// Discards what source has queued so far, in the filters and in the playback
+// buffer, so the next write is the next thing heard; a seek calls this just
+// before writing audio from the new position. Does nothing unless source
+// owns the buffer.
+void audio_bridge_flush(audio_source_t source);
+
+// Bytes currently waiting in the playback buffer.
+size_t audio_bridge_buffered_bytes(void);
+
+// Silence a2d_data_cb has filled in for audio that had not arrived while a
+// producer was active, in bytes since boot (wraps).
+uint32_t audio_bridge_missing_bytes(void);
+
+// True while a sender is connected to the TCP ingest port.
+bool audio_bridge_client_connected(void);
+
+// Forces the current TCP client off, as if the network had dropped it.
+void audio_bridge_kick_client(void);
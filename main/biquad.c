@@ -0,0 +1,62 @@
+/*
+ * Biquad design
+ *
+ * Coefficients follow Robert Bristow-Johnson's Audio EQ Cookbook and are
+ * worked out in double precision; only the processing is fixed point.
+ */
+
+#include "biquad.h"
+
+#include <math.h>
+
+static int32_t quantize(double v) {
+    return (int32_t)lrint(v * (1 << BIQUAD_COEF_BITS));
+}
+
+void biquad_set(biquad_t *f, double b0, double b1, double b2, double a0, double a1, double a2) {
+    f->b0 = quantize(b0 / a0);
+    f->b1 = quantize(b1 / a0);
+    f->b2 = quantize(b2 / a0);
+    f->a1 = quantize(a1 / a0);
+    f->a2 = quantize(a2 / a0);
+}
+
+void biquad_lowpass(biquad_t *f, float hz, float q, uint32_t rate) {
+    double w0 = 2 * M_PI * hz / rate;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2 * q);
+    biquad_set(f, (1 - cw) / 2, 1 - cw, (1 - cw) / 2, 1 + alpha, -2 * cw, 1 - alpha);
+}
+
+void biquad_allpass(biquad_t *f, float hz, float q, uint32_t rate) {
+    double w0 = 2 * M_PI * hz / rate;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2 * q);
+    biquad_set(f, 1 - alpha, -2 * cw, 1 + alpha, 1 + alpha, -2 * cw, 1 - alpha);
+}
+
+void biquad_peak(biquad_t *f, float hz, float gain_db, float q, uint32_t rate) {
+    double a = pow(10, gain_db / 40);
+    double w0 = 2 * M_PI * hz / rate;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2 * q);
+    biquad_set(f, 1 + alpha * a, -2 * cw, 1 - alpha * a, 1 + alpha / a, -2 * cw, 1 - alpha / a);
+}
+
+void biquad_low_shelf(biquad_t *f, float hz, float gain_db, float q, uint32_t rate) {
+    double a = pow(10, gain_db / 40);
+    double w0 = 2 * M_PI * hz / rate;
+    double cw = cos(w0);
+    double t = 2 * sqrt(a) * sin(w0) / (2 * q);
+    biquad_set(f, a * ((a + 1) - (a - 1) * cw + t), 2 * a * ((a - 1) - (a + 1) * cw), a * ((a + 1) - (a - 1) * cw - t),
+               (a + 1) + (a - 1) * cw + t, -2 * ((a - 1) + (a + 1) * cw), (a + 1) + (a - 1) * cw - t);
+}
+
+void biquad_high_shelf(biquad_t *f, float hz, float gain_db, float q, uint32_t rate) {
+    double a = pow(10, gain_db / 40);
+    double w0 = 2 * M_PI * hz / rate;
+    double cw = cos(w0);
+    double t = 2 * sqrt(a) * sin(w0) / (2 * q);
+    biquad_set(f, a * ((a + 1) + (a - 1) * cw + t), -2 * a * ((a - 1) + (a + 1) * cw), a * ((a + 1) + (a - 1) * cw - t),
+               (a + 1) - (a - 1) * cw + t, 2 * ((a - 1) - (a + 1) * cw), (a + 1) - (a - 1) * cw - t);
+}
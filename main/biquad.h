@@ -0,0 +1,53 @@
+/*
+ * Fixed-point biquad sections shared by the compressor, loudness
+ * compensation and other filters in the playback path.
+ *
+ * Direct form I with Q28 coefficients (so shelf and peaking gains up to
+ * +18 dB fit), a 64-bit accumulator and first-order error feedback, which
+ * keeps low-frequency sections quiet at 44.1 kHz. Samples are int32 with
+ * headroom chosen by the caller; 16-bit PCM shifted up by 12 bits is safe
+ * for any stable section with moderate gain.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define BIQUAD_COEF_BITS    28
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+} biquad_t;
+
+typedef struct {
+    int32_t x1, x2, y1, y2;
+    int32_t err;
+} biquad_state_t;
+
+// Normalizes by a0 and quantizes; the coefficients use the RBJ cookbook's
+// sign convention (y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2, all over a0).
+void biquad_set(biquad_t *f, double b0, double b1, double b2, double a0, double a1, double a2);
+
+// Second-order low-pass and all-pass at hz with quality q.
+void biquad_lowpass(biquad_t *f, float hz, float q, uint32_t rate);
+void biquad_allpass(biquad_t *f, float hz, float q, uint32_t rate);
+
+// Peaking and shelving sections with gain_db at or beyond hz. A shelf's q
+// of 1/sqrt(2) gives the steepest slope without overshoot.
+void biquad_peak(biquad_t *f, float hz, float gain_db, float q, uint32_t rate);
+void biquad_low_shelf(biquad_t *f, float hz, float gain_db, float q, uint32_t rate);
+void biquad_high_shelf(biquad_t *f, float hz, float gain_db, float q, uint32_t rate);
+
+static inline int32_t biquad_process(const biquad_t *f, biquad_state_t *s, int32_t x) {
+    int64_t acc = (int64_t)f->b0 * x + (int64_t)f->b1 * s->x1 + (int64_t)f->b2 * s->x2 -
+                  (int64_t)f->a1 * s->y1 - (int64_t)f->a2 * s->y2 + s->err;
+    int32_t y = (int32_t)(acc >> BIQUAD_COEF_BITS);
+    s->err = (int32_t)(acc - (int64_t)y * (1 << BIQUAD_COEF_BITS));
+    s->x2 = s->x1;
+    s->x1 = x;
+    s->y2 = s->y1;
+    s->y1 = y;
+    return y;
+}
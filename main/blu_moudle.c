@@ -7,12 +7,14 @@
  * FRAMEWORK: ESP-IDF
  */
 
+#include <stdatomic.h>
 #include <string.h>
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/stream_buffer.h" 
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "esp_wifi.h"
@@ -27,12 +29,48 @@
 #include "esp_gap_bt_api.h"
 #include "esp_a2dp_api.h"
 #include "esp_avrc_api.h"
+#include "esp_timer.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "catchup.h"
+#include "catchup_bench.h"
+#include "control_channel.h"
+#include "delay_report.h"
+#include "ingest.h"
+#include "a2d_cadence.h"
+#include "asset_bench.h"
+#include "asset_player.h"
+#include "comp_bench.h"
+#include "conv_bench.h"
+#include "downmix_bench.h"
+#include "dsp_bench.h"
+#include "float_bench.h"
+#include "dynamics.h"
+#include "headphone_presets.h"
+#include "ir_filter.h"
+#include "log_ring.h"
+#include "link_bench.h"
+#include "loud_bench.h"
+#include "loudness.h"
+#include "output_tap.h"
+#include "overflow.h"
+#include "play_queue.h"
+#include "reverse_bridge.h"
+#include "sbc_bench.h"
+#include "secure_link.h"
+#include "soak_monitor.h"
+#include "spectrum_bench.h"
+#include "spectrum_monitor.h"
+#include "telemetry.h"
+#include "test_signal.h"
+#include "volume.h"
 
 // --- Globals & Definitions ---
 static const char *TAG = "AUDIO_BRIDGE_TUI";
 
 // State machine for the setup process
 typedef enum {
+    APP_STATE_MODE_SELECTION,
     APP_STATE_INIT,
     APP_STATE_BT_DISCOVERY,
     APP_STATE_BT_DEVICE_SELECTION,
@@ -44,7 +82,8 @@ typedef enum {
     APP_STATE_RUNNING
 } app_state_t;
 
-static app_state_t s_app_state = APP_STATE_INIT;
+static app_state_t s_app_state = APP_STATE_MODE_SELECTION;
+static bool s_reverse = false;      // Phone -> Bluetooth -> network instead of network -> Bluetooth
 
 // For storing discovered devices
 #define MAX_DISCOVERED_DEVICES 20
@@ -64,9 +103,12 @@ static EventGroupHandle_t s_app_event_group;
 
 // --- Audio Streaming Components ---
 #define TCP_PORT              8080
-#define STREAM_BUFFER_SIZE    (16 * 1024)
+#define SEND_STALL_MS         50      // Producer waits longer than this mean the consumer stalled
 static StreamBufferHandle_t s_audio_stream_buffer; // MODIFIED: Changed from RingbufHandle_t
 static int client_socket = -1;
+static _Atomic audio_source_t s_audio_source = AUDIO_SOURCE_NETWORK;
+// A stream buffer allows one writer at a time; producers take turns through this.
+static SemaphoreHandle_t s_audio_write_lock;
 
 // --- Function Prototypes ---
 void app_main(void);
@@ -76,7 +118,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
 static int32_t a2d_data_cb(uint8_t *data, int32_t len);
 static void bt_app_av_sm_hdlr(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
 static void bt_app_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param);
-static void get_user_input(char* buffer, int len);
+static void forward_bridge_start(void);
 static char* get_bt_device_name(esp_bt_gap_cb_param_t *param);
 
 
@@ -108,6 +150,21 @@ static void bt_app_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *pa
             }
             break;
         }
+        // A phone pairing with the reverse bridge asks to confirm a passkey
+        // there is no display to show.
+        case ESP_BT_GAP_CFM_REQ_EVT: {
+            ESP_LOGI(TAG, "Accepting pairing, passkey %06lu.", (unsigned long)param->cfm_req.num_val);
+            esp_bt_gap_ssp_confirm_reply(param->cfm_req.bda, true);
+            break;
+        }
+        case ESP_BT_GAP_AUTH_CMPL_EVT: {
+            if (param->auth_cmpl.stat == ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGI(TAG, "Paired with %s.", param->auth_cmpl.device_name);
+            } else {
+                ESP_LOGW(TAG, "Pairing failed, status %d.", param->auth_cmpl.stat);
+            }
+            break;
+        }
         default:
             break;
     }
@@ -120,20 +177,27 @@ static void bt_app_av_sm_hdlr(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *para
         case ESP_A2D_CONNECTION_STATE_EVT: {
             if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
                 ESP_LOGI(TAG, "A2DP connected.");
+                headphone_presets_connected(param->conn_stat.remote_bda);
                 xEventGroupSetBits(s_app_event_group, BT_CONNECTED_BIT);
                 esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_START);
             } else if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
                 ESP_LOGW(TAG, "A2DP disconnected. Please restart the device to reconnect.");
                 xEventGroupClearBits(s_app_event_group, BT_CONNECTED_BIT);
+                delay_report_sink_lost();
             }
             break;
         }
         case ESP_A2D_AUDIO_STATE_EVT: {
             if (param->audio_stat.state == ESP_A2D_AUDIO_STATE_STARTED) {
                 ESP_LOGI(TAG, "A2DP audio streaming started.");
+                asset_player_play(ASSET_STARTUP_NAME, 0);
             }
             break;
         }
+        case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT: {
+            delay_report_sink_reported(param->a2d_report_delay_value_stat.delay_value);
+            break;
+        }
         default:
             break;
     }
@@ -160,6 +224,28 @@ void setup_task(void *pvParameters) {
 
     while (1) {
         switch (s_app_state) {
+            case APP_STATE_MODE_SELECTION:
+                printf("\n\n--- Mode ---\n");
+                printf("  1: Forward: Wi-Fi -> ESP32 -> Bluetooth headphones\n");
+                printf("  2: Reverse: phone -> Bluetooth -> ESP32 -> Wi-Fi (RTP)\n");
+                printf("Enter the mode: ");
+                console_get_line(input_buffer, sizeof(input_buffer));
+                choice = atoi(input_buffer);
+                if (choice == 1) {
+                    forward_bridge_start();
+                    s_app_state = APP_STATE_INIT;
+                } else if (choice == 2) {
+                    s_reverse = true;
+                    reverse_bridge_start();
+                    printf("\nPair your phone with ESP_A2DP_BRIDGE; it can connect at any time.\n");
+                    printf("\n--- Wi-Fi Setup ---\n");
+                    esp_wifi_scan_start(NULL, true);
+                    s_app_state = APP_STATE_WIFI_SCANNING;
+                } else {
+                    printf("Invalid choice. Please try again.\n");
+                }
+                break;
+
             case APP_STATE_INIT:
                 printf("\n\n--- Step 1: Bluetooth Setup ---\n");
                 s_bt_device_count = 0;
@@ -180,7 +266,7 @@ void setup_task(void *pvParameters) {
 
             case APP_STATE_BT_DEVICE_SELECTION:
                 printf("Enter the number of the device to connect to: ");
-                get_user_input(input_buffer, sizeof(input_buffer));
+                console_get_line(input_buffer, sizeof(input_buffer));
                 choice = atoi(input_buffer);
                 if (choice > 0 && choice <= s_bt_device_count) {
                     esp_a2d_source_connect(s_bt_devices[choice - 1].disc_res.bda);
@@ -212,7 +298,7 @@ void setup_task(void *pvParameters) {
 
             case APP_STATE_WIFI_NETWORK_SELECTION:
                 printf("Enter the number of the Wi-Fi network: ");
-                get_user_input(input_buffer, sizeof(input_buffer));
+                console_get_line(input_buffer, sizeof(input_buffer));
                 choice = atoi(input_buffer);
                 if (choice > 0 && choice <= s_wifi_ap_count) {
                     memset(&s_wifi_config, 0, sizeof(wifi_config_t));
@@ -225,7 +311,7 @@ void setup_task(void *pvParameters) {
             
             case APP_STATE_WIFI_PASSWORD_INPUT:
                 printf("Enter password for %s: ", s_wifi_config.sta.ssid);
-                get_user_input((char *)s_wifi_config.sta.password, sizeof(s_wifi_config.sta.password));
+                console_get_line((char *)s_wifi_config.sta.password, sizeof(s_wifi_config.sta.password));
                 
                 esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
                 esp_wifi_connect();
@@ -238,6 +324,14 @@ void setup_task(void *pvParameters) {
                 printf("\n--- Setup Complete! ---\n");
                 printf("Audio bridge is now active. Connect your app to the ESP32.\n");
 
+                // Up first: the audio session reports refused streams through it.
+                control_channel_start();
+                if (s_reverse) {
+                    printf("Forward the phone's audio with: rtp <receiver IP> [port]\n");
+                    s_app_state = APP_STATE_RUNNING;
+                    break;
+                }
+
                 // MODIFIED: The task is now created with higher priority and pinned to Core 1
                 xTaskCreatePinnedToCore(
                     tcp_server_task,    // Function to implement the task
@@ -248,18 +342,31 @@ void setup_task(void *pvParameters) {
                     NULL,               // Task handle
                     1                   // Core where the task should run (APP_CPU_NUM)
                 );
+                delay_report_start();
+                play_queue_start();
+                soak_monitor_start();
 
                 s_app_state = APP_STATE_RUNNING;
                 break;
 
             case APP_STATE_RUNNING:
-                // This task is no longer needed, so it deletes itself.
-                vTaskDelete(NULL);
+                // The serial monitor now belongs to the command console.
+                console_run();
                 break;
         }
         vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
+// A2DP takes one role at a time, so the source is only set up once forward
+// mode is chosen.
+static void forward_bridge_start(void) {
+    volume_init();
+    ESP_ERROR_CHECK(esp_a2d_register_callback(bt_app_av_sm_hdlr));
+    ESP_ERROR_CHECK(esp_a2d_source_init());
+    ESP_ERROR_CHECK(esp_a2d_source_register_data_callback(a2d_data_cb));
+    delay_report_init();
+}
+
 // --- Main Entry Point ---
 void app_main(void) {
     esp_err_t ret = nvs_flash_init();
@@ -270,9 +377,38 @@ void app_main(void) {
     ESP_ERROR_CHECK(ret);
 
     s_app_event_group = xEventGroupCreate();
+    log_ring_init();
+    output_tap_init();
+    spectrum_monitor_init();
+    a2d_cadence_init();
+    test_signal_init();
+    ingest_init();
+    overflow_init();
+    sbc_bench_init();
+    downmix_bench_init();
+    ir_filter_init();
+    conv_bench_init();
+    dynamics_init();
+    comp_bench_init();
+    loudness_init();
+    loud_bench_init();
+    headphone_presets_init();
+    spectrum_bench_init();
+    catchup_init();
+    catchup_bench_init();
+    reverse_bridge_init();
+    asset_player_init();
+    asset_bench_init();
+    play_queue_init();
+    secure_link_init();
+    link_bench_init();
+    dsp_bench_init();
+    float_bench_init();
+    telemetry_init();
     // MODIFIED: Create a Stream Buffer instead of a Ring Buffer.
     // The second argument '1' is the trigger level.
     s_audio_stream_buffer = xStreamBufferCreate(STREAM_BUFFER_SIZE, 1);
+    s_audio_write_lock = xSemaphoreCreateMutex();
 
     // --- Wi-Fi Init ---
     ESP_ERROR_CHECK(esp_netif_init());
@@ -292,30 +428,10 @@ void app_main(void) {
     ESP_ERROR_CHECK(esp_bluedroid_init());
     ESP_ERROR_CHECK(esp_bluedroid_enable());
     ESP_ERROR_CHECK(esp_bt_gap_register_callback(bt_app_gap_cb));
-    ESP_ERROR_CHECK(esp_a2d_register_callback(bt_app_av_sm_hdlr));
-    ESP_ERROR_CHECK(esp_a2d_source_init());
-    ESP_ERROR_CHECK(esp_a2d_source_register_data_callback(a2d_data_cb));
     esp_bt_dev_set_device_name("ESP_A2DP_BRIDGE");
 
-    xTaskCreate(setup_task, "setup_task", 4096, NULL, 5, NULL);
-}
-
-// --- Helper function to get user input from serial monitor ---
-static void get_user_input(char* buffer, int len) {
-    memset(buffer, 0, len);
-    int i = 0;
-    while (i < len - 1) {
-        int c = fgetc(stdin);
-        if (c >= 0) {
-            if (c == '\n' || c == '\r') {
-                break;
-            }
-            buffer[i++] = c;
-            printf("%c", c);
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-    printf("\n");
+    // Pinned so console benchmarks read one core's cycle counter throughout.
+    xTaskCreatePinnedToCore(setup_task, "setup_task", 4096, NULL, 5, NULL, 1);
 }
 
 // --- Helper function to safely get a device's name ---
@@ -332,28 +448,178 @@ static char* get_bt_device_name(esp_bt_gap_cb_param_t *param) {
 
 // --- Audio Streaming Code ---
 
+// Current run of short reads, logged through the binary ring when it ends.
+static uint32_t s_underrun_calls = 0;
+static uint32_t s_underrun_bytes = 0;
+static volatile uint32_t s_missing_bytes = 0;   // Every run, for audio_bridge_missing_bytes()
+
+// Bytes that have passed through the playback buffer each way (both wrap).
+// audio_bridge_flush() marks how much had been written when it was called,
+// and a2d_data_cb discards up to the mark.
+static uint32_t s_written_bytes = 0;            // Under s_audio_write_lock
+static uint32_t s_read_bytes = 0;               // a2d_data_cb only
+static volatile uint32_t s_flush_to = 0;
+
+// Reads for overflow_trim(); a2d_data_cb is the buffer's only reader.
+static size_t playback_read(void *buf, size_t n, void *ctx) {
+    size_t got = xStreamBufferReceive(s_audio_stream_buffer, buf, n, 0);
+    s_read_bytes += got;
+    return got;
+}
+
 // MODIFIED: This is the new, safe data callback function
 static int32_t a2d_data_cb(uint8_t *data, int32_t len) {
     if (len < 0 || data == NULL) {
         return 0;
     }
+    a2d_cadence_record(len);
+
+    // Audio from before a seek, queued but stale now.
+    int32_t stale = (int32_t)(s_flush_to - s_read_bytes);
+    while (stale > 0 && playback_read(data, stale < len ? stale : len, NULL) > 0) {
+        stale = (int32_t)(s_flush_to - s_read_bytes);
+    }
 
     // Read the exact number of bytes the BT stack is asking for ('len')
     // We use a small timeout so it doesn't wait forever if the network is slow.
     size_t bytes_read = xStreamBufferReceive(s_audio_stream_buffer, data, len, pdMS_TO_TICKS(20));
+    s_read_bytes += bytes_read;
 
     // If we received less data than requested (i.e., the buffer was partially empty),
     // fill the rest of the audio buffer with silence (zeros).
     if (bytes_read < len) {
         memset(data + bytes_read, 0, len - bytes_read);
+        if (client_socket >= 0 || s_audio_source != AUDIO_SOURCE_NETWORK) {
+            soak_monitor_note_underrun(len - bytes_read);
+            if (s_underrun_calls == 0) {
+                log_ring_write(LR_A2D_UNDERRUN_BEGIN, bytes_read, len, 0);
+            }
+            s_underrun_calls++;
+            s_underrun_bytes += len - bytes_read;
+            s_missing_bytes += len - bytes_read;
+        }
+    } else if (s_underrun_calls > 0) {
+        log_ring_write(LR_A2D_UNDERRUN_END, s_underrun_calls, s_underrun_bytes, 0);
+        s_underrun_calls = 0;
+        s_underrun_bytes = 0;
     }
+    if (bytes_read == len && s_audio_source == AUDIO_SOURCE_NETWORK) {
+        overflow_trim(data, len, xStreamBufferBytesAvailable(s_audio_stream_buffer), playback_read, NULL);
+    }
+
+    asset_player_mix(data, len);
+    output_tap_write(data, len);
+    spectrum_monitor_write(data, len);
 
     // The A2DP stack needs to be told that we have filled its entire buffer.
     // So, we always return the originally requested length ('len').
     return len;
 }
 
+bool audio_bridge_claim(audio_source_t source) {
+    audio_source_t owner = AUDIO_SOURCE_NETWORK;
+    return atomic_compare_exchange_strong(&s_audio_source, &owner, source) || owner == source;
+}
+
+void audio_bridge_release(audio_source_t source) {
+    audio_source_t owner = source;
+    atomic_compare_exchange_strong(&s_audio_source, &owner, AUDIO_SOURCE_NETWORK);
+}
+
+static size_t playback_send(const void *data, size_t len, void *ctx) {
+    size_t sent = xStreamBufferSend(s_audio_stream_buffer, data, len, *(TickType_t *)ctx);
+    s_written_bytes += sent;
+    return sent;
+}
+
+// Catch-up goes last so the fill it steers on is the buffer it feeds.
+static size_t catchup_send(const void *data, size_t len, void *ctx) {
+    return catchup_write(data, len, playback_send, ctx);
+}
+
+// Compressed audio gets loudness compensation, the IR filter and then the
+// headphones' preset, so correction sees the final levels and the preset's
+// limiter guards the output.
+static size_t presets_send(const void *data, size_t len, void *ctx) {
+    return headphone_presets_write(data, len, catchup_send, ctx);
+}
+
+static size_t ir_filter_send(const void *data, size_t len, void *ctx) {
+    return ir_filter_write(data, len, presets_send, ctx);
+}
+
+static size_t loudness_send(const void *data, size_t len, void *ctx) {
+    return loudness_write(data, len, ir_filter_send, ctx);
+}
+
+static void reset_filters(void) {
+    dynamics_reset();
+    loudness_reset();
+    ir_filter_reset();
+    headphone_presets_reset();
+    catchup_reset();
+}
+
+size_t audio_bridge_write(audio_source_t source, const void *data, size_t len, TickType_t wait) {
+    static audio_source_t s_last_writer = AUDIO_SOURCE_NETWORK;
+    size_t sent = len;
+    xSemaphoreTake(s_audio_write_lock, portMAX_DELAY);
+    if (source == s_audio_source) {
+        if (source != s_last_writer) {
+            // The filters' history belongs to the previous producer's audio.
+            reset_filters();
+            s_last_writer = source;
+        }
+        sent = dynamics_write(data, len, loudness_send, &wait);
+    }
+    xSemaphoreGive(s_audio_write_lock);
+    return sent;
+}
+
+void audio_bridge_flush(audio_source_t source) {
+    xSemaphoreTake(s_audio_write_lock, portMAX_DELAY);
+    if (source == s_audio_source) {
+        // Whatever the filters hold goes too, so nothing stale follows.
+        reset_filters();
+        s_flush_to = s_written_bytes;
+    }
+    xSemaphoreGive(s_audio_write_lock);
+}
+
+size_t audio_bridge_buffered_bytes(void) {
+    return xStreamBufferBytesAvailable(s_audio_stream_buffer);
+}
+
+uint32_t audio_bridge_missing_bytes(void) {
+    return s_missing_bytes;
+}
+
+bool audio_bridge_client_connected(void) {
+    return client_socket >= 0;
+}
+
+void audio_bridge_kick_client(void) {
+    int sock = client_socket;
+    if (sock >= 0) {
+        // recv() in tcp_server_task returns 0 and the normal disconnect path runs.
+        shutdown(sock, SHUT_RDWR);
+    }
+}
+
+// Decoded or passed-through PCM from the current TCP session.
+static void network_pcm_sink(const int16_t *pcm, size_t frames, void *ctx) {
+    size_t len = frames * AUDIO_BYTES_PER_FRAME;
+    int64_t send_start = esp_timer_get_time();
+    audio_bridge_write(AUDIO_SOURCE_NETWORK, pcm, len, portMAX_DELAY);
+    int32_t blocked_ms = (esp_timer_get_time() - send_start) / 1000;
+    if (blocked_ms >= SEND_STALL_MS) {
+        log_ring_write(LR_TCP_SEND_STALL, blocked_ms, len, audio_bridge_buffered_bytes());
+    }
+}
+
 void tcp_server_task(void *pvParameters) {
+    static ingest_t s_ingest;   // Kept off the task stack
+    static secure_link_t s_link;
     char addr_str[128];
     int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
     struct sockaddr_in dest_addr;
@@ -375,21 +641,30 @@ void tcp_server_task(void *pvParameters) {
         inet_ntoa_r(source_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
         ESP_LOGI(TAG, "Accepted connection from %s", addr_str);
         
-        uint8_t rx_buffer[1024];
         int len;
+        ingest_begin(&s_ingest, network_pcm_sink, NULL);
+        secure_link_begin(&s_link, client_socket, &s_ingest);
+        overflow_session_begin();
+        catchup_session_begin();
         do {
-            len = recv(client_socket, rx_buffer, sizeof(rx_buffer), 0);
-            if (len > 0) {
-                // MODIFIED: Send data to the stream buffer
-                xStreamBufferSend(s_audio_stream_buffer, rx_buffer, len, portMAX_DELAY);
+            size_t room;
+            uint8_t *rx = secure_link_rx_buffer(&s_link, &room);
+            len = recv(client_socket, rx, room, 0);
+            if (len > 0 && !secure_link_received(&s_link, len)) {
+                // The sender was told why over the control channel.
+                break;
             }
         } while (len > 0);
+        secure_link_end(&s_link);
+        ingest_end(&s_ingest);
+        overflow_session_end();
 
         ESP_LOGI(TAG, "Client disconnected.");
         shutdown(client_socket, 0);
         close(client_socket);
         client_socket = -1;
+        soak_monitor_note_session_end();
     }
     close(listen_sock);
     vTaskDelete(NULL);
-}
\ No newline at end of file
+}
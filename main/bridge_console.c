@@ -0,0 +1,170 @@
+/*
+ * Serial console
+ *
+ * The setup TUI used to delete its task once Wi-Fi was up. It now hands the
+ * serial monitor over to this small command loop so the running bridge can be
+ * inspected and driven without reflashing.
+ */
+
+#include "bridge_console.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define CONSOLE_MAX_COMMANDS    24
+#define CONSOLE_MAX_BENCHES     16
+#define CONSOLE_MAX_ARGS        8
+#define CONSOLE_LINE_MAX        128
+#define CONSOLE_OUT_MAX         256
+
+typedef struct {
+    const char *name;
+    const char *help;
+    console_cmd_fn_t fn;
+} console_cmd_t;
+
+typedef struct {
+    const char *name;
+    console_bench_fn_t fn;
+} console_bench_t;
+
+static console_cmd_t s_commands[CONSOLE_MAX_COMMANDS];
+static int s_command_count = 0;
+static console_bench_t s_benches[CONSOLE_MAX_BENCHES];
+static int s_bench_count = 0;
+
+// Output redirection is per task so serial and network commands can run at once.
+static __thread console_out_fn_t s_out = NULL;
+static __thread void *s_out_ctx = NULL;
+
+int console_register(const char *name, const char *help, console_cmd_fn_t fn) {
+    if (s_command_count >= CONSOLE_MAX_COMMANDS) {
+        return -1;
+    }
+    s_commands[s_command_count++] = (console_cmd_t){ .name = name, .help = help, .fn = fn };
+    return 0;
+}
+
+int console_register_bench(const char *name, console_bench_fn_t fn) {
+    if (s_bench_count >= CONSOLE_MAX_BENCHES) {
+        return -1;
+    }
+    s_benches[s_bench_count++] = (console_bench_t){ .name = name, .fn = fn };
+    return 0;
+}
+
+void console_printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (s_out != NULL) {
+        char text[CONSOLE_OUT_MAX];
+        vsnprintf(text, sizeof(text), fmt, args);
+        s_out(text, s_out_ctx);
+    } else {
+        vprintf(fmt, args);
+    }
+    va_end(args);
+}
+
+void console_get_line(char *buffer, int len) {
+    memset(buffer, 0, len);
+    int i = 0;
+    while (i < len - 1) {
+        int c = fgetc(stdin);
+        if (c >= 0) {
+            if (c == '\n' || c == '\r') {
+                break;
+            }
+            buffer[i++] = c;
+            printf("%c", c);
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    printf("\n");
+}
+
+// --- Built-in Commands ---
+static int cmd_help(int argc, char **argv) {
+    for (int i = 0; i < s_command_count; i++) {
+        console_printf("  %-10s %s\n", s_commands[i].name, s_commands[i].help);
+    }
+    return 0;
+}
+
+static int cmd_bench(int argc, char **argv) {
+    if (argc < 2) {
+        console_printf("Usage: bench <name|all>. Available:");
+        for (int i = 0; i < s_bench_count; i++) {
+            console_printf(" %s", s_benches[i].name);
+        }
+        console_printf("\n");
+        return 0;
+    }
+    bool all = strcmp(argv[1], "all") == 0;
+    bool found = false;
+    for (int i = 0; i < s_bench_count; i++) {
+        if (all || strcmp(argv[1], s_benches[i].name) == 0) {
+            console_printf("--- bench %s ---\n", s_benches[i].name);
+            s_benches[i].fn();
+            found = true;
+        }
+    }
+    if (!found) {
+        console_printf("Unknown benchmark '%s'\n", argv[1]);
+        return -1;
+    }
+    return 0;
+}
+
+int console_exec(char *line) {
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(line, " \t", &save); tok && argc < CONSOLE_MAX_ARGS;
+         tok = strtok_r(NULL, " \t", &save)) {
+        argv[argc++] = tok;
+    }
+    if (argc == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < s_command_count; i++) {
+        if (strcmp(argv[0], s_commands[i].name) == 0) {
+            return s_commands[i].fn(argc, argv);
+        }
+    }
+    console_printf("Unknown command '%s'. Type 'help'.\n", argv[0]);
+    return -1;
+}
+
+int console_exec_to(char *line, console_out_fn_t out, void *ctx) {
+    s_out = out;
+    s_out_ctx = ctx;
+    int ret = console_exec(line);
+    s_out = NULL;
+    s_out_ctx = NULL;
+    return ret;
+}
+
+bool console_is_remote(void) {
+    return s_out != NULL;
+}
+
+void console_run(void) {
+    char line[CONSOLE_LINE_MAX];
+
+    console_register("help", "List commands", cmd_help);
+    console_register("bench", "Run a benchmark: bench <name|all>", cmd_bench);
+
+    printf("Type 'help' for a list of commands.\n");
+    while (1) {
+        printf("> ");
+        fflush(stdout);
+        console_get_line(line, sizeof(line));
+        console_exec(line);
+    }
+}
@@ -0,0 +1,37 @@
+/*
+ * Serial console: line input for the setup TUI and the command loop that
+ * takes over once the bridge is running.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef int (*console_cmd_fn_t)(int argc, char **argv);
+typedef void (*console_bench_fn_t)(void);
+typedef void (*console_out_fn_t)(const char *text, void *ctx);
+
+// Registers a command; call before console_run(). Returns 0 on success.
+int console_register(const char *name, const char *help, console_cmd_fn_t fn);
+
+// Registers a benchmark reachable as "bench <name>".
+int console_register_bench(const char *name, console_bench_fn_t fn);
+
+// Reads one line from the serial monitor, echoing it back.
+void console_get_line(char *buffer, int len);
+
+// Tokenizes and runs one command line in place. Returns the command's result.
+int console_exec(char *line);
+
+// Like console_exec(), but console_printf() output from this task goes to out.
+int console_exec_to(char *line, console_out_fn_t out, void *ctx);
+
+// True while a command runs for a console_exec_to() caller, such as the
+// control channel, rather than the serial monitor.
+bool console_is_remote(void);
+
+// Prints command output to the serial monitor or the caller of console_exec_to().
+void console_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Reads and executes commands forever.
+void console_run(void);
@@ -0,0 +1,284 @@
+/*
+ * Latency catch-up stage
+ *
+ * Sits last in the playback chain, so the fill it steers on is the buffer
+ * it feeds. The fill is averaged over CATCHUP_SMOOTH_MS to ride over the
+ * bursts of a2d_data_cb and of the sender. Above target + CATCHUP_ENTER_MS
+ * playback speeds up in proportion to the excess, reaching CATCHUP_MAX_PCT
+ * CATCHUP_FULL_MS above target and never going below 1% while catching up,
+ * and returns to normal speed once the fill is down to the target. Below
+ * half the target it slows down the same way until the fill has recovered.
+ *
+ * Only a sender paced to real time is ever caught up with. One that is not
+ * (a file pushed as fast as the socket takes it) keeps the buffer full
+ * whatever the speed, and speeding it up would only play it fast. So the
+ * rate audio arrives at is measured over CATCHUP_PACE_WINDOW_MS windows
+ * while the buffer has room, so playback is not what sets it, and
+ * catch-up is allowed once a window comes within CATCHUP_PACE_TOLERANCE_PCT
+ * of real time. An unpaced sender fills the buffer within a fraction of a
+ * second and never completes a window; stalls and the bursts after them
+ * neither prove nor disprove anything. Each new sender, and each change of
+ * producer, starts out unproven, so one that falls behind before its first
+ * window completes keeps that backlog until the buffer next has room. Catching up for CATCHUP_GIVE_UP_S without
+ * reaching the target still drops the proof, for a sender that was paced
+ * and then was not.
+ *
+ * Like the other stages, audio is processed under s_lock in chunks and
+ * passed to the sink after the lock is released.
+ */
+
+#include "catchup.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bridge_console.h"
+#include "telemetry.h"
+#include "wsola.h"
+
+#define CATCHUP_CHUNK_FRAMES    256
+#define CATCHUP_BLOCK_FRAMES    (2 * WSOLA_HOP)
+#define CATCHUP_SMOOTH_MS       100
+#define CATCHUP_ENTER_MS        10
+#define CATCHUP_FULL_MS         20
+#define CATCHUP_GIVE_UP_S       30
+#define CATCHUP_PACE_WINDOW_MS  2000
+#define CATCHUP_PACE_TOLERANCE_PCT  3
+#define CATCHUP_PACE_HEADROOM   (STREAM_BUFFER_SIZE / 8)    // Fill above the rest means the writer may be held back
+
+static const char *TAG = "CATCHUP";
+
+typedef enum {
+    CATCHUP_NORMAL,
+    CATCHUP_FASTER,
+    CATCHUP_SLOWER,
+} catchup_mode_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+
+// Under s_lock.
+static wsola_t s_wsola;
+static bool s_enabled = true;
+static int s_target_ms = CATCHUP_DEFAULT_TARGET_MS;
+static catchup_mode_t s_mode = CATCHUP_NORMAL;
+static float s_fill_ms = -1;                // Averaged; negative until the first write
+static int64_t s_fill_us = 0;               // When it was last updated
+static int64_t s_faster_since_us = 0;
+static bool s_paced = false;                // The sender was seen arriving at real time
+static int64_t s_pace_start_us = 0;         // Current measuring window; 0 if none
+static uint32_t s_pace_frames = 0;          // Frames arrived in it
+static uint32_t s_corrections = 0;          // Times a speed change started
+static uint32_t s_give_ups = 0;
+
+// Writer only.
+static int16_t s_block[CATCHUP_BLOCK_FRAMES * AUDIO_CHANNELS];
+
+// Written by the writer, read by telemetry.
+static volatile uint32_t s_busy_us = 0;
+
+static uint32_t s_reported_busy_us = 0;
+static int64_t s_reported_us = 0;
+
+// --- Speed control ---
+// Speed change as a fraction, for the averaged fill being err_ms away
+// from the target.
+static float correction(float err_ms) {
+    float f = fabsf(err_ms) / CATCHUP_FULL_MS * CATCHUP_MAX_PCT;
+    f = f < 1 ? 1 : (f > CATCHUP_MAX_PCT ? CATCHUP_MAX_PCT : f);
+    return f / 100;
+}
+
+// Under s_lock.
+static void steer(void) {
+    int64_t now = esp_timer_get_time();
+    float fill_ms = audio_bridge_buffered_bytes() * 1000.0f / AUDIO_BYTES_PER_SEC;
+    if (s_fill_ms < 0) {
+        s_fill_ms = fill_ms;
+    } else {
+        float dt_ms = (now - s_fill_us) / 1000.0f;
+        s_fill_ms += (fill_ms - s_fill_ms) * dt_ms / (CATCHUP_SMOOTH_MS + dt_ms);
+    }
+    s_fill_us = now;
+
+    float err = s_fill_ms - s_target_ms;
+    catchup_mode_t mode = s_mode;
+    if (!s_enabled) {
+        mode = CATCHUP_NORMAL;
+    } else if (mode == CATCHUP_FASTER && err <= 0) {
+        mode = CATCHUP_NORMAL;
+    } else if (mode == CATCHUP_SLOWER && err >= 0) {
+        mode = CATCHUP_NORMAL;
+    } else if (mode == CATCHUP_NORMAL && err > CATCHUP_ENTER_MS && s_paced) {
+        mode = CATCHUP_FASTER;
+        s_faster_since_us = now;
+    } else if (mode == CATCHUP_NORMAL && s_fill_ms < s_target_ms / 2.0f) {
+        mode = CATCHUP_SLOWER;
+    }
+    if (mode == CATCHUP_FASTER && now - s_faster_since_us > CATCHUP_GIVE_UP_S * 1000000LL) {
+        ESP_LOGW(TAG, "Buffer still %.0f ms over target after %d s; sender is not paced, staying at normal speed",
+                 err, CATCHUP_GIVE_UP_S);
+        mode = CATCHUP_NORMAL;
+        s_paced = false;
+        s_pace_start_us = 0;
+        s_give_ups++;
+    }
+    if (mode != s_mode && mode != CATCHUP_NORMAL) {
+        s_corrections++;
+    }
+    s_mode = mode;
+
+    float speed = 1;
+    if (mode == CATCHUP_FASTER) {
+        speed += correction(err);
+    } else if (mode == CATCHUP_SLOWER) {
+        speed -= correction(err);
+    }
+    wsola_set_speed(&s_wsola, (int32_t)lrintf(speed * WSOLA_SPEED_ONE));
+}
+
+// Under s_lock. Counts frames that arrived, and at the end of a window
+// checks their rate against real time. A window is abandoned whenever the
+// buffer is nearly full.
+static void pace(size_t frames) {
+    int64_t now = esp_timer_get_time();
+    if (audio_bridge_buffered_bytes() > STREAM_BUFFER_SIZE - CATCHUP_PACE_HEADROOM) {
+        s_pace_start_us = 0;
+        return;
+    }
+    if (s_pace_start_us == 0) {
+        // These frames arrived before the window; it counts the ones after.
+        s_pace_start_us = now;
+        s_pace_frames = 0;
+        return;
+    }
+    s_pace_frames += frames;
+    int64_t span_us = now - s_pace_start_us;
+    if (span_us >= CATCHUP_PACE_WINDOW_MS * 1000LL) {
+        float rate = s_pace_frames * 1e6f / span_us / AUDIO_SAMPLE_RATE;
+        if (!s_paced && fabsf(rate - 1) * 100 <= CATCHUP_PACE_TOLERANCE_PCT) {
+            ESP_LOGI(TAG, "Sender is paced (%.1f%% of real time)", rate * 100);
+            s_paced = true;
+        }
+        s_pace_start_us = now;
+        s_pace_frames = 0;
+    }
+}
+
+// --- Audio path ---
+size_t catchup_write(const void *data, size_t len, audio_sink_t sink, void *ctx) {
+    const int16_t *pcm = data;
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+    size_t sent = 0;
+
+    while (frames > 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        steer();
+        int64_t start = esp_timer_get_time();
+        size_t taken = wsola_write(&s_wsola, pcm, frames < CATCHUP_CHUNK_FRAMES ? frames : CATCHUP_CHUNK_FRAMES);
+        pace(taken);
+        size_t made = wsola_read(&s_wsola, s_block, CATCHUP_BLOCK_FRAMES);
+        s_busy_us += esp_timer_get_time() - start;
+        xSemaphoreGive(s_lock);
+
+        if (made > 0) {
+            size_t bytes = made * AUDIO_BYTES_PER_FRAME;
+            if (sink(s_block, bytes, ctx) < bytes) {
+                return sent;
+            }
+        }
+        sent += taken * AUDIO_BYTES_PER_FRAME;
+        pcm += taken * AUDIO_CHANNELS;
+        frames -= taken;
+    }
+    return sent;
+}
+
+void catchup_reset(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    wsola_reset(&s_wsola);
+    s_mode = CATCHUP_NORMAL;
+    s_fill_ms = -1;
+    s_paced = false;
+    s_pace_start_us = 0;
+    xSemaphoreGive(s_lock);
+}
+
+void catchup_session_begin(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_paced = false;
+    s_pace_start_us = 0;
+    xSemaphoreGive(s_lock);
+}
+
+size_t catchup_latency_frames(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t frames = s_wsola.len - s_wsola.next;
+    xSemaphoreGive(s_lock);
+    return frames;
+}
+
+// --- Console and telemetry ---
+static int catchup_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    uint32_t busy_us = s_busy_us;
+    double span_us = s_reported_us ? now - s_reported_us : 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = snprintf(buf, len, "on=%d paced=%d speed=%+.1f%% fill=%.0f target=%d shed=%.0f corrections=%lu give_ups=%lu cpu=%.1f%%",
+                     s_enabled, s_paced, (s_wsola.speed - WSOLA_SPEED_ONE) * 100.0 / WSOLA_SPEED_ONE, s_fill_ms < 0 ? 0 : s_fill_ms,
+                     s_target_ms, (s_wsola.consumed - s_wsola.produced) * 1000.0 / AUDIO_SAMPLE_RATE,
+                     (unsigned long)s_corrections, (unsigned long)s_give_ups,
+                     span_us > 0 ? (busy_us - s_reported_busy_us) / span_us * 100 : 0.0);
+    xSemaphoreGive(s_lock);
+    s_reported_busy_us = busy_us;
+    s_reported_us = now;
+    return n;
+}
+
+static int cmd_catchup(int argc, char **argv) {
+    if (argc < 2) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        console_printf("catchup %s: target %d ms, buffer %.0f ms, speed %+.1f%%%s\n", s_enabled ? "on" : "off",
+                       s_target_ms, s_fill_ms < 0 ? 0 : s_fill_ms,
+                       (s_wsola.speed - WSOLA_SPEED_ONE) * 100.0 / WSOLA_SPEED_ONE,
+                       s_paced ? "" : " (sender not known to be paced; no speed-up)");
+        console_printf("  %.0f ms shed in total, %lu hops, %lu corrections, %lu given up\n",
+                       (s_wsola.consumed - s_wsola.produced) * 1000.0 / AUDIO_SAMPLE_RATE, (unsigned long)s_wsola.hops,
+                       (unsigned long)s_corrections, (unsigned long)s_give_ups);
+        xSemaphoreGive(s_lock);
+        console_printf("Usage: catchup on | off | target <ms>\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_enabled = argv[1][1] == 'n';
+        xSemaphoreGive(s_lock);
+        ESP_LOGI(TAG, "Latency catch-up %s", argv[1]);
+        return 0;
+    }
+
+    int max_ms = STREAM_BUFFER_SIZE * 1000 / AUDIO_BYTES_PER_SEC - CATCHUP_ENTER_MS;
+    int target = argc > 2 ? atoi(argv[2]) : 0;
+    if (strcmp(argv[1], "target") != 0 || target < 2 * CATCHUP_ENTER_MS || target > max_ms) {
+        console_printf("Expected on, off or target %d-%d ms\n", 2 * CATCHUP_ENTER_MS, max_ms);
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_target_ms = target;
+    xSemaphoreGive(s_lock);
+    return 0;
+}
+
+void catchup_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    wsola_init(&s_wsola);
+    console_register("catchup", "Time-stretch to hold the playback buffer at a target: catchup [on | off | target <ms>]",
+                     cmd_catchup);
+    telemetry_register("catchup", catchup_telemetry);
+}
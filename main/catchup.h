@@ -0,0 +1,37 @@
+/*
+ * Latency catch-up in the playback path: when the playback buffer holds
+ * more than the target (after a network stall the sender bursts and the
+ * backlog never drains by itself) audio plays up to CATCHUP_MAX_PCT faster,
+ * pitch unchanged, until the buffer is back at the target; when it runs low
+ * enough to risk an underrun, audio plays that much slower. Speeding up
+ * waits until the sender has been measured arriving at real time, so a
+ * stream pushed faster than that is never played fast. On by default
+ * ("catchup off" to disable); adds no latency while at normal speed.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "audio_bridge.h"
+
+#define CATCHUP_MAX_PCT             5
+#define CATCHUP_DEFAULT_TARGET_MS   40
+
+// Registers the "catchup" command and telemetry.
+void catchup_init(void);
+
+// Time-stretches len bytes of interleaved stereo as the playback buffer
+// fill calls for and hands the result to sink. Returns the input bytes
+// consumed; fewer than len only if sink accepted less than it was given.
+// One writer at a time.
+size_t catchup_write(const void *data, size_t len, audio_sink_t sink, void *ctx);
+
+// Input frames taken but not yet handed to sink.
+size_t catchup_latency_frames(void);
+
+// Drops buffered audio and returns to normal speed; call from the writer
+// when a different producer takes over.
+void catchup_reset(void);
+
+// Forgets that the sender was paced; call when a new TCP sender connects.
+void catchup_session_begin(void);
@@ -0,0 +1,72 @@
+/*
+ * Latency catch-up benchmark
+ *
+ * Feeds a second of noise through a wsola_t in 256-frame blocks, the size
+ * the stage hands it, timing each write and read on the cycle counter.
+ * While stretching, the cost is lumpy: most blocks only copy, and the one
+ * that completes a hop runs the search and crossfade, so the worst block
+ * is what bounds the writer's latency and the mean what bounds the CPU.
+ */
+
+#include "catchup_bench.h"
+
+#include <stdlib.h>
+#include "esp_cpu.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "catchup.h"
+#include "wsola.h"
+
+#define CATCHUP_BENCH_BLOCK     256
+#define CATCHUP_BENCH_FRAMES    AUDIO_SAMPLE_RATE
+
+static void fill_noise(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 4 - 8192;
+    }
+}
+
+static void catchup_bench(void) {
+    int16_t *in = malloc(CATCHUP_BENCH_FRAMES * AUDIO_BYTES_PER_FRAME);
+    int16_t *out = malloc(2 * WSOLA_HOP * AUDIO_BYTES_PER_FRAME);
+    wsola_t *w = malloc(sizeof(*w));
+    if (!in || !out || !w) {
+        console_printf("catchup: out of memory\n");
+        goto done;
+    }
+    fill_noise(in, CATCHUP_BENCH_FRAMES);
+
+    static const int pct[] = { 0, CATCHUP_MAX_PCT, -CATCHUP_MAX_PCT };
+    double mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    for (int p = 0; p < (int)(sizeof(pct) / sizeof(pct[0])); p++) {
+        wsola_init(w);
+        wsola_set_speed(w, WSOLA_SPEED_ONE + WSOLA_SPEED_ONE * pct[p] / 100);
+        uint32_t total = 0, worst = 0, blocks = 0;
+        size_t made = 0;
+        for (size_t pos = 0; pos + CATCHUP_BENCH_BLOCK <= CATCHUP_BENCH_FRAMES; pos += CATCHUP_BENCH_BLOCK) {
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            wsola_write(w, in + 2 * pos, CATCHUP_BENCH_BLOCK);
+            made += wsola_read(w, out, 2 * WSOLA_HOP);
+            uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+            total += cycles;
+            worst = cycles > worst ? cycles : worst;
+            blocks++;
+        }
+        double per_frame = (double)total / (made ? made : 1);
+        console_printf("speed %+d%%: %6lu cycles per block (worst %lu, %.0f us), %.1f per frame, %.1f%% cpu@%dMHz, %lu hops\n",
+                       pct[p], (unsigned long)(total / blocks), (unsigned long)worst, worst / mhz, per_frame,
+                       per_frame * AUDIO_SAMPLE_RATE / (mhz * 1e6) * 100, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+                       (unsigned long)w->hops);
+    }
+
+done:
+    free(in);
+    free(out);
+    free(w);
+}
+
+void catchup_bench_init(void) {
+    console_register_bench("catchup", catchup_bench);
+}
@@ -0,0 +1,10 @@
+/*
+ * Latency catch-up benchmark ("bench catchup"): cycles per 256-frame block
+ * through the time stretch at normal speed and at the largest speed-up and
+ * slow-down, the worst block (one that completes a hop) and the CPU share.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void catchup_bench_init(void);
@@ -0,0 +1,231 @@
+/*
+ * ChaCha20-Poly1305 AEAD (RFC 8439)
+ *
+ * Plain 32-bit code: ChaCha20 is adds, xors and rotates on 32-bit words,
+ * and Poly1305 keeps its accumulator in five 26-bit limbs so every product
+ * fits a 64-bit sum of 32x32 multiplies. Both suit the ESP32, which has no
+ * crypto extensions beyond the AES and SHA blocks.
+ */
+
+#include "chachapoly.h"
+
+#include <string.h>
+
+// --- Helpers ---
+static inline uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static inline void put_le64(uint8_t *p, uint64_t v) {
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint32_t rotl(uint32_t v, int n) {
+    return v << n | v >> (32 - n);
+}
+
+// --- ChaCha20 ---
+#define QUARTER(a, b, c, d) \
+    a += b; d = rotl(d ^ a, 16); c += d; b = rotl(b ^ c, 12); \
+    a += b; d = rotl(d ^ a, 8);  c += d; b = rotl(b ^ c, 7)
+
+static void chacha_init(uint32_t st[16], const uint8_t key[32], const uint8_t nonce[12]) {
+    st[0] = 0x61707865; st[1] = 0x3320646e; st[2] = 0x79622d32; st[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        st[4 + i] = le32(key + 4 * i);
+    }
+    st[12] = 0;
+    for (int i = 0; i < 3; i++) {
+        st[13 + i] = le32(nonce + 4 * i);
+    }
+}
+
+static void chacha_block(const uint32_t st[16], uint32_t out[16]) {
+    uint32_t x[16];
+    memcpy(x, st, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QUARTER(x[0], x[4], x[8],  x[12]);
+        QUARTER(x[1], x[5], x[9],  x[13]);
+        QUARTER(x[2], x[6], x[10], x[14]);
+        QUARTER(x[3], x[7], x[11], x[15]);
+        QUARTER(x[0], x[5], x[10], x[15]);
+        QUARTER(x[1], x[6], x[11], x[12]);
+        QUARTER(x[2], x[7], x[8],  x[13]);
+        QUARTER(x[3], x[4], x[9],  x[14]);
+    }
+    for (int i = 0; i < 16; i++) {
+        out[i] = x[i] + st[i];
+    }
+}
+
+// XORs the keystream from block counter 1 onwards into data.
+static void chacha_xor(uint32_t st[16], uint8_t *data, size_t len) {
+    uint32_t ks[16];
+    st[12] = 1;
+    while (len > 0) {
+        chacha_block(st, ks);
+        st[12]++;
+        size_t n = len < 64 ? len : 64;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            put_le32(data + i, le32(data + i) ^ ks[i / 4]);
+        }
+        for (; i < n; i++) {
+            data[i] ^= (uint8_t)(ks[i / 4] >> (8 * (i % 4)));
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+// --- Poly1305 ---
+typedef struct {
+    uint32_t r[5], s[4];    // s: r * 5 for limbs 1..4
+    uint32_t h[5];
+    uint32_t pad[4];
+} poly_t;
+
+static void poly_init(poly_t *p, const uint8_t key[32]) {
+    p->r[0] = le32(key + 0) & 0x3ffffff;
+    p->r[1] = (le32(key + 3) >> 2) & 0x3ffff03;
+    p->r[2] = (le32(key + 6) >> 4) & 0x3ffc0ff;
+    p->r[3] = (le32(key + 9) >> 6) & 0x3f03fff;
+    p->r[4] = (le32(key + 12) >> 8) & 0x00fffff;
+    for (int i = 0; i < 4; i++) {
+        p->s[i] = p->r[i + 1] * 5;
+        p->pad[i] = le32(key + 16 + 4 * i);
+    }
+    memset(p->h, 0, sizeof(p->h));
+}
+
+// Absorbs whole 16-byte blocks; hibit is 1 << 24 except for a padded tail.
+static void poly_blocks(poly_t *p, const uint8_t *m, size_t len, uint32_t hibit) {
+    const uint32_t r0 = p->r[0], r1 = p->r[1], r2 = p->r[2], r3 = p->r[3], r4 = p->r[4];
+    const uint32_t s1 = p->s[0], s2 = p->s[1], s3 = p->s[2], s4 = p->s[3];
+    uint32_t h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+
+    for (; len >= 16; m += 16, len -= 16) {
+        h0 += le32(m + 0) & 0x3ffffff;
+        h1 += (le32(m + 3) >> 2) & 0x3ffffff;
+        h2 += (le32(m + 6) >> 4) & 0x3ffffff;
+        h3 += (le32(m + 9) >> 6) & 0x3ffffff;
+        h4 += (le32(m + 12) >> 8) | hibit;
+
+        uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        uint32_t c;
+        c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+        d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+        d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+        d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+        d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+    }
+    p->h[0] = h0; p->h[1] = h1; p->h[2] = h2; p->h[3] = h3; p->h[4] = h4;
+}
+
+// Absorbs len bytes zero-padded to a 16-byte boundary, as the AEAD does.
+static void poly_padded(poly_t *p, const uint8_t *m, size_t len) {
+    size_t whole = len & ~(size_t)15;
+    poly_blocks(p, m, whole, 1u << 24);
+    if (len > whole) {
+        uint8_t block[16] = { 0 };
+        memcpy(block, m + whole, len - whole);
+        poly_blocks(p, block, 16, 1u << 24);
+    }
+}
+
+static void poly_finish(poly_t *p, uint8_t tag[16]) {
+    uint32_t h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+    uint32_t c;
+    c = h1 >> 26; h1 &= 0x3ffffff;
+    h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+    h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+    h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+    h1 += c;
+
+    // h - (2^130 - 5), kept only if it did not go negative
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1u << 26);
+    uint32_t mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    // Back to four 32-bit words, plus the pad mod 2^128
+    uint32_t w0 = h0 | h1 << 26;
+    uint32_t w1 = h1 >> 6 | h2 << 20;
+    uint32_t w2 = h2 >> 12 | h3 << 14;
+    uint32_t w3 = h3 >> 18 | h4 << 8;
+    uint64_t f;
+    f = (uint64_t)w0 + p->pad[0];             put_le32(tag + 0, (uint32_t)f);
+    f = (uint64_t)w1 + p->pad[1] + (f >> 32); put_le32(tag + 4, (uint32_t)f);
+    f = (uint64_t)w2 + p->pad[2] + (f >> 32); put_le32(tag + 8, (uint32_t)f);
+    f = (uint64_t)w3 + p->pad[3] + (f >> 32); put_le32(tag + 12, (uint32_t)f);
+}
+
+// --- AEAD ---
+// Tag over aad and the ciphertext with the one-time key from block 0.
+static void aead_tag(const uint32_t st[16], const uint8_t *aad, size_t aad_len,
+                     const uint8_t *ct, size_t len, uint8_t tag[16]) {
+    uint32_t block0[16];
+    uint8_t otk[32];
+    chacha_block(st, block0);
+    for (int i = 0; i < 8; i++) {
+        put_le32(otk + 4 * i, block0[i]);
+    }
+    poly_t p;
+    poly_init(&p, otk);
+    poly_padded(&p, aad, aad_len);
+    poly_padded(&p, ct, len);
+    uint8_t lengths[16];
+    put_le64(lengths, aad_len);
+    put_le64(lengths + 8, len);
+    poly_blocks(&p, lengths, 16, 1u << 24);
+    poly_finish(&p, tag);
+    memset(otk, 0, sizeof(otk));
+}
+
+void chachapoly_seal(const uint8_t key[CHACHAPOLY_KEY_LEN], const uint8_t nonce[CHACHAPOLY_NONCE_LEN],
+                     const uint8_t *aad, size_t aad_len, uint8_t *data, size_t len,
+                     uint8_t tag[CHACHAPOLY_TAG_LEN]) {
+    uint32_t st[16];
+    chacha_init(st, key, nonce);
+    chacha_xor(st, data, len);
+    st[12] = 0;
+    aead_tag(st, aad, aad_len, data, len, tag);
+}
+
+bool chachapoly_open(const uint8_t key[CHACHAPOLY_KEY_LEN], const uint8_t nonce[CHACHAPOLY_NONCE_LEN],
+                     const uint8_t *aad, size_t aad_len, uint8_t *data, size_t len,
+                     const uint8_t tag[CHACHAPOLY_TAG_LEN]) {
+    uint32_t st[16];
+    uint8_t expect[CHACHAPOLY_TAG_LEN];
+    chacha_init(st, key, nonce);
+    aead_tag(st, aad, aad_len, data, len, expect);
+    uint8_t diff = 0;
+    for (int i = 0; i < CHACHAPOLY_TAG_LEN; i++) {
+        diff |= expect[i] ^ tag[i];
+    }
+    if (diff != 0) {
+        return false;
+    }
+    chacha_xor(st, data, len);
+    return true;
+}
@@ -0,0 +1,30 @@
+/*
+ * ChaCha20-Poly1305 AEAD (RFC 8439) for the secure ingest link.
+ *
+ * Both calls work in place on the record buffer. chachapoly_open() checks
+ * the tag over the ciphertext before decrypting anything, so a forged or
+ * damaged record is left as it arrived and never reaches a decoder.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHACHAPOLY_KEY_LEN      32
+#define CHACHAPOLY_NONCE_LEN    12
+#define CHACHAPOLY_TAG_LEN      16
+
+// Encrypts data in place and writes its tag, which also covers aad.
+void chachapoly_seal(const uint8_t key[CHACHAPOLY_KEY_LEN], const uint8_t nonce[CHACHAPOLY_NONCE_LEN],
+                     const uint8_t *aad, size_t aad_len, uint8_t *data, size_t len,
+                     uint8_t tag[CHACHAPOLY_TAG_LEN]);
+
+// Checks tag against aad and the ciphertext in data, then decrypts data in
+// place. Returns false, leaving data untouched, if the tag does not match.
+bool chachapoly_open(const uint8_t key[CHACHAPOLY_KEY_LEN], const uint8_t nonce[CHACHAPOLY_NONCE_LEN],
+                     const uint8_t *aad, size_t aad_len, uint8_t *data, size_t len,
+                     const uint8_t tag[CHACHAPOLY_TAG_LEN]);
@@ -0,0 +1,157 @@
+/*
+ * Compressor benchmark
+ *
+ * Times the night settings on noise, on the cycle counter, then checks the
+ * two properties that fixed point is most likely to break: with every ratio
+ * at 1 and no make-up gain the three bands must sum back to the input level
+ * at any frequency, and a tone burst in each band must be pulled down with
+ * the configured attack and let go with the configured release. Times are
+ * to 63% of the steady-state reduction, so they read close to attack_ms and
+ * release_ms; the low band runs slower because a 16-frame control period
+ * only sees part of an 80 Hz cycle.
+ */
+
+#include "comp_bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "compressor.h"
+
+#define COMP_BENCH_FRAMES   4096
+#define COMP_BURST_FRAMES   AUDIO_SAMPLE_RATE       // Each step of the burst lasts a second
+
+static const char *const s_band_names[COMPRESSOR_BANDS] = { "low", "mid", "high" };
+static const float s_tones[COMPRESSOR_BANDS] = { 80, 1000, 8000 };
+
+static void fill_noise(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 4 - 8192;
+    }
+}
+
+static void fill_tone(int16_t *pcm, size_t frames, float hz, float dbfs, size_t start) {
+    double amp = 32767 * pow(10, dbfs / 20);
+    for (size_t i = 0; i < frames; i++) {
+        int16_t v = (int16_t)lrint(amp * sin(2 * M_PI * hz * (start + i) / AUDIO_SAMPLE_RATE));
+        pcm[2 * i] = v;
+        pcm[2 * i + 1] = v;
+    }
+}
+
+static double rms_dbfs(const int16_t *pcm, size_t frames) {
+    double sum = 0;
+    for (size_t i = 0; i < frames; i++) {
+        sum += (double)pcm[2 * i] * pcm[2 * i];
+    }
+    return 20 * log10(sqrt(sum / frames) * M_SQRT2 / 32767 + 1e-12);
+}
+
+// Largest deviation from unity gain of the crossover sum, in dB.
+static double flatness(int16_t *work) {
+    compressor_params_t p;
+    compressor_t c;
+    compressor_params_night(&p);
+    for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+        p.band[b].ratio = 1;
+        p.band[b].makeup_db = 0;
+    }
+    double worst = 0;
+    for (float hz = 40; hz < 16000; hz *= 1.25f) {
+        compressor_init(&c, &p, AUDIO_SAMPLE_RATE);
+        double sum = 0;
+        for (int k = 0; k < 8; k++) {
+            fill_tone(work, COMP_BENCH_FRAMES, hz, -6, (size_t)k * COMP_BENCH_FRAMES);
+            compressor_process(&c, work, COMP_BENCH_FRAMES);
+            // The first two chunks let the filters settle.
+            for (int i = 0; k >= 2 && i < COMP_BENCH_FRAMES; i++) {
+                sum += (double)work[2 * i] * work[2 * i];
+            }
+        }
+        double db = 20 * log10(sqrt(sum / (6 * COMP_BENCH_FRAMES)) * M_SQRT2 / 32767);
+        worst = fabs(db + 6) > worst ? fabs(db + 6) : worst;
+    }
+    return worst;
+}
+
+// Runs a -40, -10, -40 dBFS burst through band's tone, a control period at
+// a time, and reports how the band's reduction follows it.
+static void burst(int band, int16_t *work) {
+    compressor_params_t p;
+    compressor_t c;
+    compressor_params_night(&p);
+    compressor_init(&c, &p, AUDIO_SAMPLE_RATE);
+
+    const int n = COMPRESSOR_CONTROL_FRAMES;
+    const int steps = COMP_BURST_FRAMES / n;
+    float *reduction = malloc(3 * steps * sizeof(float));
+    if (reduction == NULL) {
+        console_printf("comp: out of memory\n");
+        return;
+    }
+    static const float levels[3] = { -40, -10, -40 };
+    double out_db[3] = { 0, 0, 0 };
+    for (int s = 0; s < 3 * steps; s++) {
+        fill_tone(work, n, s_tones[band], levels[s / steps], (size_t)s * n);
+        compressor_process(&c, work, n);
+        reduction[s] = compressor_reduction_db(&c, band);
+        if (s % steps == steps - 1) {
+            out_db[s / steps] = rms_dbfs(work, n);
+        }
+    }
+
+    float steady = reduction[2 * steps - 1];
+    int attack = steps, release = steps;
+    for (int s = 0; s < steps; s++) {
+        if (attack == steps && reduction[steps + s] >= 0.632f * steady) {
+            attack = s + 1;
+        }
+        if (release == steps && reduction[2 * steps + s] <= 0.368f * steady) {
+            release = s + 1;
+        }
+    }
+    console_printf("%-4s  %5.0f  %5.1f  %8.1f  %6.1f (%5.1f)  %7.1f (%5.0f)  %7lu\n", s_band_names[band],
+                   s_tones[band], steady, out_db[1] - out_db[0], attack * n * 1000.0 / AUDIO_SAMPLE_RATE,
+                   p.band[band].attack_ms, release * n * 1000.0 / AUDIO_SAMPLE_RATE, p.band[band].release_ms,
+                   (unsigned long)c.clipped);
+    free(reduction);
+}
+
+static void comp_bench(void) {
+    int16_t *work = malloc(2 * COMP_BENCH_FRAMES * sizeof(int16_t));
+    compressor_t *c = malloc(sizeof(*c));
+    if (!work || !c) {
+        console_printf("comp: out of memory\n");
+        goto done;
+    }
+
+    compressor_params_t p;
+    compressor_params_night(&p);
+    compressor_init(c, &p, AUDIO_SAMPLE_RATE);
+    fill_noise(work, COMP_BENCH_FRAMES);
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    compressor_process(c, work, COMP_BENCH_FRAMES);
+    uint32_t cycles = (esp_cpu_get_cycle_count() - t0) / COMP_BENCH_FRAMES;
+    double cpu = (double)cycles * AUDIO_SAMPLE_RATE / (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6) * 100;
+    console_printf("night settings: %lu cycles per frame, %.1f%% cpu@%dMHz\n", (unsigned long)cycles, cpu,
+                   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    console_printf("crossover sum at unity: within %.2f dB from 40 Hz to 16 kHz\n", flatness(work));
+
+    console_printf("band   tone  gr dB  swing dB  attack ms (set)  release ms (set)  clipped\n");
+    for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+        burst(b, work);
+    }
+
+done:
+    free(work);
+    free(c);
+}
+
+void comp_bench_init(void) {
+    console_register_bench("comp", comp_bench);
+}
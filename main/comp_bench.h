@@ -0,0 +1,10 @@
+/*
+ * Compressor benchmark ("bench comp"): cycles per frame for the night
+ * settings, flatness of the crossover sum, and attack and release of each
+ * band on a tone burst.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void comp_bench_init(void);
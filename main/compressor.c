@@ -0,0 +1,346 @@
+/*
+ * Three-band compressor
+ *
+ * Samples are processed at 12 extra bits (full scale 2^27). The crossovers
+ * use the identity LP4 + HP4 = AP2 of Linkwitz-Riley filters: each split is
+ * a 4th-order low-pass and a 2nd-order all-pass, and the high side is their
+ * difference, which saves two sections per crossover:
+ *   low0 = LP4(f0) x           rest = AP(f0) x - low0
+ *   mid  = LP4(f1) rest        high = AP(f1) rest - mid
+ *   low  = AP(f1) low0
+ * The last all-pass gives the low band the phase the other two picked up at
+ * f1, so low + mid + high = AP(f0) AP(f1) x.
+ *
+ * Gain computers run once per COMPRESSOR_CONTROL_FRAMES, in the log2 domain
+ * (Q16, one unit per 6.02 dB). A block's bands are filtered first, so the
+ * gain for a block already reflects its own peak; the static curve with its
+ * soft knee gives a target reduction, attack or release smoothing moves
+ * toward it, and the linear gain is interpolated across the next block.
+ *
+ * The float32 pipeline runs the same sections, taken from the quantized
+ * ones, over planar blocks through the DSP kernels, and the same gain
+ * computers in float. Its log2 and exp2 are polynomials about as accurate
+ * as the fixed-point tables (1e-4 of a unit), where libm's would cost more
+ * than the rest of a control period.
+ */
+
+#include "compressor.h"
+
+#include <math.h>
+#include <string.h>
+
+#define INTERNAL_SHIFT  12
+#define LOG2_ONE        (1 << 16)
+#define FULL_SCALE_LOG2 ((15 + INTERNAL_SHIFT) * LOG2_ONE)
+#define SILENCE_LOG2    (-32 * LOG2_ONE)
+#define DB_PER_LOG2     6.0206f
+#define LOG2_UNIT       (1.0f / LOG2_ONE)
+
+// log2(1 + i/32), Q16
+static const int32_t s_log2_table[33] = {
+    0, 2909, 5732, 8473, 11136, 13727, 16248, 18704, 21098, 23433, 25711, 27936, 30109, 32234,
+    34312, 36346, 38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207, 52911, 54584, 56229,
+    57845, 59434, 60997, 62534, 64047, 65536,
+};
+
+// 2^(i/32), Q30
+static const uint32_t s_exp2_table[33] = {
+    1073741824u, 1097253708u, 1121280436u, 1145833280u, 1170923762u, 1196563654u, 1222764986u,
+    1249540052u, 1276901417u, 1304861917u, 1333434672u, 1362633090u, 1392470869u, 1422962010u,
+    1454120821u, 1485961921u, 1518500250u, 1551751076u, 1585730000u, 1620452965u, 1655936265u,
+    1692196547u, 1729250827u, 1767116489u, 1805811301u, 1845353420u, 1885761398u, 1927054196u,
+    1969251188u, 2012372174u, 2056437387u, 2101467502u, 2147483648u,
+};
+
+// log2(x), Q16, for x > 0.
+static int32_t log2_q16(uint32_t x) {
+    int lz = __builtin_clz(x);
+    uint32_t frac = (x << lz) & 0x7FFFFFFF;
+    int i = frac >> 26;
+    int32_t rem = (frac >> 10) & 0xFFFF;
+    int32_t t = s_log2_table[i] + (((s_log2_table[i + 1] - s_log2_table[i]) * rem) >> 16);
+    return (31 - lz) * LOG2_ONE + t;
+}
+
+// 2^(v / 2^16), Q16.
+static int32_t exp2_q16(int32_t v) {
+    int e = v >> 16;
+    int f = v & 0xFFFF;
+    int i = f >> 11;
+    uint32_t rem = f & 0x7FF;
+    uint32_t t = s_exp2_table[i] + (uint32_t)(((uint64_t)(s_exp2_table[i + 1] - s_exp2_table[i]) * rem) >> 11);
+    int shift = 14 - e;
+    if (shift >= 32) {
+        return 0;
+    }
+    return shift >= 0 ? (int32_t)(t >> shift) : INT32_MAX;
+}
+
+// log2(x) for x > 0: the exponent, and a quartic in the mantissa.
+static inline float log2_f(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int e = (int)(bits >> 23) - 127;
+    bits = (bits & 0x007FFFFF) | 0x3F800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    float t = m - 1;
+    return e + t * (1.4386375f + t * (-0.6777391f + t * (0.3218714f + t * -0.0828558f)));
+}
+
+// 2^v, a cubic for the fraction scaled by the integer part's power of two.
+static inline float exp2_f(float v) {
+    int e = (int)v;
+    if (v < e) {
+        e--;
+    }
+    if (e < -126) {
+        return 0;
+    }
+    e = e > 127 ? 127 : e;
+    float t = v - e;
+    float p = 1 + t * (0.6955646f + t * (0.2261673f + t * 0.0781429f));
+    uint32_t bits = (uint32_t)(e + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+static int32_t q(double v, int bits) {
+    return (int32_t)lrint(v * (1 << bits));
+}
+
+static int32_t log2_of_db(float db) {
+    return q(db / DB_PER_LOG2, 16);
+}
+
+void compressor_params_night(compressor_params_t *p) {
+    static const compressor_params_t night = {
+        .crossover_hz = { 200.0f, 3000.0f },
+        .band = {
+            { .threshold_db = -32, .ratio = 4, .knee_db = 6, .attack_ms = 20, .release_ms = 250, .makeup_db = 8 },
+            { .threshold_db = -30, .ratio = 3, .knee_db = 6, .attack_ms = 5, .release_ms = 150, .makeup_db = 9 },
+            { .threshold_db = -32, .ratio = 3, .knee_db = 6, .attack_ms = 2, .release_ms = 100, .makeup_db = 7 },
+        },
+    };
+    *p = night;
+}
+
+void compressor_init(compressor_t *c, const compressor_params_t *p, uint32_t rate) {
+    memset(c, 0, sizeof(*c));
+    c->rate = rate;
+    compressor_configure(c, p);
+    for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+        c->band[b].linear = exp2_q16(c->band[b].makeup);
+        c->band[b].linear_f = exp2_f(c->band[b].makeup * LOG2_UNIT);
+    }
+}
+
+// Float copies of a section for both channels, keeping their states.
+static void float_section(dsp_biquad_t f[2], const biquad_t *q) {
+    for (int ch = 0; ch < 2; ch++) {
+        float w0 = f[ch].w[0], w1 = f[ch].w[1];
+        dsp_biquad_from_q28(&f[ch], q);
+        f[ch].w[0] = w0;
+        f[ch].w[1] = w1;
+    }
+}
+
+void compressor_configure(compressor_t *c, const compressor_params_t *p) {
+    for (int x = 0; x < COMPRESSOR_BANDS - 1; x++) {
+        biquad_lowpass(&c->lp[x][0], p->crossover_hz[x], M_SQRT1_2, c->rate);
+        biquad_allpass(&c->ap[x], p->crossover_hz[x], M_SQRT1_2, c->rate);
+        c->lp[x][1] = c->lp[x][0];
+        float_section(c->lp_f[x][0], &c->lp[x][0]);
+        float_section(c->lp_f[x][1], &c->lp[x][1]);
+        float_section(c->ap_f[x], &c->ap[x]);
+    }
+    float_section(c->ap_f[2], &c->ap[1]);
+    double period_ms = 1000.0 * COMPRESSOR_CONTROL_FRAMES / c->rate;
+    for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+        const compressor_band_params_t *bp = &p->band[b];
+        c->band[b].threshold = log2_of_db(bp->threshold_db);
+        c->band[b].slope = q(1.0 - 1.0 / (bp->ratio < 1 ? 1 : bp->ratio), 16);
+        c->band[b].knee = log2_of_db(bp->knee_db);
+        c->band[b].attack = q(1.0 - exp(-period_ms / fmax(bp->attack_ms, 0.01)), 16);
+        c->band[b].release = q(1.0 - exp(-period_ms / fmax(bp->release_ms, 0.01)), 16);
+        c->band[b].makeup = log2_of_db(bp->makeup_db);
+    }
+}
+
+// Target gain change for a band at a peak level, Q16 log2 (<= 0).
+static int32_t static_curve(const compressor_t *c, int b, int32_t level) {
+    int32_t over = level - c->band[b].threshold;
+    int32_t knee = c->band[b].knee;
+    int64_t reduction;
+    if (2 * over <= -knee) {
+        return 0;
+    }
+    if (2 * over >= knee) {
+        reduction = over;
+    } else {
+        // Quadratic through the knee: (over + knee/2)^2 / (2 knee)
+        int64_t d = over + knee / 2;
+        reduction = d * d / (2 * knee);
+    }
+    return -(int32_t)((reduction * c->band[b].slope) >> 16);
+}
+
+// --- Fixed point ---
+void compressor_process_fixed(compressor_t *c, int16_t *pcm, size_t frames) {
+    int32_t bands[COMPRESSOR_BANDS][2 * COMPRESSOR_CONTROL_FRAMES];
+
+    while (frames > 0) {
+        int n = frames < COMPRESSOR_CONTROL_FRAMES ? frames : COMPRESSOR_CONTROL_FRAMES;
+        uint32_t peak[COMPRESSOR_BANDS] = { 0, 0, 0 };
+
+        for (int i = 0; i < 2 * n; i++) {
+            int ch = i & 1;
+            int32_t x = (int32_t)pcm[i] * (1 << INTERNAL_SHIFT);
+            int32_t low = biquad_process(&c->lp[0][0], &c->lp_state[0][0][ch], x);
+            low = biquad_process(&c->lp[0][1], &c->lp_state[0][1][ch], low);
+            int32_t rest = biquad_process(&c->ap[0], &c->ap_state[0][ch], x) - low;
+            int32_t mid = biquad_process(&c->lp[1][0], &c->lp_state[1][0][ch], rest);
+            mid = biquad_process(&c->lp[1][1], &c->lp_state[1][1][ch], mid);
+            int32_t high = biquad_process(&c->ap[1], &c->ap_state[1][ch], rest) - mid;
+            low = biquad_process(&c->ap[1], &c->ap_state[2][ch], low);
+            bands[0][i] = low;
+            bands[1][i] = mid;
+            bands[2][i] = high;
+            for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+                uint32_t a = bands[b][i] < 0 ? -(uint32_t)bands[b][i] : (uint32_t)bands[b][i];
+                peak[b] = a > peak[b] ? a : peak[b];
+            }
+        }
+
+        int32_t from[COMPRESSOR_BANDS], step[COMPRESSOR_BANDS];
+        for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+            int32_t level = peak[b] ? log2_q16(peak[b]) - FULL_SCALE_LOG2 : SILENCE_LOG2;
+            int32_t target = static_curve(c, b, level);
+            int32_t gain = c->band[b].gain;
+            int32_t coef = target < gain ? c->band[b].attack : c->band[b].release;
+            gain += (int32_t)(((int64_t)(target - gain) * coef) >> 16);
+            c->band[b].gain = gain;
+
+            int32_t linear = exp2_q16(gain + c->band[b].makeup);
+            from[b] = c->band[b].linear;
+            step[b] = (linear - from[b]) / n;
+            c->band[b].linear = linear;
+        }
+
+        for (int f = 0; f < n; f++) {
+            int32_t g[COMPRESSOR_BANDS];
+            for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+                g[b] = f == n - 1 ? c->band[b].linear : from[b] + step[b] * (f + 1);
+            }
+            for (int ch = 0; ch < 2; ch++) {
+                int i = 2 * f + ch;
+                int64_t sum = (int64_t)bands[0][i] * g[0] + (int64_t)bands[1][i] * g[1] + (int64_t)bands[2][i] * g[2];
+                int64_t v = (sum + ((int64_t)1 << (15 + INTERNAL_SHIFT))) >> (16 + INTERNAL_SHIFT);
+                if (v > INT16_MAX || v < INT16_MIN) {
+                    v = v > 0 ? INT16_MAX : INT16_MIN;
+                    c->clipped++;
+                }
+                pcm[i] = v;
+            }
+        }
+        pcm += 2 * n;
+        frames -= n;
+    }
+}
+
+// --- Float32 ---
+static float static_curve_f(const compressor_t *c, int b, float level) {
+    float over = level - c->band[b].threshold * LOG2_UNIT;
+    float knee = c->band[b].knee * LOG2_UNIT;
+    float reduction;
+    if (2 * over <= -knee) {
+        return 0;
+    }
+    if (2 * over >= knee) {
+        reduction = over;
+    } else {
+        float d = over + knee / 2;
+        reduction = d * d / (2 * knee);
+    }
+    return -reduction * (c->band[b].slope * LOG2_UNIT);
+}
+
+// The crossovers over one channel's block: x holds the input and ends up
+// holding the high band.
+static void split_float(compressor_t *c, int ch, float *x, float *low, float *mid, int n) {
+    dsp_biquad(&c->lp_f[0][0][ch], x, low, n);
+    dsp_biquad(&c->lp_f[0][1][ch], low, low, n);
+    dsp_biquad(&c->ap_f[0][ch], x, x, n);
+    dsp_sub(x, low, x, n, 1, 1, 1);                 // rest
+    dsp_biquad(&c->lp_f[1][0][ch], x, mid, n);
+    dsp_biquad(&c->lp_f[1][1][ch], mid, mid, n);
+    dsp_biquad(&c->ap_f[1][ch], x, x, n);
+    dsp_sub(x, mid, x, n, 1, 1, 1);
+    dsp_biquad(&c->ap_f[2][ch], low, low, n);
+}
+
+void compressor_process_float(compressor_t *c, int16_t *pcm, size_t frames) {
+    float bands[COMPRESSOR_BANDS][2][PCM_FLOAT_BLOCK];     // [band][channel]
+
+    while (frames > 0) {
+        int n = frames < PCM_FLOAT_BLOCK ? frames : PCM_FLOAT_BLOCK;
+        pcm_to_float(pcm, bands[2][0], bands[2][1], n, 1);
+        for (int ch = 0; ch < 2; ch++) {
+            split_float(c, ch, bands[2][ch], bands[0][ch], bands[1][ch], n);
+        }
+
+        for (int start = 0; start < n; start += COMPRESSOR_CONTROL_FRAMES) {
+            int m = n - start < COMPRESSOR_CONTROL_FRAMES ? n - start : COMPRESSOR_CONTROL_FRAMES;
+            float from[COMPRESSOR_BANDS], step[COMPRESSOR_BANDS];
+            for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+                float peak = 0;
+                for (int i = start; i < start + m; i++) {
+                    peak = fmaxf(peak, fmaxf(fabsf(bands[b][0][i]), fabsf(bands[b][1][i])));
+                }
+                float level = peak > 0 ? log2_f(peak) : SILENCE_LOG2 * LOG2_UNIT;
+                float target = static_curve_f(c, b, level);
+                float gain = c->band[b].gain_f;
+                int32_t coef = target < gain ? c->band[b].attack : c->band[b].release;
+                gain += (target - gain) * (coef * LOG2_UNIT);
+                c->band[b].gain_f = gain;
+
+                float linear = exp2_f(gain + c->band[b].makeup * LOG2_UNIT);
+                from[b] = c->band[b].linear_f;
+                step[b] = (linear - from[b]) / m;
+                c->band[b].linear_f = linear;
+            }
+
+            for (int f = 0; f < m; f++) {
+                float g[COMPRESSOR_BANDS];
+                for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+                    g[b] = f == m - 1 ? c->band[b].linear_f : from[b] + step[b] * (f + 1);
+                }
+                for (int ch = 0; ch < 2; ch++) {
+                    int i = start + f;
+                    bands[0][ch][i] = bands[0][ch][i] * g[0] + bands[1][ch][i] * g[1] + bands[2][ch][i] * g[2];
+                }
+            }
+        }
+
+        c->clipped += pcm_from_float(&c->dither, bands[0][0], bands[0][1], pcm, n);
+        pcm += 2 * n;
+        frames -= n;
+    }
+}
+
+void compressor_process(compressor_t *c, int16_t *pcm, size_t frames) {
+#if DSP_FLOAT_PIPELINE
+    compressor_process_float(c, pcm, frames);
+#else
+    compressor_process_fixed(c, pcm, frames);
+#endif
+}
+
+float compressor_reduction_db(const compressor_t *c, int band) {
+#if DSP_FLOAT_PIPELINE
+    return -c->band[band].gain_f * DB_PER_LOG2;
+#else
+    return -c->band[band].gain * DB_PER_LOG2 / LOG2_ONE;
+#endif
+}
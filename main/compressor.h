@@ -0,0 +1,83 @@
+/*
+ * Three-band compressor for 16-bit stereo PCM, in fixed point or, when
+ * DSP_FLOAT_PIPELINE is set (see pcm_float.h), in float32.
+ *
+ * Fourth-order Linkwitz-Riley crossovers split the signal into low, mid and
+ * high bands that sum back to an all-pass response, so with no gain
+ * reduction the output has the input's magnitude response. Each band has a
+ * stereo-linked feed-forward gain computer with its own threshold, ratio,
+ * soft knee, attack, release and make-up gain.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "biquad.h"
+#include "pcm_float.h"
+
+#define COMPRESSOR_BANDS            3
+#define COMPRESSOR_CONTROL_FRAMES   16      // Gain computer update period
+
+typedef struct {
+    float threshold_db;                     // dBFS, where compression starts
+    float ratio;                            // >= 1
+    float knee_db;                          // Width of the soft knee
+    float attack_ms;
+    float release_ms;
+    float makeup_db;
+} compressor_band_params_t;
+
+typedef struct {
+    float crossover_hz[COMPRESSOR_BANDS - 1];
+    compressor_band_params_t band[COMPRESSOR_BANDS];
+} compressor_params_t;
+
+typedef struct {
+    uint32_t rate;
+    // Crossover filters: a 4th-order low-pass is two Butterworth sections;
+    // the all-pass is the low-pass plus high-pass sum.
+    biquad_t lp[2][2];                      // [crossover][section]
+    biquad_t ap[2];
+    biquad_state_t lp_state[2][2][2];       // [crossover][section][channel]
+    biquad_state_t ap_state[3][2];          // Crossovers 0, 1, low band's 1
+    struct {
+        int32_t threshold;                  // Q16 log2 of full scale
+        int32_t slope;                      // 1 - 1/ratio, Q16
+        int32_t knee;                       // Q16 log2
+        int32_t attack;                     // Smoothing coefficients per control period, Q16
+        int32_t release;
+        int32_t makeup;                     // Q16 log2
+        int32_t gain;                       // Smoothed gain change, Q16 log2 (<= 0)
+        int32_t linear;                     // Applied gain at the end of the last period, Q16
+        float gain_f;                       // gain and linear for the float32 pipeline,
+        float linear_f;                     // in log2 units and as a factor
+    } band[COMPRESSOR_BANDS];
+    dsp_biquad_t lp_f[2][2][2];             // Float32 pipeline: [crossover][section][channel]
+    dsp_biquad_t ap_f[3][2];
+    pcm_dither_t dither;
+    uint32_t clipped;                       // Output samples saturated
+} compressor_t;
+
+// Settings for late-night listening: heavy compression of all bands with
+// make-up gain, so dialogue comes up and effects come down.
+void compressor_params_night(compressor_params_t *p);
+
+// Sets up c from p for audio at rate Hz and clears its state.
+void compressor_init(compressor_t *c, const compressor_params_t *p, uint32_t rate);
+
+// Changes parameters without touching the filter or gain state.
+void compressor_configure(compressor_t *c, const compressor_params_t *p);
+
+// Processes frames of interleaved stereo in place, in the pipeline
+// DSP_FLOAT_PIPELINE selects.
+void compressor_process(compressor_t *c, int16_t *pcm, size_t frames);
+
+// The two pipelines, for benchmarking; a compressor should stay on one of them.
+void compressor_process_fixed(compressor_t *c, int16_t *pcm, size_t frames);
+void compressor_process_float(compressor_t *c, int16_t *pcm, size_t frames);
+
+// Current gain reduction of a band in dB (>= 0).
+float compressor_reduction_db(const compressor_t *c, int band);
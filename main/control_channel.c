@@ -0,0 +1,170 @@
+/*
+ * Control channel
+ *
+ * One controller at a time. Telemetry and command replies share the socket,
+ * so sends are serialized by s_send_lock. Tasks that report before Wi-Fi is
+ * up find no lock yet, and their lines are dropped as if no controller were
+ * connected.
+ *
+ * A controller only becomes the one lines are sent to once it has passed
+ * the challenge, so telemetry and events do not reach it before that either.
+ */
+
+#include "control_channel.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "bridge_console.h"
+#include "secure_link.h"
+#include "telemetry.h"
+
+static const char *TAG = "CONTROL";
+
+#define CONTROL_LINE_MAX            128
+#define CONTROL_SEND_TIMEOUT_MS     200
+
+static int s_control_socket = -1;
+static SemaphoreHandle_t s_send_lock;      // Set once by control_channel_start()
+
+void control_channel_send_line(const char *line) {
+    if (s_send_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_send_lock, portMAX_DELAY);
+    if (s_control_socket >= 0) {
+        send(s_control_socket, line, strlen(line), 0);
+    }
+    xSemaphoreGive(s_send_lock);
+}
+
+void control_channel_disconnect(void) {
+    if (s_send_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_send_lock, portMAX_DELAY);
+    if (s_control_socket >= 0) {
+        // recv() in control_session() returns 0 and the session ends as usual.
+        shutdown(s_control_socket, SHUT_RDWR);
+    }
+    xSemaphoreGive(s_send_lock);
+}
+
+static void control_out(const char *text, void *ctx) {
+    control_channel_send_line(text);
+}
+
+static void set_controller(int sock) {
+    xSemaphoreTake(s_send_lock, portMAX_DELAY);
+    s_control_socket = sock;
+    xSemaphoreGive(s_send_lock);
+}
+
+// Sends the hello; returns true if the controller needs to answer the
+// challenge in it.
+static bool greet(int sock, uint8_t challenge[SECURE_LINK_NONCE_LEN]) {
+    char hello[96];
+    bool keyed = secure_link_control_challenge(challenge);
+    int n = snprintf(hello, sizeof(hello), "E control hello auth=%s", keyed ? "hmac-sha256 challenge=" : "none");
+    for (int i = 0; keyed && i < SECURE_LINK_NONCE_LEN; i++) {
+        n += snprintf(hello + n, sizeof(hello) - n, "%02x", challenge[i]);
+    }
+    snprintf(hello + n, sizeof(hello) - n, "\n");
+    send(sock, hello, strlen(hello), 0);
+    return keyed;
+}
+
+static void control_session(int sock) {
+    char line[CONTROL_LINE_MAX];
+    int used = 0;
+    uint8_t challenge[SECURE_LINK_NONCE_LEN];
+    bool authed = !greet(sock, challenge);
+    if (authed) {
+        set_controller(sock);
+    }
+
+    while (1) {
+        int len = recv(sock, line + used, sizeof(line) - 1 - used, 0);
+        if (len <= 0) {
+            break;
+        }
+        used += len;
+        line[used] = '\0';
+
+        char *start = line;
+        char *nl;
+        while ((nl = strpbrk(start, "\r\n")) != NULL) {
+            *nl = '\0';
+            if (!authed && *start != '\0') {
+                if (strncmp(start, "auth ", 5) != 0 || !secure_link_control_verify(challenge, start + 5)) {
+                    ESP_LOGW(TAG, "Controller failed authentication");
+                    send(sock, "ERR auth\n", 9, 0);
+                    return;
+                }
+                // Straight to sock first, so the OK comes before any telemetry.
+                send(sock, "OK\n", 3, 0);
+                set_controller(sock);
+                authed = true;
+            } else if (*start != '\0') {
+                int ret = console_exec_to(start, control_out, NULL);
+                char status[24];
+                if (ret == 0) {
+                    strcpy(status, "OK\n");
+                } else {
+                    snprintf(status, sizeof(status), "ERR %d\n", ret);
+                }
+                control_channel_send_line(status);
+            }
+            start = nl + 1;
+        }
+        used -= start - line;
+        memmove(line, start, used);
+        if (used == sizeof(line) - 1) {
+            // No newline in a full buffer: drop the oversized line.
+            used = 0;
+        }
+    }
+}
+
+static void control_channel_task(void *pvParameters) {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(CONTROL_PORT),
+    };
+    bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr));
+    listen(listen_sock, 1);
+    ESP_LOGI(TAG, "Control channel listening on port %d", CONTROL_PORT);
+
+    while (1) {
+        struct sockaddr_in source_addr;
+        socklen_t addr_len = sizeof(source_addr);
+        int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+        if (sock < 0) {
+            ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        ESP_LOGI(TAG, "Controller connected");
+        // A controller that stops reading must not stall the telemetry task.
+        struct timeval timeout = { .tv_sec = 0, .tv_usec = CONTROL_SEND_TIMEOUT_MS * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        control_session(sock);
+
+        set_controller(-1);
+        close(sock);
+        ESP_LOGI(TAG, "Controller disconnected");
+    }
+}
+
+void control_channel_start(void) {
+    s_send_lock = xSemaphoreCreateMutex();
+    telemetry_set_sink(control_channel_send_line);
+    xTaskCreate(control_channel_task, "control", 4096, NULL, 4, NULL);
+}
@@ -0,0 +1,33 @@
+/*
+ * Control channel: line-based TCP service next to the audio port.
+ *
+ * A controller (GUI, sender, netcat) connects to CONTROL_PORT and receives
+ * telemetry lines starting with "T " and event lines starting with "E " (such as
+ * an audio stream being refused). Any line it sends is run as a console
+ * command; the command's output follows, then "OK" or "ERR <code>".
+ *
+ * Each connection opens with
+ *
+ *     E control hello auth=none
+ *     E control hello auth=hmac-sha256 challenge=<32 hex digits>
+ *
+ * the second once a secure link key is set ("link key"). The controller
+ * must then send "auth <64 hex digits>", the HMAC described in
+ * secure_link.h, and gets "OK" before anything else is run or sent to it.
+ * Any other first line, or a wrong answer, gets "ERR auth" and the
+ * connection is closed.
+ */
+
+#pragma once
+
+#define CONTROL_PORT    8081
+
+// Starts the control server task; call once Wi-Fi is up.
+void control_channel_start(void);
+
+// Sends one newline-terminated line to the connected controller, if any.
+// Safe to call before control_channel_start(); the line is then dropped.
+void control_channel_send_line(const char *line);
+
+// Closes the connection to the current controller, if any.
+void control_channel_disconnect(void);
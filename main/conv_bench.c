@@ -0,0 +1,133 @@
+/*
+ * Convolution benchmark
+ *
+ * Builds synthetic responses (exponentially decaying noise, like a room or
+ * a headphone correction with a long tail) of several lengths, with two and
+ * four paths, and runs noise through each in IR_DEFAULT_PARTITION blocks,
+ * timing every block on the cycle counter. The last block is checked against
+ * a direct convolution in single precision. Rounding to 16 bits alone gives
+ * half an LSB; much more than one LSB is a fixed-point regression.
+ */
+
+#include "conv_bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "convolver.h"
+#include "ir_filter.h"
+
+#define CONV_BENCH_BLOCKS   8       // Timed blocks per response, after the delay line has filled
+
+static const int s_lengths[] = { 256, 1024, 2048, 4096 };
+
+// Tap j of a path: noise from a hash of (path, j), decaying by 60 dB over
+// the response, with unit energy.
+static float bench_tap(int path, int j, int taps) {
+    uint32_t x = (uint32_t)path * 2654435761u ^ (uint32_t)j * 2246822519u;
+    x ^= x >> 15;
+    x *= 2246822519u;
+    x ^= x >> 13;
+    float u = (int32_t)x * (1.0f / 2147483648.0f);
+    return u * expf(-6.9f * j / taps) * sqrtf(41.4f / taps);
+}
+
+static int bench_read(void *ctx, int path, int offset, float *taps, int count) {
+    int len = *(const int *)ctx;
+    for (int i = 0; i < count; i++) {
+        taps[i] = bench_tap(path, offset + i, len);
+    }
+    return 0;
+}
+
+static void fill_input(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 8 - 4096;
+    }
+}
+
+static void conv_bench_run(int taps, int paths, const int16_t *in, int16_t *block) {
+    const int n = IR_DEFAULT_PARTITION;
+    size_t bytes = convolver_size(n, taps, paths);
+    void *mem = malloc(bytes);
+    if (mem == NULL) {
+        console_printf("%5d  %5d  %7u  out of memory\n", taps, paths, (unsigned)bytes);
+        return;
+    }
+    convolver_t *c = convolver_create(mem, n, taps, paths);
+    convolver_load(c, bench_read, &taps);
+
+    int fill = (taps + n - 1) / n;
+    uint32_t total = 0;
+    uint32_t worst = 0;
+    for (int b = 0; b < fill + CONV_BENCH_BLOCKS; b++) {
+        memcpy(block, in + 2 * b * n, 2 * n * sizeof(int16_t));
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        convolver_process(c, block);
+        uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+        if (b >= fill) {
+            total += cycles;
+            worst = cycles > worst ? cycles : worst;
+        }
+    }
+
+    // Direct convolution of the last block.
+    int start = (fill + CONV_BENCH_BLOCKS - 1) * n;
+    double max_err = 0;
+    for (int i = 0; i < n; i++) {
+        for (int o = 0; o < 2; o++) {
+            float ref = 0;
+            for (int j = 0; j < taps && j <= start + i; j++) {
+                const int16_t *x = in + 2 * (start + i - j);
+                if (paths == 2) {
+                    ref += bench_tap(o, j, taps) * x[o];
+                } else {
+                    ref += bench_tap(o, j, taps) * x[0] + bench_tap(2 + o, j, taps) * x[1];
+                }
+            }
+            ref = ref > INT16_MAX ? INT16_MAX : (ref < INT16_MIN ? INT16_MIN : ref);
+            double err = fabs(block[2 * i + o] - ref);
+            max_err = err > max_err ? err : max_err;
+        }
+    }
+
+    uint32_t cycles = total / CONV_BENCH_BLOCKS;
+    double cpu = (double)cycles * AUDIO_SAMPLE_RATE / n / (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6) * 100;
+    console_printf("%5d  %5d  %7u  %10lu  %10lu  %7.1f%%  %11.2f  %7lu\n", taps, paths, (unsigned)bytes,
+                   (unsigned long)cycles, (unsigned long)worst, cpu, max_err, (unsigned long)convolver_clipped(c));
+    free(mem);
+}
+
+static void conv_bench(void) {
+    const int n = IR_DEFAULT_PARTITION;
+    int max_taps = s_lengths[sizeof(s_lengths) / sizeof(s_lengths[0]) - 1];
+    size_t frames = max_taps + (CONV_BENCH_BLOCKS + 1) * n;
+    int16_t *in = malloc(2 * frames * sizeof(int16_t));
+    int16_t *block = malloc(2 * n * sizeof(int16_t));
+    if (!in || !block) {
+        console_printf("conv: out of memory\n");
+        goto done;
+    }
+    fill_input(in, frames);
+
+    console_printf("%d-frame partitions (%.1f ms)\n", n, n * 1000.0 / AUDIO_SAMPLE_RATE);
+    console_printf(" taps  paths    bytes  cyc/block  worst cyc  cpu@%dMHz  max err LSB  clipped\n",
+                   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    for (int i = 0; i < sizeof(s_lengths) / sizeof(s_lengths[0]); i++) {
+        conv_bench_run(s_lengths[i], 2, in, block);
+        conv_bench_run(s_lengths[i], 4, in, block);
+    }
+
+done:
+    free(in);
+    free(block);
+}
+
+void conv_bench_init(void) {
+    console_register_bench("conv", conv_bench);
+}
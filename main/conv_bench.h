@@ -0,0 +1,10 @@
+/*
+ * Convolution benchmark ("bench conv"): cycles per block and CPU per second
+ * of audio for several impulse-response lengths, plus the error against a
+ * direct convolution.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void conv_bench_init(void);
@@ -0,0 +1,300 @@
+/*
+ * Uniformly partitioned FFT convolution
+ *
+ * Overlap-save with a block of N frames and transforms of M = 2N points.
+ * Both channels share one complex FFT, left in the real part and right in
+ * the imaginary part, and their spectra are pulled apart through the
+ * symmetry of real signals:
+ *   L[k] = (Z[k] + conj Z[M-k]) / 2,  R[k] = (Z[k] - conj Z[M-k]) / 2i
+ * Only bins 0..N of each are kept. The newest P input spectra sit in a
+ * frequency-domain delay line, so output bin k is
+ *   Y[k] = sum over p < P of X(block - p)[k] * H(partition p)[k]
+ * per path, summed in 64 bits. The two outputs are packed back the same
+ * way for a single inverse FFT, and its last N points are the new block.
+ *
+ * Scaling: input enters as Q28 (16-bit samples << 13), which leaves 12 dB
+ * for filter gain before the packed output spectra saturate at 2^30. Both
+ * transforms divide by M; the output spectrum is renormalised before the
+ * inverse one, so the output keeps at least 13 - log2(M) fraction bits and
+ * more in quieter blocks.
+ * Spectra of the response are 16-bit with one exponent for the whole set,
+ * which puts their quantization error about 90 dB below the filter's peak
+ * response.
+ */
+
+#include "convolver.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "fft.h"
+
+#define INPUT_SHIFT     13
+#define SPECTRUM_LIMIT  (1 << 30)
+
+struct convolver {
+    fft_t fft;
+    int partition;          // N
+    int log2m;
+    int taps;
+    int paths;
+    int parts;              // P
+    int head;               // Delay line slot of the newest block
+    int hbits;              // Fraction bits of spectra[]
+    bool loaded;
+    uint32_t clipped;
+    int32_t *work;          // M complex points
+    int32_t *fdl;           // [P][N + 1][L re, L im, R re, R im]
+    int16_t *spectra;       // [P][N + 1][paths][re, im]
+    int16_t *history;       // Previous block, interleaved stereo
+    int32_t table[];
+};
+
+static size_t table_len(int partition) {
+    return FFT_TABLE_LEN(2 * partition);
+}
+
+size_t convolver_size(int partition, int taps, int paths) {
+    size_t bins = partition + 1;
+    size_t parts = (taps + partition - 1) / partition;
+    return sizeof(convolver_t) + table_len(partition) * sizeof(int32_t) +
+           4 * partition * sizeof(int32_t) + parts * bins * 4 * sizeof(int32_t) +
+           parts * bins * paths * 2 * sizeof(int16_t) + 2 * partition * sizeof(int16_t);
+}
+
+convolver_t *convolver_create(void *mem, int partition, int taps, int paths) {
+    convolver_t *c = mem;
+    memset(c, 0, sizeof(*c));
+    c->partition = partition;
+    c->log2m = __builtin_ctz(2 * partition);
+    c->taps = taps;
+    c->paths = paths;
+    c->parts = (taps + partition - 1) / partition;
+
+    size_t bins = partition + 1;
+    c->work = c->table + table_len(partition);
+    c->fdl = c->work + 4 * partition;
+    c->spectra = (int16_t *)(c->fdl + c->parts * bins * 4);
+    c->history = c->spectra + c->parts * bins * paths * 2;
+    fft_init(&c->fft, c->table, 2 * partition);
+    convolver_reset(c);
+    return c;
+}
+
+void convolver_reset(convolver_t *c) {
+    memset(c->fdl, 0, c->parts * (c->partition + 1) * 4 * sizeof(int32_t));
+    memset(c->history, 0, 2 * c->partition * sizeof(int16_t));
+    c->head = 0;
+}
+
+// Reads one partition of a path into work as zero-padded complex points,
+// scaled by 2^shift. The taps are staged as floats in the top quarter of
+// work, which the conversion reaches only after it has read them.
+static int read_partition(convolver_t *c, convolver_read_fn_t read, void *ctx, int path, int p, int shift) {
+    int n = c->partition;
+    int offset = p * n;
+    int count = c->taps - offset < n ? c->taps - offset : n;
+    float *taps = (float *)(c->work + 3 * n);
+    if (read(ctx, path, offset, taps, count) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        float v = i < count ? taps[i] : 0.0f;
+        c->work[2 * i] = (int32_t)lrintf(ldexpf(v, shift));
+        c->work[2 * i + 1] = 0;
+    }
+    memset(c->work + 2 * n, 0, 2 * n * sizeof(int32_t));
+    return 0;
+}
+
+int convolver_load(convolver_t *c, convolver_read_fn_t read, void *ctx) {
+    int n = c->partition;
+    int bins = n + 1;
+    c->loaded = false;
+
+    // Pass 1: the largest tap sets the scale of the time-domain input.
+    float peak = 0.0f;
+    float *taps = (float *)(c->work + 3 * n);
+    for (int path = 0; path < c->paths; path++) {
+        for (int offset = 0; offset < c->taps; offset += n) {
+            int count = c->taps - offset < n ? c->taps - offset : n;
+            if (read(ctx, path, offset, taps, count) != 0) {
+                return -1;
+            }
+            for (int i = 0; i < count; i++) {
+                peak = fmaxf(peak, fabsf(taps[i]));
+            }
+        }
+    }
+    int exp;
+    frexpf(peak > 0.0f ? peak : 1.0f, &exp);
+    int shift = 30 - exp;       // Peak tap just under 2^30
+
+    // Pass 2: the largest spectral component sets the spectra's exponent.
+    int32_t big = 0;
+    for (int path = 0; path < c->paths; path++) {
+        for (int p = 0; p < c->parts; p++) {
+            if (read_partition(c, read, ctx, path, p, shift) != 0) {
+                return -1;
+            }
+            fft_complex(&c->fft, c->work, 2 * n, false);
+            for (int j = 0; j < 2 * bins; j++) {
+                int32_t v = c->work[j];
+                big |= v < 0 ? ~v : v;
+            }
+        }
+    }
+    // Bins are DFT(h) * 2^shift / M; keep 15 significant bits.
+    int rshift = big ? 32 - __builtin_clz(big) - 15 : 0;
+    c->hbits = shift - c->log2m - rshift;
+    if (c->hbits < 0) {
+        return -2;
+    }
+
+    // Pass 3: quantize.
+    for (int path = 0; path < c->paths; path++) {
+        for (int p = 0; p < c->parts; p++) {
+            if (read_partition(c, read, ctx, path, p, shift) != 0) {
+                return -1;
+            }
+            fft_complex(&c->fft, c->work, 2 * n, false);
+            int16_t *h = c->spectra + (p * bins * c->paths + path) * 2;
+            for (int k = 0; k < bins; k++) {
+                for (int j = 0; j < 2; j++) {
+                    int64_t v = c->work[2 * k + j];
+                    if (rshift > 0) {
+                        v = (v + ((int64_t)1 << (rshift - 1))) >> rshift;
+                    } else {
+                        v *= (int64_t)1 << -rshift;
+                    }
+                    h[2 * k * c->paths + j] = v > INT16_MAX ? INT16_MAX : (v < -INT16_MAX ? -INT16_MAX : v);
+                }
+            }
+        }
+    }
+    convolver_reset(c);
+    c->loaded = true;
+    return 0;
+}
+
+static inline int64_t spectrum_round(int64_t acc, int hbits) {
+    return hbits > 0 ? (acc + ((int64_t)1 << (hbits - 1))) >> hbits : acc;
+}
+
+static inline int32_t spectrum_clamp(int64_t v) {
+    return v >= SPECTRUM_LIMIT ? SPECTRUM_LIMIT - 1 : (v <= -SPECTRUM_LIMIT ? -(SPECTRUM_LIMIT - 1) : v);
+}
+
+// Multiplies the delay line by the spectra, summing over partitions, and
+// packs the two outputs into work for the inverse transform. Returns the
+// largest component magnitude written.
+static int32_t accumulate(convolver_t *c) {
+    const int n = c->partition;
+    const int m = 2 * n;
+    const int bins = n + 1;
+    const int paths = c->paths;
+    int32_t *w = c->work;
+    int32_t peak = 0;
+
+    for (int k = 0; k < bins; k++) {
+        int64_t lr = 0, li = 0, rr = 0, ri = 0;
+        int slot = c->head;
+        const int16_t *h = c->spectra + k * paths * 2;
+        for (int p = 0; p < c->parts; p++) {
+            const int32_t *x = c->fdl + (slot * bins + k) * 4;
+            if (paths == 2) {
+                lr += (int64_t)x[0] * h[0] - (int64_t)x[1] * h[1];
+                li += (int64_t)x[0] * h[1] + (int64_t)x[1] * h[0];
+                rr += (int64_t)x[2] * h[2] - (int64_t)x[3] * h[3];
+                ri += (int64_t)x[2] * h[3] + (int64_t)x[3] * h[2];
+            } else {
+                lr += (int64_t)x[0] * h[0] - (int64_t)x[1] * h[1] + (int64_t)x[2] * h[4] - (int64_t)x[3] * h[5];
+                li += (int64_t)x[0] * h[1] + (int64_t)x[1] * h[0] + (int64_t)x[2] * h[5] + (int64_t)x[3] * h[4];
+                rr += (int64_t)x[0] * h[2] - (int64_t)x[1] * h[3] + (int64_t)x[2] * h[6] - (int64_t)x[3] * h[7];
+                ri += (int64_t)x[0] * h[3] + (int64_t)x[1] * h[2] + (int64_t)x[2] * h[7] + (int64_t)x[3] * h[6];
+            }
+            slot = slot > 0 ? slot - 1 : c->parts - 1;
+            h += bins * paths * 2;
+        }
+        int64_t al = spectrum_round(lr, c->hbits), bl = spectrum_round(li, c->hbits);
+        int64_t ar = spectrum_round(rr, c->hbits), br = spectrum_round(ri, c->hbits);
+        // W[k] = Yl[k] + i Yr[k], W[M-k] = conj Yl[k] + i conj Yr[k]
+        int32_t v[4] = {
+            spectrum_clamp(al - br), spectrum_clamp(bl + ar), spectrum_clamp(al + br), spectrum_clamp(ar - bl),
+        };
+        w[2 * k] = v[0];
+        w[2 * k + 1] = v[1];
+        if (k > 0 && k < n) {
+            w[2 * (m - k)] = v[2];
+            w[2 * (m - k) + 1] = v[3];
+        }
+        for (int j = 0; j < 4; j++) {
+            peak |= v[j] < 0 ? -v[j] : v[j];
+        }
+    }
+    return peak;
+}
+
+void convolver_process(convolver_t *c, int16_t *pcm) {
+    const int n = c->partition;
+    const int m = 2 * n;
+    const int bins = n + 1;
+    int32_t *w = c->work;
+    if (!c->loaded) {
+        memset(pcm, 0, 2 * n * sizeof(int16_t));
+        return;
+    }
+
+    for (int i = 0; i < 2 * n; i++) {
+        w[i] = c->history[i] * (1 << INPUT_SHIFT);
+        w[2 * n + i] = pcm[i] * (1 << INPUT_SHIFT);
+    }
+    memcpy(c->history, pcm, 2 * n * sizeof(int16_t));
+    fft_complex(&c->fft, w, m, false);
+
+    c->head = c->head + 1 < c->parts ? c->head + 1 : 0;
+    int32_t *x = c->fdl + c->head * bins * 4;
+    for (int k = 0; k < bins; k++) {
+        int j = (m - k) & (m - 1);
+        int32_t zr = w[2 * k], zi = w[2 * k + 1];
+        int32_t yr = w[2 * j], yi = w[2 * j + 1];
+        x[4 * k] = (zr + yr) >> 1;
+        x[4 * k + 1] = (zi - yi) >> 1;
+        x[4 * k + 2] = (zi + yi) >> 1;
+        x[4 * k + 3] = (yr - zr) >> 1;
+    }
+
+    // Block floating point: scale the spectrum's peak up to 2^29 so quiet
+    // passages keep their precision through the inverse transform.
+    int32_t peak = accumulate(c);
+    int shift = INPUT_SHIFT - c->log2m;
+    int norm = peak ? __builtin_clz(peak) - 2 : 0;
+    if (norm > 30 - shift) {
+        norm = 30 - shift;
+    }
+    if (norm > 0) {
+        for (int i = 0; i < 2 * m; i++) {
+            w[i] *= 1 << norm;
+        }
+    }
+    fft_complex(&c->fft, w, m, true);
+
+    shift += norm;
+    const int32_t round = 1 << (shift - 1);
+    for (int i = 0; i < 2 * n; i++) {
+        int32_t v = (w[2 * n + i] + round) >> shift;
+        if (v > INT16_MAX || v < INT16_MIN) {
+            v = v > 0 ? INT16_MAX : INT16_MIN;
+            c->clipped++;
+        }
+        pcm[i] = v;
+    }
+}
+
+int convolver_partition(const convolver_t *c) {
+    return c->partition;
+}
+
+uint32_t convolver_clipped(const convolver_t *c) {
+    return c->clipped;
+}
@@ -0,0 +1,61 @@
+/*
+ * Uniformly partitioned FFT convolution of 16-bit stereo PCM, in fixed point.
+ *
+ * The impulse response is cut into partitions of the block size and kept
+ * as spectra; each block of input costs one forward and one inverse FFT of
+ * twice the block size, plus one complex multiply-accumulate per bin per
+ * partition per path. Output is delayed by exactly one block.
+ *
+ * Two paths filter each channel on its own (headphone or room correction);
+ * four form a 2x2 matrix so each output is a mix of both inputs (binaural
+ * virtualization, crossfeed).
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONVOLVER_MIN_PARTITION     32
+#define CONVOLVER_MAX_PARTITION     1024
+
+// Path order for four paths: input channel * 2 + output channel.
+enum {
+    CONVOLVER_PATH_LL,
+    CONVOLVER_PATH_LR,
+    CONVOLVER_PATH_RL,
+    CONVOLVER_PATH_RR,
+};
+
+typedef struct convolver convolver_t;
+
+// Reads count taps of a path, starting at tap offset, into taps. Returns 0,
+// or -1 to abandon the load.
+typedef int (*convolver_read_fn_t)(void *ctx, int path, int offset, float *taps, int count);
+
+// Bytes of memory a convolver needs for taps-long responses on paths paths
+// (2 or 4), processed in blocks of partition frames (a power of two from
+// CONVOLVER_MIN_PARTITION to CONVOLVER_MAX_PARTITION).
+size_t convolver_size(int partition, int taps, int paths);
+
+// Places a convolver in mem (convolver_size() bytes, aligned as malloc's).
+// It passes audio through silent until convolver_load() succeeds.
+convolver_t *convolver_create(void *mem, int partition, int taps, int paths);
+
+// Reads the impulse responses and converts them to partition spectra.
+// Returns 0, -1 if read failed, or -2 if the response's gain is too high
+// to represent. Not safe to run alongside convolver_process().
+int convolver_load(convolver_t *c, convolver_read_fn_t read, void *ctx);
+
+// Filters one block of partition interleaved stereo frames in place.
+void convolver_process(convolver_t *c, int16_t *pcm);
+
+// Forgets past input, as at the start of a stream.
+void convolver_reset(convolver_t *c);
+
+int convolver_partition(const convolver_t *c);
+
+// Output samples saturated since creation.
+uint32_t convolver_clipped(const convolver_t *c);
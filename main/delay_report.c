@@ -0,0 +1,152 @@
+/*
+ * Output delay reporting
+ *
+ * The total is the sum of
+ *   buffer    the playback buffer fill, averaged over DELAY_SMOOTH_MS since
+ *             it saw-tooths between the sender's writes and a2d_data_cb;
+ *   pipeline  frames the stages ahead of the buffer are holding (the IR
+ *             filter's partition and block, catch-up lookahead while it
+ *             stretches);
+ *   bt        one a2d_data_cb interval: Bluedroid takes a whole interval's
+ *             audio at each call and encodes and queues it for the radio;
+ *   sink      what the sink says it adds, from AVDTP delay reporting, or
+ *             the "delay sink" estimate for sinks that never report.
+ *
+ * The fill is sampled every DELAY_SAMPLE_MS; the rest only when a report
+ * is due, since reading the stages takes their locks.
+ */
+
+#include "delay_report.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "a2d_cadence.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "catchup.h"
+#include "control_channel.h"
+#include "ir_filter.h"
+
+#define DELAY_SAMPLE_MS         10
+#define DELAY_SMOOTH_MS         250
+#define DELAY_STEP_MS           2       // Change worth reporting straight away...
+#define DELAY_MIN_GAP_MS        100     // ...but no more often than this
+#define DELAY_MAX_GAP_MS        1000    // Reported at least this often
+#define DELAY_SINK_MAX_MS       1000
+
+static const char *TAG = "DELAY";
+
+static atomic_int s_sink_01ms = -1;     // Last AVDTP report; negative without one
+static atomic_int s_sink_estimate_ms = DELAY_REPORT_SINK_DEFAULT_MS;
+
+// Reporting task only, apart from the console reading the last report.
+static float s_fill_ms = -1;
+static int64_t s_fill_us = 0;
+static float s_buffer_ms, s_pipeline_ms, s_bt_ms, s_sink_ms, s_total_ms;
+static bool s_sink_reported;
+static uint32_t s_reports = 0;
+
+void delay_report_sink_reported(uint16_t delay_01ms) {
+    if (atomic_exchange(&s_sink_01ms, delay_01ms) != delay_01ms) {
+        ESP_LOGI(TAG, "Sink reports %.1f ms of delay", delay_01ms / 10.0);
+    }
+}
+
+void delay_report_sink_lost(void) {
+    atomic_store(&s_sink_01ms, -1);
+}
+
+// Folds the current fill into the average.
+static void sample_fill(int64_t now) {
+    float fill_ms = audio_bridge_buffered_bytes() * 1000.0f / AUDIO_BYTES_PER_SEC;
+    if (s_fill_ms < 0) {
+        s_fill_ms = fill_ms;
+    } else {
+        float dt_ms = (now - s_fill_us) / 1000.0f;
+        s_fill_ms += (fill_ms - s_fill_ms) * dt_ms / (DELAY_SMOOTH_MS + dt_ms);
+    }
+    s_fill_us = now;
+}
+
+static float measure(bool *sink_reported) {
+    size_t frames = ir_filter_latency_frames() + catchup_latency_frames();
+    int sink_01ms = atomic_load(&s_sink_01ms);
+    *sink_reported = sink_01ms >= 0;
+
+    s_buffer_ms = s_fill_ms;
+    s_pipeline_ms = frames * 1000.0f / AUDIO_SAMPLE_RATE;
+    s_bt_ms = a2d_cadence_interval_us() / 1000.0f;
+    s_sink_ms = *sink_reported ? sink_01ms / 10.0f : atomic_load(&s_sink_estimate_ms);
+    return s_buffer_ms + s_pipeline_ms + s_bt_ms + s_sink_ms;
+}
+
+static void delay_report_task(void *pvParameters) {
+    int64_t last_report = 0, last_check = 0;
+    float reported_ms = -1;
+    bool reported_from_sink = false;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(DELAY_SAMPLE_MS));
+        int64_t now = esp_timer_get_time();
+        sample_fill(now);
+        if (now - last_check < DELAY_MIN_GAP_MS * 1000LL) {
+            continue;
+        }
+        last_check = now;
+
+        bool from_sink;
+        float total = measure(&from_sink);
+        if (fabsf(total - reported_ms) < DELAY_STEP_MS && from_sink == reported_from_sink &&
+            now - last_report < DELAY_MAX_GAP_MS * 1000LL) {
+            continue;
+        }
+        char line[128];
+        snprintf(line, sizeof(line),
+                 "E delay total=%.1f buffer=%.1f pipeline=%.1f bt=%.1f sink=%.1f sink_from=%s\n", total,
+                 s_buffer_ms, s_pipeline_ms, s_bt_ms, s_sink_ms, from_sink ? "avdtp" : "estimate");
+        control_channel_send_line(line);
+        s_total_ms = total;
+        s_sink_reported = from_sink;
+        s_reports++;
+        reported_ms = total;
+        reported_from_sink = from_sink;
+        last_report = now;
+    }
+}
+
+// --- Console ---
+static int cmd_delay(int argc, char **argv) {
+    if (argc < 2) {
+        console_printf("Output delay %.1f ms: buffer %.1f, pipeline %.1f, bluetooth %.1f, sink %.1f (%s)\n",
+                       s_total_ms, s_buffer_ms, s_pipeline_ms, s_bt_ms, s_sink_ms,
+                       s_sink_reported ? "reported by the sink" : "estimate");
+        console_printf("  %lu reports sent; sink estimate %d ms\n", (unsigned long)s_reports,
+                       atomic_load(&s_sink_estimate_ms));
+        console_printf("Usage: delay sink <ms>\n");
+        return 0;
+    }
+    int ms = argc > 2 ? atoi(argv[2]) : -1;
+    if (strcmp(argv[1], "sink") != 0 || ms < 0 || ms > DELAY_SINK_MAX_MS) {
+        console_printf("Expected sink 0-%d ms\n", DELAY_SINK_MAX_MS);
+        return -1;
+    }
+    atomic_store(&s_sink_estimate_ms, ms);
+    ESP_LOGI(TAG, "Assuming %d ms of delay in sinks that do not report it", ms);
+    return 0;
+}
+
+void delay_report_init(void) {
+    console_register("delay", "Output delay reported to the controller: delay [sink <ms>]", cmd_delay);
+}
+
+void delay_report_start(void) {
+    xTaskCreate(delay_report_task, "delay_report", 3072, NULL, 2, NULL);
+}
@@ -0,0 +1,30 @@
+/*
+ * Output delay reporting: how long audio handed to the bridge takes to be
+ * heard, sent to the controller as
+ *
+ *     E delay total=<ms> buffer=<ms> pipeline=<ms> bt=<ms> sink=<ms> sink_from=avdtp|estimate
+ *
+ * a few times a second while it moves and once a second while it holds, so
+ * a player can hold its video back by total. total counts from the moment
+ * the TCP task reads the audio off the socket; audio still queued in the
+ * sender's socket is the sender's to add.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define DELAY_REPORT_SINK_DEFAULT_MS    150     // Assumed for sinks that do not report their delay
+
+// Registers the "delay" command.
+void delay_report_init(void);
+
+// Starts reporting; call once the control channel is up.
+void delay_report_start(void);
+
+// Called with the delay an A2DP sink reports over AVDTP, in 1/10 ms.
+void delay_report_sink_reported(uint16_t delay_01ms);
+
+// Called when the sink disconnects; the estimate applies until the next
+// sink reports.
+void delay_report_sink_lost(void);
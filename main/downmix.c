@@ -0,0 +1,190 @@
+/*
+ * Multichannel to stereo downmix
+ *
+ * downmix_init() turns the matrix rows of the stream's speakers into at most
+ * DOWNMIX_MAX_CHANNELS (input, coefficient) taps per output, dropping zero
+ * gains. With normalize set, all coefficients are scaled by the larger of
+ * the two rows' absolute sums, a unit coming off those rounded up most
+ * where rounding took a row over unity, so full-scale input cannot clip.
+ * Without it,
+ * a row's coefficients lose fraction bits until the worst-case sum fits
+ * the 32-bit accumulator, and the output saturates.
+ *
+ * downmix_process() works on blocks of DOWNMIX_BLOCK frames. Each tap is one
+ * pass over the block, frames innermost, into a per-output accumulator: one
+ * multiply-accumulate per frame per tap, with the inner loop free of
+ * branches and table lookups. The block is then rounded and saturated into
+ * the interleaved output. The whole block is read before any of it is
+ * written, which makes the in-place case safe.
+ */
+
+#include "downmix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DOWNMIX_BLOCK   32
+#define GAIN_ONE        (1 << DOWNMIX_GAIN_BITS)
+#define GAIN_3DB        11585       // 1/sqrt(2), Q14
+
+static const char *const s_speaker_names[DOWNMIX_SPEAKERS] = {
+    "fl", "fr", "fc", "lfe", "bl", "br", "flc", "frc", "bc", "sl", "sr",
+};
+
+// Usual layouts when a WAV file gives no channel mask, by channel count.
+static const uint8_t s_wav_default[DOWNMIX_MAX_CHANNELS + 1][DOWNMIX_MAX_CHANNELS] = {
+    [3] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_FC },
+    [4] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_BL, DOWNMIX_BR },
+    [5] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_FC, DOWNMIX_BL, DOWNMIX_BR },
+    [6] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_FC, DOWNMIX_LFE, DOWNMIX_BL, DOWNMIX_BR },
+    [7] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_FC, DOWNMIX_LFE, DOWNMIX_BC, DOWNMIX_SL, DOWNMIX_SR },
+    [8] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_FC, DOWNMIX_LFE, DOWNMIX_BL, DOWNMIX_BR, DOWNMIX_SL, DOWNMIX_SR },
+};
+
+static const uint8_t s_vorbis_order[DOWNMIX_MAX_CHANNELS + 1][DOWNMIX_MAX_CHANNELS] = {
+    [3] = { DOWNMIX_FL, DOWNMIX_FC, DOWNMIX_FR },
+    [4] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_BL, DOWNMIX_BR },
+    [5] = { DOWNMIX_FL, DOWNMIX_FC, DOWNMIX_FR, DOWNMIX_BL, DOWNMIX_BR },
+    [6] = { DOWNMIX_FL, DOWNMIX_FC, DOWNMIX_FR, DOWNMIX_BL, DOWNMIX_BR, DOWNMIX_LFE },
+    [7] = { DOWNMIX_FL, DOWNMIX_FC, DOWNMIX_FR, DOWNMIX_SL, DOWNMIX_SR, DOWNMIX_BC, DOWNMIX_LFE },
+    [8] = { DOWNMIX_FL, DOWNMIX_FC, DOWNMIX_FR, DOWNMIX_SL, DOWNMIX_SR, DOWNMIX_BL, DOWNMIX_BR, DOWNMIX_LFE },
+};
+
+void downmix_matrix_itu(downmix_matrix_t *m) {
+    memset(m, 0, sizeof(*m));
+    m->gain[DOWNMIX_FL][0] = GAIN_ONE;
+    m->gain[DOWNMIX_FR][1] = GAIN_ONE;
+    m->gain[DOWNMIX_FC][0] = GAIN_3DB;
+    m->gain[DOWNMIX_FC][1] = GAIN_3DB;
+    m->gain[DOWNMIX_BL][0] = GAIN_3DB;
+    m->gain[DOWNMIX_BR][1] = GAIN_3DB;
+    m->gain[DOWNMIX_SL][0] = GAIN_3DB;
+    m->gain[DOWNMIX_SR][1] = GAIN_3DB;
+    // Front centre pair folds into the fronts, back centre into both sides.
+    m->gain[DOWNMIX_FLC][0] = GAIN_ONE;
+    m->gain[DOWNMIX_FRC][1] = GAIN_ONE;
+    m->gain[DOWNMIX_BC][0] = GAIN_ONE / 2;
+    m->gain[DOWNMIX_BC][1] = GAIN_ONE / 2;
+    m->normalize = true;
+}
+
+const char *downmix_speaker_name(downmix_speaker_t s) {
+    return s < DOWNMIX_SPEAKERS ? s_speaker_names[s] : NULL;
+}
+
+downmix_speaker_t downmix_speaker_from_name(const char *name) {
+    for (int s = 0; s < DOWNMIX_SPEAKERS; s++) {
+        if (strcmp(name, s_speaker_names[s]) == 0) {
+            return (downmix_speaker_t)s;
+        }
+    }
+    return DOWNMIX_NONE;
+}
+
+void downmix_layout_wav(uint32_t mask, int channels, uint8_t *layout) {
+    if (mask == 0) {
+        memcpy(layout, s_wav_default[channels], channels);
+        return;
+    }
+    // Channels follow the mask bits in ascending order; positions this
+    // matrix has no row for, and channels beyond the mask, are dropped.
+    int bit = 0;
+    for (int c = 0; c < channels; c++) {
+        while (bit < 32 && !(mask & (1u << bit))) {
+            bit++;
+        }
+        layout[c] = bit < DOWNMIX_SPEAKERS ? bit : DOWNMIX_NONE;
+        bit++;
+    }
+}
+
+void downmix_layout_vorbis(int channels, uint8_t *layout) {
+    memcpy(layout, s_vorbis_order[channels], channels);
+}
+
+void downmix_init(downmix_t *d, const downmix_matrix_t *m, const uint8_t *layout, int channels) {
+    memset(d, 0, sizeof(*d));
+    d->channels = channels;
+    int64_t sum[2] = { 0, 0 };
+    for (int o = 0; o < 2; o++) {
+        for (int c = 0; c < channels; c++) {
+            int32_t g = layout[c] < DOWNMIX_SPEAKERS ? m->gain[layout[c]][o] : 0;
+            if (g != 0) {
+                d->input[o][d->taps[o]] = c;
+                d->coef[o][d->taps[o]++] = g;
+                sum[o] += g < 0 ? -g : g;
+            }
+        }
+    }
+
+    int64_t peak = sum[0] > sum[1] ? sum[0] : sum[1];
+    for (int o = 0; o < 2; o++) {
+        if (m->normalize && peak > GAIN_ONE) {
+            sum[o] = 0;
+            int64_t up[DOWNMIX_MAX_CHANNELS];     // How far each magnitude was rounded up, over peak
+            for (int t = 0; t < d->taps[o]; t++) {
+                int64_t exact = (int64_t)abs(d->coef[o][t]) * GAIN_ONE;
+                int32_t mag = (exact + peak / 2) / peak;
+                up[t] = mag * peak - exact;
+                d->coef[o][t] = d->coef[o][t] < 0 ? -mag : mag;
+                sum[o] += mag;
+            }
+            // Rounding can leave the row a unit or two over unity; the
+            // coefficients rounded up the most give it back.
+            while (sum[o] > GAIN_ONE) {
+                int most = 0;
+                for (int t = 1; t < d->taps[o]; t++) {
+                    most = up[t] > up[most] ? t : most;
+                }
+                d->coef[o][most] -= d->coef[o][most] > 0 ? 1 : -1;
+                up[most] -= peak;
+                sum[o]--;
+            }
+        }
+        // Full-scale input on every tap, plus rounding, must fit in the
+        // accumulator.
+        d->shift[o] = DOWNMIX_GAIN_BITS;
+        while (sum[o] * 32768 >= INT32_MAX / 2) {
+            for (int t = 0; t < d->taps[o]; t++) {
+                d->coef[o][t] >>= 1;
+            }
+            sum[o] >>= 1;
+            d->shift[o]--;
+        }
+    }
+}
+
+void downmix_process(downmix_t *d, const int16_t *in, int16_t *out, size_t frames) {
+    const int channels = d->channels;
+    int32_t acc[2][DOWNMIX_BLOCK];
+
+    while (frames > 0) {
+        int n = frames < DOWNMIX_BLOCK ? frames : DOWNMIX_BLOCK;
+        for (int o = 0; o < 2; o++) {
+            int32_t *a = acc[o];
+            memset(a, 0, n * sizeof(*a));
+            for (int t = 0; t < d->taps[o]; t++) {
+                const int16_t *x = in + d->input[o][t];
+                const int32_t c = d->coef[o][t];
+                for (int f = 0; f < n; f++) {
+                    a[f] += c * x[f * channels];
+                }
+            }
+        }
+        for (int o = 0; o < 2; o++) {
+            const int shift = d->shift[o];
+            const int32_t round = 1 << (shift - 1);
+            for (int f = 0; f < n; f++) {
+                int32_t v = (acc[o][f] + round) >> shift;
+                if (v > INT16_MAX || v < INT16_MIN) {
+                    v = v > 0 ? INT16_MAX : INT16_MIN;
+                    d->clipped++;
+                }
+                out[2 * f + o] = v;
+            }
+        }
+        in += n * channels;
+        out += 2 * n;
+        frames -= n;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * Multichannel to stereo downmix in fixed point.
+ *
+ * A matrix gives every speaker position a left and a right gain. A stream's
+ * channel layout picks the rows it needs, and the result is compiled into a
+ * short list of taps per output, which is then applied to interleaved 16-bit
+ * PCM one block of frames at a time.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DOWNMIX_MAX_CHANNELS    8
+#define DOWNMIX_GAIN_BITS       14                      // Matrix gains are Q14
+#define DOWNMIX_GAIN_MAX        (2 << DOWNMIX_GAIN_BITS)    // +6 dB
+
+// Speaker positions in WAVE_FORMAT_EXTENSIBLE channel mask order.
+typedef enum {
+    DOWNMIX_FL,
+    DOWNMIX_FR,
+    DOWNMIX_FC,
+    DOWNMIX_LFE,
+    DOWNMIX_BL,
+    DOWNMIX_BR,
+    DOWNMIX_FLC,
+    DOWNMIX_FRC,
+    DOWNMIX_BC,
+    DOWNMIX_SL,
+    DOWNMIX_SR,
+    DOWNMIX_SPEAKERS,
+    DOWNMIX_NONE = DOWNMIX_SPEAKERS,    // Unknown position: dropped
+} downmix_speaker_t;
+
+typedef struct {
+    int32_t gain[DOWNMIX_SPEAKERS][2];  // Left and right gain, Q14
+    bool normalize;                     // Scale down so the mix cannot clip
+} downmix_matrix_t;
+
+typedef struct {
+    int channels;
+    int taps[2];                        // Inputs feeding each output
+    uint8_t input[2][DOWNMIX_MAX_CHANNELS];
+    int32_t coef[2][DOWNMIX_MAX_CHANNELS];
+    int shift[2];                       // Fraction bits of each output's coefs
+    uint32_t clipped;                   // Output samples saturated
+} downmix_t;
+
+// ITU-R BS.775 stereo downmix: centre and surrounds at -3 dB, LFE dropped,
+// normalised.
+void downmix_matrix_itu(downmix_matrix_t *m);
+
+// "fl", "lfe", ... or NULL.
+const char *downmix_speaker_name(downmix_speaker_t s);
+
+// DOWNMIX_NONE if name is not a speaker.
+downmix_speaker_t downmix_speaker_from_name(const char *name);
+
+// Fills layout[channels] from a WAVE_FORMAT_EXTENSIBLE channel mask, or
+// with the usual layout for the channel count if mask is 0.
+void downmix_layout_wav(uint32_t mask, int channels, uint8_t *layout);
+
+// Vorbis I channel order (specification section 4.3.9).
+void downmix_layout_vorbis(int channels, uint8_t *layout);
+
+// Compiles matrix rows for a stream of channels (3..DOWNMIX_MAX_CHANNELS)
+// with the given layout.
+void downmix_init(downmix_t *d, const downmix_matrix_t *m, const uint8_t *layout, int channels);
+
+// Mixes frames of interleaved input down to interleaved stereo. out may be
+// the same buffer as in.
+void downmix_process(downmix_t *d, const int16_t *in, int16_t *out, size_t frames);
@@ -0,0 +1,82 @@
+/*
+ * Downmix benchmark
+ *
+ * Mixes a block of synthetic multichannel audio (a different tone plus noise
+ * per channel, peaking near full scale) with the ITU matrix, in place as
+ * ingest does, timing it on the cycle counter. The output is checked against
+ * the same mix done in double precision from the compiled coefficients;
+ * anything above rounding (half an LSB) is a fixed-point regression.
+ */
+
+#include "downmix_bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "downmix.h"
+
+#define DOWNMIX_BENCH_FRAMES    1024
+
+static void fill_input(int16_t *pcm, int channels, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < frames; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            seed = seed * 1664525u + 1013904223u;
+            double tone = 24000.0 * sin(2 * M_PI * (220.0 * (ch + 1)) * i / 44100.0);
+            pcm[i * channels + ch] = (int16_t)(tone + (int32_t)(seed >> 16) / 8 - 4096);
+        }
+    }
+}
+
+static void downmix_bench(void) {
+    int16_t *in = malloc(DOWNMIX_BENCH_FRAMES * DOWNMIX_MAX_CHANNELS * sizeof(int16_t));
+    int16_t *work = malloc(DOWNMIX_BENCH_FRAMES * DOWNMIX_MAX_CHANNELS * sizeof(int16_t));
+    if (!in || !work) {
+        console_printf("downmix: out of memory\n");
+        goto done;
+    }
+
+    downmix_matrix_t m;
+    downmix_matrix_itu(&m);
+    console_printf("channels  taps L/R  cyc/frame  cpu@%dMHz  max err LSB  clipped\n", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    for (int channels = 3; channels <= DOWNMIX_MAX_CHANNELS; channels++) {
+        uint8_t layout[DOWNMIX_MAX_CHANNELS];
+        downmix_t d;
+        downmix_layout_wav(0, channels, layout);
+        downmix_init(&d, &m, layout, channels);
+        fill_input(in, channels, DOWNMIX_BENCH_FRAMES);
+        memcpy(work, in, DOWNMIX_BENCH_FRAMES * channels * sizeof(int16_t));
+
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        downmix_process(&d, work, work, DOWNMIX_BENCH_FRAMES);
+        uint32_t cycles = (esp_cpu_get_cycle_count() - t0) / DOWNMIX_BENCH_FRAMES;
+
+        double max_err = 0;
+        for (int f = 0; f < DOWNMIX_BENCH_FRAMES; f++) {
+            for (int o = 0; o < 2; o++) {
+                double ref = 0;
+                for (int t = 0; t < d.taps[o]; t++) {
+                    ref += (double)d.coef[o][t] * in[f * channels + d.input[o][t]];
+                }
+                ref = ldexp(ref, -d.shift[o]);
+                ref = ref > INT16_MAX ? INT16_MAX : (ref < INT16_MIN ? INT16_MIN : ref);
+                double err = fabs(work[2 * f + o] - ref);
+                max_err = err > max_err ? err : max_err;
+            }
+        }
+        double cpu = (double)cycles * AUDIO_SAMPLE_RATE / (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6) * 100;
+        console_printf("%8d  %4d/%-4d  %9lu  %8.2f%%  %11.2f  %7lu\n", channels, d.taps[0], d.taps[1],
+                       (unsigned long)cycles, cpu, max_err, (unsigned long)d.clipped);
+    }
+
+done:
+    free(in);
+    free(work);
+}
+
+void downmix_bench_init(void) {
+    console_register_bench("downmix", downmix_bench);
+}
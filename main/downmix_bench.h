@@ -0,0 +1,9 @@
+/*
+ * Downmix benchmark ("bench downmix"): cycles per frame for 3 to 8 channel
+ * layouts, plus the largest deviation from a double-precision mix.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void downmix_bench_init(void);
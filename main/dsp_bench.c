@@ -0,0 +1,168 @@
+/*
+ * DSP kernel benchmark
+ *
+ * Every kernel runs on the same block of noise twice, through dsp_* (esp-dsp
+ * when it is enabled) and through dsp_*_c, each from the same starting
+ * state, and the fastest of DSP_BENCH_RUNS runs is kept. The outputs are
+ * then compared: gain and mixing are one rounding per sample on either
+ * side, so they must match exactly; the biquad, FIR and FFT may differ by
+ * the fused multiply-adds and summation order of esp-dsp's assembly, so
+ * they are held to a limit relative to the largest output.
+ */
+
+#include "dsp_bench.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "bridge_console.h"
+#include "dsp_kernels.h"
+
+#define DSP_BENCH_N         1024    // Samples, or complex points for the FFT
+#define DSP_BENCH_TAPS      64
+#define DSP_BENCH_RUNS      8
+
+typedef struct {
+    const float *in;
+    const float *in2;
+    float *out;
+    dsp_fft_t fft;
+    float *fir_taps;
+    float *fir_state;
+} bench_ctx_t;
+
+typedef uint32_t (*bench_fn_t)(bench_ctx_t *b, bool fast);
+
+static uint32_t bench_gain(bench_ctx_t *b, bool fast) {
+    uint32_t t = esp_cpu_get_cycle_count();
+    (fast ? dsp_gain : dsp_gain_c)(b->in, b->out, DSP_BENCH_N, 0.7071f, 1, 1);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t bench_add(bench_ctx_t *b, bool fast) {
+    uint32_t t = esp_cpu_get_cycle_count();
+    (fast ? dsp_add : dsp_add_c)(b->in, b->in2, b->out, DSP_BENCH_N, 1, 1, 1);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t bench_sub(bench_ctx_t *b, bool fast) {
+    uint32_t t = esp_cpu_get_cycle_count();
+    (fast ? dsp_sub : dsp_sub_c)(b->in, b->in2, b->out, DSP_BENCH_N, 1, 1, 1);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t bench_biquad(bench_ctx_t *b, bool fast) {
+    biquad_t q;
+    dsp_biquad_t f;
+    biquad_peak(&q, 1000, 6, 1, 44100);
+    dsp_biquad_from_q28(&f, &q);
+    uint32_t t = esp_cpu_get_cycle_count();
+    (fast ? dsp_biquad : dsp_biquad_c)(&f, b->in, b->out, DSP_BENCH_N);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t bench_fir(bench_ctx_t *b, bool fast) {
+    dsp_fir_t f;
+    for (int i = 0; i < DSP_BENCH_TAPS; i++) {
+        b->fir_taps[i] = b->in2[i] / DSP_BENCH_TAPS;     // Asymmetric, so tap order shows
+    }
+    dsp_fir_init(&f, b->fir_taps, b->fir_state, DSP_BENCH_TAPS);
+    uint32_t t = esp_cpu_get_cycle_count();
+    (fast ? dsp_fir : dsp_fir_c)(&f, b->in, b->out, DSP_BENCH_N);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t bench_fft(bench_ctx_t *b, bool fast) {
+    memcpy(b->out, b->in, 2 * DSP_BENCH_N * sizeof(float));
+    uint32_t t = esp_cpu_get_cycle_count();
+    (fast ? dsp_fft : dsp_fft_c)(&b->fft, b->out, DSP_BENCH_N, false);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static const struct {
+    const char *name;
+    bench_fn_t fn;
+    int outputs;                // Floats written
+    float limit;                // Largest difference allowed, relative to the largest output
+} s_kernels[] = {
+    { "gain",   bench_gain,   DSP_BENCH_N,     0 },
+    { "add",    bench_add,    DSP_BENCH_N,     0 },
+    { "sub",    bench_sub,    DSP_BENCH_N,     0 },
+    { "biquad", bench_biquad, DSP_BENCH_N,     1e-5f },
+    { "fir64",  bench_fir,    DSP_BENCH_N,     1e-5f },
+    { "fft",    bench_fft,    2 * DSP_BENCH_N, 1e-5f },
+};
+
+static uint32_t fastest(bench_ctx_t *b, bench_fn_t fn, bool fast) {
+    uint32_t best = UINT32_MAX;
+    for (int r = 0; r < DSP_BENCH_RUNS; r++) {
+        uint32_t cycles = fn(b, fast);
+        best = cycles < best ? cycles : best;
+    }
+    return best;
+}
+
+static void dsp_bench(void) {
+    float *in = malloc(2 * DSP_BENCH_N * sizeof(float));
+    float *in2 = malloc(DSP_BENCH_N * sizeof(float));
+    float *out_fast = malloc(2 * DSP_BENCH_N * sizeof(float));
+    float *out_c = malloc(2 * DSP_BENCH_N * sizeof(float));
+    float *table = malloc(DSP_FFT_TABLE_LEN(DSP_BENCH_N) * sizeof(float));
+    float *taps = malloc(DSP_BENCH_TAPS * sizeof(float));
+    float *state = malloc(DSP_FIR_STATE_LEN(DSP_BENCH_TAPS) * sizeof(float));
+    bench_ctx_t b = { .in = in, .in2 = in2, .fir_taps = taps, .fir_state = state };
+    if (!in || !in2 || !out_fast || !out_c || !table || !taps || !state) {
+        console_printf("dsp: out of memory\n");
+        goto done;
+    }
+    if (!dsp_fft_init(&b.fft, table, DSP_BENCH_N)) {
+        console_printf("dsp: esp-dsp's FFT table is too small or could not be allocated\n");
+        goto done;
+    }
+    uint32_t seed = 12345;
+    for (int i = 0; i < 2 * DSP_BENCH_N; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        in[i] = (int32_t)seed * (1.0f / 2147483648.0f);
+        if (i < DSP_BENCH_N) {
+            in2[i] = in[i] * in[i] - 0.3f;
+        }
+    }
+
+    bool fast = DSP_KERNELS_ESP_DSP;
+    console_printf("kernels run on %s; %d samples per call, cycles per sample:\n", dsp_kernels_backend(),
+                   DSP_BENCH_N);
+    for (int k = 0; k < sizeof(s_kernels) / sizeof(s_kernels[0]); k++) {
+        b.out = out_c;
+        uint32_t c = fastest(&b, s_kernels[k].fn, false);
+        if (!fast) {
+            console_printf("%-7s C %7.2f\n", s_kernels[k].name, (double)c / DSP_BENCH_N);
+            continue;
+        }
+        b.out = out_fast;
+        uint32_t f = fastest(&b, s_kernels[k].fn, true);
+        float peak = 0, diff = 0;
+        for (int i = 0; i < s_kernels[k].outputs; i++) {
+            peak = fmaxf(peak, fabsf(out_c[i]));
+            diff = fmaxf(diff, fabsf(out_fast[i] - out_c[i]));
+        }
+        float rel = peak > 0 ? diff / peak : diff;
+        console_printf("%-7s esp-dsp %7.2f  C %7.2f  %5.2fx  diff %.1e of peak (limit %.0e) %s\n",
+                       s_kernels[k].name, (double)f / DSP_BENCH_N, (double)c / DSP_BENCH_N, (double)c / f, rel,
+                       s_kernels[k].limit, rel <= s_kernels[k].limit ? "ok" : "FAIL");
+    }
+
+done:
+    free(in);
+    free(in2);
+    free(out_fast);
+    free(out_c);
+    free(table);
+    free(taps);
+    free(state);
+}
+
+void dsp_bench_init(void) {
+    console_register_bench("dsp", dsp_bench);
+}
@@ -0,0 +1,10 @@
+/*
+ * DSP kernel benchmark ("bench dsp"): cycles per sample of each kernel in
+ * dsp_kernels.h on esp-dsp and in portable C, the speedup, and how far the
+ * two outputs are apart.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void dsp_bench_init(void);
@@ -0,0 +1,251 @@
+/*
+ * DSP kernels
+ *
+ * The C versions follow esp-dsp's reference (ANSI) code where there is one,
+ * so the two differ only in rounding: esp-dsp's assembly uses the FPU's
+ * fused multiply-add, and its FIR sums in another order than our eight
+ * partial sums. The FIR delay line is held twice over (each sample written
+ * at pos and pos + count) so the window is always contiguous and the dot
+ * product needs no wrap.
+ *
+ * esp-dsp keeps a single FFT table, sized by the first dsp_fft_init(); its
+ * FFT is forward only, so the inverse conjugates before and after.
+ */
+
+#include "dsp_kernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if DSP_KERNELS_ESP_DSP
+#include "esp_dsp.h"
+
+static int s_esp_fft_max_n = 0;
+#endif
+
+const char *dsp_kernels_backend(void) {
+    return DSP_KERNELS_ESP_DSP ? "esp-dsp" : "c";
+}
+
+// --- Gain and mixing ---
+void dsp_gain_c(const float *in, float *out, int n, float gain, int step_in, int step_out) {
+    if (step_in == 1 && step_out == 1) {
+        for (int i = 0; i < n; i++) {
+            out[i] = in[i] * gain;
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        out[i * step_out] = in[i * step_in] * gain;
+    }
+}
+
+void dsp_add_c(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out) {
+    if (step_a == 1 && step_b == 1 && step_out == 1) {
+        for (int i = 0; i < n; i++) {
+            out[i] = a[i] + b[i];
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        out[i * step_out] = a[i * step_a] + b[i * step_b];
+    }
+}
+
+void dsp_sub_c(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out) {
+    if (step_a == 1 && step_b == 1 && step_out == 1) {
+        for (int i = 0; i < n; i++) {
+            out[i] = a[i] - b[i];
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        out[i * step_out] = a[i * step_a] - b[i * step_b];
+    }
+}
+
+void dsp_gain(const float *in, float *out, int n, float gain, int step_in, int step_out) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_mulc_f32(in, out, n, gain, step_in, step_out);
+#else
+    dsp_gain_c(in, out, n, gain, step_in, step_out);
+#endif
+}
+
+void dsp_add(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_add_f32(a, b, out, n, step_a, step_b, step_out);
+#else
+    dsp_add_c(a, b, out, n, step_a, step_b, step_out);
+#endif
+}
+
+void dsp_sub(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_sub_f32(a, b, out, n, step_a, step_b, step_out);
+#else
+    dsp_sub_c(a, b, out, n, step_a, step_b, step_out);
+#endif
+}
+
+// --- Biquad ---
+void dsp_biquad_from_q28(dsp_biquad_t *f, const biquad_t *q) {
+    const float scale = 1.0f / (1 << BIQUAD_COEF_BITS);
+    f->coef[0] = q->b0 * scale;
+    f->coef[1] = q->b1 * scale;
+    f->coef[2] = q->b2 * scale;
+    f->coef[3] = q->a1 * scale;
+    f->coef[4] = q->a2 * scale;
+    f->w[0] = f->w[1] = 0;
+}
+
+void dsp_biquad_c(dsp_biquad_t *f, const float *in, float *out, int n) {
+    const float b0 = f->coef[0], b1 = f->coef[1], b2 = f->coef[2], a1 = f->coef[3], a2 = f->coef[4];
+    float w1 = f->w[0], w2 = f->w[1];
+    for (int i = 0; i < n; i++) {
+        float w = in[i] - a1 * w1 - a2 * w2;
+        out[i] = b0 * w + b1 * w1 + b2 * w2;
+        w2 = w1;
+        w1 = w;
+    }
+    f->w[0] = w1;
+    f->w[1] = w2;
+}
+
+void dsp_biquad(dsp_biquad_t *f, const float *in, float *out, int n) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_biquad_f32(in, out, n, f->coef, f->w);
+#else
+    dsp_biquad_c(f, in, out, n);
+#endif
+}
+
+// --- FIR ---
+// Eight running sums: one AVX register or two SSE/NEON ones, so the loop
+// vectorizes as written, with no reassociation left to the compiler.
+static float dot(const float *a, const float *b, int n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, s5 = 0, s6 = 0, s7 = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+        s4 += a[i + 4] * b[i + 4];
+        s5 += a[i + 5] * b[i + 5];
+        s6 += a[i + 6] * b[i + 6];
+        s7 += a[i + 7] * b[i + 7];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return ((s0 + s1) + (s2 + s3)) + ((s4 + s5) + (s6 + s7));
+}
+
+void dsp_fir_init(dsp_fir_t *f, const float *h, float *state, int count) {
+    f->taps = state;
+    f->delay = state + count;
+    f->count = count;
+    f->pos = 0;
+    for (int i = 0; i < count; i++) {
+        f->taps[i] = h[count - 1 - i];
+    }
+    memset(f->delay, 0, 2 * count * sizeof(float));
+#if DSP_KERNELS_ESP_DSP
+    // esp-dsp also pairs its first coefficient with the oldest sample.
+    dsps_fir_init_f32(&f->fir, f->taps, f->delay, count);
+#endif
+}
+
+void dsp_fir_c(dsp_fir_t *f, const float *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        float x = in[i];
+        f->delay[f->pos] = x;
+        f->delay[f->pos + f->count] = x;
+        if (++f->pos == f->count) {
+            f->pos = 0;
+        }
+        out[i] = dot(f->taps, f->delay + f->pos, f->count);     // Oldest first
+    }
+}
+
+void dsp_fir(dsp_fir_t *f, const float *in, float *out, int n) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_fir_f32(&f->fir, in, out, n);
+#else
+    dsp_fir_c(f, in, out, n);
+#endif
+}
+
+// --- FFT ---
+bool dsp_fft_init(dsp_fft_t *t, float *table, int max_n) {
+    t->twiddle = table;
+    t->max_n = max_n;
+    for (int k = 0; k < max_n / 2; k++) {
+        double a = -2 * M_PI * k / max_n;
+        table[2 * k] = (float)cos(a);
+        table[2 * k + 1] = (float)sin(a);
+    }
+#if DSP_KERNELS_ESP_DSP
+    if (s_esp_fft_max_n == 0) {
+        if (dsps_fft2r_init_fc32(NULL, max_n) != ESP_OK) {
+            return false;
+        }
+        s_esp_fft_max_n = max_n;
+    }
+    return max_n <= s_esp_fft_max_n;
+#else
+    return true;
+#endif
+}
+
+void dsp_fft_c(const dsp_fft_t *t, float *x, int n, bool inverse) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            float re = x[2 * i], im = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = re;
+            x[2 * j + 1] = im;
+        }
+    }
+    float sign = inverse ? -1.0f : 1.0f;
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        int step = t->max_n / len;
+        for (int start = 0; start < n; start += len) {
+            float *a = x + 2 * start;
+            float *b = a + 2 * half;
+            for (int k = 0; k < half; k++) {
+                float wr = t->twiddle[2 * k * step];
+                float wi = sign * t->twiddle[2 * k * step + 1];
+                float br = b[2 * k] * wr - b[2 * k + 1] * wi;
+                float bi = b[2 * k] * wi + b[2 * k + 1] * wr;
+                b[2 * k] = a[2 * k] - br;
+                b[2 * k + 1] = a[2 * k + 1] - bi;
+                a[2 * k] += br;
+                a[2 * k + 1] += bi;
+            }
+        }
+    }
+}
+
+void dsp_fft(const dsp_fft_t *t, float *x, int n, bool inverse) {
+#if DSP_KERNELS_ESP_DSP
+    if (inverse) {
+        dsps_mulc_f32(x + 1, x + 1, n, -1.0f, 2, 2);
+    }
+    dsps_fft2r_fc32(x, n);
+    dsps_bit_rev_fc32_ansi(x, n);
+    if (inverse) {
+        dsps_mulc_f32(x + 1, x + 1, n, -1.0f, 2, 2);
+    }
+#else
+    dsp_fft_c(t, x, n, inverse);
+#endif
+}
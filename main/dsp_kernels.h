@@ -0,0 +1,102 @@
+/*
+ * DSP kernels: the inner loops of gain, mixing, biquads, FIRs and FFTs on
+ * float32 blocks.
+ *
+ * On the ESP32 (with CONFIG_BRIDGE_DSP_ESP_DSP) they run esp-dsp's routines,
+ * hand-written for the core's FPU. Everywhere else, the Linux host included,
+ * they are plain C written for the compiler to vectorize: unit-stride
+ * counted loops, and dot products kept in eight partial sums so no
+ * -ffast-math is needed. The C versions are always built and reachable as
+ * dsp_*_c so "bench dsp" can time and check one against the other on the
+ * device.
+ *
+ * Blocks are planar (one channel); gain, add and sub take strides so they
+ * work across interleaved frames.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "biquad.h"
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if defined(ESP_PLATFORM) && CONFIG_BRIDGE_DSP_ESP_DSP
+#define DSP_KERNELS_ESP_DSP     1
+#include "dsps_fir.h"
+#else
+#define DSP_KERNELS_ESP_DSP     0
+#endif
+
+#define DSP_FFT_MAX_N           4096
+#define DSP_FFT_TABLE_LEN(max_n)    (max_n)     // Floats in a twiddle table
+#define DSP_FIR_STATE_LEN(taps)     (3 * (taps))     // Floats of state per filter
+
+// Direct form II, coefficients normalized by a0 with the RBJ cookbook's
+// signs: w = x - a1 w1 - a2 w2, y = b0 w + b1 w1 + b2 w2.
+typedef struct {
+    float coef[5];              // b0, b1, b2, a1, a2
+    float w[2];
+} dsp_biquad_t;
+
+typedef struct {
+    float *taps;                // Impulse response, oldest sample's tap first
+    float *delay;               // Delay line, held twice over
+    int count;
+    int pos;
+#if DSP_KERNELS_ESP_DSP
+    fir_f32_t fir;
+#endif
+} dsp_fir_t;
+
+typedef struct {
+    float *twiddle;             // cos, sin of -2 pi k / max_n for k < max_n / 2
+    int max_n;
+} dsp_fft_t;
+
+// Name of the implementation dsp_* runs: "esp-dsp" or "c".
+const char *dsp_kernels_backend(void);
+
+// out[i * step_out] = in[i * step_in] * gain, for i < n. in may be out.
+void dsp_gain(const float *in, float *out, int n, float gain, int step_in, int step_out);
+void dsp_gain_c(const float *in, float *out, int n, float gain, int step_in, int step_out);
+
+// out[i * step_out] = a[i * step_a] + b[i * step_b], for i < n. a or b may be out.
+void dsp_add(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out);
+void dsp_add_c(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out);
+
+// out[i * step_out] = a[i * step_a] - b[i * step_b], for i < n. a or b may be out.
+void dsp_sub(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out);
+void dsp_sub_c(const float *a, const float *b, float *out, int n, int step_a, int step_b, int step_out);
+
+// Makes f the section designed by biquad.h's functions, with its state
+// cleared. Q28 holds those coefficients more finely than a float does.
+void dsp_biquad_from_q28(dsp_biquad_t *f, const biquad_t *q);
+
+// Filters n samples; in may be out.
+void dsp_biquad(dsp_biquad_t *f, const float *in, float *out, int n);
+void dsp_biquad_c(dsp_biquad_t *f, const float *in, float *out, int n);
+
+// Sets up f for the count taps of h, newest sample's tap first. The taps
+// are copied, reversed, into state (DSP_FIR_STATE_LEN(count) floats, owned
+// by the caller), which also holds the delay line; h is not kept. A filter
+// should be run with dsp_fir() or dsp_fir_c(), not both.
+void dsp_fir_init(dsp_fir_t *f, const float *h, float *state, int count);
+
+// Filters n samples; in may be out.
+void dsp_fir(dsp_fir_t *f, const float *in, float *out, int n);
+void dsp_fir_c(dsp_fir_t *f, const float *in, float *out, int n);
+
+// Fills table (DSP_FFT_TABLE_LEN(max_n) floats, owned by the caller) for
+// transforms up to max_n points, a power of two up to DSP_FFT_MAX_N, and
+// readies esp-dsp's own table. Returns false if esp-dsp could not.
+bool dsp_fft_init(dsp_fft_t *t, float *table, int max_n);
+
+// In-place transform of n interleaved (re, im) points, a power of two up to
+// max_n, in natural order and unscaled: inverse uses exp(+2 pi i jk / n), so
+// a forward transform followed by an inverse one multiplies the input by n.
+void dsp_fft(const dsp_fft_t *t, float *x, int n, bool inverse);
+void dsp_fft_c(const dsp_fft_t *t, float *x, int n, bool inverse);
@@ -0,0 +1,215 @@
+/*
+ * Multiband compressor stage
+ *
+ * The writer copies a chunk of its data into s_block, compresses it under
+ * s_lock and passes it to the sink after releasing the lock, so console
+ * changes never wait on a full playback buffer. Parameter changes keep the
+ * filter and gain state, so adjusting a band while listening does not click.
+ */
+
+#include "dynamics.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bridge_console.h"
+#include "compressor.h"
+#include "telemetry.h"
+
+#define DYNAMICS_CHUNK_FRAMES   256
+
+static const char *TAG = "DYNAMICS";
+
+static const char *const s_band_names[COMPRESSOR_BANDS] = { "low", "mid", "high" };
+
+static SemaphoreHandle_t s_lock = NULL;
+
+// Under s_lock.
+static compressor_t s_comp;
+static compressor_params_t s_params;
+static bool s_enabled = false;
+
+// Writer only.
+static int16_t s_block[DYNAMICS_CHUNK_FRAMES * AUDIO_CHANNELS];
+
+// Written by the writer, read by telemetry.
+static volatile uint32_t s_busy_us = 0;
+
+static uint32_t s_reported_busy_us = 0;
+static int64_t s_reported_us = 0;
+
+// --- Audio path ---
+size_t dynamics_write(const void *data, size_t len, audio_sink_t sink, void *ctx) {
+    const int16_t *pcm = data;
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+    size_t sent = 0;
+
+    while (frames > 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (!s_enabled) {
+            xSemaphoreGive(s_lock);
+            return sent + sink(pcm, len - sent, ctx);
+        }
+        size_t n = frames < DYNAMICS_CHUNK_FRAMES ? frames : DYNAMICS_CHUNK_FRAMES;
+        memcpy(s_block, pcm, n * AUDIO_BYTES_PER_FRAME);
+        int64_t start = esp_timer_get_time();
+        compressor_process(&s_comp, s_block, n);
+        s_busy_us += esp_timer_get_time() - start;
+        xSemaphoreGive(s_lock);
+
+        size_t bytes = n * AUDIO_BYTES_PER_FRAME;
+        size_t accepted = sink(s_block, bytes, ctx);
+        sent += accepted;
+        if (accepted < bytes) {
+            return sent;
+        }
+        pcm += n * AUDIO_CHANNELS;
+        frames -= n;
+    }
+    return sent;
+}
+
+void dynamics_reset(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    compressor_init(&s_comp, &s_params, AUDIO_SAMPLE_RATE);
+    xSemaphoreGive(s_lock);
+}
+
+// --- Console and telemetry ---
+static int dynamics_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    uint32_t busy_us = s_busy_us;
+    double span_us = s_reported_us ? now - s_reported_us : 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = snprintf(buf, len, "on=%d gr_low=%.1f gr_mid=%.1f gr_high=%.1f clipped=%lu cpu=%.1f%%", s_enabled,
+                     compressor_reduction_db(&s_comp, 0), compressor_reduction_db(&s_comp, 1),
+                     compressor_reduction_db(&s_comp, 2), (unsigned long)s_comp.clipped,
+                     span_us > 0 ? (busy_us - s_reported_busy_us) / span_us * 100 : 0.0);
+    xSemaphoreGive(s_lock);
+    s_reported_busy_us = busy_us;
+    s_reported_us = now;
+    return n;
+}
+
+static void print_status(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    console_printf("comp %s: crossovers %.0f Hz and %.0f Hz, %lu clipped\n", s_enabled ? "on" : "off",
+                   s_params.crossover_hz[0], s_params.crossover_hz[1], (unsigned long)s_comp.clipped);
+    console_printf("  band  threshold  ratio  knee  attack  release  makeup  reduction\n");
+    for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+        const compressor_band_params_t *p = &s_params.band[b];
+        console_printf("  %-4s  %5.1f dB  %5.1f  %4.1f  %4.1f ms  %4.0f ms  %+4.1f   %5.1f dB\n", s_band_names[b],
+                       p->threshold_db, p->ratio, p->knee_db, p->attack_ms, p->release_ms, p->makeup_db,
+                       compressor_reduction_db(&s_comp, b));
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// Points at the field of p named name, checking value against its range.
+static float *band_field(compressor_band_params_t *p, const char *name, float value) {
+    struct {
+        const char *name;
+        float *field;
+        float min, max;
+    } fields[] = {
+        { "threshold", &p->threshold_db, -60, 0 },
+        { "ratio", &p->ratio, 1, 20 },
+        { "knee", &p->knee_db, 0, 24 },
+        { "attack", &p->attack_ms, 0.1f, 500 },
+        { "release", &p->release_ms, 1, 5000 },
+        { "makeup", &p->makeup_db, -12, 24 },
+    };
+    for (int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (strcmp(name, fields[i].name) == 0) {
+            if (value < fields[i].min || value > fields[i].max) {
+                console_printf("%s must be from %g to %g\n", name, fields[i].min, fields[i].max);
+                return NULL;
+            }
+            return fields[i].field;
+        }
+    }
+    console_printf("Unknown setting '%s'\n", name);
+    return NULL;
+}
+
+static void set_enabled(bool on) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (on && !s_enabled) {
+        compressor_init(&s_comp, &s_params, AUDIO_SAMPLE_RATE);
+    }
+    s_enabled = on;
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "Compressor %s", on ? "on" : "off");
+}
+
+static int cmd_comp(int argc, char **argv) {
+    if (argc < 2) {
+        print_status();
+        console_printf("Usage: comp on | off | night | xover <hz> <hz> | <low|mid|high> "
+                       "<threshold|ratio|knee|attack|release|makeup> <value>\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0) {
+        set_enabled(argv[1][1] == 'n');
+        return 0;
+    }
+    if (strcmp(argv[1], "night") == 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        compressor_params_night(&s_params);
+        compressor_configure(&s_comp, &s_params);
+        xSemaphoreGive(s_lock);
+        set_enabled(true);
+        return 0;
+    }
+
+    compressor_params_t p;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    p = s_params;
+    xSemaphoreGive(s_lock);
+    if (strcmp(argv[1], "xover") == 0 && argc > 3) {
+        float f0 = atof(argv[2]);
+        float f1 = atof(argv[3]);
+        if (f0 < 40 || f1 > 16000 || f1 < 2 * f0) {
+            console_printf("Crossovers must be from 40 Hz to 16 kHz, the second at least an octave above the first\n");
+            return -1;
+        }
+        p.crossover_hz[0] = f0;
+        p.crossover_hz[1] = f1;
+    } else {
+        int b = 0;
+        while (b < COMPRESSOR_BANDS && strcmp(argv[1], s_band_names[b]) != 0) {
+            b++;
+        }
+        if (b == COMPRESSOR_BANDS || argc < 4) {
+            console_printf("Unknown argument '%s'\n", argv[1]);
+            return -1;
+        }
+        float value = atof(argv[3]);
+        float *field = band_field(&p.band[b], argv[2], value);
+        if (field == NULL) {
+            return -1;
+        }
+        *field = value;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_params = p;
+    compressor_configure(&s_comp, &s_params);
+    xSemaphoreGive(s_lock);
+    return 0;
+}
+
+void dynamics_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    compressor_params_night(&s_params);
+    compressor_init(&s_comp, &s_params, AUDIO_SAMPLE_RATE);
+    console_register("comp", "Multiband compressor: comp [on | off | night | xover <hz> <hz> | <band> <setting> <value>]",
+                     cmd_comp);
+    telemetry_register("comp", dynamics_telemetry);
+}
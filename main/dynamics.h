@@ -0,0 +1,21 @@
+/*
+ * Multiband compressor in the playback path, for listening to films at low
+ * volume: quiet dialogue comes up and loud effects come down. Off until
+ * enabled on the console ("comp on" or "comp night"); adds no latency.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "audio_bridge.h"
+
+// Registers the "comp" command and telemetry.
+void dynamics_init(void);
+
+// Compresses len bytes of interleaved stereo and hands the result to sink.
+// Returns the bytes sink accepted. One writer at a time.
+size_t dynamics_write(const void *data, size_t len, audio_sink_t sink, void *ctx);
+
+// Clears filter and gain state; call from the writer when a different
+// producer takes over.
+void dynamics_reset(void);
@@ -0,0 +1,79 @@
+/*
+ * Fixed-point radix-2 complex FFT
+ *
+ * Decimation in time: a bit-reversal permutation, then log2(n) butterfly
+ * stages. The twiddle exp(-2 pi i j / len) of a stage is read from the
+ * quarter-wave table for the first quadrant and by symmetry for the second;
+ * the inverse transform only flips its imaginary part.
+ */
+
+#include "fft.h"
+
+#include <math.h>
+
+void fft_init(fft_t *t, int32_t *table, int max_n) {
+    t->sine = table;
+    t->quarter = max_n / 4;
+    for (int i = 0; i <= t->quarter; i++) {
+        double v = sin(M_PI / 2 * i / t->quarter) * 2147483648.0;
+        table[i] = v >= 2147483647.0 ? INT32_MAX : (int32_t)lrint(v);
+    }
+}
+
+static inline int32_t mul31(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 31);
+}
+
+void fft_complex(const fft_t *t, int32_t *x, int n, bool inverse) {
+    for (int i = 0, j = 0; i < n; i++) {
+        if (i < j) {
+            int32_t re = x[2 * i];
+            int32_t im = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = re;
+            x[2 * j + 1] = im;
+        }
+        int bit = n >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        int q = len / 4 > 0 ? len / 4 : 1;
+        for (int j = 0; j < half; j++) {
+            // exp(-2 pi i j / len), from the first or second quadrant
+            int32_t wr, wi, s, c;
+            if (len == 2) {
+                wr = INT32_MAX;
+                wi = 0;
+            } else if (j < q) {
+                fft_sincos(t, j, q, &s, &c);
+                wr = c;
+                wi = -s;
+            } else {
+                fft_sincos(t, j - q, q, &s, &c);
+                wr = -s;
+                wi = -c;
+            }
+            if (inverse) {
+                wi = -wi;
+            }
+            for (int i = j; i < n; i += len) {
+                int32_t *a = &x[2 * i];
+                int32_t *b = &x[2 * (i + half)];
+                int32_t br = (mul31(b[0], wr) - mul31(b[1], wi)) >> 1;
+                int32_t bi = (mul31(b[0], wi) + mul31(b[1], wr)) >> 1;
+                int32_t ar = a[0] >> 1;
+                int32_t ai = a[1] >> 1;
+                a[0] = ar + br;
+                a[1] = ai + bi;
+                b[0] = ar - br;
+                b[1] = ai - bi;
+            }
+        }
+    }
+}
@@ -0,0 +1,40 @@
+/*
+ * Fixed-point radix-2 complex FFT shared by the IMDCT, the convolver and
+ * anything else that needs a transform.
+ *
+ * Points are interleaved (re, im) int32_t pairs. Every stage halves its
+ * output, so the result is the DFT divided by n and can never grow beyond
+ * the largest input magnitude: inputs up to 2^30 are always safe. Twiddles
+ * come from one quarter-wave sine table that serves every size up to the
+ * one it was built for.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Entries of the sine table needed for transforms up to max_n points.
+#define FFT_TABLE_LEN(max_n)    ((max_n) / 4 + 1)
+
+typedef struct {
+    int32_t *sine;          // sin(pi/2 * i / quarter), Q31
+    int quarter;            // max_n / 4
+} fft_t;
+
+// Fills table (FFT_TABLE_LEN(max_n) entries, owned by the caller).
+void fft_init(fft_t *t, int32_t *table, int max_n);
+
+// sin and cos of pi/2 * j / q, Q31, for q a power of two up to max_n / 4.
+static inline void fft_sincos(const fft_t *t, int j, int q, int32_t *s, int32_t *c) {
+    int step = t->quarter / q;
+    *s = t->sine[j * step];
+    *c = t->sine[(q - j) * step];
+}
+
+// In-place transform of n complex points (a power of two up to max_n),
+// scaled by 1/n. inverse uses exp(+2 pi i jk / n), so a forward transform
+// followed by an inverse one returns the input divided by n.
+void fft_complex(const fft_t *t, int32_t *x, int n, bool inverse);
@@ -0,0 +1,192 @@
+/*
+ * Fixed point against float32 benchmark
+ *
+ * Each stage is set up afresh and run on the same noise through its
+ * fixed-point and its float32 process function, and the fastest of
+ * FLOAT_BENCH_RUNS runs is kept. "convert" is the float pipeline's own
+ * overhead, the conversion to float and the dithered conversion back, which
+ * every float stage pays and the fixed-point stages fold into their loops.
+ * The ratio is fixed-point cycles over float cycles, so above 1 the float
+ * stage is faster.
+ *
+ * The outputs are compared in LSBs. Dither and rounding alone put them
+ * about 0.5 LSB rms and 2 LSB peak apart; anything well above that is one
+ * pipeline's arithmetic. The limiter and compressor, whose gains follow the
+ * signal, can add a little more. During loudness steps the two part by tens
+ * of LSBs: each new filter set takes over the old one's state, and the
+ * float sections' direct form II state carries over far more closely than
+ * the fixed-point direct form I history does.
+ */
+
+#include "float_bench.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "compressor.h"
+#include "headphone_dsp.h"
+#include "loudness_eq.h"
+#include "pcm_float.h"
+
+#define FLOAT_BENCH_FRAMES  1024
+#define FLOAT_BENCH_RUNS    4
+
+typedef union {
+    compressor_t comp;
+    loudness_eq_t loud;
+    headphone_dsp_t hp;
+} engine_t;
+
+// Sets up a stage in e, then times it on frames of pcm.
+typedef uint32_t (*stage_fn_t)(engine_t *e, int16_t *pcm, bool use_float);
+
+static void fill_noise(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 4 - 8192;
+    }
+}
+
+static uint32_t stage_convert(engine_t *e, int16_t *pcm, bool use_float) {
+    float l[PCM_FLOAT_BLOCK], r[PCM_FLOAT_BLOCK];
+    pcm_dither_t dither = { 0 };
+    uint32_t t = esp_cpu_get_cycle_count();
+    for (int f = 0; f < FLOAT_BENCH_FRAMES; f += PCM_FLOAT_BLOCK) {
+        pcm_to_float(pcm + 2 * f, l, r, PCM_FLOAT_BLOCK, 1);
+        pcm_from_float(&dither, l, r, pcm + 2 * f, PCM_FLOAT_BLOCK);
+    }
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t stage_comp(engine_t *e, int16_t *pcm, bool use_float) {
+    compressor_params_t p;
+    compressor_params_night(&p);
+    compressor_init(&e->comp, &p, AUDIO_SAMPLE_RATE);
+    uint32_t t = esp_cpu_get_cycle_count();
+    (use_float ? compressor_process_float : compressor_process_fixed)(&e->comp, pcm, FLOAT_BENCH_FRAMES);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t stage_loud(engine_t *e, int16_t *pcm, bool use_float) {
+    loudness_eq_init(&e->loud, 100, 10000, AUDIO_SAMPLE_RATE);
+    loudness_eq_set(&e->loud, 12, 3);
+    loudness_eq_settle(&e->loud);
+    uint32_t t = esp_cpu_get_cycle_count();
+    (use_float ? loudness_eq_process_float : loudness_eq_process_fixed)(&e->loud, pcm, FLOAT_BENCH_FRAMES);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+// Stepping from flat toward +12/+3 dB: every frame is in a crossfade.
+static uint32_t stage_loud_fade(engine_t *e, int16_t *pcm, bool use_float) {
+    loudness_eq_init(&e->loud, 100, 10000, AUDIO_SAMPLE_RATE);
+    loudness_eq_set(&e->loud, 12, 3);
+    uint32_t t = esp_cpu_get_cycle_count();
+    (use_float ? loudness_eq_process_float : loudness_eq_process_fixed)(&e->loud, pcm, FLOAT_BENCH_FRAMES);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+// Four EQ bands, crossfeed and a limiter that the boosts keep busy.
+static uint32_t stage_hp(engine_t *e, int16_t *pcm, bool use_float) {
+    headphone_dsp_params_t p;
+    headphone_dsp_params_flat(&p);
+    p.gain_db = 3;
+    p.band[0] = (headphone_eq_band_t){ HEADPHONE_EQ_LOW_SHELF, 105, 4, 0.7f };
+    p.band[1] = (headphone_eq_band_t){ HEADPHONE_EQ_PEAK, 200, -2, 1.0f };
+    p.band[2] = (headphone_eq_band_t){ HEADPHONE_EQ_PEAK, 3000, 3, 2.0f };
+    p.band[3] = (headphone_eq_band_t){ HEADPHONE_EQ_HIGH_SHELF, 9000, -3, 0.7f };
+    p.crossfeed = true;
+    p.limiter = true;
+    headphone_dsp_compile(&e->hp, &p, AUDIO_SAMPLE_RATE);
+    uint32_t t = esp_cpu_get_cycle_count();
+    (use_float ? headphone_dsp_process_float : headphone_dsp_process_fixed)(&e->hp, pcm, FLOAT_BENCH_FRAMES);
+    return esp_cpu_get_cycle_count() - t;
+}
+
+static uint32_t clipped(const engine_t *e, stage_fn_t fn) {
+    if (fn == stage_comp) {
+        return e->comp.clipped;
+    }
+    if (fn == stage_hp) {
+        return e->hp.clipped;
+    }
+    return fn == stage_convert ? 0 : e->loud.clipped;
+}
+
+static const struct {
+    const char *name;
+    stage_fn_t fn;
+    bool fixed;                 // Has a fixed-point side
+} s_stages[] = {
+    { "convert",   stage_convert,   false },
+    { "comp",      stage_comp,      true },
+    { "loud",      stage_loud,      true },
+    { "loud-fade", stage_loud_fade, true },
+    { "hp",        stage_hp,        true },
+};
+
+// Fastest run; out holds the last run's output and *clip its clipped count.
+static uint32_t fastest(engine_t *e, stage_fn_t fn, bool use_float, const int16_t *in, int16_t *out,
+                        uint32_t *clip) {
+    uint32_t best = UINT32_MAX;
+    for (int r = 0; r < FLOAT_BENCH_RUNS; r++) {
+        memcpy(out, in, FLOAT_BENCH_FRAMES * AUDIO_BYTES_PER_FRAME);
+        uint32_t cycles = fn(e, out, use_float);
+        best = cycles < best ? cycles : best;
+    }
+    *clip = clipped(e, fn);
+    return best;
+}
+
+static void float_bench(void) {
+    const size_t bytes = FLOAT_BENCH_FRAMES * AUDIO_BYTES_PER_FRAME;
+    int16_t *in = malloc(bytes);
+    int16_t *out_fixed = malloc(bytes);
+    int16_t *out_float = malloc(bytes);
+    engine_t *e = malloc(sizeof(*e));
+    if (!in || !out_fixed || !out_float || !e) {
+        console_printf("float: out of memory\n");
+        goto done;
+    }
+    fill_noise(in, FLOAT_BENCH_FRAMES);
+
+    double mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    console_printf("pipeline in use: %s; kernels on %s\n", DSP_FLOAT_PIPELINE ? "float32" : "fixed point",
+                   dsp_kernels_backend());
+    console_printf("cycles per frame over %d frames (%.1f is 1%% cpu@%dMHz):\n", FLOAT_BENCH_FRAMES,
+                   mhz * 1e6 / AUDIO_SAMPLE_RATE / 100, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    for (int s = 0; s < sizeof(s_stages) / sizeof(s_stages[0]); s++) {
+        uint32_t clip_float, clip_fixed;
+        uint32_t fl = fastest(e, s_stages[s].fn, true, in, out_float, &clip_float);
+        if (!s_stages[s].fixed) {
+            console_printf("%-9s  fixed       -  float %7.1f\n", s_stages[s].name, (double)fl / FLOAT_BENCH_FRAMES);
+            continue;
+        }
+        uint32_t fx = fastest(e, s_stages[s].fn, false, in, out_fixed, &clip_fixed);
+        double sum = 0;
+        int peak = 0;
+        for (int i = 0; i < 2 * FLOAT_BENCH_FRAMES; i++) {
+            int d = abs(out_float[i] - out_fixed[i]);
+            sum += (double)d * d;
+            peak = d > peak ? d : peak;
+        }
+        console_printf("%-9s  fixed %7.1f  float %7.1f  %5.2fx  diff %.2f rms %d peak LSB  clipped %lu/%lu\n",
+                       s_stages[s].name, (double)fx / FLOAT_BENCH_FRAMES, (double)fl / FLOAT_BENCH_FRAMES,
+                       (double)fx / fl, sqrt(sum / (2 * FLOAT_BENCH_FRAMES)), peak, (unsigned long)clip_fixed,
+                       (unsigned long)clip_float);
+    }
+
+done:
+    free(in);
+    free(out_fixed);
+    free(out_float);
+    free(e);
+}
+
+void float_bench_init(void) {
+    console_register_bench("float", float_bench);
+}
@@ -0,0 +1,9 @@
+/*
+ * Fixed point against float32 ("bench float"): cycles per frame of each
+ * processing stage in both pipelines, and how far their outputs are apart.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void float_bench_init(void);
@@ -0,0 +1,217 @@
+/*
+ * Headphone processing chain
+ *
+ * Samples run at 12 extra bits as in the compressor. Crossfeed mixes each
+ * channel with a low-passed copy of the other (the head shadows high
+ * frequencies from the far speaker, and the low-pass adds roughly the
+ * interaural delay), scaled so a centred low note keeps its level.
+ *
+ * The limiter has instant attack and exponential release: when a frame's
+ * peak would exceed the ceiling the gain drops to exactly meet it, so
+ * nothing leaves above the ceiling, and it recovers toward unity after.
+ *
+ * The float32 chain runs the same designed sections in planar blocks through
+ * the DSP kernels, with the gain folded into the conversion from 16 bits;
+ * only the limiter, whose gain depends on the frame before, is a per-frame
+ * loop. Its coefficients are taken from the fixed-point ones, so the two
+ * chains differ only in arithmetic.
+ */
+
+#include "headphone_dsp.h"
+
+#include <math.h>
+#include <string.h>
+
+#define INTERNAL_SHIFT  12
+#define GAIN_BITS       28
+#define LIMITER_BITS    30
+
+static int32_t q(double v, int bits) {
+    return (int32_t)lrint(v * ((int64_t)1 << bits));
+}
+
+void headphone_dsp_params_flat(headphone_dsp_params_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->crossfeed_db = 6;
+    p->crossfeed_hz = 700;
+    p->limiter_db = -1;
+    p->limiter_release_ms = 100;
+}
+
+void headphone_dsp_compile(headphone_dsp_t *d, const headphone_dsp_params_t *p, uint32_t rate) {
+    memset(d, 0, sizeof(*d));
+    d->gain = q(pow(10, p->gain_db / 20), GAIN_BITS);
+    for (int b = 0; b < HEADPHONE_DSP_MAX_BANDS; b++) {
+        const headphone_eq_band_t *band = &p->band[b];
+        float q_ = band->q > 0 ? band->q : M_SQRT1_2;
+        biquad_t *f = &d->eq[d->bands];
+        switch (band->type) {
+            case HEADPHONE_EQ_PEAK:
+                biquad_peak(f, band->hz, band->gain_db, q_, rate);
+                break;
+            case HEADPHONE_EQ_LOW_SHELF:
+                biquad_low_shelf(f, band->hz, band->gain_db, q_, rate);
+                break;
+            case HEADPHONE_EQ_HIGH_SHELF:
+                biquad_high_shelf(f, band->hz, band->gain_db, q_, rate);
+                break;
+            default:
+                continue;
+        }
+        d->bands++;
+    }
+
+    d->crossfeed = p->crossfeed;
+    if (d->crossfeed) {
+        double cross = pow(10, -p->crossfeed_db / 20);
+        biquad_lowpass(&d->xf_lp, p->crossfeed_hz, 0.5f, rate);
+        d->xf_direct = q(1 / (1 + cross), GAIN_BITS);
+        d->xf_cross = q(cross / (1 + cross), GAIN_BITS);
+    }
+
+    d->limiter = p->limiter;
+    d->ceiling = q(pow(10, p->limiter_db / 20) * INT16_MAX, INTERNAL_SHIFT);
+    d->release = q(1 - exp(-1000.0 / (rate * fmax(p->limiter_release_ms, 1))), LIMITER_BITS);
+    d->lim_gain = 1 << LIMITER_BITS;
+
+    d->bypass = d->gain == 1 << GAIN_BITS && d->bands == 0 && !d->crossfeed && !d->limiter;
+
+    d->gain_f = d->gain * (1.0f / (1 << GAIN_BITS));
+    for (int b = 0; b < d->bands; b++) {
+        dsp_biquad_from_q28(&d->eq_f[b][0], &d->eq[b]);
+        d->eq_f[b][1] = d->eq_f[b][0];
+    }
+    if (d->crossfeed) {
+        float cross = d->xf_cross * (1.0f / (1 << GAIN_BITS));
+        dsp_biquad_from_q28(&d->xf_lp_f[0], &d->xf_lp);
+        for (int i = 0; i < 3; i++) {
+            d->xf_lp_f[0].coef[i] *= cross;
+        }
+        d->xf_lp_f[1] = d->xf_lp_f[0];
+        d->xf_direct_f = d->xf_direct * (1.0f / (1 << GAIN_BITS));
+    }
+    d->ceiling_f = d->ceiling * (1.0f / (1 << (15 + INTERNAL_SHIFT)));
+    d->release_f = d->release * (1.0f / (1 << LIMITER_BITS));
+    d->lim_gain_f = 1;
+}
+
+void headphone_dsp_reset(headphone_dsp_t *d) {
+    memset(d->eq_state, 0, sizeof(d->eq_state));
+    memset(d->xf_state, 0, sizeof(d->xf_state));
+    d->lim_gain = 1 << LIMITER_BITS;
+    for (int b = 0; b < HEADPHONE_DSP_MAX_BANDS; b++) {
+        for (int ch = 0; ch < 2; ch++) {
+            d->eq_f[b][ch].w[0] = d->eq_f[b][ch].w[1] = 0;
+        }
+    }
+    for (int ch = 0; ch < 2; ch++) {
+        d->xf_lp_f[ch].w[0] = d->xf_lp_f[ch].w[1] = 0;
+    }
+    d->lim_gain_f = 1;
+}
+
+static inline int16_t output(headphone_dsp_t *d, int32_t v) {
+    v = (v + (1 << (INTERNAL_SHIFT - 1))) >> INTERNAL_SHIFT;
+    if (v > INT16_MAX || v < INT16_MIN) {
+        d->clipped++;
+        return v > 0 ? INT16_MAX : INT16_MIN;
+    }
+    return v;
+}
+
+// --- Fixed point ---
+void headphone_dsp_process_fixed(headphone_dsp_t *d, int16_t *pcm, size_t frames) {
+    if (d->bypass) {
+        return;
+    }
+    for (size_t f = 0; f < frames; f++, pcm += 2) {
+        int32_t x[2];
+        for (int ch = 0; ch < 2; ch++) {
+            int32_t v = (int32_t)(((int64_t)pcm[ch] * d->gain) >> (GAIN_BITS - INTERNAL_SHIFT));
+            for (int b = 0; b < d->bands; b++) {
+                v = biquad_process(&d->eq[b], &d->eq_state[b][ch], v);
+            }
+            x[ch] = v;
+        }
+
+        if (d->crossfeed) {
+            int32_t lp_l = biquad_process(&d->xf_lp, &d->xf_state[0], x[0]);
+            int32_t lp_r = biquad_process(&d->xf_lp, &d->xf_state[1], x[1]);
+            int32_t l = (int32_t)(((int64_t)x[0] * d->xf_direct + (int64_t)lp_r * d->xf_cross) >> GAIN_BITS);
+            int32_t r = (int32_t)(((int64_t)x[1] * d->xf_direct + (int64_t)lp_l * d->xf_cross) >> GAIN_BITS);
+            x[0] = l;
+            x[1] = r;
+        }
+
+        if (d->limiter) {
+            uint32_t peak_l = x[0] < 0 ? -(uint32_t)x[0] : (uint32_t)x[0];
+            uint32_t peak_r = x[1] < 0 ? -(uint32_t)x[1] : (uint32_t)x[1];
+            uint32_t peak = peak_l > peak_r ? peak_l : peak_r;
+            int32_t g = d->lim_gain;
+            if (((uint64_t)peak * g) >> LIMITER_BITS > (uint32_t)d->ceiling) {
+                g = (int32_t)(((uint64_t)d->ceiling << LIMITER_BITS) / peak);
+                d->limited++;
+            }
+            x[0] = (int32_t)(((int64_t)x[0] * g) >> LIMITER_BITS);
+            x[1] = (int32_t)(((int64_t)x[1] * g) >> LIMITER_BITS);
+            d->lim_gain = g + (int32_t)(((int64_t)((1 << LIMITER_BITS) - g) * d->release) >> LIMITER_BITS);
+        }
+
+        pcm[0] = output(d, x[0]);
+        pcm[1] = output(d, x[1]);
+    }
+}
+
+// --- Float32 ---
+void headphone_dsp_process_float(headphone_dsp_t *d, int16_t *pcm, size_t frames) {
+    float l[PCM_FLOAT_BLOCK], r[PCM_FLOAT_BLOCK];
+    float lp_l[PCM_FLOAT_BLOCK], lp_r[PCM_FLOAT_BLOCK];
+
+    if (d->bypass) {
+        return;
+    }
+    while (frames > 0) {
+        int n = frames < PCM_FLOAT_BLOCK ? frames : PCM_FLOAT_BLOCK;
+        pcm_to_float(pcm, l, r, n, d->gain_f);
+        for (int b = 0; b < d->bands; b++) {
+            dsp_biquad(&d->eq_f[b][0], l, l, n);
+            dsp_biquad(&d->eq_f[b][1], r, r, n);
+        }
+
+        if (d->crossfeed) {
+            dsp_biquad(&d->xf_lp_f[0], l, lp_l, n);
+            dsp_biquad(&d->xf_lp_f[1], r, lp_r, n);
+            dsp_gain(l, l, n, d->xf_direct_f, 1, 1);
+            dsp_gain(r, r, n, d->xf_direct_f, 1, 1);
+            dsp_add(l, lp_r, l, n, 1, 1, 1);
+            dsp_add(r, lp_l, r, n, 1, 1, 1);
+        }
+
+        if (d->limiter) {
+            float g = d->lim_gain_f;
+            for (int i = 0; i < n; i++) {
+                float peak = fmaxf(fabsf(l[i]), fabsf(r[i]));
+                if (peak * g > d->ceiling_f) {
+                    g = d->ceiling_f / peak;
+                    d->limited++;
+                }
+                l[i] *= g;
+                r[i] *= g;
+                g += (1 - g) * d->release_f;
+            }
+            d->lim_gain_f = g;
+        }
+
+        d->clipped += pcm_from_float(&d->dither, l, r, pcm, n);
+        pcm += 2 * n;
+        frames -= n;
+    }
+}
+
+void headphone_dsp_process(headphone_dsp_t *d, int16_t *pcm, size_t frames) {
+#if DSP_FLOAT_PIPELINE
+    headphone_dsp_process_float(d, pcm, frames);
+#else
+    headphone_dsp_process_fixed(d, pcm, frames);
+#endif
+}
@@ -0,0 +1,91 @@
+/*
+ * Per-headphone processing chain for 16-bit stereo PCM: gain, a parametric
+ * EQ, crossfeed and a peak limiter, in that order. It runs in fixed point,
+ * or in float32 when DSP_FLOAT_PIPELINE is set (see pcm_float.h).
+ *
+ * Parameters are compiled into coefficients once, so a chain can be kept
+ * ready for each pair of headphones and switched to without any design
+ * work on the audio path.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "biquad.h"
+#include "pcm_float.h"
+
+#define HEADPHONE_DSP_MAX_BANDS     8
+
+typedef enum {
+    HEADPHONE_EQ_OFF,
+    HEADPHONE_EQ_PEAK,
+    HEADPHONE_EQ_LOW_SHELF,
+    HEADPHONE_EQ_HIGH_SHELF,
+} headphone_eq_type_t;
+
+typedef struct {
+    uint8_t type;                           // headphone_eq_type_t
+    float hz;
+    float gain_db;
+    float q;
+} headphone_eq_band_t;
+
+typedef struct {
+    float gain_db;                          // Applied first
+    headphone_eq_band_t band[HEADPHONE_DSP_MAX_BANDS];
+    bool crossfeed;
+    float crossfeed_db;                     // Level of the other channel, below the direct one
+    float crossfeed_hz;                     // Its low-pass cutoff
+    bool limiter;
+    float limiter_db;                       // Ceiling, dBFS
+    float limiter_release_ms;
+} headphone_dsp_params_t;
+
+typedef struct {
+    int bands;
+    biquad_t eq[HEADPHONE_DSP_MAX_BANDS];
+    biquad_state_t eq_state[HEADPHONE_DSP_MAX_BANDS][2];   // [band][channel]
+    int32_t gain;                           // Q28
+    bool crossfeed;
+    biquad_t xf_lp;
+    biquad_state_t xf_state[2];
+    int32_t xf_direct, xf_cross;            // Q28, summing to one
+    bool limiter;
+    int32_t ceiling;                        // Internal sample units
+    int32_t release;                        // Recovery per frame, Q30
+    int32_t lim_gain;                       // Current limiter gain, Q30
+    bool bypass;                            // Nothing to do
+    // Float32 pipeline: the same sections, held once per channel
+    dsp_biquad_t eq_f[HEADPHONE_DSP_MAX_BANDS][2];
+    dsp_biquad_t xf_lp_f[2];                // With xf_cross folded into its numerator
+    float gain_f;
+    float xf_direct_f;
+    float ceiling_f;                        // Full scale is 1
+    float release_f;
+    float lim_gain_f;
+    pcm_dither_t dither;
+    uint32_t limited;                       // Frames the limiter pulled down
+    uint32_t clipped;
+} headphone_dsp_t;
+
+// A chain that leaves audio untouched, with the usual crossfeed and limiter
+// settings filled in but switched off.
+void headphone_dsp_params_flat(headphone_dsp_params_t *p);
+
+// Builds d from p for audio at rate Hz, with clear state.
+void headphone_dsp_compile(headphone_dsp_t *d, const headphone_dsp_params_t *p, uint32_t rate);
+
+// Forgets past audio, keeping the coefficients.
+void headphone_dsp_reset(headphone_dsp_t *d);
+
+// Processes frames of interleaved stereo in place, in the pipeline
+// DSP_FLOAT_PIPELINE selects.
+void headphone_dsp_process(headphone_dsp_t *d, int16_t *pcm, size_t frames);
+
+// The two pipelines, for benchmarking; a chain should stay on one of them.
+void headphone_dsp_process_fixed(headphone_dsp_t *d, int16_t *pcm, size_t frames);
+void headphone_dsp_process_float(headphone_dsp_t *d, int16_t *pcm, size_t frames);
@@ -0,0 +1,488 @@
+/*
+ * Headphone presets
+ *
+ * NVS holds one blob per preset, keyed by the address as twelve hex digits
+ * (or "default"). s_cache mirrors it with every preset compiled. The live
+ * chain is a copy of a cached one, so switching is a memcpy under s_lock;
+ * the chain it replaces keeps running in s_outgoing for PRESET_FADE_FRAMES
+ * while the output crossfades to the new one.
+ *
+ * Console edits change the live chain immediately and are kept for the
+ * connected headphones only once saved.
+ */
+
+#include "headphone_presets.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "bridge_console.h"
+#include "headphone_dsp.h"
+#include "telemetry.h"
+
+#define PRESET_VERSION          1
+#define PRESET_KEY_LEN          13          // Twelve hex digits and a NUL
+#define PRESET_DEFAULT_KEY      "default"
+#define PRESET_CHUNK_FRAMES     256
+#define PRESET_FADE_BITS        8
+#define PRESET_FADE_FRAMES      (1 << PRESET_FADE_BITS)
+
+static const char *TAG = "HP_PRESETS";
+
+typedef struct {
+    uint32_t version;
+    headphone_dsp_params_t params;
+} preset_record_t;
+
+typedef struct {
+    bool used;
+    char key[PRESET_KEY_LEN];
+    headphone_dsp_params_t params;
+    headphone_dsp_t dsp;
+} preset_slot_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+
+// Console and Bluetooth tasks, under s_lock.
+static preset_slot_t s_cache[HEADPHONE_PRESETS_MAX];
+static char s_connected[PRESET_KEY_LEN] = "";   // Headphones last connected
+static char s_source[PRESET_KEY_LEN] = "flat";  // Where the live settings came from
+static bool s_edited = false;                   // Live settings differ from s_source
+static headphone_dsp_params_t s_live_params;
+static headphone_dsp_params_t s_flat_params;    // Compiled into s_flat at init
+static headphone_dsp_t s_flat;                  // Static: too big for the Bluetooth task's stack
+
+// Audio path, under s_lock.
+static headphone_dsp_t s_live;
+static headphone_dsp_t s_outgoing;
+static int s_fade = 0;                          // Frames of crossfade to go
+static uint32_t s_switches = 0;
+
+// Writer only.
+static int16_t s_block[PRESET_CHUNK_FRAMES * AUDIO_CHANNELS];
+static int16_t s_fade_block[PRESET_CHUNK_FRAMES * AUDIO_CHANNELS];
+
+// --- Cache and NVS ---
+static void format_key(const uint8_t bda[6], char *key) {
+    snprintf(key, PRESET_KEY_LEN, "%02x%02x%02x%02x%02x%02x", bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+}
+
+// Accepts aa:bb:cc:dd:ee:ff, aabbccddeeff or "default".
+static bool parse_key(const char *text, char *key) {
+    if (strcmp(text, PRESET_DEFAULT_KEY) == 0) {
+        strcpy(key, PRESET_DEFAULT_KEY);
+        return true;
+    }
+    unsigned b[6];
+    if (sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6 &&
+        sscanf(text, "%2x%2x%2x%2x%2x%2x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) {
+        return false;
+    }
+    uint8_t bda[6];
+    for (int i = 0; i < 6; i++) {
+        bda[i] = b[i];
+    }
+    format_key(bda, key);
+    return true;
+}
+
+static preset_slot_t *find_slot(const char *key) {
+    for (int i = 0; i < HEADPHONE_PRESETS_MAX; i++) {
+        if (s_cache[i].used && strcmp(s_cache[i].key, key) == 0) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static preset_slot_t *free_slot(void) {
+    for (int i = 0; i < HEADPHONE_PRESETS_MAX; i++) {
+        if (!s_cache[i].used) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void load_presets(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(HEADPHONE_PRESETS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;     // Nothing saved yet
+    }
+    nvs_iterator_t it = NULL;
+    esp_err_t res = nvs_entry_find(NVS_DEFAULT_PART_NAME, HEADPHONE_PRESETS_NAMESPACE, NVS_TYPE_BLOB, &it);
+    while (res == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        preset_record_t rec;
+        size_t len = sizeof(rec);
+        preset_slot_t *slot = free_slot();
+        if (slot == NULL) {
+            ESP_LOGW(TAG, "More than %d presets stored; ignoring '%s'", HEADPHONE_PRESETS_MAX, info.key);
+        } else if (nvs_get_blob(nvs, info.key, &rec, &len) != ESP_OK || len != sizeof(rec) ||
+                   rec.version != PRESET_VERSION || strlen(info.key) >= PRESET_KEY_LEN) {
+            ESP_LOGW(TAG, "Preset '%s' is from another firmware version; ignoring it", info.key);
+        } else {
+            slot->used = true;
+            strcpy(slot->key, info.key);
+            slot->params = rec.params;
+            headphone_dsp_compile(&slot->dsp, &rec.params, AUDIO_SAMPLE_RATE);
+        }
+        res = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    nvs_close(nvs);
+}
+
+// Writes params under key, or erases key if params is NULL.
+static esp_err_t store_preset(const char *key, const headphone_dsp_params_t *params) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(HEADPHONE_PRESETS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        if (params != NULL) {
+            preset_record_t rec = { .version = PRESET_VERSION, .params = *params };
+            err = nvs_set_blob(nvs, key, &rec, sizeof(rec));
+        } else {
+            err = nvs_erase_key(nvs, key);
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    return err;
+}
+
+// --- Switching ---
+// Under s_lock. Makes dsp the live chain, fading from the current one.
+static void go_live(const headphone_dsp_t *dsp, const headphone_dsp_params_t *params, const char *source) {
+    s_outgoing = s_live;
+    s_live = *dsp;
+    headphone_dsp_reset(&s_live);
+    s_fade = PRESET_FADE_FRAMES;
+    s_live_params = *params;
+    snprintf(s_source, sizeof(s_source), "%s", source);
+    s_edited = false;
+    s_switches++;
+}
+
+// Under s_lock. The preset for the connected headphones, else the default,
+// else a flat chain.
+static void apply_for_connected(void) {
+    preset_slot_t *slot = find_slot(s_connected);
+    if (slot == NULL) {
+        slot = find_slot(PRESET_DEFAULT_KEY);
+    }
+    if (slot != NULL) {
+        go_live(&slot->dsp, &slot->params, slot->key);
+        return;
+    }
+    go_live(&s_flat, &s_flat_params, "flat");
+}
+
+void headphone_presets_connected(const uint8_t bda[6]) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    format_key(bda, s_connected);
+    apply_for_connected();
+    ESP_LOGI(TAG, "Headphones %s: using preset '%s'", s_connected, s_source);
+    xSemaphoreGive(s_lock);
+}
+
+// --- Audio path ---
+size_t headphone_presets_write(const void *data, size_t len, audio_sink_t sink, void *ctx) {
+    const int16_t *pcm = data;
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+    size_t sent = 0;
+
+    while (frames > 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (s_live.bypass && s_fade == 0) {
+            xSemaphoreGive(s_lock);
+            return sent + sink(pcm, len - sent, ctx);
+        }
+        size_t n = frames < PRESET_CHUNK_FRAMES ? frames : PRESET_CHUNK_FRAMES;
+        memcpy(s_block, pcm, n * AUDIO_BYTES_PER_FRAME);
+        if (s_fade > 0) {
+            memcpy(s_fade_block, pcm, n * AUDIO_BYTES_PER_FRAME);
+            headphone_dsp_process(&s_outgoing, s_fade_block, n);
+        }
+        headphone_dsp_process(&s_live, s_block, n);
+        for (size_t f = 0; f < n && s_fade > 0; f++, s_fade--) {
+            int k = PRESET_FADE_FRAMES - s_fade + 1;
+            for (int ch = 0; ch < 2; ch++) {
+                int32_t from = s_fade_block[2 * f + ch];
+                s_block[2 * f + ch] = from + (((s_block[2 * f + ch] - from) * k) >> PRESET_FADE_BITS);
+            }
+        }
+        xSemaphoreGive(s_lock);
+
+        size_t bytes = n * AUDIO_BYTES_PER_FRAME;
+        size_t accepted = sink(s_block, bytes, ctx);
+        sent += accepted;
+        if (accepted < bytes) {
+            return sent;
+        }
+        pcm += n * AUDIO_CHANNELS;
+        frames -= n;
+    }
+    return sent;
+}
+
+void headphone_presets_reset(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    headphone_dsp_reset(&s_live);
+    s_fade = 0;
+    xSemaphoreGive(s_lock);
+}
+
+// --- Console and telemetry ---
+static int presets_telemetry(char *buf, size_t len) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = snprintf(buf, len, "preset=%s%s switches=%lu limited=%lu clipped=%lu", s_source, s_edited ? "*" : "",
+                     (unsigned long)s_switches, (unsigned long)s_live.limited, (unsigned long)s_live.clipped);
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+static const char *const s_type_names[] = { "off", "peak", "low", "high" };
+
+static void print_params(const headphone_dsp_params_t *p) {
+    console_printf("  gain %+.1f dB\n", p->gain_db);
+    for (int b = 0; b < HEADPHONE_DSP_MAX_BANDS; b++) {
+        const headphone_eq_band_t *band = &p->band[b];
+        if (band->type != HEADPHONE_EQ_OFF) {
+            console_printf("  eq %d %-4s %7.1f Hz %+5.1f dB q %.2f\n", b + 1, s_type_names[band->type], band->hz,
+                           band->gain_db, band->q);
+        }
+    }
+    if (p->crossfeed) {
+        console_printf("  crossfeed -%.1f dB below %.0f Hz\n", p->crossfeed_db, p->crossfeed_hz);
+    }
+    if (p->limiter) {
+        console_printf("  limiter %.1f dBFS, %.0f ms release\n", p->limiter_db, p->limiter_release_ms);
+    }
+}
+
+static void print_status(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    console_printf("Headphones %s, preset '%s'%s\n", s_connected[0] ? s_connected : "(none connected)", s_source,
+                   s_edited ? " with unsaved changes" : "");
+    print_params(&s_live_params);
+    console_printf("Stored:");
+    for (int i = 0; i < HEADPHONE_PRESETS_MAX; i++) {
+        if (s_cache[i].used) {
+            console_printf(" %s", s_cache[i].key);
+        }
+    }
+    console_printf("\n");
+    xSemaphoreGive(s_lock);
+}
+
+// Applies an edited copy of the live settings.
+static void apply_edit(const headphone_dsp_params_t *p) {
+    headphone_dsp_t *dsp = malloc(sizeof(*dsp));
+    if (dsp == NULL) {
+        console_printf("Out of memory\n");
+        return;
+    }
+    headphone_dsp_compile(dsp, p, AUDIO_SAMPLE_RATE);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    char source[PRESET_KEY_LEN];
+    strcpy(source, s_source);
+    go_live(dsp, p, source);
+    s_edited = true;
+    xSemaphoreGive(s_lock);
+    free(dsp);
+}
+
+static int save(const char *key) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    headphone_dsp_params_t p = s_live_params;
+    xSemaphoreGive(s_lock);
+
+    headphone_dsp_t *dsp = malloc(sizeof(*dsp));
+    if (dsp == NULL) {
+        console_printf("Out of memory\n");
+        return -1;
+    }
+    headphone_dsp_compile(dsp, &p, AUDIO_SAMPLE_RATE);
+    int ret = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    preset_slot_t *slot = find_slot(key);
+    if (slot == NULL) {
+        slot = free_slot();
+    }
+    if (slot == NULL) {
+        console_printf("All %d preset slots are used; erase one first\n", HEADPHONE_PRESETS_MAX);
+        ret = -1;
+    } else if (store_preset(key, &p) != ESP_OK) {
+        console_printf("Unable to write NVS\n");
+        ret = -1;
+    } else {
+        slot->used = true;
+        strcpy(slot->key, key);
+        slot->params = p;
+        slot->dsp = *dsp;
+        strcpy(s_source, key);
+        s_edited = false;
+    }
+    xSemaphoreGive(s_lock);
+    free(dsp);
+    return ret;
+}
+
+static int erase(const char *key) {
+    int ret = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    preset_slot_t *slot = find_slot(key);
+    if (slot == NULL) {
+        console_printf("No preset '%s'\n", key);
+        ret = -1;
+    } else if (store_preset(key, NULL) != ESP_OK) {
+        console_printf("Unable to write NVS\n");
+        ret = -1;
+    } else {
+        slot->used = false;
+        if (strcmp(s_source, key) == 0) {
+            apply_for_connected();
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+static int parse_type(const char *name) {
+    for (int t = 0; t < sizeof(s_type_names) / sizeof(s_type_names[0]); t++) {
+        if (strcmp(name, s_type_names[t]) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+static int cmd_preset(int argc, char **argv) {
+    if (argc < 2) {
+        print_status();
+        console_printf("Usage: preset gain <dB> | eq <1-%d> <peak|low|high> <hz> <dB> [q] | eq <n> off |\n"
+                       "       crossfeed <dB> [hz] | crossfeed off | limiter <dBFS> [release ms] | limiter off |\n"
+                       "       save [default] | erase <address|default> | reload\n",
+                       HEADPHONE_DSP_MAX_BANDS);
+        return 0;
+    }
+
+    char key[PRESET_KEY_LEN];
+    if (strcmp(argv[1], "save") == 0) {
+        if (argc > 2) {
+            if (!parse_key(argv[2], key)) {
+                console_printf("Expected an address or 'default'\n");
+                return -1;
+            }
+        } else if (s_connected[0]) {
+            strcpy(key, s_connected);
+        } else {
+            console_printf("No headphones connected; use 'preset save default'\n");
+            return -1;
+        }
+        return save(key);
+    }
+    if (strcmp(argv[1], "erase") == 0 && argc > 2) {
+        if (!parse_key(argv[2], key)) {
+            console_printf("Expected an address or 'default'\n");
+            return -1;
+        }
+        return erase(key);
+    }
+    if (strcmp(argv[1], "reload") == 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        apply_for_connected();
+        xSemaphoreGive(s_lock);
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    headphone_dsp_params_t p = s_live_params;
+    xSemaphoreGive(s_lock);
+    bool off = argc > 2 && strcmp(argv[2], "off") == 0;
+    if (strcmp(argv[1], "gain") == 0 && argc > 2) {
+        float db = atof(argv[2]);
+        if (db < -24 || db > 12) {
+            console_printf("Gain must be from -24 to +12 dB\n");
+            return -1;
+        }
+        p.gain_db = db;
+    } else if (strcmp(argv[1], "eq") == 0 && argc > 3) {
+        int b = atoi(argv[2]) - 1;
+        int type = parse_type(argv[3]);
+        if (b < 0 || b >= HEADPHONE_DSP_MAX_BANDS || type < 0) {
+            console_printf("Expected a band from 1 to %d and peak, low, high or off\n", HEADPHONE_DSP_MAX_BANDS);
+            return -1;
+        }
+        headphone_eq_band_t band = { .type = type, .q = M_SQRT1_2 };
+        if (type != HEADPHONE_EQ_OFF) {
+            if (argc < 6) {
+                console_printf("Expected a frequency and a gain\n");
+                return -1;
+            }
+            band.hz = atof(argv[4]);
+            band.gain_db = atof(argv[5]);
+            band.q = argc > 6 ? atof(argv[6]) : band.q;
+            if (band.hz < 20 || band.hz > 20000 || band.gain_db < -18 || band.gain_db > 18 || band.q < 0.1f ||
+                band.q > 20) {
+                console_printf("Expected 20-20000 Hz, -18 to +18 dB and q from 0.1 to 20\n");
+                return -1;
+            }
+        }
+        p.band[b] = band;
+    } else if (strcmp(argv[1], "crossfeed") == 0 && argc > 2) {
+        p.crossfeed = !off;
+        if (!off) {
+            p.crossfeed_db = atof(argv[2]);
+            p.crossfeed_hz = argc > 3 ? atof(argv[3]) : p.crossfeed_hz;
+            if (p.crossfeed_db < 1 || p.crossfeed_db > 30 || p.crossfeed_hz < 200 || p.crossfeed_hz > 2000) {
+                console_printf("Expected a level 1-30 dB below the direct signal and 200-2000 Hz\n");
+                return -1;
+            }
+        }
+    } else if (strcmp(argv[1], "limiter") == 0 && argc > 2) {
+        p.limiter = !off;
+        if (!off) {
+            p.limiter_db = atof(argv[2]);
+            p.limiter_release_ms = argc > 3 ? atof(argv[3]) : p.limiter_release_ms;
+            if (p.limiter_db < -30 || p.limiter_db > 0 || p.limiter_release_ms < 1 || p.limiter_release_ms > 2000) {
+                console_printf("Expected a ceiling from -30 to 0 dBFS and 1-2000 ms release\n");
+                return -1;
+            }
+        }
+    } else {
+        console_printf("Unknown argument '%s'\n", argv[1]);
+        return -1;
+    }
+    apply_edit(&p);
+    return 0;
+}
+
+void headphone_presets_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    headphone_dsp_params_flat(&s_flat_params);
+    headphone_dsp_compile(&s_flat, &s_flat_params, AUDIO_SAMPLE_RATE);
+    load_presets();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    apply_for_connected();
+    s_fade = 0;
+    s_switches = 0;
+    xSemaphoreGive(s_lock);
+    int count = 0;
+    for (int i = 0; i < HEADPHONE_PRESETS_MAX; i++) {
+        count += s_cache[i].used;
+    }
+    ESP_LOGI(TAG, "%d headphone preset%s loaded", count, count == 1 ? "" : "s");
+    console_register("preset", "Per-headphone gain, EQ, crossfeed and limiter: preset [<setting> ... | save | erase]",
+                     cmd_preset);
+    telemetry_register("preset", presets_telemetry);
+}
@@ -0,0 +1,32 @@
+/*
+ * Per-headphone DSP presets: gain, EQ, crossfeed and limiter settings kept
+ * in NVS under the headphones' Bluetooth address and applied whenever they
+ * connect. Every stored preset is compiled at boot, so connecting switches
+ * chains with a short crossfade and no design work or gap. Headphones
+ * without a preset of their own get the "default" one, if saved.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_bridge.h"
+
+#define HEADPHONE_PRESETS_NAMESPACE "hp_presets"
+#define HEADPHONE_PRESETS_MAX       8       // Stored presets, including "default"
+
+// Loads and compiles the stored presets and registers the "preset" command
+// and telemetry. Call after nvs_flash_init().
+void headphone_presets_init(void);
+
+// Switches to the preset for the headphones at bda; call when A2DP
+// connects.
+void headphone_presets_connected(const uint8_t bda[6]);
+
+// Runs len bytes of interleaved stereo through the active chain and hands
+// the result to sink. Returns the bytes sink accepted. One writer at a time.
+size_t headphone_presets_write(const void *data, size_t len, audio_sink_t sink, void *ctx);
+
+// Clears the active chain's state; call from the writer when a different
+// producer takes over.
+void headphone_presets_reset(void);
@@ -0,0 +1,84 @@
+/*
+ * Fixed-point inverse MDCT
+ *
+ * With m = n/2 and k = m/2, the DCT-IV u[] of X[0..m) is
+ *   t[j] = (X[2j] + i X[m-1-2j]) * exp(-i pi (4j + 1) / (4m)),  j < k
+ *   T    = FFT_k(t)
+ *   c[j] = T[j] * exp(-i pi j / m)
+ *   u[2j] = Re c[j],  u[m-1-2j] = -Im c[j]
+ * and the IMDCT unfolds from u (see imdct_sample()). The constant part of
+ * the pre-twiddle, exp(-i pi / (4m)), commutes with the FFT and is applied
+ * with the post-twiddle, so one quarter-wave sine table serves every twiddle
+ * of every size. Each FFT stage halves its output, dividing the result by k.
+ */
+
+#include "imdct.h"
+
+#include <math.h>
+
+static int32_t q31(double x) {
+    double v = x * 2147483648.0;
+    return v >= 2147483647.0 ? INT32_MAX : (int32_t)lrint(v);
+}
+
+void imdct_init(imdct_t *t, int32_t *table, int max_n) {
+    fft_init(&t->fft, table, max_n);
+    for (int b = 0; b <= IMDCT_MAX_LOG2; b++) {
+        double angle = M_PI / (2 << b);
+        t->rotation[b][0] = q31(cos(angle));
+        t->rotation[b][1] = q31(sin(angle));
+    }
+}
+
+static inline int32_t mul31(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 31);
+}
+
+void imdct_folded(const imdct_t *t, int32_t *x, int n, int frac_bits, int out_bits, int32_t *work) {
+    int m = n / 2;
+    int k = m / 2;
+    int log2k = __builtin_ctz(k);
+
+    // Peak at 2^28: room for the FFT's worst-case growth of 2 per stage pair.
+    int32_t peak = 0;
+    for (int j = 0; j < m; j++) {
+        peak |= x[j] < 0 ? ~x[j] : x[j];
+    }
+    int norm = peak ? __builtin_clz(peak) - 3 : 0;
+
+    for (int j = 0; j < k; j++) {
+        int32_t re = x[2 * j];
+        int32_t im = x[m - 1 - 2 * j];
+        if (norm >= 0) {
+            re = (int32_t)((uint32_t)re << norm);
+            im = (int32_t)((uint32_t)im << norm);
+        } else {
+            re >>= -norm;
+            im >>= -norm;
+        }
+        int32_t s, c;
+        fft_sincos(&t->fft, j, k, &s, &c);
+        work[2 * j] = mul31(re, c) + mul31(im, s);
+        work[2 * j + 1] = mul31(im, c) - mul31(re, s);
+    }
+    fft_complex(&t->fft, work, k, false);
+
+    const int32_t *rot = t->rotation[__builtin_ctz(n)];
+    int shift = frac_bits + norm - log2k - out_bits;
+    for (int j = 0; j < k; j++) {
+        int32_t s, c;
+        fft_sincos(&t->fft, j, k, &s, &c);
+        // exp(-i pi (4j + 1) / (4m)) = (c - i s)(cos - i sin of pi / (2n))
+        int32_t wr = mul31(c, rot[0]) - mul31(s, rot[1]);
+        int32_t wi = -(mul31(s, rot[0]) + mul31(c, rot[1]));
+        int32_t re = work[2 * j];
+        int32_t im = work[2 * j + 1];
+        int32_t u[2] = { mul31(re, wr) - mul31(im, wi), -(mul31(re, wi) + mul31(im, wr)) };
+        for (int h = 0; h < 2; h++) {
+            int64_t v = shift >= 0 ? u[h] >> shift : (int64_t)u[h] * ((int64_t)1 << -shift);
+            u[h] = v > IMDCT_OUT_LIMIT ? IMDCT_OUT_LIMIT : (v < -IMDCT_OUT_LIMIT ? -IMDCT_OUT_LIMIT : v);
+        }
+        x[2 * j] = u[0];
+        x[m - 1 - 2 * j] = u[1];
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * Fixed-point inverse MDCT shared by the Vorbis and AAC decoders.
+ *
+ * The n-point IMDCT
+ *   y[j] = sum_k X[k] cos(2 pi / n * (j + 1/2 + n/4) * (k + 1/2)),  j < n
+ * is computed as a DCT-IV of the n/2 spectral values through an n/4-point
+ * complex FFT. The spectrum is renormalised before the FFT so its peak uses
+ * the full 32-bit headroom whatever the signal level (block floating point);
+ * the result comes back at a fixed scale chosen by the caller. Codec-specific
+ * scale factors such as AAC's 2/n are folded into frac_bits.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "fft.h"
+
+#define IMDCT_MAX_LOG2      13                  // n up to 8192 (Vorbis' limit)
+#define IMDCT_OUT_LIMIT     ((1 << 30) - 1)     // Output clamp; two can be summed
+
+// Entries of the sine table needed for transforms up to max_n points.
+#define IMDCT_TABLE_LEN(max_n)  FFT_TABLE_LEN(max_n)
+
+typedef struct {
+    fft_t fft;
+    int32_t rotation[IMDCT_MAX_LOG2 + 1][2];    // cos, sin of pi / (2n), Q31
+} imdct_t;
+
+// Fills table (IMDCT_TABLE_LEN(max_n) entries, owned by the caller) for
+// transforms of any power-of-two size from 16 up to max_n.
+void imdct_init(imdct_t *t, int32_t *table, int max_n);
+
+// Replaces the n/2 spectral values in x, Q(frac_bits), with the folded
+// IMDCT output in Q(out_bits), clamped to +-IMDCT_OUT_LIMIT. work must hold
+// n/2 values. Read the time-domain samples back with imdct_sample().
+void imdct_folded(const imdct_t *t, int32_t *x, int n, int frac_bits, int out_bits, int32_t *work);
+
+// Sample j (0 <= j < n) of the IMDCT from the folded output u.
+static inline int32_t imdct_sample(const int32_t *u, int n, int j) {
+    int m = n / 2;
+    if (j < m / 2) {
+        return u[j + m / 2];
+    }
+    if (j < 3 * m / 2) {
+        return -u[3 * m / 2 - 1 - j];
+    }
+    return -u[j - 3 * m / 2];
+}
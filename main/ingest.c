@@ -0,0 +1,1064 @@
+/*
+ * Stream ingest
+ *
+ * Each session starts in INGEST_FORMAT_UNKNOWN and buffers a few bytes in
+ * carry[] until it can tell what the sender is doing:
+ *   "RIFF....WAVE"  WAV file: chunks are walked, "fmt " is checked, and the
+ *                   "data" chunk is played as PCM.
+ *   0x9C ...        SBC, but only if the header is legal, the CRC matches and
+ *                   another frame header follows right after the first frame.
+ *   "OggS"          Ogg Vorbis: pages are demultiplexed and the packets fed
+ *                   to the integer Vorbis decoder.
+ *   0xFFF ...       AAC in ADTS, if the header parses and (when the first
+ *                   frame fits in carry[]) another header follows it.
+ *   anything else   Raw 16-bit stereo PCM, as before.
+ *
+ * SBC frames are reassembled in carry[] so the decoder always sees whole
+ * frames no matter how TCP splits them. A frame with a bad CRC is dropped and
+ * the stream is rescanned from the next syncword with the same parameters.
+ *
+ * Bluedroid in IDF 5.1 encodes SBC itself and offers no way to hand it frames,
+ * so SBC is decoded back to PCM here. It halves the Wi-Fi bitrate at high
+ * bitpools but does not save the encoder's CPU time.
+ *
+ * Ogg Vorbis needs far more state than fits in ingest_t (codebooks, transform
+ * tables), so one heap block of CONFIG_BRIDGE_VORBIS_ARENA_KB plus a packet
+ * buffer is taken when such a stream starts and returned by ingest_end().
+ * Decoding never allocates after that.
+ *
+ * AAC works the same way with a smaller block: the decoder (~40 KB) and a
+ * frame buffer, since ADTS frames outgrow carry[]. Once the first header is
+ * accepted its profile, rate and channels are locked, and a header that does
+ * not match them costs a resync to the next syncword. A frame that fails to
+ * decode is concealed by fading out the last frame's overlap, which keeps the
+ * timing without playing garbage.
+ *
+ * WAV and Vorbis streams of 3 to 8 channels go through downmix.c with the
+ * layout taken from the WAV channel mask (or the usual one for the channel
+ * count) or from the Vorbis channel order. The matrix is copied when a
+ * stream starts, so "downmix" changes apply from the next one.
+ *
+ * Seeking (for the play queue's HTTP items) maps a frame to a byte offset
+ * the caller fetches from. PCM and WAV are plain arithmetic and SBC frames
+ * all have the same length, so those land on the frame asked for. AAC and
+ * Vorbis have no index in a stream this decoder sees, so the offset is
+ * estimated from the average bitrate so far and aimed a little early: AAC
+ * resyncs on the next ADTS header, numbered by its offset at the average
+ * frame size, so its position stays an estimate; Ogg resyncs on the next
+ * page and the output is held back until a packet ends on a second page,
+ * whose predecessor's granule position then says exactly where the stream
+ * is. Either way emit() drops whatever comes before the target. Aiming
+ * before the first audio means starting over from byte 0.
+ */
+
+#include "ingest.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "control_channel.h"
+#include "telemetry.h"
+
+static const char *TAG = "INGEST";
+
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+
+#define VORBIS_ARENA_SIZE       (CONFIG_BRIDGE_VORBIS_ARENA_KB * 1024)
+// Setup headers run to ~4 KB for stereo, audio packets to ~1.5 KB. 5.1 setups
+// are ~9 KB but only fit arenas of ~200 KB, so the buffer grows with those.
+#define OGG_MAX_PACKET          (CONFIG_BRIDGE_VORBIS_ARENA_KB >= 192 ? 16384 : 8192)
+
+// How far before the target an estimated seek aims, for the bitrate
+// estimate's error. Ogg adds two of its longest pages: the one landed in and
+// the one after it, at whose end the position is learnt.
+#define SEEK_LEAD_FRAMES        (AUDIO_SAMPLE_RATE / 4)
+
+typedef struct {
+    ingest_format_t format;
+    sbc_params_t sbc;
+    uint32_t sessions;
+    uint32_t rejects;
+    uint32_t bytes_in;
+    uint32_t frames_out;
+    uint32_t sbc_frames;
+    uint32_t crc_errors;
+    uint32_t resyncs;
+    uint32_t skipped_bytes;     // Discarded while hunting for a syncword
+    uint32_t vorbis_packets;
+    uint32_t vorbis_errors;
+    uint32_t decode_us;         // Time spent in the Vorbis or AAC decoder (wraps)
+    uint32_t decode_worst_us;   // Slowest audio packet or frame
+    uint32_t ogg_pages;
+    uint32_t ogg_crc_errors;
+    uint32_t ogg_resyncs;
+    uint32_t ogg_dropped;       // Packets lost to damage or oversize
+    uint32_t vorbis_rate;
+    int vorbis_channels;
+    uint32_t vorbis_arena;      // Bytes used by the current stream's setup
+    uint32_t aac_frames;
+    uint32_t aac_errors;        // Frames dropped and concealed
+    uint32_t aac_rate;
+    int aac_channels;
+    int downmix_channels;       // Current stream's, if downmixed
+    uint32_t downmix_clipped;   // Samples saturated by the downmix
+} ingest_stats_t;
+
+// Written by the tasks feeding sessions (the TCP server and the play queue's
+// workers); telemetry works from differences between snapshots, so no
+// locking is needed, and a prefetching session can at worst skew a report.
+static ingest_stats_t s_stats;
+static ingest_stats_t s_reported;
+static int64_t s_reported_us = 0;
+
+// Console task writes, ingest task copies at stream start.
+static downmix_matrix_t s_downmix_matrix;
+
+static const char *const s_mode_names[4] = { "mono", "dual", "stereo", "joint" };
+static const char *const s_aac_profiles[4] = { "main", "LC", "SSR", "LTP" };
+
+const char *ingest_format_name(ingest_format_t format) {
+    switch (format) {
+        case INGEST_FORMAT_PCM: return "pcm";
+        case INGEST_FORMAT_WAV: return "wav";
+        case INGEST_FORMAT_SBC: return "sbc";
+        case INGEST_FORMAT_OGG: return "ogg";
+        case INGEST_FORMAT_AAC: return "aac";
+        default:                return "unknown";
+    }
+}
+
+// Drops the first n bytes of carry[].
+static void carry_consume(ingest_t *in, size_t n) {
+    in->carry_len -= n;
+    memmove(in->carry, in->carry + n, in->carry_len);
+}
+
+// Tells the sender why its stream is refused so it can fall back to raw PCM.
+static bool reject(ingest_t *in, const char *why) {
+    char line[128];
+    snprintf(line, sizeof(line), "E ingest reject format=%s reason=%s want=pcm16/%d/%d\n",
+             ingest_format_name(in->format), why, AUDIO_SAMPLE_RATE, AUDIO_CHANNELS);
+    ESP_LOGW(TAG, "%s stream rejected: %s", ingest_format_name(in->format), why);
+    control_channel_send_line(line);
+    s_stats.rejects++;
+    return false;
+}
+
+static void emit(ingest_t *in, const int16_t *pcm, size_t frames) {
+    if (in->position < in->seek_to) {
+        // Short of a seek target, or not knowing where yet.
+        size_t drop = frames;
+        if (in->position >= 0 && (int64_t)frames > in->seek_to - in->position) {
+            drop = in->seek_to - in->position;
+        }
+        if (in->position >= 0) {
+            in->position += drop;
+        }
+        pcm += drop * 2;
+        frames -= drop;
+        if (frames == 0) {
+            return;
+        }
+    }
+    in->position += frames;
+    s_stats.frames_out += frames;
+    in->sink(pcm, frames, in->ctx);
+}
+
+// Sets up the downmix for a stream of more than two channels.
+static void downmix_start(ingest_t *in, const uint8_t *layout, int channels) {
+    downmix_matrix_t m = s_downmix_matrix;
+    downmix_init(&in->downmix, &m, layout, channels);
+    s_stats.downmix_channels = channels;
+    ESP_LOGI(TAG, "Downmixing %d channels (%d/%d taps)", channels, in->downmix.taps[0], in->downmix.taps[1]);
+}
+
+// Mixes frames of src down into pcm[].
+static void downmix_block(ingest_t *in, const int16_t *src, int frames) {
+    uint32_t clipped = in->downmix.clipped;
+    downmix_process(&in->downmix, src, in->pcm, frames);
+    s_stats.downmix_clipped += in->downmix.clipped - clipped;
+}
+
+// Hands decoder output to the sink in INGEST_PCM_FRAMES pieces, upmixing
+// mono and downmixing more than two channels.
+static void emit_decoded(ingest_t *in, const int16_t *pcm, int frames, int channels) {
+    while (frames > 0) {
+        int n = frames < INGEST_PCM_FRAMES ? frames : INGEST_PCM_FRAMES;
+        if (channels > 2) {
+            downmix_block(in, pcm, n);
+            emit(in, in->pcm, n);
+        } else if (channels == 1) {
+            for (int i = 0; i < n; i++) {
+                in->pcm[2 * i] = pcm[i];
+                in->pcm[2 * i + 1] = pcm[i];
+            }
+            emit(in, in->pcm, n);
+        } else {
+            emit(in, pcm, n);
+        }
+        pcm += n * channels;
+        frames -= n;
+    }
+}
+
+static void decode_timing(uint32_t took_us) {
+    s_stats.decode_us += took_us;
+    if (took_us > s_stats.decode_worst_us) {
+        s_stats.decode_worst_us = took_us;
+    }
+}
+
+// --- PCM ---
+// Raw bytes are staged in pcm[] (carry_len counts them) so the sink always
+// gets aligned, whole stereo frames. Mono is spread out in place, back to
+// front; more channels are mixed down in place, front to back, so fewer
+// frames fit in a stage.
+static void pcm_feed(ingest_t *in, const uint8_t *data, size_t len) {
+    size_t frame_bytes = in->channels * sizeof(int16_t);
+    size_t stage_frames = in->channels <= 2 ? INGEST_PCM_FRAMES : sizeof(in->pcm) / frame_bytes;
+    size_t stage_bytes = stage_frames * frame_bytes;
+    uint8_t *stage = (uint8_t *)in->pcm;
+
+    while (len > 0) {
+        size_t n = len < stage_bytes - in->carry_len ? len : stage_bytes - in->carry_len;
+        memcpy(stage + in->carry_len, data, n);
+        in->carry_len += n;
+        data += n;
+        len -= n;
+
+        size_t frames = in->carry_len / frame_bytes;
+        if (frames == 0) {
+            break;
+        }
+        if (in->channels == 1) {
+            for (size_t i = frames; i-- > 0;) {
+                in->pcm[2 * i + 1] = in->pcm[i];
+                in->pcm[2 * i] = in->pcm[i];
+            }
+        } else if (in->channels > 2) {
+            downmix_block(in, in->pcm, frames);
+        }
+        emit(in, in->pcm, frames);
+        size_t rest = in->carry_len - frames * frame_bytes;
+        // The remainder is at most one partial input frame; re-read it from
+        // the source rather than from the (possibly upmixed) stage.
+        memmove(stage, data - rest, rest);
+        in->carry_len = rest;
+    }
+}
+
+// Switches to PCM handling and replays whatever was buffered while sniffing.
+static void start_pcm(ingest_t *in, ingest_format_t format) {
+    uint8_t pending[sizeof(in->carry)];
+    size_t pending_len = in->carry_len;
+    memcpy(pending, in->carry, pending_len);
+    in->format = format;
+    in->carry_len = 0;
+    pcm_feed(in, pending, pending_len);
+}
+
+// --- WAV ---
+static bool wav_fmt(ingest_t *in, const uint8_t *fmt, uint32_t size) {
+    if (size < 16) {
+        return reject(in, "short-fmt");
+    }
+    uint16_t tag = fmt[0] | (fmt[1] << 8);
+    uint32_t mask = 0;
+    uint16_t channels = fmt[2] | (fmt[3] << 8);
+    uint32_t rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | ((uint32_t)fmt[7] << 24);
+    uint16_t bits = fmt[14] | (fmt[15] << 8);
+
+    ESP_LOGI(TAG, "WAV: format 0x%04x, %u ch, %lu Hz, %u bit", tag, channels, (unsigned long)rate, bits);
+    if (tag != WAV_FORMAT_PCM && tag != WAV_FORMAT_EXTENSIBLE) {
+        return reject(in, "not-pcm");
+    }
+    if (bits != 16) {
+        return reject(in, "bits");
+    }
+    if (rate != AUDIO_SAMPLE_RATE) {
+        return reject(in, "rate");
+    }
+    if (channels < 1 || channels > DOWNMIX_MAX_CHANNELS) {
+        return reject(in, "channels");
+    }
+    if (tag == WAV_FORMAT_EXTENSIBLE && size >= 24) {
+        mask = fmt[20] | (fmt[21] << 8) | (fmt[22] << 16) | ((uint32_t)fmt[23] << 24);
+    }
+    in->channels = channels;
+    if (channels > 2) {
+        uint8_t layout[DOWNMIX_MAX_CHANNELS];
+        downmix_layout_wav(mask, channels, layout);
+        downmix_start(in, layout, channels);
+    }
+    return true;
+}
+
+// Walks chunk headers buffered in carry[] until the data chunk starts.
+static bool wav_header(ingest_t *in) {
+    while (!in->in_data && in->skip == 0 && in->carry_len >= 8) {
+        const uint8_t *h = in->carry;
+        uint32_t size = h[4] | (h[5] << 8) | (h[6] << 16) | ((uint32_t)h[7] << 24);
+
+        if (memcmp(h, "data", 4) == 0) {
+            carry_consume(in, 8);
+            in->data_offset = in->fed - in->carry_len;
+            in->in_data = true;
+            start_pcm(in, INGEST_FORMAT_WAV);
+            return true;
+        }
+        uint32_t padded = size + (size & 1);
+        if (memcmp(h, "fmt ", 4) == 0) {
+            if (padded > sizeof(in->carry) - 8) {
+                return reject(in, "fmt-size");
+            }
+            if (in->carry_len < 8 + padded) {
+                return true;
+            }
+            if (!wav_fmt(in, h + 8, size)) {
+                return false;
+            }
+            carry_consume(in, 8 + padded);
+        } else {
+            // LIST, fact and friends: skip whatever is not buffered yet.
+            size_t have = in->carry_len - 8 < padded ? in->carry_len - 8 : padded;
+            carry_consume(in, 8 + have);
+            in->skip = padded - have;
+        }
+    }
+    return true;
+}
+
+// --- SBC ---
+static bool sbc_same_stream(const sbc_params_t *a, const sbc_params_t *b) {
+    // The bitpool may change from frame to frame; the rest may not.
+    return a->freq_index == b->freq_index && a->blocks == b->blocks && a->mode == b->mode &&
+           a->allocation == b->allocation && a->subbands == b->subbands;
+}
+
+// Drops carry[0] and everything up to the next syncword.
+static void sbc_resync(ingest_t *in) {
+    size_t i = 1;
+    while (i < in->carry_len && in->carry[i] != SBC_SYNCWORD) {
+        i++;
+    }
+    carry_consume(in, i);
+    s_stats.skipped_bytes += i;
+    s_stats.resyncs += in->sbc_locked;
+}
+
+static bool sbc_frame(ingest_t *in, const sbc_params_t *p, int flen) {
+    if (sbc_sample_rate(p) != AUDIO_SAMPLE_RATE) {
+        return reject(in, "rate");
+    }
+    if (in->sbc_locked && p->subbands != in->sbc.subbands) {
+        sbc_decoder_init(&in->dec);
+    }
+    in->sbc = *p;
+    in->sbc_locked = true;
+    s_stats.sbc = *p;
+
+    int16_t *pcm = in->pcm;
+    int samples = sbc_decode_frame(&in->dec, in->carry, flen, pcm);
+    carry_consume(in, flen);
+    if (samples < 0) {
+        return true;
+    }
+    s_stats.sbc_frames++;
+    if (sbc_channels(p) == 1) {
+        for (int i = samples; i-- > 0;) {
+            pcm[2 * i + 1] = pcm[i];
+            pcm[2 * i] = pcm[i];
+        }
+    }
+    emit(in, pcm, samples);
+    return true;
+}
+
+static bool sbc_feed(ingest_t *in, const uint8_t *data, size_t len) {
+    while (1) {
+        size_t need = SBC_HEADER_LEN;
+        sbc_params_t p;
+        int flen = -1;
+
+        if (in->carry_len >= SBC_HEADER_LEN) {
+            flen = sbc_parse_header(in->carry, in->carry_len, &p);
+            if (flen < 0 || (in->sbc_locked && !sbc_same_stream(&p, &in->sbc))) {
+                sbc_resync(in);
+                continue;
+            }
+            need = flen;
+        }
+        if (in->carry_len < need) {
+            if (len == 0) {
+                return true;
+            }
+            size_t n = need - in->carry_len < len ? need - in->carry_len : len;
+            memcpy(in->carry + in->carry_len, data, n);
+            in->carry_len += n;
+            data += n;
+            len -= n;
+            if (in->carry_len < need) {
+                return true;
+            }
+            if (flen < 0) {
+                continue;
+            }
+        }
+
+        if (!sbc_check_crc(in->carry, flen, &p)) {
+            s_stats.crc_errors += in->sbc_locked;
+            sbc_resync(in);
+            continue;
+        }
+        if (!sbc_frame(in, &p, flen)) {
+            return false;
+        }
+    }
+}
+
+// --- Ogg Vorbis ---
+static bool ogg_packet(const uint8_t *packet, size_t len, bool bos, void *ctx) {
+    ingest_t *in = ctx;
+    if (bos) {
+        vorbis_decoder_reset(in->vorbis);
+    }
+    bool was_ready = vorbis_ready(in->vorbis);
+    if (was_ready && len > 0 && (packet[0] & 1)) {
+        // The headers again, after seeking back to the top.
+        return true;
+    }
+    const int16_t *pcm;
+    int64_t start_us = esp_timer_get_time();
+    int frames = vorbis_decode_packet(in->vorbis, packet, len, &pcm);
+    uint32_t took_us = esp_timer_get_time() - start_us;
+
+    if (!was_ready) {
+        switch (frames) {
+            case VORBIS_OK:
+                break;
+            case VORBIS_ERR_MEMORY:
+                return reject(in, "memory");
+            case VORBIS_ERR_UNSUPPORTED:
+                return reject(in, "floor0");
+            default:
+                // Opus, FLAC or anything else wrapped in Ogg.
+                return reject(in, "not-vorbis");
+        }
+        // Known from the identification header on, so refused before the
+        // setup header spends the arena.
+        if (vorbis_sample_rate(in->vorbis) != AUDIO_SAMPLE_RATE) {
+            return reject(in, "rate");
+        }
+        if (vorbis_channels(in->vorbis) > DOWNMIX_MAX_CHANNELS) {
+            return reject(in, "channels");
+        }
+        if (vorbis_ready(in->vorbis)) {
+            if (vorbis_channels(in->vorbis) > 2) {
+                uint8_t layout[DOWNMIX_MAX_CHANNELS];
+                downmix_layout_vorbis(vorbis_channels(in->vorbis), layout);
+                downmix_start(in, layout, vorbis_channels(in->vorbis));
+            }
+            s_stats.vorbis_rate = vorbis_sample_rate(in->vorbis);
+            s_stats.vorbis_channels = vorbis_channels(in->vorbis);
+            s_stats.vorbis_arena = vorbis_arena_used(in->vorbis);
+            // Close enough for bitrate estimates: the setup header ends
+            // somewhere in the piece being fed.
+            in->data_offset = in->fed;
+            ESP_LOGI(TAG, "Vorbis: %lu Hz, %d ch, %lu of %d arena bytes", (unsigned long)s_stats.vorbis_rate,
+                     s_stats.vorbis_channels, (unsigned long)s_stats.vorbis_arena, VORBIS_ARENA_SIZE);
+        }
+        return true;
+    }
+
+    if (in->ogg.sequence != in->page_sequence) {
+        // A packet ends on a later page than the one before it, so the output
+        // so far ends at the earlier page's granule position: where a seek
+        // has landed.
+        if (in->page_granule >= 0) {
+            if (in->position < 0) {
+                in->position = in->page_granule;
+            }
+            if (in->ogg.granule - in->page_granule > in->page_frames) {
+                in->page_frames = in->ogg.granule - in->page_granule;
+            }
+        }
+        in->page_sequence = in->ogg.sequence;
+        in->page_granule = in->ogg.granule;
+    }
+    s_stats.vorbis_packets++;
+    decode_timing(took_us);
+    if (frames < 0) {
+        s_stats.vorbis_errors++;
+        return true;
+    }
+    emit_decoded(in, pcm, frames, vorbis_channels(in->vorbis));
+    return true;
+}
+
+static bool ogg_start(ingest_t *in) {
+    in->codec_mem = malloc(VORBIS_ARENA_SIZE + OGG_MAX_PACKET);
+    if (in->codec_mem == NULL) {
+        return reject(in, "memory");
+    }
+    in->vorbis = vorbis_decoder_create(in->codec_mem, VORBIS_ARENA_SIZE);
+    ogg_demux_init(&in->ogg, (uint8_t *)in->codec_mem + VORBIS_ARENA_SIZE, OGG_MAX_PACKET);
+    return true;
+}
+
+static bool ogg_feed(ingest_t *in, const uint8_t *data, size_t len) {
+    ogg_demux_t *d = &in->ogg;
+    uint32_t pages = d->pages;
+    uint32_t crc_errors = d->crc_errors;
+    uint32_t resyncs = d->resyncs;
+    uint32_t dropped = d->dropped_packets;
+
+    bool ok = ogg_demux_feed(d, data, len, ogg_packet, in);
+
+    s_stats.ogg_pages += d->pages - pages;
+    s_stats.ogg_crc_errors += d->crc_errors - crc_errors;
+    s_stats.ogg_resyncs += d->resyncs - resyncs;
+    s_stats.ogg_dropped += d->dropped_packets - dropped;
+    return ok;
+}
+
+// --- AAC ---
+static bool aac_same_stream(const aac_adts_t *a, const aac_adts_t *b) {
+    return a->profile == b->profile && a->rate_index == b->rate_index &&
+           a->channel_config == b->channel_config && a->raw_blocks == b->raw_blocks;
+}
+
+static void aac_conceal_frame(ingest_t *in) {
+    const int16_t *pcm;
+    int frames = aac_conceal(in->aac, &pcm);
+    s_stats.aac_errors++;
+    emit_decoded(in, pcm, frames, aac_channels(in->aac));
+}
+
+// Drops aac_frame[0] and everything up to the next 0xFF. Losing sync costs
+// (at least) the frame whose header was damaged; it is concealed once.
+static void aac_resync(ingest_t *in) {
+    if (!in->aac_hunting) {
+        in->aac_hunting = true;
+        aac_conceal_frame(in);
+    }
+    size_t i = 1;
+    while (i < in->aac_len && in->aac_frame[i] != 0xFF) {
+        i++;
+    }
+    in->aac_len -= i;
+    memmove(in->aac_frame, in->aac_frame + i, in->aac_len);
+    s_stats.skipped_bytes += i;
+    s_stats.resyncs++;
+}
+
+static bool aac_start(ingest_t *in) {
+    aac_adts_t *h = &in->aac_hdr;
+    aac_parse_adts(in->carry, in->carry_len, h);
+    ESP_LOGI(TAG, "AAC: %s, %lu Hz, channel config %u, %u bytes/frame", s_aac_profiles[h->profile],
+             (unsigned long)aac_sample_rate(h), h->channel_config, h->frame_len);
+    if (h->profile != 1) {
+        // Main, SSR and LTP; HE-AAC is signalled as LC at half the rate.
+        return reject(in, "profile");
+    }
+    if (aac_sample_rate(h) != AUDIO_SAMPLE_RATE) {
+        return reject(in, "rate");
+    }
+    if (h->channel_config < 1 || h->channel_config > 2) {
+        return reject(in, "channels");
+    }
+    if (!aac_supported(h)) {
+        return reject(in, "framing");
+    }
+    in->codec_mem = malloc(aac_decoder_size() + AAC_MAX_FRAME_LEN + AAC_INPUT_PADDING);
+    if (in->codec_mem == NULL) {
+        return reject(in, "memory");
+    }
+    in->aac = aac_decoder_create(in->codec_mem);
+    in->aac_frame = (uint8_t *)in->codec_mem + aac_decoder_size();
+    in->aac_len = 0;
+    s_stats.aac_rate = aac_sample_rate(h);
+    s_stats.aac_channels = h->channel_config;
+    return true;
+}
+
+static void aac_frame(ingest_t *in, int flen) {
+    const int16_t *pcm;
+    int64_t start_us = esp_timer_get_time();
+    int frames = aac_decode_frame(in->aac, in->aac_frame, flen, &pcm);
+    decode_timing(esp_timer_get_time() - start_us);
+    in->aac_hunting = false;
+    if (frames < 0) {
+        aac_conceal_frame(in);
+        return;
+    }
+    s_stats.aac_frames++;
+    emit_decoded(in, pcm, frames, aac_channels(in->aac));
+}
+
+static bool aac_feed(ingest_t *in, const uint8_t *data, size_t len) {
+    while (1) {
+        size_t need = AAC_ADTS_HEADER_LEN;
+        aac_adts_t h;
+        int flen = -1;
+
+        if (in->aac_len >= AAC_ADTS_HEADER_LEN) {
+            flen = aac_parse_adts(in->aac_frame, in->aac_len, &h);
+            if (flen < 0 || flen > AAC_MAX_FRAME_LEN || !aac_same_stream(&h, &in->aac_hdr)) {
+                aac_resync(in);
+                continue;
+            }
+            need = flen;
+        }
+        if (in->aac_len < need) {
+            if (len == 0) {
+                return true;
+            }
+            size_t n = need - in->aac_len < len ? need - in->aac_len : len;
+            memcpy(in->aac_frame + in->aac_len, data, n);
+            in->aac_len += n;
+            data += n;
+            len -= n;
+            continue;
+        }
+
+        if (in->position < 0) {
+            // First frame after a seek: which one it is follows from where
+            // it starts, at the average frame size.
+            uint32_t start = in->fed - len - flen;
+            in->position = lrint((start - in->data_offset) / in->aac_frame_bytes) * AAC_FRAME_SAMPLES;
+        }
+        // The decoder may read a few bytes past the frame.
+        memset(in->aac_frame + flen, 0, AAC_INPUT_PADDING);
+        aac_frame(in, flen);
+        in->aac_len = 0;
+    }
+}
+
+// --- Sniffing ---
+typedef enum { SNIFF_MORE, SNIFF_PCM, SNIFF_WAV, SNIFF_SBC, SNIFF_OGG, SNIFF_AAC } sniff_t;
+
+static sniff_t sniff(const ingest_t *in) {
+    const uint8_t *d = in->carry;
+    size_t n = in->carry_len;
+    bool full = n == sizeof(in->carry);
+
+    if (n < 4) {
+        return SNIFF_MORE;
+    }
+    if (memcmp(d, "RIFF", 4) == 0) {
+        if (n < 12) {
+            return SNIFF_MORE;
+        }
+        return memcmp(d + 8, "WAVE", 4) == 0 ? SNIFF_WAV : SNIFF_PCM;
+    }
+    if (memcmp(d, "OggS", 4) == 0) {
+        return SNIFF_OGG;
+    }
+    if (d[0] == 0xFF) {
+        aac_adts_t h, next;
+        int flen = aac_parse_adts(d, n, &h);
+        if (flen < 0) {
+            return SNIFF_PCM;
+        }
+        // Frames longer than carry[] are taken on the first header alone.
+        if (n < (size_t)flen + AAC_ADTS_HEADER_LEN) {
+            return full ? SNIFF_AAC : SNIFF_MORE;
+        }
+        if (aac_parse_adts(d + flen, n - flen, &next) >= 0 && aac_same_stream(&h, &next)) {
+            return SNIFF_AAC;
+        }
+        return SNIFF_PCM;
+    }
+    if (d[0] == SBC_SYNCWORD) {
+        sbc_params_t p, next;
+        int flen = sbc_parse_header(d, n, &p);
+        if (flen < 0) {
+            return SNIFF_PCM;
+        }
+        if (n < (size_t)flen + SBC_HEADER_LEN) {
+            return full ? SNIFF_PCM : SNIFF_MORE;
+        }
+        if (sbc_check_crc(d, flen, &p) && sbc_parse_header(d + flen, n - flen, &next) >= 0 &&
+            sbc_same_stream(&p, &next)) {
+            return SNIFF_SBC;
+        }
+    }
+    return SNIFF_PCM;
+}
+
+void ingest_begin(ingest_t *in, ingest_sink_t sink, void *ctx) {
+    memset(in, 0, sizeof(*in));
+    in->format = INGEST_FORMAT_UNKNOWN;
+    in->sink = sink;
+    in->ctx = ctx;
+    in->channels = AUDIO_CHANNELS;
+    in->page_granule = -1;
+    sbc_decoder_init(&in->dec);
+    s_stats.sessions++;
+    s_stats.format = INGEST_FORMAT_UNKNOWN;
+    s_stats.downmix_channels = 0;
+}
+
+void ingest_end(ingest_t *in) {
+    free(in->codec_mem);
+    in->codec_mem = NULL;
+    in->vorbis = NULL;
+    in->aac = NULL;
+}
+
+size_t ingest_codec_memory(const uint8_t *head, size_t len) {
+    if (len >= 4 && memcmp(head, "OggS", 4) == 0) {
+        return VORBIS_ARENA_SIZE + OGG_MAX_PACKET;
+    }
+    aac_adts_t h;
+    if (len > 0 && head[0] == 0xFF && aac_parse_adts(head, len, &h) >= 0) {
+        return aac_decoder_size() + AAC_MAX_FRAME_LEN + AAC_INPUT_PADDING;
+    }
+    return 0;
+}
+
+// Moves input into carry[] for sniffing or WAV header parsing.
+static size_t buffer_input(ingest_t *in, const uint8_t *data, size_t len) {
+    size_t n = sizeof(in->carry) - in->carry_len;
+    n = n < len ? n : len;
+    memcpy(in->carry + in->carry_len, data, n);
+    in->carry_len += n;
+    return n;
+}
+
+// Settles the format once enough bytes are buffered. Returns false if the
+// stream was rejected.
+static bool detect_format(ingest_t *in) {
+    sbc_params_t p;
+    switch (sniff(in)) {
+        case SNIFF_MORE:
+            return true;
+        case SNIFF_PCM:
+            start_pcm(in, INGEST_FORMAT_PCM);
+            break;
+        case SNIFF_WAV:
+            in->format = INGEST_FORMAT_WAV;
+            carry_consume(in, 12);
+            break;
+        case SNIFF_SBC:
+            in->format = INGEST_FORMAT_SBC;
+            sbc_parse_header(in->carry, in->carry_len, &p);
+            ESP_LOGI(TAG, "SBC: %d Hz, %s, %u subbands, %u blocks, bitpool %u",
+                     sbc_sample_rate(&p), s_mode_names[p.mode], p.subbands, p.blocks, p.bitpool);
+            break;
+        case SNIFF_OGG:
+            in->format = INGEST_FORMAT_OGG;
+            if (!ogg_start(in)) {
+                return false;
+            }
+            break;
+        case SNIFF_AAC:
+            in->format = INGEST_FORMAT_AAC;
+            if (!aac_start(in)) {
+                return false;
+            }
+            break;
+    }
+    s_stats.format = in->format;
+    ESP_LOGI(TAG, "Stream format: %s", ingest_format_name(in->format));
+    // Frames already buffered are decoded right away.
+    if (in->format == INGEST_FORMAT_OGG) {
+        size_t pending = in->carry_len;
+        in->carry_len = 0;
+        return ogg_feed(in, in->carry, pending);
+    }
+    if (in->format == INGEST_FORMAT_AAC) {
+        size_t pending = in->carry_len;
+        in->carry_len = 0;
+        return aac_feed(in, in->carry, pending);
+    }
+    return in->format != INGEST_FORMAT_SBC || sbc_feed(in, NULL, 0);
+}
+
+bool ingest_feed(ingest_t *in, const uint8_t *data, size_t len) {
+    s_stats.bytes_in += len;
+
+    while (len > 0) {
+        if (in->skip > 0) {
+            size_t n = len < in->skip ? len : in->skip;
+            in->skip -= n;
+            in->fed += n;
+            data += n;
+            len -= n;
+            continue;
+        }
+        size_t n;
+        if (in->format != INGEST_FORMAT_UNKNOWN && (in->format != INGEST_FORMAT_WAV || in->in_data)) {
+            in->fed += len;
+        }
+        switch (in->format) {
+            case INGEST_FORMAT_PCM:
+                pcm_feed(in, data, len);
+                return true;
+
+            case INGEST_FORMAT_SBC:
+                return sbc_feed(in, data, len);
+
+            case INGEST_FORMAT_OGG:
+                return ogg_feed(in, data, len);
+
+            case INGEST_FORMAT_AAC:
+                return aac_feed(in, data, len);
+
+            case INGEST_FORMAT_WAV:
+                if (in->in_data) {
+                    pcm_feed(in, data, len);
+                    return true;
+                }
+                n = buffer_input(in, data, len);
+                in->fed += n;
+                if (!wav_header(in)) {
+                    return false;
+                }
+                break;
+
+            default:
+                n = buffer_input(in, data, len);
+                in->fed += n;
+                if (!detect_format(in)) {
+                    return false;
+                }
+                if (in->format == INGEST_FORMAT_WAV && !wav_header(in)) {
+                    return false;
+                }
+                break;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// --- Seeking ---
+// Average input bytes per output frame so far.
+static double bytes_per_frame(const ingest_t *in) {
+    return (double)(in->fed - in->data_offset) / in->position;
+}
+
+bool ingest_seek_plan(const ingest_t *in, uint32_t target, ingest_seek_t *plan) {
+    uint64_t offset;
+    switch (in->format) {
+        case INGEST_FORMAT_WAV:
+        case INGEST_FORMAT_PCM:
+            if (!in->in_data && in->format == INGEST_FORMAT_WAV) {
+                return false;
+            }
+            offset = in->data_offset + (uint64_t)target * in->channels * sizeof(int16_t);
+            plan->position = target;
+            plan->exact = true;
+            break;
+
+        case INGEST_FORMAT_SBC: {
+            if (!in->sbc_locked) {
+                return false;
+            }
+            uint32_t frame_samples = in->sbc.blocks * in->sbc.subbands;
+            uint32_t frames = target / frame_samples;
+            offset = in->data_offset + (uint64_t)frames * sbc_frame_length(&in->sbc);
+            plan->position = (int64_t)frames * frame_samples;
+            plan->exact = true;
+            break;
+        }
+
+        case INGEST_FORMAT_AAC:
+        case INGEST_FORMAT_OGG: {
+            if (in->position <= 0 || in->fed <= in->data_offset) {
+                return false;
+            }
+            int64_t lead = SEEK_LEAD_FRAMES;
+            if (in->format == INGEST_FORMAT_OGG) {
+                lead += 2 * (int64_t)in->page_frames;
+            }
+            int64_t aim = target > lead ? target - lead : 0;
+            plan->position = -1;
+            plan->exact = in->format == INGEST_FORMAT_OGG;
+            if (aim == 0) {
+                // From the top, headers and all: the position is known.
+                offset = 0;
+                plan->position = 0;
+            } else {
+                offset = in->data_offset + (uint64_t)(aim * bytes_per_frame(in));
+            }
+            break;
+        }
+
+        default:
+            return false;
+    }
+    if (offset > UINT32_MAX) {
+        return false;
+    }
+    plan->offset = offset;
+    return true;
+}
+
+void ingest_seek(ingest_t *in, uint32_t target, const ingest_seek_t *plan) {
+    in->carry_len = 0;
+    in->skip = 0;
+    if (in->format == INGEST_FORMAT_SBC) {
+        sbc_decoder_init(&in->dec);
+    } else if (in->format == INGEST_FORMAT_OGG) {
+        ogg_demux_seek(&in->ogg);
+        vorbis_decoder_restart(in->vorbis);
+        in->page_granule = -1;
+    } else if (in->format == INGEST_FORMAT_AAC) {
+        in->aac_frame_bytes = bytes_per_frame(in) * AAC_FRAME_SAMPLES;
+        aac_decoder_restart(in->aac);
+        in->aac_len = 0;
+        // Already hunting, so landing mid-frame is not concealed.
+        in->aac_hunting = true;
+    }
+    in->fed = plan->offset;
+    in->position = plan->position;
+    in->seek_to = target;
+}
+
+int64_t ingest_position(const ingest_t *in) {
+    return in->position;
+}
+
+// --- Reporting ---
+static int ingest_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    ingest_stats_t st = s_stats;
+    double span_s = s_reported_us ? (now - s_reported_us) / 1e6 : 0;
+    uint32_t bytes_in = st.bytes_in - s_reported.bytes_in;
+
+    int n = snprintf(buf, len, "format=%s kbps_in=%.0f frames_out=%lu rejects=%lu",
+                     ingest_format_name(st.format), span_s > 0 ? bytes_in * 8 / span_s / 1000 : 0.0,
+                     (unsigned long)(st.frames_out - s_reported.frames_out), (unsigned long)st.rejects);
+    if (st.downmix_channels > 0 && n < (int)len) {
+        n += snprintf(buf + n, len - n, " downmix=%d clipped=%lu", st.downmix_channels,
+                      (unsigned long)(st.downmix_clipped - s_reported.downmix_clipped));
+    }
+    if (st.format == INGEST_FORMAT_SBC && n < (int)len) {
+        n += snprintf(buf + n, len - n, " sbc=%lu crc_err=%lu resync=%lu skipped=%lu bitpool=%u",
+                      (unsigned long)(st.sbc_frames - s_reported.sbc_frames),
+                      (unsigned long)(st.crc_errors - s_reported.crc_errors),
+                      (unsigned long)(st.resyncs - s_reported.resyncs),
+                      (unsigned long)(st.skipped_bytes - s_reported.skipped_bytes), st.sbc.bitpool);
+    }
+    if (st.format == INGEST_FORMAT_OGG && n < (int)len) {
+        uint32_t decode_us = st.decode_us - s_reported.decode_us;
+        n += snprintf(buf + n, len - n,
+                      " packets=%lu dec_err=%lu dec_cpu=%.1f%% worst_us=%lu pages=%lu crc_err=%lu resync=%lu dropped=%lu",
+                      (unsigned long)(st.vorbis_packets - s_reported.vorbis_packets),
+                      (unsigned long)(st.vorbis_errors - s_reported.vorbis_errors),
+                      span_s > 0 ? decode_us / span_s / 1e4 : 0.0, (unsigned long)st.decode_worst_us,
+                      (unsigned long)(st.ogg_pages - s_reported.ogg_pages),
+                      (unsigned long)(st.ogg_crc_errors - s_reported.ogg_crc_errors),
+                      (unsigned long)(st.ogg_resyncs - s_reported.ogg_resyncs),
+                      (unsigned long)(st.ogg_dropped - s_reported.ogg_dropped));
+    }
+    if (st.format == INGEST_FORMAT_AAC && n < (int)len) {
+        uint32_t decode_us = st.decode_us - s_reported.decode_us;
+        n += snprintf(buf + n, len - n, " aac=%lu dec_err=%lu dec_cpu=%.1f%% worst_us=%lu resync=%lu skipped=%lu",
+                      (unsigned long)(st.aac_frames - s_reported.aac_frames),
+                      (unsigned long)(st.aac_errors - s_reported.aac_errors),
+                      span_s > 0 ? decode_us / span_s / 1e4 : 0.0, (unsigned long)st.decode_worst_us,
+                      (unsigned long)(st.resyncs - s_reported.resyncs),
+                      (unsigned long)(st.skipped_bytes - s_reported.skipped_bytes));
+    }
+    s_reported = st;
+    s_reported_us = now;
+    return n;
+}
+
+static int cmd_ingest(int argc, char **argv) {
+    ingest_stats_t st = s_stats;
+    console_printf("ingest: %lu sessions (%lu rejected), current format %s, %lu bytes in, %lu frames out\n",
+                   (unsigned long)st.sessions, (unsigned long)st.rejects, ingest_format_name(st.format),
+                   (unsigned long)st.bytes_in, (unsigned long)st.frames_out);
+    if (st.sbc_frames > 0) {
+        const sbc_params_t *p = &st.sbc;
+        console_printf("  sbc: %d Hz, %s, %s allocation, %u subbands, %u blocks, bitpool %u (%d bytes/frame)\n",
+                       sbc_sample_rate(p), s_mode_names[p->mode], p->allocation == SBC_ALLOC_SNR ? "snr" : "loudness",
+                       p->subbands, p->blocks, p->bitpool, sbc_frame_length(p));
+        console_printf("  sbc: %lu frames, %lu crc errors, %lu resyncs, %lu bytes skipped\n",
+                       (unsigned long)st.sbc_frames, (unsigned long)st.crc_errors, (unsigned long)st.resyncs,
+                       (unsigned long)st.skipped_bytes);
+    }
+    if (st.ogg_pages > 0) {
+        console_printf("  vorbis: %lu Hz, %d ch, arena %lu/%d bytes, %lu packets, %lu decode errors, "
+                       "slowest packet %lu us\n",
+                       (unsigned long)st.vorbis_rate, st.vorbis_channels, (unsigned long)st.vorbis_arena,
+                       VORBIS_ARENA_SIZE, (unsigned long)st.vorbis_packets, (unsigned long)st.vorbis_errors,
+                       (unsigned long)st.decode_worst_us);
+        console_printf("  ogg: %lu pages, %lu crc errors, %lu resyncs, %lu packets dropped\n",
+                       (unsigned long)st.ogg_pages, (unsigned long)st.ogg_crc_errors,
+                       (unsigned long)st.ogg_resyncs, (unsigned long)st.ogg_dropped);
+    }
+    if (st.aac_frames > 0) {
+        console_printf("  aac: LC, %lu Hz, %d ch, %lu frames, %lu concealed, %lu resyncs, %lu bytes skipped, "
+                       "slowest frame %lu us\n",
+                       (unsigned long)st.aac_rate, st.aac_channels, (unsigned long)st.aac_frames,
+                       (unsigned long)st.aac_errors, (unsigned long)st.resyncs, (unsigned long)st.skipped_bytes,
+                       (unsigned long)st.decode_worst_us);
+    }
+    return 0;
+}
+
+static int cmd_downmix(int argc, char **argv) {
+    downmix_matrix_t *m = &s_downmix_matrix;
+    if (argc < 2) {
+        console_printf("downmix matrix (gain to L, R), normalize %s:\n", m->normalize ? "on" : "off");
+        for (int s = 0; s < DOWNMIX_SPEAKERS; s++) {
+            console_printf("  %-3s  %6.3f  %6.3f\n", downmix_speaker_name(s),
+                           (double)m->gain[s][0] / (1 << DOWNMIX_GAIN_BITS),
+                           (double)m->gain[s][1] / (1 << DOWNMIX_GAIN_BITS));
+        }
+        if (s_stats.downmix_channels > 0) {
+            console_printf("current stream: %d channels\n", s_stats.downmix_channels);
+        }
+        console_printf("%lu samples clipped since boot\n", (unsigned long)s_stats.downmix_clipped);
+        console_printf("Usage: downmix itu | normalize <on|off> | <speaker> <left> <right>\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "itu") == 0) {
+        downmix_matrix_itu(m);
+        return 0;
+    }
+    if (strcmp(argv[1], "normalize") == 0) {
+        if (argc < 3 || (strcmp(argv[2], "on") != 0 && strcmp(argv[2], "off") != 0)) {
+            console_printf("Expected normalize on or off\n");
+            return -1;
+        }
+        m->normalize = strcmp(argv[2], "on") == 0;
+        return 0;
+    }
+    downmix_speaker_t s = downmix_speaker_from_name(argv[1]);
+    if (s == DOWNMIX_NONE || argc < 4) {
+        console_printf("Unknown speaker '%s' or missing gains\n", argv[1]);
+        return -1;
+    }
+    for (int o = 0; o < 2; o++) {
+        double g = atof(argv[2 + o]);
+        if (fabs(g) > (double)DOWNMIX_GAIN_MAX / (1 << DOWNMIX_GAIN_BITS)) {
+            console_printf("Gain %s out of range\n", argv[2 + o]);
+            return -1;
+        }
+        m->gain[s][o] = lrint(g * (1 << DOWNMIX_GAIN_BITS));
+    }
+    return 0;
+}
+
+void ingest_init(void) {
+    downmix_matrix_itu(&s_downmix_matrix);
+    console_register("ingest", "Format and counters of the audio stream since boot", cmd_ingest);
+    console_register("downmix",
+                     "Stereo downmix of multichannel streams: downmix [itu | normalize <on|off> | <speaker> <l> <r>]",
+                     cmd_downmix);
+    telemetry_register("ingest", ingest_telemetry);
+}
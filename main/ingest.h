@@ -0,0 +1,111 @@
+/*
+ * Stream ingest: turns whatever a sender writes to the audio port into
+ * 16-bit stereo PCM at AUDIO_SAMPLE_RATE.
+ *
+ * The format is sniffed from the first bytes of each session: a RIFF/WAVE
+ * header, pre-encoded SBC frames, an Ogg Vorbis stream, an ADTS AAC stream,
+ * or (the original protocol) raw PCM. Multichannel WAV and Vorbis streams
+ * are downmixed to stereo with the matrix set by the "downmix" command.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "aac_decoder.h"
+#include "downmix.h"
+#include "ogg_demux.h"
+#include "sbc_codec.h"
+#include "vorbis_decoder.h"
+
+#define INGEST_PCM_FRAMES       256     // Frames per sink call at most
+
+typedef enum {
+    INGEST_FORMAT_UNKNOWN,      // Still sniffing
+    INGEST_FORMAT_PCM,
+    INGEST_FORMAT_WAV,
+    INGEST_FORMAT_SBC,
+    INGEST_FORMAT_OGG,          // Ogg Vorbis
+    INGEST_FORMAT_AAC,          // AAC-LC in ADTS
+} ingest_format_t;
+
+// Receives interleaved stereo PCM, always whole frames.
+typedef void (*ingest_sink_t)(const int16_t *pcm, size_t frames, void *ctx);
+
+typedef struct {
+    ingest_format_t format;
+    ingest_sink_t sink;
+    void *ctx;
+    int channels;               // Of the incoming stream; mono is upmixed,
+                                // more than two downmixed
+    uint32_t skip;              // Input bytes still to discard (WAV chunks)
+    bool in_data;               // WAV: inside the data chunk
+    sbc_params_t sbc;           // Parameters of the last good frame
+    bool sbc_locked;
+    sbc_decoder_t dec;
+    uint8_t carry[SBC_MAX_FRAME_LEN + SBC_HEADER_LEN];
+    size_t carry_len;
+    int16_t pcm[INGEST_PCM_FRAMES * 2];
+    ogg_demux_t ogg;
+    vorbis_decoder_t *vorbis;
+    aac_decoder_t *aac;
+    aac_adts_t aac_hdr;         // Header of the first frame
+    uint8_t *aac_frame;         // Frame being reassembled
+    size_t aac_len;
+    bool aac_hunting;           // Lost sync; the missing frame is concealed
+    double aac_frame_bytes;     // Average frame size, to place the first frame after a seek
+    void *codec_mem;            // Ogg or AAC decoder state and buffers, heap
+    downmix_t downmix;
+    uint32_t fed;               // Stream offset of the next input byte
+    uint32_t data_offset;       // Where the audio starts (past WAV and Vorbis headers)
+    int64_t position;           // Frame the next output starts at; -1 unknown
+    int64_t seek_to;            // Output before this frame is dropped
+    int64_t page_granule;       // Ogg: granule of the page the last packet ended on, -1 none
+    uint32_t page_sequence;     // Ogg: that page's sequence number
+    uint32_t page_frames;       // Ogg: longest page seen, in frames
+} ingest_t;
+
+// Where to resume a stream to reach a frame: from byte offset, which starts
+// at frame position (-1 if only known once decoding resumes).
+typedef struct {
+    uint32_t offset;
+    int64_t position;
+    bool exact;                 // Positions after the seek are exact (AAC's are estimated)
+} ingest_seek_t;
+
+// Registers the "ingest" and "downmix" console commands and the telemetry
+// provider.
+void ingest_init(void);
+
+// Starts a new session; the format is sniffed again.
+void ingest_begin(ingest_t *in, ingest_sink_t sink, void *ctx);
+
+// Ends the session, releasing memory taken for it (Ogg Vorbis, AAC).
+void ingest_end(ingest_t *in);
+
+// Heap a session starting with these bytes would take for its decoder: the
+// Vorbis arena for Ogg, the AAC decoder for ADTS, nothing otherwise.
+size_t ingest_codec_memory(const uint8_t *head, size_t len);
+
+// Consumes received bytes. Returns false if the stream cannot be played
+// (unsupported WAV, SBC, Vorbis or AAC parameters); the sender has been told
+// why and the connection should be closed.
+bool ingest_feed(ingest_t *in, const uint8_t *data, size_t len);
+
+// Works out where to fetch from to play on from frame target. WAV, raw PCM
+// and SBC map frames to bytes exactly; AAC and Ogg Vorbis offsets are
+// estimated from the average bitrate so far and aimed early, the frames
+// before target being decoded and dropped. Returns false if the format is
+// not known yet or the bitrate cannot be estimated. Changes nothing.
+bool ingest_seek_plan(const ingest_t *in, uint32_t target, ingest_seek_t *plan);
+
+// Drops partial input and decoder history so the stream can be fed again
+// from plan->offset; output starts at frame target.
+void ingest_seek(ingest_t *in, uint32_t target, const ingest_seek_t *plan);
+
+// Frame of the stream the next output starts at, or -1 while a seek has not
+// landed yet.
+int64_t ingest_position(const ingest_t *in);
+
+const char *ingest_format_name(ingest_format_t format);
@@ -0,0 +1,322 @@
+/*
+ * Impulse-response filter
+ *
+ * The writer (whichever producer owns the playback buffer) gathers frames
+ * into a partition-sized block, convolves it in place and hands it on. The
+ * active convolver is only touched under s_lock, and the block is passed to
+ * the sink after the lock is released, so a writer stuck on a full playback
+ * buffer never holds up "ir load" or "ir off".
+ *
+ * Loading reads the response straight from flash into a new convolver
+ * outside the lock, then swaps it in; nothing stops playing meanwhile. When
+ * the filter changes, frames held for the old one go out unfiltered.
+ */
+
+#include "ir_filter.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "convolver.h"
+#include "telemetry.h"
+
+static const char *TAG = "IR_FILTER";
+
+static const esp_partition_t *s_partition = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+
+// Under s_lock.
+static convolver_t *s_conv = NULL;
+static uint32_t s_generation = 0;       // Bumped on every load or unload
+static char s_name[IR_NAME_LEN + 1] = "off";
+static int s_taps = 0;
+static size_t s_bytes = 0;
+static int s_held = 0;                  // Frames gathered in s_block
+static uint32_t s_held_generation = 0;
+
+// Writer only.
+static int16_t s_block[CONVOLVER_MAX_PARTITION * AUDIO_CHANNELS];
+
+// Written by the writer, read by the console and telemetry.
+static volatile uint32_t s_blocks = 0;
+static volatile uint32_t s_busy_us = 0;
+static volatile uint32_t s_worst_us = 0;
+static volatile uint32_t s_dropped_frames = 0;
+
+static uint32_t s_reported_blocks = 0;
+static uint32_t s_reported_busy_us = 0;
+static int64_t s_reported_us = 0;
+
+// --- Flash image ---
+static int read_header(ir_image_header_t *hdr) {
+    if (s_partition == NULL || esp_partition_read(s_partition, 0, hdr, sizeof(*hdr)) != ESP_OK ||
+        hdr->magic != IR_IMAGE_MAGIC) {
+        return -1;
+    }
+    size_t max = (s_partition->size - sizeof(*hdr)) / sizeof(ir_image_entry_t);
+    if (hdr->count > max) {
+        hdr->count = max;
+    }
+    return 0;
+}
+
+static int read_entry(int i, ir_image_entry_t *e) {
+    size_t pos = sizeof(ir_image_header_t) + i * sizeof(*e);
+    if (esp_partition_read(s_partition, pos, e, sizeof(*e)) != ESP_OK) {
+        return -1;
+    }
+    uint64_t end = e->offset + (uint64_t)e->taps * e->paths * sizeof(float);
+    if (e->taps == 0 || (e->paths != 1 && e->paths != 2 && e->paths != 4) || end > s_partition->size) {
+        return -1;
+    }
+    return 0;
+}
+
+static int find_entry(const char *name, ir_image_entry_t *e) {
+    ir_image_header_t hdr;
+    if (read_header(&hdr) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < hdr.count; i++) {
+        if (read_entry(i, e) == 0 && strncmp(e->name, name, IR_NAME_LEN) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int read_taps(void *ctx, int path, int offset, float *taps, int count) {
+    const ir_image_entry_t *e = ctx;
+    if (e->paths == 1) {
+        path = 0;
+    }
+    size_t pos = e->offset + ((size_t)path * e->taps + offset) * sizeof(float);
+    return esp_partition_read(s_partition, pos, taps, count * sizeof(float)) == ESP_OK ? 0 : -1;
+}
+
+// --- Switching ---
+static void install(convolver_t *conv, const char *name, int taps, size_t bytes) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    convolver_t *old = s_conv;
+    s_conv = conv;
+    s_generation++;
+    snprintf(s_name, sizeof(s_name), "%s", name);
+    s_taps = taps;
+    s_bytes = bytes;
+    s_blocks = 0;
+    s_busy_us = 0;
+    s_worst_us = 0;
+    xSemaphoreGive(s_lock);
+    free(old);
+}
+
+static int ir_filter_load(const char *name, int partition) {
+    ir_image_entry_t e;
+    if (find_entry(name, &e) != 0) {
+        console_printf("No response '%s' in the %s partition\n", name, IR_PARTITION_LABEL);
+        return -1;
+    }
+    if (e.rate != AUDIO_SAMPLE_RATE) {
+        console_printf("'%s' is for %lu Hz; the bridge plays %d Hz\n", name, (unsigned long)e.rate,
+                       AUDIO_SAMPLE_RATE);
+        return -1;
+    }
+    int paths = e.paths == 4 ? 4 : 2;
+    size_t bytes = convolver_size(partition, e.taps, paths);
+    void *mem = malloc(bytes);
+    if (mem == NULL) {
+        console_printf("Not enough memory: %u bytes needed, largest free block %u\n", (unsigned)bytes,
+                       (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+        return -1;
+    }
+
+    int64_t start = esp_timer_get_time();
+    convolver_t *conv = convolver_create(mem, partition, e.taps, paths);
+    int err = convolver_load(conv, read_taps, &e);
+    if (err != 0) {
+        console_printf("Unable to load '%s': %s\n", name, err == -2 ? "gain too high" : "flash read failed");
+        free(mem);
+        return -1;
+    }
+    install(conv, name, e.taps, bytes);
+    ESP_LOGI(TAG, "Loaded '%s': %lu taps, %d paths, %d-frame partitions, %u bytes, %lu ms", name,
+             (unsigned long)e.taps, paths, partition, (unsigned)bytes,
+             (unsigned long)((esp_timer_get_time() - start) / 1000));
+    return 0;
+}
+
+// --- Audio path ---
+size_t ir_filter_write(const void *data, size_t len, audio_sink_t sink, void *ctx) {
+    const int16_t *pcm = data;
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+
+    while (1) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        convolver_t *conv = s_conv;
+        if (s_held_generation != s_generation) {
+            // The filter changed: what was held for the old one goes out as is.
+            s_held_generation = s_generation;
+            int held = s_held;
+            s_held = 0;
+            xSemaphoreGive(s_lock);
+            if (held > 0) {
+                sink(s_block, held * AUDIO_BYTES_PER_FRAME, ctx);
+            }
+            continue;
+        }
+        if (conv == NULL) {
+            xSemaphoreGive(s_lock);
+            size_t rest = len - ((const uint8_t *)pcm - (const uint8_t *)data);
+            return len - rest + sink(pcm, rest, ctx);
+        }
+
+        int partition = convolver_partition(conv);
+        int n = partition - s_held;
+        if (n > frames) {
+            n = frames;
+        }
+        memcpy(s_block + s_held * AUDIO_CHANNELS, pcm, n * AUDIO_BYTES_PER_FRAME);
+        s_held += n;
+        pcm += n * AUDIO_CHANNELS;
+        frames -= n;
+        if (s_held < partition) {
+            xSemaphoreGive(s_lock);
+            return len;
+        }
+
+        int64_t start = esp_timer_get_time();
+        convolver_process(conv, s_block);
+        uint32_t us = esp_timer_get_time() - start;
+        s_held = 0;
+        xSemaphoreGive(s_lock);
+        s_blocks++;
+        s_busy_us += us;
+        if (us > s_worst_us) {
+            s_worst_us = us;
+        }
+
+        size_t bytes = partition * AUDIO_BYTES_PER_FRAME;
+        size_t sent = sink(s_block, bytes, ctx);
+        if (sent < bytes) {
+            s_dropped_frames += (bytes - sent) / AUDIO_BYTES_PER_FRAME;
+        }
+    }
+}
+
+size_t ir_filter_latency_frames(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t frames = s_conv != NULL ? convolver_partition(s_conv) + s_held : 0;
+    xSemaphoreGive(s_lock);
+    return frames;
+}
+
+void ir_filter_reset(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_conv != NULL) {
+        convolver_reset(s_conv);
+    }
+    s_held = 0;
+    xSemaphoreGive(s_lock);
+}
+
+// --- Console and telemetry ---
+static int ir_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    uint32_t blocks = s_blocks;
+    uint32_t busy_us = s_busy_us;
+    double span_us = s_reported_us ? now - s_reported_us : 0;
+    // Counters restart on every load; report from there.
+    uint32_t base_blocks = blocks >= s_reported_blocks ? s_reported_blocks : 0;
+    uint32_t base_busy = busy_us >= s_reported_busy_us ? s_reported_busy_us : 0;
+
+    int n = snprintf(buf, len, "name=%s cpu=%.1f%% blocks=%lu worst_us=%lu dropped=%lu", s_name,
+                     span_us > 0 ? (busy_us - base_busy) / span_us * 100 : 0.0,
+                     (unsigned long)(blocks - base_blocks), (unsigned long)s_worst_us,
+                     (unsigned long)s_dropped_frames);
+    s_reported_blocks = blocks;
+    s_reported_busy_us = busy_us;
+    s_reported_us = now;
+    return n;
+}
+
+static void list_responses(void) {
+    ir_image_header_t hdr;
+    if (read_header(&hdr) != 0) {
+        console_printf("No response image in the %s partition (see tools/ir_pack.py)\n", IR_PARTITION_LABEL);
+        return;
+    }
+    for (int i = 0; i < hdr.count; i++) {
+        ir_image_entry_t e;
+        if (read_entry(i, &e) != 0) {
+            console_printf("  entry %d is damaged\n", i);
+            continue;
+        }
+        console_printf("  %-16.16s  %5lu taps (%.1f ms)  %lu path%s  %lu Hz\n", e.name, (unsigned long)e.taps,
+                       e.taps * 1000.0 / e.rate, (unsigned long)e.paths, e.paths > 1 ? "s" : "",
+                       (unsigned long)e.rate);
+    }
+}
+
+static int cmd_ir(int argc, char **argv) {
+    if (argc < 2) {
+        if (s_partition == NULL) {
+            console_printf("No '%s' partition in the partition table\n", IR_PARTITION_LABEL);
+            return 0;
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (s_conv != NULL) {
+            int partition = convolver_partition(s_conv);
+            uint32_t blocks = s_blocks;
+            console_printf("ir %s: %d taps, %d-frame partitions (%.1f ms latency), %u bytes, "
+                           "%lu us per block (worst %lu), %lu clipped, %lu frames dropped\n",
+                           s_name, s_taps, partition, partition * 1000.0 / AUDIO_SAMPLE_RATE, (unsigned)s_bytes,
+                           (unsigned long)(blocks ? s_busy_us / blocks : 0), (unsigned long)s_worst_us,
+                           (unsigned long)convolver_clipped(s_conv), (unsigned long)s_dropped_frames);
+        } else {
+            console_printf("ir off\n");
+        }
+        xSemaphoreGive(s_lock);
+        list_responses();
+        console_printf("Usage: ir load <name> [partition frames] | ir off\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "off") == 0) {
+        install(NULL, "off", 0, 0);
+        return 0;
+    }
+    if (strcmp(argv[1], "load") == 0 && argc > 2) {
+        int partition = argc > 3 ? atoi(argv[3]) : IR_DEFAULT_PARTITION;
+        if (partition < CONVOLVER_MIN_PARTITION || partition > CONVOLVER_MAX_PARTITION ||
+            (partition & (partition - 1)) != 0) {
+            console_printf("Partition must be a power of two from %d to %d\n", CONVOLVER_MIN_PARTITION,
+                           CONVOLVER_MAX_PARTITION);
+            return -1;
+        }
+        if (s_partition == NULL) {
+            console_printf("No '%s' partition in the partition table\n", IR_PARTITION_LABEL);
+            return -1;
+        }
+        return ir_filter_load(argv[2], partition);
+    }
+    console_printf("Unknown argument '%s'\n", argv[1]);
+    return -1;
+}
+
+void ir_filter_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, IR_PARTITION_SUBTYPE, IR_PARTITION_LABEL);
+    if (s_partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition; the IR filter is unavailable", IR_PARTITION_LABEL);
+    }
+    console_register("ir", "Impulse-response filter from flash: ir [load <name> [frames] | off]", cmd_ir);
+    telemetry_register("ir", ir_telemetry);
+}
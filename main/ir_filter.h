@@ -0,0 +1,52 @@
+/*
+ * Impulse-response filter in the playback path: convolves everything
+ * written to the playback buffer with a response loaded from the "ir" flash
+ * partition (see tools/ir_pack.py), for headphone or room correction and
+ * binaural virtualization. Adds one partition of latency while active.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_bridge.h"
+
+#define IR_PARTITION_LABEL      "ir"
+#define IR_PARTITION_SUBTYPE    0x40
+#define IR_IMAGE_MAGIC          0x31425249  // "IRB1" little endian
+#define IR_NAME_LEN             16
+#define IR_DEFAULT_PARTITION    256         // Frames; 5.8 ms at 44.1 kHz
+
+// The partition starts with this header and count entries. Each response
+// is paths (1, 2 or 4) runs of taps little-endian floats, one path after
+// another: a single path filters both channels; two filter left and right;
+// four are left to left, left to right, right to left, right to right.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t count;
+} ir_image_header_t;
+
+typedef struct __attribute__((packed)) {
+    char name[IR_NAME_LEN];                 // NUL padded
+    uint32_t rate;
+    uint32_t taps;
+    uint32_t paths;
+    uint32_t offset;                        // From the start of the partition
+} ir_image_entry_t;
+
+// Registers the "ir" command and telemetry.
+void ir_filter_init(void);
+
+// Runs len bytes of interleaved stereo through the active filter and hands
+// the result to sink a partition at a time, holding back frames short of a
+// partition until the next call. Without a filter, data goes straight to
+// sink. One writer at a time.
+size_t ir_filter_write(const void *data, size_t len, audio_sink_t sink, void *ctx);
+
+// Frames between the writer's input and what it has handed to sink: the
+// active filter's partition plus the frames held for the next one.
+size_t ir_filter_latency_frames(void);
+
+// Drops held frames and the filter's memory of past input; call from the
+// writer when a different producer takes over.
+void ir_filter_reset(void);
@@ -0,0 +1,89 @@
+/*
+ * Secure link benchmark
+ *
+ * Only opening is timed, as the bridge never seals: each run seals a fresh
+ * record outside the measurement and then times the in-place open the TCP
+ * server would do, tag check and decryption both. The record is on the
+ * heap, where the TCP server's session also lives.
+ */
+
+#include "link_bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "esp_random.h"
+#include "mbedtls/gcm.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "chachapoly.h"
+#include "secure_link.h"
+
+#define LINK_BENCH_RUNS     64
+
+static const size_t s_sizes[] = { 256, 512, SECURE_LINK_MAX_RECORD };
+
+static void report(const char *name, size_t size, uint32_t cycles) {
+    double mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    double per_byte = (double)cycles / LINK_BENCH_RUNS / size;
+    console_printf("%-18s %5u-byte records: %6.1f cycles/byte, %5.2f%% cpu@%dMHz at 1411 kbit/s\n", name,
+                   (unsigned)size, per_byte, per_byte * AUDIO_BYTES_PER_SEC / (mhz * 1e6) * 100,
+                   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+static void link_bench(void) {
+    uint8_t *rec = malloc(SECURE_LINK_RECORD_BYTES);
+    mbedtls_gcm_context *gcm = malloc(sizeof(*gcm));
+    if (!rec || !gcm) {
+        console_printf("link: out of memory\n");
+        free(rec);
+        free(gcm);
+        return;
+    }
+    uint8_t key[SECURE_LINK_KEY_LEN];
+    uint8_t nonce[12] = { 0 };
+    esp_fill_random(key, sizeof(key));
+    mbedtls_gcm_init(gcm);
+    mbedtls_gcm_setkey(gcm, MBEDTLS_CIPHER_ID_AES, key, sizeof(key) * 8);
+
+    for (int s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); s++) {
+        size_t size = s_sizes[s];
+        uint8_t *data = rec + 2;
+        uint8_t *tag = data + size;
+        rec[0] = (uint8_t)size;
+        rec[1] = (uint8_t)(size >> 8);
+
+        esp_fill_random(data, size);
+
+        uint32_t cycles = 0;
+        int failed = 0;
+        for (int i = 0; i < LINK_BENCH_RUNS; i++) {
+            chachapoly_seal(key, nonce, rec, 2, data, size, tag);
+            uint32_t t = esp_cpu_get_cycle_count();
+            failed += !chachapoly_open(key, nonce, rec, 2, data, size, tag);
+            cycles += esp_cpu_get_cycle_count() - t;
+        }
+        report("chacha20-poly1305", size, cycles);
+
+        cycles = 0;
+        for (int i = 0; i < LINK_BENCH_RUNS; i++) {
+            mbedtls_gcm_crypt_and_tag(gcm, MBEDTLS_GCM_ENCRYPT, size, nonce, sizeof(nonce), rec, 2, data, data,
+                                      SECURE_LINK_TAG_LEN, tag);
+            uint32_t t = esp_cpu_get_cycle_count();
+            failed += mbedtls_gcm_auth_decrypt(gcm, size, nonce, sizeof(nonce), rec, 2, tag, SECURE_LINK_TAG_LEN,
+                                               data, data) != 0;
+            cycles += esp_cpu_get_cycle_count() - t;
+        }
+        report("aes-256-gcm", size, cycles);
+        if (failed > 0) {
+            console_printf("link: %d records failed to open\n", failed);
+        }
+    }
+    mbedtls_gcm_free(gcm);
+    free(gcm);
+    free(rec);
+}
+
+void link_bench_init(void) {
+    console_register_bench("link", link_bench);
+}
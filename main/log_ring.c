@@ -0,0 +1,143 @@
+/*
+ * Binary log ring
+ *
+ * Bounded multi-producer queue (one sequence number per slot): a writer claims
+ * a slot with a compare-and-swap on the head, fills it and publishes it by
+ * storing the slot's sequence. Both cores may write; only the drain task reads.
+ * When the ring is full the entry is dropped and counted instead of waiting.
+ */
+
+#include "log_ring.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "bridge_console.h"
+
+static const char *TAG = "RT_LOG";
+
+#define LOG_RING_ENTRIES        128     // Must be a power of two
+#define LOG_RING_DRAIN_MS       50
+#define LOG_RING_BENCH_CALLS    64
+#define LOG_RING_BENCH_LOGI     16
+
+typedef struct {
+    atomic_uint seq;
+    uint32_t timestamp_us;
+    uint16_t id;
+    int32_t args[3];
+} log_ring_entry_t;
+
+static const char *const s_formats[LR_EVENT_COUNT] = {
+#define LOG_RING_FORMAT(id, fmt) [id] = fmt,
+    LOG_RING_EVENTS(LOG_RING_FORMAT)
+#undef LOG_RING_FORMAT
+};
+
+static log_ring_entry_t s_entries[LOG_RING_ENTRIES];
+static atomic_uint s_head;
+static unsigned s_tail;             // Drain task only
+static atomic_uint s_dropped;
+
+void log_ring_write(log_ring_event_t id, int32_t a, int32_t b, int32_t c) {
+    unsigned pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+    while (1) {
+        log_ring_entry_t *e = &s_entries[pos & (LOG_RING_ENTRIES - 1)];
+        unsigned seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            // Slot is free for this lap; try to claim it. On failure pos is reloaded.
+            if (atomic_compare_exchange_weak_explicit(&s_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                e->timestamp_us = (uint32_t)esp_timer_get_time();
+                e->id = id;
+                e->args[0] = a;
+                e->args[1] = b;
+                e->args[2] = c;
+                atomic_store_explicit(&e->seq, pos + 1, memory_order_release);
+                return;
+            }
+        } else if (diff < 0) {
+            // The drain task has not freed this slot yet: ring is full.
+            atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+        }
+    }
+}
+
+static void log_ring_drain(void) {
+    char line[160];
+    while (1) {
+        log_ring_entry_t *e = &s_entries[s_tail & (LOG_RING_ENTRIES - 1)];
+        if (atomic_load_explicit(&e->seq, memory_order_acquire) != s_tail + 1) {
+            break;
+        }
+        uint32_t ts = e->timestamp_us;
+        uint16_t id = e->id;
+        long a = e->args[0], b = e->args[1], c = e->args[2];
+        atomic_store_explicit(&e->seq, s_tail + LOG_RING_ENTRIES, memory_order_release);
+        s_tail++;
+
+        // Benchmark entries only exist to be timed.
+        if (id == LR_BENCH || id >= LR_EVENT_COUNT) {
+            continue;
+        }
+        snprintf(line, sizeof(line), s_formats[id], a, b, c);
+        ESP_LOGI(TAG, "[%lu.%06lu] %s", (unsigned long)(ts / 1000000), (unsigned long)(ts % 1000000), line);
+    }
+}
+
+static void log_ring_task(void *pvParameters) {
+    unsigned reported_drops = 0;
+    while (1) {
+        log_ring_drain();
+        unsigned dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+        if (dropped != reported_drops) {
+            ESP_LOGW(TAG, "%u entries dropped (ring full)", dropped - reported_drops);
+            reported_drops = dropped;
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOG_RING_DRAIN_MS));
+    }
+}
+
+// --- Benchmark: log_ring_write versus ESP_LOGI ---
+static void log_ring_bench(void) {
+    // Stay under the ring size so every call takes the normal (non-drop) path.
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < LOG_RING_BENCH_CALLS; i++) {
+        log_ring_write(LR_BENCH, i, 0, 0);
+    }
+    uint32_t ring_cycles = (esp_cpu_get_cycle_count() - start) / LOG_RING_BENCH_CALLS;
+
+    uint32_t logi_total = 0;
+    uint32_t logi_worst = 0;
+    for (int i = 0; i < LOG_RING_BENCH_LOGI; i++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        ESP_LOGI(TAG, "benchmark entry %d 0 0", i);
+        uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+        logi_total += cycles;
+        if (cycles > logi_worst) {
+            logi_worst = cycles;
+        }
+    }
+
+    console_printf("log_ring_write: %lu cycles/call\n", (unsigned long)ring_cycles);
+    console_printf("ESP_LOGI:       %lu cycles/call (worst %lu)\n",
+                   (unsigned long)(logi_total / LOG_RING_BENCH_LOGI), (unsigned long)logi_worst);
+}
+
+void log_ring_init(void) {
+    for (unsigned i = 0; i < LOG_RING_ENTRIES; i++) {
+        atomic_store_explicit(&s_entries[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&s_head, 0, memory_order_relaxed);
+    s_tail = 0;
+    xTaskCreate(log_ring_task, "log_ring", 3072, NULL, 1, NULL);
+    console_register_bench("log", log_ring_bench);
+}
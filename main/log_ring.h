@@ -0,0 +1,33 @@
+/*
+ * Binary log ring for real-time code.
+ *
+ * a2d_data_cb and the recv loop must not wait on the UART, so they record a
+ * format ID, up to three integer arguments and a timestamp into a lock-free
+ * ring. A low-priority task formats the entries later.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Event IDs and their format strings; formats take up to three %ld arguments.
+#define LOG_RING_EVENTS(X) \
+    X(LR_BENCH,              "benchmark entry %ld %ld %ld") \
+    X(LR_A2D_UNDERRUN_BEGIN, "a2d_data_cb underrun: got %ld of %ld bytes") \
+    X(LR_A2D_UNDERRUN_END,   "a2d_data_cb recovered after %ld short calls (%ld bytes of silence)") \
+    X(LR_A2D_LATE_CALL,      "a2d_data_cb late: %ld ms since previous call (average %ld us), len %ld") \
+    X(LR_TCP_SEND_STALL,     "recv loop blocked %ld ms pushing %ld bytes, buffer %ld bytes") \
+    X(LR_LIVE_DROP,          "live stream over its bound: dropped %ld bytes, %ld left buffered (bound %ld)")
+
+typedef enum {
+#define LOG_RING_ENUM(id, fmt) id,
+    LOG_RING_EVENTS(LOG_RING_ENUM)
+#undef LOG_RING_ENUM
+    LR_EVENT_COUNT
+} log_ring_event_t;
+
+// Resets the ring, starts the drain task and registers "bench log".
+void log_ring_init(void);
+
+// Records one event. Never blocks; drops the entry if the ring is full.
+void log_ring_write(log_ring_event_t id, int32_t a, int32_t b, int32_t c);
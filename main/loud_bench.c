@@ -0,0 +1,89 @@
+/*
+ * Loudness compensation benchmark
+ *
+ * Steps a filter from flat to the default bass and treble boosts, timing
+ * every coefficient update on the cycle counter, then times noise through
+ * the settled filter and through a crossfade (which runs both coefficient
+ * sets). The settle time is what a jump from full volume to zero costs:
+ * one crossfade per LOUDNESS_EQ_STEP_DB of the larger shelf change.
+ */
+
+#include "loud_bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "loudness_eq.h"
+
+#define LOUD_BENCH_FRAMES   LOUDNESS_EQ_FADE_FRAMES
+
+static void fill_noise(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 4 - 8192;
+    }
+}
+
+static void loud_bench(void) {
+    const size_t bytes = 2 * LOUD_BENCH_FRAMES * sizeof(int16_t);
+    int16_t *in = malloc(bytes);
+    int16_t *work = malloc(bytes);
+    loudness_eq_t *e = malloc(sizeof(*e));
+    if (!in || !work || !e) {
+        console_printf("loud: out of memory\n");
+        goto done;
+    }
+    fill_noise(in, LOUD_BENCH_FRAMES);
+
+    // Coefficient updates, each followed by its crossfade.
+    loudness_eq_init(e, 100, 10000, AUDIO_SAMPLE_RATE);
+    loudness_eq_set(e, 12, 3);
+    uint32_t update_total = 0, update_worst = 0, fade_total = 0, frames = 0;
+    while (1) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        bool stepped = loudness_eq_step(e);
+        uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+        if (!stepped) {
+            break;
+        }
+        update_total += cycles;
+        update_worst = cycles > update_worst ? cycles : update_worst;
+        memcpy(work, in, bytes);
+        t0 = esp_cpu_get_cycle_count();
+        loudness_eq_process(e, work, LOUD_BENCH_FRAMES);
+        fade_total += esp_cpu_get_cycle_count() - t0;
+        frames += LOUD_BENCH_FRAMES;
+    }
+    uint32_t steps = e->steps;
+
+    // Settled.
+    memcpy(work, in, bytes);
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    loudness_eq_process(e, work, LOUD_BENCH_FRAMES);
+    uint32_t settled = (esp_cpu_get_cycle_count() - t0) / LOUD_BENCH_FRAMES;
+    uint32_t fading = frames ? fade_total / frames : 0;
+
+    double mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    // The last update lands on the target with powf() and usually costs most.
+    console_printf("coefficient update: %lu cycles (worst %lu), %lu steps from flat to +12/+3 dB\n",
+                   (unsigned long)(steps ? update_total / steps : 0), (unsigned long)update_worst,
+                   (unsigned long)steps);
+    console_printf("settled:   %4lu cycles per frame, %.1f%% cpu@%dMHz\n", (unsigned long)settled,
+                   settled * AUDIO_SAMPLE_RATE / (mhz * 1e6) * 100, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    console_printf("fading:    %4lu cycles per frame, %.1f%% cpu@%dMHz\n", (unsigned long)fading,
+                   fading * AUDIO_SAMPLE_RATE / (mhz * 1e6) * 100, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    console_printf("settle time for that change: %.0f ms; %lu samples clipped\n",
+                   frames * 1000.0 / AUDIO_SAMPLE_RATE, (unsigned long)e->clipped);
+
+done:
+    free(in);
+    free(work);
+    free(e);
+}
+
+void loud_bench_init(void) {
+    console_register_bench("loud", loud_bench);
+}
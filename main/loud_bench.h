@@ -0,0 +1,10 @@
+/*
+ * Loudness compensation benchmark ("bench loud"): cycles per coefficient
+ * update, cycles per frame settled and while crossfading, and how long a
+ * full volume swing takes to settle.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void loud_bench_init(void);
@@ -0,0 +1,200 @@
+/*
+ * Loudness compensation stage
+ *
+ * The volume is mapped to an attenuation below the reference volume,
+ * linear in dB over range_db (AVRCP volume is a fader position, and most
+ * headphones space its steps evenly in dB). Each shelf's boost grows in
+ * proportion, reaching its configured gain at the bottom of the range; the
+ * ISO 226 contours between 80 and 40 phon need roughly 10 dB more at 50 Hz
+ * and a few dB more at 10 kHz.
+ *
+ * The writer checks the volume on every call, sets new shelf targets when
+ * it has moved, and the filter steps toward them on its own. Like the
+ * compressor stage, audio is processed under s_lock in chunks and passed to
+ * the sink after the lock is released.
+ */
+
+#include "loudness.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bridge_console.h"
+#include "loudness_eq.h"
+#include "telemetry.h"
+#include "volume.h"
+
+#define LOUDNESS_CHUNK_FRAMES   256
+#define LOUDNESS_BASS_HZ        100
+#define LOUDNESS_TREBLE_HZ      10000
+
+static const char *TAG = "LOUDNESS";
+
+static SemaphoreHandle_t s_lock = NULL;
+
+// Under s_lock.
+static loudness_eq_t s_eq;
+static bool s_enabled = false;
+static int s_reference = VOLUME_MAX;        // Volume that needs no compensation
+static float s_range_db = 48;               // Attenuation at volume 0
+static float s_bass_db = 12;                // Boosts at volume 0
+static float s_treble_db = 3;
+static int s_applied_volume = -2;           // Volume the targets were set for
+
+// Writer only.
+static int16_t s_block[LOUDNESS_CHUNK_FRAMES * AUDIO_CHANNELS];
+
+// Written by the writer, read by telemetry.
+static volatile uint32_t s_busy_us = 0;
+
+static uint32_t s_reported_busy_us = 0;
+static int64_t s_reported_us = 0;
+
+// Attenuation below the reference for a volume; an unknown volume is
+// taken as the reference, so nothing changes until one is reported.
+static float attenuation_db(int volume) {
+    if (volume < 0 || volume >= s_reference) {
+        return 0;
+    }
+    return s_range_db * (s_reference - volume) / s_reference;
+}
+
+// Under s_lock.
+static void retarget(int volume) {
+    float atten = attenuation_db(volume);
+    loudness_eq_set(&s_eq, s_bass_db * atten / s_range_db, s_treble_db * atten / s_range_db);
+    s_applied_volume = volume;
+}
+
+// --- Audio path ---
+size_t loudness_write(const void *data, size_t len, audio_sink_t sink, void *ctx) {
+    const int16_t *pcm = data;
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+    size_t sent = 0;
+
+    while (frames > 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (!s_enabled) {
+            xSemaphoreGive(s_lock);
+            return sent + sink(pcm, len - sent, ctx);
+        }
+        int volume = volume_get();
+        if (volume != s_applied_volume) {
+            retarget(volume);
+        }
+        size_t n = frames < LOUDNESS_CHUNK_FRAMES ? frames : LOUDNESS_CHUNK_FRAMES;
+        memcpy(s_block, pcm, n * AUDIO_BYTES_PER_FRAME);
+        int64_t start = esp_timer_get_time();
+        loudness_eq_process(&s_eq, s_block, n);
+        s_busy_us += esp_timer_get_time() - start;
+        xSemaphoreGive(s_lock);
+
+        size_t bytes = n * AUDIO_BYTES_PER_FRAME;
+        size_t accepted = sink(s_block, bytes, ctx);
+        sent += accepted;
+        if (accepted < bytes) {
+            return sent;
+        }
+        pcm += n * AUDIO_CHANNELS;
+        frames -= n;
+    }
+    return sent;
+}
+
+// Under s_lock. Starts from the current volume's gains without stepping.
+static void restart(void) {
+    loudness_eq_init(&s_eq, LOUDNESS_BASS_HZ, LOUDNESS_TREBLE_HZ, AUDIO_SAMPLE_RATE);
+    retarget(volume_get());
+    loudness_eq_settle(&s_eq);
+}
+
+void loudness_reset(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    restart();
+    xSemaphoreGive(s_lock);
+}
+
+// --- Console and telemetry ---
+static int loudness_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    uint32_t busy_us = s_busy_us;
+    double span_us = s_reported_us ? now - s_reported_us : 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = snprintf(buf, len, "on=%d volume=%d bass=%.1f treble=%.1f steps=%lu clipped=%lu cpu=%.1f%%", s_enabled,
+                     volume_get(), s_eq.shelf[LOUDNESS_EQ_BASS].db, s_eq.shelf[LOUDNESS_EQ_TREBLE].db,
+                     (unsigned long)s_eq.steps, (unsigned long)s_eq.clipped,
+                     span_us > 0 ? (busy_us - s_reported_busy_us) / span_us * 100 : 0.0);
+    xSemaphoreGive(s_lock);
+    s_reported_busy_us = busy_us;
+    s_reported_us = now;
+    return n;
+}
+
+static int cmd_loudness(int argc, char **argv) {
+    if (argc < 2) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int volume = volume_get();
+        console_printf("loudness %s: volume %d, %.1f dB below reference %d; bass %+.1f dB, treble %+.1f dB\n",
+                       s_enabled ? "on" : "off", volume, attenuation_db(volume), s_reference,
+                       s_eq.shelf[LOUDNESS_EQ_BASS].db, s_eq.shelf[LOUDNESS_EQ_TREBLE].db);
+        console_printf("  range %.0f dB, bass %+.1f dB and treble %+.1f dB at volume 0, %lu steps, %lu clipped\n",
+                       s_range_db, s_bass_db, s_treble_db, (unsigned long)s_eq.steps, (unsigned long)s_eq.clipped);
+        xSemaphoreGive(s_lock);
+        console_printf("Usage: loudness on | off | ref <1-%d> | range <dB> | bass <dB> | treble <dB>\n", VOLUME_MAX);
+        return 0;
+    }
+    if (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0) {
+        bool on = argv[1][1] == 'n';
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (on && !s_enabled) {
+            restart();
+        }
+        s_enabled = on;
+        xSemaphoreGive(s_lock);
+        ESP_LOGI(TAG, "Loudness compensation %s", on ? "on" : "off");
+        return 0;
+    }
+    if (argc < 3) {
+        console_printf("Unknown argument '%s'\n", argv[1]);
+        return -1;
+    }
+
+    float value = atof(argv[2]);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int err = 0;
+    if (strcmp(argv[1], "ref") == 0 && value >= 1 && value <= VOLUME_MAX) {
+        s_reference = value;
+    } else if (strcmp(argv[1], "range") == 0 && value >= 10 && value <= 90) {
+        s_range_db = value;
+    } else if (strcmp(argv[1], "bass") == 0 && fabsf(value) <= LOUDNESS_EQ_MAX_DB) {
+        s_bass_db = value;
+    } else if (strcmp(argv[1], "treble") == 0 && fabsf(value) <= LOUDNESS_EQ_MAX_DB) {
+        s_treble_db = value;
+    } else {
+        err = -1;
+    }
+    if (err == 0) {
+        retarget(volume_get());
+    }
+    xSemaphoreGive(s_lock);
+    if (err != 0) {
+        console_printf("Expected ref 1-%d, range 10-90 dB, or bass/treble within +-%.0f dB\n", VOLUME_MAX,
+                       LOUDNESS_EQ_MAX_DB);
+    }
+    return err;
+}
+
+void loudness_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    loudness_eq_init(&s_eq, LOUDNESS_BASS_HZ, LOUDNESS_TREBLE_HZ, AUDIO_SAMPLE_RATE);
+    console_register("loudness", "Volume-dependent loudness compensation: loudness [on | off | ref|range|bass|treble <v>]",
+                     cmd_loudness);
+    telemetry_register("loud", loudness_telemetry);
+}
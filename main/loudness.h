@@ -0,0 +1,22 @@
+/*
+ * Volume-dependent loudness compensation in the playback path: as the
+ * listening volume (see volume.h) drops below a reference, bass and treble
+ * shelves rise so the balance heard stays the same. Off until enabled on
+ * the console ("loudness on"); adds no latency.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "audio_bridge.h"
+
+// Registers the "loudness" command and telemetry.
+void loudness_init(void);
+
+// Filters len bytes of interleaved stereo and hands the result to sink.
+// Returns the bytes sink accepted. One writer at a time.
+size_t loudness_write(const void *data, size_t len, audio_sink_t sink, void *ctx);
+
+// Clears filter state; call from the writer when a different producer takes
+// over.
+void loudness_reset(void);
@@ -0,0 +1,284 @@
+/*
+ * Loudness compensation filter
+ *
+ * The shelves are RBJ cookbook shelves with slope 1, so alpha depends only
+ * on the frequency and A = 10^(dB / 40) enters through A and sqrt(A). A step
+ * of LOUDNESS_EQ_STEP_DB multiplies sqrt(A) by a constant, which leaves a
+ * few multiplies and one divide per coefficient set; only the final step
+ * onto an arbitrary target needs powf(). Updates run in single precision,
+ * which the ESP32's FPU does in hardware.
+ *
+ * The attenuation that keeps the largest boost from clipping is folded into
+ * the numerator of the shelf that boosts most. During a crossfade both
+ * filter sets run on the same input; the new set starts from the old one's
+ * state, and the fade hides the small transient that leaves. That state is
+ * first scaled by the change in attenuation: a step moves it by the step
+ * size, and the bass shelf's poles sit so close to z = 1 that an output
+ * history that far off rings for hundreds of milliseconds.
+ *
+ * The float32 pipeline keeps a float copy of each set per channel, made
+ * from the quantized coefficients whenever they change, and runs it in
+ * planar blocks through the DSP kernels.
+ */
+
+#include "loudness_eq.h"
+
+#include <math.h>
+#include <string.h>
+
+#define INTERNAL_SHIFT  12
+#define FADE_BITS       7
+
+_Static_assert(LOUDNESS_EQ_FADE_FRAMES == 1 << FADE_BITS, "crossfade length must match FADE_BITS");
+
+static int32_t quantize(float v) {
+    return (int32_t)lrintf(v * (1 << BIQUAD_COEF_BITS));
+}
+
+static void shelf_coefs(biquad_t *f, const loudness_eq_shelf_t *sh, bool high, float pre) {
+    float a = sh->root * sh->root;
+    float t = 2 * sh->root * sh->alpha;
+    float ap1 = a + 1;
+    float am1c = (a - 1) * sh->cos_w0;
+    float ap1c = ap1 * sh->cos_w0;
+    float b0, b1, b2, a0, a1, a2;
+    if (high) {
+        b0 = a * (ap1 + am1c + t);
+        b1 = -2 * a * ((a - 1) + ap1c);
+        b2 = a * (ap1 + am1c - t);
+        a0 = ap1 - am1c + t;
+        a1 = 2 * ((a - 1) - ap1c);
+        a2 = ap1 - am1c - t;
+    } else {
+        b0 = a * (ap1 - am1c + t);
+        b1 = 2 * a * ((a - 1) - ap1c);
+        b2 = a * (ap1 - am1c - t);
+        a0 = ap1 + am1c + t;
+        a1 = -2 * ((a - 1) + ap1c);
+        a2 = ap1 + am1c - t;
+    }
+    float inv = 1 / a0;
+    float g = pre * inv;
+    f->b0 = quantize(b0 * g);
+    f->b1 = quantize(b1 * g);
+    f->b2 = quantize(b2 * g);
+    f->a1 = quantize(a1 * inv);
+    f->a2 = quantize(a2 * inv);
+}
+
+// Coefficients for the shelves' current gains.
+static void design(loudness_eq_t *e, biquad_t *out) {
+    const loudness_eq_shelf_t *bass = &e->shelf[LOUDNESS_EQ_BASS];
+    const loudness_eq_shelf_t *treble = &e->shelf[LOUDNESS_EQ_TREBLE];
+    // A shelf's peak gain is A^2 = root^4.
+    float peak_bass = bass->root * bass->root * bass->root * bass->root;
+    float peak_treble = treble->root * treble->root * treble->root * treble->root;
+    bool bass_first = peak_bass >= peak_treble;
+    float peak = bass_first ? peak_bass : peak_treble;
+    float pre = peak > 1 ? 1 / peak : 1;
+    e->shelf[LOUDNESS_EQ_BASS].pre = bass_first ? pre : 1;
+    e->shelf[LOUDNESS_EQ_TREBLE].pre = bass_first ? 1 : pre;
+    shelf_coefs(&out[LOUDNESS_EQ_BASS], bass, false, e->shelf[LOUDNESS_EQ_BASS].pre);
+    shelf_coefs(&out[LOUDNESS_EQ_TREBLE], treble, true, e->shelf[LOUDNESS_EQ_TREBLE].pre);
+}
+
+// Scales the new set's states, copied from the old set, by how much the
+// new attenuation scales each section's input and output. Direct form I
+// (fixed point) holds both; the float sections' direct form II state comes
+// before the numerator, so only the input counts.
+static void rescale_states(loudness_eq_t *e, const float old_pre[LOUDNESS_EQ_SHELVES]) {
+    float in = 1;
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        float out = in * e->shelf[s].pre / old_pre[s];
+        for (int ch = 0; ch < 2; ch++) {
+            biquad_state_t *st = &e->next_state[s][ch];
+            st->x1 = (int32_t)lrintf(st->x1 * in);
+            st->x2 = (int32_t)lrintf(st->x2 * in);
+            st->y1 = (int32_t)lrintf(st->y1 * out);
+            st->y2 = (int32_t)lrintf(st->y2 * out);
+            e->next_f[s][ch].w[0] *= in;
+            e->next_f[s][ch].w[1] *= in;
+        }
+        in = out;
+    }
+}
+
+// Float copies of set for both channels, taking over the states in out.
+static void float_set(dsp_biquad_t out[LOUDNESS_EQ_SHELVES][2], const biquad_t *set) {
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        for (int ch = 0; ch < 2; ch++) {
+            float w0 = out[s][ch].w[0], w1 = out[s][ch].w[1];
+            dsp_biquad_from_q28(&out[s][ch], &set[s]);
+            out[s][ch].w[0] = w0;
+            out[s][ch].w[1] = w1;
+        }
+    }
+}
+
+void loudness_eq_init(loudness_eq_t *e, float bass_hz, float treble_hz, uint32_t rate) {
+    memset(e, 0, sizeof(*e));
+    const float hz[LOUDNESS_EQ_SHELVES] = { bass_hz, treble_hz };
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        float w0 = 2 * (float)M_PI * hz[s] / rate;
+        e->shelf[s].cos_w0 = cosf(w0);
+        e->shelf[s].alpha = sinf(w0) * (float)M_SQRT1_2;
+        e->shelf[s].root = 1;
+    }
+    e->up = powf(10, LOUDNESS_EQ_STEP_DB / 80);
+    e->down = 1 / e->up;
+    design(e, e->cur);
+    float_set(e->cur_f, e->cur);
+}
+
+void loudness_eq_set(loudness_eq_t *e, float bass_db, float treble_db) {
+    const float db[LOUDNESS_EQ_SHELVES] = { bass_db, treble_db };
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        e->shelf[s].target_db = fmaxf(-LOUDNESS_EQ_MAX_DB, fminf(LOUDNESS_EQ_MAX_DB, db[s]));
+    }
+}
+
+void loudness_eq_settle(loudness_eq_t *e) {
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        e->shelf[s].root = powf(10, e->shelf[s].target_db / 80);
+        e->shelf[s].db = e->shelf[s].target_db;
+    }
+    design(e, e->cur);
+    float_set(e->cur_f, e->cur);
+    e->fade = 0;
+}
+
+bool loudness_eq_busy(const loudness_eq_t *e) {
+    return e->fade > 0 || e->shelf[LOUDNESS_EQ_BASS].db != e->shelf[LOUDNESS_EQ_BASS].target_db ||
+           e->shelf[LOUDNESS_EQ_TREBLE].db != e->shelf[LOUDNESS_EQ_TREBLE].target_db;
+}
+
+bool loudness_eq_step(loudness_eq_t *e) {
+    bool moved = false;
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        loudness_eq_shelf_t *sh = &e->shelf[s];
+        float d = sh->target_db - sh->db;
+        if (d == 0) {
+            continue;
+        }
+        if (d > LOUDNESS_EQ_STEP_DB) {
+            sh->root *= e->up;
+            sh->db += LOUDNESS_EQ_STEP_DB;
+        } else if (d < -LOUDNESS_EQ_STEP_DB) {
+            sh->root *= e->down;
+            sh->db -= LOUDNESS_EQ_STEP_DB;
+        } else {
+            // Landing on the target also clears drift from the products.
+            sh->root = powf(10, sh->target_db / 80);
+            sh->db = sh->target_db;
+        }
+        moved = true;
+    }
+    if (!moved) {
+        return false;
+    }
+    const float old_pre[LOUDNESS_EQ_SHELVES] = { e->shelf[LOUDNESS_EQ_BASS].pre, e->shelf[LOUDNESS_EQ_TREBLE].pre };
+    design(e, e->next);
+    memcpy(e->next_state, e->cur_state, sizeof(e->next_state));
+    memcpy(e->next_f, e->cur_f, sizeof(e->next_f));
+    float_set(e->next_f, e->next);
+    rescale_states(e, old_pre);
+    e->fade = LOUDNESS_EQ_FADE_FRAMES;
+    e->steps++;
+    return true;
+}
+
+static inline int16_t output(loudness_eq_t *e, int32_t y) {
+    int32_t v = (y + (1 << (INTERNAL_SHIFT - 1))) >> INTERNAL_SHIFT;
+    if (v > INT16_MAX || v < INT16_MIN) {
+        e->clipped++;
+        return v > 0 ? INT16_MAX : INT16_MIN;
+    }
+    return v;
+}
+
+// --- Fixed point ---
+void loudness_eq_process_fixed(loudness_eq_t *e, int16_t *pcm, size_t frames) {
+    while (frames > 0) {
+        if (e->fade == 0 && !loudness_eq_step(e)) {
+            for (size_t i = 0; i < 2 * frames; i++) {
+                int ch = i & 1;
+                int32_t y = biquad_process(&e->cur[0], &e->cur_state[0][ch], pcm[i] * (1 << INTERNAL_SHIFT));
+                pcm[i] = output(e, biquad_process(&e->cur[1], &e->cur_state[1][ch], y));
+            }
+            return;
+        }
+
+        size_t n = frames < (size_t)e->fade ? frames : (size_t)e->fade;
+        for (size_t f = 0; f < n; f++) {
+            int k = LOUDNESS_EQ_FADE_FRAMES - e->fade + 1;
+            for (int ch = 0; ch < 2; ch++) {
+                int32_t x = pcm[2 * f + ch] * (1 << INTERNAL_SHIFT);
+                int32_t a = biquad_process(&e->cur[0], &e->cur_state[0][ch], x);
+                a = biquad_process(&e->cur[1], &e->cur_state[1][ch], a);
+                int32_t b = biquad_process(&e->next[0], &e->next_state[0][ch], x);
+                b = biquad_process(&e->next[1], &e->next_state[1][ch], b);
+                pcm[2 * f + ch] = output(e, a + (int32_t)(((int64_t)(b - a) * k) >> FADE_BITS));
+            }
+            e->fade--;
+        }
+        if (e->fade == 0) {
+            memcpy(e->cur, e->next, sizeof(e->cur));
+            memcpy(e->cur_state, e->next_state, sizeof(e->cur_state));
+        }
+        pcm += 2 * n;
+        frames -= n;
+    }
+}
+
+// --- Float32 ---
+static void filter_float(dsp_biquad_t set[LOUDNESS_EQ_SHELVES][2], float *l, float *r, int n) {
+    for (int s = 0; s < LOUDNESS_EQ_SHELVES; s++) {
+        dsp_biquad(&set[s][0], l, l, n);
+        dsp_biquad(&set[s][1], r, r, n);
+    }
+}
+
+void loudness_eq_process_float(loudness_eq_t *e, int16_t *pcm, size_t frames) {
+    float l[PCM_FLOAT_BLOCK], r[PCM_FLOAT_BLOCK];
+    float next_l[PCM_FLOAT_BLOCK], next_r[PCM_FLOAT_BLOCK];
+
+    while (frames > 0) {
+        if (e->fade == 0) {
+            loudness_eq_step(e);
+        }
+        int n = frames < PCM_FLOAT_BLOCK ? frames : PCM_FLOAT_BLOCK;
+        pcm_to_float(pcm, l, r, n, 1);
+        if (e->fade > 0) {
+            n = n < e->fade ? n : e->fade;
+            memcpy(next_l, l, n * sizeof(float));
+            memcpy(next_r, r, n * sizeof(float));
+            filter_float(e->next_f, next_l, next_r, n);
+        }
+        filter_float(e->cur_f, l, r, n);
+
+        if (e->fade > 0) {
+            for (int i = 0; i < n; i++) {
+                float k = (LOUDNESS_EQ_FADE_FRAMES - e->fade + 1) * (1.0f / LOUDNESS_EQ_FADE_FRAMES);
+                l[i] += (next_l[i] - l[i]) * k;
+                r[i] += (next_r[i] - r[i]) * k;
+                e->fade--;
+            }
+            if (e->fade == 0) {
+                memcpy(e->cur, e->next, sizeof(e->cur));
+                memcpy(e->cur_f, e->next_f, sizeof(e->cur_f));
+            }
+        }
+
+        e->clipped += pcm_from_float(&e->dither, l, r, pcm, n);
+        pcm += 2 * n;
+        frames -= n;
+    }
+}
+
+void loudness_eq_process(loudness_eq_t *e, int16_t *pcm, size_t frames) {
+#if DSP_FLOAT_PIPELINE
+    loudness_eq_process_float(e, pcm, frames);
+#else
+    loudness_eq_process_fixed(e, pcm, frames);
+#endif
+}
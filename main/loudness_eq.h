@@ -0,0 +1,84 @@
+/*
+ * Loudness compensation filter for 16-bit stereo PCM: a bass and a treble
+ * shelf whose gains follow the listening level, so the extremes of the
+ * spectrum stay audible at low volume (the equal-loudness contours flatten
+ * as level rises). The largest boost is taken off the whole signal first,
+ * so the filter never pushes full-scale input into clipping.
+ *
+ * Gain changes are made in LOUDNESS_EQ_STEP_DB steps. Each step's
+ * coefficients are derived from the last ones without transcendental
+ * functions, and the output crossfades from the old filter to the new one
+ * over LOUDNESS_EQ_FADE_FRAMES, so a volume change never clicks. Filtering
+ * runs in fixed point, or in float32 when DSP_FLOAT_PIPELINE is set (see
+ * pcm_float.h).
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "biquad.h"
+#include "pcm_float.h"
+
+#define LOUDNESS_EQ_STEP_DB         0.5f
+#define LOUDNESS_EQ_FADE_FRAMES     128
+#define LOUDNESS_EQ_MAX_DB          18.0f   // Largest shelf gain either way
+
+enum {
+    LOUDNESS_EQ_BASS,
+    LOUDNESS_EQ_TREBLE,
+    LOUDNESS_EQ_SHELVES,
+};
+
+typedef struct {
+    float cos_w0;
+    float alpha;
+    float root;                             // sqrt(A) = 10^(db / 80) of the newest coefficients
+    float pre;                              // Attenuation folded into their numerator
+    float db;                               // Their gain
+    float target_db;
+} loudness_eq_shelf_t;
+
+typedef struct {
+    loudness_eq_shelf_t shelf[LOUDNESS_EQ_SHELVES];
+    float up, down;                         // Step factors for root
+    biquad_t cur[LOUDNESS_EQ_SHELVES];
+    biquad_t next[LOUDNESS_EQ_SHELVES];
+    biquad_state_t cur_state[LOUDNESS_EQ_SHELVES][2];   // [shelf][channel]
+    biquad_state_t next_state[LOUDNESS_EQ_SHELVES][2];
+    dsp_biquad_t cur_f[LOUDNESS_EQ_SHELVES][2];         // Float32 pipeline: [shelf][channel]
+    dsp_biquad_t next_f[LOUDNESS_EQ_SHELVES][2];
+    pcm_dither_t dither;
+    int fade;                               // Frames of crossfade to go; 0 when settled on cur
+    uint32_t steps;                         // Coefficient updates since init
+    uint32_t clipped;
+} loudness_eq_t;
+
+// Sets up flat shelves at bass_hz and treble_hz for audio at rate Hz.
+void loudness_eq_init(loudness_eq_t *e, float bass_hz, float treble_hz, uint32_t rate);
+
+// Sets the shelf gains to move to, in dB (clamped to +-LOUDNESS_EQ_MAX_DB).
+void loudness_eq_set(loudness_eq_t *e, float bass_db, float treble_db);
+
+// Jumps straight to the target gains without crossfading, for a filter
+// that has not started on audio yet.
+void loudness_eq_settle(loudness_eq_t *e);
+
+// True while the filter is still stepping or crossfading toward its target.
+bool loudness_eq_busy(const loudness_eq_t *e);
+
+// Works out the next step's coefficients and starts crossfading to them.
+// Returns false if already at the target. loudness_eq_process() calls this
+// as needed; it is public for benchmarking.
+bool loudness_eq_step(loudness_eq_t *e);
+
+// Filters frames of interleaved stereo in place, in the pipeline
+// DSP_FLOAT_PIPELINE selects.
+void loudness_eq_process(loudness_eq_t *e, int16_t *pcm, size_t frames);
+
+// The two pipelines, for benchmarking; a filter should stay on one of them.
+void loudness_eq_process_fixed(loudness_eq_t *e, int16_t *pcm, size_t frames);
+void loudness_eq_process_float(loudness_eq_t *e, int16_t *pcm, size_t frames);
@@ -0,0 +1,230 @@
+/*
+ * Ogg page demultiplexer
+ *
+ * Page layout (RFC 3533): "OggS", version, flags, granule position (8),
+ * serial (4), sequence (4), CRC (4), segment count, lacing table, body.
+ * A lacing value below 255 ends a packet; 255 means it continues in the
+ * next segment, possibly on the next page.
+ */
+
+#include "ogg_demux.h"
+
+#include <string.h>
+
+#define OGG_FLAG_CONTINUED      0x01
+#define OGG_FLAG_BOS            0x02
+
+static uint32_t s_crc_table[256];
+
+// CRC-32 with polynomial 0x04C11DB7, not reflected, initial value 0.
+static void crc_init(void) {
+    if (s_crc_table[1] != 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t r = i << 24;
+        for (int j = 0; j < 8; j++) {
+            r = (r & 0x80000000u) ? (r << 1) ^ 0x04C11DB7u : r << 1;
+        }
+        s_crc_table[i] = r;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 8) ^ s_crc_table[((crc >> 24) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int64_t le64(const uint8_t *p) {
+    return (int64_t)((uint64_t)le32(p) | (uint64_t)le32(p + 4) << 32);
+}
+
+void ogg_demux_init(ogg_demux_t *d, uint8_t *packet_buf, size_t packet_cap) {
+    crc_init();
+    memset(d, 0, sizeof(*d));
+    d->packet = packet_buf;
+    d->packet_cap = packet_cap;
+}
+
+void ogg_demux_seek(ogg_demux_t *d) {
+    d->header_len = 0;
+    d->in_body = false;
+    // With nothing collected, page_start() skips a packet continued from
+    // before the seek point whatever the next page's sequence number.
+    d->packet_len = 0;
+    d->skip_packet = false;
+}
+
+// Drops header[0] and everything before the next possible capture pattern.
+static void hunt(ogg_demux_t *d) {
+    size_t i = 1;
+    while (i < d->header_len && d->header[i] != 'O') {
+        i++;
+    }
+    d->header_len -= i;
+    memmove(d->header, d->header + i, d->header_len);
+}
+
+static void lose_packet(ogg_demux_t *d) {
+    if (d->packet_len > 0 || d->skip_packet) {
+        d->dropped_packets++;
+    }
+    d->packet_len = 0;
+    d->skip_packet = false;
+}
+
+// Called once the fixed header and lacing table are in. Returns false if the
+// page is to be ignored (another logical stream).
+static bool page_start(ogg_demux_t *d) {
+    const uint8_t *h = d->header;
+    uint8_t flags = h[5];
+    uint32_t serial = le32(h + 14);
+    uint32_t sequence = le32(h + 18);
+
+    if (flags & OGG_FLAG_BOS) {
+        // First page of a logical stream; a chained stream replaces the old one.
+        if (d->have_stream && serial == d->serial) {
+            return false;
+        }
+        lose_packet(d);
+        d->have_stream = true;
+        d->serial = serial;
+        d->bos_pending = true;
+    } else if (!d->have_stream || serial != d->serial) {
+        return false;
+    } else if (sequence != d->sequence + 1) {
+        lose_packet(d);
+        d->skip_packet = (flags & OGG_FLAG_CONTINUED) != 0;
+    } else if (!(flags & OGG_FLAG_CONTINUED) && d->packet_len > 0) {
+        lose_packet(d);
+    } else if ((flags & OGG_FLAG_CONTINUED) && d->packet_len == 0 && !d->skip_packet) {
+        // Continues a packet whose start was never seen (e.g. joined mid-stream).
+        d->skip_packet = true;
+    }
+    d->sequence = sequence;
+    d->granule = le64(h + 6);
+    return true;
+}
+
+bool ogg_demux_feed(ogg_demux_t *d, const uint8_t *data, size_t len, ogg_packet_fn_t fn, void *ctx) {
+    while (len > 0 || d->in_body) {
+        if (!d->in_body) {
+            // Collect the fixed header, then the lacing table.
+            size_t need = OGG_HEADER_LEN;
+            if (d->header_len >= OGG_HEADER_LEN) {
+                need += d->header[26];
+            }
+            size_t n = need - d->header_len < len ? need - d->header_len : len;
+            memcpy(d->header + d->header_len, data, n);
+            d->header_len += n;
+            data += n;
+            len -= n;
+
+            if ((d->header_len >= 4 && memcmp(d->header, "OggS", 4) != 0) ||
+                (d->header_len >= 5 && d->header[4] != 0)) {
+                if (!d->lost_sync) {
+                    d->lost_sync = true;
+                    d->resyncs++;
+                    lose_packet(d);
+                }
+                hunt(d);
+                continue;
+            }
+            if (d->header_len < OGG_HEADER_LEN || d->header_len < OGG_HEADER_LEN + d->header[26]) {
+                continue;
+            }
+
+            uint8_t crc_field[4];
+            memcpy(crc_field, d->header + 22, 4);
+            memset(d->header + 22, 0, 4);
+            d->crc = crc_update(0, d->header, d->header_len);
+            memcpy(d->header + 22, crc_field, 4);
+
+            d->pages++;
+            d->lost_sync = false;
+            d->segments = d->header[26];
+            d->segment = 0;
+            d->in_body = true;
+            d->ignore_page = !page_start(d);
+            if (d->ignore_page) {
+                // Not our stream: the whole body is skipped in one go.
+                d->segment_left = 0;
+                for (int i = 0; i < d->segments; i++) {
+                    d->segment_left += d->header[OGG_HEADER_LEN + i];
+                }
+            } else {
+                d->segment_left = d->segments > 0 ? d->header[OGG_HEADER_LEN] : 0;
+            }
+        }
+
+        if (d->ignore_page) {
+            size_t n = d->segment_left < len ? d->segment_left : len;
+            data += n;
+            len -= n;
+            d->segment_left -= n;
+            if (d->segment_left > 0) {
+                return true;
+            }
+            d->in_body = false;
+            d->header_len = 0;
+            continue;
+        }
+
+        // Body: walk the lacing table, copying packet bytes.
+        while (d->segment < d->segments) {
+            uint32_t seg_len = d->header[OGG_HEADER_LEN + d->segment];
+            size_t n = d->segment_left < len ? d->segment_left : len;
+
+            d->crc = crc_update(d->crc, data, n);
+            if (!d->skip_packet) {
+                if (d->packet_len + n > d->packet_cap) {
+                    d->skip_packet = true;
+                    d->packet_len = 0;
+                } else {
+                    memcpy(d->packet + d->packet_len, data, n);
+                    d->packet_len += n;
+                }
+            }
+            data += n;
+            len -= n;
+            d->segment_left -= n;
+            if (d->segment_left > 0) {
+                return true;
+            }
+
+            if (seg_len < 255) {
+                // Packet complete.
+                if (d->skip_packet) {
+                    d->dropped_packets++;
+                    d->skip_packet = false;
+                } else {
+                    bool bos = d->bos_pending;
+                    size_t plen = d->packet_len;
+                    d->bos_pending = false;
+                    d->packet_len = 0;
+                    if (!fn(d->packet, plen, bos, ctx)) {
+                        return false;
+                    }
+                }
+            }
+            d->segment++;
+            if (d->segment < d->segments) {
+                d->segment_left = d->header[OGG_HEADER_LEN + d->segment];
+            }
+        }
+
+        if (d->crc != le32(d->header + 22)) {
+            d->crc_errors++;
+            lose_packet(d);
+        }
+        d->in_body = false;
+        d->header_len = 0;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * Ogg page demultiplexer for streaming input.
+ *
+ * Bytes arrive in arbitrary pieces; complete packets of the first logical
+ * stream are handed to a callback. Pages are not buffered whole (muxers
+ * write pages of up to ~64 KB), so packets are delivered as soon as their
+ * last segment arrives and the page CRC can only flag damage afterwards.
+ * Losing the capture pattern, a bad CRC or a sequence gap drops the packet
+ * in progress and hunts for the next "OggS".
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OGG_HEADER_LEN      27
+#define OGG_MAX_SEGMENTS    255
+
+// Receives one complete packet. bos is set on the first packet of a new
+// logical stream (also after a chain boundary). Return false to stop
+// feeding; ogg_demux_feed() then returns false as well.
+typedef bool (*ogg_packet_fn_t)(const uint8_t *packet, size_t len, bool bos, void *ctx);
+
+typedef struct {
+    uint8_t header[OGG_HEADER_LEN + OGG_MAX_SEGMENTS];
+    size_t header_len;          // Bytes of the page header collected so far
+    int segment;                // Current index into the lacing table
+    int segments;
+    uint32_t segment_left;      // Body bytes left in the current segment
+    bool in_body;
+    bool ignore_page;           // Page of another logical stream
+    bool lost_sync;             // Hunting for the capture pattern
+    uint32_t crc;               // Running CRC of the current page
+    uint32_t serial;
+    uint32_t sequence;
+    int64_t granule;            // Of the page being read; -1 if no packet ends on it
+    bool have_stream;
+    bool bos_pending;           // Next packet starts a logical stream
+    bool skip_packet;           // Current packet lost its start or overflowed
+
+    uint8_t *packet;
+    size_t packet_cap;
+    size_t packet_len;
+
+    uint32_t pages;
+    uint32_t crc_errors;
+    uint32_t resyncs;           // Times the capture pattern was hunted for
+    uint32_t dropped_packets;
+} ogg_demux_t;
+
+// packet_buf holds the packet being assembled; longer packets are dropped.
+void ogg_demux_init(ogg_demux_t *d, uint8_t *packet_buf, size_t packet_cap);
+
+// Drops the partial page and packet, for feeding from another position in
+// the same stream after a seek. The next page is found by its capture
+// pattern and a packet continued from before it is skipped.
+void ogg_demux_seek(ogg_demux_t *d);
+
+// Consumes bytes, calling fn for each packet completed on the way.
+bool ogg_demux_feed(ogg_demux_t *d, const uint8_t *data, size_t len, ogg_packet_fn_t fn, void *ctx);
@@ -0,0 +1,159 @@
+/*
+ * Output tap
+ *
+ * a2d_data_cb copies each block it returns into a side ring, prefixed with the
+ * block's byte position in the output stream. A low-priority task drains the
+ * ring into UDP datagrams. If the ring is full the block is dropped and
+ * counted; the capture tool sees the hole through the offsets and fills it
+ * with silence, so the recording stays time-aligned.
+ */
+
+#include "output_tap.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "bridge_console.h"
+#include "spsc_ring.h"
+
+static const char *TAG = "OUTPUT_TAP";
+
+#define TAP_RING_SIZE       (16 * 1024)
+#define TAP_PAYLOAD_MAX     1024        // Keeps datagrams below the Wi-Fi MTU
+#define TAP_POLL_MS         10
+
+typedef struct {
+    uint64_t offset;
+    uint32_t len;
+} tap_record_t;
+
+static spsc_ring_t s_ring;
+static atomic_bool s_enabled;
+static TaskHandle_t s_task = NULL;
+static int s_sock = -1;
+static SemaphoreHandle_t s_lock = NULL;
+static struct sockaddr_in s_dest;       // Under s_lock: set by the console, read by the tap task
+
+static uint64_t s_stream_offset = 0;    // a2d_data_cb only
+static atomic_uint s_dropped_bytes;
+static atomic_uint s_sent_packets;
+static atomic_uint s_send_errors;
+
+void output_tap_write(const uint8_t *data, size_t len) {
+    uint64_t offset = s_stream_offset;
+    s_stream_offset += len;
+    if (!atomic_load_explicit(&s_enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    tap_record_t rec = { .offset = offset, .len = len };
+    if (spsc_ring_free(&s_ring) < sizeof(rec) + len) {
+        atomic_fetch_add_explicit(&s_dropped_bytes, len, memory_order_relaxed);
+        return;
+    }
+    spsc_ring_write(&s_ring, &rec, sizeof(rec));
+    spsc_ring_write(&s_ring, data, len);
+}
+
+static void tap_send(uint8_t *packet, size_t payload_len) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    struct sockaddr_in dest = s_dest;
+    xSemaphoreGive(s_lock);
+    int err = sendto(s_sock, packet, sizeof(output_tap_header_t) + payload_len, 0,
+                     (struct sockaddr *)&dest, sizeof(dest));
+    if (err < 0) {
+        // Wi-Fi is congested; monitor data is the first thing to give way.
+        atomic_fetch_add_explicit(&s_send_errors, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&s_sent_packets, 1, memory_order_relaxed);
+    }
+}
+
+static void output_tap_task(void *pvParameters) {
+    static uint8_t packet[sizeof(output_tap_header_t) + TAP_PAYLOAD_MAX];
+    output_tap_header_t *hdr = (output_tap_header_t *)packet;
+    uint32_t seq = 0;
+
+    while (1) {
+        tap_record_t rec;
+        if (spsc_ring_used(&s_ring) < sizeof(rec)) {
+            vTaskDelay(pdMS_TO_TICKS(TAP_POLL_MS));
+            continue;
+        }
+        spsc_ring_read(&s_ring, &rec, sizeof(rec));
+
+        uint32_t done = 0;
+        while (done < rec.len) {
+            uint32_t chunk = rec.len - done;
+            if (chunk > TAP_PAYLOAD_MAX) {
+                chunk = TAP_PAYLOAD_MAX;
+            }
+            // The payload is published right after its record header.
+            while (spsc_ring_used(&s_ring) < chunk) {
+                vTaskDelay(1);
+            }
+            spsc_ring_read(&s_ring, packet + sizeof(*hdr), chunk);
+            hdr->magic = OUTPUT_TAP_MAGIC;
+            hdr->seq = seq++;
+            hdr->offset = rec.offset + done;
+            tap_send(packet, chunk);
+            done += chunk;
+        }
+    }
+}
+
+static int cmd_tap(int argc, char **argv) {
+    if (argc < 2) {
+        console_printf("tap %s: %u packets sent, %u bytes dropped (ring full), %u send errors\n",
+                       atomic_load(&s_enabled) ? "on" : "off",
+                       atomic_load(&s_sent_packets), atomic_load(&s_dropped_bytes),
+                       atomic_load(&s_send_errors));
+        console_printf("Usage: tap <ip> [port] | tap off\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "off") == 0) {
+        atomic_store(&s_enabled, false);
+        return 0;
+    }
+
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(argc > 2 ? atoi(argv[2]) : OUTPUT_TAP_DEFAULT_PORT),
+    };
+    if (inet_aton(argv[1], &dest.sin_addr) == 0) {
+        console_printf("Invalid address '%s'\n", argv[1]);
+        return -1;
+    }
+
+    if (s_task == NULL) {
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (sock < 0) {
+            ESP_LOGE(TAG, "Unable to create the tap socket: errno %d", errno);
+            return -1;
+        }
+        if (!spsc_ring_init(&s_ring, TAP_RING_SIZE)) {
+            ESP_LOGE(TAG, "Out of memory for the tap ring");
+            close(sock);
+            return -1;
+        }
+        s_sock = sock;
+        xTaskCreatePinnedToCore(output_tap_task, "output_tap", 3072, NULL, 3, &s_task, 1);
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_dest = dest;
+    xSemaphoreGive(s_lock);
+    atomic_store(&s_enabled, true);
+    ESP_LOGI(TAG, "Mirroring output to %s:%d", argv[1], ntohs(dest.sin_port));
+    return 0;
+}
+
+void output_tap_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    console_register("tap", "Mirror Bluetooth output over UDP: tap <ip> [port] | off", cmd_tap);
+}
@@ -0,0 +1,25 @@
+/*
+ * Output tap: mirrors the exact PCM returned by a2d_data_cb to a UDP listener
+ * (see tools/tap_capture.py).
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTPUT_TAP_DEFAULT_PORT     9100
+#define OUTPUT_TAP_MAGIC            0x31504154  // "TAP1" little endian
+
+// Every datagram starts with this header; the payload is 16-bit stereo PCM.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint64_t offset;        // Byte position of the payload in the a2d_data_cb output
+} output_tap_header_t;
+
+// Registers the "tap" console command.
+void output_tap_init(void);
+
+// Called from a2d_data_cb with the block handed to Bluetooth. Never blocks.
+void output_tap_write(const uint8_t *data, size_t len);
@@ -0,0 +1,168 @@
+/*
+ * Playback buffer overflow policy
+ *
+ * The cut happens inside the block a2d_data_cb is about to return. The
+ * block is played up to its first zero crossing (mono, so both channels
+ * are near zero together); the OVERFLOW_FADE_FRAMES after it are kept
+ * aside, enough of the buffer is read and thrown away to bring it down to
+ * OVERFLOW_MARGIN_MS below the bound, and the rest of the block is read
+ * from what follows, crossfaded in from the frames kept aside. Dropping
+ * below the bound rather than to it keeps a sender running slightly fast
+ * from being cut on every call.
+ *
+ * Any sample is therefore played within the bound of the first call after
+ * it was queued: latency is held under the bound plus one a2d_data_cb
+ * period. The recv loop can still fill the buffer between two calls and
+ * block, but only until the next one, so the socket keeps draining and
+ * the backlog ends up here, where it is dropped, rather than in TCP.
+ */
+
+#include "overflow.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "log_ring.h"
+#include "telemetry.h"
+
+static const char *TAG = "OVERFLOW";
+
+#define OVERFLOW_SCRATCH_BYTES  512
+#define BYTES_PER_MS            ((int)(AUDIO_BYTES_PER_SEC / 1000))
+
+static atomic_int s_selected_ms = 0;        // Policy for the next session; 0 is lossless
+static atomic_int s_bound_bytes = 0;        // Current session's; 0 is lossless
+
+// a2d_data_cb only, apart from the counters telemetry reads.
+static uint8_t s_scratch[OVERFLOW_SCRATCH_BYTES];
+static int16_t s_fade[OVERFLOW_FADE_FRAMES * AUDIO_CHANNELS];
+static volatile uint32_t s_cuts = 0;
+static volatile uint32_t s_dropped_frames = 0;
+
+static uint32_t s_reported_cuts = 0;
+static uint32_t s_reported_dropped = 0;
+
+void overflow_session_begin(void) {
+    int ms = atomic_load(&s_selected_ms);
+    atomic_store(&s_bound_bytes, ms * BYTES_PER_MS);
+}
+
+void overflow_session_end(void) {
+    atomic_store(&s_bound_bytes, 0);
+}
+
+// --- Audio path ---
+// First frame at or after from where the mono signal changes sign, or from
+// if there is none before limit.
+static size_t zero_crossing(const int16_t *pcm, size_t from, size_t limit) {
+    for (size_t f = from > 0 ? from : 1; f < limit; f++) {
+        int32_t prev = pcm[2 * f - 2] + pcm[2 * f - 1];
+        int32_t cur = pcm[2 * f] + pcm[2 * f + 1];
+        if ((prev < 0) != (cur < 0)) {
+            return f;
+        }
+    }
+    return from;
+}
+
+size_t overflow_trim(uint8_t *data, size_t len, size_t buffered, overflow_reader_t read, void *ctx) {
+    size_t bound = atomic_load_explicit(&s_bound_bytes, memory_order_relaxed);
+    size_t frames = len / AUDIO_BYTES_PER_FRAME;
+    if (bound == 0 || buffered <= bound || frames < OVERFLOW_FADE_FRAMES) {
+        return 0;
+    }
+
+    int16_t *pcm = (int16_t *)data;
+    size_t cut = zero_crossing(pcm, 0, frames - OVERFLOW_FADE_FRAMES + 1);
+    size_t tail = (frames - cut) * AUDIO_BYTES_PER_FRAME;
+    memcpy(s_fade, pcm + 2 * cut, sizeof(s_fade));
+
+    // Refilling the tail takes another tail bytes out of the buffer.
+    size_t margin = OVERFLOW_MARGIN_MS * BYTES_PER_MS;
+    size_t keep = bound > margin ? bound - margin : 0;
+    size_t drop = buffered > keep + tail ? buffered - keep - tail : 0;
+    drop -= drop % AUDIO_BYTES_PER_FRAME;
+    size_t dropped = 0;
+    while (dropped < drop) {
+        size_t n = drop - dropped < sizeof(s_scratch) ? drop - dropped : sizeof(s_scratch);
+        size_t got = read(s_scratch, n, ctx);
+        dropped += got;
+        if (got < n) {
+            break;
+        }
+    }
+    size_t got = read(data + cut * AUDIO_BYTES_PER_FRAME, tail, ctx);
+    if (got < tail) {
+        memset(data + cut * AUDIO_BYTES_PER_FRAME + got, 0, tail - got);
+    }
+
+    for (int f = 0; f < OVERFLOW_FADE_FRAMES; f++) {
+        int32_t g = (f + 1) * 32768 / (OVERFLOW_FADE_FRAMES + 1);
+        for (int ch = 0; ch < AUDIO_CHANNELS; ch++) {
+            int16_t *s = &pcm[2 * (cut + f) + ch];
+            *s = (int16_t)((s_fade[2 * f + ch] * (32768 - g) + *s * g) >> 15);
+        }
+    }
+
+    // The tail already read was dropped as well.
+    size_t lost = dropped + tail;
+    s_cuts++;
+    s_dropped_frames += lost / AUDIO_BYTES_PER_FRAME;
+    log_ring_write(LR_LIVE_DROP, lost, buffered - dropped - got, bound);
+    return lost;
+}
+
+// --- Console and telemetry ---
+static int overflow_telemetry(char *buf, size_t len) {
+    uint32_t cuts = s_cuts;
+    uint32_t dropped = s_dropped_frames;
+    int bound = atomic_load(&s_bound_bytes);
+    int n = snprintf(buf, len, "policy=%s bound=%d cuts=%lu dropped=%lu", bound ? "live" : "lossless",
+                     bound / BYTES_PER_MS, (unsigned long)(cuts - s_reported_cuts),
+                     (unsigned long)(dropped - s_reported_dropped));
+    s_reported_cuts = cuts;
+    s_reported_dropped = dropped;
+    return n;
+}
+
+static int cmd_overflow(int argc, char **argv) {
+    int max_ms = STREAM_BUFFER_SIZE / BYTES_PER_MS - OVERFLOW_MARGIN_MS;
+    if (argc < 2) {
+        int selected = atomic_load(&s_selected_ms);
+        int bound = atomic_load(&s_bound_bytes);
+        console_printf("overflow: next session %s", selected ? "live" : "lossless");
+        if (selected) {
+            console_printf(" (%d ms)", selected);
+        }
+        console_printf(", current session %s", bound ? "live" : "lossless");
+        if (bound) {
+            console_printf(" (%d ms)", bound / BYTES_PER_MS);
+        }
+        console_printf("\n  %lu cuts, %lu frames (%.1f s) dropped since boot\n", (unsigned long)s_cuts,
+                       (unsigned long)s_dropped_frames, s_dropped_frames / (double)AUDIO_SAMPLE_RATE);
+        console_printf("Usage: overflow lossless | overflow live [bound ms, %d-%d]\n", 2 * OVERFLOW_MARGIN_MS, max_ms);
+        return 0;
+    }
+    if (strcmp(argv[1], "lossless") == 0) {
+        atomic_store(&s_selected_ms, 0);
+        return 0;
+    }
+    int ms = argc > 2 ? atoi(argv[2]) : OVERFLOW_DEFAULT_BOUND_MS;
+    if (strcmp(argv[1], "live") != 0 || ms < 2 * OVERFLOW_MARGIN_MS || ms > max_ms) {
+        console_printf("Expected lossless or live [%d-%d ms]\n", 2 * OVERFLOW_MARGIN_MS, max_ms);
+        return -1;
+    }
+    atomic_store(&s_selected_ms, ms);
+    ESP_LOGI(TAG, "Next session is live, bounded to %d ms", ms);
+    return 0;
+}
+
+void overflow_init(void) {
+    console_register("overflow", "Playback buffer policy for the next session: overflow [lossless | live [ms]]",
+                     cmd_overflow);
+    telemetry_register("overflow", overflow_telemetry);
+}
@@ -0,0 +1,46 @@
+/*
+ * Playback buffer overflow policy for TCP sessions.
+ *
+ * Lossless (the default): the recv loop blocks while the playback buffer is
+ * full, so nothing is lost and a sender that gets ahead adds latency, up to
+ * the whole buffer plus whatever TCP is holding.
+ *
+ * Live: a2d_data_cb drops the oldest audio whenever more than the bound is
+ * buffered, cutting at a zero crossing with a short crossfade, so audio
+ * never waits in the buffer much longer than the bound and the recv loop
+ * keeps draining the socket.
+ *
+ * The policy is chosen with the "overflow" command and taken up when a
+ * session starts, so a controller sets it before connecting the stream.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OVERFLOW_DEFAULT_BOUND_MS   60
+#define OVERFLOW_FADE_FRAMES        64      // Crossfade across a cut (1.5 ms)
+#define OVERFLOW_MARGIN_MS          10      // Left below the bound after a cut
+
+// Pulls up to n bytes from the playback buffer without waiting; returns
+// how many it got.
+typedef size_t (*overflow_reader_t)(void *buf, size_t n, void *ctx);
+
+// Registers the "overflow" command and telemetry.
+void overflow_init(void);
+
+// Takes up the selected policy for a TCP session that is starting.
+void overflow_session_begin(void);
+
+// Back to lossless once the session has ended, so other producers are never
+// cut.
+void overflow_session_end(void);
+
+// Called from a2d_data_cb after it has read len bytes into data with
+// buffered bytes left behind them. Under the live policy, if buffered is
+// over the bound, drops audio from just after a zero crossing in data, refills
+// the rest of data from read, and crossfades across the cut. Returns the
+// bytes dropped. Never blocks.
+size_t overflow_trim(uint8_t *data, size_t len, size_t buffered, overflow_reader_t read, void *ctx);
@@ -0,0 +1,55 @@
+/*
+ * PCM to float conversion
+ *
+ * The dither is triangular (TPDF), 2 LSB peak to peak, which makes the
+ * rounding error independent of the signal: quiet fades and reverb tails
+ * decay into steady noise instead of breaking up into distortion, at the
+ * cost of a noise floor about 5 dB above plain rounding. Each sample's
+ * dither is the difference between this draw and the channel's last one,
+ * which is triangular as well, needs one draw per sample instead of two,
+ * and tilts the noise toward high frequencies where it is least audible.
+ *
+ * Rounding adds an offset that makes every value in range positive, so the
+ * FPU's truncating conversion rounds to nearest without a call to lrintf().
+ */
+
+#include "pcm_float.h"
+
+#define FULL_SCALE      32768.0f
+
+static inline float draw(pcm_dither_t *d) {
+    d->seed = d->seed * 1664525u + 1013904223u;
+    return (d->seed >> 8) * (1.0f / (1 << 24));
+}
+
+static inline int16_t quantize(pcm_dither_t *d, int ch, float x, int *clipped) {
+    float r = draw(d);
+    float v = x * FULL_SCALE + (r - d->last[ch]);
+    d->last[ch] = r;
+    if (v >= INT16_MAX + 0.5f) {
+        (*clipped)++;
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN - 0.5f) {
+        (*clipped)++;
+        return INT16_MIN;
+    }
+    return (int32_t)(v + (FULL_SCALE + 0.5f)) - (int32_t)FULL_SCALE;
+}
+
+void pcm_to_float(const int16_t *pcm, float *l, float *r, int frames, float gain) {
+    const float scale = gain / FULL_SCALE;
+    for (int f = 0; f < frames; f++) {
+        l[f] = pcm[2 * f] * scale;
+        r[f] = pcm[2 * f + 1] * scale;
+    }
+}
+
+int pcm_from_float(pcm_dither_t *d, const float *l, const float *r, int16_t *pcm, int frames) {
+    int clipped = 0;
+    for (int f = 0; f < frames; f++) {
+        pcm[2 * f] = quantize(d, 0, l[f], &clipped);
+        pcm[2 * f + 1] = quantize(d, 1, r[f], &clipped);
+    }
+    return clipped;
+}
@@ -0,0 +1,39 @@
+/*
+ * Float32 pipeline: conversion of 16-bit stereo PCM to planar float blocks
+ * and back, with TPDF dither on the way out.
+ *
+ * The compressor, loudness compensation and headphone chain each have a
+ * fixed-point and a float32 implementation, both always built so "bench
+ * float" can compare them. DSP_FLOAT_PIPELINE picks the one their
+ * *_process() functions run: on the ESP32 it follows
+ * CONFIG_BRIDGE_DSP_FLOAT; host builds can define it themselves.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "dsp_kernels.h"
+
+#ifndef DSP_FLOAT_PIPELINE
+#if defined(ESP_PLATFORM) && CONFIG_BRIDGE_DSP_FLOAT
+#define DSP_FLOAT_PIPELINE      1
+#else
+#define DSP_FLOAT_PIPELINE      0
+#endif
+#endif
+
+#define PCM_FLOAT_BLOCK         32      // Frames per planar block; a float stage keeps a few on its stack
+
+typedef struct {
+    uint32_t seed;
+    float last[2];                      // Previous draw, per channel
+} pcm_dither_t;
+
+// Deinterleaves frames into l and r, scaled so full scale is +-gain.
+void pcm_to_float(const int16_t *pcm, float *l, float *r, int frames, float gain);
+
+// Interleaves l and r back into pcm with dither, rounding and saturation.
+// Returns the number of samples that were saturated.
+int pcm_from_float(pcm_dither_t *d, const float *l, const float *r, int16_t *pcm, int frames);
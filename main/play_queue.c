@@ -0,0 +1,748 @@
+/*
+ * Play queue
+ *
+ * Two identical workers take items off the front of the queue in order, so
+ * whenever something is playing the other worker is working on the item
+ * after it. Each worker runs its item from connection to end of stream
+ * with its own ingest session; what differs is only whether the item has
+ * its turn yet:
+ *   - Before its turn a worker connects, fetches up to
+ *     PLAY_QUEUE_PREFETCH_BYTES and starts decoding. Decoded PCM collects
+ *     in the head buffer; once that is full the sink parks the worker until
+ *     the item ahead finishes. Setting up the decoder (Vorbis codebooks,
+ *     the first AAC frames) is therefore out of the way too.
+ *   - When the worker playing finishes it hands the turn to the other one,
+ *     which writes its head straight into the playback buffer and carries
+ *     on decoding what it fetched, then reads the network as the playback
+ *     buffer drains.
+ * The playing worker runs at the TCP server's priority, the one fetching
+ * ahead below it, so prefetching never starves playback.
+ *
+ * Decoding ahead needs a second decoder's memory. If the heap cannot spare
+ * it (two Vorbis streams back to back with a large arena) the next item is
+ * only fetched ahead and decoded from its turn on.
+ *
+ * The gap between items is measured at the output: the silence a2d_data_cb
+ * filled in between the last write of one item and the first of the next.
+ * With a prefetched head it should be zero; the time from one item ending
+ * to the next one writing (handoff) is reported next to it.
+ *
+ * The queue takes the playback buffer from the network as its first item
+ * starts and hands it back once it is empty. While the test generator has
+ * the buffer, the item whose turn it is waits for it with its head decoded.
+ *
+ * Seeking works on the item playing, if it came over HTTP. Ingest maps the
+ * time to a byte offset (exactly for WAV, raw PCM and SBC, by the bitrate
+ * so far for AAC and Vorbis), a second request asks for the rest of the
+ * file from there with a Range header, and only once the server answers
+ * 206 is the old connection dropped and the decoder restarted. The audio
+ * already queued keeps playing through the round trip; what is left of it
+ * is flushed just before the first audio from the new position is written,
+ * and the time from the command to that write is reported.
+ */
+
+#include "play_queue.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "control_channel.h"
+#include "ingest.h"
+#include "telemetry.h"
+
+static const char *TAG = "QUEUE";
+
+#define QUEUE_WORKERS           2
+#define QUEUE_READ_BYTES        1024
+#define QUEUE_FEED_BYTES        512     // Prefetched input is decoded in pieces this size
+#define QUEUE_READ_TIMEOUT_MS   1000
+#define QUEUE_STALL_MS          10000   // No data for this long fails the item
+#define QUEUE_POLL_MS           100
+#define QUEUE_HEAP_RESERVE      (24 * 1024)     // Left for Wi-Fi and Bluetooth when decoding ahead
+#define QUEUE_PLAY_PRIORITY     10      // Same as the TCP server
+#define QUEUE_FETCH_PRIORITY    8
+#define HEAD_FRAMES             (PLAY_QUEUE_HEAD_BYTES / AUDIO_BYTES_PER_FRAME)
+
+typedef enum {
+    WORKER_IDLE,
+    WORKER_CONNECTING,
+    WORKER_FETCHING,
+    WORKER_READY,           // Head decoded, waiting for its turn
+    WORKER_PLAYING,
+} worker_state_t;
+
+static const char *const s_state_names[] = { "idle", "connecting", "fetching", "ready", "playing" };
+
+typedef struct {
+    uint32_t id;
+    int worker;             // Index into s_workers, or -1 until one takes it
+    char uri[PLAY_QUEUE_URI_LEN];
+} queue_item_t;
+
+typedef struct {
+    TaskHandle_t task;
+    atomic_bool turn;       // Its item is at the front of the queue
+    atomic_bool cancel;
+    atomic_int state;
+    atomic_uint ahead;      // Fetched bytes not decoded yet
+    atomic_bool seek;       // A seek is waiting in seek_ms
+    uint32_t seek_ms;       // s_lock
+    int64_t seek_asked_us;  // s_lock
+
+    // Worker task only.
+    uint32_t id;
+    char uri[PLAY_QUEUE_URI_LEN];
+    bool playing;
+    esp_http_client_handle_t http;
+    uint32_t length;        // HTTP content length, 0 if not given
+    int sock;
+    uint8_t *fetch;
+    size_t fetch_len;
+    size_t fetch_pos;
+    int16_t *head;
+    size_t head_frames;
+    uint32_t played_frames;
+    ingest_t ingest;
+    bool landing;           // Seeked; the next write flushes and is reported
+    uint32_t landing_ms;
+    int64_t landing_asked_us;
+    bool landing_exact;
+} worker_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static worker_t s_workers[QUEUE_WORKERS];
+static bool s_started = false;
+
+// s_lock.
+static queue_item_t s_items[PLAY_QUEUE_LEN];
+static int s_count = 0;
+static uint32_t s_next_id = 1;
+static bool s_transition = false;           // An item ended and the next one has not written yet
+static int64_t s_ended_us;
+static uint32_t s_ended_missing;
+
+static atomic_uint s_playing_id;
+static atomic_uint s_transitions;
+static atomic_uint s_gap_us;                // Silence at the output, last transition
+static atomic_uint s_gap_max_us;
+static atomic_uint s_handoff_us;            // End of one item to the next one's first write
+static atomic_uint s_failed;
+
+static void queue_event(const char *line) {
+    ESP_LOGI(TAG, "%.*s", (int)strlen(line) - 3, line + 2);     // Without "E " and the newline
+    control_channel_send_line(line);
+}
+
+// --- Sources ---
+// GETs the item from byte offset from on (a range request unless 0).
+// Returns the open client once the status is the one expected, else NULL.
+static esp_http_client_handle_t http_get(worker_t *w, uint32_t from, int expect) {
+    esp_http_client_config_t cfg = {
+        .url = w->uri,
+        .timeout_ms = QUEUE_READ_TIMEOUT_MS,
+    };
+    esp_http_client_handle_t http = esp_http_client_init(&cfg);
+    if (http == NULL) {
+        return NULL;
+    }
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)from);
+    bool ok = (from == 0 || esp_http_client_set_header(http, "Range", range) == ESP_OK) &&
+              esp_http_client_open(http, 0) == ESP_OK;
+    if (ok) {
+        // Headers can take longer than one read on a slow link.
+        int64_t deadline = esp_timer_get_time() + QUEUE_STALL_MS * 1000LL;
+        while (esp_http_client_fetch_headers(http) == -ESP_ERR_HTTP_EAGAIN && !atomic_load(&w->cancel) &&
+               esp_timer_get_time() < deadline) {
+        }
+        int status = esp_http_client_get_status_code(http);
+        if (status != expect) {
+            ESP_LOGW(TAG, "%s: HTTP status %d", w->uri, status);
+            ok = false;
+        }
+    }
+    if (!ok) {
+        esp_http_client_close(http);
+        esp_http_client_cleanup(http);
+        return NULL;
+    }
+    return http;
+}
+
+static bool source_open(worker_t *w) {
+    if (strncmp(w->uri, "http://", 7) == 0) {
+        w->http = http_get(w, 0, 200);
+        if (w->http == NULL) {
+            return false;
+        }
+        int64_t length = esp_http_client_get_content_length(w->http);
+        w->length = length > 0 && length <= UINT32_MAX ? length : 0;
+        return true;
+    }
+
+    // tcp://host:port, validated by play_queue_add().
+    char host[PLAY_QUEUE_URI_LEN];
+    const char *start = w->uri + 6;
+    const char *colon = strrchr(start, ':');
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - start), start);
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0 || res == NULL) {
+        return false;
+    }
+    w->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    struct timeval tv = { .tv_sec = QUEUE_READ_TIMEOUT_MS / 1000, .tv_usec = QUEUE_READ_TIMEOUT_MS % 1000 * 1000 };
+    bool ok = w->sock >= 0 && setsockopt(w->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+              connect(w->sock, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    return ok;
+}
+
+// Returns bytes read, 0 at the end of the stream, or -1 on an error, after
+// QUEUE_STALL_MS without data or once the item is cancelled. Fetching ahead
+// it gives up with -2 when the item gets its turn, so a slow read never
+// holds up the start.
+static int source_read(worker_t *w, uint8_t *buf, size_t len, bool ahead) {
+    int64_t deadline = esp_timer_get_time() + QUEUE_STALL_MS * 1000LL;
+    while (!atomic_load(&w->cancel) && esp_timer_get_time() < deadline) {
+        if (ahead && atomic_load(&w->turn)) {
+            return -2;
+        }
+        int n;
+        if (w->http) {
+            n = esp_http_client_read(w->http, (char *)buf, len);
+            if (n == -ESP_ERR_HTTP_EAGAIN) {
+                continue;
+            }
+        } else {
+            n = recv(w->sock, buf, len, 0);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                continue;
+            }
+        }
+        return n < 0 ? -1 : n;
+    }
+    return -1;
+}
+
+static void source_close(worker_t *w) {
+    if (w->http) {
+        esp_http_client_close(w->http);
+        esp_http_client_cleanup(w->http);
+        w->http = NULL;
+    }
+    if (w->sock >= 0) {
+        close(w->sock);
+        w->sock = -1;
+    }
+}
+
+// --- Playing ---
+static bool wait_turn(worker_t *w) {
+    while (!atomic_load(&w->turn)) {
+        if (atomic_load(&w->cancel)) {
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(QUEUE_POLL_MS));
+    }
+    return !atomic_load(&w->cancel);
+}
+
+static void play(worker_t *w, const int16_t *pcm, size_t frames) {
+    if (frames > 0 && !atomic_load(&w->cancel)) {
+        bool landing = w->landing;
+        if (landing) {
+            audio_bridge_flush(AUDIO_SOURCE_QUEUE);
+            w->landing = false;
+        }
+        audio_bridge_write(AUDIO_SOURCE_QUEUE, pcm, frames * AUDIO_BYTES_PER_FRAME, portMAX_DELAY);
+        w->played_frames += frames;
+        if (landing) {
+            // Written to an emptied buffer: heard from the next a2d_data_cb.
+            char line[128];
+            int64_t landed = ingest_position(&w->ingest) - (int64_t)frames;
+            snprintf(line, sizeof(line), "E queue seek id=%lu to_ms=%lu landed_ms=%.1f exact=%d ms=%.1f\n",
+                     (unsigned long)w->id, (unsigned long)w->landing_ms, landed * 1000.0 / AUDIO_SAMPLE_RATE,
+                     w->landing_exact, (esp_timer_get_time() - w->landing_asked_us) / 1000.0);
+            queue_event(line);
+        }
+    }
+}
+
+// Waits for the playback buffer: the generator keeps it while it runs.
+static bool wait_buffer(worker_t *w) {
+    while (!audio_bridge_claim(AUDIO_SOURCE_QUEUE)) {
+        if (atomic_load(&w->cancel)) {
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(QUEUE_POLL_MS));
+    }
+    return true;
+}
+
+// Waits for the item's turn and the buffer, then plays the head and
+// reports the gap.
+static bool begin_playing(worker_t *w) {
+    if (!wait_turn(w) || !wait_buffer(w)) {
+        return false;
+    }
+    int64_t now = esp_timer_get_time();
+    w->playing = true;
+    vTaskPrioritySet(NULL, QUEUE_PLAY_PRIORITY);
+    atomic_store(&w->state, WORKER_PLAYING);
+    atomic_store(&s_playing_id, w->id);
+
+    char line[PLAY_QUEUE_URI_LEN + 96];
+    snprintf(line, sizeof(line), "E queue start id=%lu head_ms=%lu ahead=%u uri=%s\n", (unsigned long)w->id,
+             (unsigned long)(w->head_frames * 1000 / AUDIO_SAMPLE_RATE), (unsigned)(w->fetch_len - w->fetch_pos),
+             w->uri);
+    queue_event(line);
+    play(w, w->head, w->head_frames);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool transition = s_transition;
+    int64_t ended_us = s_ended_us;
+    uint32_t ended_missing = s_ended_missing;
+    s_transition = false;
+    xSemaphoreGive(s_lock);
+    if (transition) {
+        uint32_t gap_us = (uint64_t)(audio_bridge_missing_bytes() - ended_missing) * 1000000 / AUDIO_BYTES_PER_SEC;
+        uint32_t handoff_us = now - ended_us;
+        atomic_store(&s_gap_us, gap_us);
+        atomic_store(&s_handoff_us, handoff_us);
+        if (gap_us > atomic_load(&s_gap_max_us)) {
+            atomic_store(&s_gap_max_us, gap_us);
+        }
+        atomic_fetch_add(&s_transitions, 1);
+        snprintf(line, sizeof(line), "E queue gap id=%lu ms=%.1f handoff_ms=%.1f\n", (unsigned long)w->id,
+                 gap_us / 1000.0, handoff_us / 1000.0);
+        queue_event(line);
+    }
+    return true;
+}
+
+// Ingest sink: fills the head until the item's turn, then plays.
+static void queue_sink(const int16_t *pcm, size_t frames, void *ctx) {
+    worker_t *w = ctx;
+    if (!w->playing) {
+        size_t n = HEAD_FRAMES - w->head_frames;
+        n = frames < n ? frames : n;
+        memcpy(w->head + w->head_frames * AUDIO_CHANNELS, pcm, n * AUDIO_BYTES_PER_FRAME);
+        w->head_frames += n;
+        pcm += n * AUDIO_CHANNELS;
+        frames -= n;
+        if (frames == 0 && !atomic_load(&w->turn)) {
+            return;
+        }
+        // The head is full (or it is already this item's turn): the rest
+        // waits for that.
+        atomic_store(&w->state, WORKER_READY);
+        if (!begin_playing(w)) {
+            return;
+        }
+    }
+    play(w, pcm, frames);
+}
+
+// --- Seeking ---
+static bool seek_wanted(worker_t *w) {
+    return w->playing && atomic_load(&w->seek);
+}
+
+static void seek_failed(worker_t *w, uint32_t ms, const char *why) {
+    char line[96];
+    snprintf(line, sizeof(line), "E queue seek id=%lu to_ms=%lu failed=%s\n", (unsigned long)w->id,
+             (unsigned long)ms, why);
+    queue_event(line);
+}
+
+// Carries out the seek asked for. Returns true if the source now reads from
+// the new position; otherwise playback goes on where it was.
+static bool seek(worker_t *w) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t ms = w->seek_ms;
+    int64_t asked_us = w->seek_asked_us;
+    atomic_store(&w->seek, false);
+    xSemaphoreGive(s_lock);
+
+    uint32_t target = (uint64_t)ms * AUDIO_SAMPLE_RATE / 1000;
+    ingest_seek_t plan;
+    if (w->http == NULL || !ingest_seek_plan(&w->ingest, target, &plan)) {
+        seek_failed(w, ms, "unsupported");
+        return false;
+    }
+    if (w->length > 0 && plan.offset >= w->length) {
+        seek_failed(w, ms, "past-end");
+        return false;
+    }
+    esp_http_client_handle_t http = http_get(w, plan.offset, 206);
+    if (http == NULL) {
+        seek_failed(w, ms, "no-range");
+        return false;
+    }
+    source_close(w);
+    w->http = http;
+    ingest_seek(&w->ingest, target, &plan);
+    w->landing = true;
+    w->landing_ms = ms;
+    w->landing_asked_us = asked_us;
+    w->landing_exact = plan.exact;
+    ESP_LOGI(TAG, "Item %lu: seeking to %lu ms from byte %lu", (unsigned long)w->id, (unsigned long)ms,
+             (unsigned long)plan.offset);
+    return true;
+}
+
+// Runs one item to its end. Returns why it ended.
+static const char *run_item(worker_t *w) {
+    ingest_begin(&w->ingest, queue_sink, w);
+    atomic_store(&w->state, WORKER_CONNECTING);
+    if (!source_open(w)) {
+        return "connect";
+    }
+    w->fetch = malloc(PLAY_QUEUE_PREFETCH_BYTES);
+    w->head = malloc(PLAY_QUEUE_HEAD_BYTES);
+    if (w->fetch == NULL || w->head == NULL) {
+        return "memory";
+    }
+
+    // Fetch ahead while the item in front plays.
+    atomic_store(&w->state, WORKER_FETCHING);
+    int n = 1;
+    while (!atomic_load(&w->turn) && w->fetch_len < PLAY_QUEUE_PREFETCH_BYTES) {
+        size_t room = PLAY_QUEUE_PREFETCH_BYTES - w->fetch_len;
+        n = source_read(w, w->fetch + w->fetch_len, room < QUEUE_READ_BYTES ? room : QUEUE_READ_BYTES, true);
+        if (n <= 0) {
+            break;
+        }
+        w->fetch_len += n;
+        atomic_store(&w->ahead, w->fetch_len);
+    }
+    if (n == -1) {
+        return "network";
+    }
+    bool eof = n == 0;
+
+    if (!atomic_load(&w->turn) &&
+        ingest_codec_memory(w->fetch, w->fetch_len) + QUEUE_HEAP_RESERVE >
+            heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)) {
+        ESP_LOGI(TAG, "Item %lu: no memory for a second decoder, decoding from its turn", (unsigned long)w->id);
+        if (!wait_turn(w)) {
+            return "skipped";
+        }
+    }
+    while (w->fetch_pos < w->fetch_len) {
+        if (seek_wanted(w) && seek(w)) {
+            // What was fetched ahead is from the old position.
+            w->fetch_pos = w->fetch_len;
+            atomic_store(&w->ahead, 0);
+            eof = false;
+            break;
+        }
+        size_t len = w->fetch_len - w->fetch_pos;
+        len = len < QUEUE_FEED_BYTES ? len : QUEUE_FEED_BYTES;
+        bool ok = ingest_feed(&w->ingest, w->fetch + w->fetch_pos, len);
+        w->fetch_pos += len;
+        atomic_store(&w->ahead, w->fetch_len - w->fetch_pos);
+        if (!ok) {
+            return "format";
+        }
+        if (atomic_load(&w->cancel)) {
+            return "skipped";
+        }
+    }
+
+    // Then straight from the network, paced by the playback buffer.
+    while (!eof) {
+        if (seek_wanted(w)) {
+            seek(w);
+        }
+        n = source_read(w, w->fetch, QUEUE_READ_BYTES, false);
+        if (n < 0) {
+            return "network";
+        }
+        eof = n == 0;
+        if (n > 0 && !ingest_feed(&w->ingest, w->fetch, n)) {
+            return "format";
+        }
+        if (atomic_load(&w->cancel)) {
+            return "skipped";
+        }
+    }
+    // An item shorter than the head has not started yet.
+    if (!w->playing && !begin_playing(w)) {
+        return "skipped";
+    }
+    return "eof";
+}
+
+// --- Queue ---
+// Takes the first item no worker has yet.
+static bool claim(worker_t *w) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = 0;
+    while (i < s_count && s_items[i].worker >= 0) {
+        i++;
+    }
+    bool found = i < s_count;
+    if (found) {
+        s_items[i].worker = w - s_workers;
+        w->id = s_items[i].id;
+        strcpy(w->uri, s_items[i].uri);
+        atomic_store(&w->cancel, false);
+        atomic_store(&w->seek, false);
+        atomic_store(&w->turn, i == 0);
+    }
+    xSemaphoreGive(s_lock);
+    if (found) {
+        w->playing = false;
+        w->fetch_len = 0;
+        w->fetch_pos = 0;
+        w->head_frames = 0;
+        w->played_frames = 0;
+        w->length = 0;
+        w->landing = false;
+        vTaskPrioritySet(NULL, i == 0 ? QUEUE_PLAY_PRIORITY : QUEUE_FETCH_PRIORITY);
+    }
+    return found;
+}
+
+// Removes the worker's item and, if it was the one playing, gives the turn
+// to the next.
+static void finish(worker_t *w) {
+    bool emptied = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = 0;
+    while (i < s_count && s_items[i].id != w->id) {
+        i++;
+    }
+    if (i < s_count) {
+        memmove(&s_items[i], &s_items[i + 1], (s_count - i - 1) * sizeof(s_items[0]));
+        s_count--;
+        if (i == 0 && s_count > 0) {
+            if (w->playing) {
+                s_transition = true;
+                s_ended_us = esp_timer_get_time();
+                s_ended_missing = audio_bridge_missing_bytes();
+            }
+            if (s_items[0].worker >= 0) {
+                worker_t *next = &s_workers[s_items[0].worker];
+                atomic_store(&next->turn, true);
+                xTaskNotifyGive(next->task);
+            }
+            // Otherwise this worker takes it next.
+        }
+        emptied = i == 0 && s_count == 0;
+    }
+    atomic_store(&w->state, WORKER_IDLE);
+    atomic_store(&w->ahead, 0);
+    xSemaphoreGive(s_lock);
+
+    if (emptied) {
+        atomic_store(&s_playing_id, 0);
+        audio_bridge_release(AUDIO_SOURCE_QUEUE);
+        queue_event("E queue empty\n");
+    }
+}
+
+static void worker_task(void *arg) {
+    worker_t *w = arg;
+    for (;;) {
+        if (!claim(w)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        const char *reason = run_item(w);
+        if (atomic_load(&w->cancel)) {
+            reason = "skipped";
+        }
+        ingest_end(&w->ingest);
+        source_close(w);
+        free(w->fetch);
+        free(w->head);
+        w->fetch = NULL;
+        w->head = NULL;
+        if (strcmp(reason, "eof") != 0 && strcmp(reason, "skipped") != 0) {
+            atomic_fetch_add(&s_failed, 1);
+        }
+        if (atomic_load(&w->seek)) {
+            seek_failed(w, w->seek_ms, "ended");
+        }
+
+        char line[96];
+        snprintf(line, sizeof(line), "E queue end id=%lu reason=%s played_ms=%lu\n", (unsigned long)w->id, reason,
+                 (unsigned long)((uint64_t)w->played_frames * 1000 / AUDIO_SAMPLE_RATE));
+        queue_event(line);
+        finish(w);
+    }
+}
+
+static void wake_workers(void) {
+    for (int i = 0; i < QUEUE_WORKERS; i++) {
+        if (s_workers[i].task) {
+            xTaskNotifyGive(s_workers[i].task);
+        }
+    }
+}
+
+bool play_queue_add(const char *uri) {
+    size_t len = strlen(uri);
+    bool http = strncmp(uri, "http://", 7) == 0;
+    bool tcp = strncmp(uri, "tcp://", 6) == 0 && strrchr(uri, ':') > uri + 6;
+    if (len >= PLAY_QUEUE_URI_LEN || (!http && !tcp)) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool added = s_count < PLAY_QUEUE_LEN;
+    if (added) {
+        queue_item_t *item = &s_items[s_count++];
+        item->id = s_next_id++;
+        item->worker = -1;
+        memcpy(item->uri, uri, len + 1);
+    }
+    xSemaphoreGive(s_lock);
+    if (added) {
+        wake_workers();
+    }
+    return added;
+}
+
+void play_queue_skip(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_count > 0 && s_items[0].worker >= 0) {
+        atomic_store(&s_workers[s_items[0].worker].cancel, true);
+    }
+    xSemaphoreGive(s_lock);
+    wake_workers();
+}
+
+bool play_queue_seek(uint32_t ms) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool found = s_count > 0 && s_items[0].worker >= 0;
+    if (found) {
+        worker_t *w = &s_workers[s_items[0].worker];
+        w->seek_ms = ms;
+        w->seek_asked_us = esp_timer_get_time();
+        atomic_store(&w->seek, true);
+    }
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+void play_queue_clear(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool had_items = s_count > 0;
+    for (int i = 0; i < s_count; i++) {
+        if (s_items[i].worker >= 0) {
+            atomic_store(&s_workers[s_items[i].worker].cancel, true);
+        }
+    }
+    s_count = 0;
+    s_transition = false;
+    xSemaphoreGive(s_lock);
+    wake_workers();
+    if (had_items) {
+        atomic_store(&s_playing_id, 0);
+        audio_bridge_release(AUDIO_SOURCE_QUEUE);
+        queue_event("E queue empty\n");
+    }
+}
+
+// --- Console and telemetry ---
+static const char *item_state(const queue_item_t *item) {
+    return item->worker < 0 ? "waiting" : s_state_names[atomic_load(&s_workers[item->worker].state)];
+}
+
+static int queue_telemetry(char *buf, size_t len) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int count = s_count;
+    const char *next = count > 1 ? item_state(&s_items[1]) : "none";
+    unsigned ahead = count > 1 && s_items[1].worker >= 0 ? atomic_load(&s_workers[s_items[1].worker].ahead) : 0;
+    xSemaphoreGive(s_lock);
+    return snprintf(buf, len,
+                    "items=%d playing=%u next=%s ahead=%u transitions=%u gap_ms=%.1f gap_max_ms=%.1f "
+                    "handoff_ms=%.1f failed=%u",
+                    count, atomic_load(&s_playing_id), next, ahead, atomic_load(&s_transitions),
+                    atomic_load(&s_gap_us) / 1000.0, atomic_load(&s_gap_max_us) / 1000.0,
+                    atomic_load(&s_handoff_us) / 1000.0, atomic_load(&s_failed));
+}
+
+static int cmd_queue(int argc, char **argv) {
+    if (argc < 2) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for (int i = 0; i < s_count; i++) {
+            console_printf("  %3lu  %-10s  %s\n", (unsigned long)s_items[i].id, item_state(&s_items[i]),
+                           s_items[i].uri);
+        }
+        int count = s_count;
+        xSemaphoreGive(s_lock);
+        if (count == 0) {
+            console_printf("Queue empty%s\n", s_started ? "" : " (starts once Wi-Fi is up)");
+        }
+        console_printf("%u transitions: last gap %.1f ms (worst %.1f), handoff %.1f ms; %u items failed\n",
+                       atomic_load(&s_transitions), atomic_load(&s_gap_us) / 1000.0,
+                       atomic_load(&s_gap_max_us) / 1000.0, atomic_load(&s_handoff_us) / 1000.0,
+                       atomic_load(&s_failed));
+        console_printf("Usage: queue add <http://... | tcp://host:port> | skip | seek <seconds> | clear\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "skip") == 0) {
+        play_queue_skip();
+        return 0;
+    }
+    if (strcmp(argv[1], "clear") == 0) {
+        play_queue_clear();
+        return 0;
+    }
+    if (strcmp(argv[1], "seek") == 0 && argc > 2) {
+        double seconds = atof(argv[2]);
+        if (seconds < 0 || seconds > 24 * 3600) {
+            console_printf("Seek to 0 to 86400 seconds\n");
+            return -1;
+        }
+        if (!play_queue_seek(seconds * 1000)) {
+            console_printf("Nothing playing\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (strcmp(argv[1], "add") != 0 || argc < 3) {
+        console_printf("Expected add <uri>, skip, seek <seconds> or clear\n");
+        return -1;
+    }
+    if (!play_queue_add(argv[2])) {
+        console_printf("Expected an http:// or tcp://host:port URI shorter than %d characters, "
+                       "with room in the queue (%d items)\n", PLAY_QUEUE_URI_LEN, PLAY_QUEUE_LEN);
+        return -1;
+    }
+    return 0;
+}
+
+void play_queue_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < QUEUE_WORKERS; i++) {
+        s_workers[i].sock = -1;
+    }
+    console_register("queue", "Play streams from the network in turn: queue [add <uri> | skip | seek <s> | clear]",
+                     cmd_queue);
+    telemetry_register("queue", queue_telemetry);
+}
+
+void play_queue_start(void) {
+    for (int i = 0; i < QUEUE_WORKERS; i++) {
+        xTaskCreatePinnedToCore(worker_task, i == 0 ? "queue0" : "queue1", 4096, &s_workers[i], QUEUE_FETCH_PRIORITY,
+                                &s_workers[i].task, 1);
+    }
+    s_started = true;
+}
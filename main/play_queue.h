@@ -0,0 +1,46 @@
+/*
+ * Play queue: a device-side list of streams the bridge fetches and plays in
+ * turn, so a controller no longer has to push every track over port 8080
+ * in real time.
+ *
+ * Items are http:// URLs or tcp://host:port streams in any format ingest
+ * understands. While one plays, the next is connected, its first
+ * PLAY_QUEUE_PREFETCH_BYTES fetched and its first PLAY_QUEUE_HEAD_BYTES
+ * decoded, so it starts the moment the current one ends. Transitions and
+ * the silence between items are reported to the controller as
+ * "E queue ..." lines and through telemetry. The item playing can be
+ * moved to another time if its server takes range requests.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PLAY_QUEUE_LEN              8
+#define PLAY_QUEUE_URI_LEN          128
+#define PLAY_QUEUE_PREFETCH_BYTES   (16 * 1024)     // Compressed, fetched ahead
+#define PLAY_QUEUE_HEAD_BYTES       (8 * 1024)      // Decoded ahead, ~46 ms
+
+// Registers the "queue" command and telemetry; call before telemetry_init().
+void play_queue_init(void);
+
+// Starts the two workers; items added before this wait for it. Call once
+// Wi-Fi is up.
+void play_queue_start(void);
+
+// Appends uri. Returns false if it is not http:// or tcp:// or the queue is
+// full. Any task.
+bool play_queue_add(const char *uri);
+
+// Stops the item playing; the next one starts straight away.
+void play_queue_skip(void);
+
+// Moves the item at the front of the queue to ms from its start, once it is
+// playing. The outcome is reported as "E queue seek ..."; only http:// items
+// can seek, and only if the server honours range requests. Returns false if
+// no item is under way.
+bool play_queue_seek(uint32_t ms);
+
+// Stops everything and empties the queue.
+void play_queue_clear(void);
@@ -0,0 +1,299 @@
+/*
+ * Reverse bridge
+ *
+ * Bluedroid hands decoded PCM to sink_data_cb from its own task. The
+ * callback copies each block into a side ring behind a record of its RTP
+ * timestamp and format and wakes the sender task, which cuts it into
+ * packets and sends them straight away: nothing is held back to fill a
+ * packet, so the only buffering on the device is whatever the sender has
+ * not caught up with. If the ring is full the block is dropped, its frames
+ * still advance the timestamp and the next packet carries the marker, so
+ * the receiver sees the hole rather than a shift.
+ *
+ * Mono streams are sent as stereo so every packet has the same layout.
+ */
+
+#include "reverse_bridge.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_a2dp_api.h"
+#include "esp_gap_bt_api.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "lwip/sockets.h"
+#include "bridge_console.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+
+static const char *TAG = "REVERSE";
+
+#define RTP_RING_SIZE       (16 * 1024)
+#define RTP_PAYLOAD_FRAMES  256         // 1 KB of stereo PCM keeps packets below the Wi-Fi MTU
+#define RTP_WAIT_MS         100
+#define RTP_VERSION         0x80
+#define RTP_MARKER          0x80
+
+typedef struct __attribute__((packed)) {
+    uint8_t flags;          // Version 2, no padding, extension or CSRCs
+    uint8_t marker_pt;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+} rtp_header_t;
+
+typedef struct {
+    uint32_t timestamp;     // Of the first frame
+    uint32_t len;           // Bytes of PCM following the record
+    uint8_t channels;
+    bool marker;
+} rtp_record_t;
+
+static spsc_ring_t s_ring;
+static atomic_bool s_started;           // Sink role up
+static atomic_bool s_enabled;           // Sending to s_dest
+static atomic_bool s_restart;           // Set when playback starts; the next packet is marked
+static atomic_int s_rate = 44100;
+static atomic_int s_channels = 2;
+static atomic_bool s_connected;
+static TaskHandle_t s_task = NULL;
+static int s_sock = -1;
+static SemaphoreHandle_t s_lock = NULL;
+static struct sockaddr_in s_dest;       // Under s_lock: set by the console, read by the RTP task
+
+// sink_data_cb only.
+static uint32_t s_timestamp = 0;
+static bool s_marker = true;
+
+static atomic_uint s_received_frames;
+static atomic_uint s_dropped_frames;
+static atomic_uint s_sent_packets;
+static atomic_uint s_send_errors;
+
+// --- Bluetooth side ---
+static void sink_data_cb(const uint8_t *data, uint32_t len) {
+    int channels = atomic_load_explicit(&s_channels, memory_order_relaxed);
+    uint32_t frames = len / (channels * sizeof(int16_t));
+    rtp_record_t rec = { .timestamp = s_timestamp, .len = frames * channels * sizeof(int16_t), .channels = channels };
+    s_timestamp += frames;
+    atomic_fetch_add_explicit(&s_received_frames, frames, memory_order_relaxed);
+    if (atomic_exchange_explicit(&s_restart, false, memory_order_relaxed)) {
+        s_marker = true;
+    }
+    if (!atomic_load_explicit(&s_enabled, memory_order_relaxed)) {
+        s_marker = true;
+        return;
+    }
+
+    if (spsc_ring_free(&s_ring) < sizeof(rec) + rec.len) {
+        atomic_fetch_add_explicit(&s_dropped_frames, frames, memory_order_relaxed);
+        s_marker = true;
+        return;
+    }
+    rec.marker = s_marker;
+    s_marker = false;
+    spsc_ring_write(&s_ring, &rec, sizeof(rec));
+    spsc_ring_write(&s_ring, data, rec.len);
+    xTaskNotifyGive(s_task);
+}
+
+// Sample rate and channel count from the first octet of the SBC
+// configuration the phone chose.
+static void sink_configured(const esp_a2d_mcc_t *mcc) {
+    uint8_t oct0 = mcc->cie.sbc[0];
+    int rate = 16000;
+    if (oct0 & (1 << 6)) {
+        rate = 32000;
+    } else if (oct0 & (1 << 5)) {
+        rate = 44100;
+    } else if (oct0 & (1 << 4)) {
+        rate = 48000;
+    }
+    int channels = (oct0 & (1 << 3)) ? 1 : 2;
+    atomic_store(&s_rate, rate);
+    atomic_store(&s_channels, channels);
+    ESP_LOGI(TAG, "Phone streams SBC at %d Hz, %s", rate, channels == 1 ? "mono" : "stereo");
+}
+
+static void reverse_av_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {
+    switch (event) {
+        case ESP_A2D_CONNECTION_STATE_EVT: {
+            const uint8_t *bda = param->conn_stat.remote_bda;
+            if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
+                ESP_LOGI(TAG, "Phone connected: %02x:%02x:%02x:%02x:%02x:%02x", bda[0], bda[1], bda[2], bda[3],
+                         bda[4], bda[5]);
+                atomic_store(&s_connected, true);
+                esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_NON_DISCOVERABLE);
+            } else if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
+                ESP_LOGW(TAG, "Phone disconnected; discoverable again");
+                atomic_store(&s_connected, false);
+                esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
+            }
+            break;
+        }
+        case ESP_A2D_AUDIO_STATE_EVT: {
+            if (param->audio_stat.state == ESP_A2D_AUDIO_STATE_STARTED) {
+                ESP_LOGI(TAG, "Phone started playing");
+                atomic_store(&s_restart, true);
+            }
+            break;
+        }
+        case ESP_A2D_AUDIO_CFG_EVT: {
+            sink_configured(&param->audio_cfg.mcc);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// --- Network side ---
+static int payload_type(int rate) {
+    switch (rate) {
+        case 48000:
+            return REVERSE_BRIDGE_PT_48K;
+        case 32000:
+            return REVERSE_BRIDGE_PT_32K;
+        case 16000:
+            return REVERSE_BRIDGE_PT_16K;
+        default:
+            return REVERSE_BRIDGE_PT_44K;
+    }
+}
+
+// Sends one packet to the current destination; what was queued before
+// "rtp off" is dropped here rather than sent.
+static void rtp_send(const void *packet, size_t len) {
+    if (!atomic_load(&s_enabled)) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    struct sockaddr_in dest = s_dest;
+    xSemaphoreGive(s_lock);
+    if (sendto(s_sock, packet, len, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+        atomic_fetch_add_explicit(&s_send_errors, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&s_sent_packets, 1, memory_order_relaxed);
+    }
+}
+
+static void rtp_task(void *pvParameters) {
+    // Word-aligned so the payload can be written 16 bits at a time.
+    static uint32_t packet[(sizeof(rtp_header_t) + RTP_PAYLOAD_FRAMES * 2 * sizeof(int16_t)) / sizeof(uint32_t)];
+    static int16_t pcm[RTP_PAYLOAD_FRAMES * 2];
+    rtp_header_t *hdr = (rtp_header_t *)packet;
+    uint16_t *payload = (uint16_t *)(hdr + 1);
+    uint16_t seq = esp_random();
+    uint32_t ssrc = esp_random();
+
+    while (1) {
+        rtp_record_t rec;
+        if (spsc_ring_used(&s_ring) < sizeof(rec)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RTP_WAIT_MS));
+            continue;
+        }
+        spsc_ring_read(&s_ring, &rec, sizeof(rec));
+        int pt = payload_type(atomic_load(&s_rate));
+        size_t frame_bytes = rec.channels * sizeof(int16_t);
+        uint32_t frames = rec.len / frame_bytes;
+
+        for (uint32_t done = 0; done < frames;) {
+            uint32_t n = frames - done < RTP_PAYLOAD_FRAMES ? frames - done : RTP_PAYLOAD_FRAMES;
+            // The PCM is published right after its record.
+            while (spsc_ring_used(&s_ring) < n * frame_bytes) {
+                vTaskDelay(1);
+            }
+            spsc_ring_read(&s_ring, pcm, n * frame_bytes);
+            for (uint32_t i = 0; i < n; i++) {
+                payload[2 * i] = htons((uint16_t)pcm[i * rec.channels]);
+                payload[2 * i + 1] = htons((uint16_t)pcm[i * rec.channels + rec.channels - 1]);
+            }
+            hdr->flags = RTP_VERSION;
+            hdr->marker_pt = (rec.marker && done == 0 ? RTP_MARKER : 0) | pt;
+            hdr->seq = htons(seq++);
+            hdr->timestamp = htonl(rec.timestamp + done);
+            hdr->ssrc = htonl(ssrc);
+
+            rtp_send(packet, sizeof(*hdr) + n * 2 * sizeof(int16_t));
+            done += n;
+        }
+    }
+}
+
+// --- Console and telemetry ---
+static int rtp_telemetry(char *buf, size_t len) {
+    return snprintf(buf, len, "on=%d phone=%d rate=%d channels=%d frames=%u packets=%u dropped=%u errors=%u",
+                    atomic_load(&s_enabled), atomic_load(&s_connected), atomic_load(&s_rate),
+                    atomic_load(&s_channels), atomic_load(&s_received_frames), atomic_load(&s_sent_packets),
+                    atomic_load(&s_dropped_frames), atomic_load(&s_send_errors));
+}
+
+static int cmd_rtp(int argc, char **argv) {
+    if (!atomic_load(&s_started)) {
+        console_printf("The bridge runs forward; choose reverse mode at setup to forward a phone's audio\n");
+        return argc < 2 ? 0 : -1;
+    }
+    if (argc < 2) {
+        char ip[16] = "off";
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        struct sockaddr_in dest = s_dest;
+        xSemaphoreGive(s_lock);
+        if (atomic_load(&s_enabled)) {
+            inet_ntoa_r(dest.sin_addr, ip, sizeof(ip));
+        }
+        console_printf("rtp %s port %d: phone %s, %d Hz %s\n", ip, ntohs(dest.sin_port),
+                       atomic_load(&s_connected) ? "connected" : "not connected", atomic_load(&s_rate),
+                       atomic_load(&s_channels) == 1 ? "mono" : "stereo");
+        console_printf("  %u frames received, %u packets sent, %u frames dropped (ring full), %u send errors\n",
+                       atomic_load(&s_received_frames), atomic_load(&s_sent_packets),
+                       atomic_load(&s_dropped_frames), atomic_load(&s_send_errors));
+        console_printf("Usage: rtp <ip> [port] | rtp off\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "off") == 0) {
+        atomic_store(&s_enabled, false);
+        return 0;
+    }
+
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(argc > 2 ? atoi(argv[2]) : REVERSE_BRIDGE_DEFAULT_PORT),
+    };
+    if (inet_aton(argv[1], &dest.sin_addr) == 0) {
+        console_printf("Invalid address '%s'\n", argv[1]);
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_dest = dest;
+    xSemaphoreGive(s_lock);
+    atomic_store(&s_enabled, true);
+    ESP_LOGI(TAG, "Forwarding the phone's audio to %s:%d", argv[1], ntohs(dest.sin_port));
+    return 0;
+}
+
+void reverse_bridge_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    console_register("rtp", "Forward a phone's audio as RTP (reverse mode): rtp <ip> [port] | off", cmd_rtp);
+    telemetry_register("rtp", rtp_telemetry);
+}
+
+void reverse_bridge_start(void) {
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_sock < 0 || !spsc_ring_init(&s_ring, RTP_RING_SIZE)) {
+        ESP_LOGE(TAG, "Unable to set up RTP forwarding (socket %d)", s_sock);
+        return;
+    }
+    xTaskCreatePinnedToCore(rtp_task, "rtp", 3072, NULL, 9, &s_task, 1);
+
+    ESP_ERROR_CHECK(esp_a2d_register_callback(reverse_av_cb));
+    ESP_ERROR_CHECK(esp_a2d_sink_register_data_callback(sink_data_cb));
+    ESP_ERROR_CHECK(esp_a2d_sink_init());
+    ESP_ERROR_CHECK(esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE));
+    atomic_store(&s_started, true);
+}
@@ -0,0 +1,29 @@
+/*
+ * Reverse bridge: the ESP32 as Bluetooth headphones for a phone, forwarding
+ * what it plays to the network as RTP (see tools/rtp_receiver.py).
+ *
+ * Packets carry uncompressed 16-bit stereo PCM, big endian (RFC 3551 L16),
+ * with the RTP timestamp counting frames from the start of the stream:
+ * payload type 10 at 44.1 kHz and the dynamic types below otherwise. The
+ * marker bit is set on the first packet after the phone starts playing and
+ * after frames were dropped on the device.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define REVERSE_BRIDGE_DEFAULT_PORT     5004
+#define REVERSE_BRIDGE_PT_44K           10      // Static L16 stereo 44.1 kHz
+#define REVERSE_BRIDGE_PT_48K           96
+#define REVERSE_BRIDGE_PT_32K           97
+#define REVERSE_BRIDGE_PT_16K           98
+
+// Registers the "rtp" command and telemetry.
+void reverse_bridge_init(void);
+
+// Initializes the A2DP sink role in place of the source, makes the bridge
+// discoverable and starts the sender task. Call once Bluedroid is
+// enabled; A2DP allows one role at a time, so this is instead of the
+// forward bridge.
+void reverse_bridge_start(void);
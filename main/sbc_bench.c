@@ -0,0 +1,99 @@
+/*
+ * SBC codec benchmark
+ *
+ * Encodes and decodes the same block of synthetic stereo audio (a tone plus
+ * filtered noise that differs between channels, so joint stereo has
+ * something to decide) with every preset, timing each frame on the cycle
+ * counter. The round trip is compared with the input to catch fixed-point
+ * regressions: the SBC filter bank itself tops out around 65 dB.
+ */
+
+#include "sbc_bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include "esp_cpu.h"
+#include "bridge_console.h"
+#include "sbc_codec.h"
+
+#define SBC_BENCH_FRAMES    32
+#define SBC_BENCH_SKIP      4       // Frames left out of the SNR while the filters fill
+
+static void fill_input(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    int32_t lp[2] = { 0, 0 };
+    for (size_t i = 0; i < frames; i++) {
+        double tone = 6000.0 * sin(2 * M_PI * 1000.0 * i / 44100.0);
+        for (int ch = 0; ch < 2; ch++) {
+            seed = seed * 1664525u + 1013904223u;
+            lp[ch] += (((int32_t)(seed >> 16) - 32768) - lp[ch]) >> 2;
+            pcm[2 * i + ch] = (int16_t)(tone * (ch ? 0.5 : 1.0) + lp[ch] / 2);
+        }
+    }
+}
+
+static void sbc_bench(void) {
+    size_t samples = SBC_BENCH_FRAMES * SBC_MAX_SAMPLES * SBC_MAX_CHANNELS;
+    int16_t *in = malloc(samples * sizeof(int16_t));
+    int16_t *out = malloc(samples * sizeof(int16_t));
+    sbc_encoder_t *enc = malloc(sizeof(*enc));
+    sbc_decoder_t *dec = malloc(sizeof(*dec));
+    uint8_t frame[SBC_MAX_FRAME_LEN + 2];
+    if (!in || !out || !enc || !dec) {
+        console_printf("sbc: out of memory\n");
+        goto done;
+    }
+    fill_input(in, samples / 2);
+
+    console_printf("preset  kbit/s  bytes  enc cyc/frame  dec cyc/frame  cpu@%dMHz  snr dB\n",
+                   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    const char *name;
+    for (int i = 0; (name = sbc_preset_name(i)) != NULL; i++) {
+        sbc_params_t p;
+        sbc_preset(name, &p);
+        sbc_encoder_init(enc, &p);
+        sbc_decoder_init(dec);
+
+        int per_frame = p.blocks * p.subbands;
+        uint32_t enc_cycles = 0;
+        uint32_t dec_cycles = 0;
+        for (int f = 0; f < SBC_BENCH_FRAMES; f++) {
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            int len = sbc_encode_frame(enc, in + f * per_frame * 2, frame);
+            uint32_t t1 = esp_cpu_get_cycle_count();
+            sbc_decode_frame(dec, frame, len, out + f * per_frame * 2);
+            uint32_t t2 = esp_cpu_get_cycle_count();
+            enc_cycles += t1 - t0;
+            dec_cycles += t2 - t1;
+        }
+        enc_cycles /= SBC_BENCH_FRAMES;
+        dec_cycles /= SBC_BENCH_FRAMES;
+
+        // Analysis plus synthesis delays the output by 9M + 1 samples.
+        int delay = 9 * p.subbands + 1;
+        double signal = 0, noise = 0;
+        for (int n = SBC_BENCH_SKIP * per_frame; n < SBC_BENCH_FRAMES * per_frame; n++) {
+            for (int ch = 0; ch < 2; ch++) {
+                double x = in[2 * (n - delay) + ch];
+                double e = out[2 * n + ch] - x;
+                signal += x * x;
+                noise += e * e;
+            }
+        }
+        double frames_per_s = (double)sbc_sample_rate(&p) / per_frame;
+        double cpu = (enc_cycles + dec_cycles) * frames_per_s / (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6) * 100;
+        console_printf("%-6s  %6d  %5d  %13lu  %13lu  %8.1f%%  %6.1f\n", name, sbc_bitrate(&p) / 1000,
+                       sbc_frame_length(&p), (unsigned long)enc_cycles, (unsigned long)dec_cycles, cpu,
+                       noise > 0 ? 10 * log10(signal / noise) : 99.0);
+    }
+
+done:
+    free(in);
+    free(out);
+    free(enc);
+    free(dec);
+}
+
+void sbc_bench_init(void) {
+    console_register_bench("sbc", sbc_bench);
+}
@@ -0,0 +1,9 @@
+/*
+ * SBC codec benchmark ("bench sbc"): cycles per frame for each encoder
+ * preset, plus the decoder and the round-trip SNR.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void sbc_bench_init(void);
@@ -0,0 +1,640 @@
+/*
+ * SBC codec
+ *
+ * Follows the A2DP specification (section 12): header and CRC-8, loudness/SNR
+ * bit allocation, (de)quantization and the cosine-modulated analysis and
+ * synthesis filter banks. Everything is 32-bit fixed point with 64-bit
+ * accumulators; subband and filter-bank values carry SBC_FRAC_BITS fractional
+ * bits on top of 16-bit PCM units.
+ */
+
+#include "sbc_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SBC_FRAC_BITS       10
+#define SBC_COEF_BITS       30
+#define SBC_WINDOW_BITS     16      // Analysis window, so taps fit in int16_t
+
+// --- Tables ---
+static const int s_sample_rates[4] = { 16000, 32000, 44100, 48000 };
+
+static const int8_t s_loudness_offset4[4][4] = {
+    { -1, 0, 0, 0 }, { -2, 0, 0, 1 }, { -2, 0, 0, 1 }, { -2, 0, 0, 1 },
+};
+
+static const int8_t s_loudness_offset8[4][8] = {
+    { -2, 0, 0, 0, 0, 0, 0, 1 }, { -3, 0, 0, 0, 0, 0, 1, 2 },
+    { -4, 0, 0, 0, 0, 0, 1, 2 }, { -4, 0, 0, 0, 0, 0, 1, 2 },
+};
+
+// First half (up to and including the centre tap) of the symmetric prototype
+// filters behind Proto_4_40 and Proto_8_80.
+static const float s_proto4_half[21] = {
+    0.00000000E+00f, 5.36548976E-04f, 1.49188357E-03f, 2.73370904E-03f,
+    3.83720193E-03f, 3.89205149E-03f, 1.86581691E-03f, -3.06012286E-03f,
+    -1.09137620E-02f, -2.04385087E-02f, -2.88757392E-02f, -3.21939290E-02f,
+    -2.58767811E-02f, -6.13245186E-03f, 2.88217274E-02f, 7.76463494E-02f,
+    1.35593274E-01f, 1.94987841E-01f, 2.46636662E-01f, 2.81828203E-01f,
+    2.94315332E-01f,
+};
+
+static const float s_proto8_half[41] = {
+    0.00000000E+00f, 1.56575398E-04f, 3.43256425E-04f, 5.54620202E-04f,
+    8.23919506E-04f, 1.13992507E-03f, 1.47640169E-03f, 1.78371725E-03f,
+    2.01182542E-03f, 2.10371989E-03f, 1.99454554E-03f, 1.61656283E-03f,
+    9.02154502E-04f, -1.78805361E-04f, -1.64973098E-03f, -3.49717454E-03f,
+    -5.65949473E-03f, -8.02941163E-03f, -1.04584443E-02f, -1.27472335E-02f,
+    -1.46525263E-02f, -1.59045603E-02f, -1.62208471E-02f, -1.53184106E-02f,
+    -1.29371806E-02f, -8.85757540E-03f, -2.92408442E-03f, 4.91578024E-03f,
+    1.46404076E-02f, 2.61098752E-02f, 3.90751381E-02f, 5.31873032E-02f,
+    6.79989431E-02f, 8.29847578E-02f, 9.75753918E-02f, 1.11196689E-01f,
+    1.23264548E-01f, 1.33264415E-01f, 1.40753505E-01f, 1.45389847E-01f,
+    1.46955068E-01f,
+};
+
+// Built once from the tables above: synthesis windows D (with the filter-bank
+// gain folded in) and matrixing coefficients N[k][i]; analysis windows C and
+// the folded analysis matrix (see analyze_block()).
+static int32_t s_synth_window4[40];
+static int32_t s_synth_window8[80];
+static int32_t s_synth_matrix4[8][4];
+static int32_t s_synth_matrix8[16][8];
+static int16_t s_analysis_window4[40];
+static int16_t s_analysis_window8[80];
+static int32_t s_analysis_matrix4[4][4];
+static int32_t s_analysis_matrix8[8][8];
+static bool s_tables_ready = false;
+
+static int32_t to_fixed(double x, int frac_bits) {
+    return (int32_t)lround(x * (double)(1LL << frac_bits));
+}
+
+// Tap i of the analysis window: the prototype with its sign flipped on every
+// other run of 2M taps, as tabulated in the specification.
+static double window_tap(const float *half, int m, int i) {
+    int taps = 10 * m;
+    int n = i <= taps / 2 ? i : taps - i;
+    return ((i / (2 * m)) & 1) ? -half[n] : half[n];
+}
+
+// Analysis input index that stands for folded column j (see analyze_block()).
+static int folded_column(int m, int j) {
+    return j <= m / 2 ? m / 2 - j : m + j - m / 2;
+}
+
+static void build_analysis_tables(int m, const float *half, int16_t *window, int32_t *matrix) {
+    for (int i = 0; i < 10 * m; i++) {
+        window[i] = to_fixed(window_tap(half, m, i), SBC_WINDOW_BITS);
+    }
+    for (int k = 0; k < m; k++) {
+        for (int j = 0; j < m; j++) {
+            int i = folded_column(m, j);
+            matrix[k * m + j] = to_fixed(cos((k + 0.5) * (i - m / 2) * M_PI / m), SBC_COEF_BITS);
+        }
+    }
+}
+
+static void sbc_build_tables(void) {
+    if (s_tables_ready) {
+        return;
+    }
+    // The synthesis window is the analysis window scaled by -M.
+    for (int i = 0; i < 40; i++) {
+        s_synth_window4[i] = to_fixed(-4.0 * window_tap(s_proto4_half, 4, i), SBC_COEF_BITS);
+    }
+    for (int i = 0; i < 80; i++) {
+        s_synth_window8[i] = to_fixed(-8.0 * window_tap(s_proto8_half, 8, i), SBC_COEF_BITS);
+    }
+    build_analysis_tables(4, s_proto4_half, s_analysis_window4, &s_analysis_matrix4[0][0]);
+    build_analysis_tables(8, s_proto8_half, s_analysis_window8, &s_analysis_matrix8[0][0]);
+    for (int k = 0; k < 8; k++) {
+        for (int i = 0; i < 4; i++) {
+            s_synth_matrix4[k][i] = to_fixed(cos((i + 0.5) * (k + 2) * M_PI / 4), SBC_COEF_BITS);
+        }
+    }
+    for (int k = 0; k < 16; k++) {
+        for (int i = 0; i < 8; i++) {
+            s_synth_matrix8[k][i] = to_fixed(cos((i + 0.5) * (k + 4) * M_PI / 8), SBC_COEF_BITS);
+        }
+    }
+    s_tables_ready = true;
+}
+
+// --- Header ---
+int sbc_sample_rate(const sbc_params_t *p) {
+    return s_sample_rates[p->freq_index];
+}
+
+int sbc_channels(const sbc_params_t *p) {
+    return p->mode == SBC_MODE_MONO ? 1 : 2;
+}
+
+int sbc_frame_length(const sbc_params_t *p) {
+    int ch = sbc_channels(p);
+    int len = SBC_HEADER_LEN + (4 * p->subbands * ch) / 8;
+    switch (p->mode) {
+        case SBC_MODE_MONO:
+        case SBC_MODE_DUAL_CHANNEL:
+            return len + (p->blocks * ch * p->bitpool + 7) / 8;
+        case SBC_MODE_STEREO:
+            return len + (p->blocks * p->bitpool + 7) / 8;
+        default:
+            return len + (p->subbands + p->blocks * p->bitpool + 7) / 8;
+    }
+}
+
+int sbc_parse_header(const uint8_t *data, size_t len, sbc_params_t *p) {
+    if (len < SBC_HEADER_LEN || data[0] != SBC_SYNCWORD) {
+        return -1;
+    }
+    p->freq_index = data[1] >> 6;
+    p->blocks = 4 * (((data[1] >> 4) & 0x03) + 1);
+    p->mode = (data[1] >> 2) & 0x03;
+    p->allocation = (data[1] >> 1) & 0x01;
+    p->subbands = (data[1] & 0x01) ? 8 : 4;
+    p->bitpool = data[2];
+
+    int max_bitpool = (p->mode == SBC_MODE_MONO || p->mode == SBC_MODE_DUAL_CHANNEL) ?
+                      16 * p->subbands : 32 * p->subbands;
+    if (max_bitpool > 250) {
+        max_bitpool = 250;
+    }
+    if (p->bitpool < 2 || p->bitpool > max_bitpool) {
+        return -1;
+    }
+    return sbc_frame_length(p);
+}
+
+// --- Bit Reading ---
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;             // In bits
+} sbc_bits_t;
+
+static inline uint8_t byte_at(const sbc_bits_t *b, size_t i) {
+    return i < b->len ? b->data[i] : 0;
+}
+
+// Reads n <= 16 bits, most significant first.
+static inline uint32_t bits_get(sbc_bits_t *b, int n) {
+    size_t byte = b->pos >> 3;
+    int shift = b->pos & 7;
+    uint32_t w = ((uint32_t)byte_at(b, byte) << 16) | ((uint32_t)byte_at(b, byte + 1) << 8) |
+                 byte_at(b, byte + 2);
+    b->pos += n;
+    return (w >> (24 - shift - n)) & ((1u << n) - 1);
+}
+
+static uint8_t crc8_bits(uint8_t crc, const uint8_t *data, size_t bit_start, size_t bit_count) {
+    for (size_t i = bit_start; i < bit_start + bit_count; i++) {
+        int bit = (data[i >> 3] >> (7 - (i & 7))) & 1;
+        int top = (crc >> 7) & 1;
+        crc <<= 1;
+        if (top ^ bit) {
+            crc ^= 0x1D;
+        }
+    }
+    return crc;
+}
+
+static int sbc_crc_bits(const sbc_params_t *p) {
+    return (p->mode == SBC_MODE_JOINT_STEREO ? p->subbands : 0) + 4 * p->subbands * sbc_channels(p);
+}
+
+bool sbc_check_crc(const uint8_t *frame, size_t len, const sbc_params_t *p) {
+    int bits = sbc_crc_bits(p);
+    if (len < SBC_HEADER_LEN + (size_t)(bits + 7) / 8) {
+        return false;
+    }
+    // Bytes 1-2 of the header, then everything after the CRC byte up to the
+    // end of the scale factors.
+    uint8_t crc = crc8_bits(0x0F, frame, 8, 16);
+    crc = crc8_bits(crc, frame, 32, bits);
+    return crc == frame[3];
+}
+
+// --- Bit Allocation ---
+static void allocate_channel(const sbc_params_t *p, const int bitneed[2][SBC_MAX_SUBBANDS],
+                             int8_t bits[2][SBC_MAX_SUBBANDS], int first_ch, int nch) {
+    int m = p->subbands;
+    int max_bitneed = 0;
+    for (int ch = first_ch; ch < first_ch + nch; ch++) {
+        for (int sb = 0; sb < m; sb++) {
+            if (bitneed[ch][sb] > max_bitneed) {
+                max_bitneed = bitneed[ch][sb];
+            }
+        }
+    }
+
+    int bitcount = 0;
+    int slicecount = 0;
+    int bitslice = max_bitneed + 1;
+    do {
+        bitslice--;
+        bitcount += slicecount;
+        slicecount = 0;
+        for (int ch = first_ch; ch < first_ch + nch; ch++) {
+            for (int sb = 0; sb < m; sb++) {
+                if (bitneed[ch][sb] > bitslice + 1 && bitneed[ch][sb] < bitslice + 16) {
+                    slicecount++;
+                } else if (bitneed[ch][sb] == bitslice + 1) {
+                    slicecount += 2;
+                }
+            }
+        }
+    } while (bitcount + slicecount < p->bitpool);
+
+    if (bitcount + slicecount == p->bitpool) {
+        bitcount += slicecount;
+        bitslice--;
+    }
+
+    for (int ch = first_ch; ch < first_ch + nch; ch++) {
+        for (int sb = 0; sb < m; sb++) {
+            if (bitneed[ch][sb] < bitslice + 2) {
+                bits[ch][sb] = 0;
+            } else {
+                int b = bitneed[ch][sb] - bitslice;
+                bits[ch][sb] = b < 16 ? b : 16;
+            }
+        }
+    }
+
+    // Hand out what is left, one subband at a time, alternating channels.
+    int ch = first_ch;
+    int sb = 0;
+    while (bitcount < p->bitpool && sb < m) {
+        if (bits[ch][sb] >= 2 && bits[ch][sb] < 16) {
+            bits[ch][sb]++;
+            bitcount++;
+        } else if (bitneed[ch][sb] == bitslice + 1 && p->bitpool > bitcount + 1) {
+            bits[ch][sb] = 2;
+            bitcount += 2;
+        }
+        if (nch == 2 && ch == first_ch) {
+            ch++;
+        } else {
+            ch = first_ch;
+            sb++;
+        }
+    }
+    ch = first_ch;
+    sb = 0;
+    while (bitcount < p->bitpool && sb < m) {
+        if (bits[ch][sb] < 16) {
+            bits[ch][sb]++;
+            bitcount++;
+        }
+        if (nch == 2 && ch == first_ch) {
+            ch++;
+        } else {
+            ch = first_ch;
+            sb++;
+        }
+    }
+}
+
+static void sbc_allocate_bits(const sbc_params_t *p, const uint8_t sf[2][SBC_MAX_SUBBANDS],
+                              int8_t bits[2][SBC_MAX_SUBBANDS]) {
+    int bitneed[2][SBC_MAX_SUBBANDS];
+    int nch = sbc_channels(p);
+    const int8_t *offset = p->subbands == 4 ? s_loudness_offset4[p->freq_index] :
+                                              s_loudness_offset8[p->freq_index];
+
+    for (int ch = 0; ch < nch; ch++) {
+        for (int sb = 0; sb < p->subbands; sb++) {
+            if (p->allocation == SBC_ALLOC_SNR) {
+                bitneed[ch][sb] = sf[ch][sb];
+            } else if (sf[ch][sb] == 0) {
+                bitneed[ch][sb] = -5;
+            } else {
+                int loudness = sf[ch][sb] - offset[sb];
+                bitneed[ch][sb] = loudness > 0 ? loudness / 2 : loudness;
+            }
+        }
+    }
+
+    // Mono and dual channel allocate each channel on its own; stereo modes
+    // share the bitpool between both.
+    if (p->mode == SBC_MODE_STEREO || p->mode == SBC_MODE_JOINT_STEREO) {
+        allocate_channel(p, bitneed, bits, 0, 2);
+    } else {
+        for (int ch = 0; ch < nch; ch++) {
+            allocate_channel(p, bitneed, bits, ch, 1);
+        }
+    }
+}
+
+// --- Synthesis ---
+static void synthesize_block(int32_t *v, const int32_t *s, int m, int16_t *out, int stride) {
+    const int32_t *window = m == 4 ? s_synth_window4 : s_synth_window8;
+
+    memmove(v + 2 * m, v, (20 * m - 2 * m) * sizeof(int32_t));
+    for (int k = 0; k < 2 * m; k++) {
+        const int32_t *n = m == 4 ? s_synth_matrix4[k] : s_synth_matrix8[k];
+        int64_t acc = 0;
+        for (int i = 0; i < m; i++) {
+            acc += (int64_t)n[i] * s[i];
+        }
+        v[k] = (int32_t)(acc >> SBC_COEF_BITS);
+    }
+
+    // U is gathered from V on the fly: U[i*2M + j] = V[i*4M + j] and
+    // U[i*2M + M + j] = V[i*4M + 3M + j].
+    for (int j = 0; j < m; j++) {
+        int64_t acc = 0;
+        for (int i = 0; i < 5; i++) {
+            acc += (int64_t)v[i * 4 * m + j] * window[i * 2 * m + j];
+            acc += (int64_t)v[i * 4 * m + 3 * m + j] * window[i * 2 * m + m + j];
+        }
+        int32_t x = (int32_t)((acc + (1LL << (SBC_COEF_BITS + SBC_FRAC_BITS - 1))) >>
+                              (SBC_COEF_BITS + SBC_FRAC_BITS));
+        out[j * stride] = x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x);
+    }
+}
+
+void sbc_decoder_init(sbc_decoder_t *dec) {
+    sbc_build_tables();
+    memset(dec, 0, sizeof(*dec));
+}
+
+int sbc_decode_frame(sbc_decoder_t *dec, const uint8_t *frame, size_t len, int16_t *pcm) {
+    sbc_params_t p;
+    int flen = sbc_parse_header(frame, len, &p);
+    if (flen < 0 || (size_t)flen > len || !sbc_check_crc(frame, len, &p)) {
+        return -1;
+    }
+
+    int m = p.subbands;
+    int nch = sbc_channels(&p);
+    sbc_bits_t br = { .data = frame, .len = flen, .pos = 32 };
+
+    uint8_t join = 0;
+    if (p.mode == SBC_MODE_JOINT_STEREO) {
+        for (int sb = 0; sb < m; sb++) {
+            join |= bits_get(&br, 1) << sb;
+        }
+        join &= ~(1u << (m - 1));   // Last bit is reserved
+    }
+
+    uint8_t sf[2][SBC_MAX_SUBBANDS];
+    for (int ch = 0; ch < nch; ch++) {
+        for (int sb = 0; sb < m; sb++) {
+            sf[ch][sb] = bits_get(&br, 4);
+        }
+    }
+
+    int8_t bits[2][SBC_MAX_SUBBANDS];
+    sbc_allocate_bits(&p, sf, bits);
+
+    // 2^32 / levels, so dequantization is a multiply instead of a divide.
+    uint32_t recip[2][SBC_MAX_SUBBANDS];
+    for (int ch = 0; ch < nch; ch++) {
+        for (int sb = 0; sb < m; sb++) {
+            recip[ch][sb] = bits[ch][sb] ? (uint32_t)((1ULL << 32) / ((1u << bits[ch][sb]) - 1)) : 0;
+        }
+    }
+
+    for (int blk = 0; blk < p.blocks; blk++) {
+        int32_t s[2][SBC_MAX_SUBBANDS];
+        for (int ch = 0; ch < nch; ch++) {
+            for (int sb = 0; sb < m; sb++) {
+                if (bits[ch][sb] == 0) {
+                    s[ch][sb] = 0;
+                    continue;
+                }
+                // scale * ((2q + 1) / levels - 1) with scale = 2^(sf + 1)
+                uint32_t q = bits_get(&br, bits[ch][sb]);
+                uint64_t ratio = (uint64_t)(2 * q + 1) * recip[ch][sb];
+                int shift = sf[ch][sb] + 1 + SBC_FRAC_BITS;
+                s[ch][sb] = (int32_t)(ratio >> (32 - shift)) - (1 << shift);
+            }
+        }
+        for (int sb = 0; sb < m; sb++) {
+            if (join & (1u << sb)) {
+                int32_t mid = s[0][sb];
+                int32_t side = s[1][sb];
+                s[0][sb] = mid + side;
+                s[1][sb] = mid - side;
+            }
+        }
+        for (int ch = 0; ch < nch; ch++) {
+            synthesize_block(dec->v[ch], s[ch], m, pcm + blk * m * nch + ch, nch);
+        }
+    }
+    return p.blocks * m;
+}
+
+// --- Analysis ---
+// One block of the analysis filter bank. x points at the newest input sample,
+// older ones sit before it: x[-i] is X[i] in the specification.
+static void analyze_block(const int16_t *x, int m, int32_t *s) {
+    const int16_t *window = m == 4 ? s_analysis_window4 : s_analysis_window8;
+    const int32_t *matrix = m == 4 ? &s_analysis_matrix4[0][0] : &s_analysis_matrix8[0][0];
+
+    // Windowing stays in 16x16 -> 32 bit multiplies, which Xtensa does in one
+    // cycle; the worst-case sum is well inside int32_t.
+    int32_t y[2 * SBC_MAX_SUBBANDS];
+    for (int i = 0; i < 2 * m; i++) {
+        int32_t acc = 0;
+        for (int j = 0; j < 5; j++) {
+            int n = i + 2 * m * j;
+            acc += (int32_t)window[n] * x[-n];
+        }
+        y[i] = acc;
+    }
+
+    // cos((k + 0.5)(i - M/2)pi/M) is equal for columns i and M - i, changes
+    // sign between i and 3M - i, and is zero at 3M/2. Folding Y first halves
+    // the matrix to M x M.
+    int32_t r[SBC_MAX_SUBBANDS];
+    r[0] = y[m / 2];
+    for (int j = 1; j <= m / 2; j++) {
+        r[j] = y[m / 2 - j] + y[m / 2 + j];
+    }
+    for (int j = m / 2 + 1; j < m; j++) {
+        int i = folded_column(m, j);
+        r[j] = y[i] - y[3 * m - i];
+    }
+
+    for (int k = 0; k < m; k++) {
+        const int32_t *row = matrix + k * m;
+        int64_t acc = 0;
+        for (int j = 0; j < m; j++) {
+            acc += (int64_t)row[j] * r[j];
+        }
+        s[k] = (int32_t)(acc >> (SBC_COEF_BITS + SBC_WINDOW_BITS - SBC_FRAC_BITS));
+    }
+}
+
+// Smallest scale factor whose range 2^(sf + 1) covers max_abs.
+static inline uint8_t scale_factor(uint32_t max_abs) {
+    int bits = max_abs ? 32 - __builtin_clz(max_abs) : 0;
+    int sf = bits - (SBC_FRAC_BITS + 1);
+    return sf < 0 ? 0 : (sf > 15 ? 15 : sf);
+}
+
+static inline uint32_t abs32(int32_t v) {
+    return v < 0 ? -(uint32_t)v : (uint32_t)v;
+}
+
+// --- Bit Writing ---
+typedef struct {
+    uint8_t *data;
+    size_t pos;             // In bits
+} sbc_writer_t;
+
+// Writes n <= 16 bits, most significant first, into a zeroed buffer.
+static inline void bits_put(sbc_writer_t *w, uint32_t value, int n) {
+    size_t byte = w->pos >> 3;
+    int shift = 24 - (w->pos & 7) - n;
+    uint32_t v = value << shift;
+    w->data[byte] |= v >> 16;
+    w->data[byte + 1] |= v >> 8;
+    w->data[byte + 2] |= v;
+    w->pos += n;
+}
+
+// --- Encoding ---
+static const struct {
+    const char *name;
+    sbc_params_t params;
+} s_presets[] = {
+    // Bluedroid's own source configuration tops out at "sq".
+    { "mq",  { 2, 16, SBC_MODE_JOINT_STEREO, SBC_ALLOC_LOUDNESS, 8, 35 } },   // 229 kbit/s
+    { "sq",  { 2, 16, SBC_MODE_JOINT_STEREO, SBC_ALLOC_LOUDNESS, 8, 53 } },   // 328 kbit/s
+    { "xq",  { 2, 16, SBC_MODE_DUAL_CHANNEL, SBC_ALLOC_LOUDNESS, 8, 38 } },   // 452 kbit/s
+    { "xq+", { 2, 16, SBC_MODE_DUAL_CHANNEL, SBC_ALLOC_LOUDNESS, 8, 47 } },   // 551 kbit/s
+};
+
+bool sbc_preset(const char *name, sbc_params_t *p) {
+    for (size_t i = 0; i < sizeof(s_presets) / sizeof(s_presets[0]); i++) {
+        if (strcmp(name, s_presets[i].name) == 0) {
+            *p = s_presets[i].params;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *sbc_preset_name(int index) {
+    return index >= 0 && index < (int)(sizeof(s_presets) / sizeof(s_presets[0])) ? s_presets[index].name : NULL;
+}
+
+int sbc_bitrate(const sbc_params_t *p) {
+    return sbc_frame_length(p) * 8 * sbc_sample_rate(p) / (p->blocks * p->subbands);
+}
+
+void sbc_encoder_init(sbc_encoder_t *enc, const sbc_params_t *p) {
+    sbc_build_tables();
+    memset(enc, 0, sizeof(*enc));
+    enc->params = *p;
+}
+
+int sbc_encode_frame(sbc_encoder_t *enc, const int16_t *pcm, uint8_t *out) {
+    const sbc_params_t *p = &enc->params;
+    int m = p->subbands;
+    int nch = sbc_channels(p);
+    int history = 9 * m;
+    int flen = sbc_frame_length(p);
+
+    // Filter bank, one frame at a time: the new samples go behind the last
+    // 9M of the previous frame, so each block sees its 10M inputs in place.
+    int32_t sb[SBC_MAX_BLOCKS][SBC_MAX_CHANNELS][SBC_MAX_SUBBANDS];
+    for (int ch = 0; ch < nch; ch++) {
+        int16_t *x = enc->x[ch];
+        for (int i = 0; i < p->blocks * m; i++) {
+            x[history + i] = pcm[i * nch + ch];
+        }
+        for (int blk = 0; blk < p->blocks; blk++) {
+            analyze_block(x + history + blk * m + m - 1, m, sb[blk][ch]);
+        }
+        memmove(x, x + p->blocks * m, history * sizeof(int16_t));
+    }
+
+    uint8_t sf[2][SBC_MAX_SUBBANDS];
+    for (int ch = 0; ch < nch; ch++) {
+        for (int s = 0; s < m; s++) {
+            uint32_t max_abs = 0;
+            for (int blk = 0; blk < p->blocks; blk++) {
+                uint32_t a = abs32(sb[blk][ch][s]);
+                max_abs = a > max_abs ? a : max_abs;
+            }
+            sf[ch][s] = scale_factor(max_abs);
+        }
+    }
+
+    // Joint stereo: code a subband as mid/side when that needs smaller scale
+    // factors in total. The last subband cannot be joined.
+    uint8_t join = 0;
+    if (p->mode == SBC_MODE_JOINT_STEREO) {
+        for (int s = 0; s < m - 1; s++) {
+            uint32_t max_mid = 0;
+            uint32_t max_side = 0;
+            for (int blk = 0; blk < p->blocks; blk++) {
+                int32_t l = sb[blk][0][s];
+                int32_t r = sb[blk][1][s];
+                uint32_t mid = abs32((l >> 1) + (r >> 1));
+                uint32_t side = abs32((l >> 1) - (r >> 1));
+                max_mid = mid > max_mid ? mid : max_mid;
+                max_side = side > max_side ? side : max_side;
+            }
+            uint8_t sf_mid = scale_factor(max_mid);
+            uint8_t sf_side = scale_factor(max_side);
+            if (sf_mid + sf_side < sf[0][s] + sf[1][s]) {
+                join |= 1u << s;
+                sf[0][s] = sf_mid;
+                sf[1][s] = sf_side;
+                for (int blk = 0; blk < p->blocks; blk++) {
+                    int32_t l = sb[blk][0][s];
+                    int32_t r = sb[blk][1][s];
+                    sb[blk][0][s] = (l >> 1) + (r >> 1);
+                    sb[blk][1][s] = (l >> 1) - (r >> 1);
+                }
+            }
+        }
+    }
+
+    int8_t bits[2][SBC_MAX_SUBBANDS];
+    sbc_allocate_bits(p, sf, bits);
+
+    memset(out, 0, flen + 2);   // bits_put() may touch two bytes past the end
+    out[0] = SBC_SYNCWORD;
+    out[1] = (p->freq_index << 6) | ((p->blocks / 4 - 1) << 4) | (p->mode << 2) |
+             (p->allocation << 1) | (m == 8);
+    out[2] = p->bitpool;
+    sbc_writer_t w = { .data = out, .pos = 32 };
+
+    if (p->mode == SBC_MODE_JOINT_STEREO) {
+        for (int s = 0; s < m; s++) {
+            bits_put(&w, (join >> s) & 1, 1);
+        }
+    }
+    for (int ch = 0; ch < nch; ch++) {
+        for (int s = 0; s < m; s++) {
+            bits_put(&w, sf[ch][s], 4);
+        }
+    }
+    out[3] = crc8_bits(crc8_bits(0x0F, out, 8, 16), out, 32, sbc_crc_bits(p));
+
+    // (S / 2^(sf + 1) + 1) * levels / 2, truncated
+    for (int blk = 0; blk < p->blocks; blk++) {
+        for (int ch = 0; ch < nch; ch++) {
+            for (int s = 0; s < m; s++) {
+                int b = bits[ch][s];
+                if (b == 0) {
+                    continue;
+                }
+                int shift = sf[ch][s] + 1 + SBC_FRAC_BITS;
+                uint32_t levels = (1u << b) - 1;
+                int64_t biased = (int64_t)sb[blk][ch][s] + (1LL << shift);
+                uint32_t q = (uint32_t)((biased * levels) >> (shift + 1));
+                bits_put(&w, q < levels ? q : levels - 1, b);
+            }
+        }
+    }
+    return flen;
+}
@@ -0,0 +1,86 @@
+/*
+ * SBC (A2DP low-complexity subband codec) frame parsing, decoding and
+ * encoding.
+ *
+ * Platform independent fixed-point code: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SBC_SYNCWORD            0x9C
+#define SBC_HEADER_LEN          4
+#define SBC_MAX_FRAME_LEN       524     // Dual channel, 8 subbands, 16 blocks, bitpool 128
+#define SBC_MAX_SUBBANDS        8
+#define SBC_MAX_BLOCKS          16
+#define SBC_MAX_CHANNELS        2
+#define SBC_MAX_SAMPLES         (SBC_MAX_BLOCKS * SBC_MAX_SUBBANDS)    // Per channel, per frame
+
+typedef enum {
+    SBC_MODE_MONO,
+    SBC_MODE_DUAL_CHANNEL,
+    SBC_MODE_STEREO,
+    SBC_MODE_JOINT_STEREO,
+} sbc_channel_mode_t;
+
+typedef enum {
+    SBC_ALLOC_LOUDNESS,
+    SBC_ALLOC_SNR,
+} sbc_allocation_t;
+
+typedef struct {
+    uint8_t freq_index;         // 0: 16 kHz, 1: 32 kHz, 2: 44.1 kHz, 3: 48 kHz
+    uint8_t blocks;             // 4, 8, 12 or 16
+    uint8_t mode;               // sbc_channel_mode_t
+    uint8_t allocation;         // sbc_allocation_t
+    uint8_t subbands;           // 4 or 8
+    uint8_t bitpool;
+} sbc_params_t;
+
+typedef struct {
+    int32_t v[SBC_MAX_CHANNELS][20 * SBC_MAX_SUBBANDS];     // Synthesis history, Q10
+} sbc_decoder_t;
+
+int sbc_sample_rate(const sbc_params_t *p);
+int sbc_channels(const sbc_params_t *p);
+
+// Bytes in a frame with these parameters.
+int sbc_frame_length(const sbc_params_t *p);
+
+// Parses the 4-byte header. Returns the frame length, or -1 if this is not a
+// valid SBC header (bad syncword or a bitpool the spec does not allow).
+int sbc_parse_header(const uint8_t *data, size_t len, sbc_params_t *p);
+
+// Checks the header CRC, which also covers the scale factors.
+bool sbc_check_crc(const uint8_t *frame, size_t len, const sbc_params_t *p);
+
+typedef struct {
+    sbc_params_t params;
+    int16_t x[SBC_MAX_CHANNELS][9 * SBC_MAX_SUBBANDS + SBC_MAX_SAMPLES];    // Analysis input
+} sbc_encoder_t;
+
+// Fills in one of the named configurations: "mq", "sq" (joint stereo, bitpool
+// 35 and 53) or the dual channel "xq" and "xq+" (bitpool 38 and 47), all
+// 44.1 kHz, 8 subbands, 16 blocks. Returns false for an unknown name.
+bool sbc_preset(const char *name, sbc_params_t *p);
+
+// Name of preset number index, or NULL past the last one.
+const char *sbc_preset_name(int index);
+
+// Bits per second on the wire.
+int sbc_bitrate(const sbc_params_t *p);
+
+void sbc_decoder_init(sbc_decoder_t *dec);
+
+// Decodes one complete frame into interleaved 16-bit PCM (sbc_channels()
+// samples per frame). Returns samples per channel, or -1 on a bad frame.
+int sbc_decode_frame(sbc_decoder_t *dec, const uint8_t *frame, size_t len, int16_t *pcm);
+
+void sbc_encoder_init(sbc_encoder_t *enc, const sbc_params_t *p);
+
+// Encodes blocks * subbands frames of interleaved PCM (sbc_channels() samples
+// each). out needs sbc_frame_length() + 2 bytes. Returns the frame length.
+int sbc_encode_frame(sbc_encoder_t *enc, const int16_t *pcm, uint8_t *out);
@@ -0,0 +1,404 @@
+/*
+ * Secure link
+ *
+ * Records are opened in the buffer recv() wrote them to: the plaintext
+ * replaces the ciphertext byte for byte and ingest is fed from there, so
+ * the link adds no copy beyond moving a partial record to the front.
+ * ChaCha20-Poly1305 is our own (mbedTLS's is not enabled) and checks the tag
+ * before decrypting. AES-256-GCM is mbedTLS's on the ESP32's AES block, with
+ * GHASH in software; it decrypts and checks in one pass and wipes the
+ * record if the tag is wrong, so nothing forged reaches ingest either way.
+ *
+ * The key is only ever set or cleared from the serial console. The control
+ * channel is authenticated under it but not encrypted, so a key typed there
+ * would cross the network in the clear. Changing the key drops the
+ * controller, which then has to answer a challenge under the new one.
+ */
+
+#include "secure_link.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "bridge_console.h"
+#include "chachapoly.h"
+#include "control_channel.h"
+#include "telemetry.h"
+
+static const char *TAG = "LINK";
+
+#define LINK_NAMESPACE      "link"
+#define LINK_KEY_NAME       "psk"
+#define LINK_MAGIC_LEN      4
+
+typedef struct {
+    uint32_t sessions;
+    uint32_t sealed_sessions;
+    uint32_t rejects;
+    uint32_t auth_failures;
+    uint32_t records;
+    uint32_t bytes;             // Plaintext out of records
+    uint32_t crypt_us;          // Time spent opening records (wraps)
+    secure_link_cipher_t cipher;    // Current or last session's
+} link_stats_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+
+// Console task writes, TCP server task copies at session start, under s_lock.
+static uint8_t s_psk[SECURE_LINK_KEY_LEN];
+static bool s_have_psk = false;
+
+// Written by the TCP server task only; telemetry works from differences.
+static link_stats_t s_stats;
+static link_stats_t s_reported;
+static int64_t s_reported_us = 0;
+
+const char *secure_link_cipher_name(secure_link_cipher_t cipher) {
+    switch (cipher) {
+        case SECURE_LINK_PLAIN:             return "plain";
+        case SECURE_LINK_CHACHA20_POLY1305: return "chacha20-poly1305";
+        case SECURE_LINK_AES256_GCM:        return "aes-256-gcm";
+        default:                            return "unknown";
+    }
+}
+
+// --- Key storage ---
+static void load_key(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(LINK_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;     // Never set
+    }
+    size_t len = sizeof(s_psk);
+    s_have_psk = nvs_get_blob(nvs, LINK_KEY_NAME, s_psk, &len) == ESP_OK && len == sizeof(s_psk);
+    nvs_close(nvs);
+}
+
+// Writes key, or erases it if key is NULL.
+static esp_err_t store_key(const uint8_t *key) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(LINK_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        if (key != NULL) {
+            err = nvs_set_blob(nvs, LINK_KEY_NAME, key, SECURE_LINK_KEY_LEN);
+        } else {
+            err = nvs_erase_key(nvs, LINK_KEY_NAME);
+            err = err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    return err;
+}
+
+// First four bytes of SHA-256(key), to check both ends hold the same key
+// without showing it.
+static uint32_t key_fingerprint(const uint8_t *key) {
+    uint8_t digest[32];
+    mbedtls_sha256(key, SECURE_LINK_KEY_LEN, digest, 0);
+    return (uint32_t)digest[0] << 24 | (uint32_t)digest[1] << 16 | (uint32_t)digest[2] << 8 | digest[3];
+}
+
+// --- Session ---
+// Tells the sender why its stream is refused.
+static bool reject(secure_link_t *l, const char *why) {
+    char line[96];
+    snprintf(line, sizeof(line), "E link reject cipher=%s reason=%s record=%llu\n",
+             secure_link_cipher_name(l->cipher), why, (unsigned long long)l->record);
+    ESP_LOGW(TAG, "Stream rejected: %s", why);
+    control_channel_send_line(line);
+    s_stats.rejects++;
+    return false;
+}
+
+void secure_link_begin(secure_link_t *l, int sock, ingest_t *in) {
+    l->sock = sock;
+    l->in = in;
+    l->open = false;
+    l->cipher = SECURE_LINK_PLAIN;
+    l->record = 0;
+    l->len = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    l->keyed = s_have_psk;
+    memcpy(l->key, s_psk, sizeof(l->key));
+    xSemaphoreGive(s_lock);
+    s_stats.sessions++;
+    s_stats.cipher = SECURE_LINK_PLAIN;
+}
+
+void secure_link_end(secure_link_t *l) {
+    if (l->cipher == SECURE_LINK_AES256_GCM) {
+        mbedtls_gcm_free(&l->gcm);
+    }
+    mbedtls_platform_zeroize(l->key, sizeof(l->key));
+    mbedtls_platform_zeroize(l->buf, sizeof(l->buf));
+    l->cipher = SECURE_LINK_PLAIN;
+}
+
+uint8_t *secure_link_rx_buffer(secure_link_t *l, size_t *room) {
+    *room = sizeof(l->buf) - l->len;
+    return l->buf + l->len;
+}
+
+// Checks the hello at the front of buf, answers it and derives the session
+// key in place of the PSK.
+static bool handshake(secure_link_t *l) {
+    const uint8_t *hello = l->buf;
+    l->cipher = hello[LINK_MAGIC_LEN];
+    if (l->cipher != SECURE_LINK_CHACHA20_POLY1305 && l->cipher != SECURE_LINK_AES256_GCM) {
+        return reject(l, "cipher");
+    }
+    for (int i = LINK_MAGIC_LEN + 1; i < SECURE_LINK_HELLO_LEN - SECURE_LINK_NONCE_LEN; i++) {
+        if (hello[i] != 0) {
+            return reject(l, "hello");
+        }
+    }
+    uint8_t nonce[SECURE_LINK_NONCE_LEN];
+    esp_fill_random(nonce, sizeof(nonce));
+    if (send(l->sock, nonce, sizeof(nonce), 0) != sizeof(nonce)) {
+        return false;
+    }
+
+    uint8_t kdf[SECURE_LINK_KEY_LEN + sizeof(SECURE_LINK_LABEL) - 1 + 2 * SECURE_LINK_NONCE_LEN + 1];
+    uint8_t *p = kdf;
+    memcpy(p, l->key, SECURE_LINK_KEY_LEN);
+    p += SECURE_LINK_KEY_LEN;
+    memcpy(p, SECURE_LINK_LABEL, sizeof(SECURE_LINK_LABEL) - 1);
+    p += sizeof(SECURE_LINK_LABEL) - 1;
+    memcpy(p, hello + SECURE_LINK_HELLO_LEN - SECURE_LINK_NONCE_LEN, SECURE_LINK_NONCE_LEN);
+    p += SECURE_LINK_NONCE_LEN;
+    memcpy(p, nonce, SECURE_LINK_NONCE_LEN);
+    p += SECURE_LINK_NONCE_LEN;
+    *p = l->cipher;
+    mbedtls_sha256(kdf, sizeof(kdf), l->key, 0);
+    mbedtls_platform_zeroize(kdf, sizeof(kdf));
+
+    if (l->cipher == SECURE_LINK_AES256_GCM) {
+        mbedtls_gcm_init(&l->gcm);
+        if (mbedtls_gcm_setkey(&l->gcm, MBEDTLS_CIPHER_ID_AES, l->key, SECURE_LINK_KEY_LEN * 8) != 0) {
+            return reject(l, "cipher");
+        }
+    }
+    l->len -= SECURE_LINK_HELLO_LEN;
+    memmove(l->buf, l->buf + SECURE_LINK_HELLO_LEN, l->len);
+    l->open = true;
+    s_stats.sealed_sessions++;
+    s_stats.cipher = l->cipher;
+    ESP_LOGI(TAG, "Sealed session, %s", secure_link_cipher_name(l->cipher));
+    return true;
+}
+
+// Authenticates and decrypts the record at rec, of len plaintext bytes,
+// in place.
+static bool open_record(secure_link_t *l, uint8_t *rec, size_t len) {
+    uint8_t nonce[12] = { 0 };
+    for (int i = 0; i < 8; i++) {
+        nonce[4 + i] = (uint8_t)(l->record >> (8 * i));
+    }
+    uint8_t *data = rec + 2;
+    const uint8_t *tag = data + len;
+    int64_t start = esp_timer_get_time();
+    bool ok;
+    if (l->cipher == SECURE_LINK_CHACHA20_POLY1305) {
+        ok = chachapoly_open(l->key, nonce, rec, 2, data, len, tag);
+    } else {
+        ok = mbedtls_gcm_auth_decrypt(&l->gcm, len, nonce, sizeof(nonce), rec, 2, tag, SECURE_LINK_TAG_LEN,
+                                      data, data) == 0;
+    }
+    s_stats.crypt_us += esp_timer_get_time() - start;
+    return ok;
+}
+
+static bool open_records(secure_link_t *l) {
+    size_t pos = 0;
+    bool ok = true;
+    while (ok && l->len - pos >= 2) {
+        uint8_t *rec = l->buf + pos;
+        size_t len = rec[0] | (size_t)rec[1] << 8;
+        if (len == 0 || len > SECURE_LINK_MAX_RECORD) {
+            return reject(l, "length");
+        }
+        if (l->len - pos < 2 + len + SECURE_LINK_TAG_LEN) {
+            break;      // The rest is still on its way
+        }
+        if (!open_record(l, rec, len)) {
+            s_stats.auth_failures++;
+            return reject(l, "auth");
+        }
+        l->record++;
+        s_stats.records++;
+        s_stats.bytes += len;
+        ok = ingest_feed(l->in, rec + 2, len);
+        pos += 2 + len + SECURE_LINK_TAG_LEN;
+    }
+    l->len -= pos;
+    memmove(l->buf, l->buf + pos, l->len);
+    return ok;
+}
+
+bool secure_link_received(secure_link_t *l, size_t len) {
+    l->len += len;
+    if (!l->open) {
+        size_t head = l->len < LINK_MAGIC_LEN ? l->len : LINK_MAGIC_LEN;
+        bool hello = memcmp(l->buf, SECURE_LINK_MAGIC, head) == 0;
+        if (!l->keyed) {
+            if (hello && head == LINK_MAGIC_LEN) {
+                return reject(l, "no-key");
+            }
+            if (hello) {
+                return true;        // Too short to tell yet
+            }
+            l->open = true;         // Plaintext, as before there was a link
+        } else if (!hello) {
+            return reject(l, "plaintext");
+        } else if (l->len < SECURE_LINK_HELLO_LEN) {
+            return true;
+        } else if (!handshake(l)) {
+            return false;
+        }
+    }
+    if (l->cipher == SECURE_LINK_PLAIN) {
+        bool ok = ingest_feed(l->in, l->buf, l->len);
+        l->len = 0;
+        return ok;
+    }
+    return open_records(l);
+}
+
+// --- Control channel ---
+static bool parse_key(const char *hex, uint8_t key[SECURE_LINK_KEY_LEN]) {
+    if (strlen(hex) != 2 * SECURE_LINK_KEY_LEN) {
+        return false;
+    }
+    for (int i = 0; i < SECURE_LINK_KEY_LEN; i++) {
+        unsigned v;
+        if (sscanf(hex + 2 * i, "%2x", &v) != 1) {
+            return false;
+        }
+        key[i] = v;
+    }
+    return true;
+}
+
+bool secure_link_control_challenge(uint8_t challenge[SECURE_LINK_NONCE_LEN]) {
+    esp_fill_random(challenge, SECURE_LINK_NONCE_LEN);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool keyed = s_have_psk;
+    xSemaphoreGive(s_lock);
+    return keyed;
+}
+
+bool secure_link_control_verify(const uint8_t challenge[SECURE_LINK_NONCE_LEN], const char *hex) {
+    uint8_t answer[SECURE_LINK_KEY_LEN];
+    if (!parse_key(hex, answer)) {
+        return false;
+    }
+    uint8_t msg[sizeof(SECURE_LINK_CONTROL_LABEL) - 1 + SECURE_LINK_NONCE_LEN];
+    memcpy(msg, SECURE_LINK_CONTROL_LABEL, sizeof(SECURE_LINK_CONTROL_LABEL) - 1);
+    memcpy(msg + sizeof(SECURE_LINK_CONTROL_LABEL) - 1, challenge, SECURE_LINK_NONCE_LEN);
+    uint8_t expect[32];
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool keyed = s_have_psk;
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), s_psk, sizeof(s_psk), msg, sizeof(msg), expect);
+    xSemaphoreGive(s_lock);
+    uint8_t diff = 0;
+    for (int i = 0; i < sizeof(expect); i++) {
+        diff |= expect[i] ^ answer[i];
+    }
+    mbedtls_platform_zeroize(expect, sizeof(expect));
+    return keyed && diff == 0;
+}
+
+// --- Reporting ---
+static int link_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    link_stats_t st = s_stats;
+    double span_s = s_reported_us ? (now - s_reported_us) / 1e6 : 0;
+    uint32_t crypt_us = st.crypt_us - s_reported.crypt_us;
+    int n = snprintf(buf, len, "key=%s cipher=%s records=%lu kbps=%.0f crypt_cpu=%.1f%% auth_fail=%lu rejects=%lu",
+                     s_have_psk ? "set" : "none", secure_link_cipher_name(st.cipher),
+                     (unsigned long)(st.records - s_reported.records),
+                     span_s > 0 ? (st.bytes - s_reported.bytes) * 8 / span_s / 1000 : 0.0,
+                     span_s > 0 ? crypt_us / span_s / 1e4 : 0.0, (unsigned long)st.auth_failures,
+                     (unsigned long)st.rejects);
+    s_reported = st;
+    s_reported_us = now;
+    return n;
+}
+
+static int cmd_link(int argc, char **argv) {
+    if (argc < 2) {
+        link_stats_t st = s_stats;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (s_have_psk) {
+            console_printf("link: key set (fingerprint %08lx); only sealed streams accepted\n",
+                           (unsigned long)key_fingerprint(s_psk));
+        } else {
+            console_printf("link: no key; plaintext streams accepted\n");
+        }
+        xSemaphoreGive(s_lock);
+        console_printf("  %lu sessions, %lu sealed (last %s), %lu rejected, %lu auth failures\n",
+                       (unsigned long)st.sessions, (unsigned long)st.sealed_sessions,
+                       secure_link_cipher_name(st.cipher), (unsigned long)st.rejects,
+                       (unsigned long)st.auth_failures);
+        console_printf("  %lu records, %lu bytes, %lu us opening them\n", (unsigned long)st.records,
+                       (unsigned long)st.bytes, (unsigned long)st.crypt_us);
+        console_printf("Usage: link key <64 hex digits> | link off (serial console only)\n");
+        return 0;
+    }
+    if (console_is_remote()) {
+        console_printf("link: the key can only be changed from the serial console\n");
+        return -1;
+    }
+    uint8_t key[SECURE_LINK_KEY_LEN];
+    bool off = strcmp(argv[1], "off") == 0;
+    if (!off && (strcmp(argv[1], "key") != 0 || argc < 3 || !parse_key(argv[2], key))) {
+        console_printf("Usage: link key <64 hex digits> | link off\n");
+        return -1;
+    }
+    esp_err_t err = store_key(off ? NULL : key);
+    if (err != ESP_OK) {
+        console_printf("link: could not save the key (%s)\n", esp_err_to_name(err));
+        mbedtls_platform_zeroize(key, sizeof(key));
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_have_psk = !off;
+    if (off) {
+        mbedtls_platform_zeroize(s_psk, sizeof(s_psk));
+    } else {
+        memcpy(s_psk, key, sizeof(s_psk));
+    }
+    xSemaphoreGive(s_lock);
+    // A controller let in under the old key, or with none, has to answer again.
+    control_channel_disconnect();
+    if (off) {
+        console_printf("link: key cleared; plaintext streams accepted from the next connection\n");
+    } else {
+        console_printf("link: key saved (fingerprint %08lx); sealed streams required from the next connection\n",
+                       (unsigned long)key_fingerprint(key));
+    }
+    mbedtls_platform_zeroize(key, sizeof(key));
+    return 0;
+}
+
+void secure_link_init(void) {
+    s_lock = xSemaphoreCreateMutex();
+    load_key();
+    if (s_have_psk) {
+        ESP_LOGI(TAG, "Key set (fingerprint %08lx); only sealed streams accepted",
+                 (unsigned long)key_fingerprint(s_psk));
+    }
+    console_register("link", "Encrypted audio stream: link [key <64 hex digits> | off]", cmd_link);
+    telemetry_register("link", link_telemetry);
+}
@@ -0,0 +1,92 @@
+/*
+ * Secure link: optional authenticated encryption of the audio stream on
+ * port 8080 under a pre-shared key kept in NVS.
+ *
+ * With no key set, streams are taken as before. Once one is set ("link key"
+ * on the serial console) a sender must open with a hello,
+ *
+ *     "ASL1" | cipher (u8) | 11 zero bytes | client nonce (16)
+ *
+ * to which the bridge answers with its own 16-byte nonce. The session key
+ * is SHA-256 of the key, SECURE_LINK_LABEL, both nonces and the cipher, and
+ * everything after is sealed records:
+ *
+ *     length (u16 LE, 1..SECURE_LINK_MAX_RECORD) | ciphertext | tag (16)
+ *
+ * The length is the associated data and the nonce is four zero bytes and
+ * the record's number (u64 LE), so a record dropped, reordered or replayed
+ * fails authentication. The receive buffer belongs to the link: records are
+ * decrypted where they landed and ingest is fed from there.
+ *
+ * The same key guards the control channel. Each controller is sent a random
+ * challenge and must answer with HMAC-SHA256 under the key of
+ * SECURE_LINK_CONTROL_LABEL and the challenge before any command runs.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mbedtls/gcm.h"
+#include "ingest.h"
+
+#define SECURE_LINK_MAGIC           "ASL1"
+#define SECURE_LINK_LABEL           "ASL1 session key"
+#define SECURE_LINK_CONTROL_LABEL   "ASL1 control"
+#define SECURE_LINK_KEY_LEN         32
+#define SECURE_LINK_NONCE_LEN       16
+#define SECURE_LINK_HELLO_LEN       32
+#define SECURE_LINK_TAG_LEN         16
+#define SECURE_LINK_MAX_RECORD      1024
+#define SECURE_LINK_RECORD_BYTES    (2 + SECURE_LINK_MAX_RECORD + SECURE_LINK_TAG_LEN)
+#define SECURE_LINK_BUFFER_BYTES    (2 * SECURE_LINK_RECORD_BYTES)
+
+typedef enum {
+    SECURE_LINK_PLAIN = 0,
+    SECURE_LINK_CHACHA20_POLY1305 = 1,
+    SECURE_LINK_AES256_GCM = 2,
+} secure_link_cipher_t;
+
+typedef struct {
+    int sock;
+    ingest_t *in;
+    bool keyed;                     // A key was set when the session began
+    bool open;                      // Hello done, or plaintext accepted
+    secure_link_cipher_t cipher;
+    uint8_t key[SECURE_LINK_KEY_LEN];   // The PSK until the hello, then the session key
+    uint64_t record;                // Number of the next record
+    mbedtls_gcm_context gcm;        // AES-256-GCM sessions
+    size_t len;                     // Bytes held in buf
+    uint8_t buf[SECURE_LINK_BUFFER_BYTES];
+} secure_link_t;
+
+// Loads the key and registers the "link" console command and telemetry;
+// call before telemetry_init().
+void secure_link_init(void);
+
+const char *secure_link_cipher_name(secure_link_cipher_t cipher);
+
+// Starts a session on sock feeding in, under the key set now.
+void secure_link_begin(secure_link_t *l, int sock, ingest_t *in);
+
+// Where the next recv() should write, and how much room there is.
+uint8_t *secure_link_rx_buffer(secure_link_t *l, size_t *room);
+
+// Takes len bytes received into the buffer: answers the hello, opens every
+// complete record in place and feeds it to ingest. Returns false if the
+// session must be closed (bad hello, plaintext where a key is set, a record
+// failing authentication, or ingest refusing the stream); the sender has
+// been told why.
+bool secure_link_received(secure_link_t *l, size_t len);
+
+// Ends the session and wipes its key.
+void secure_link_end(secure_link_t *l);
+
+// Draws a challenge for a new controller. Returns false if no key is set,
+// in which case the controller needs no answer.
+bool secure_link_control_challenge(uint8_t challenge[SECURE_LINK_NONCE_LEN]);
+
+// Checks a controller's answer to challenge, 64 hex digits. False if no key
+// is set any more or it was changed since the challenge was drawn.
+bool secure_link_control_verify(const uint8_t challenge[SECURE_LINK_NONCE_LEN], const char *hex);
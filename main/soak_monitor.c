@@ -0,0 +1,212 @@
+/*
+ * Soak monitor
+ *
+ * The bridge is meant to run all day, so this task samples free heap, playback
+ * buffer fill and the latency that fill represents, and fits a line through
+ * the last SOAK_WINDOW_SAMPLES samples. A heap that keeps shrinking or a
+ * latency that keeps growing inside one streaming session is reported, and the
+ * heap left after each session is compared with the first one to catch leaks
+ * in the connect/disconnect path.
+ *
+ * The latency sampled here is what the buffer fill represents, so it tops
+ * out at the buffer's 93 ms. A sender running ahead under the lossless
+ * overflow policy queues the rest in TCP, which the fill cannot show; the
+ * host soak test (test/test_soak.c) drives the same checks over a simulated
+ * day with latency measured from timestamps the sender put in the audio.
+ */
+
+#include "soak_monitor.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "audio_bridge.h"
+
+static const char *TAG = "SOAK_MONITOR";
+
+#define SOAK_WINDOW_SAMPLES           60
+#define SOAK_HEAP_SLOPE_LIMIT         1024    // Bytes of heap lost per hour
+#define SOAK_LATENCY_SLOPE_LIMIT_MS   20      // Milliseconds of latency gained per hour
+#define SOAK_LATENCY_RISE_MIN_MS      12      // Less across the window is one a2d_data_cb period of jitter
+#define SOAK_SESSION_LEAK_LIMIT       2048    // Bytes of heap lost across sessions
+
+typedef struct {
+    uint32_t free_heap;
+    uint32_t latency_ms;
+    uint32_t session;       // Number of finished sessions when the sample was taken
+    bool streaming;
+} soak_sample_t;
+
+// Written by a2d_data_cb and the TCP task, read by the monitor task.
+static volatile uint32_t s_underrun_events;
+static volatile uint32_t s_underrun_bytes;
+static volatile uint32_t s_session_count;
+static volatile uint32_t s_session_heap_first;
+static volatile uint32_t s_session_heap_last;
+
+void soak_monitor_note_underrun(size_t missing_bytes) {
+    s_underrun_events++;
+    s_underrun_bytes += missing_bytes;
+}
+
+void soak_monitor_note_session_end(void) {
+    uint32_t heap = esp_get_free_heap_size();
+    if (s_session_count == 0) {
+        s_session_heap_first = heap;
+    }
+    s_session_heap_last = heap;
+    s_session_count++;
+}
+
+#if CONFIG_BRIDGE_SOAK_MONITOR
+
+static soak_sample_t s_window[SOAK_WINDOW_SAMPLES];
+static int s_window_count = 0;
+static int s_window_head = 0;
+
+static void soak_window_push(const soak_sample_t *sample) {
+    s_window[s_window_head] = *sample;
+    s_window_head = (s_window_head + 1) % SOAK_WINDOW_SAMPLES;
+    if (s_window_count < SOAK_WINDOW_SAMPLES) {
+        s_window_count++;
+    }
+}
+
+// Only a window spent entirely inside one streaming session says anything about
+// drift; connects and disconnects move heap and latency in steps.
+static bool soak_window_is_steady(void) {
+    if (s_window_count < SOAK_WINDOW_SAMPLES) {
+        return false;
+    }
+    uint32_t session = s_window[0].session;
+    for (int i = 0; i < SOAK_WINDOW_SAMPLES; i++) {
+        if (!s_window[i].streaming || s_window[i].session != session) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Least-squares slopes of free heap and latency, scaled to units per hour.
+static void soak_window_slopes(double *heap_per_hour, double *latency_per_hour) {
+    double n = s_window_count;
+    double sx = 0, sxx = 0, sy_heap = 0, sxy_heap = 0, sy_lat = 0, sxy_lat = 0;
+
+    for (int i = 0; i < s_window_count; i++) {
+        // Walk oldest to newest so x grows with time.
+        const soak_sample_t *s = &s_window[(s_window_head + i) % SOAK_WINDOW_SAMPLES];
+        double x = i;
+        sx += x;
+        sxx += x * x;
+        sy_heap += s->free_heap;
+        sxy_heap += x * s->free_heap;
+        sy_lat += s->latency_ms;
+        sxy_lat += x * s->latency_ms;
+    }
+
+    double denom = n * sxx - sx * sx;
+    double samples_per_hour = 3600.0 / CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S;
+    *heap_per_hour = (n * sxy_heap - sx * sy_heap) / denom * samples_per_hour;
+    *latency_per_hour = (n * sxy_lat - sx * sy_lat) / denom * samples_per_hour;
+}
+
+// Monitor task only.
+static uint32_t s_last_underrun_events = 0;
+static uint32_t s_last_underrun_bytes = 0;
+static uint32_t s_last_session_checked = 0;
+static size_t s_fill_high = 0;
+
+int soak_monitor_sample(uint32_t latency_ms) {
+    int warnings = 0;
+    size_t fill = audio_bridge_buffered_bytes();
+    if (fill > s_fill_high) {
+        s_fill_high = fill;
+    }
+    soak_sample_t sample = {
+        .free_heap = esp_get_free_heap_size(),
+        .latency_ms = latency_ms,
+        .session = s_session_count,
+        .streaming = audio_bridge_client_connected(),
+    };
+    soak_window_push(&sample);
+
+    uint32_t underrun_events = s_underrun_events;
+    uint32_t underrun_bytes = s_underrun_bytes;
+    ESP_LOGI(TAG, "heap %lu (min %lu, largest %u), buffer %u bytes (peak %u), latency %lu ms, underruns %lu (%lu bytes)",
+             (unsigned long)sample.free_heap,
+             (unsigned long)esp_get_minimum_free_heap_size(),
+             heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+             fill, s_fill_high, (unsigned long)sample.latency_ms,
+             (unsigned long)(underrun_events - s_last_underrun_events),
+             (unsigned long)(underrun_bytes - s_last_underrun_bytes));
+    s_last_underrun_events = underrun_events;
+    s_last_underrun_bytes = underrun_bytes;
+
+    if (soak_window_is_steady()) {
+        double heap_slope, latency_slope;
+        soak_window_slopes(&heap_slope, &latency_slope);
+        if (heap_slope < -SOAK_HEAP_SLOPE_LIMIT) {
+            ESP_LOGW(TAG, "Free heap is falling by %.0f bytes/hour while streaming", -heap_slope);
+            warnings++;
+        }
+        double window_h = SOAK_WINDOW_SAMPLES * CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S / 3600.0;
+        if (latency_slope > SOAK_LATENCY_SLOPE_LIMIT_MS && latency_slope * window_h > SOAK_LATENCY_RISE_MIN_MS) {
+            ESP_LOGW(TAG, "Latency is growing by %.1f ms/hour while streaming", latency_slope);
+            warnings++;
+        }
+    }
+
+    uint32_t sessions = s_session_count;
+    if (sessions >= 3 && sessions != s_last_session_checked) {
+        int32_t lost = (int32_t)(s_session_heap_first - s_session_heap_last);
+        if (lost > SOAK_SESSION_LEAK_LIMIT) {
+            ESP_LOGW(TAG, "Heap after %lu sessions is %ld bytes below the first session; possible leak on disconnect",
+                     (unsigned long)sessions, (long)lost);
+            warnings++;
+        }
+        s_last_session_checked = sessions;
+    }
+    return warnings;
+}
+
+static void soak_monitor_task(void *pvParameters) {
+    TickType_t last_wake = xTaskGetTickCount();
+#if CONFIG_BRIDGE_SOAK_KICK_INTERVAL_S > 0
+    int64_t last_kick_us = esp_timer_get_time();
+#endif
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S * 1000));
+        soak_monitor_sample(audio_bridge_buffered_bytes() * 1000 / AUDIO_BYTES_PER_SEC);
+
+#if CONFIG_BRIDGE_SOAK_KICK_INTERVAL_S > 0
+        int64_t now_us = esp_timer_get_time();
+        if (now_us - last_kick_us >= (int64_t)CONFIG_BRIDGE_SOAK_KICK_INTERVAL_S * 1000000 &&
+            audio_bridge_client_connected()) {
+            ESP_LOGW(TAG, "Injecting sender disconnect");
+            audio_bridge_kick_client();
+            last_kick_us = now_us;
+        }
+#endif
+    }
+}
+
+void soak_monitor_start(void) {
+    xTaskCreate(soak_monitor_task, "soak_monitor", 3072, NULL, 2, NULL);
+}
+
+#else
+
+int soak_monitor_sample(uint32_t latency_ms) {
+    return 0;
+}
+
+void soak_monitor_start(void) {
+}
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Soak monitor: watches for slow leaks and latency drift during long runs.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Starts the low-priority sampling task (no-op if disabled in menuconfig).
+void soak_monitor_start(void);
+
+// Called from a2d_data_cb when the playback buffer could not cover a request.
+void soak_monitor_note_underrun(size_t missing_bytes);
+
+// Called by the TCP server each time a sender disconnects.
+void soak_monitor_note_session_end(void);
+
+// Takes one sample, with latency_ms the latency audio is played at, checks
+// the window for drift and logs the figures. Returns the number of warnings
+// raised. The task samples every CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S with the
+// latency of the playback buffer fill; tests call it themselves.
+int soak_monitor_sample(uint32_t latency_ms);
@@ -0,0 +1,86 @@
+/*
+ * Octave-band spectrum
+ *
+ * The mono mix is at most 2^15 and the window 2^15, so windowed samples
+ * stay within the 2^30 the FFT accepts. The transform is scaled by 1/n,
+ * which leaves a full-scale sine near 2^28 in its peak bin: plenty of
+ * headroom above the rounding noise for any level worth showing. Bin powers
+ * are shifted down by POWER_SHIFT before they are summed: a window's total
+ * is bounded by its energy (under 2^60) and the average must survive
+ * thousands of windows between reads.
+ *
+ * Band edges sit half an octave either side of each centre. The lowest band
+ * also takes everything below it except DC and the highest everything up to
+ * Nyquist, since at a 1024-point window the bottom octave is a single bin.
+ * Shorter windows leave the bottom octaves without a bin of their own, and
+ * those bands read as the floor.
+ */
+
+#include "spectrum.h"
+
+#include <math.h>
+#include <string.h>
+
+#define POWER_SHIFT     8
+
+int spectrum_band_hz(int band) {
+    static const int centre[SPECTRUM_BANDS] = { 63, 125, 250, 500, 1000, 2000, 4000, 8000, 16000 };
+    return centre[band];
+}
+
+bool spectrum_init(spectrum_t *s, int n, uint32_t rate) {
+    if (n < 256 || n > SPECTRUM_MAX_N || (n & (n - 1)) != 0) {
+        return false;
+    }
+    memset(s, 0, sizeof(*s));
+    s->n = n;
+    fft_init(&s->fft, s->table, SPECTRUM_MAX_N);
+
+    double sum_w2 = 0;
+    for (int i = 0; i < n; i++) {
+        double w = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+        s->window[i] = (int16_t)lrint(w * 32767);
+        sum_w2 += (double)s->window[i] * s->window[i];
+    }
+
+    s->first_bin[0] = 1;
+    for (int b = 1; b < SPECTRUM_BANDS; b++) {
+        double edge = spectrum_band_hz(b) / M_SQRT2;
+        s->first_bin[b] = (int)ceil(edge * n / rate);
+    }
+    s->first_bin[SPECTRUM_BANDS] = n / 2 + 1;
+
+    // Parseval: a sine of amplitude A puts A^2/4 * sum(w^2)/n of power into
+    // the positive bins of a transform scaled by 1/n.
+    s->full_scale = 32768.0 * 32768.0 / 4 * sum_w2 / n / (1 << POWER_SHIFT);
+    return true;
+}
+
+void spectrum_analyze(spectrum_t *s, const int16_t *pcm) {
+    for (int i = 0; i < s->n; i++) {
+        int32_t mono = ((int32_t)pcm[2 * i] + pcm[2 * i + 1]) >> 1;
+        s->buf[2 * i] = mono * s->window[i];
+        s->buf[2 * i + 1] = 0;
+    }
+    fft_complex(&s->fft, s->buf, s->n, false);
+
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        uint64_t power = 0;
+        for (int k = s->first_bin[b]; k < s->first_bin[b + 1]; k++) {
+            int64_t re = s->buf[2 * k];
+            int64_t im = s->buf[2 * k + 1];
+            power += (uint64_t)(re * re + im * im) >> POWER_SHIFT;
+        }
+        s->power[b] += power;
+    }
+    s->windows++;
+}
+
+void spectrum_read(spectrum_t *s, float db[SPECTRUM_BANDS]) {
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        double power = s->windows ? (double)s->power[b] / s->windows : 0;
+        db[b] = power > 0 ? fmaxf(10 * log10(power / s->full_scale), SPECTRUM_FLOOR_DB) : SPECTRUM_FLOOR_DB;
+        s->power[b] = 0;
+    }
+    s->windows = 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Octave-band spectrum of 16-bit stereo PCM, in fixed point.
+ *
+ * Each analysis takes one window of frames, mixes it to mono, applies a
+ * Hann window and runs the shared FFT; the power of the bins in every
+ * octave band is accumulated until the levels are read, which averages
+ * all the windows analysed since the last read.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fft.h"
+
+#define SPECTRUM_MAX_N      1024
+#define SPECTRUM_BANDS      9       // Octaves centred on 63 Hz to 16 kHz
+#define SPECTRUM_FLOOR_DB   -120.0f // Reported for a band with no energy
+
+typedef struct {
+    int n;                                      // Window length, 256 to SPECTRUM_MAX_N
+    fft_t fft;
+    int32_t table[FFT_TABLE_LEN(SPECTRUM_MAX_N)];
+    int16_t window[SPECTRUM_MAX_N];             // Hann, Q15
+    int32_t buf[2 * SPECTRUM_MAX_N];            // Complex work area
+    int first_bin[SPECTRUM_BANDS + 1];          // Band b covers [first_bin[b], first_bin[b + 1])
+    double full_scale;                          // Band power of a full-scale sine
+    uint64_t power[SPECTRUM_BANDS];
+    uint32_t windows;                           // Analysed since the last read
+} spectrum_t;
+
+// Nominal centre frequency of band b.
+int spectrum_band_hz(int band);
+
+// Sets up s for windows of n frames (a power of two) at rate Hz. Returns
+// false if n is out of range.
+bool spectrum_init(spectrum_t *s, int n, uint32_t rate);
+
+// Analyses s->n frames of interleaved stereo and adds them to the average.
+void spectrum_analyze(spectrum_t *s, const int16_t *pcm);
+
+// Average level of every band in dB relative to a full-scale sine, since
+// the last call; SPECTRUM_FLOOR_DB if nothing was analysed. Starts a new
+// average.
+void spectrum_read(spectrum_t *s, float db[SPECTRUM_BANDS]);
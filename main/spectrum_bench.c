@@ -0,0 +1,61 @@
+/*
+ * Spectrum benchmark
+ *
+ * Times spectrum_analyze() on noise for 256, 512 and 1024-point windows on
+ * the cycle counter. The monitor analyses SPECTRUM_MONITOR_WINDOWS windows
+ * per report, so its CPU share is the per-window time times that rate.
+ */
+
+#include "spectrum_bench.h"
+
+#include <stdlib.h>
+#include "esp_cpu.h"
+#include "bridge_console.h"
+#include "spectrum.h"
+#include "spectrum_monitor.h"
+
+#define SPECTRUM_BENCH_RUNS     16
+
+static void fill_noise(int16_t *pcm, size_t frames) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 4 - 8192;
+    }
+}
+
+static void spectrum_bench(void) {
+    int16_t *pcm = malloc(2 * SPECTRUM_MAX_N * sizeof(int16_t));
+    spectrum_t *s = malloc(sizeof(*s));
+    if (!pcm || !s) {
+        console_printf("spectrum: out of memory\n");
+        goto done;
+    }
+    fill_noise(pcm, SPECTRUM_MAX_N);
+
+    double mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    double windows_per_s = SPECTRUM_MONITOR_WINDOWS * 1000.0 / SPECTRUM_MONITOR_DEFAULT_MS;
+    for (int n = 256; n <= SPECTRUM_MAX_N; n *= 2) {
+        spectrum_init(s, n, 44100);
+        uint32_t worst = 0, total = 0;
+        for (int r = 0; r < SPECTRUM_BENCH_RUNS; r++) {
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            spectrum_analyze(s, pcm);
+            uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+            total += cycles;
+            worst = cycles > worst ? cycles : worst;
+        }
+        uint32_t mean = total / SPECTRUM_BENCH_RUNS;
+        console_printf("%4d points: %7lu cycles per window (worst %lu), %.0f us; %.2f%% cpu@%dMHz at %.0f windows/s\n",
+                       n, (unsigned long)mean, (unsigned long)worst, mean / mhz,
+                       mean * windows_per_s / (mhz * 1e6) * 100, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, windows_per_s);
+    }
+
+done:
+    free(pcm);
+    free(s);
+}
+
+void spectrum_bench_init(void) {
+    console_register_bench("spectrum", spectrum_bench);
+}
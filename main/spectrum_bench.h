@@ -0,0 +1,10 @@
+/*
+ * Spectrum benchmark ("bench spectrum"): cycles per analysis window at each
+ * supported size and the CPU share the spectrum monitor's default rate
+ * costs.
+ */
+
+#pragma once
+
+// Registers the benchmark.
+void spectrum_bench_init(void);
@@ -0,0 +1,186 @@
+/*
+ * Spectrum monitor
+ *
+ * The analysis task asks for one window at a time: it sets s_wanted and
+ * a2d_data_cb copies that many bytes from the blocks it returns into a side
+ * ring, then goes back to a single atomic load per call. Windows are spaced
+ * so SPECTRUM_MONITOR_WINDOWS of them land in each report, which keeps the
+ * share of audio analysed, and the CPU spent on it, small and independent
+ * of the block size. The task runs below telemetry and the output tap, so
+ * it only ever takes idle time.
+ */
+
+#include "spectrum_monitor.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "spectrum.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+
+static const char *TAG = "SPECTRUM";
+
+#define SPECTRUM_WINDOW_BYTES   (SPECTRUM_MONITOR_N * AUDIO_CHANNELS * sizeof(int16_t))
+#define SPECTRUM_POLL_MS        10
+
+static spsc_ring_t s_ring;
+static atomic_size_t s_wanted;          // Bytes a2d_data_cb still has to copy
+static atomic_bool s_enabled;
+static atomic_int s_report_ms = SPECTRUM_MONITOR_DEFAULT_MS;
+static TaskHandle_t s_task = NULL;
+
+// Analysis task only, apart from the console reading the last levels.
+static spectrum_t *s_spectrum;
+static int16_t *s_pcm;
+static float s_db[SPECTRUM_BANDS];
+static uint32_t s_windows;              // In the last report
+static uint32_t s_reports;
+static int64_t s_busy_us;               // Since the last report
+static int64_t s_reported_us;
+
+void spectrum_monitor_write(const uint8_t *data, size_t len) {
+    size_t wanted = atomic_load_explicit(&s_wanted, memory_order_acquire);
+    if (wanted == 0) {
+        return;
+    }
+    size_t take = len < wanted ? len : wanted;
+    spsc_ring_write(&s_ring, data, take);
+    atomic_store_explicit(&s_wanted, wanted - take, memory_order_release);
+}
+
+// --- Telemetry ---
+static int spectrum_telemetry(char *buf, size_t len) {
+    int64_t now = esp_timer_get_time();
+    double span_us = s_reported_us ? now - s_reported_us : 0;
+    s_windows = s_spectrum->windows;
+    spectrum_read(s_spectrum, s_db);
+
+    int n = snprintf(buf, len, "n=%d windows=%lu", SPECTRUM_MONITOR_N, (unsigned long)s_windows);
+    for (int b = 0; b < SPECTRUM_BANDS && n < (int)len; b++) {
+        int hz = spectrum_band_hz(b);
+        n += snprintf(buf + n, len - n, hz >= 1000 ? " %dk=%.1f" : " %d=%.1f", hz >= 1000 ? hz / 1000 : hz,
+                      s_db[b]);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, " cpu=%.2f%%", span_us > 0 ? s_busy_us / span_us * 100 : 0.0);
+    }
+    s_busy_us = 0;
+    s_reported_us = now;
+    s_reports++;
+    return n;
+}
+
+// --- Analysis ---
+static void spectrum_task(void *pvParameters) {
+    int64_t next_window = 0, next_report = 0;
+    bool capturing = false;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(SPECTRUM_POLL_MS));
+        if (!atomic_load(&s_enabled)) {
+            capturing = false;
+            next_report = 0;
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        int64_t report_us = (int64_t)atomic_load(&s_report_ms) * 1000;
+        if (next_report == 0) {
+            next_report = now + report_us;
+            next_window = now;
+            spectrum_read(s_spectrum, s_db);
+        }
+
+        // A window requested before the monitor was last switched off may
+        // still be filling; a2d_data_cb owns s_wanted until it reaches zero.
+        if (!capturing && now >= next_window &&
+            atomic_load_explicit(&s_wanted, memory_order_acquire) == 0) {
+            spsc_ring_flush(&s_ring);
+            atomic_store_explicit(&s_wanted, SPECTRUM_WINDOW_BYTES, memory_order_release);
+            capturing = true;
+            next_window += report_us / SPECTRUM_MONITOR_WINDOWS;
+            if (next_window < now) {
+                next_window = now;
+            }
+        }
+        if (capturing && spsc_ring_used(&s_ring) >= SPECTRUM_WINDOW_BYTES) {
+            spsc_ring_read(&s_ring, s_pcm, SPECTRUM_WINDOW_BYTES);
+            capturing = false;
+            int64_t start = esp_timer_get_time();
+            spectrum_analyze(s_spectrum, s_pcm);
+            s_busy_us += esp_timer_get_time() - start;
+        }
+
+        // Reported on time even when nothing plays, so a stalled output
+        // shows up as empty windows rather than a silent monitor.
+        if (now >= next_report) {
+            telemetry_publish("spec", spectrum_telemetry);
+            next_report += report_us;
+            if (next_report < now) {
+                next_report = now + report_us;
+            }
+        }
+    }
+}
+
+// --- Console ---
+static int cmd_spectrum(int argc, char **argv) {
+    if (argc < 2) {
+        console_printf("spectrum %s: %d-point windows, %d per report every %d ms, %lu reports\n",
+                       atomic_load(&s_enabled) ? "on" : "off", SPECTRUM_MONITOR_N, SPECTRUM_MONITOR_WINDOWS,
+                       atomic_load(&s_report_ms), (unsigned long)s_reports);
+        if (s_reports > 0) {
+            console_printf("  last report (%lu windows):", (unsigned long)s_windows);
+            for (int b = 0; b < SPECTRUM_BANDS; b++) {
+                console_printf(" %d Hz %.1f dB%s", spectrum_band_hz(b), s_db[b], b + 1 < SPECTRUM_BANDS ? "," : "\n");
+            }
+        }
+        console_printf("Usage: spectrum on [report ms] | spectrum off\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "off") == 0) {
+        atomic_store(&s_enabled, false);
+        return 0;
+    }
+    if (strcmp(argv[1], "on") != 0) {
+        console_printf("Unknown argument '%s'\n", argv[1]);
+        return -1;
+    }
+
+    int report_ms = argc > 2 ? atoi(argv[2]) : SPECTRUM_MONITOR_DEFAULT_MS;
+    if (report_ms < 100 || report_ms > 10000) {
+        console_printf("Expected a report period of 100-10000 ms\n");
+        return -1;
+    }
+    if (s_task == NULL) {
+        s_spectrum = malloc(sizeof(*s_spectrum));
+        s_pcm = malloc(SPECTRUM_WINDOW_BYTES);
+        if (!s_spectrum || !s_pcm || !spsc_ring_init(&s_ring, SPECTRUM_WINDOW_BYTES)) {
+            ESP_LOGE(TAG, "Out of memory for the spectrum monitor");
+            free(s_spectrum);
+            free(s_pcm);
+            s_spectrum = NULL;
+            s_pcm = NULL;
+            return -1;
+        }
+        spectrum_init(s_spectrum, SPECTRUM_MONITOR_N, AUDIO_SAMPLE_RATE);
+        xTaskCreatePinnedToCore(spectrum_task, "spectrum", 3072, NULL, 1, &s_task, 1);
+    }
+    atomic_store(&s_report_ms, report_ms);
+    atomic_store(&s_enabled, true);
+    ESP_LOGI(TAG, "Publishing the output spectrum every %d ms", report_ms);
+    return 0;
+}
+
+void spectrum_monitor_init(void) {
+    console_register("spectrum", "Octave-band levels of the Bluetooth output as telemetry: spectrum on [ms] | off",
+                     cmd_spectrum);
+}
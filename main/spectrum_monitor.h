@@ -0,0 +1,20 @@
+/*
+ * Spectrum monitor: octave-band levels of the PCM returned by a2d_data_cb,
+ * published as "T spec" telemetry lines a few times a second while it is
+ * switched on with the "spectrum" command.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPECTRUM_MONITOR_N              1024    // Frames per analysis window
+#define SPECTRUM_MONITOR_WINDOWS        4       // Windows averaged into each report
+#define SPECTRUM_MONITOR_DEFAULT_MS     250
+
+// Registers the "spectrum" console command.
+void spectrum_monitor_init(void);
+
+// Called from a2d_data_cb with the block handed to Bluetooth. Never blocks.
+void spectrum_monitor_write(const uint8_t *data, size_t len);
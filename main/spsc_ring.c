@@ -0,0 +1,73 @@
+/*
+ * Single-producer single-consumer byte ring
+ */
+
+#include "spsc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool spsc_ring_init(spsc_ring_t *ring, size_t size) {
+    size_t pow2 = 1;
+    while (pow2 < size) {
+        pow2 <<= 1;
+    }
+    ring->buf = malloc(pow2);
+    if (ring->buf == NULL) {
+        return false;
+    }
+    ring->size = pow2;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return true;
+}
+
+bool spsc_ring_write(spsc_ring_t *ring, const void *data, size_t len) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (ring->size - (head - tail) < len) {
+        return false;
+    }
+
+    size_t pos = head & (ring->size - 1);
+    size_t first = ring->size - pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->buf + pos, data, first);
+    memcpy(ring->buf, (const uint8_t *)data + first, len - first);
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+    return true;
+}
+
+size_t spsc_ring_read(spsc_ring_t *ring, void *data, size_t len) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (len > head - tail) {
+        len = head - tail;
+    }
+
+    size_t pos = tail & (ring->size - 1);
+    size_t first = ring->size - pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, ring->buf + pos, first);
+    memcpy((uint8_t *)data + first, ring->buf, len - first);
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+    return len;
+}
+
+size_t spsc_ring_used(spsc_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+size_t spsc_ring_free(spsc_ring_t *ring) {
+    return ring->size - spsc_ring_used(ring);
+}
+
+void spsc_ring_flush(spsc_ring_t *ring) {
+    atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->head, memory_order_acquire),
+                          memory_order_release);
+}
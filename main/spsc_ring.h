@@ -0,0 +1,37 @@
+/*
+ * Single-producer single-consumer byte ring.
+ *
+ * For side channels fed from a2d_data_cb: the writer never blocks and never
+ * takes a lock, it either fits the whole block or leaves the ring untouched.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;            // Power of two
+    atomic_size_t head;     // Total bytes written (producer)
+    atomic_size_t tail;     // Total bytes read (consumer)
+} spsc_ring_t;
+
+// Allocates the storage; size is rounded up to a power of two.
+bool spsc_ring_init(spsc_ring_t *ring, size_t size);
+
+// Writes all of data or nothing. Returns false if it did not fit.
+bool spsc_ring_write(spsc_ring_t *ring, const void *data, size_t len);
+
+// Reads up to len bytes and returns how many were read.
+size_t spsc_ring_read(spsc_ring_t *ring, void *data, size_t len);
+
+size_t spsc_ring_used(spsc_ring_t *ring);
+
+// Space left for the producer.
+size_t spsc_ring_free(spsc_ring_t *ring);
+
+// Discards everything currently stored; consumer side only.
+void spsc_ring_flush(spsc_ring_t *ring);
@@ -0,0 +1,109 @@
+/*
+ * Telemetry
+ *
+ * One low-priority task reads every provider once per period, so providers
+ * with per-period counters see a single reader. The last snapshot is kept for
+ * the "telemetry" console command.
+ */
+
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "bridge_console.h"
+
+#define TELEMETRY_MAX_PROVIDERS     16
+#define TELEMETRY_LINE_MAX          256
+#define TELEMETRY_SNAPSHOT_SIZE     2048
+
+typedef struct {
+    const char *name;
+    telemetry_fn_t fn;
+} telemetry_provider_t;
+
+static telemetry_provider_t s_providers[TELEMETRY_MAX_PROVIDERS];
+static int s_provider_count = 0;
+static telemetry_sink_t s_sink = NULL;
+static char s_snapshot[TELEMETRY_SNAPSHOT_SIZE];
+static SemaphoreHandle_t s_snapshot_lock;
+
+int telemetry_register(const char *name, telemetry_fn_t fn) {
+    if (s_provider_count >= TELEMETRY_MAX_PROVIDERS) {
+        return -1;
+    }
+    s_providers[s_provider_count++] = (telemetry_provider_t){ .name = name, .fn = fn };
+    return 0;
+}
+
+void telemetry_set_sink(telemetry_sink_t sink) {
+    s_sink = sink;
+}
+
+// "T <name> <pairs>\n" into line; returns the length.
+static int format_line(char *line, size_t size, const char *name, telemetry_fn_t fn) {
+    int n = snprintf(line, size, "T %s ", name);
+    n += fn(line + n, size - n - 1);
+    if (n > (int)size - 2) {
+        n = size - 2;
+    }
+    line[n++] = '\n';
+    line[n] = '\0';
+    return n;
+}
+
+void telemetry_publish(const char *name, telemetry_fn_t fn) {
+    char line[TELEMETRY_LINE_MAX];
+    format_line(line, sizeof(line), name, fn);
+    if (s_sink != NULL) {
+        s_sink(line);
+    }
+}
+
+static void telemetry_task(void *pvParameters) {
+    static char snapshot[TELEMETRY_SNAPSHOT_SIZE];
+    char line[TELEMETRY_LINE_MAX];
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_BRIDGE_TELEMETRY_PERIOD_MS));
+
+        size_t used = 0;
+        snapshot[0] = '\0';
+        for (int i = 0; i < s_provider_count; i++) {
+            int n = format_line(line, sizeof(line), s_providers[i].name, s_providers[i].fn);
+            if (s_sink != NULL) {
+                s_sink(line);
+            }
+            if (used + n < sizeof(snapshot)) {
+                memcpy(snapshot + used, line, n + 1);
+                used += n;
+            }
+        }
+
+        xSemaphoreTake(s_snapshot_lock, portMAX_DELAY);
+        memcpy(s_snapshot, snapshot, used + 1);
+        xSemaphoreGive(s_snapshot_lock);
+    }
+}
+
+static int cmd_telemetry(int argc, char **argv) {
+    xSemaphoreTake(s_snapshot_lock, portMAX_DELAY);
+    // console_printf() output is bounded, so print line by line.
+    for (const char *l = s_snapshot; *l != '\0';) {
+        const char *end = strchr(l, '\n');
+        int n = end ? end - l + 1 : strlen(l);
+        console_printf("%.*s", n, l);
+        l += n;
+    }
+    xSemaphoreGive(s_snapshot_lock);
+    return 0;
+}
+
+void telemetry_init(void) {
+    s_snapshot_lock = xSemaphoreCreateMutex();
+    xTaskCreate(telemetry_task, "telemetry", 3072, NULL, 2, NULL);
+    console_register("telemetry", "Print the latest telemetry snapshot", cmd_telemetry);
+}
@@ -0,0 +1,29 @@
+/*
+ * Telemetry: periodic "T <name> key=value ..." lines gathered from modules
+ * and pushed to the control channel.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+// Writes "key=value" pairs separated by spaces into buf; returns the length.
+// Called once per period from the telemetry task, so a provider may reset
+// per-period counters when it is read.
+typedef int (*telemetry_fn_t)(char *buf, size_t len);
+
+typedef void (*telemetry_sink_t)(const char *line);
+
+// Registers a provider; call before telemetry_init().
+int telemetry_register(const char *name, telemetry_fn_t fn);
+
+// Formats one line from fn straight away and hands it to the sink, for
+// providers that report faster than the telemetry period. Such providers
+// are not registered, so fn has this caller as its only reader.
+void telemetry_publish(const char *name, telemetry_fn_t fn);
+
+// Receives every telemetry line as it is produced.
+void telemetry_set_sink(telemetry_sink_t sink);
+
+// Starts the collection task and registers the "telemetry" console command.
+void telemetry_init(void);
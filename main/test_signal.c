@@ -0,0 +1,212 @@
+/*
+ * Test signal generator
+ *
+ * Produces 16-bit stereo PCM in blocks of TEST_SIGNAL_BLOCK_FRAMES and pushes
+ * it into the playback buffer with a blocking write, so it runs exactly as fast
+ * as a2d_data_cb consumes. While it runs, data from the TCP sender is dropped
+ * and the play queue waits; it does not start while the queue is playing.
+ * The frame counter is exact, so click positions can be matched against an
+ * output tap capture to measure latency.
+ */
+
+#include "test_signal.h"
+
+#include <math.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "a2d_cadence.h"
+#include "audio_bridge.h"
+#include "bridge_console.h"
+
+static const char *TAG = "TEST_SIGNAL";
+
+#define TEST_SIGNAL_BLOCK_FRAMES    256
+#define SWEEP_START_HZ              20.0f
+#define SWEEP_END_HZ                20000.0f
+#define SWEEP_SECONDS               10
+#define SWEEP_AMPLITUDE             16384.0f    // -6 dBFS
+#define PINK_AMPLITUDE              6000.0f
+#define CLICK_PERIOD_FRAMES         (AUDIO_SAMPLE_RATE / 2)
+#define TWO_PI                      6.28318530718f
+
+static volatile test_signal_type_t s_type = TEST_SIGNAL_OFF;
+static TaskHandle_t s_task = NULL;
+
+// Generator task only, read by the console.
+static volatile uint64_t s_frames_generated = 0;
+static volatile uint32_t s_clicks = 0;
+static volatile uint64_t s_last_click_frame = 0;
+
+// --- Generators ---
+typedef struct {
+    float phase;
+    float freq;
+    float ratio;            // Per-sample frequency multiplier
+    uint32_t pos;
+} sweep_state_t;
+
+typedef struct {
+    uint32_t rng;
+    float b[7];             // Paul Kellet's pink filter state
+} pink_state_t;
+
+static void sweep_reset(sweep_state_t *st) {
+    st->phase = 0.0f;
+    st->freq = SWEEP_START_HZ;
+    st->ratio = powf(SWEEP_END_HZ / SWEEP_START_HZ, 1.0f / (SWEEP_SECONDS * AUDIO_SAMPLE_RATE));
+    st->pos = 0;
+}
+
+static void sweep_fill(sweep_state_t *st, int16_t *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        int16_t s = (int16_t)(SWEEP_AMPLITUDE * sinf(st->phase));
+        out[2 * i] = s;
+        out[2 * i + 1] = s;
+        st->phase += TWO_PI * st->freq / AUDIO_SAMPLE_RATE;
+        if (st->phase >= TWO_PI) {
+            st->phase -= TWO_PI;
+        }
+        st->freq *= st->ratio;
+        if (++st->pos >= SWEEP_SECONDS * AUDIO_SAMPLE_RATE) {
+            sweep_reset(st);
+        }
+    }
+}
+
+static void pink_fill(pink_state_t *st, int16_t *out, int frames) {
+    float *b = st->b;
+    for (int i = 0; i < frames; i++) {
+        // xorshift32 white noise in [-1, 1)
+        st->rng ^= st->rng << 13;
+        st->rng ^= st->rng >> 17;
+        st->rng ^= st->rng << 5;
+        float white = (int32_t)st->rng * (1.0f / 2147483648.0f);
+
+        b[0] = 0.99886f * b[0] + white * 0.0555179f;
+        b[1] = 0.99332f * b[1] + white * 0.0750759f;
+        b[2] = 0.96900f * b[2] + white * 0.1538520f;
+        b[3] = 0.86650f * b[3] + white * 0.3104856f;
+        b[4] = 0.55000f * b[4] + white * 0.5329522f;
+        b[5] = -0.7616f * b[5] - white * 0.0168980f;
+        float pink = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + white * 0.5362f;
+        b[6] = white * 0.115926f;
+
+        // The filter has a gain of roughly 4 at its loudest.
+        int16_t s = (int16_t)(pink * (PINK_AMPLITUDE / 4.0f));
+        out[2 * i] = s;
+        out[2 * i + 1] = s;
+    }
+}
+
+static void click_fill(uint64_t first_frame, int16_t *out, int frames) {
+    memset(out, 0, frames * AUDIO_BYTES_PER_FRAME);
+    for (int i = 0; i < frames; i++) {
+        uint64_t frame = first_frame + i;
+        if (frame % CLICK_PERIOD_FRAMES == 0) {
+            out[2 * i] = INT16_MAX;
+            out[2 * i + 1] = INT16_MAX;
+            s_last_click_frame = frame;
+            s_clicks++;
+        }
+    }
+}
+
+static void test_signal_task(void *pvParameters) {
+    static int16_t block[TEST_SIGNAL_BLOCK_FRAMES * AUDIO_CHANNELS];
+    sweep_state_t sweep;
+    pink_state_t pink = { .rng = 0x12345678 };
+    test_signal_type_t running = TEST_SIGNAL_OFF;
+
+    while (1) {
+        test_signal_type_t type = s_type;
+        if (type == TEST_SIGNAL_OFF) {
+            running = TEST_SIGNAL_OFF;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (type != running) {
+            sweep_reset(&sweep);
+            memset(pink.b, 0, sizeof(pink.b));
+            s_frames_generated = 0;
+            s_clicks = 0;
+            running = type;
+        }
+
+        switch (type) {
+            case TEST_SIGNAL_SWEEP:
+                sweep_fill(&sweep, block, TEST_SIGNAL_BLOCK_FRAMES);
+                break;
+            case TEST_SIGNAL_PINK:
+                pink_fill(&pink, block, TEST_SIGNAL_BLOCK_FRAMES);
+                break;
+            case TEST_SIGNAL_CLICK:
+                click_fill(s_frames_generated, block, TEST_SIGNAL_BLOCK_FRAMES);
+                break;
+            default:
+                memset(block, 0, sizeof(block));
+                break;
+        }
+        audio_bridge_write(AUDIO_SOURCE_GENERATOR, block, sizeof(block), portMAX_DELAY);
+        s_frames_generated += TEST_SIGNAL_BLOCK_FRAMES;
+    }
+}
+
+bool test_signal_select(test_signal_type_t type) {
+    if (type == TEST_SIGNAL_OFF) {
+        s_type = type;
+        audio_bridge_release(AUDIO_SOURCE_GENERATOR);
+        return true;
+    }
+    if (!audio_bridge_claim(AUDIO_SOURCE_GENERATOR)) {
+        return false;
+    }
+    s_type = type;
+    // Measure the Bluetooth side from the moment the generator takes over.
+    a2d_cadence_reset();
+    xTaskNotifyGive(s_task);
+    return true;
+}
+
+// --- Console ---
+static const char *const s_type_names[] = {
+    [TEST_SIGNAL_OFF] = "off",
+    [TEST_SIGNAL_SWEEP] = "sweep",
+    [TEST_SIGNAL_PINK] = "pink",
+    [TEST_SIGNAL_CLICK] = "click",
+    [TEST_SIGNAL_SILENCE] = "silence",
+};
+
+static int cmd_gen(int argc, char **argv) {
+    if (argc < 2) {
+        uint64_t frames = s_frames_generated;
+        console_printf("gen %s: %llu frames generated (%.3f s)\n", s_type_names[s_type],
+                       (unsigned long long)frames, (double)frames / AUDIO_SAMPLE_RATE);
+        if (s_type == TEST_SIGNAL_CLICK) {
+            console_printf("  %lu clicks, last at frame %llu\n", (unsigned long)s_clicks,
+                           (unsigned long long)s_last_click_frame);
+        }
+        a2d_cadence_report();
+        console_printf("Usage: gen <sweep|pink|click|silence|off>\n");
+        return 0;
+    }
+    for (int i = 0; i < sizeof(s_type_names) / sizeof(s_type_names[0]); i++) {
+        if (strcmp(argv[1], s_type_names[i]) == 0) {
+            if (!test_signal_select((test_signal_type_t)i)) {
+                console_printf("The play queue is playing; clear it first\n");
+                return -1;
+            }
+            ESP_LOGI(TAG, "Generator %s", s_type_names[i]);
+            return 0;
+        }
+    }
+    console_printf("Unknown signal '%s'\n", argv[1]);
+    return -1;
+}
+
+void test_signal_init(void) {
+    // Same core and just below the TCP server, which it replaces while running.
+    xTaskCreatePinnedToCore(test_signal_task, "test_signal", 3072, NULL, 9, &s_task, 1);
+    console_register("gen", "Test signal instead of TCP: gen <sweep|pink|click|silence|off>", cmd_gen);
+}
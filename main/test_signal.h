@@ -0,0 +1,23 @@
+/*
+ * Test signal generator: feeds the playback buffer in place of the TCP sender
+ * so the Bluetooth side can be measured with the network out of the picture.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef enum {
+    TEST_SIGNAL_OFF,
+    TEST_SIGNAL_SWEEP,      // Exponential sine sweep, 20 Hz to 20 kHz over 10 s
+    TEST_SIGNAL_PINK,       // Pink noise
+    TEST_SIGNAL_CLICK,      // One full-scale sample every 500 ms, for latency
+    TEST_SIGNAL_SILENCE,
+} test_signal_type_t;
+
+// Registers the "gen" console command.
+void test_signal_init(void);
+
+// Starts (or switches) the generator; TEST_SIGNAL_OFF hands back to TCP.
+// Returns false, changing nothing, while the play queue has the buffer.
+bool test_signal_select(test_signal_type_t type);
@@ -0,0 +1,111 @@
+/*
+ * Volume tracking
+ *
+ * AVRCP's absolute volume is owned by the headphones; a source learns of
+ * changes by registering for the volume-changed notification. Each
+ * notification is answered once (interim with the current value, then
+ * changed), so it is registered again after every change. Callbacks run in
+ * the Bluetooth task and only store the value.
+ */
+
+#include "volume.h"
+
+#include <stdlib.h>
+#include "esp_avrc_api.h"
+#include "esp_log.h"
+#include "bridge_console.h"
+
+static const char *TAG = "VOLUME";
+
+// AVRCP transaction labels
+#define VOLUME_TL_CAPS      1
+#define VOLUME_TL_NOTIFY    2
+#define VOLUME_TL_SET       3
+
+static volatile int s_volume = -1;
+static volatile bool s_connected = false;
+static volatile bool s_absolute = false;    // Headphones report volume changes
+
+static void register_notification(void) {
+    esp_avrc_ct_send_register_notification_cmd(VOLUME_TL_NOTIFY, ESP_AVRC_RN_VOLUME_CHANGE, 0);
+}
+
+static void avrc_ct_cb(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param) {
+    switch (event) {
+        case ESP_AVRC_CT_CONNECTION_STATE_EVT:
+            s_connected = param->conn_stat.connected;
+            s_absolute = false;
+            if (s_connected) {
+                esp_avrc_ct_send_get_rn_capabilities_cmd(VOLUME_TL_CAPS);
+            }
+            break;
+        case ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT:
+            if (esp_avrc_rn_evt_bit_mask_operation(ESP_AVRC_BIT_MASK_OP_TEST, &param->get_rn_caps_rsp.evt_set,
+                                                   ESP_AVRC_RN_VOLUME_CHANGE)) {
+                s_absolute = true;
+                register_notification();
+            } else {
+                ESP_LOGI(TAG, "Headphones do not report volume; set it with the volume command");
+            }
+            break;
+        case ESP_AVRC_CT_CHANGE_NOTIFY_EVT:
+            if (param->change_ntf.event_id == ESP_AVRC_RN_VOLUME_CHANGE) {
+                s_volume = param->change_ntf.event_parameter.volume;
+                ESP_LOGI(TAG, "Headphone volume %d", s_volume);
+                register_notification();
+            }
+            break;
+        case ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT:
+            s_volume = param->set_volume_rsp.volume;
+            break;
+        default:
+            break;
+    }
+}
+
+int volume_get(void) {
+    return s_volume;
+}
+
+bool volume_set(int volume) {
+    if (volume < 0) {
+        volume = 0;
+    } else if (volume > VOLUME_MAX) {
+        volume = VOLUME_MAX;
+    }
+    s_volume = volume;
+    if (s_connected && s_absolute) {
+        return esp_avrc_ct_send_set_absolute_volume_cmd(VOLUME_TL_SET, volume) == ESP_OK;
+    }
+    return false;
+}
+
+static int cmd_volume(int argc, char **argv) {
+    if (argc < 2) {
+        int v = s_volume;
+        if (v < 0) {
+            console_printf("volume unknown\n");
+        } else {
+            console_printf("volume %d of %d (%s)\n", v, VOLUME_MAX,
+                           s_absolute ? "reported by the headphones" : "set by command");
+        }
+        return 0;
+    }
+    char *end;
+    long v = strtol(argv[1], &end, 10);
+    if (*end != '\0' || v < 0 || v > VOLUME_MAX) {
+        console_printf("Volume must be from 0 to %d\n", VOLUME_MAX);
+        return -1;
+    }
+    if (!volume_set(v)) {
+        console_printf("Recorded; the headphones do not take absolute volume, so set theirs to match\n");
+    }
+    return 0;
+}
+
+void volume_init(void) {
+    ESP_ERROR_CHECK(esp_avrc_ct_register_callback(avrc_ct_cb));
+    ESP_ERROR_CHECK(esp_avrc_ct_init());
+    console_register("volume", "Playback volume (0-127) for volume-dependent processing: volume [<level>]",
+                     cmd_volume);
+}
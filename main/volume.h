@@ -0,0 +1,24 @@
+/*
+ * Playback volume as the bridge knows it: the headphones' absolute volume
+ * over AVRCP when they report it, otherwise whatever a controller last set
+ * with the "volume" command. Values use AVRCP's 0-127 scale throughout.
+ * The bridge itself never scales the audio; this is for processing that
+ * depends on how loud the listener hears it.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#define VOLUME_MAX  127
+
+// Starts the AVRCP controller and registers the "volume" command. Call
+// after Bluedroid is enabled and before the A2DP source is initialized.
+void volume_init(void);
+
+// Current volume, or -1 until the headphones or a controller report one.
+int volume_get(void);
+
+// Records volume and, if the headphones support absolute volume, asks them
+// to change to it. Returns true if it was sent to the headphones.
+bool volume_set(int volume);
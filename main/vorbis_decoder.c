@@ -0,0 +1,1315 @@
+/*
+ * Vorbis I decoder
+ *
+ * Follows the Vorbis I specification: codebooks with Huffman and VQ lookup,
+ * floor type 1, residue types 0-2, channel coupling, and the fixed-point
+ * IMDCT from imdct.h. Everything after setup is integer arithmetic:
+ *   residue/VQ values       Q(VORBIS_VALUE_BITS)
+ *   floor curve             Q30 (1.0 at 0 dB)
+ *   spectrum                Q(VORBIS_SPECTRUM_BITS)
+ *   time domain / overlap   Q(VORBIS_OUT_BITS), full scale = 1.0
+ *   window and twiddles     Q31
+ * Setup may use floating point once per stream to convert the codebook
+ * floats and build tables.
+ *
+ * Memory comes from the arena passed to vorbis_decoder_create(): permanent
+ * allocations grow up from the bottom, setup scratch grows down from the
+ * top and is released once the setup header has been parsed.
+ *
+ * Floor type 0 is not implemented; no encoder in use since 2002 produces it.
+ */
+
+#include "vorbis_decoder.h"
+
+#include <math.h>
+#include <string.h>
+#include "imdct.h"
+
+#define VORBIS_VALUE_BITS       12
+#define VORBIS_VALUE_LIMIT      (1 << 22)
+#define VORBIS_SPECTRUM_BITS    22
+#define VORBIS_OUT_BITS         23      // 8 bits of headroom above 16-bit PCM
+#define VORBIS_FAST_BITS        8       // Huffman lookup table index width
+#define VORBIS_MAX_FLOOR1_X     65      // 2 + 31 partitions * up to 8 (spec caps at 65)
+#define VORBIS_MAX_MODES        64
+
+// --- Arena ---
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t low;                 // Permanent allocations end here
+    size_t high;                // Setup scratch starts here
+    bool exhausted;             // An allocation has failed
+} arena_t;
+
+static void *arena_alloc(arena_t *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    if (a->high - a->low < n) {
+        a->exhausted = true;
+        return NULL;
+    }
+    void *p = a->base + a->low;
+    a->low += n;
+    memset(p, 0, n);
+    return p;
+}
+
+static void *arena_scratch(arena_t *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    if (a->high - a->low < n) {
+        a->exhausted = true;
+        return NULL;
+    }
+    a->high -= n;
+    return a->base + a->high;
+}
+
+// --- Bit Reading ---
+// Vorbis packs fields least significant bit first.
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t acc;               // Bits above 'avail' are zero
+    int avail;
+    bool eop;                   // Tried to read past the end of the packet
+} bitreader_t;
+
+static void br_init(bitreader_t *br, const uint8_t *data, size_t len) {
+    br->p = data;
+    br->end = data + len;
+    br->acc = 0;
+    br->avail = 0;
+    br->eop = false;
+}
+
+static inline void br_refill(bitreader_t *br) {
+    while (br->avail <= 24 && br->p < br->end) {
+        br->acc |= (uint32_t)*br->p++ << br->avail;
+        br->avail += 8;
+    }
+}
+
+// n <= 24
+static inline uint32_t br_read(bitreader_t *br, int n) {
+    if (br->avail < n) {
+        br_refill(br);
+        if (br->avail < n) {
+            br->eop = true;
+            br->acc = 0;
+            br->avail = 0;
+            return 0;
+        }
+    }
+    uint32_t v = br->acc & ((1u << n) - 1);
+    br->acc >>= n;
+    br->avail -= n;
+    return v;
+}
+
+static uint32_t br_read32(bitreader_t *br, int n) {
+    if (n <= 24) {
+        return br_read(br, n);
+    }
+    uint32_t lo = br_read(br, 16);
+    return lo | (br_read(br, n - 16) << 16);
+}
+
+// The next 32 bits without consuming them; zeros past the end of the packet.
+static inline uint32_t br_peek32(bitreader_t *br) {
+    br_refill(br);
+    uint32_t v = br->acc;
+    if (br->avail < 32 && br->p < br->end) {
+        v |= (uint32_t)*br->p << br->avail;
+    }
+    return v;
+}
+
+static inline void br_skip(bitreader_t *br, int n) {
+    if (n > br->avail) {
+        n -= br->avail;
+        br->acc = 0;
+        br->avail = 0;
+        br_refill(br);
+        if (n > br->avail) {
+            br->eop = true;
+            br->avail = 0;
+            br->acc = 0;
+            return;
+        }
+    }
+    br->acc = n < 32 ? br->acc >> n : 0;
+    br->avail -= n;
+}
+
+static int ilog(uint32_t v) {
+    return v ? 32 - __builtin_clz(v) : 0;
+}
+
+static uint32_t bit_reverse(uint32_t v) {
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+    v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+// --- Setup Structures ---
+typedef struct {
+    uint32_t entries;
+    uint16_t dimensions;
+    uint8_t lookup_type;        // 0: scalar only, 1: lattice, 2: one vector per entry
+    bool sequence_p;
+    uint32_t lookup_values;
+    int32_t *values;            // minimum + multiplicand * delta, Q(VORBIS_VALUE_BITS)
+    uint8_t *lengths;           // Codeword length per entry, 0 if unused
+    uint8_t fast_bits;          // Up to VORBIS_FAST_BITS, no wider than the longest codeword
+    int16_t *fast;              // Entry for the next fast_bits bits, -1 if longer
+    uint32_t sorted_count;      // Codewords longer than fast_bits...
+    uint32_t *sorted_codes;     // ...left-aligned, ascending
+    uint32_t *sorted_entries;
+    int single_entry;           // Only one used entry: it takes no bits
+} codebook_t;
+
+typedef struct {
+    uint8_t partitions;
+    uint8_t partition_class[31];
+    uint8_t class_dims[16];
+    uint8_t class_subclasses[16];
+    uint8_t class_masterbook[16];
+    int16_t subclass_books[16][8];
+    uint8_t multiplier;
+    uint8_t values;
+    uint16_t x[VORBIS_MAX_FLOOR1_X];
+    uint8_t sorted[VORBIS_MAX_FLOOR1_X];        // Indices in increasing x
+    uint8_t low[VORBIS_MAX_FLOOR1_X];           // low_neighbor()
+    uint8_t high[VORBIS_MAX_FLOOR1_X];          // high_neighbor()
+} floor1_t;
+
+typedef struct {
+    uint8_t type;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t partition_size;
+    uint8_t classifications;
+    uint8_t classbook;
+    int16_t (*books)[8];        // Per classification and pass, -1 if unused
+} residue_t;
+
+typedef struct {
+    uint8_t submaps;
+    uint16_t coupling_steps;
+    uint8_t *magnitude;
+    uint8_t *angle;
+    uint8_t mux[VORBIS_MAX_CHANNELS];
+    uint8_t submap_floor[16];
+    uint8_t submap_residue[16];
+} mapping_t;
+
+typedef struct {
+    bool blockflag;
+    uint8_t mapping;
+} block_mode_t;
+
+struct vorbis_decoder {
+    arena_t arena;
+    size_t arena_base;          // First byte after this struct
+    int stage;                  // Header packets accepted so far (3: audio)
+
+    int channels;
+    uint32_t rate;
+    int blocksize[2];
+
+    int codebook_count;
+    codebook_t *codebooks;
+    int floor_count;
+    floor1_t *floors;
+    int residue_count;
+    residue_t *residues;
+    int mapping_count;
+    mapping_t *mappings;
+    int mode_count;
+    int mode_bits;
+    block_mode_t modes[VORBIS_MAX_MODES];
+
+    // Per packet state
+    int32_t *spectrum[VORBIS_MAX_CHANNELS];     // blocksize[1] / 2 each
+    int32_t *overlap[VORBIS_MAX_CHANNELS];      // Windowed second half of the previous block
+    int16_t *floor_y[VORBIS_MAX_CHANNELS];      // Unpacked floor 1 amplitudes
+    uint8_t *classifications;                   // Residue scratch
+    size_t classifications_stride;
+    int32_t *work;                              // blocksize[1] / 2: transform scratch
+    int16_t *pcm;
+    int32_t *window[2];                         // Rising slope for each block size, Q31
+    imdct_t imdct;
+    int prev_blocksize;                         // 0 before the first audio packet
+    bool prev_long_window;                      // Right slope of the previous block was long
+};
+
+// --- Decoder Lifetime ---
+vorbis_decoder_t *vorbis_decoder_create(void *mem, size_t size) {
+    size_t self = (sizeof(vorbis_decoder_t) + 7) & ~(size_t)7;
+    if (size < self) {
+        return NULL;
+    }
+    vorbis_decoder_t *dec = mem;
+    memset(dec, 0, sizeof(*dec));
+    dec->arena.base = mem;
+    dec->arena.size = size;
+    dec->arena_base = self;
+    vorbis_decoder_reset(dec);
+    return dec;
+}
+
+void vorbis_decoder_reset(vorbis_decoder_t *dec) {
+    arena_t arena = dec->arena;
+    size_t base = dec->arena_base;
+    memset(dec, 0, sizeof(*dec));
+    dec->arena = arena;
+    dec->arena.low = base;
+    dec->arena.high = arena.size;
+    dec->arena.exhausted = false;
+    dec->arena_base = base;
+}
+
+void vorbis_decoder_restart(vorbis_decoder_t *dec) {
+    dec->prev_blocksize = 0;
+    dec->prev_long_window = false;
+}
+
+bool vorbis_ready(const vorbis_decoder_t *dec) {
+    return dec->stage == 3;
+}
+
+int vorbis_channels(const vorbis_decoder_t *dec) {
+    return dec->channels;
+}
+
+uint32_t vorbis_sample_rate(const vorbis_decoder_t *dec) {
+    return dec->rate;
+}
+
+size_t vorbis_arena_used(const vorbis_decoder_t *dec) {
+    return dec->arena.low;
+}
+
+// --- Codebooks ---
+static double float32_unpack(uint32_t x) {
+    double mantissa = x & 0x1FFFFF;
+    int exponent = (x & 0x7FE00000) >> 21;
+    return ldexp((x & 0x80000000u) ? -mantissa : mantissa, exponent - 788);
+}
+
+// Largest r with r^dims <= entries.
+static uint32_t lookup1_values(uint32_t entries, int dims) {
+    uint32_t r = (uint32_t)floor(exp(log((double)entries) / dims));
+    while (pow(r + 1, dims) <= entries) {
+        r++;
+    }
+    while (r > 0 && pow(r, dims) > entries) {
+        r--;
+    }
+    return r;
+}
+
+// Assigns codewords in entry order as the specification requires: each entry
+// takes the lowest free codeword of its length.
+static bool assign_codewords(const uint8_t *lengths, uint32_t entries, uint32_t *codes) {
+    uint32_t marker[33] = { 0 };
+    for (uint32_t i = 0; i < entries; i++) {
+        int len = lengths[i];
+        if (len == 0) {
+            continue;
+        }
+        uint32_t entry = marker[len];
+        if (len < 32 && (entry >> len) != 0) {
+            return false;       // Overspecified tree
+        }
+        codes[i] = entry;
+
+        for (int j = len; j > 0; j--) {
+            if (marker[j] & 1) {
+                marker[j] = j == 1 ? marker[1] + 1 : marker[j - 1] << 1;
+                break;
+            }
+            marker[j]++;
+        }
+        for (int j = len + 1; j < 33; j++) {
+            if ((marker[j] >> 1) == entry) {
+                entry = marker[j];
+                marker[j] = marker[j - 1] << 1;
+            } else {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+static bool build_huffman(arena_t *a, codebook_t *cb) {
+    uint32_t *codes = arena_scratch(a, cb->entries * sizeof(uint32_t));
+    if (codes == NULL) {
+        return false;
+    }
+    uint32_t used = 0;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < cb->entries; i++) {
+        if (cb->lengths[i]) {
+            used++;
+            last = i;
+        }
+    }
+    cb->single_entry = -1;
+    if (used == 1) {
+        cb->single_entry = last;
+        return true;
+    }
+    if (!assign_codewords(cb->lengths, cb->entries, codes)) {
+        return false;
+    }
+
+    int max_len = 0;
+    for (uint32_t i = 0; i < cb->entries; i++) {
+        if (cb->lengths[i] > max_len) {
+            max_len = cb->lengths[i];
+        }
+    }
+    cb->fast_bits = cb->entries > INT16_MAX ? 0 : (max_len < VORBIS_FAST_BITS ? max_len : VORBIS_FAST_BITS);
+    cb->fast = arena_alloc(a, (1 << cb->fast_bits) * sizeof(int16_t));
+    if (cb->fast == NULL) {
+        return false;
+    }
+    memset(cb->fast, 0xFF, (1 << cb->fast_bits) * sizeof(int16_t));
+    cb->sorted_count = 0;
+    for (uint32_t i = 0; i < cb->entries; i++) {
+        int len = cb->lengths[i];
+        if (len == 0) {
+            continue;
+        }
+        if (len <= cb->fast_bits) {
+            // Stream order: the codeword's first bit is the lowest table bit.
+            uint32_t rev = bit_reverse(codes[i]) >> (32 - len);
+            for (uint32_t j = rev; j < (1u << cb->fast_bits); j += 1u << len) {
+                cb->fast[j] = i;
+            }
+        } else {
+            cb->sorted_count++;
+        }
+    }
+    if (cb->sorted_count == 0) {
+        return true;
+    }
+
+    cb->sorted_codes = arena_alloc(a, cb->sorted_count * sizeof(uint32_t));
+    cb->sorted_entries = arena_alloc(a, cb->sorted_count * sizeof(uint32_t));
+    if (cb->sorted_codes == NULL || cb->sorted_entries == NULL) {
+        return false;
+    }
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < cb->entries; i++) {
+        int len = cb->lengths[i];
+        if (len == 0 || len <= cb->fast_bits) {
+            continue;
+        }
+        // Insertion sort: setup only, and long codewords are a minority.
+        uint32_t code = codes[i] << (32 - len);
+        uint32_t j = n++;
+        while (j > 0 && cb->sorted_codes[j - 1] > code) {
+            cb->sorted_codes[j] = cb->sorted_codes[j - 1];
+            cb->sorted_entries[j] = cb->sorted_entries[j - 1];
+            j--;
+        }
+        cb->sorted_codes[j] = code;
+        cb->sorted_entries[j] = i;
+    }
+    return true;
+}
+
+static bool read_codebook(vorbis_decoder_t *dec, bitreader_t *br, codebook_t *cb) {
+    arena_t *a = &dec->arena;
+    if (br_read(br, 24) != 0x564342) {
+        return false;
+    }
+    cb->dimensions = br_read(br, 16);
+    cb->entries = br_read(br, 24);
+    if (cb->dimensions == 0 || cb->entries == 0) {
+        return false;
+    }
+    cb->lengths = arena_alloc(a, cb->entries);
+    if (cb->lengths == NULL) {
+        return false;
+    }
+
+    if (br_read(br, 1)) {
+        // Ordered: runs of entries with increasing lengths.
+        uint32_t entry = 0;
+        int len = br_read(br, 5) + 1;
+        while (entry < cb->entries) {
+            uint32_t count = br_read(br, ilog(cb->entries - entry));
+            if (entry + count > cb->entries || len > 32) {
+                return false;
+            }
+            memset(cb->lengths + entry, len, count);
+            entry += count;
+            len++;
+        }
+    } else {
+        bool sparse = br_read(br, 1);
+        for (uint32_t i = 0; i < cb->entries; i++) {
+            if (!sparse || br_read(br, 1)) {
+                cb->lengths[i] = br_read(br, 5) + 1;
+            }
+        }
+    }
+
+    cb->lookup_type = br_read(br, 4);
+    if (cb->lookup_type == 1 || cb->lookup_type == 2) {
+        double minimum = float32_unpack(br_read32(br, 32));
+        double delta = float32_unpack(br_read32(br, 32));
+        int value_bits = br_read(br, 4) + 1;
+        cb->sequence_p = br_read(br, 1);
+        cb->lookup_values = cb->lookup_type == 1 ? lookup1_values(cb->entries, cb->dimensions) :
+                                                   cb->entries * cb->dimensions;
+        cb->values = arena_alloc(a, cb->lookup_values * sizeof(int32_t));
+        if (cb->values == NULL) {
+            return false;
+        }
+        for (uint32_t i = 0; i < cb->lookup_values; i++) {
+            // Real books stay within a few hundred; the clamp keeps residue
+            // sums of a malicious one from overflowing.
+            double v = (minimum + br_read(br, value_bits) * delta) * (1 << VORBIS_VALUE_BITS);
+            v = v > VORBIS_VALUE_LIMIT ? VORBIS_VALUE_LIMIT : (v < -VORBIS_VALUE_LIMIT ? -VORBIS_VALUE_LIMIT : v);
+            cb->values[i] = (int32_t)lrint(v);
+        }
+    } else if (cb->lookup_type != 0) {
+        return false;
+    }
+    return !br->eop && build_huffman(a, cb);
+}
+
+// Returns the entry number, or -1 at the end of the packet or on a codeword
+// that is not in the book.
+static int32_t decode_scalar(const codebook_t *cb, bitreader_t *br) {
+    if (cb->single_entry >= 0) {
+        return cb->single_entry;
+    }
+    uint32_t bits = br_peek32(br);
+    int32_t entry = cb->fast[bits & ((1u << cb->fast_bits) - 1)];
+    if (entry < 0) {
+        // Largest left-aligned codeword not above the upcoming bits is the
+        // only one that can be their prefix.
+        uint32_t v = bit_reverse(bits);
+        uint32_t lo = 0;
+        uint32_t hi = cb->sorted_count;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (cb->sorted_codes[mid] <= v) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        if (cb->sorted_count == 0 || cb->sorted_codes[lo] > v) {
+            br->eop = true;
+            return -1;
+        }
+        entry = cb->sorted_entries[lo];
+        int len = cb->lengths[entry];
+        if (((v ^ cb->sorted_codes[lo]) >> (32 - len)) != 0) {
+            br->eop = true;
+            return -1;
+        }
+    }
+    br_skip(br, cb->lengths[entry]);
+    return br->eop ? -1 : entry;
+}
+
+// Writes the VQ vector of entry to out[0..dimensions).
+static void entry_vector(const codebook_t *cb, uint32_t entry, int32_t *out) {
+    int32_t last = 0;
+    if (cb->lookup_type == 1) {
+        uint32_t q = entry;
+        for (int d = 0; d < cb->dimensions; d++) {
+            int32_t v = cb->values[q % cb->lookup_values] + last;
+            q /= cb->lookup_values;
+            out[d] = v;
+            if (cb->sequence_p) {
+                last = v;
+            }
+        }
+    } else {
+        const int32_t *row = cb->values + entry * cb->dimensions;
+        for (int d = 0; d < cb->dimensions; d++) {
+            int32_t v = row[d] + last;
+            out[d] = v;
+            if (cb->sequence_p) {
+                last = v;
+            }
+        }
+    }
+}
+
+// --- Floor 1 Setup ---
+static bool read_floor1(vorbis_decoder_t *dec, bitreader_t *br, floor1_t *f) {
+    int max_class = -1;
+    f->partitions = br_read(br, 5);
+    for (int i = 0; i < f->partitions; i++) {
+        f->partition_class[i] = br_read(br, 4);
+        if (f->partition_class[i] > max_class) {
+            max_class = f->partition_class[i];
+        }
+    }
+    for (int c = 0; c <= max_class; c++) {
+        f->class_dims[c] = br_read(br, 3) + 1;
+        f->class_subclasses[c] = br_read(br, 2);
+        if (f->class_subclasses[c]) {
+            f->class_masterbook[c] = br_read(br, 8);
+            if (f->class_masterbook[c] >= dec->codebook_count) {
+                return false;
+            }
+        }
+        for (int j = 0; j < (1 << f->class_subclasses[c]); j++) {
+            f->subclass_books[c][j] = (int16_t)br_read(br, 8) - 1;
+            if (f->subclass_books[c][j] >= dec->codebook_count) {
+                return false;
+            }
+        }
+    }
+    f->multiplier = br_read(br, 2) + 1;
+    int range_bits = br_read(br, 4);
+    f->x[0] = 0;
+    f->x[1] = 1 << range_bits;
+    f->values = 2;
+    for (int i = 0; i < f->partitions; i++) {
+        int c = f->partition_class[i];
+        for (int j = 0; j < f->class_dims[c]; j++) {
+            if (f->values >= VORBIS_MAX_FLOOR1_X) {
+                return false;
+            }
+            f->x[f->values++] = br_read(br, range_bits);
+        }
+    }
+
+    // Sort order and neighbours depend only on x, so they are set up once.
+    for (int i = 0; i < f->values; i++) {
+        f->sorted[i] = i;
+    }
+    for (int i = 1; i < f->values; i++) {
+        for (int j = i; j > 0 && f->x[f->sorted[j - 1]] > f->x[f->sorted[j]]; j--) {
+            uint8_t t = f->sorted[j];
+            f->sorted[j] = f->sorted[j - 1];
+            f->sorted[j - 1] = t;
+        }
+    }
+    for (int i = 2; i < f->values; i++) {
+        int lo = 0;
+        int hi = 1;
+        for (int j = 0; j < i; j++) {
+            if (f->x[j] < f->x[i] && f->x[j] > f->x[lo]) {
+                lo = j;
+            }
+            if (f->x[j] > f->x[i] && f->x[j] < f->x[hi]) {
+                hi = j;
+            }
+        }
+        f->low[i] = lo;
+        f->high[i] = hi;
+    }
+    return true;
+}
+
+// --- Residue and Mapping Setup ---
+static bool read_residue(vorbis_decoder_t *dec, bitreader_t *br, residue_t *r) {
+    r->type = br_read(br, 16);
+    if (r->type > 2) {
+        return false;
+    }
+    r->begin = br_read(br, 24);
+    r->end = br_read(br, 24);
+    r->partition_size = br_read(br, 24) + 1;
+    r->classifications = br_read(br, 6) + 1;
+    r->classbook = br_read(br, 8);
+    if (r->classbook >= dec->codebook_count) {
+        return false;
+    }
+    uint8_t cascade[64];
+    for (int i = 0; i < r->classifications; i++) {
+        int low = br_read(br, 3);
+        int high = br_read(br, 1) ? br_read(br, 5) : 0;
+        cascade[i] = high * 8 + low;
+    }
+    r->books = arena_alloc(&dec->arena, r->classifications * sizeof(*r->books));
+    if (r->books == NULL) {
+        return false;
+    }
+    for (int i = 0; i < r->classifications; i++) {
+        for (int j = 0; j < 8; j++) {
+            r->books[i][j] = -1;
+            if (cascade[i] & (1 << j)) {
+                r->books[i][j] = br_read(br, 8);
+                if (r->books[i][j] >= dec->codebook_count ||
+                    dec->codebooks[r->books[i][j]].lookup_type == 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool read_mapping(vorbis_decoder_t *dec, bitreader_t *br, mapping_t *m) {
+    if (br_read(br, 16) != 0) {
+        return false;
+    }
+    m->submaps = br_read(br, 1) ? br_read(br, 4) + 1 : 1;
+    if (br_read(br, 1)) {
+        m->coupling_steps = br_read(br, 8) + 1;
+        m->magnitude = arena_alloc(&dec->arena, m->coupling_steps);
+        m->angle = arena_alloc(&dec->arena, m->coupling_steps);
+        if (m->magnitude == NULL || m->angle == NULL) {
+            return false;
+        }
+        int bits = ilog(dec->channels - 1);
+        for (int i = 0; i < m->coupling_steps; i++) {
+            m->magnitude[i] = br_read(br, bits);
+            m->angle[i] = br_read(br, bits);
+            if (m->magnitude[i] == m->angle[i] || m->magnitude[i] >= dec->channels ||
+                m->angle[i] >= dec->channels) {
+                return false;
+            }
+        }
+    }
+    if (br_read(br, 2) != 0) {
+        return false;
+    }
+    for (int ch = 0; ch < dec->channels; ch++) {
+        m->mux[ch] = m->submaps > 1 ? br_read(br, 4) : 0;
+        if (m->mux[ch] >= m->submaps) {
+            return false;
+        }
+    }
+    for (int i = 0; i < m->submaps; i++) {
+        br_read(br, 8);         // Unused time configuration
+        m->submap_floor[i] = br_read(br, 8);
+        m->submap_residue[i] = br_read(br, 8);
+        if (m->submap_floor[i] >= dec->floor_count || m->submap_residue[i] >= dec->residue_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Transform Tables ---
+static int32_t q31(double x) {
+    double v = x * 2147483648.0;
+    return v >= 2147483647.0 ? INT32_MAX : (int32_t)lrint(v);
+}
+
+static bool build_tables(vorbis_decoder_t *dec) {
+    arena_t *a = &dec->arena;
+    int32_t *sine = arena_alloc(a, IMDCT_TABLE_LEN(dec->blocksize[1]) * sizeof(int32_t));
+    if (sine == NULL) {
+        return false;
+    }
+    imdct_init(&dec->imdct, sine, dec->blocksize[1]);
+
+    // Rising half of the Vorbis window for each block size:
+    // sin(pi/2 * sin^2((i + 0.5) / n * pi)) over the first n/2 samples.
+    for (int b = 0; b < 2; b++) {
+        int half = dec->blocksize[b] / 2;
+        dec->window[b] = arena_alloc(a, half * sizeof(int32_t));
+        if (dec->window[b] == NULL) {
+            return false;
+        }
+        for (int i = 0; i < half; i++) {
+            double s = sin((i + 0.5) / half * M_PI / 2);
+            dec->window[b][i] = q31(sin(M_PI / 2 * s * s));
+        }
+    }
+
+    int half = dec->blocksize[1] / 2;
+    for (int ch = 0; ch < dec->channels; ch++) {
+        dec->spectrum[ch] = arena_alloc(a, half * sizeof(int32_t));
+        dec->overlap[ch] = arena_alloc(a, half * sizeof(int32_t));
+        dec->floor_y[ch] = arena_alloc(a, VORBIS_MAX_FLOOR1_X * sizeof(int16_t));
+        if (dec->spectrum[ch] == NULL || dec->overlap[ch] == NULL || dec->floor_y[ch] == NULL) {
+            return false;
+        }
+    }
+    dec->work = arena_alloc(a, half * sizeof(int32_t));
+    dec->pcm = arena_alloc(a, half * dec->channels * sizeof(int16_t));
+    return dec->work != NULL && dec->pcm != NULL;
+}
+
+// --- Header Packets ---
+static int read_identification(vorbis_decoder_t *dec, bitreader_t *br) {
+    if (br_read32(br, 32) != 0) {
+        return VORBIS_ERR_HEADER;
+    }
+    dec->channels = br_read(br, 8);
+    dec->rate = br_read32(br, 32);
+    br_read32(br, 32);          // Bitrate maximum, nominal, minimum
+    br_read32(br, 32);
+    br_read32(br, 32);
+    int b0 = br_read(br, 4);
+    int b1 = br_read(br, 4);
+    if (br_read(br, 1) != 1 || br->eop || dec->rate == 0 || dec->channels == 0 ||
+        b0 < 6 || b1 > 13 || b0 > b1) {
+        return VORBIS_ERR_HEADER;
+    }
+    if (dec->channels > VORBIS_MAX_CHANNELS) {
+        return VORBIS_ERR_UNSUPPORTED;
+    }
+    dec->blocksize[0] = 1 << b0;
+    dec->blocksize[1] = 1 << b1;
+    return VORBIS_OK;
+}
+
+// A setup failure is a memory problem if any allocation ran out of arena.
+static int setup_error(const vorbis_decoder_t *dec) {
+    return dec->arena.exhausted ? VORBIS_ERR_MEMORY : VORBIS_ERR_HEADER;
+}
+
+static int read_setup(vorbis_decoder_t *dec, bitreader_t *br) {
+    arena_t *a = &dec->arena;
+
+    dec->codebook_count = br_read(br, 8) + 1;
+    dec->codebooks = arena_alloc(a, dec->codebook_count * sizeof(codebook_t));
+    if (dec->codebooks == NULL) {
+        return setup_error(dec);
+    }
+    for (int i = 0; i < dec->codebook_count; i++) {
+        if (!read_codebook(dec, br, &dec->codebooks[i])) {
+            return setup_error(dec);
+        }
+        a->high = a->size;      // Codeword scratch is only needed per book
+    }
+
+    int time_count = br_read(br, 6) + 1;
+    for (int i = 0; i < time_count; i++) {
+        if (br_read(br, 16) != 0) {
+            return setup_error(dec);
+        }
+    }
+
+    dec->floor_count = br_read(br, 6) + 1;
+    dec->floors = arena_alloc(a, dec->floor_count * sizeof(floor1_t));
+    if (dec->floors == NULL) {
+        return setup_error(dec);
+    }
+    for (int i = 0; i < dec->floor_count; i++) {
+        int type = br_read(br, 16);
+        if (type == 0) {
+            return VORBIS_ERR_UNSUPPORTED;
+        }
+        if (type != 1 || !read_floor1(dec, br, &dec->floors[i])) {
+            return setup_error(dec);
+        }
+    }
+
+    dec->residue_count = br_read(br, 6) + 1;
+    dec->residues = arena_alloc(a, dec->residue_count * sizeof(residue_t));
+    if (dec->residues == NULL) {
+        return setup_error(dec);
+    }
+    size_t max_partitions = 0;
+    for (int i = 0; i < dec->residue_count; i++) {
+        residue_t *r = &dec->residues[i];
+        if (!read_residue(dec, br, r)) {
+            return setup_error(dec);
+        }
+        uint32_t size = dec->blocksize[1] / 2 * (r->type == 2 ? dec->channels : 1);
+        uint32_t begin = r->begin < size ? r->begin : size;
+        uint32_t end = r->end < size ? r->end : size;
+        size_t partitions = end > begin ? (end - begin) / r->partition_size : 0;
+        partitions += dec->codebooks[r->classbook].dimensions;
+        if (partitions > max_partitions) {
+            max_partitions = partitions;
+        }
+    }
+    dec->classifications_stride = max_partitions;
+    dec->classifications = arena_alloc(a, max_partitions * dec->channels);
+    if (dec->classifications == NULL) {
+        return setup_error(dec);
+    }
+
+    dec->mapping_count = br_read(br, 6) + 1;
+    dec->mappings = arena_alloc(a, dec->mapping_count * sizeof(mapping_t));
+    if (dec->mappings == NULL) {
+        return setup_error(dec);
+    }
+    for (int i = 0; i < dec->mapping_count; i++) {
+        if (!read_mapping(dec, br, &dec->mappings[i])) {
+            return setup_error(dec);
+        }
+    }
+
+    dec->mode_count = br_read(br, 6) + 1;
+    for (int i = 0; i < dec->mode_count; i++) {
+        dec->modes[i].blockflag = br_read(br, 1);
+        int window = br_read(br, 16);
+        int transform = br_read(br, 16);
+        dec->modes[i].mapping = br_read(br, 8);
+        if (window != 0 || transform != 0 || dec->modes[i].mapping >= dec->mapping_count) {
+            return setup_error(dec);
+        }
+    }
+    dec->mode_bits = ilog(dec->mode_count - 1);
+    if (br_read(br, 1) != 1 || br->eop) {
+        return setup_error(dec);
+    }
+    return build_tables(dec) ? VORBIS_OK : setup_error(dec);
+}
+
+static int decode_header(vorbis_decoder_t *dec, const uint8_t *packet, size_t len) {
+    static const uint8_t types[3] = { 1, 3, 5 };
+    if (dec->stage == 1 && packet[0] == 5) {
+        // The comment header carries nothing we use, and one inflated by
+        // cover art may have been dropped as too long for the packet buffer.
+        dec->stage = 2;
+    }
+    if (len < 7 || packet[0] != types[dec->stage] || memcmp(packet + 1, "vorbis", 6) != 0) {
+        return VORBIS_ERR_HEADER;
+    }
+    bitreader_t br;
+    br_init(&br, packet + 7, len - 7);
+    int ret = VORBIS_OK;
+    if (dec->stage == 0) {
+        ret = read_identification(dec, &br);
+    } else if (dec->stage == 2) {
+        ret = read_setup(dec, &br);
+    }
+    if (ret == VORBIS_OK) {
+        dec->stage++;
+    }
+    return ret;
+}
+
+// --- Floor 1 Decode ---
+static const uint16_t s_floor1_range[4] = { 256, 128, 86, 64 };
+
+// Reads the amplitudes; returns false if the floor is unused this packet.
+static bool floor1_decode(vorbis_decoder_t *dec, const floor1_t *f, bitreader_t *br, int16_t *y) {
+    if (!br_read(br, 1)) {
+        return false;
+    }
+    int range = s_floor1_range[f->multiplier - 1];
+    int bits = ilog(range - 1);
+    y[0] = br_read(br, bits);
+    y[1] = br_read(br, bits);
+    int offset = 2;
+    for (int i = 0; i < f->partitions; i++) {
+        int c = f->partition_class[i];
+        int cdim = f->class_dims[c];
+        int cbits = f->class_subclasses[c];
+        int csub = (1 << cbits) - 1;
+        int32_t cval = 0;
+        if (cbits > 0) {
+            cval = decode_scalar(&dec->codebooks[f->class_masterbook[c]], br);
+            if (cval < 0) {
+                return false;
+            }
+        }
+        for (int j = 0; j < cdim; j++) {
+            int book = f->subclass_books[c][cval & csub];
+            cval >>= cbits;
+            int32_t v = 0;
+            if (book >= 0) {
+                v = decode_scalar(&dec->codebooks[book], br);
+                if (v < 0) {
+                    return false;
+                }
+            }
+            y[offset++] = v;
+        }
+    }
+    return !br->eop;
+}
+
+static int render_point(int x0, int y0, int x1, int y1, int x) {
+    int dy = y1 - y0;
+    int adx = x1 - x0;
+    int off = (dy < 0 ? -dy : dy) * (x - x0) / adx;
+    return dy < 0 ? y0 - off : y0 + off;
+}
+
+static int32_t s_floor1_db[256];    // Inverse dB table, Q30
+
+static void floor1_build_db_table(void) {
+    if (s_floor1_db[255] != 0) {
+        return;
+    }
+    // Geometric from 1.0649863e-07 (-139.5 dB) up to 1.0, as tabulated in the spec.
+    for (int i = 0; i < 256; i++) {
+        s_floor1_db[i] = (int32_t)lrint(pow(1.0649863e-07, (255 - i) / 255.0) * (1 << 30));
+    }
+}
+
+static inline int32_t saturate32(int64_t v) {
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int32_t)v);
+}
+
+static inline void floor_scale(int32_t *v, int x, int y) {
+    int64_t p = (int64_t)v[x] * s_floor1_db[y > 255 ? 255 : (y < 0 ? 0 : y)];
+    v[x] = saturate32(p >> (VORBIS_VALUE_BITS + 30 - VORBIS_SPECTRUM_BITS));
+}
+
+// Bresenham-style line from the specification, applied multiplicatively
+// to the residue in v[x0..x1) (clipped to n).
+static void render_line(int x0, int y0, int x1, int y1, int32_t *v, int n) {
+    int dy = y1 - y0;
+    int adx = x1 - x0;
+    int ady = dy < 0 ? -dy : dy;
+    int base = dy / adx;
+    int sy = dy < 0 ? base - 1 : base + 1;
+    int y = y0;
+    int err = 0;
+    ady -= (base < 0 ? -base : base) * adx;
+    if (x1 > n) {
+        x1 = n;
+    }
+    if (x0 < x1) {
+        floor_scale(v, x0, y);
+    }
+    for (int x = x0 + 1; x < x1; x++) {
+        err += ady;
+        if (err >= adx) {
+            err -= adx;
+            y += sy;
+        } else {
+            y += base;
+        }
+        floor_scale(v, x, y);
+    }
+}
+
+// Turns the amplitudes into the curve and multiplies it into the spectrum.
+static void floor1_apply(const floor1_t *f, const int16_t *y, int32_t *v, int n) {
+    int range = s_floor1_range[f->multiplier - 1];
+    int16_t final_y[VORBIS_MAX_FLOOR1_X];
+    bool step2[VORBIS_MAX_FLOOR1_X];
+
+    final_y[0] = y[0];
+    final_y[1] = y[1];
+    step2[0] = step2[1] = true;
+    for (int i = 2; i < f->values; i++) {
+        int lo = f->low[i];
+        int hi = f->high[i];
+        int predicted = render_point(f->x[lo], final_y[lo], f->x[hi], final_y[hi], f->x[i]);
+        int val = y[i];
+        int highroom = range - predicted;
+        int lowroom = predicted;
+        int room = (highroom < lowroom ? highroom : lowroom) * 2;
+        if (val != 0) {
+            step2[lo] = step2[hi] = step2[i] = true;
+            if (val >= room) {
+                final_y[i] = highroom > lowroom ? val - lowroom + predicted : predicted - val + highroom - 1;
+            } else {
+                final_y[i] = (val & 1) ? predicted - (val + 1) / 2 : predicted + val / 2;
+            }
+        } else {
+            step2[i] = false;
+            final_y[i] = predicted;
+        }
+    }
+
+    int lx = 0;
+    int ly = final_y[f->sorted[0]] * f->multiplier;
+    for (int j = 1; j < f->values; j++) {
+        int i = f->sorted[j];
+        if (step2[i]) {
+            int hy = final_y[i] * f->multiplier;
+            int hx = f->x[i];
+            if (hx > lx) {
+                render_line(lx, ly, hx, hy, v, n);
+            }
+            lx = hx;
+            ly = hy;
+        }
+    }
+    if (lx < n) {
+        render_line(lx, ly, n, ly, v, n);
+    }
+}
+
+// --- Residue Decode ---
+// Adds the vector of one VQ codeword per 'dimensions' positions into the
+// channel vectors. Positions index the (possibly interleaved) residue vector.
+static bool residue_partition(const codebook_t *cb, bitreader_t *br, int type,
+                              int32_t **vectors, int nvec, uint32_t offset, uint32_t size) {
+    int32_t vals[16];
+    int dims = cb->dimensions;
+    if (dims > 16) {
+        return false;
+    }
+    if (type == 0) {
+        uint32_t step = size / dims;
+        for (uint32_t i = 0; i < step; i++) {
+            int32_t e = decode_scalar(cb, br);
+            if (e < 0) {
+                return false;
+            }
+            entry_vector(cb, e, vals);
+            for (int j = 0; j < dims; j++) {
+                vectors[0][offset + i + j * step] += vals[j];
+            }
+        }
+    } else if (type == 1 || nvec == 1) {
+        for (uint32_t i = 0; i < size;) {
+            int32_t e = decode_scalar(cb, br);
+            if (e < 0) {
+                return false;
+            }
+            entry_vector(cb, e, vals);
+            for (int j = 0; j < dims && i < size; j++, i++) {
+                vectors[0][offset + i] += vals[j];
+            }
+        }
+    } else {
+        // Type 2: one vector interleaving all channels.
+        int ch = offset % nvec;
+        uint32_t pos = offset / nvec;
+        for (uint32_t i = 0; i < size;) {
+            int32_t e = decode_scalar(cb, br);
+            if (e < 0) {
+                return false;
+            }
+            entry_vector(cb, e, vals);
+            for (int j = 0; j < dims && i < size; j++, i++) {
+                vectors[ch][pos] += vals[j];
+                if (++ch == nvec) {
+                    ch = 0;
+                    pos++;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void residue_decode(vorbis_decoder_t *dec, const residue_t *r, bitreader_t *br, int32_t **vectors,
+                           const bool *skip, int nvec, int n) {
+    const codebook_t *classbook = &dec->codebooks[r->classbook];
+    int cpc = classbook->dimensions;       // Classifications per classword
+    uint32_t size = n / 2;
+    int lanes = nvec;                      // Independently classified vectors
+
+    if (r->type == 2) {
+        bool any = false;
+        for (int i = 0; i < nvec; i++) {
+            any |= !skip[i];
+        }
+        if (!any) {
+            return;
+        }
+        size *= nvec;
+        lanes = 1;
+    }
+    uint32_t begin = r->begin < size ? r->begin : size;
+    uint32_t end = r->end < size ? r->end : size;
+    uint32_t psize = r->partition_size;
+    uint32_t partitions = end > begin ? (end - begin) / psize : 0;
+    if (partitions == 0) {
+        return;
+    }
+
+    for (int pass = 0; pass < 8; pass++) {
+        uint32_t p = 0;
+        while (p < partitions) {
+            if (pass == 0) {
+                for (int l = 0; l < lanes; l++) {
+                    if (r->type != 2 && skip[l]) {
+                        continue;
+                    }
+                    int32_t temp = decode_scalar(classbook, br);
+                    if (temp < 0) {
+                        return;
+                    }
+                    uint8_t *cls = dec->classifications + l * dec->classifications_stride;
+                    for (int i = cpc - 1; i >= 0; i--) {
+                        cls[p + i] = temp % r->classifications;
+                        temp /= r->classifications;
+                    }
+                }
+            }
+            for (int i = 0; i < cpc && p < partitions; i++, p++) {
+                for (int l = 0; l < lanes; l++) {
+                    if (r->type != 2 && skip[l]) {
+                        continue;
+                    }
+                    int book = r->books[dec->classifications[l * dec->classifications_stride + p]][pass];
+                    if (book < 0) {
+                        continue;
+                    }
+                    int32_t **vec = r->type == 2 ? vectors : &vectors[l];
+                    if (!residue_partition(&dec->codebooks[book], br, r->type, vec,
+                                           r->type == 2 ? nvec : 1, begin + p * psize, psize)) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static inline int32_t mul31(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 31);
+}
+
+// --- Audio Packets ---
+static int decode_audio(vorbis_decoder_t *dec, const uint8_t *packet, size_t len, const int16_t **pcm) {
+    bitreader_t br;
+    br_init(&br, packet, len);
+    if (br_read(&br, 1) != 0) {
+        return VORBIS_ERR_PACKET;
+    }
+    int mode_number = br_read(&br, dec->mode_bits);
+    if (br.eop || mode_number >= dec->mode_count) {
+        return VORBIS_ERR_PACKET;
+    }
+    const block_mode_t *mode = &dec->modes[mode_number];
+    const mapping_t *map = &dec->mappings[mode->mapping];
+    int n = dec->blocksize[mode->blockflag];
+    int half = n / 2;
+    bool prev_long = false;
+    bool next_long = false;
+    if (mode->blockflag) {
+        prev_long = br_read(&br, 1);
+        next_long = br_read(&br, 1);
+    }
+
+    // Floors
+    bool nonzero[VORBIS_MAX_CHANNELS];
+    for (int ch = 0; ch < dec->channels; ch++) {
+        const floor1_t *f = &dec->floors[map->submap_floor[map->mux[ch]]];
+        nonzero[ch] = floor1_decode(dec, f, &br, dec->floor_y[ch]);
+        memset(dec->spectrum[ch], 0, half * sizeof(int32_t));
+    }
+    bool floor_used[VORBIS_MAX_CHANNELS];
+    memcpy(floor_used, nonzero, sizeof(floor_used));
+    for (int i = 0; i < map->coupling_steps; i++) {
+        if (nonzero[map->magnitude[i]] || nonzero[map->angle[i]]) {
+            nonzero[map->magnitude[i]] = nonzero[map->angle[i]] = true;
+        }
+    }
+
+    // Residues, one submap at a time
+    for (int s = 0; s < map->submaps; s++) {
+        int32_t *vectors[VORBIS_MAX_CHANNELS];
+        bool skip[VORBIS_MAX_CHANNELS];
+        int nvec = 0;
+        for (int ch = 0; ch < dec->channels; ch++) {
+            if (map->mux[ch] == s) {
+                vectors[nvec] = dec->spectrum[ch];
+                skip[nvec] = !nonzero[ch];
+                nvec++;
+            }
+        }
+        residue_decode(dec, &dec->residues[map->submap_residue[s]], &br, vectors, skip, nvec, n);
+    }
+
+    // Inverse coupling, last step first
+    for (int i = map->coupling_steps - 1; i >= 0; i--) {
+        int32_t *mag = dec->spectrum[map->magnitude[i]];
+        int32_t *ang = dec->spectrum[map->angle[i]];
+        for (int j = 0; j < half; j++) {
+            int32_t m = mag[j];
+            int32_t a = ang[j];
+            if (m > 0) {
+                if (a > 0) {
+                    ang[j] = m - a;
+                } else {
+                    ang[j] = m;
+                    mag[j] = m + a;
+                }
+            } else {
+                if (a > 0) {
+                    ang[j] = m + a;
+                } else {
+                    ang[j] = m;
+                    mag[j] = m - a;
+                }
+            }
+        }
+    }
+
+    // Floor curves, transform, window and overlap-add
+    int prev = dec->prev_blocksize;
+    int out_frames = prev ? prev / 4 + n / 4 : 0;
+    // Left slope: long only if both this and the previous block are long.
+    int left_n = mode->blockflag && prev_long ? dec->blocksize[1] : dec->blocksize[0];
+    int right_n = mode->blockflag && next_long ? dec->blocksize[1] : dec->blocksize[0];
+    const int32_t *left_w = dec->window[left_n == dec->blocksize[1]];
+    const int32_t *right_w = dec->window[right_n == dec->blocksize[1]];
+    int left_start = n / 4 - left_n / 4;
+    int right_start = n * 3 / 4 - right_n / 4;
+
+    for (int ch = 0; ch < dec->channels; ch++) {
+        int32_t *x = dec->spectrum[ch];
+        if (floor_used[ch]) {
+            floor1_apply(&dec->floors[map->submap_floor[map->mux[ch]]], dec->floor_y[ch], x, half);
+        } else {
+            memset(x, 0, half * sizeof(int32_t));
+        }
+        imdct_folded(&dec->imdct, x, n, VORBIS_SPECTRUM_BITS, VORBIS_OUT_BITS, dec->work);
+
+        int m = half;
+        int32_t *ov = dec->overlap[ch];
+        int16_t *out = dec->pcm + ch;
+        int out_start = n / 4 - prev / 4;
+        for (int j = out_start; j < m; j++) {
+            int32_t y = imdct_sample(x, n, j);
+            if (j < left_start) {
+                y = 0;
+            } else if (j < left_start + left_n / 2) {
+                y = mul31(y, left_w[j - left_start]);
+            }
+            int32_t sum = y;
+            int o = j - out_start;
+            if (o < prev / 2) {
+                sum += ov[o];
+            }
+            if (prev) {
+                int32_t s = (sum + (1 << (VORBIS_OUT_BITS - 16))) >> (VORBIS_OUT_BITS - 15);
+                out[o * dec->channels] = s > INT16_MAX ? INT16_MAX : (s < INT16_MIN ? INT16_MIN : s);
+            }
+        }
+        // Keep the windowed second half for the next block.
+        for (int j = m; j < n; j++) {
+            int32_t y = imdct_sample(x, n, j);
+            if (j >= right_start + right_n / 2) {
+                y = 0;
+            } else if (j >= right_start) {
+                y = mul31(y, right_w[right_n / 2 - 1 - (j - right_start)]);
+            }
+            ov[j - m] = y;
+        }
+    }
+    dec->prev_blocksize = n;
+    *pcm = dec->pcm;
+    return out_frames;
+}
+
+int vorbis_decode_packet(vorbis_decoder_t *dec, const uint8_t *packet, size_t len, const int16_t **pcm) {
+    if (len == 0) {
+        return 0;
+    }
+    if (packet[0] & 1) {
+        // Header packet. An identification header restarts the stream.
+        if (packet[0] == 1 && dec->stage != 0) {
+            vorbis_decoder_reset(dec);
+        }
+        if (dec->stage >= 3) {
+            return VORBIS_ERR_HEADER;
+        }
+        floor1_build_db_table();
+        int ret = decode_header(dec, packet, len);
+        if (ret != VORBIS_OK) {
+            vorbis_decoder_reset(dec);
+        }
+        return ret;
+    }
+    if (dec->stage < 3) {
+        return VORBIS_ERR_HEADER;
+    }
+    return decode_audio(dec, packet, len, pcm);
+}
@@ -0,0 +1,56 @@
+/*
+ * Vorbis I decoder, integer only.
+ *
+ * Takes the packets of one logical stream (see ogg_demux.h) and produces
+ * interleaved 16-bit PCM. All working memory -- codebooks, floors, residue
+ * vectors, transform tables, overlap and output buffers -- is carved out of
+ * one arena handed over at creation, so nothing is allocated per packet and
+ * a stream that needs more than the arena is refused during setup.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VORBIS_MAX_CHANNELS     8
+
+typedef enum {
+    VORBIS_OK = 0,
+    VORBIS_ERR_HEADER = -1,         // Malformed or out-of-order header packet
+    VORBIS_ERR_UNSUPPORTED = -2,    // Legal but not handled here (floor 0)
+    VORBIS_ERR_MEMORY = -3,         // Setup does not fit in the arena
+    VORBIS_ERR_PACKET = -4,         // Bad audio packet; it was skipped
+} vorbis_status_t;
+
+typedef struct vorbis_decoder vorbis_decoder_t;
+
+// Places a decoder in arena (which must stay valid and 8-byte aligned).
+// Returns NULL if arena_size is too small even for the fixed state.
+vorbis_decoder_t *vorbis_decoder_create(void *arena, size_t arena_size);
+
+// Forgets the stream so the next packet must be an identification header,
+// as at the start of a chained Ogg stream.
+void vorbis_decoder_reset(vorbis_decoder_t *dec);
+
+// Keeps the stream's setup but forgets the previous block, for decoding
+// from a new position after a seek: the next audio packet returns no frames
+// and only primes the overlap.
+void vorbis_decoder_restart(vorbis_decoder_t *dec);
+
+// Decodes one packet. Header packets return 0. Audio packets return the
+// number of frames now available through *pcm (interleaved, channels()
+// samples each; valid until the next call), or a vorbis_status_t.
+int vorbis_decode_packet(vorbis_decoder_t *dec, const uint8_t *packet, size_t len, const int16_t **pcm);
+
+// True once all three header packets have been accepted.
+bool vorbis_ready(const vorbis_decoder_t *dec);
+
+int vorbis_channels(const vorbis_decoder_t *dec);
+uint32_t vorbis_sample_rate(const vorbis_decoder_t *dec);
+
+// Arena bytes taken by the current stream's setup.
+size_t vorbis_arena_used(const vorbis_decoder_t *dec);
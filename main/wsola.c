@@ -0,0 +1,211 @@
+/*
+ * WSOLA time stretch
+ *
+ * The nominal position advances by WSOLA_HOP * speed input frames per hop
+ * on its own, so however each hop's search lands the average rate is the
+ * requested one and the offset from nominal never exceeds WSOLA_SEEK.
+ * Starting a hop at the natural continuation (the input right after the
+ * last segment) would match perfectly and make no progress; because the
+ * nominal position keeps moving, that continuation falls outside the
+ * search range after a few hops and a real splice is forced.
+ *
+ * The search correlates the natural continuation with every candidate on
+ * a mono copy decimated by WSOLA_DECIMATE, scored by normalized
+ * correlation, then refines the best one at full rate. That is about
+ * 20 multiply-adds per output frame.
+ */
+
+#include "wsola.h"
+
+#include <math.h>
+#include <string.h>
+
+#define COARSE_LEN      (WSOLA_HOP / WSOLA_DECIMATE)
+#define FINE_REACH      (WSOLA_DECIMATE - 1)
+
+void wsola_init(wsola_t *w) {
+    memset(w, 0, sizeof(*w));
+    for (int i = 0; i < WSOLA_HOP; i++) {
+        w->fade[i] = (int16_t)lrint((0.5 - 0.5 * cos(M_PI * (i + 0.5) / WSOLA_HOP)) * 32767);
+    }
+    w->speed = WSOLA_SPEED_ONE;
+}
+
+void wsola_reset(wsola_t *w) {
+    w->len = 0;
+    w->next = 0;
+    w->nominal = 0;
+    w->speed = WSOLA_SPEED_ONE;
+    w->stretching = false;
+}
+
+void wsola_set_speed(wsola_t *w, int32_t speed) {
+    if (speed < WSOLA_SPEED_ONE - WSOLA_SPEED_RANGE) {
+        speed = WSOLA_SPEED_ONE - WSOLA_SPEED_RANGE;
+    } else if (speed > WSOLA_SPEED_ONE + WSOLA_SPEED_RANGE) {
+        speed = WSOLA_SPEED_ONE + WSOLA_SPEED_RANGE;
+    }
+    w->speed = speed;
+}
+
+// Drops input nothing can reach any more: everything before the search
+// range of the next hop.
+static void compact(wsola_t *w) {
+    int keep = w->next - WSOLA_HISTORY;
+    if (w->stretching) {
+        int lowest = (int)(w->nominal >> 16) - WSOLA_SEEK;
+        keep = lowest < keep ? lowest : keep;
+    }
+    if (keep <= 0) {
+        return;
+    }
+    memmove(w->buf, w->buf + 2 * keep, (size_t)(w->len - keep) * 2 * sizeof(int16_t));
+    w->len -= keep;
+    w->next -= keep;
+    w->nominal -= (int64_t)keep << 16;
+}
+
+size_t wsola_write(wsola_t *w, const int16_t *pcm, size_t frames) {
+    compact(w);
+    size_t room = WSOLA_BUFFER - w->len;
+    size_t n = frames < room ? frames : room;
+    memcpy(w->buf + 2 * w->len, pcm, n * 2 * sizeof(int16_t));
+    w->len += n;
+    return n;
+}
+
+static inline int32_t mono(const wsola_t *w, int frame) {
+    return w->buf[2 * frame] + w->buf[2 * frame + 1];
+}
+
+// Sum of WSOLA_DECIMATE mono frames from frame on.
+static inline int32_t coarse(const wsola_t *w, int frame) {
+    int32_t sum = 0;
+    for (int i = 0; i < WSOLA_DECIMATE; i++) {
+        sum += mono(w, frame + i);
+    }
+    return sum;
+}
+
+static inline float score(int64_t corr, int64_t energy) {
+    if (energy <= 0) {
+        return 0;
+    }
+    float c = (float)corr;
+    return c * fabsf(c) / (float)energy;
+}
+
+// Start of the segment, within WSOLA_SEEK of nominal, that best continues
+// the output.
+static int best_start(wsola_t *w, int nominal) {
+    int first = nominal - WSOLA_SEEK;
+    if (first < 0) {
+        first = 0;
+    }
+    int last = nominal + WSOLA_SEEK;
+
+    // Coarse pass over every WSOLA_DECIMATE-th start.
+    int32_t *tmpl = w->tmpl;
+    int32_t *cand = w->cand;
+    for (int i = 0; i < COARSE_LEN; i++) {
+        tmpl[i] = coarse(w, w->next + i * WSOLA_DECIMATE) >> 3;
+    }
+    int lags = (last - first) / WSOLA_DECIMATE + 1;
+    for (int i = 0; i < COARSE_LEN + lags - 1; i++) {
+        cand[i] = coarse(w, first + i * WSOLA_DECIMATE) >> 3;
+    }
+    int64_t energy = 0;
+    for (int i = 0; i < COARSE_LEN; i++) {
+        energy += (int64_t)cand[i] * cand[i];
+    }
+    int best = first;
+    float best_score = -INFINITY;
+    for (int lag = 0; lag < lags; lag++) {
+        if (lag > 0) {
+            energy += (int64_t)cand[lag + COARSE_LEN - 1] * cand[lag + COARSE_LEN - 1] -
+                      (int64_t)cand[lag - 1] * cand[lag - 1];
+        }
+        int64_t corr = 0;
+        for (int i = 0; i < COARSE_LEN; i++) {
+            corr += (int64_t)tmpl[i] * cand[lag + i];
+        }
+        float s = score(corr, energy);
+        if (s > best_score) {
+            best_score = s;
+            best = first + lag * WSOLA_DECIMATE;
+        }
+    }
+
+    // Fine pass at full rate around it.
+    int centre = best;
+    best_score = -INFINITY;
+    for (int start = centre - FINE_REACH; start <= centre + FINE_REACH; start++) {
+        if (start < first || start > last) {
+            continue;
+        }
+        int64_t corr = 0, e = 0;
+        for (int i = 0; i < WSOLA_HOP; i += 2) {
+            int32_t a = mono(w, w->next + i);
+            int32_t b = mono(w, start + i);
+            corr += (int64_t)a * b;
+            e += (int64_t)b * b;
+        }
+        float s = score(corr, e);
+        if (s > best_score) {
+            best_score = s;
+            best = start;
+        }
+    }
+    return best;
+}
+
+// One hop of WSOLA_HOP frames into out.
+static void hop(wsola_t *w, int16_t *out) {
+    int nominal = (int)((w->nominal + (1 << 15)) >> 16);
+    int start = best_start(w, nominal);
+    const int16_t *from = w->buf + 2 * w->next;
+    const int16_t *to = w->buf + 2 * start;
+    for (int i = 0; i < WSOLA_HOP; i++) {
+        int32_t g = w->fade[i];
+        for (int ch = 0; ch < 2; ch++) {
+            int32_t v = from[2 * i + ch] * (32767 - g) + to[2 * i + ch] * g;
+            out[2 * i + ch] = (int16_t)((v + (1 << 14)) >> 15);
+        }
+    }
+    w->consumed += start + WSOLA_HOP - w->next;
+    w->produced += WSOLA_HOP;
+    w->next = start + WSOLA_HOP;
+    w->nominal += (int64_t)WSOLA_HOP * w->speed;
+    w->hops++;
+}
+
+size_t wsola_read(wsola_t *w, int16_t *out, size_t max) {
+    size_t made = 0;
+    while (made < max) {
+        if (w->speed == WSOLA_SPEED_ONE) {
+            // The natural continuation is seamless, so stretching can stop
+            // between any two hops.
+            w->stretching = false;
+            size_t n = w->len - w->next;
+            n = n < max - made ? n : max - made;
+            memcpy(out + 2 * made, w->buf + 2 * w->next, n * 2 * sizeof(int16_t));
+            w->next += n;
+            w->consumed += n;
+            w->produced += n;
+            made += n;
+            break;
+        }
+        if (!w->stretching) {
+            w->stretching = true;
+            w->nominal = (int64_t)w->next << 16;
+        }
+        int nominal = (int)((w->nominal + (1 << 15)) >> 16);
+        int needed = (nominal + WSOLA_SEEK > w->next ? nominal + WSOLA_SEEK : w->next) + WSOLA_HOP + WSOLA_DECIMATE;
+        if (w->len < needed || max - made < WSOLA_HOP) {
+            break;
+        }
+        hop(w, out + 2 * made);
+        made += WSOLA_HOP;
+    }
+    return made;
+}
@@ -0,0 +1,62 @@
+/*
+ * Pitch-preserving time stretch for 16-bit stereo PCM (WSOLA: waveform
+ * similarity overlap-add), for playing a few percent faster or slower than
+ * real time.
+ *
+ * At speed 1 audio passes straight through with no added delay. Otherwise
+ * output is made in hops of WSOLA_HOP frames: each hop crossfades from the
+ * natural continuation of the last segment to a segment near the nominal
+ * input position, shifted by up to WSOLA_SEEK frames to where the two
+ * waveforms line up best. Stretching needs WSOLA_LOOKAHEAD frames of input
+ * ahead of the output, gathered before the first hop.
+ *
+ * Platform independent: no FreeRTOS or ESP-IDF dependencies.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WSOLA_HOP           512     // Output frames per hop (11.6 ms at 44.1 kHz)
+#define WSOLA_SEEK          128     // Search either side of the nominal position
+#define WSOLA_DECIMATE      4       // Coarse search runs on mono at 1/4 rate
+#define WSOLA_SPEED_ONE     65536   // Speeds are Q16
+#define WSOLA_SPEED_RANGE   (WSOLA_SPEED_ONE / 10)  // Largest departure from 1
+#define WSOLA_LOOKAHEAD     (WSOLA_HOP + WSOLA_SPEED_RANGE * WSOLA_HOP / WSOLA_SPEED_ONE + 1 + 2 * WSOLA_SEEK + WSOLA_DECIMATE)
+#define WSOLA_HISTORY       (WSOLA_SPEED_RANGE * WSOLA_HOP / WSOLA_SPEED_ONE + 1 + 2 * WSOLA_SEEK)
+#define WSOLA_BUFFER        (WSOLA_HISTORY + WSOLA_LOOKAHEAD + 1024)
+
+typedef struct {
+    int16_t buf[WSOLA_BUFFER * 2];          // Input frames, interleaved
+    int len;                                // Frames in buf
+    int next;                               // Natural continuation of the output
+    int64_t nominal;                        // Where the next hop ideally starts, Q16
+    int32_t speed;                          // Q16
+    bool stretching;                        // Working in hops rather than passing through
+    int16_t fade[WSOLA_HOP];                // Rising crossfade, Q15
+    int32_t tmpl[WSOLA_HOP / WSOLA_DECIMATE];  // Search scratch, kept off the writer's stack
+    int32_t cand[(WSOLA_HOP + 2 * WSOLA_SEEK) / WSOLA_DECIMATE + 1];
+    int64_t consumed;                       // Input frames turned into output
+    int64_t produced;                       // Output frames
+    uint32_t hops;
+} wsola_t;
+
+void wsola_init(wsola_t *w);
+
+// Drops buffered audio and returns to speed 1.
+void wsola_reset(wsola_t *w);
+
+// Sets the playback speed, Q16, clamped to 1 +- WSOLA_SPEED_RANGE. Takes
+// effect from the next hop.
+void wsola_set_speed(wsola_t *w, int32_t speed);
+
+// Buffers up to frames of interleaved stereo input; returns how many were
+// taken. Always takes something once wsola_read() has emptied the output.
+size_t wsola_write(wsola_t *w, const int16_t *pcm, size_t frames);
+
+// Produces up to max frames of output from the buffered input; returns how
+// many were made. Stretched output comes a whole hop at a time, so max
+// should be at least WSOLA_HOP.
+size_t wsola_read(wsola_t *w, int16_t *out, size_t max);
@@ -0,0 +1,136 @@
+/*
+ * Host benchmark for the Vorbis decoder: decodes Ogg Vorbis files through
+ * the demuxer as ingest does and prints how many times real time that ran
+ * at, the slowest audio packet and the time the headers took. Each packet's
+ * time is the fastest of several passes, which keeps other load on the
+ * machine out of the figures.
+ *
+ *   bench_vorbis [file.ogg ...]      (the test fixtures when none given)
+ *
+ * Not a test; the device is 20 to 40 times slower than a desktop core, and
+ * "ingest" there reports the decoder's share of the CPU.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "ogg_demux.h"
+#include "sdkconfig.h"
+#include "vorbis_decoder.h"
+
+#define ARENA_SIZE      (CONFIG_BRIDGE_VORBIS_ARENA_KB * 1024)
+#define MAX_PACKETS     8192
+#define PASSES          7
+
+typedef struct {
+    vorbis_decoder_t *dec;
+    int pass;
+    int packets;
+    long frames;
+    int errors;
+    int64_t setup_us;
+    int64_t fastest_us[MAX_PACKETS];
+} bench_t;
+
+static bool packet(const uint8_t *data, size_t len, bool bos, void *ctx) {
+    bench_t *b = ctx;
+    const int16_t *pcm;
+    if (bos) {
+        vorbis_decoder_reset(b->dec);
+    }
+    // Header packets, the setup above all, are timed apart from audio.
+    bool audio = vorbis_ready(b->dec);
+    int64_t start_us = esp_timer_get_time();
+    int n = vorbis_decode_packet(b->dec, data, len, &pcm);
+    int64_t took_us = esp_timer_get_time() - start_us;
+    if (!audio) {
+        b->setup_us += took_us;
+        took_us = 0;
+    }
+    if (b->packets < MAX_PACKETS && (b->pass == 0 || took_us < b->fastest_us[b->packets])) {
+        b->fastest_us[b->packets] = took_us;
+    }
+    b->packets++;
+    if (n < 0) {
+        b->errors++;
+    } else {
+        b->frames += n;
+    }
+    return true;
+}
+
+static int bench(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("%s: cannot open\n", path);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *stream = malloc(len);
+    if (fread(stream, 1, len, f) != (size_t)len) {
+        printf("%s: cannot read\n", path);
+        fclose(f);
+        free(stream);
+        return 1;
+    }
+    fclose(f);
+
+    static bench_t b;
+    static uint8_t packet_buf[16384];
+    void *arena = malloc(ARENA_SIZE);
+    for (b.pass = 0; b.pass < PASSES; b.pass++) {
+        ogg_demux_t d;
+        ogg_demux_init(&d, packet_buf, sizeof(packet_buf));
+        b.dec = vorbis_decoder_create(arena, ARENA_SIZE);
+        b.packets = 0;
+        b.frames = 0;
+        b.errors = 0;
+        b.setup_us = 0;
+        for (long off = 0; off < len; off += 1460) {
+            ogg_demux_feed(&d, stream + off, len - off < 1460 ? len - off : 1460, packet, &b);
+        }
+    }
+
+    int64_t total_us = 0, worst_us = 0;
+    for (int i = 0; i < b.packets && i < MAX_PACKETS; i++) {
+        total_us += b.fastest_us[i];
+        worst_us = b.fastest_us[i] > worst_us ? b.fastest_us[i] : worst_us;
+    }
+    uint32_t rate = vorbis_sample_rate(b.dec);
+    int status = 0;
+    if (rate == 0 || b.frames == 0) {
+        printf("%s: not Vorbis, or no audio\n", path);
+        status = 1;
+    } else {
+        double seconds = (double)b.frames / rate;
+        printf("%s: %d ch, %lu Hz, %.2f s, %d packets, %d errors, arena %zu bytes, setup %.2f ms: "
+               "%.0fx realtime, worst packet %.3f ms\n", path, vorbis_channels(b.dec), (unsigned long)rate, seconds,
+               b.packets, b.errors, vorbis_arena_used(b.dec), b.setup_us / 1000.0,
+               seconds * 1e6 / (total_us > 0 ? total_us : 1), worst_us / 1000.0);
+    }
+    free(arena);
+    free(stream);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    static const char *const fixtures[] = {
+        FIXTURE_DIR "/vorbis_q3.ogg",
+        FIXTURE_DIR "/vorbis_mono_q0.ogg",
+        FIXTURE_DIR "/vorbis_clicks_q10.ogg",
+    };
+    int status = 0;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            status |= bench(argv[i]);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+            status |= bench(fixtures[i]);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,39 @@
+/*
+ * Minimal assertions for the host tests: a failed CHECK prints where and
+ * carries on, and CHECK_DONE() turns the tally into the exit status.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static int s_check_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            s_check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) do { \
+        double check_a_ = (a), check_b_ = (b); \
+        if (!(fabs(check_a_ - check_b_) <= (tol))) { \
+            fprintf(stderr, "%s:%d: CHECK_NEAR failed: %s = %g, %s = %g, tolerance %g\n", __FILE__, __LINE__, \
+                    #a, check_a_, #b, check_b_, (double)(tol)); \
+            s_check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_MEM(a, b, len) CHECK(memcmp((a), (b), (len)) == 0)
+
+#define CHECK_DONE() do { \
+        if (s_check_failures) { \
+            fprintf(stderr, "%d check(s) failed\n", s_check_failures); \
+            return 1; \
+        } \
+        printf("ok\n"); \
+        return 0; \
+    } while (0)
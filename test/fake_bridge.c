@@ -0,0 +1,147 @@
+/*
+ * Stand-in for the audio_bridge_* functions of blu_moudle.c: a playback
+ * buffer of STREAM_BUFFER_SIZE with the same producer ownership rules,
+ * optionally fed through the catch-up stage, and the reading end of
+ * a2d_data_cb for tests to call in place of the Bluetooth stack.
+ */
+
+#include "fake_bridge.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "host.h"
+#include "catchup.h"
+#include "overflow.h"
+#include "soak_monitor.h"
+
+static StreamBufferHandle_t s_playback;
+// Producers take turns writing, as on the device.
+static SemaphoreHandle_t s_write_lock;
+static _Atomic audio_source_t s_source = AUDIO_SOURCE_NETWORK;
+static bool s_connected;
+static uint32_t s_missing;
+static bool s_catchup;
+
+// Under the manual clock nothing runs while a writer waits for room, so
+// what a waiting writer could not send yet is held here and moved into the
+// buffer as fake_bridge_play() makes room, as if the writer were blocked.
+static uint8_t *s_held;
+static size_t s_held_len;
+static size_t s_held_size;
+
+StreamBufferHandle_t fake_bridge_playback(void) {
+    if (s_playback == NULL) {
+        s_playback = xStreamBufferCreate(STREAM_BUFFER_SIZE, 1);
+        s_write_lock = xSemaphoreCreateMutex();
+        // Sized up front, so a soak test does not see it grow as heap lost.
+        s_held_size = STREAM_BUFFER_SIZE;
+        s_held = malloc(s_held_size);
+    }
+    return s_playback;
+}
+
+void fake_bridge_set_connected(bool connected) {
+    s_connected = connected;
+}
+
+void fake_bridge_use_catchup(bool on) {
+    s_catchup = on;
+}
+
+bool fake_bridge_blocked(void) {
+    return s_held_len > 0;
+}
+
+static void release_held(void) {
+    size_t n = xStreamBufferSend(fake_bridge_playback(), s_held, s_held_len, 0);
+    s_held_len -= n;
+    memmove(s_held, s_held + n, s_held_len);
+}
+
+static size_t playback_read(void *buf, size_t n, void *ctx) {
+    return xStreamBufferReceive(fake_bridge_playback(), buf, n, 0);
+}
+
+// a2d_data_cb without the flush, the asset mix and the taps.
+void fake_bridge_play(uint8_t *data, size_t len) {
+    size_t got = playback_read(data, len, NULL);
+    if (got < len) {
+        memset(data + got, 0, len - got);
+        if (s_connected || s_source != AUDIO_SOURCE_NETWORK) {
+            soak_monitor_note_underrun(len - got);
+            s_missing += len - got;
+        }
+    } else if (s_source == AUDIO_SOURCE_NETWORK) {
+        overflow_trim(data, len, audio_bridge_buffered_bytes(), playback_read, NULL);
+    }
+    release_held();
+}
+
+static size_t playback_send(const void *data, size_t len, void *ctx) {
+    TickType_t wait = *(TickType_t *)ctx;
+    size_t sent = s_held_len > 0 ? 0 : xStreamBufferSend(fake_bridge_playback(), data, len, wait);
+    if (sent == len || wait == 0 || !host_clock_is_manual()) {
+        return sent;
+    }
+    if (s_held_len + len - sent > s_held_size) {
+        s_held_size = 2 * (s_held_len + len - sent);
+        s_held = realloc(s_held, s_held_size);
+    }
+    memcpy(s_held + s_held_len, (const uint8_t *)data + sent, len - sent);
+    s_held_len += len - sent;
+    return len;
+}
+
+bool audio_bridge_claim(audio_source_t source) {
+    audio_source_t owner = AUDIO_SOURCE_NETWORK;
+    return atomic_compare_exchange_strong(&s_source, &owner, source) || owner == source;
+}
+
+void audio_bridge_release(audio_source_t source) {
+    audio_source_t owner = source;
+    atomic_compare_exchange_strong(&s_source, &owner, AUDIO_SOURCE_NETWORK);
+}
+
+size_t audio_bridge_write(audio_source_t source, const void *data, size_t len, TickType_t wait) {
+    size_t sent = len;
+    fake_bridge_playback();
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    if (source == s_source) {
+        sent = s_catchup ? catchup_write(data, len, playback_send, &wait) : playback_send(data, len, &wait);
+    }
+    xSemaphoreGive(s_write_lock);
+    return sent;
+}
+
+void audio_bridge_flush(audio_source_t source) {
+    fake_bridge_playback();
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    if (source == s_source) {
+        if (s_catchup) {
+            catchup_reset();
+        }
+        xStreamBufferReset(fake_bridge_playback());
+        s_held_len = 0;
+    }
+    xSemaphoreGive(s_write_lock);
+}
+
+size_t audio_bridge_buffered_bytes(void) {
+    return xStreamBufferBytesAvailable(fake_bridge_playback());
+}
+
+uint32_t audio_bridge_missing_bytes(void) {
+    return s_missing;
+}
+
+bool audio_bridge_client_connected(void) {
+    return s_connected;
+}
+
+void audio_bridge_kick_client(void) {
+    s_connected = false;
+}
@@ -0,0 +1,31 @@
+/*
+ * The playback buffer and client state that blu_moudle.c owns on the
+ * device, for tests.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/stream_buffer.h"
+#include "audio_bridge.h"
+
+// The buffer audio_bridge_write() fills; created on first use.
+StreamBufferHandle_t fake_bridge_playback(void);
+
+// What audio_bridge_client_connected() reports.
+void fake_bridge_set_connected(bool connected);
+
+// Sends writes through catchup_write() first, as blu_moudle.c does; the
+// test calls catchup_init().
+void fake_bridge_use_catchup(bool on);
+
+// True while a writer that would block on the device is waiting for room
+// under the manual clock; it resumes as fake_bridge_play() drains the buffer.
+bool fake_bridge_blocked(void);
+
+// Fills data from the playback buffer as a2d_data_cb does: silence for what
+// is missing, counted as an underrun while a producer is active, and the
+// overflow policy applied to a full read.
+void fake_bridge_play(uint8_t *data, size_t len);
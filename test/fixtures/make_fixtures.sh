@@ -0,0 +1,53 @@
+#!/bin/sh
+# Regenerates the decoder fixtures in this directory from a built test tree:
+#
+#   cmake -S test -B _test_build && cmake --build _test_build
+#   test/fixtures/make_fixtures.sh _test_build
+#
+# Needs ffmpeg on the path (or in $FFMPEG). Reference PCM is always ffmpeg's
+# decode of the checked-in stream, as raw interleaved 16-bit little endian.
+set -e
+build=$(cd "${1:?usage: make_fixtures.sh <test build dir>}" && pwd)
+ffmpeg=${FFMPEG:-ffmpeg}
+cd "$(dirname "$0")"
+
+decode() {
+    "$ffmpeg" -v error -y -f "$1" -i "$2" -f s16le "$3"
+}
+
+# SBC: frames from sbc_codec.c's encoder (test_sbc writes them), decoded by
+# ffmpeg's SBC decoder.
+"$build/test_sbc" --write-fixtures
+for name in sbc_sq sbc_xq_noise sbc_mono4; do
+    decode sbc "$name.sbc" "$name.pcm"
+done
+
+# Signals for the codecs ffmpeg encodes: tones under sweeps in stereo and
+# mono, and short bursts for transients.
+tones='0.3*sin(2*PI*440*t)+0.15*sin(2*PI*(300+4000*t)*t)|0.3*sin(2*PI*660*t)+0.15*sin(2*PI*(9000-4000*t)*t)'
+mono='0.4*sin(2*PI*330*t)+0.2*sin(2*PI*(500+6000*t)*t)'
+clicks='0.6*sin(2*PI*1500*t)*lt(mod(t\,0.125)\,0.004)|0.5*sin(2*PI*2500*t)*lt(mod(t+0.06\,0.125)\,0.003)'
+
+# encode <name> <signal> <seconds> <format> <ext> <encoder options...>
+encode() {
+    name=$1 signal=$2 seconds=$3 format=$4 ext=$5
+    shift 5
+    "$ffmpeg" -v error -y -f lavfi -i "aevalsrc=$signal:s=44100:d=$seconds" "$@" -f "$format" "$name.$ext"
+}
+
+# AAC: ffmpeg's AAC encoder and decoder.
+encode aac_stereo "$tones" 0.75 adts aac -c:a aac -b:a 128k
+encode aac_mono "$mono" 0.5 adts aac -c:a aac -b:a 64k
+encode aac_clicks "$clicks" 0.5 adts aac -c:a aac -b:a 96k
+for name in aac_stereo aac_mono aac_clicks; do
+    decode aac "$name.aac" "$name.pcm"
+done
+
+# Vorbis: libvorbis both ways, at its lowest, a middling and its highest
+# quality.
+encode vorbis_q3 "$tones" 0.75 ogg ogg -fflags +bitexact -c:a libvorbis -q:a 3
+encode vorbis_mono_q0 "$mono" 0.5 ogg ogg -fflags +bitexact -c:a libvorbis -q:a 0
+encode vorbis_clicks_q10 "$clicks" 0.5 ogg ogg -fflags +bitexact -c:a libvorbis -q:a 10
+for name in vorbis_q3 vorbis_mono_q0 vorbis_clicks_q10; do
+    "$ffmpeg" -v error -y -c:a libvorbis -i "$name.ogg" -f s16le "$name.pcm"
+done
@@ -0,0 +1,70 @@
+/*
+ * Shared host test fixtures (see harness.h).
+ */
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "lwip/sockets.h"
+#include "bridge_console.h"
+#include "control_channel.h"
+
+static char s_output[4096];
+static size_t s_output_len;
+
+static void capture(const char *text, void *ctx) {
+    size_t n = strlen(text);
+    if (s_output_len + n < sizeof(s_output)) {
+        memcpy(s_output + s_output_len, text, n + 1);
+        s_output_len += n;
+    }
+}
+
+int harness_exec(const char *line) {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "%s", line);
+    s_output_len = 0;
+    s_output[0] = '\0';
+    return console_exec_to(cmd, capture, NULL);
+}
+
+const char *harness_output(void) {
+    return s_output;
+}
+
+int harness_control_connect(void) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = htons(CONTROL_PORT),
+    };
+    for (int tries = 0; tries < 100; tries++) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            struct timeval timeout = { .tv_sec = 5 };
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            return sock;
+        }
+        close(sock);
+        usleep(20000);
+    }
+    return -1;
+}
+
+bool harness_read_line(int sock, char *line, size_t len) {
+    size_t n = 0;
+    char c;
+    while (recv(sock, &c, 1, 0) == 1) {
+        if (c == '\n') {
+            line[n] = '\0';
+            return true;
+        }
+        if (n < len - 1) {
+            line[n++] = c;
+        }
+    }
+    line[n] = '\0';
+    return false;
+}
@@ -0,0 +1,24 @@
+/*
+ * Fixtures the host tests share: console commands run with their output
+ * kept, and a controller's end of the control channel.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Runs a console command line and returns its status. The line is copied
+// first, since the console splits it in place; what the command printed is
+// in harness_output() until the next call.
+int harness_exec(const char *line);
+
+const char *harness_output(void);
+
+// Connects to CONTROL_PORT on loopback, retrying for a couple of seconds
+// while the server starts, with a 5 s receive timeout. Returns the socket,
+// or -1.
+int harness_control_connect(void);
+
+// Reads one line without its newline; false on EOF or timeout.
+bool harness_read_line(int sock, char *line, size_t len);
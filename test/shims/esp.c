@@ -0,0 +1,172 @@
+/*
+ * ESP-IDF system services on the host: clock, logging, randomness, heap
+ * figures, the cycle counter and a flash partition a test provides.
+ */
+
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host.h"
+
+// --- Clock ---
+static atomic_bool s_manual;
+static _Atomic int64_t s_manual_us;
+
+bool host_clock_is_manual(void) {
+    return atomic_load(&s_manual);
+}
+
+void host_clock_manual(int64_t start_us) {
+    atomic_store(&s_manual_us, start_us);
+    atomic_store(&s_manual, true);
+}
+
+void host_clock_advance(int64_t us) {
+    atomic_fetch_add(&s_manual_us, us);
+}
+
+int64_t esp_timer_get_time(void) {
+    if (atomic_load(&s_manual)) {
+        return atomic_load(&s_manual_us);
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t esp_cpu_get_cycle_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+
+// --- Logging ---
+static atomic_bool s_quiet;
+
+void host_log_quiet(bool quiet) {
+    atomic_store(&s_quiet, quiet);
+}
+
+void host_log(char level, const char *tag, const char *fmt, ...) {
+    if (atomic_load(&s_quiet)) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c (%lld) %s: ", level, (long long)(esp_timer_get_time() / 1000), tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+uint32_t esp_log_timestamp(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default:                    return "ESP_FAIL";
+    }
+}
+
+// --- Randomness ---
+// Deterministic, so a failing run can be repeated.
+static uint64_t s_random_state = 0x853c49e6748fea9bull;
+
+uint32_t esp_random(void) {
+    host_critical_enter();
+    s_random_state = s_random_state * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t r = (uint32_t)(s_random_state >> 32);
+    host_critical_exit();
+    return r;
+}
+
+void esp_fill_random(void *buf, size_t len) {
+    uint8_t *p = buf;
+    for (size_t i = 0; i < len; i++) {
+        p[i] = (uint8_t)esp_random();
+    }
+}
+
+// --- Heap ---
+static uint32_t s_min_free = HOST_HEAP_SIZE;
+
+size_t host_heap_used(void) {
+    return mallinfo2().uordblks;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    size_t used = host_heap_used();
+    uint32_t free_bytes = used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+    if (free_bytes < s_min_free) {
+        s_min_free = free_bytes;
+    }
+    return free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    esp_get_free_heap_size();
+    return s_min_free;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return esp_get_free_heap_size();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return esp_get_free_heap_size();
+}
+
+// --- Flash ---
+static esp_partition_t s_partition;
+static const uint8_t *s_partition_data;
+
+void host_partition_set(const char *label, int subtype, const void *data, size_t size) {
+    s_partition = (esp_partition_t){ .type = ESP_PARTITION_TYPE_DATA, .subtype = subtype, .size = size };
+    snprintf(s_partition.label, sizeof(s_partition.label), "%s", label);
+    s_partition_data = data;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    if (s_partition_data == NULL || type != s_partition.type ||
+        (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != s_partition.subtype) ||
+        (label != NULL && strcmp(label, s_partition.label) != 0)) {
+        return NULL;
+    }
+    return &s_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t len) {
+    if (part != &s_partition || offset > part->size || len > part->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(dst, s_partition_data + offset, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *part, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out, esp_partition_mmap_handle_t *handle) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+}
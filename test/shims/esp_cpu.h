@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// A 1 GHz count from the host's monotonic clock; benchmarks only compare
+// their own runs.
+uint32_t esp_cpu_get_cycle_count(void);
@@ -0,0 +1,42 @@
+/*
+ * The HTTP client that is not there (see esp_http_client.h).
+ */
+
+#include <stddef.h>
+#include "esp_http_client.h"
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    return NULL;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+    return ESP_FAIL;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    return ESP_FAIL;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    return ESP_FAIL;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return -1;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return -1;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+    return -1;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    return ESP_OK;
+}
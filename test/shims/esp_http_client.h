@@ -0,0 +1,30 @@
+/*
+ * The ESP-IDF HTTP client, for building the play queue on the host. There
+ * is no client behind it: esp_http_client_init() fails, so http:// items
+ * fail to connect and host tests queue tcp:// streams instead.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_ERR_HTTP_BASE       0x7000
+#define ESP_ERR_HTTP_EAGAIN     (ESP_ERR_HTTP_BASE + 7)
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef struct {
+    const char *url;
+    int timeout_ms;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
@@ -0,0 +1,18 @@
+/*
+ * Logging goes to stderr, or nowhere once a test calls host_log_quiet().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+void host_log(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, fmt, ...)     host_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)     host_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)     host_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)     ((void)(tag))
+#define ESP_EARLY_LOGW(tag, fmt, ...) host_log('W', tag, fmt, ##__VA_ARGS__)
+
+uint32_t esp_log_timestamp(void);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Heap figures come from the host allocator, measured against a notional
+// HOST_HEAP_SIZE so they fall as memory is taken, as on the device.
+#define HOST_HEAP_SIZE  (256 * 1024 * 1024)
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
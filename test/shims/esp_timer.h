@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// Microseconds on the host clock (see host.h).
+int64_t esp_timer_get_time(void);
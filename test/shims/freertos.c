@@ -0,0 +1,320 @@
+/*
+ * FreeRTOS on pthreads
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "host.h"
+
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_critical_enter(void) {
+    pthread_mutex_lock(&s_critical);
+}
+
+void host_critical_exit(void) {
+    pthread_mutex_unlock(&s_critical);
+}
+
+// Absolute deadline for a wait of ticks, on CLOCK_MONOTONIC.
+static struct timespec deadline(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)pdTICKS_TO_MS(ticks) * 1000000 + ts.tv_nsec;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    return ts;
+}
+
+static pthread_cond_t *cond_new(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_t *c = malloc(sizeof(*c));
+    pthread_cond_init(c, &attr);
+    pthread_condattr_destroy(&attr);
+    return c;
+}
+
+// Waits on c until woken, or for ticks; never under manual time, where
+// nothing else runs to wake it. Returns false on timeout.
+static bool cond_wait(pthread_cond_t *c, pthread_mutex_t *m, TickType_t ticks) {
+    if (ticks == 0 || host_clock_is_manual()) {
+        return false;
+    }
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(c, m);
+        return true;
+    }
+    struct timespec ts = deadline(ticks);
+    return pthread_cond_timedwait(c, m, &ts) != ETIMEDOUT;
+}
+
+// --- Tasks ---
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t *cond;
+    uint32_t notified;
+} host_task_t;
+
+static __thread host_task_t *s_self;
+
+static void *task_main(void *arg) {
+    s_self = arg;
+    s_self->fn(s_self->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core) {
+    host_task_t *t = calloc(1, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+    pthread_mutex_init(&t->lock, NULL);
+    t->cond = cond_new();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_main, t) != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = t;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == s_self) {
+        pthread_exit(NULL);
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (host_clock_is_manual()) {
+        host_clock_advance((int64_t)pdTICKS_TO_MS(ticks) * 1000);
+        return;
+    }
+    struct timespec ts = { .tv_sec = pdTICKS_TO_MS(ticks) / 1000, .tv_nsec = pdTICKS_TO_MS(ticks) % 1000 * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void vTaskDelayUntil(TickType_t *last_wake, TickType_t period) {
+    *last_wake += period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*last_wake - now) > 0) {
+        vTaskDelay(*last_wake - now);
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return s_self;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t prio) {
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 1024;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    host_task_t *t = task;
+    pthread_mutex_lock(&t->lock);
+    t->notified++;
+    pthread_cond_broadcast(t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    host_task_t *t = s_self;
+    if (t == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&t->lock);
+    while (t->notified == 0 && cond_wait(t->cond, &t->lock, wait)) {
+    }
+    uint32_t n = t->notified;
+    if (n > 0) {
+        t->notified = clear ? 0 : n - 1;
+    }
+    pthread_mutex_unlock(&t->lock);
+    return n;
+}
+
+// --- Semaphores ---
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t *cond;
+    int count;
+};
+
+static SemaphoreHandle_t semaphore_new(int count) {
+    SemaphoreHandle_t s = calloc(1, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    s->cond = cond_new();
+    s->count = count;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return semaphore_new(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return semaphore_new(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) {
+    // FreeRTOS asserts on a NULL handle; so do we.
+    if (s == NULL) {
+        abort();
+    }
+    pthread_mutex_lock(&s->lock);
+    while (s->count == 0 && cond_wait(s->cond, &s->lock, wait)) {
+    }
+    bool taken = s->count > 0;
+    s->count -= taken;
+    pthread_mutex_unlock(&s->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    if (s == NULL) {
+        abort();
+    }
+    pthread_mutex_lock(&s->lock);
+    bool given = s->count == 0;
+    s->count = 1;
+    pthread_cond_broadcast(s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return given ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s) {
+    pthread_cond_destroy(s->cond);
+    free(s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+// --- Stream buffers ---
+struct host_stream_buffer {
+    pthread_mutex_t lock;
+    pthread_cond_t *cond;
+    uint8_t *buf;
+    size_t size;
+    size_t head;            // Total written
+    size_t tail;            // Total read
+};
+
+// Copies n bytes into the ring at stream offset pos, or out of it.
+static void ring_copy(StreamBufferHandle_t sb, size_t pos, void *data, size_t n, bool in) {
+    size_t at = pos % sb->size;
+    size_t first = n < sb->size - at ? n : sb->size - at;
+    if (in) {
+        memcpy(sb->buf + at, data, first);
+        memcpy(sb->buf, (uint8_t *)data + first, n - first);
+    } else {
+        memcpy(data, sb->buf + at, first);
+        memcpy((uint8_t *)data + first, sb->buf, n - first);
+    }
+}
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger) {
+    StreamBufferHandle_t sb = calloc(1, sizeof(*sb));
+    pthread_mutex_init(&sb->lock, NULL);
+    sb->cond = cond_new();
+    sb->buf = malloc(size);
+    sb->size = size;
+    return sb;
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t sb) {
+    pthread_cond_destroy(sb->cond);
+    free(sb->cond);
+    pthread_mutex_destroy(&sb->lock);
+    free(sb->buf);
+    free(sb);
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t sb, const void *data, size_t len, TickType_t wait) {
+    pthread_mutex_lock(&sb->lock);
+    // Like FreeRTOS: waits up to wait for room for all of it, then sends
+    // whatever fits.
+    size_t want = len < sb->size ? len : sb->size;
+    struct timespec until = deadline(wait == portMAX_DELAY ? 0 : wait);
+    while (sb->size - (sb->head - sb->tail) < want && wait > 0 && !host_clock_is_manual()) {
+        if (wait == portMAX_DELAY) {
+            pthread_cond_wait(sb->cond, &sb->lock);
+        } else if (pthread_cond_timedwait(sb->cond, &sb->lock, &until) == ETIMEDOUT) {
+            break;
+        }
+    }
+    size_t room = sb->size - (sb->head - sb->tail);
+    size_t sent = len < room ? len : room;
+    ring_copy(sb, sb->head, (void *)data, sent, true);
+    sb->head += sent;
+    if (sent > 0) {
+        pthread_cond_broadcast(sb->cond);
+    }
+    pthread_mutex_unlock(&sb->lock);
+    return sent;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t sb, void *data, size_t len, TickType_t wait) {
+    uint8_t *p = data;
+    pthread_mutex_lock(&sb->lock);
+    if (sb->head == sb->tail) {
+        cond_wait(sb->cond, &sb->lock, wait);
+    }
+    size_t avail = sb->head - sb->tail;
+    size_t n = len < avail ? len : avail;
+    ring_copy(sb, sb->tail, p, n, false);
+    sb->tail += n;
+    if (n > 0) {
+        pthread_cond_broadcast(sb->cond);
+    }
+    pthread_mutex_unlock(&sb->lock);
+    return n;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t sb) {
+    pthread_mutex_lock(&sb->lock);
+    size_t n = sb->head - sb->tail;
+    pthread_mutex_unlock(&sb->lock);
+    return n;
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t sb) {
+    return sb->size - xStreamBufferBytesAvailable(sb);
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t sb) {
+    pthread_mutex_lock(&sb->lock);
+    sb->tail = sb->head;
+    pthread_cond_broadcast(sb->cond);
+    pthread_mutex_unlock(&sb->lock);
+    return pdPASS;
+}
@@ -0,0 +1,45 @@
+/*
+ * FreeRTOS on the host: tasks are pthreads, ticks follow the host clock
+ * (see host.h) at CONFIG_FREERTOS_HZ.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES    25
+#define portMAX_DELAY           ((TickType_t)0xffffffffu)
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define pdTICKS_TO_MS(t)        ((uint32_t)((uint64_t)(t) * 1000 / configTICK_RATE_HZ))
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define tskNO_AFFINITY          0x7fffffff
+#define IRAM_ATTR
+
+// One lock stands in for every spinlock, as the sections it guards are short.
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define portENTER_CRITICAL(mux)         host_critical_enter()
+#define portEXIT_CRITICAL(mux)          host_critical_exit()
+#define taskENTER_CRITICAL(mux)         host_critical_enter()
+#define taskEXIT_CRITICAL(mux)          host_critical_exit()
+#define portENTER_CRITICAL_ISR(mux)     host_critical_enter()
+#define portEXIT_CRITICAL_ISR(mux)      host_critical_exit()
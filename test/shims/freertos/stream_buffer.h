@@ -0,0 +1,13 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_stream_buffer *StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger);
+size_t xStreamBufferSend(StreamBufferHandle_t sb, const void *data, size_t len, TickType_t wait);
+size_t xStreamBufferReceive(StreamBufferHandle_t sb, void *data, size_t len, TickType_t wait);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t sb);
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t sb);
+BaseType_t xStreamBufferReset(StreamBufferHandle_t sb);
+void vStreamBufferDelete(StreamBufferHandle_t sb);
@@ -0,0 +1,32 @@
+/*
+ * Controls the shims give tests.
+ *
+ * The clock is the host's monotonic clock until a test calls
+ * host_clock_manual(); from then on it only moves when the test advances
+ * it, and vTaskDelay() advances it instead of sleeping, so a simulation can
+ * run hours of device time in seconds. Manual time suits single-threaded
+ * simulations; a test that starts tasks keeps the real clock.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Switches to manual time, starting at start_us.
+void host_clock_manual(int64_t start_us);
+
+void host_clock_advance(int64_t us);
+
+bool host_clock_is_manual(void);
+
+// Drops ESP_LOGx output, or brings it back.
+void host_log_quiet(bool quiet);
+
+// Bytes the host allocator has handed out and not had back.
+size_t host_heap_used(void);
+
+// Makes data the one flash partition, found by its label and subtype; data
+// must outlive its use.
+void host_partition_set(const char *label, int subtype, const void *data, size_t size);
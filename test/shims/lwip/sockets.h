@@ -0,0 +1,22 @@
+/*
+ * lwIP's BSD socket API is the host's own. Listening sockets are bound with
+ * SO_REUSEADDR so a test run straight after another finds its port free.
+ */
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static inline int host_bind(int sock, const struct sockaddr *addr, socklen_t len) {
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    return bind(sock, addr, len);
+}
+
+#define bind host_bind
@@ -0,0 +1,187 @@
+/*
+ * The parts of mbedTLS the bridge uses: SHA-256 and HMAC-SHA256 (FIPS 180-4,
+ * RFC 2104), zeroize, and a GCM that refuses every key.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "mbedtls/gcm.h"
+#include "mbedtls/md.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/sha256.h"
+
+typedef struct {
+    uint32_t h[8];
+    uint8_t block[64];
+    size_t used;
+    uint64_t total;
+} sha256_t;
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) ((x) >> (n) | (x) << (32 - (n)))
+
+static void compress(sha256_t *c) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)c->block[4 * i] << 24 | (uint32_t)c->block[4 * i + 1] << 16 |
+               (uint32_t)c->block[4 * i + 2] << 8 | c->block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = c->h[0], b = c->h[1], cc = c->h[2], d = c->h[3];
+    uint32_t e = c->h[4], f = c->h[5], g = c->h[6], h = c->h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & cc) ^ (b & cc));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = cc;
+        cc = b;
+        b = a;
+        a = t1 + t2;
+    }
+    c->h[0] += a;
+    c->h[1] += b;
+    c->h[2] += cc;
+    c->h[3] += d;
+    c->h[4] += e;
+    c->h[5] += f;
+    c->h[6] += g;
+    c->h[7] += h;
+}
+
+static void sha256_start(sha256_t *c) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(c->h, iv, sizeof(iv));
+    c->used = 0;
+    c->total = 0;
+}
+
+static void sha256_update(sha256_t *c, const uint8_t *p, size_t len) {
+    c->total += len;
+    while (len > 0) {
+        size_t n = 64 - c->used < len ? 64 - c->used : len;
+        memcpy(c->block + c->used, p, n);
+        c->used += n;
+        p += n;
+        len -= n;
+        if (c->used == 64) {
+            compress(c);
+            c->used = 0;
+        }
+    }
+}
+
+static void sha256_finish(sha256_t *c, uint8_t out[32]) {
+    uint64_t bits = c->total * 8;
+    uint8_t pad = 0x80;
+    sha256_update(c, &pad, 1);
+    pad = 0;
+    while (c->used != 56) {
+        sha256_update(c, &pad, 1);
+    }
+    uint8_t len[8];
+    for (int i = 0; i < 8; i++) {
+        len[i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    sha256_update(c, len, 8);
+    for (int i = 0; i < 8; i++) {
+        out[4 * i] = c->h[i] >> 24;
+        out[4 * i + 1] = c->h[i] >> 16;
+        out[4 * i + 2] = c->h[i] >> 8;
+        out[4 * i + 3] = c->h[i];
+    }
+}
+
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char output[32], int is224) {
+    sha256_t c;
+    sha256_start(&c);
+    sha256_update(&c, input, ilen);
+    sha256_finish(&c, output);
+    return is224 ? -1 : 0;
+}
+
+static const struct mbedtls_md_info_t {
+    int type;
+} s_sha256_info = { MBEDTLS_MD_SHA256 };
+
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+    return type == MBEDTLS_MD_SHA256 ? &s_sha256_info : NULL;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *md_info, const unsigned char *key, size_t keylen,
+                    const unsigned char *input, size_t ilen, unsigned char *output) {
+    if (md_info != &s_sha256_info) {
+        return -1;
+    }
+    uint8_t k[64] = { 0 };
+    if (keylen > sizeof(k)) {
+        mbedtls_sha256(key, keylen, k, 0);
+    } else {
+        memcpy(k, key, keylen);
+    }
+    uint8_t pad[64], inner[32];
+    sha256_t c;
+    for (int i = 0; i < 64; i++) {
+        pad[i] = k[i] ^ 0x36;
+    }
+    sha256_start(&c);
+    sha256_update(&c, pad, 64);
+    sha256_update(&c, input, ilen);
+    sha256_finish(&c, inner);
+    for (int i = 0; i < 64; i++) {
+        pad[i] = k[i] ^ 0x5c;
+    }
+    sha256_start(&c);
+    sha256_update(&c, pad, 64);
+    sha256_update(&c, inner, 32);
+    sha256_finish(&c, output);
+    return 0;
+}
+
+void mbedtls_platform_zeroize(void *buf, size_t len) {
+    volatile uint8_t *p = buf;
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+void mbedtls_gcm_init(mbedtls_gcm_context *ctx) {
+}
+
+int mbedtls_gcm_setkey(mbedtls_gcm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key,
+                       unsigned int keybits) {
+    return MBEDTLS_ERR_GCM_BAD_INPUT;
+}
+
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+                             const unsigned char *add, size_t add_len, const unsigned char *tag, size_t tag_len,
+                             const unsigned char *input, unsigned char *output) {
+    return MBEDTLS_ERR_GCM_AUTH_FAILED;
+}
+
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context *ctx, int mode, size_t length, const unsigned char *iv,
+                              size_t iv_len, const unsigned char *add, size_t add_len, const unsigned char *input,
+                              unsigned char *output, size_t tag_len, unsigned char *tag) {
+    return MBEDTLS_ERR_GCM_BAD_INPUT;
+}
+
+void mbedtls_gcm_free(mbedtls_gcm_context *ctx) {
+}
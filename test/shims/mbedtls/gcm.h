@@ -0,0 +1,32 @@
+/*
+ * No AES on the host: AES-256-GCM sessions fail at setkey, as they would
+ * with the cipher disabled, and the tests run ChaCha20-Poly1305.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_GCM_AUTH_FAILED     -0x0012
+#define MBEDTLS_ERR_GCM_BAD_INPUT       -0x0014
+#define MBEDTLS_GCM_ENCRYPT             1
+#define MBEDTLS_GCM_DECRYPT             0
+
+typedef enum {
+    MBEDTLS_CIPHER_ID_AES = 2,
+} mbedtls_cipher_id_t;
+
+typedef struct {
+    int unused;
+} mbedtls_gcm_context;
+
+void mbedtls_gcm_init(mbedtls_gcm_context *ctx);
+int mbedtls_gcm_setkey(mbedtls_gcm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key,
+                       unsigned int keybits);
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+                             const unsigned char *add, size_t add_len, const unsigned char *tag, size_t tag_len,
+                             const unsigned char *input, unsigned char *output);
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context *ctx, int mode, size_t length, const unsigned char *iv,
+                              size_t iv_len, const unsigned char *add, size_t add_len, const unsigned char *input,
+                              unsigned char *output, size_t tag_len, unsigned char *tag);
+void mbedtls_gcm_free(mbedtls_gcm_context *ctx);
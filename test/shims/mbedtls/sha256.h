@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stddef.h>
+
+// One-shot SHA-256 (is224 must be 0).
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char output[32], int is224);
@@ -0,0 +1,177 @@
+/*
+ * In-memory NVS
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+
+#define HOST_NVS_ENTRIES    64
+#define HOST_NVS_VALUE_MAX  4096
+
+typedef struct {
+    bool used;
+    nvs_type_t type;
+    char ns[NVS_NS_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t len;
+    uint8_t value[HOST_NVS_VALUE_MAX];
+} entry_t;
+
+static entry_t s_entries[HOST_NVS_ENTRIES];
+static char s_names[8][NVS_NS_NAME_MAX_SIZE];       // Handle n is namespace n - 1
+static int s_name_count = 0;
+
+struct nvs_opaque_iterator_t {
+    char ns[NVS_NS_NAME_MAX_SIZE];
+    nvs_type_t type;
+    int index;
+};
+
+static const char *ns_of(nvs_handle_t handle) {
+    return handle > 0 && handle <= (nvs_handle_t)s_name_count ? s_names[handle - 1] : "";
+}
+
+static entry_t *find(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < HOST_NVS_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, ns_of(handle)) == 0 && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t put(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t len) {
+    if (len > HOST_NVS_VALUE_MAX || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    host_critical_enter();
+    entry_t *e = find(handle, key);
+    for (int i = 0; e == NULL && i < HOST_NVS_ENTRIES; i++) {
+        if (!s_entries[i].used) {
+            e = &s_entries[i];
+            e->used = true;
+            strcpy(e->ns, ns_of(handle));
+            strcpy(e->key, key);
+        }
+    }
+    if (e != NULL) {
+        e->type = type;
+        e->len = len;
+        memcpy(e->value, value, len);
+    }
+    host_critical_exit();
+    return e != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t get(nvs_handle_t handle, const char *key, nvs_type_t type, void *out, size_t *len) {
+    host_critical_enter();
+    entry_t *e = find(handle, key);
+    esp_err_t err = ESP_OK;
+    if (e == NULL || e->type != type) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out == NULL) {
+        *len = e->len;
+    } else if (*len < e->len) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(out, e->value, e->len);
+        *len = e->len;
+    }
+    host_critical_exit();
+    return err;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle) {
+    host_critical_enter();
+    int n;
+    for (n = 0; n < s_name_count && strcmp(s_names[n], name) != 0; n++) {
+    }
+    if (n == s_name_count && n < 8) {
+        strncpy(s_names[n], name, NVS_NS_NAME_MAX_SIZE - 1);
+        s_name_count++;
+    }
+    host_critical_exit();
+    *handle = n + 1;
+    return n < 8 ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *len) {
+    return get(handle, key, NVS_TYPE_BLOB, out, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len) {
+    return put(handle, key, NVS_TYPE_BLOB, value, len);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out) {
+    size_t len = 1;
+    return get(handle, key, NVS_TYPE_U8, out, &len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) {
+    return put(handle, key, NVS_TYPE_U8, &value, 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out, size_t *len) {
+    return get(handle, key, NVS_TYPE_STR, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    return put(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    host_critical_enter();
+    entry_t *e = find(handle, key);
+    if (e != NULL) {
+        e->used = false;
+    }
+    host_critical_exit();
+    return e != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+// Moves it to the next entry from index on that matches, or frees it.
+static esp_err_t seek(nvs_iterator_t *it) {
+    for (; (*it)->index < HOST_NVS_ENTRIES; (*it)->index++) {
+        entry_t *e = &s_entries[(*it)->index];
+        if (e->used && strcmp(e->ns, (*it)->ns) == 0 && ((*it)->type == NVS_TYPE_ANY || (*it)->type == e->type)) {
+            return ESP_OK;
+        }
+    }
+    free(*it);
+    *it = NULL;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_find(const char *part, const char *name, nvs_type_t type, nvs_iterator_t *it) {
+    *it = calloc(1, sizeof(**it));
+    strncpy((*it)->ns, name, NVS_NS_NAME_MAX_SIZE - 1);
+    (*it)->type = type;
+    return seek(it);
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *it) {
+    (*it)->index++;
+    return seek(it);
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t *info) {
+    entry_t *e = &s_entries[it->index];
+    strcpy(info->namespace_name, e->ns);
+    strcpy(info->key, e->key);
+    info->type = e->type;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t it) {
+    free(it);
+}
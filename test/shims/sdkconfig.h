@@ -0,0 +1,15 @@
+/*
+ * Host build configuration: the Kconfig defaults from main/Kconfig.projbuild
+ * and the IDF values the bridge's sources read.
+ */
+
+#pragma once
+
+#define CONFIG_FREERTOS_HZ                      100
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ         160
+#define CONFIG_BRIDGE_SOAK_MONITOR              1
+#define CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S      10
+#define CONFIG_BRIDGE_SOAK_KICK_INTERVAL_S      0
+#define CONFIG_BRIDGE_TELEMETRY_PERIOD_MS       1000
+#define CONFIG_BRIDGE_VORBIS_ARENA_KB           96
+#define CONFIG_BRIDGE_DSP_ESP_DSP               1
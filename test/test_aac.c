@@ -0,0 +1,291 @@
+/*
+ * AAC-LC decoder against ffmpeg's on ADTS streams ffmpeg's encoder made
+ * (fixtures/make_fixtures.sh): output within rounding of the reference PCM,
+ * and decoding fast enough, frame by frame, to leave room for the ESP32.
+ *
+ * Through ingest: a damaged header costs the one frame it belonged to,
+ * concealed, and junk between frames costs sync until the next header, one
+ * frame concealed for it; either way the rest of the stream decodes as the
+ * decoder alone makes it with that frame concealed.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aac_decoder.h"
+#include "check.h"
+#include "esp_timer.h"
+#include "host.h"
+#include "ingest.h"
+
+#define MAX_STREAM      (16 * 1024)
+#define MAX_FRAMES      64
+#define PASSES          7           // Timing is the fastest of these, frame by frame
+#define FRAME_US        (1e6 * AAC_FRAME_SAMPLES / 44100)
+
+static const struct {
+    const char *name;
+    int channels;
+} s_fixtures[] = {
+    { "aac_stereo", 2 },
+    { "aac_mono", 1 },
+    { "aac_clicks", 2 },
+};
+
+typedef struct {
+    uint8_t data[MAX_STREAM + AAC_INPUT_PADDING];
+    size_t len;
+    int frames;
+    size_t offset[MAX_FRAMES + 1];  // Where each frame starts, then the end
+} stream_t;
+
+static size_t read_fixture(const char *name, const char *ext, void *buf, size_t size) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.%s", FIXTURE_DIR, name, ext);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("%s: cannot open\n", path);
+        return 0;
+    }
+    size_t n = fread(buf, 1, size, f);
+    fclose(f);
+    return n;
+}
+
+// Reads a fixture and splits it into frames.
+static void load_stream(const char *name, stream_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->len = read_fixture(name, "aac", s->data, MAX_STREAM);
+    CHECK(s->len > 0 && s->len < MAX_STREAM);
+    size_t pos = 0;
+    while (pos < s->len && s->frames < MAX_FRAMES) {
+        aac_adts_t h;
+        int flen = aac_parse_adts(s->data + pos, s->len - pos, &h);
+        CHECK(flen > 0 && pos + flen <= s->len);
+        if (flen <= 0) {
+            break;
+        }
+        s->offset[s->frames++] = pos;
+        pos += flen;
+    }
+    CHECK(pos == s->len);
+    s->offset[s->frames] = pos;
+}
+
+// --- Reference decoder ---
+static void test_reference(void) {
+    // ffmpeg's decoder is floating point: the two agree to within
+    // rounding, and both carry the encoder's priming frame.
+    static stream_t s;
+    static int16_t ref[MAX_FRAMES * AAC_FRAME_SAMPLES * 2];
+    static int16_t out[MAX_FRAMES * AAC_FRAME_SAMPLES * 2];
+    static double fastest_us[MAX_FRAMES];
+    void *mem = malloc(aac_decoder_size());
+
+    for (size_t i = 0; i < sizeof(s_fixtures) / sizeof(s_fixtures[0]); i++) {
+        const int channels = s_fixtures[i].channels;
+        load_stream(s_fixtures[i].name, &s);
+        size_t ref_len = read_fixture(s_fixtures[i].name, "pcm", ref, sizeof(ref));
+        CHECK(ref_len == (size_t)s.frames * AAC_FRAME_SAMPLES * channels * sizeof(int16_t));
+
+        double total_us = 0;
+        for (int pass = 0; pass < PASSES; pass++) {
+            aac_decoder_t *dec = aac_decoder_create(mem);
+            for (int f = 0; f < s.frames; f++) {
+                const int16_t *pcm;
+                int64_t start_us = esp_timer_get_time();
+                int n = aac_decode_frame(dec, s.data + s.offset[f], s.offset[f + 1] - s.offset[f], &pcm);
+                double took_us = esp_timer_get_time() - start_us;
+                CHECK(n == AAC_FRAME_SAMPLES);
+                CHECK(aac_channels(dec) == channels);
+                if (n != AAC_FRAME_SAMPLES) {
+                    break;
+                }
+                memcpy(out + f * AAC_FRAME_SAMPLES * channels, pcm, n * channels * sizeof(int16_t));
+                if (pass == 0 || took_us < fastest_us[f]) {
+                    fastest_us[f] = took_us;
+                }
+            }
+        }
+
+        const int samples = s.frames * AAC_FRAME_SAMPLES * channels;
+        double sum = 0, signal = 0, worst_us = 0;
+        int worst = 0;
+        for (int n = 0; n < samples; n++) {
+            int d = abs(out[n] - ref[n]);
+            worst = d > worst ? d : worst;
+            sum += (double)d * d;
+            signal += (double)ref[n] * ref[n];
+        }
+        for (int f = 0; f < s.frames; f++) {
+            total_us += fastest_us[f];
+            worst_us = fmax(worst_us, fastest_us[f]);
+        }
+        double rms = sqrt(sum / samples);
+        double realtime = s.frames * FRAME_US / total_us;
+        printf("%-10s %2d frames: %.2f LSB rms, %d LSB peak, snr %.1f dB against ffmpeg; %.0fx realtime, "
+               "worst frame %.3f ms\n", s_fixtures[i].name, s.frames, rms, worst, 10 * log10(signal / sum), realtime,
+               worst_us / 1000);
+        CHECK(rms < 0.5);
+        CHECK(worst <= 2);
+        CHECK(10 * log10(signal / sum) > 80);
+        // The ESP32 runs this 20 to 40 times slower than a desktop core; at
+        // that, the slowest frame must still take well under its 23.2 ms.
+        CHECK(realtime > 100);
+        CHECK(40 * worst_us < FRAME_US / 2);
+    }
+    free(mem);
+}
+
+static void test_headers(void) {
+    static stream_t s;
+    load_stream("aac_stereo", &s);
+    uint8_t frame[AAC_ADTS_HEADER_LEN];
+    aac_adts_t h;
+    memcpy(frame, s.data + s.offset[1], sizeof(frame));
+    CHECK(aac_parse_adts(frame, sizeof(frame), &h) == (int)(s.offset[2] - s.offset[1]));
+    CHECK(h.profile == 1 && aac_sample_rate(&h) == 44100 && h.channel_config == 2 && h.raw_blocks == 0);
+    CHECK(aac_supported(&h));
+
+    // Broken syncword, a layer other than 0, a length shorter than the
+    // header, and too few bytes to hold one.
+    uint8_t bad[AAC_ADTS_HEADER_LEN];
+    memcpy(bad, frame, sizeof(bad));
+    bad[1] &= ~0x10;
+    CHECK(aac_parse_adts(bad, sizeof(bad), &h) < 0);
+    memcpy(bad, frame, sizeof(bad));
+    bad[1] |= 0x02;
+    CHECK(aac_parse_adts(bad, sizeof(bad), &h) < 0);
+    memcpy(bad, frame, sizeof(bad));
+    bad[3] &= ~0x03;
+    bad[4] = 0;
+    bad[5] &= 0x1f;
+    CHECK(aac_parse_adts(bad, sizeof(bad), &h) < 0);
+    CHECK(aac_parse_adts(frame, AAC_ADTS_HEADER_LEN - 1, &h) < 0);
+}
+
+// --- Sync through ingest ---
+typedef struct {
+    int16_t pcm[(MAX_FRAMES + 4) * AAC_FRAME_SAMPLES * 2];
+    size_t frames;
+} capture_t;
+
+static void sink(const int16_t *pcm, size_t frames, void *ctx) {
+    capture_t *cap = ctx;
+    if (cap->frames + frames <= sizeof(cap->pcm) / 4) {
+        memcpy(cap->pcm + 2 * cap->frames, pcm, frames * 4);
+    }
+    cap->frames += frames;
+}
+
+// Feeds len bytes in the pieces recv() hands over.
+static void feed(const uint8_t *data, size_t len, capture_t *cap) {
+    ingest_t in;
+    cap->frames = 0;
+    ingest_begin(&in, sink, cap);
+    for (size_t off = 0; off < len; off += 1460) {
+        CHECK(ingest_feed(&in, data + off, len - off < 1460 ? len - off : 1460));
+    }
+    CHECK(in.format == INGEST_FORMAT_AAC);
+    ingest_end(&in);
+}
+
+// The stream decoded directly with a frame concealed at frame at, in its
+// place or, if inserted, before it: what ingest should make of the damage.
+// Stereo streams only.
+static void expected(const stream_t *s, int at, bool inserted, capture_t *exp) {
+    void *mem = malloc(aac_decoder_size());
+    aac_decoder_t *dec = aac_decoder_create(mem);
+    exp->frames = 0;
+    for (int f = 0; f < s->frames; f++) {
+        const int16_t *pcm;
+        int n;
+        if (f == at && inserted) {
+            n = aac_conceal(dec, &pcm);
+            sink(pcm, n, exp);
+        }
+        if (f == at && !inserted) {
+            n = aac_conceal(dec, &pcm);
+        } else {
+            n = aac_decode_frame(dec, s->data + s->offset[f], s->offset[f + 1] - s->offset[f], &pcm);
+        }
+        CHECK(n == AAC_FRAME_SAMPLES);
+        sink(pcm, n, exp);
+    }
+    free(mem);
+}
+
+static bool same_output(const capture_t *a, const capture_t *b) {
+    return a->frames == b->frames && memcmp(a->pcm, b->pcm, a->frames * 4) == 0;
+}
+
+// Difference between a and b over frames [from, to), in dB below the signal.
+static double difference_db(const capture_t *a, const capture_t *b, int from, int to) {
+    double signal = 0, noise = 0;
+    for (int i = 2 * from * AAC_FRAME_SAMPLES; i < 2 * to * AAC_FRAME_SAMPLES; i++) {
+        double d = a->pcm[i] - b->pcm[i];
+        signal += (double)b->pcm[i] * b->pcm[i];
+        noise += d * d;
+    }
+    return 10 * log10(signal / noise);
+}
+
+static void test_sync(void) {
+    static stream_t s;
+    static uint8_t damaged[MAX_STREAM + 1024];
+    static capture_t clean, cap, exp;
+    load_stream("aac_stereo", &s);
+    const int k = 10;
+    feed(s.data, s.len, &clean);
+    expected(&s, -1, false, &exp);
+    CHECK(same_output(&clean, &exp));
+    CHECK(clean.frames == (size_t)s.frames * AAC_FRAME_SAMPLES);
+
+    // Frame k's syncword broken: the frame is concealed in its place, so
+    // the timing holds, and the rest decodes as if it had been lost in
+    // transit. Frame k + 1 starts without its overlap; after that, only
+    // noise-substituted bands differ from the undamaged stream, their
+    // generator being a frame behind.
+    memcpy(damaged, s.data, s.len);
+    damaged[s.offset[k] + 1] &= ~0x10;
+    feed(damaged, s.len, &cap);
+    expected(&s, k, false, &exp);
+    CHECK(same_output(&cap, &exp));
+    double after_db = difference_db(&cap, &clean, k + 2, s.frames);
+    CHECK(after_db > 20);
+
+    // A frame length past the decoder's limit is no header either.
+    memcpy(damaged, s.data, s.len);
+    damaged[s.offset[k] + 3] |= 0x03;
+    damaged[s.offset[k] + 4] = 0xff;
+    feed(damaged, s.len, &cap);
+    CHECK(same_output(&cap, &exp));
+
+    // 700 bytes of junk, 0xFF among them, between frames k - 1 and k:
+    // sync is lost once, one frame concealed for it, and every frame of the
+    // stream still decoded.
+    size_t junk = 700;
+    memcpy(damaged, s.data, s.offset[k]);
+    uint32_t seed = 7;
+    for (size_t i = 0; i < junk; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        damaged[s.offset[k] + i] = i % 97 == 0 ? 0xff : seed >> 24;
+    }
+    memcpy(damaged + s.offset[k] + junk, s.data + s.offset[k], s.len - s.offset[k]);
+    feed(damaged, s.len + junk, &cap);
+    expected(&s, k, true, &exp);
+    CHECK(same_output(&cap, &exp));
+    printf("sync: damaged header and %zu bytes of junk recovered from; %.1f dB from the undamaged stream "
+           "after the lost frame\n", junk, after_db);
+}
+
+int main(void) {
+    host_log_quiet(true);
+    ingest_init();
+    test_reference();
+    test_headers();
+    test_sync();
+    CHECK_DONE();
+}
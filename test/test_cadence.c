@@ -0,0 +1,94 @@
+/*
+ * a2d_data_cb cadence statistics, driven under the manual clock with a
+ * known call pattern and read back from the "cadence" command.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "a2d_cadence.h"
+#include "audio_bridge.h"
+#include "check.h"
+#include "harness.h"
+#include "host.h"
+#include "log_ring.h"
+
+typedef struct {
+    unsigned long calls, late;
+    double span_s, mean_ms, min_ms, max_ms, jitter_ms, rate, ppm;
+    char hist[256];
+} report_t;
+
+static bool report(report_t *r) {
+    harness_exec("cadence");
+    const char *out = harness_output();
+    const char *l2 = strstr(out, "\ncadence: ");
+    const char *hist = strstr(out, "histogram (ms):");
+    if (!l2 || !hist) {
+        return false;
+    }
+    unsigned nominal;
+    sscanf(hist + strlen("histogram (ms):"), "%255[^\n]", r->hist);
+    return sscanf(out, "cadence: %lu calls over %lf s, interval mean %lf ms, min %lf, max %lf, "
+                  "jitter (stddev) %lf ms", &r->calls, &r->span_s, &r->mean_ms, &r->min_ms, &r->max_ms,
+                  &r->jitter_ms) == 6 &&
+           sscanf(l2 + 1, "cadence: %lf bytes/s pulled (nominal %u, %lf ppm), %lu late calls", &r->rate,
+                  &nominal, &r->ppm, &r->late) == 4;
+}
+
+int main(void) {
+    host_log_quiet(true);
+    log_ring_init();
+    a2d_cadence_init();
+    host_clock_manual(1000000);
+
+    // Not enough to go on yet.
+    a2d_cadence_record(2048);
+    report_t r;
+    CHECK(!report(&r));
+    CHECK(strstr(harness_output(), "not enough calls") != NULL);
+    harness_exec("cadence reset");
+
+    // 512-frame pulls from a Bluetooth clock 100 ppm fast, alternating
+    // 1 ms early and late: the rate shows the drift, the jitter the wobble.
+    const double period_us = 512 * 1e6 / AUDIO_SAMPLE_RATE / (1 + 100e-6);
+    const int calls = 6001;
+    int64_t prev_us = 0;
+    for (int i = 0; i < calls; i++) {
+        int64_t at_us = (int64_t)(i * period_us) + (i % 2 ? 1000 : -1000) * (i > 0 && i < calls - 1);
+        host_clock_advance(at_us - prev_us);
+        prev_us = at_us;
+        a2d_cadence_record(512 * AUDIO_BYTES_PER_FRAME);
+    }
+    CHECK(report(&r));
+    CHECK(r.calls == calls);
+    CHECK_NEAR(r.span_s, (calls - 1) * period_us / 1e6, 0.05);
+    CHECK_NEAR(r.mean_ms, period_us / 1000, 0.01);
+    CHECK_NEAR(r.min_ms, period_us / 1000 - 2, 0.01);
+    CHECK_NEAR(r.max_ms, period_us / 1000 + 2, 0.01);
+    CHECK_NEAR(r.jitter_ms, 2, 0.01);
+    CHECK_NEAR(r.ppm, 100, 2);
+    CHECK(r.late == 0);
+    // All intervals, 9.6 and 13.6 ms, in the 8-16 ms bin.
+    char want[128];
+    snprintf(want, sizeof(want), " <1:0 1-2:0 2-4:0 4-8:0 8-16:%d 16-32:0 32-64:0 64-128:0 >=128:0", calls - 1);
+    CHECK(strcmp(r.hist, want) == 0);
+    CHECK(strstr(harness_output(), "len   2048: 6001 calls (100.0%)") != NULL);
+    CHECK_NEAR(a2d_cadence_interval_us(), period_us, 300);
+
+    // A stall of ten intervals is a late call; requests of other sizes are
+    // counted by size.
+    harness_exec("cadence reset");
+    for (int i = 0; i < 100; i++) {
+        host_clock_advance(i == 50 ? 116100 : 11610);
+        a2d_cadence_record(i % 4 == 0 ? 4096 : 2048);
+    }
+    CHECK(report(&r));
+    CHECK(r.late == 1);
+    CHECK_NEAR(r.max_ms, 116.1, 0.001);
+    CHECK(strstr(r.hist, " 64-128:1 ") != NULL);
+    CHECK(strstr(harness_output(), "len   4096: 25 calls") != NULL);
+    CHECK(strstr(harness_output(), "len   2048: 75 calls") != NULL);
+
+    CHECK_DONE();
+}
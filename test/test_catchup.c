@@ -0,0 +1,153 @@
+/*
+ * Catch-up stage against senders that are and are not paced to real time.
+ *
+ * The sender's audio waits in a modelled TCP queue, and the TCP task moves
+ * it into the bridge while the writer is not blocked; the Bluetooth stack
+ * reads on the bridge's clock through fake_bridge_play(). Everything runs
+ * on one thread under the manual clock. How much was played fast is read
+ * back from the "catchup" command.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio_bridge.h"
+#include "catchup.h"
+#include "check.h"
+#include "fake_bridge.h"
+#include "harness.h"
+#include "host.h"
+
+#define SEND_FRAMES     256
+#define PLAY_FRAMES     512
+
+typedef struct {
+    double shed_ms;
+    unsigned long give_ups;
+    bool paced;
+} status_t;
+
+static status_t status(void) {
+    harness_exec("catchup");
+    const char *out = harness_output();
+    status_t s = { 0 };
+    const char *line = strstr(out, "ms shed in total");
+    CHECK(line != NULL);
+    while (line && line > out && line[-1] != '\n') {
+        line--;
+    }
+    CHECK(line && sscanf(line, " %lf ms shed in total, %*lu hops, %*lu corrections, %lu given up", &s.shed_ms,
+                         &s.give_ups) == 2);
+    s.paced = strstr(out, "not known to be paced") == NULL;
+    return s;
+}
+
+// --- Closed loop ---
+static int64_t s_now_us;
+static uint64_t s_played_blocks;
+static uint64_t s_made_frames;
+static uint64_t s_queued_frames;        // Waiting in TCP
+static uint32_t s_phase;
+
+static void send_chunk(void) {
+    int16_t chunk[SEND_FRAMES * 2];
+    for (int f = 0; f < SEND_FRAMES; f++) {
+        // 441 Hz, so WSOLA has something periodic to splice.
+        int16_t v = (int16_t)(8000 * sinf(2 * (float)M_PI * (s_phase++ % 100) / 100));
+        chunk[2 * f] = v;
+        chunk[2 * f + 1] = v;
+    }
+    audio_bridge_write(AUDIO_SOURCE_NETWORK, chunk, sizeof(chunk), portMAX_DELAY);
+}
+
+// Runs for seconds. A paced sender makes audio at real time, unless it is
+// stalled, when it still makes it but the network holds it back; an
+// unpaced one always has more to send than the bridge takes.
+static void run(double seconds, bool paced, bool stalled) {
+    int16_t block[PLAY_FRAMES * 2];
+    int64_t end_us = s_now_us + (int64_t)(seconds * 1e6);
+    while (s_now_us < end_us) {
+        int64_t next_play_us = (int64_t)(s_played_blocks * PLAY_FRAMES * 1e6 / AUDIO_SAMPLE_RATE);
+        int64_t next_make_us = (int64_t)(s_made_frames * 1e6 / AUDIO_SAMPLE_RATE);
+        int64_t t = paced && next_make_us < next_play_us ? next_make_us : next_play_us;
+        host_clock_advance(t - s_now_us);
+        s_now_us = t;
+
+        if (paced && s_now_us == next_make_us) {
+            s_made_frames += SEND_FRAMES;
+            s_queued_frames += SEND_FRAMES;
+        }
+        if (s_now_us == next_play_us) {
+            fake_bridge_play((uint8_t *)block, sizeof(block));
+            s_played_blocks++;
+        }
+        if (!paced) {
+            s_queued_frames = SEND_FRAMES * 64;
+        }
+        while (!stalled && s_queued_frames > 0 && !fake_bridge_blocked()) {
+            send_chunk();
+            s_queued_frames -= SEND_FRAMES;
+        }
+    }
+}
+
+static void new_session(void) {
+    audio_bridge_flush(AUDIO_SOURCE_NETWORK);
+    catchup_session_begin();
+    s_queued_frames = 0;
+    s_made_frames = (uint64_t)(s_now_us * 1e-6 * AUDIO_SAMPLE_RATE) / SEND_FRAMES * SEND_FRAMES;
+}
+
+int main(void) {
+    host_log_quiet(true);
+    catchup_init();
+    fake_bridge_use_catchup(true);
+    fake_bridge_set_connected(true);
+    host_clock_manual(0);
+
+    // A file pushed as fast as the bridge takes it keeps the buffer full:
+    // it is never proven paced and never played fast.
+    new_session();
+    status_t before = status();
+    run(120, false, false);
+    status_t s = status();
+    CHECK(!s.paced);
+    // Slowing down while the buffer first fills is allowed.
+    CHECK(s.shed_ms <= before.shed_ms + 0.5);
+    CHECK(s.give_ups == before.give_ups);
+    printf("unpaced   shed %5.0f ms  give-ups %lu\n", s.shed_ms - before.shed_ms, s.give_ups - before.give_ups);
+
+    // A live sender is proven paced within a few seconds. After a second's
+    // stall and the burst behind it, the backlog is played out fast.
+    new_session();
+    before = status();
+    run(10, true, false);
+    CHECK(status().paced);
+    run(1, true, true);
+    run(40, true, false);
+    s = status();
+    CHECK(s.paced);
+    CHECK(s.shed_ms - before.shed_ms > 900 && s.shed_ms - before.shed_ms < 1100);
+    CHECK(s.give_ups == before.give_ups);
+    CHECK(s_queued_frames < 2 * SEND_FRAMES);
+    printf("stall     shed %5.0f ms  give-ups %lu\n", s.shed_ms - before.shed_ms, s.give_ups - before.give_ups);
+
+    // One that was paced and then pushes faster is caught up with until
+    // catch-up gives up, and is not sped up again after that.
+    new_session();
+    before = status();
+    run(10, true, false);
+    CHECK(status().paced);
+    run(40, false, false);
+    status_t gave_up = status();
+    CHECK(gave_up.give_ups == before.give_ups + 1);
+    CHECK(!gave_up.paced);
+    run(120, false, false);
+    s = status();
+    CHECK_NEAR(s.shed_ms, gave_up.shed_ms, 0.5);
+    CHECK(s.give_ups == gave_up.give_ups);
+    printf("give-up   shed %5.0f ms  give-ups %lu\n", s.shed_ms - before.shed_ms, s.give_ups - before.give_ups);
+
+    CHECK_DONE();
+}
@@ -0,0 +1,100 @@
+/*
+ * ChaCha20-Poly1305 against RFC 8439, and records that must not open.
+ */
+
+#include <stdint.h>
+#include "check.h"
+#include "chachapoly.h"
+
+// RFC 8439 section 2.8.2.
+static const char PLAINTEXT[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for "
+                                "the future, sunscreen would be it.";
+static const uint8_t AAD[] = { 0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7 };
+static const uint8_t NONCE[CHACHAPOLY_NONCE_LEN] = {
+    0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+};
+static const uint8_t CIPHERTEXT[] = {
+    0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+    0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+    0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+    0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+    0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+    0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+    0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+    0x61, 0x16,
+};
+static const uint8_t TAG[CHACHAPOLY_TAG_LEN] = {
+    0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91,
+};
+
+#define LEN     (sizeof(PLAINTEXT) - 1)
+
+static uint8_t s_key[CHACHAPOLY_KEY_LEN];
+
+// Opening data under a changed tag, aad or nonce fails and leaves it as it was.
+static void check_refused(const uint8_t *data, const uint8_t *aad, const uint8_t *nonce, const uint8_t *tag) {
+    uint8_t buf[LEN];
+    memcpy(buf, data, LEN);
+    CHECK(!chachapoly_open(s_key, nonce, aad, sizeof(AAD), buf, LEN, tag));
+    CHECK_MEM(buf, data, LEN);
+}
+
+int main(void) {
+    for (int i = 0; i < CHACHAPOLY_KEY_LEN; i++) {
+        s_key[i] = 0x80 + i;
+    }
+    _Static_assert(sizeof(CIPHERTEXT) == LEN, "vector length");
+
+    uint8_t buf[LEN];
+    uint8_t tag[CHACHAPOLY_TAG_LEN];
+    memcpy(buf, PLAINTEXT, LEN);
+    chachapoly_seal(s_key, NONCE, AAD, sizeof(AAD), buf, LEN, tag);
+    CHECK_MEM(buf, CIPHERTEXT, LEN);
+    CHECK_MEM(tag, TAG, sizeof(TAG));
+
+    CHECK(chachapoly_open(s_key, NONCE, AAD, sizeof(AAD), buf, LEN, TAG));
+    CHECK_MEM(buf, PLAINTEXT, LEN);
+
+    // Every byte of ciphertext, aad, nonce and tag is covered.
+    uint8_t bad[LEN];
+    for (size_t i = 0; i < LEN; i++) {
+        memcpy(bad, CIPHERTEXT, LEN);
+        bad[i] ^= 0x01;
+        check_refused(bad, AAD, NONCE, TAG);
+    }
+    for (size_t i = 0; i < sizeof(AAD); i++) {
+        uint8_t aad[sizeof(AAD)];
+        memcpy(aad, AAD, sizeof(aad));
+        aad[i] ^= 0x80;
+        check_refused(CIPHERTEXT, aad, NONCE, TAG);
+    }
+    for (size_t i = 0; i < sizeof(NONCE); i++) {
+        uint8_t nonce[sizeof(NONCE)];
+        memcpy(nonce, NONCE, sizeof(nonce));
+        nonce[i] ^= 0x01;
+        check_refused(CIPHERTEXT, AAD, nonce, TAG);
+    }
+    for (size_t i = 0; i < sizeof(TAG); i++) {
+        memcpy(tag, TAG, sizeof(tag));
+        tag[i] ^= 0x01;
+        check_refused(CIPHERTEXT, AAD, NONCE, tag);
+    }
+
+    // Lengths around the 64-byte block and 16-byte Poly1305 boundaries
+    // round-trip, and a record cut short does not open.
+    for (size_t len = 0; len <= 130; len++) {
+        uint8_t msg[130], orig[130];
+        for (size_t i = 0; i < len; i++) {
+            orig[i] = (uint8_t)(i * 7 + len);
+        }
+        memcpy(msg, orig, len);
+        chachapoly_seal(s_key, NONCE, AAD, sizeof(AAD), msg, len, tag);
+        CHECK(len == 0 || memcmp(msg, orig, len) != 0);
+        if (len > 0) {
+            CHECK(!chachapoly_open(s_key, NONCE, AAD, sizeof(AAD), msg, len - 1, tag));
+        }
+        CHECK(chachapoly_open(s_key, NONCE, AAD, sizeof(AAD), msg, len, tag));
+        CHECK_MEM(msg, orig, len);
+    }
+    CHECK_DONE();
+}
@@ -0,0 +1,259 @@
+/*
+ * Three-band compressor: the static curve through its soft knee, attack and
+ * release times on a tone burst, the crossover sum at unity, and the fixed
+ * and float32 pipelines against each other. Each property is checked on
+ * both pipelines.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_bridge.h"
+#include "check.h"
+#include "compressor.h"
+
+#define TONE_HZ         12000.0     // In the high band, 58 dB down in the mid band
+#define CONTROL_MS      (1000.0 * COMPRESSOR_CONTROL_FRAMES / AUDIO_SAMPLE_RATE)
+#define CHUNK_FRAMES    4096
+#define SETTLED_FRAMES  (4 * CHUNK_FRAMES)
+
+typedef void (*process_fn)(compressor_t *c, int16_t *pcm, size_t frames);
+
+static const struct {
+    const char *name;
+    process_fn process;
+} s_pipelines[] = {
+    { "fixed", compressor_process_fixed },
+    { "float", compressor_process_float },
+};
+
+// The smoothed reduction of a band in dB, read from the pipeline's own state.
+static double reduction_db(const compressor_t *c, int pipeline, int band) {
+    return pipeline == 0 ? -c->band[band].gain * 6.0206 / 65536 : -c->band[band].gain_f * 6.0206;
+}
+
+static void fill_tone(int16_t *pcm, size_t frames, double hz, double dbfs, size_t start) {
+    double amp = 32767 * pow(10, dbfs / 20);
+    for (size_t i = 0; i < frames; i++) {
+        int16_t v = (int16_t)lrint(amp * sin(2 * M_PI * hz * (start + i) / AUDIO_SAMPLE_RATE));
+        pcm[2 * i] = v;
+        pcm[2 * i + 1] = v;
+    }
+}
+
+static double rms(const int16_t *pcm, size_t frames) {
+    double sum = 0;
+    for (size_t i = 0; i < frames; i++) {
+        sum += (double)pcm[2 * i] * pcm[2 * i];
+    }
+    return sqrt(sum / frames);
+}
+
+// Magnitude of the high band at hz in dB: the LR4 high-pass, the square of
+// a bilinear Butterworth, so frequencies are prewarped.
+static double high_band_db(double hz, double crossover_hz) {
+    double r = tan(M_PI * hz / AUDIO_SAMPLE_RATE) / tan(M_PI * crossover_hz / AUDIO_SAMPLE_RATE);
+    return 20 * log10(pow(r, 4) / (1 + pow(r, 4)));
+}
+
+// The same setting in every band, no make-up gain.
+static void uniform_params(compressor_params_t *p, float threshold_db, float ratio, float attack_ms,
+                           float release_ms) {
+    compressor_params_night(p);
+    for (int b = 0; b < COMPRESSOR_BANDS; b++) {
+        p->band[b] = (compressor_band_params_t){
+            .threshold_db = threshold_db,
+            .ratio = ratio,
+            .knee_db = 6,
+            .attack_ms = attack_ms,
+            .release_ms = release_ms,
+            .makeup_db = 0,
+        };
+    }
+}
+
+static void test_static_curve(void) {
+    // Band levels across the knee (-23 to -17 dB) and either side of it:
+    // below it nothing, through it the quadratic, above it 1 - 1/ratio of
+    // the overshoot. A fast attack and slow release make the reduction the
+    // one for the tone's peak rather than for each block's.
+    static const double levels[] = { -40, -26, -23, -21.5, -20, -18.5, -17, -12, -6 };
+    const double threshold = -20, ratio = 4, knee = 6;
+    compressor_params_t p;
+    uniform_params(&p, threshold, ratio, 0.5f, 500);
+    double band_db = high_band_db(TONE_HZ, p.crossover_hz[1]);
+    static int16_t pcm[2 * CHUNK_FRAMES];
+
+    for (int k = 0; k < 2; k++) {
+        double worst = 0, worst_out = 0;
+        for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+            double over = levels[l] - threshold;
+            double expected = 0;
+            if (2 * over >= knee) {
+                expected = over * (1 - 1 / ratio);
+            } else if (2 * over > -knee) {
+                expected = (over + knee / 2) * (over + knee / 2) / (2 * knee) * (1 - 1 / ratio);
+            }
+            compressor_t c;
+            compressor_init(&c, &p, AUDIO_SAMPLE_RATE);
+            double in_db = levels[l] - band_db;
+            for (int n = 0; n < 8; n++) {
+                fill_tone(pcm, CHUNK_FRAMES, TONE_HZ, in_db, (size_t)n * CHUNK_FRAMES);
+                s_pipelines[k].process(&c, pcm, CHUNK_FRAMES);
+            }
+            double got = reduction_db(&c, k, 2);
+            double out_db = 20 * log10(rms(pcm, CHUNK_FRAMES) * M_SQRT2 / 32767);
+            worst = fmax(worst, fabs(got - expected));
+            worst_out = fmax(worst_out, fabs(in_db - out_db - expected));
+            CHECK(reduction_db(&c, k, 0) == 0 && reduction_db(&c, k, 1) == 0);
+        }
+        printf("%s: static curve within %.3f dB, output level within %.3f dB\n", s_pipelines[k].name, worst,
+               worst_out);
+        CHECK(worst < 0.02);
+        CHECK(worst_out < 0.05);
+    }
+}
+
+static void test_attack_release(void) {
+    // A -40, -6, -40 dB burst: the reduction moves toward its target by
+    // the same share each control period, so it gets 63 % of the way in
+    // attack_ms and back to 37 % in release_ms, give or take a period for
+    // where the crossing falls and one for the ripple on the steady value.
+    const int steps = AUDIO_SAMPLE_RATE / COMPRESSOR_CONTROL_FRAMES;     // Each level lasts a second
+    const double attack_ms = 10, release_ms = 200;
+    compressor_params_t p;
+    uniform_params(&p, -30, 4, attack_ms, release_ms);
+    int16_t pcm[2 * COMPRESSOR_CONTROL_FRAMES];
+    double *reduction = malloc(3 * steps * sizeof(double));
+
+    for (int k = 0; k < 2; k++) {
+        compressor_t c;
+        compressor_init(&c, &p, AUDIO_SAMPLE_RATE);
+        static const double levels[3] = { -40, -6, -40 };
+        for (int s = 0; s < 3 * steps; s++) {
+            fill_tone(pcm, COMPRESSOR_CONTROL_FRAMES, TONE_HZ, levels[s / steps], (size_t)s * COMPRESSOR_CONTROL_FRAMES);
+            s_pipelines[k].process(&c, pcm, COMPRESSOR_CONTROL_FRAMES);
+            reduction[s] = reduction_db(&c, k, 2);
+        }
+        CHECK(reduction[steps - 1] == 0);
+        double steady = reduction[2 * steps - 1];
+        int attack = steps, release = steps;
+        for (int s = 0; s < steps; s++) {
+            if (attack == steps && reduction[steps + s] >= 0.632 * steady) {
+                attack = s + 1;
+            }
+            if (release == steps && reduction[2 * steps + s] <= 0.368 * steady) {
+                release = s + 1;
+            }
+        }
+        printf("%s: %.1f dB reduction, attack %.2f ms, release %.2f ms\n", s_pipelines[k].name, steady,
+               attack * CONTROL_MS, release * CONTROL_MS);
+        CHECK(steady > 15 && steady < 20);
+        CHECK_NEAR(attack * CONTROL_MS, attack_ms, 2 * CONTROL_MS);
+        CHECK_NEAR(release * CONTROL_MS, release_ms, 2 * CONTROL_MS);
+    }
+    free(reduction);
+}
+
+static void test_crossover_sum(void) {
+    // Ratio 1 everywhere: the bands sum to an all-pass, so tones from 30 Hz
+    // to 16 kHz, the crossover frequencies among them, come out at the
+    // level they went in.
+    double tones[48];
+    int n_tones = 0;
+    compressor_params_t p;
+    uniform_params(&p, -30, 1, 5, 100);
+    tones[n_tones++] = p.crossover_hz[0];
+    tones[n_tones++] = p.crossover_hz[1];
+    for (double hz = 30; hz < 16000; hz *= 1.2) {
+        tones[n_tones++] = hz;
+    }
+    static int16_t in[2 * SETTLED_FRAMES], out[2 * SETTLED_FRAMES];
+
+    for (int k = 0; k < 2; k++) {
+        double worst = 0;
+        for (int t = 0; t < n_tones; t++) {
+            compressor_t c;
+            compressor_init(&c, &p, AUDIO_SAMPLE_RATE);
+            // Two chunks let the filters settle; the level is taken over a
+            // whole number of periods of what follows.
+            for (int n = 0; n < 2; n++) {
+                fill_tone(out, CHUNK_FRAMES, tones[t], -6, (size_t)n * CHUNK_FRAMES);
+                s_pipelines[k].process(&c, out, CHUNK_FRAMES);
+            }
+            fill_tone(in, SETTLED_FRAMES, tones[t], -6, 2 * CHUNK_FRAMES);
+            memcpy(out, in, sizeof(out));
+            s_pipelines[k].process(&c, out, SETTLED_FRAMES);
+            double period = AUDIO_SAMPLE_RATE / tones[t];
+            size_t frames = lrint(floor(SETTLED_FRAMES / period) * period);
+            worst = fmax(worst, fabs(20 * log10(rms(out, frames) / rms(in, frames))));
+        }
+        printf("%s: crossover sum within %.4f dB over %d tones\n", s_pipelines[k].name, worst, n_tones);
+        CHECK(worst < 0.002);
+    }
+}
+
+static void test_fixed_float(void) {
+    // The night settings on programme-like material, noise and tones
+    // under an envelope that swings 40 dB. With every ratio at 1 the two
+    // pipelines differ by dither and rounding, about 0.6 LSB rms; the gain
+    // computers' log2 and exp2 approximations add the rest, about 0.1 % of
+    // the peak at worst.
+    const size_t frames = 2 * AUDIO_SAMPLE_RATE;
+    int16_t *in = malloc(frames * AUDIO_BYTES_PER_FRAME);
+    int16_t *fixed = malloc(frames * AUDIO_BYTES_PER_FRAME);
+    int16_t *flt = malloc(frames * AUDIO_BYTES_PER_FRAME);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < frames; i++) {
+        double t = (double)i / AUDIO_SAMPLE_RATE;
+        double env = pow(10, (-30 + 20 * sin(2 * M_PI * 1.3 * t)) / 20);
+        for (int ch = 0; ch < 2; ch++) {
+            seed = seed * 1664525u + 1013904223u;
+            double noise = ((int32_t)(seed >> 8) / 8388608.0 - 1) * 0.3;
+            double tones = 0.4 * sin(2 * M_PI * (90 + 10 * ch) * t) + 0.3 * sin(2 * M_PI * 1200 * t) +
+                           0.2 * sin(2 * M_PI * 7000 * t);
+            in[2 * i + ch] = (int16_t)lrint(32767 * env * (noise + tones));
+        }
+    }
+    memcpy(fixed, in, frames * AUDIO_BYTES_PER_FRAME);
+    memcpy(flt, in, frames * AUDIO_BYTES_PER_FRAME);
+
+    compressor_params_t p;
+    compressor_params_night(&p);
+    compressor_t cf, cq;
+    compressor_init(&cq, &p, AUDIO_SAMPLE_RATE);
+    compressor_init(&cf, &p, AUDIO_SAMPLE_RATE);
+    for (size_t at = 0; at < frames; at += 512) {
+        compressor_process_fixed(&cq, fixed + 2 * at, 512);
+        compressor_process_float(&cf, flt + 2 * at, 512);
+    }
+
+    double sum = 0, signal = 0;
+    int worst = 0, peak = 0;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        int d = abs(fixed[i] - flt[i]);
+        worst = d > worst ? d : worst;
+        peak = abs(fixed[i]) > peak ? abs(fixed[i]) : peak;
+        sum += (double)d * d;
+        signal += (double)fixed[i] * fixed[i];
+    }
+    double diff_rms = sqrt(sum / (2 * frames));
+    printf("fixed vs float: %.2f LSB rms, %d LSB worst; output %.1f LSB rms, peak %d\n", diff_rms, worst,
+           sqrt(signal / (2 * frames)), peak);
+    CHECK(cq.clipped == 0 && cf.clipped == 0);
+    CHECK(diff_rms < 2.5);
+    CHECK(worst < peak / 500);
+    free(in);
+    free(fixed);
+    free(flt);
+}
+
+int main(void) {
+    test_static_curve();
+    test_attack_release();
+    test_crossover_sum();
+    test_fixed_float();
+    CHECK_DONE();
+}
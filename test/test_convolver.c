@@ -0,0 +1,274 @@
+/*
+ * Partitioned convolver: output against a direct convolution in double
+ * precision for response lengths on and either side of partition
+ * boundaries, with two and four paths, and delayed impulses passed bit for
+ * bit. Through the IR filter, with responses in a flash image: output a
+ * partition behind the input, and a response loaded mid-stream taking over
+ * with nothing of the old one left and no frame lost.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_bridge.h"
+#include "check.h"
+#include "convolver.h"
+#include "harness.h"
+#include "host.h"
+#include "ir_filter.h"
+
+#define MAX_TAPS        2048
+#define BLOCKS          24
+#define STREAM_FRAMES   (40 * 64)
+
+typedef struct {
+    int taps;
+    float h[4][MAX_TAPS];               // [path][tap]
+} response_t;
+
+static int read_response(void *ctx, int path, int offset, float *taps, int count) {
+    const response_t *r = ctx;
+    memcpy(taps, r->h[path] + offset, count * sizeof(float));
+    return 0;
+}
+
+static uint32_t s_seed = 1;
+
+static double noise(void) {
+    s_seed = s_seed * 1664525u + 1013904223u;
+    return (int32_t)s_seed / 2147483648.0;
+}
+
+// Noise decaying by 60 dB over the response, scaled to unit energy per
+// path so noise keeps its level.
+static void decaying(response_t *r, int taps, int paths) {
+    r->taps = taps;
+    for (int p = 0; p < paths; p++) {
+        double energy = 0;
+        for (int j = 0; j < taps; j++) {
+            r->h[p][j] = noise() * exp(-6.9 * j / taps);
+            energy += r->h[p][j] * r->h[p][j];
+        }
+        for (int j = 0; j < taps; j++) {
+            r->h[p][j] /= sqrt(energy);
+        }
+    }
+}
+
+static void fill_noise(int16_t *pcm, size_t frames) {
+    for (size_t i = 0; i < 2 * frames; i++) {
+        pcm[i] = (int16_t)lrint(6000 * noise());
+    }
+}
+
+static convolver_t *create(int partition, const response_t *r, int paths) {
+    convolver_t *c = convolver_create(malloc(convolver_size(partition, r->taps, paths)), partition, r->taps, paths);
+    CHECK(convolver_load(c, read_response, (void *)r) == 0);
+    return c;
+}
+
+// Output channel ch at frame f of in[from..] convolved with r.
+static double direct(const int16_t *in, const response_t *r, int paths, int ch, int f, int from) {
+    double y = 0;
+    for (int j = 0; j < r->taps && f - j >= from; j++) {
+        if (paths == 2) {
+            y += r->h[ch][j] * in[2 * (f - j) + ch];
+        } else {
+            y += r->h[ch][j] * in[2 * (f - j)] + r->h[2 + ch][j] * in[2 * (f - j) + 1];
+        }
+    }
+    return y;
+}
+
+// RMS difference over frames [from, to) between out and in[start..] through r.
+static double error_rms(const int16_t *out, const int16_t *in, const response_t *r, int paths, int from, int to,
+                        int start, int *worst) {
+    double sum = 0;
+    for (int f = from; f < to; f++) {
+        for (int ch = 0; ch < 2; ch++) {
+            double e = out[2 * f + ch] - direct(in, r, paths, ch, f, start);
+            sum += e * e;
+            if (worst && fabs(e) > *worst) {
+                *worst = (int)ceil(fabs(e));
+            }
+        }
+    }
+    return sqrt(sum / (2 * (to - from)));
+}
+
+// --- Convolver ---
+static void test_direct(void) {
+    // Rounding to 16 bits alone is 0.29 LSB rms; the fixed-point transforms
+    // and 16-bit response spectra add about as much again.
+    static const int lengths[] = { 1, 31, 32, 33, 63, 64, 65, 100, 255, 256, 257, 1000, 1024, 1025 };
+    static const int partitions[] = { 32, 64, 256 };
+    static response_t r;
+    static int16_t in[2 * BLOCKS * 256], out[2 * BLOCKS * 256];
+
+    for (int paths = 2; paths <= 4; paths += 2) {
+        double worst_rms = 0;
+        int worst = 0;
+        for (size_t pi = 0; pi < sizeof(partitions) / sizeof(partitions[0]); pi++) {
+            int n = partitions[pi];
+            for (size_t li = 0; li < sizeof(lengths) / sizeof(lengths[0]); li++) {
+                decaying(&r, lengths[li], paths);
+                convolver_t *c = create(n, &r, paths);
+                fill_noise(in, BLOCKS * n);
+                memcpy(out, in, 2 * BLOCKS * n * sizeof(int16_t));
+                for (int b = 0; b < BLOCKS; b++) {
+                    convolver_process(c, out + 2 * b * n);
+                }
+                CHECK(convolver_clipped(c) == 0);
+                worst_rms = fmax(worst_rms, error_rms(out, in, &r, paths, 0, BLOCKS * n, 0, &worst));
+                free(c);
+            }
+        }
+        printf("%d paths: worst %.2f LSB rms, %d LSB peak\n", paths, worst_rms, worst);
+        CHECK(worst_rms < 0.8);
+        CHECK(worst <= 3);
+    }
+}
+
+static void test_delta(void) {
+    // A unit impulse at tap d, in the first partition, on its last tap or
+    // in the second: the input d frames later, bit for bit.
+    static response_t r;
+    const int blocks = 4;
+    for (int n = CONVOLVER_MIN_PARTITION; n <= CONVOLVER_MAX_PARTITION; n *= 8) {
+        int16_t *in = malloc(2 * blocks * n * sizeof(int16_t));
+        int16_t *out = malloc(2 * blocks * n * sizeof(int16_t));
+        const int taps[] = { 0, n - 1, n, 2 * n - 1 };
+        for (int t = 0; t < 4; t++) {
+            int d = taps[t];
+            memset(&r, 0, sizeof(r));
+            r.taps = d + 1;
+            r.h[0][d] = 1;
+            r.h[1][d] = 1;
+            convolver_t *c = create(n, &r, 2);
+            fill_noise(in, blocks * n);
+            memcpy(out, in, 2 * blocks * n * sizeof(int16_t));
+            for (int b = 0; b < blocks; b++) {
+                convolver_process(c, out + 2 * b * n);
+            }
+            for (int f = 0; f < d; f++) {
+                CHECK(out[2 * f] == 0 && out[2 * f + 1] == 0);
+            }
+            CHECK_MEM(out + 2 * d, in, (blocks * n - d) * 2 * sizeof(int16_t));
+            free(c);
+        }
+        free(in);
+        free(out);
+    }
+}
+
+// --- IR filter ---
+typedef struct {
+    int16_t pcm[2 * STREAM_FRAMES];
+    int frames;
+} capture_t;
+
+static size_t capture(const void *data, size_t len, void *ctx) {
+    capture_t *cap = ctx;
+    memcpy(cap->pcm + 2 * cap->frames, data, len);
+    cap->frames += len / AUDIO_BYTES_PER_FRAME;
+    return len;
+}
+
+// An image as tools/ir_pack.py builds it, with two-path responses.
+static uint8_t *build_image(const char *const names[], const response_t *const r[], int count, size_t *size) {
+    size_t pos = sizeof(ir_image_header_t) + count * sizeof(ir_image_entry_t);
+    size_t total = pos;
+    for (int i = 0; i < count; i++) {
+        total += 2 * r[i]->taps * sizeof(float);
+    }
+    uint8_t *image = calloc(1, total);
+    ir_image_header_t hdr = { .magic = IR_IMAGE_MAGIC, .count = count };
+    memcpy(image, &hdr, sizeof(hdr));
+    for (int i = 0; i < count; i++) {
+        ir_image_entry_t e = { .rate = AUDIO_SAMPLE_RATE, .taps = r[i]->taps, .paths = 2, .offset = pos };
+        memcpy(e.name, names[i], strlen(names[i]));
+        memcpy(image + sizeof(hdr) + i * sizeof(e), &e, sizeof(e));
+        for (int p = 0; p < 2; p++) {
+            memcpy(image + pos, r[i]->h[p], r[i]->taps * sizeof(float));
+            pos += r[i]->taps * sizeof(float);
+        }
+    }
+    *size = total;
+    return image;
+}
+
+static void test_filter_latency(const int16_t *in) {
+    // Frames come out a whole partition at a time, so each waits in the
+    // filter until its partition is complete: the latency reported is the
+    // partition plus what is held, and the output is the input up to the
+    // last complete partition.
+    static capture_t cap;
+    cap.frames = 0;
+    CHECK(harness_exec("ir load delta 64") == 0);
+    CHECK(ir_filter_latency_frames() == 64);
+    int written = 0;
+    for (int len = 1; written + len <= STREAM_FRAMES; len = len * 5 % 97 + 1) {
+        CHECK(ir_filter_write(in + 2 * written, len * AUDIO_BYTES_PER_FRAME, capture, &cap) ==
+              len * AUDIO_BYTES_PER_FRAME);
+        written += len;
+        CHECK(cap.frames == written / 64 * 64);
+        CHECK(ir_filter_latency_frames() == 64 + written % 64);
+    }
+    CHECK_MEM(cap.pcm, in, cap.frames * AUDIO_BYTES_PER_FRAME);
+}
+
+static void test_filter_swap(const int16_t *in, const response_t *a, const response_t *b) {
+    // Half a partition into the stream, b replaces a. What was held for a
+    // goes out unfiltered, and from there on the output is b over the input
+    // since, as from a fresh filter: nothing of a's tail and no frame lost.
+    static capture_t cap;
+    cap.frames = 0;
+    const int n = 64, before = 10 * n + n / 2;
+    CHECK(harness_exec("ir load a 64") == 0);
+    CHECK(ir_filter_write(in, before * AUDIO_BYTES_PER_FRAME, capture, &cap) == before * AUDIO_BYTES_PER_FRAME);
+    CHECK(cap.frames == 10 * n);
+    CHECK(harness_exec("ir load b 64") == 0);
+    int rest = STREAM_FRAMES - before;
+    CHECK(ir_filter_write(in + 2 * before, rest * AUDIO_BYTES_PER_FRAME, capture, &cap) ==
+          rest * AUDIO_BYTES_PER_FRAME);
+    CHECK(cap.frames == before + rest / n * n);
+
+    double rms_a = error_rms(cap.pcm, in, a, 2, 0, 10 * n, 0, NULL);
+    CHECK_MEM(cap.pcm + 2 * 10 * n, in + 2 * 10 * n, (before - 10 * n) * AUDIO_BYTES_PER_FRAME);
+    double rms_b = error_rms(cap.pcm, in, b, 2, before, cap.frames, before, NULL);
+    printf("swap: %.2f LSB rms from a before, %.2f from b after\n", rms_a, rms_b);
+    CHECK(rms_a < 0.8 && rms_b < 0.8);
+}
+
+static void test_filter(void) {
+    static response_t delta, a, b;
+    delta.taps = 1;
+    delta.h[0][0] = 1;
+    delta.h[1][0] = 1;
+    decaying(&a, 700, 2);
+    decaying(&b, 300, 2);
+    static const char *const names[] = { "delta", "a", "b" };
+    const response_t *const responses[] = { &delta, &a, &b };
+    size_t size;
+    uint8_t *image = build_image(names, responses, 3, &size);
+    host_partition_set(IR_PARTITION_LABEL, IR_PARTITION_SUBTYPE, image, size);
+    ir_filter_init();
+
+    static int16_t in[2 * STREAM_FRAMES];
+    fill_noise(in, STREAM_FRAMES);
+    test_filter_latency(in);
+    ir_filter_reset();
+    test_filter_swap(in, &a, &b);
+    CHECK(harness_exec("ir off") == 0);
+    free(image);
+}
+
+int main(void) {
+    host_log_quiet(true);
+    test_direct();
+    test_delta();
+    test_filter();
+    CHECK_DONE();
+}
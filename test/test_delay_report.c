@@ -0,0 +1,123 @@
+/*
+ * Delay reports: nothing is sent before the control channel is up, then
+ * "E delay" lines reach a controller with the parts adding up to the total,
+ * the sink's own figure taking over from the estimate while it reports.
+ * Runs the report task on the real clock over a loopback connection.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "audio_bridge.h"
+#include "a2d_cadence.h"
+#include "catchup.h"
+#include "check.h"
+#include "control_channel.h"
+#include "delay_report.h"
+#include "esp_timer.h"
+#include "harness.h"
+#include "host.h"
+#include "ir_filter.h"
+#include "log_ring.h"
+#include "secure_link.h"
+
+#define FILL_MS     50
+
+typedef struct {
+    double total, buffer, pipeline, bt, sink;
+    char from[16];
+} report_t;
+
+// Reads up to the next delay report.
+static bool next_report(int sock, report_t *r) {
+    char line[256];
+    while (harness_read_line(sock, line, sizeof(line))) {
+        if (sscanf(line, "E delay total=%lf buffer=%lf pipeline=%lf bt=%lf sink=%lf sink_from=%15s", &r->total,
+                   &r->buffer, &r->pipeline, &r->bt, &r->sink, r->from) == 6) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads reports until one whose sink part is sink_ms, from from.
+static bool report_with_sink(int sock, double sink_ms, const char *from, report_t *r) {
+    for (int i = 0; i < 20; i++) {
+        if (!next_report(sock, r)) {
+            return false;
+        }
+        if (r->sink > sink_ms - 0.05 && r->sink < sink_ms + 0.05 && strcmp(r->from, from) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void check_sum(const report_t *r) {
+    // Each part is printed to a tenth.
+    CHECK_NEAR(r->total, r->buffer + r->pipeline + r->bt + r->sink, 0.25);
+    CHECK_NEAR(r->buffer, FILL_MS, 0.1);
+    CHECK(r->pipeline == 0);
+}
+
+int main(void) {
+    host_log_quiet(true);
+    log_ring_init();
+    a2d_cadence_init();
+    catchup_init();
+    ir_filter_init();
+    secure_link_init();
+    delay_report_init();
+
+    // Before the channel is up there is no one to send to, and no lock to
+    // take: the line is dropped.
+    control_channel_send_line("E delay total=0.0\n");
+
+    CHECK(harness_exec("delay sink 1001") != 0);
+    CHECK(harness_exec("delay sink -5") != 0);
+    CHECK(harness_exec("delay later 5") != 0);
+
+    // A steady fill, nothing ahead of the buffer.
+    static uint8_t fill[FILL_MS * AUDIO_BYTES_PER_SEC / 1000];
+    CHECK(audio_bridge_write(AUDIO_SOURCE_NETWORK, fill, sizeof(fill), 0) == sizeof(fill));
+
+    control_channel_start();
+    delay_report_start();
+    int sock = harness_control_connect();
+    CHECK(sock >= 0);
+
+    // The estimate for sinks that do not report.
+    report_t r;
+    CHECK(report_with_sink(sock, DELAY_REPORT_SINK_DEFAULT_MS, "estimate", &r));
+    check_sum(&r);
+
+    // A new estimate goes out straight away, well within the once a
+    // second of a steady delay.
+    int64_t start_us = esp_timer_get_time();
+    CHECK(harness_exec("delay sink 90") == 0);
+    CHECK(report_with_sink(sock, 90, "estimate", &r));
+    CHECK(esp_timer_get_time() - start_us < 500000);
+    check_sum(&r);
+
+    // The sink's own figure while it reports, then the estimate again.
+    delay_report_sink_reported(423);
+    CHECK(report_with_sink(sock, 42.3, "avdtp", &r));
+    check_sum(&r);
+    delay_report_sink_lost();
+    CHECK(report_with_sink(sock, 90, "estimate", &r));
+    check_sum(&r);
+
+    // Holding still, it is reported about once a second, not every check.
+    start_us = esp_timer_get_time();
+    int reports = 0;
+    while (esp_timer_get_time() - start_us < 2500000 && next_report(sock, &r)) {
+        reports++;
+    }
+    printf("%d reports in 2.5 s while steady\n", reports);
+    CHECK(reports >= 2 && reports <= 4);
+
+    close(sock);
+    CHECK_DONE();
+}
@@ -0,0 +1,188 @@
+/*
+ * Downmix against a double-precision mix of the same matrix: within 3 LSB
+ * where nothing clips, saturating and counting where it does.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "downmix.h"
+#include "harness.h"
+#include "host.h"
+#include "ingest.h"
+
+#define FRAMES      1000        // Not a whole number of blocks
+
+static int16_t s_in[FRAMES * DOWNMIX_MAX_CHANNELS];
+static int16_t s_out[FRAMES * 2];
+static int16_t s_ref[FRAMES * 2];
+
+static void fill_noise(int channels, int amplitude, uint32_t seed) {
+    for (int i = 0; i < FRAMES * channels; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        s_in[i] = (int16_t)(((int32_t)(seed >> 16) - 32768) * amplitude / 32768);
+    }
+    // Full scale on every channel at once, both ways.
+    for (int c = 0; c < channels; c++) {
+        s_in[c] = INT16_MAX;
+        s_in[channels + c] = INT16_MIN;
+    }
+}
+
+// The mix in double precision with the matrix's gains, normalised as
+// downmix_init() does and saturated. Returns the samples that clipped.
+static int reference(const downmix_matrix_t *m, const uint8_t *layout, int channels) {
+    double g[2][DOWNMIX_MAX_CHANNELS] = { { 0 } };
+    double sum[2] = { 0, 0 };
+    for (int o = 0; o < 2; o++) {
+        for (int c = 0; c < channels; c++) {
+            g[o][c] = layout[c] < DOWNMIX_SPEAKERS ? m->gain[layout[c]][o] / 16384.0 : 0;
+            sum[o] += fabs(g[o][c]);
+        }
+    }
+    double peak = fmax(sum[0], sum[1]);
+    int clipped = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        for (int o = 0; o < 2; o++) {
+            double v = 0;
+            for (int c = 0; c < channels; c++) {
+                v += g[o][c] * s_in[f * channels + c];
+            }
+            if (m->normalize && peak > 1) {
+                v /= peak;
+            }
+            v = round(v);
+            if (v > INT16_MAX || v < INT16_MIN) {
+                clipped++;
+                v = v > 0 ? INT16_MAX : INT16_MIN;
+            }
+            s_ref[2 * f + o] = (int16_t)v;
+        }
+    }
+    return clipped;
+}
+
+static int worst_error(void) {
+    int worst = 0;
+    for (int i = 0; i < FRAMES * 2; i++) {
+        int e = abs(s_out[i] - s_ref[i]);
+        worst = e > worst ? e : worst;
+    }
+    return worst;
+}
+
+static void check_mix(const char *what, const downmix_matrix_t *m, const uint8_t *layout, int channels,
+                      int amplitude) {
+    downmix_t d;
+    fill_noise(channels, amplitude, channels);
+    int clipped = reference(m, layout, channels);
+    downmix_init(&d, m, layout, channels);
+    downmix_process(&d, s_in, s_out, FRAMES);
+    int worst = worst_error();
+    printf("%-24s %d ch  worst %d LSB  clipped %lu (reference %d)\n", what, channels, worst,
+           (unsigned long)d.clipped, clipped);
+    // A Q14 coefficient unit is 2 LSB at full scale; rounding leaves each
+    // within half a unit, and the few trimmed back to unity within one.
+    CHECK(worst <= 3);
+    // Rounding can tip a sample at the rails either way.
+    CHECK(abs((int)d.clipped - clipped) <= 2);
+}
+
+static void test_itu(void) {
+    downmix_matrix_t m;
+    downmix_matrix_itu(&m);
+    uint8_t layout[DOWNMIX_MAX_CHANNELS];
+    for (int channels = 3; channels <= DOWNMIX_MAX_CHANNELS; channels++) {
+        downmix_layout_wav(0, channels, layout);
+        check_mix("itu, wav order", &m, layout, channels, 32767);
+        downmix_layout_vorbis(channels, layout);
+        check_mix("itu, vorbis order", &m, layout, channels, 32767);
+    }
+
+    // Normalised, so full scale on every channel does not clip.
+    downmix_t d;
+    downmix_layout_wav(0, 6, layout);
+    downmix_init(&d, &m, layout, 6);
+    fill_noise(6, 32767, 1);
+    downmix_process(&d, s_in, s_out, FRAMES);
+    CHECK(d.clipped == 0);
+
+    // In place gives the same result.
+    int16_t copy[FRAMES * 6];
+    memcpy(copy, s_in, sizeof(copy));
+    downmix_process(&d, copy, copy, FRAMES);
+    CHECK_MEM(copy, s_out, sizeof(s_out));
+}
+
+static void test_unnormalised(void) {
+    // Everything into both outputs at full gain, LFE included: quiet input
+    // mixes exactly, loud input saturates and is counted.
+    downmix_matrix_t m;
+    memset(&m, 0, sizeof(m));
+    for (int s = 0; s < DOWNMIX_SPEAKERS; s++) {
+        m.gain[s][0] = 16384;
+        m.gain[s][1] = s % 2 ? -16384 : 8192;
+    }
+    uint8_t layout[DOWNMIX_MAX_CHANNELS];
+    downmix_layout_wav(0, 6, layout);
+    check_mix("unity, quiet", &m, layout, 6, 4000);
+    check_mix("unity, loud", &m, layout, 6, 32767);
+
+    // The largest gains on every channel: the coefficients give up fraction
+    // bits so the accumulator cannot overflow.
+    for (int s = 0; s < DOWNMIX_SPEAKERS; s++) {
+        m.gain[s][0] = DOWNMIX_GAIN_MAX;
+        m.gain[s][1] = -DOWNMIX_GAIN_MAX;
+    }
+    downmix_layout_wav(0, 8, layout);
+    check_mix("+6 dB everywhere, quiet", &m, layout, 8, 1000);
+    check_mix("+6 dB everywhere, loud", &m, layout, 8, 32767);
+}
+
+static void test_layouts(void) {
+    // 5.1 with side surrounds: FL FR FC LFE SL SR.
+    uint8_t layout[DOWNMIX_MAX_CHANNELS];
+    downmix_layout_wav(0x60F, 6, layout);
+    static const uint8_t want[] = { DOWNMIX_FL, DOWNMIX_FR, DOWNMIX_FC, DOWNMIX_LFE, DOWNMIX_SL, DOWNMIX_SR };
+    CHECK_MEM(layout, want, sizeof(want));
+    // A position past the matrix's rows, and channels beyond the mask, are
+    // dropped.
+    downmix_layout_wav(0x3 | 0x800, 4, layout);
+    CHECK(layout[0] == DOWNMIX_FL && layout[1] == DOWNMIX_FR);
+    CHECK(layout[2] == DOWNMIX_NONE && layout[3] == DOWNMIX_NONE);
+
+    for (int s = 0; s < DOWNMIX_SPEAKERS; s++) {
+        CHECK(downmix_speaker_from_name(downmix_speaker_name(s)) == s);
+    }
+    CHECK(downmix_speaker_from_name("top") == DOWNMIX_NONE);
+    CHECK(downmix_speaker_name(DOWNMIX_NONE) == NULL);
+}
+
+static void test_command(void) {
+    ingest_init();
+    CHECK(harness_exec("downmix normalize off") == 0);
+    CHECK(harness_exec("downmix") == 0);
+    CHECK(strstr(harness_output(), "normalize off:") != NULL);
+    // Anything but on or off is refused and changes nothing.
+    CHECK(harness_exec("downmix normalize of") != 0);
+    CHECK(harness_exec("downmix normalize") != 0);
+    CHECK(harness_exec("downmix normalize on") == 0);
+    CHECK(harness_exec("downmix normalize yes") != 0);
+    harness_exec("downmix");
+    CHECK(strstr(harness_output(), "normalize on:") != NULL);
+    CHECK(harness_exec("downmix fl 0.5 0.5") == 0);
+    CHECK(harness_exec("downmix top 0.5 0.5") != 0);
+    CHECK(harness_exec("downmix fl 3 0") != 0);
+}
+
+int main(void) {
+    host_log_quiet(true);
+    test_itu();
+    test_unnormalised();
+    test_layouts();
+    test_command();
+    CHECK_DONE();
+}
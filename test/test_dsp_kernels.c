@@ -0,0 +1,149 @@
+/*
+ * DSP kernels against double-precision references, within the float32
+ * rounding the kernels are allowed.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "biquad.h"
+#include "check.h"
+#include "dsp_kernels.h"
+
+#define N           1024
+#define TAPS        37          // Odd, so no unrolled loop ends evenly
+
+static float s_in[2 * N], s_in2[2 * N], s_out[2 * N];
+
+static void fill_noise(float *x, int n, uint32_t seed) {
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        x[i] = (int32_t)seed * (1.0f / 2147483648.0f);
+    }
+}
+
+static void test_mixing(void) {
+    fill_noise(s_in, 2 * N, 1);
+    fill_noise(s_in2, 2 * N, 2);
+    // Across interleaved frames, as the pipeline uses them.
+    dsp_gain(s_in, s_out, N, 0.7071f, 2, 1);
+    for (int i = 0; i < N; i++) {
+        CHECK(s_out[i] == s_in[2 * i] * 0.7071f);
+    }
+    dsp_add(s_in, s_in2, s_out, N, 1, 2, 2);
+    for (int i = 0; i < N; i++) {
+        CHECK(s_out[2 * i] == s_in[i] + s_in2[2 * i]);
+    }
+    memcpy(s_out, s_in, sizeof(s_out));
+    dsp_sub(s_out, s_in2, s_out, 2 * N, 1, 1, 1);
+    for (int i = 0; i < 2 * N; i++) {
+        CHECK(s_out[i] == s_in[i] - s_in2[i]);
+    }
+}
+
+static void test_biquad(void) {
+    biquad_t q;
+    biquad_peak(&q, 1000, 6, 1.0f, 44100);
+    double b0 = q.b0 / 268435456.0, b1 = q.b1 / 268435456.0, b2 = q.b2 / 268435456.0;
+    double a1 = q.a1 / 268435456.0, a2 = q.a2 / 268435456.0;
+
+    dsp_biquad_t f;
+    dsp_biquad_from_q28(&f, &q);
+    fill_noise(s_in, N, 3);
+    // In two calls, so the state carries over.
+    dsp_biquad(&f, s_in, s_out, N / 3);
+    dsp_biquad(&f, s_in + N / 3, s_out + N / 3, N - N / 3);
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0, worst = 0;
+    for (int i = 0; i < N; i++) {
+        double y = b0 * s_in[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = s_in[i];
+        y2 = y1;
+        y1 = y;
+        worst = fmax(worst, fabs(s_out[i] - y));
+    }
+    CHECK_NEAR(worst, 0, 1e-5);
+}
+
+static void test_fir(void) {
+    float h[TAPS], h_copy[TAPS], state[DSP_FIR_STATE_LEN(TAPS)];
+    fill_noise(h, TAPS, 4);
+    for (int k = 0; k < TAPS; k++) {
+        h[k] /= TAPS;
+    }
+    memcpy(h_copy, h, sizeof(h));
+
+    dsp_fir_t f;
+    dsp_fir_init(&f, h, state, TAPS);
+    CHECK_MEM(h, h_copy, sizeof(h));            // The caller's taps are left alone
+    fill_noise(s_in, N, 5);
+    dsp_fir(&f, s_in, s_out, 100);
+    dsp_fir(&f, s_in + 100, s_out + 100, N - 100);
+    double worst = 0;
+    for (int i = 0; i < N; i++) {
+        double y = 0;
+        for (int k = 0; k < TAPS && k <= i; k++) {
+            y += (double)h[k] * s_in[i - k];
+        }
+        worst = fmax(worst, fabs(s_out[i] - y));
+    }
+    CHECK_NEAR(worst, 0, 1e-6);
+
+    // The same taps set up twice give the same filter.
+    dsp_fir_t g;
+    float state2[DSP_FIR_STATE_LEN(TAPS)];
+    dsp_fir_init(&g, h, state2, TAPS);
+    float out2[N];
+    dsp_fir_c(&g, s_in, out2, N);
+    CHECK_MEM(out2, s_out, sizeof(out2));
+}
+
+// Largest error against a direct DFT, over the largest output magnitude.
+static double fft_error(const dsp_fft_t *t, int n, bool inverse) {
+    fill_noise(s_in, 2 * n, 6 + n);
+    memcpy(s_out, s_in, 2 * n * sizeof(float));
+    dsp_fft(t, s_out, n, inverse);
+    double worst = 0, peak = 0;
+    for (int k = 0; k < n; k++) {
+        double re = 0, im = 0;
+        for (int j = 0; j < n; j++) {
+            double a = (inverse ? 2 : -2) * M_PI * (double)j * k / n;
+            re += s_in[2 * j] * cos(a) - s_in[2 * j + 1] * sin(a);
+            im += s_in[2 * j] * sin(a) + s_in[2 * j + 1] * cos(a);
+        }
+        worst = fmax(worst, hypot(s_out[2 * k] - re, s_out[2 * k + 1] - im));
+        peak = fmax(peak, hypot(re, im));
+    }
+    return worst / peak;
+}
+
+static void test_fft(void) {
+    static float table[DSP_FFT_TABLE_LEN(N)];
+    dsp_fft_t t;
+    CHECK(dsp_fft_init(&t, table, N));
+    for (int n = 2; n <= N; n *= 4) {
+        CHECK_NEAR(fft_error(&t, n, false), 0, 1e-5);
+        CHECK_NEAR(fft_error(&t, n, true), 0, 1e-5);
+    }
+
+    // Forward then inverse gives the input times n.
+    fill_noise(s_in, 2 * N, 7);
+    memcpy(s_out, s_in, sizeof(s_out));
+    dsp_fft(&t, s_out, N, false);
+    dsp_fft(&t, s_out, N, true);
+    double worst = 0;
+    for (int i = 0; i < 2 * N; i++) {
+        worst = fmax(worst, fabs(s_out[i] / N - s_in[i]));
+    }
+    CHECK_NEAR(worst, 0, 1e-5);
+}
+
+int main(void) {
+    printf("kernels on %s\n", dsp_kernels_backend());
+    test_mixing();
+    test_biquad();
+    test_fir();
+    test_fft();
+    CHECK_DONE();
+}
@@ -0,0 +1,195 @@
+/*
+ * Float32 pipeline against fixed point: each stage "bench float" compares
+ * is run both ways on its noise and settings, and the outputs must stay as
+ * close as they were when the pipeline went in. Loudness steps are also
+ * held against an ideal crossfade, each coefficient set run in double
+ * precision over the whole input and the output faded between them on the
+ * filter's own schedule.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_bridge.h"
+#include "check.h"
+#include "compressor.h"
+#include "headphone_dsp.h"
+#include "loudness_eq.h"
+
+#define FRAMES          1024        // FLOAT_BENCH_FRAMES
+#define FADES           (FRAMES / LOUDNESS_EQ_FADE_FRAMES)
+
+typedef struct {
+    double rms;
+    int peak;
+} diff_t;
+
+// The bench's noise, about a quarter of full scale.
+static void fill_noise(int16_t *pcm) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2 * FRAMES; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pcm[i] = (int32_t)(seed >> 16) / 4 - 8192;
+    }
+}
+
+static diff_t difference(const int16_t *a, const double *b) {
+    diff_t d = { 0, 0 };
+    for (int i = 0; i < 2 * FRAMES; i++) {
+        double e = a[i] - b[i];
+        d.rms += e * e;
+        d.peak = fabs(e) > d.peak ? (int)ceil(fabs(e)) : d.peak;
+    }
+    d.rms = sqrt(d.rms / (2 * FRAMES));
+    return d;
+}
+
+static diff_t fixed_float(const int16_t *fixed, const int16_t *flt) {
+    static double as_double[2 * FRAMES];
+    for (int i = 0; i < 2 * FRAMES; i++) {
+        as_double[i] = flt[i];
+    }
+    return difference(fixed, as_double);
+}
+
+// Runs process on a copy of in into out.
+#define RUN(process, state, in, out) do { \
+        memcpy(out, in, sizeof(out)); \
+        process(state, out, FRAMES); \
+    } while (0)
+
+static void report(const char *name, diff_t d) {
+    printf("%-9s fixed vs float %.2f LSB rms, %d peak\n", name, d.rms, d.peak);
+}
+
+static void test_comp(const int16_t *in) {
+    static int16_t fixed[2 * FRAMES], flt[2 * FRAMES];
+    compressor_params_t p;
+    compressor_params_night(&p);
+    static compressor_t cq, cf;
+    compressor_init(&cq, &p, AUDIO_SAMPLE_RATE);
+    compressor_init(&cf, &p, AUDIO_SAMPLE_RATE);
+    RUN(compressor_process_fixed, &cq, in, fixed);
+    RUN(compressor_process_float, &cf, in, flt);
+    diff_t d = fixed_float(fixed, flt);
+    report("comp", d);
+    CHECK(cq.clipped == 0 && cf.clipped == 0);
+    CHECK(d.rms < 0.8);
+    CHECK(d.peak <= 4);
+}
+
+static void test_loud(const int16_t *in) {
+    static int16_t fixed[2 * FRAMES], flt[2 * FRAMES];
+    static loudness_eq_t eq, ef;
+    loudness_eq_t *e[2] = { &eq, &ef };
+    for (int k = 0; k < 2; k++) {
+        loudness_eq_init(e[k], 100, 10000, AUDIO_SAMPLE_RATE);
+        loudness_eq_set(e[k], 12, 3);
+        loudness_eq_settle(e[k]);
+    }
+    RUN(loudness_eq_process_fixed, &eq, in, fixed);
+    RUN(loudness_eq_process_float, &ef, in, flt);
+    diff_t d = fixed_float(fixed, flt);
+    report("loud", d);
+    CHECK(eq.clipped == 0 && ef.clipped == 0);
+    CHECK(d.rms < 0.65);
+    CHECK(d.peak <= 3);
+}
+
+// Channel ch of in through the cascade set, in double precision.
+static void filter_double(const biquad_t set[LOUDNESS_EQ_SHELVES], const int16_t *in, int ch, double *out) {
+    double s[LOUDNESS_EQ_SHELVES][4] = { { 0 } };       // x1, x2, y1, y2
+    for (int f = 0; f < FRAMES; f++) {
+        double x = in[2 * f + ch];
+        for (int i = 0; i < LOUDNESS_EQ_SHELVES; i++) {
+            const biquad_t *q = &set[i];
+            double y = (q->b0 * x + q->b1 * s[i][0] + q->b2 * s[i][1] - q->a1 * s[i][2] - q->a2 * s[i][3]) /
+                       (1 << BIQUAD_COEF_BITS);
+            s[i][1] = s[i][0];
+            s[i][0] = x;
+            s[i][3] = s[i][2];
+            s[i][2] = y;
+            x = y;
+        }
+        out[2 * f + ch] = x;
+    }
+}
+
+static void test_loud_fade(const int16_t *in) {
+    // Stepping from flat toward +12/+3 dB, every frame in a crossfade.
+    // Either pipeline's new set starts from the old one's state scaled by
+    // the change in attenuation; the fixed-point history still lags the
+    // shelf's new shape, which leaves that path tens of LSBs off.
+    static int16_t fixed[2 * FRAMES], flt[2 * FRAMES];
+    static double ideal[2 * FRAMES], through[FADES + 1][2 * FRAMES];
+    static loudness_eq_t eq, ef, plan;
+    loudness_eq_t *e[3] = { &eq, &ef, &plan };
+    for (int k = 0; k < 3; k++) {
+        loudness_eq_init(e[k], 100, 10000, AUDIO_SAMPLE_RATE);
+        loudness_eq_set(e[k], 12, 3);
+    }
+    RUN(loudness_eq_process_fixed, &eq, in, fixed);
+    RUN(loudness_eq_process_float, &ef, in, flt);
+
+    // The sets the filter steps through, each run over the whole input.
+    for (int j = 0; j <= FADES; j++) {
+        CHECK(j == 0 || loudness_eq_step(&plan));
+        const biquad_t *set = j == 0 ? plan.cur : plan.next;
+        filter_double(set, in, 0, through[j]);
+        filter_double(set, in, 1, through[j]);
+    }
+    for (int f = 0; f < FRAMES; f++) {
+        int j = f / LOUDNESS_EQ_FADE_FRAMES;
+        double k = (double)(f % LOUDNESS_EQ_FADE_FRAMES + 1) / LOUDNESS_EQ_FADE_FRAMES;
+        for (int ch = 0; ch < 2; ch++) {
+            int i = 2 * f + ch;
+            ideal[i] = through[j][i] + (through[j + 1][i] - through[j][i]) * k;
+        }
+    }
+
+    diff_t d = fixed_float(fixed, flt);
+    diff_t fixed_ideal = difference(fixed, ideal), float_ideal = difference(flt, ideal);
+    report("loud-fade", d);
+    printf("          against an ideal crossfade: fixed %.1f LSB rms, float %.2f\n", fixed_ideal.rms,
+           float_ideal.rms);
+    CHECK(eq.steps == FADES && ef.steps == FADES);
+    CHECK(eq.clipped == 0 && ef.clipped == 0);
+    CHECK(d.rms < 45);
+    CHECK(fixed_ideal.rms < 45);
+    CHECK(float_ideal.rms < 1.5);
+}
+
+static void test_hp(const int16_t *in) {
+    static int16_t fixed[2 * FRAMES], flt[2 * FRAMES];
+    headphone_dsp_params_t p;
+    headphone_dsp_params_flat(&p);
+    p.gain_db = 3;
+    p.band[0] = (headphone_eq_band_t){ HEADPHONE_EQ_LOW_SHELF, 105, 4, 0.7f };
+    p.band[1] = (headphone_eq_band_t){ HEADPHONE_EQ_PEAK, 200, -2, 1.0f };
+    p.band[2] = (headphone_eq_band_t){ HEADPHONE_EQ_PEAK, 3000, 3, 2.0f };
+    p.band[3] = (headphone_eq_band_t){ HEADPHONE_EQ_HIGH_SHELF, 9000, -3, 0.7f };
+    p.crossfeed = true;
+    p.limiter = true;
+    static headphone_dsp_t hq, hf;
+    headphone_dsp_compile(&hq, &p, AUDIO_SAMPLE_RATE);
+    headphone_dsp_compile(&hf, &p, AUDIO_SAMPLE_RATE);
+    RUN(headphone_dsp_process_fixed, &hq, in, fixed);
+    RUN(headphone_dsp_process_float, &hf, in, flt);
+    diff_t d = fixed_float(fixed, flt);
+    report("hp", d);
+    CHECK(hq.clipped == 0 && hf.clipped == 0);
+    CHECK(d.rms < 0.7);
+    CHECK(d.peak <= 3);
+}
+
+int main(void) {
+    static int16_t in[2 * FRAMES];
+    fill_noise(in);
+    test_comp(in);
+    test_loud(in);
+    test_loud_fade(in);
+    test_hp(in);
+    CHECK_DONE();
+}
@@ -0,0 +1,233 @@
+/*
+ * Range-seek planning: where ingest_seek_plan() says to fetch from for
+ * each format, and that output after ingest_seek() starts at the target.
+ *
+ * WAV, raw PCM and SBC streams are made here and fed as the play queue
+ * would; their frames carry their own number, so the first frame out after
+ * a seek shows where it landed. AAC and Ogg plans depend only on the
+ * bitrate seen so far, so those sessions are set up by hand.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio_bridge.h"
+#include "check.h"
+#include "host.h"
+#include "ingest.h"
+#include "sbc_codec.h"
+
+#define STREAM_FRAMES   (2 * AUDIO_SAMPLE_RATE)
+#define SEEK_LEAD       (AUDIO_SAMPLE_RATE / 4)     // SEEK_LEAD_FRAMES in ingest.c
+
+static uint8_t s_stream[STREAM_FRAMES * 4 + 1024];
+static int64_t s_first;             // Number carried by the first frame out, -1 none
+static size_t s_frames_out;
+
+static void sink(const int16_t *pcm, size_t frames, void *ctx) {
+    if (s_first < 0 && frames > 0) {
+        s_first = (uint16_t)pcm[0] | (int64_t)(uint16_t)pcm[1] << 16;
+    }
+    s_frames_out += frames;
+}
+
+static void put_le(uint8_t *p, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = v >> (8 * i);
+    }
+}
+
+// A WAV file of STREAM_FRAMES numbered frames, with a LIST chunk before
+// the data when list is set. Mono frames carry only the low 16 bits.
+static size_t make_wav(int channels, bool list) {
+    uint8_t *p = s_stream;
+    memcpy(p, "RIFF\xff\xff\xff\xffWAVEfmt ", 16);
+    put_le(p + 16, 16, 4);
+    put_le(p + 20, 1, 2);
+    put_le(p + 22, channels, 2);
+    put_le(p + 24, AUDIO_SAMPLE_RATE, 4);
+    put_le(p + 28, AUDIO_SAMPLE_RATE * channels * 2, 4);
+    put_le(p + 32, channels * 2, 2);
+    put_le(p + 34, 16, 2);
+    p += 36;
+    if (list) {
+        memcpy(p, "LIST", 4);
+        put_le(p + 4, 26, 4);
+        memset(p + 8, 'x', 26);
+        p += 34;
+    }
+    memcpy(p, "data", 4);
+    put_le(p + 4, STREAM_FRAMES * channels * 2, 4);
+    p += 8;
+    for (uint32_t f = 0; f < STREAM_FRAMES; f++) {
+        put_le(p, f & 0xffff, 2);
+        if (channels == 2) {
+            put_le(p + 2, f >> 16, 2);
+        }
+        p += channels * 2;
+    }
+    return p - s_stream;
+}
+
+static void feed(ingest_t *in, const uint8_t *data, size_t len) {
+    // In pieces, as recv() hands them over.
+    for (size_t off = 0; off < len; off += 1460) {
+        CHECK(ingest_feed(in, data + off, len - off < 1460 ? len - off : 1460));
+    }
+}
+
+// Seeks in to target and feeds the stream from where the plan says.
+static void seek_and_feed(ingest_t *in, uint32_t target, const ingest_seek_t *plan, size_t len) {
+    ingest_seek(in, target, plan);
+    s_first = -1;
+    s_frames_out = 0;
+    feed(in, s_stream + plan->offset, len - plan->offset);
+}
+
+static void test_wav(int channels, bool list) {
+    size_t len = make_wav(channels, list);
+    size_t data_offset = list ? 78 : 44;
+    ingest_t in;
+    ingest_seek_t plan;
+
+    ingest_begin(&in, sink, NULL);
+    // Not before the data chunk is found.
+    feed(&in, s_stream, 20);
+    CHECK(!ingest_seek_plan(&in, 1000, &plan));
+    feed(&in, s_stream + 20, AUDIO_SAMPLE_RATE * channels * 2);
+
+    const uint32_t target = 54321;
+    CHECK(ingest_seek_plan(&in, target, &plan));
+    CHECK(plan.exact);
+    CHECK(plan.position == target);
+    CHECK(plan.offset == data_offset + target * channels * 2);
+    seek_and_feed(&in, target, &plan, len);
+    // Mono is upmixed, so both channels carry the low bits.
+    CHECK(s_first == (channels == 2 ? target : (target & 0xffff) * 0x10001));
+    CHECK(s_frames_out == STREAM_FRAMES - target);
+    CHECK(ingest_position(&in) == STREAM_FRAMES);
+
+    // Back to the first frame.
+    CHECK(ingest_seek_plan(&in, 0, &plan));
+    CHECK(plan.offset == data_offset && plan.position == 0);
+    ingest_end(&in);
+}
+
+static void test_pcm(void) {
+    for (uint32_t f = 0; f < STREAM_FRAMES; f++) {
+        put_le(s_stream + 4 * f, f & 0xffff, 2);
+        put_le(s_stream + 4 * f + 2, f >> 16, 2);
+    }
+    // Frame 0 is four zero bytes, which is raw PCM to the sniffer.
+    ingest_t in;
+    ingest_seek_t plan;
+    ingest_begin(&in, sink, NULL);
+    feed(&in, s_stream, 4 * 10000);
+    CHECK(in.format == INGEST_FORMAT_PCM);
+    CHECK(ingest_seek_plan(&in, 77777, &plan));
+    CHECK(plan.exact && plan.position == 77777 && plan.offset == 4 * 77777);
+    seek_and_feed(&in, 77777, &plan, 4 * STREAM_FRAMES);
+    CHECK(s_first == 77777);
+    ingest_end(&in);
+}
+
+static void test_sbc(void) {
+    sbc_params_t p;
+    CHECK(sbc_preset("sq", &p));
+    const int frame_samples = p.blocks * p.subbands;
+    const int flen = sbc_frame_length(&p);
+    const int frames = 100;
+    static sbc_encoder_t enc;
+    sbc_encoder_init(&enc, &p);
+    int16_t pcm[SBC_MAX_SAMPLES * 2];
+    uint8_t out[SBC_MAX_FRAME_LEN + 2];
+    size_t len = 0;
+    for (int i = 0; i < frames; i++) {
+        for (int s = 0; s < 2 * frame_samples; s++) {
+            pcm[s] = (int16_t)((i * 2 * frame_samples + s) * 37);
+        }
+        CHECK(sbc_encode_frame(&enc, pcm, out) == flen);
+        memcpy(s_stream + len, out, flen);
+        len += flen;
+    }
+
+    ingest_t in;
+    ingest_seek_t plan;
+    ingest_begin(&in, sink, NULL);
+    CHECK(!ingest_seek_plan(&in, 0, &plan));
+    feed(&in, s_stream, 20 * flen);
+    CHECK(in.format == INGEST_FORMAT_SBC);
+
+    // Frames map to bytes exactly; the plan starts at the frame holding
+    // the target, and output begins at the target itself.
+    const uint32_t target = 37 * frame_samples + 5;
+    CHECK(ingest_seek_plan(&in, target, &plan));
+    CHECK(plan.exact);
+    CHECK(plan.position == 37 * frame_samples);
+    CHECK(plan.offset == 37 * flen);
+    seek_and_feed(&in, target, &plan, len);
+    CHECK(s_frames_out == frames * frame_samples - target);
+    CHECK(ingest_position(&in) == frames * frame_samples);
+    ingest_end(&in);
+}
+
+// A session that has fed fed bytes past data_offset for position frames.
+static void estimated(ingest_t *in, ingest_format_t format, uint32_t data_offset, uint32_t fed, int64_t position) {
+    ingest_begin(in, sink, NULL);
+    in->format = format;
+    in->data_offset = data_offset;
+    in->fed = fed;
+    in->position = position;
+}
+
+static void test_estimated(void) {
+    ingest_t in;
+    ingest_seek_t plan;
+
+    // 128 kbit/s AAC: about 0.363 bytes a frame. Aimed SEEK_LEAD early,
+    // and the position is only known once frames are decoded.
+    estimated(&in, INGEST_FORMAT_AAC, 0, 160000, 441000);
+    CHECK(ingest_seek_plan(&in, 1000000, &plan));
+    CHECK(!plan.exact);
+    CHECK(plan.position == -1);
+    CHECK(plan.offset == (uint32_t)((1000000 - SEEK_LEAD) * (160000.0 / 441000)));
+    // Near the start, from the top: position known.
+    CHECK(ingest_seek_plan(&in, SEEK_LEAD - 1, &plan));
+    CHECK(plan.offset == 0 && plan.position == 0);
+    // Nothing decoded yet: no bitrate to go on.
+    estimated(&in, INGEST_FORMAT_AAC, 0, 5000, 0);
+    CHECK(!ingest_seek_plan(&in, 1000000, &plan));
+
+    // Ogg Vorbis: past the headers, and two pages earlier still, since a
+    // page's first granule is only known at its end. Positions are exact
+    // once a page ends.
+    estimated(&in, INGEST_FORMAT_OGG, 4000, 4000 + 88200, 441000);
+    in.page_frames = 4096;
+    CHECK(ingest_seek_plan(&in, 500000, &plan));
+    CHECK(plan.exact);
+    CHECK(plan.position == -1);
+    CHECK(plan.offset == 4000 + (uint32_t)((500000 - SEEK_LEAD - 2 * 4096) * 0.2));
+    CHECK(ingest_seek_plan(&in, SEEK_LEAD + 2 * 4096, &plan));
+    CHECK(plan.offset == 0 && plan.position == 0);
+    // Still in the headers.
+    estimated(&in, INGEST_FORMAT_OGG, 4000, 4000, 0);
+    CHECK(!ingest_seek_plan(&in, 500000, &plan));
+
+    // An offset past 4 GB cannot be asked for.
+    estimated(&in, INGEST_FORMAT_AAC, 0, 4000000, 44100);
+    CHECK(!ingest_seek_plan(&in, 100000000, &plan));
+
+    ingest_begin(&in, sink, NULL);
+    CHECK(!ingest_seek_plan(&in, 0, &plan));
+}
+
+int main(void) {
+    host_log_quiet(true);
+    ingest_init();
+    test_wav(2, false);
+    test_wav(1, true);
+    test_pcm();
+    test_sbc();
+    test_estimated();
+    CHECK_DONE();
+}
@@ -0,0 +1,274 @@
+/*
+ * Ogg demultiplexer against pages built here: CRCs, packets spanning
+ * pages, sequence gaps, chained streams and pages of other streams, lost
+ * sync and seeking, fed in pieces from a byte up to whole pages.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "check.h"
+#include "ogg_demux.h"
+
+#define MAX_PACKETS     64
+
+typedef struct {
+    int count;
+    size_t len[MAX_PACKETS];
+    uint8_t first[MAX_PACKETS];     // First byte, which names the packet
+    bool bos[MAX_PACKETS];
+    bool intact[MAX_PACKETS];       // Every byte as made by fill_packet()
+} received_t;
+
+static uint8_t s_stream[64 * 1024];
+static size_t s_len;
+static uint8_t s_packet_buf[4096];
+
+// Bitwise CRC, independent of the demuxer's table.
+static uint32_t crc(const uint8_t *p, size_t len) {
+    uint32_t r = 0;
+    for (size_t i = 0; i < len; i++) {
+        r ^= (uint32_t)p[i] << 24;
+        for (int b = 0; b < 8; b++) {
+            r = r & 0x80000000u ? r << 1 ^ 0x04C11DB7u : r << 1;
+        }
+    }
+    return r;
+}
+
+static void fill_packet(uint8_t *p, size_t len, uint8_t name) {
+    for (size_t i = 0; i < len; i++) {
+        p[i] = i ? (uint8_t)(name + i * 7) : name;
+    }
+}
+
+// Appends a page with the given lacing values and the body they describe.
+static size_t put_page(uint32_t serial, uint32_t seq, int64_t granule, uint8_t flags, const uint8_t *lacing,
+                       int segments, const uint8_t *body) {
+    uint8_t *h = s_stream + s_len;
+    memcpy(h, "OggS", 4);
+    h[4] = 0;
+    h[5] = flags;
+    for (int i = 0; i < 8; i++) {
+        h[6 + i] = (uint8_t)((uint64_t)granule >> (8 * i));
+    }
+    for (int i = 0; i < 4; i++) {
+        h[14 + i] = serial >> (8 * i);
+        h[18 + i] = seq >> (8 * i);
+        h[22 + i] = 0;
+    }
+    h[26] = segments;
+    memcpy(h + 27, lacing, segments);
+    size_t body_len = 0;
+    for (int i = 0; i < segments; i++) {
+        body_len += lacing[i];
+    }
+    memcpy(h + 27 + segments, body, body_len);
+    size_t page_len = 27 + segments + body_len;
+    uint32_t c = crc(h, page_len);
+    for (int i = 0; i < 4; i++) {
+        h[22 + i] = c >> (8 * i);
+    }
+    s_len += page_len;
+    return page_len;
+}
+
+// Appends packets of the given lengths as pages of at most max_segments
+// segments, a packet continuing onto the next page where it does not fit.
+// Packet k is named first + k.
+static uint32_t put_packets(uint32_t serial, uint32_t seq, bool bos, const size_t *lens, int count,
+                            uint8_t first, int max_segments) {
+    static uint8_t body[64 * 1024];
+    uint8_t lacing[255];
+    int segments = 0;
+    size_t body_len = 0;
+    uint8_t flags = bos ? 0x02 : 0;
+    for (int k = 0; k < count; k++) {
+        uint8_t packet[4096 + 1];
+        fill_packet(packet, lens[k], first + k);
+        size_t left = lens[k];
+        const uint8_t *p = packet;
+        do {
+            uint8_t lace = left >= 255 ? 255 : left;
+            memcpy(body + body_len, p, lace);
+            body_len += lace;
+            lacing[segments++] = lace;
+            p += lace;
+            left -= lace;
+            bool more = lace == 255;
+            if (segments == max_segments) {
+                put_page(serial, seq, more ? -1 : 1000 * seq, flags, lacing, segments, body);
+                seq++;
+                flags = more ? 0x01 : 0;
+                segments = 0;
+                body_len = 0;
+            }
+            if (!more) {
+                break;
+            }
+        } while (true);
+    }
+    if (segments > 0) {
+        put_page(serial, seq, 1000 * seq, flags, lacing, segments, body);
+        seq++;
+    }
+    return seq;
+}
+
+static bool on_packet(const uint8_t *packet, size_t len, bool bos, void *ctx) {
+    received_t *r = ctx;
+    if (r->count < MAX_PACKETS) {
+        uint8_t want[4096];
+        fill_packet(want, len, len ? packet[0] : 0);
+        r->len[r->count] = len;
+        r->first[r->count] = len ? packet[0] : 0;
+        r->bos[r->count] = bos;
+        r->intact[r->count] = memcmp(packet, want, len) == 0;
+    }
+    r->count++;
+    return true;
+}
+
+// Feeds s_stream in pieces of step bytes.
+static void demux(ogg_demux_t *d, received_t *r, size_t step) {
+    memset(r, 0, sizeof(*r));
+    ogg_demux_init(d, s_packet_buf, sizeof(s_packet_buf));
+    for (size_t off = 0; off < s_len; off += step) {
+        CHECK(ogg_demux_feed(d, s_stream + off, s_len - off < step ? s_len - off : step, on_packet, r));
+    }
+}
+
+static void test_crc(void) {
+    // CRC-32 with this polynomial, no reflection, initial value and final
+    // XOR of 0: the check value of "123456789".
+    CHECK(crc((const uint8_t *)"123456789", 9) == 0x89A1897Fu);
+
+    const size_t lens[] = { 10, 20, 30 };
+    s_len = 0;
+    put_packets(1, 0, true, lens, 3, 'a', 255);
+    ogg_demux_t d;
+    received_t r;
+    demux(&d, &r, s_len);
+    CHECK(r.count == 3 && d.crc_errors == 0 && d.pages == 1);
+
+    // Damage in the body is only caught at the end of the page; the packets
+    // have gone out by then.
+    s_stream[27 + 3 + 15] ^= 1;
+    demux(&d, &r, s_len);
+    CHECK(d.crc_errors == 1);
+    CHECK(r.count == 3 && !r.intact[1]);
+}
+
+static void test_spanning(void) {
+    // Two packets over three pages, one exactly 255 bytes (ended by a
+    // zero lacing value) and one of 1000; then short ones.
+    const size_t lens[] = { 255, 1000, 5, 0, 7 };
+    for (size_t step = 1; step <= 4096; step *= 8) {
+        s_len = 0;
+        put_packets(7, 0, true, lens, 5, 'A', 3);
+        ogg_demux_t d;
+        received_t r;
+        demux(&d, &r, step);
+        CHECK(r.count == 5);
+        for (int k = 0; k < 5 && k < r.count; k++) {
+            CHECK(r.len[k] == lens[k]);
+            CHECK(r.intact[k]);
+            CHECK(r.bos[k] == (k == 0));
+        }
+        CHECK(d.crc_errors == 0 && d.dropped_packets == 0 && d.resyncs == 0);
+    }
+}
+
+static void test_gap(void) {
+    // A 600-byte packet over pages 1-3, with page 2 lost: it is dropped,
+    // and the packet after it comes through.
+    const size_t lens[] = { 10, 600, 20 };
+    s_len = 0;
+    put_packets(3, 0, true, lens, 3, 'a', 2);
+    // Pages: [10, 255] [255, 90] [20]; cut out the second.
+    size_t page1 = 27 + 2 + 10 + 255;
+    size_t page2 = 27 + 2 + 255 + 90;
+    memmove(s_stream + page1, s_stream + page1 + page2, s_len - page1 - page2);
+    s_len -= page2;
+    ogg_demux_t d;
+    received_t r;
+    demux(&d, &r, 100);
+    CHECK(r.count == 2);
+    CHECK(r.len[0] == 10 && r.len[1] == 20 && r.first[1] == 'c' && r.intact[1]);
+    CHECK(d.dropped_packets == 1);
+}
+
+static void test_chained(void) {
+    // Stream 1, a page of some other logical stream in between, then a
+    // chained stream with a new BOS.
+    const size_t a[] = { 30, 40 };
+    const size_t b[] = { 50 };
+    const size_t c[] = { 60, 70 };
+    s_len = 0;
+    put_packets(100, 0, true, a, 2, 'a', 255);
+    put_packets(200, 4, false, b, 1, 'x', 255);
+    put_packets(100, 1, false, a, 1, 'c', 255);
+    put_packets(300, 0, true, c, 2, 'm', 255);
+    ogg_demux_t d;
+    received_t r;
+    demux(&d, &r, 13);
+    CHECK(r.count == 5);
+    static const uint8_t names[] = { 'a', 'b', 'c', 'm', 'n' };
+    static const bool bos[] = { true, false, false, true, false };
+    for (int k = 0; k < 5 && k < r.count; k++) {
+        CHECK(r.first[k] == names[k]);
+        CHECK(r.bos[k] == bos[k]);
+        CHECK(r.intact[k]);
+    }
+    CHECK(d.serial == 300);
+}
+
+static void test_sync(void) {
+    const size_t lens[] = { 100, 100 };
+    s_len = 0;
+    put_packets(5, 0, true, lens, 1, 'a', 255);
+    // Junk, including a false "Ogg", between pages.
+    memcpy(s_stream + s_len, "junkOggjunk", 11);
+    s_len += 11;
+    put_packets(5, 1, false, lens + 1, 1, 'b', 255);
+    ogg_demux_t d;
+    received_t r;
+    demux(&d, &r, 1);
+    CHECK(r.count == 2 && r.first[1] == 'b' && r.intact[1]);
+    CHECK(d.resyncs == 1);
+
+    // A packet too long for the buffer is dropped, not truncated.
+    const size_t big[] = { sizeof(s_packet_buf) + 1, 9 };
+    s_len = 0;
+    put_packets(5, 0, true, big, 2, 'a', 255);
+    demux(&d, &r, 1000);
+    CHECK(r.count == 1 && r.len[0] == 9);
+    CHECK(d.dropped_packets == 1);
+}
+
+static void test_seek(void) {
+    // Pages: [10, 255] [255, 90] [20]. Joining mid-way through page 1 after
+    // a seek, the packet continued on page 2 is skipped.
+    const size_t lens[] = { 10, 600, 20 };
+    s_len = 0;
+    put_packets(3, 0, true, lens, 3, 'a', 2);
+    ogg_demux_t d;
+    received_t r;
+    demux(&d, &r, 20);
+    CHECK(r.count == 3);
+    size_t mid = 27 + 2 + 100;
+    ogg_demux_seek(&d);
+    memset(&r, 0, sizeof(r));
+    CHECK(ogg_demux_feed(&d, s_stream + mid, s_len - mid, on_packet, &r));
+    CHECK(r.count == 1 && r.len[0] == 20 && r.intact[0]);
+}
+
+int main(void) {
+    test_crc();
+    test_spanning();
+    test_gap();
+    test_chained();
+    test_sync();
+    test_seek();
+    CHECK_DONE();
+}
@@ -0,0 +1,184 @@
+/*
+ * Live overflow policy: the bound is only taken up by a session, a cut
+ * leaves the buffer below it at a zero crossing with no step across the
+ * crossfade, and a sender running fast is held to the bound call after
+ * call. The playback buffer is a FIFO over a known signal here.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_bridge.h"
+#include "check.h"
+#include "harness.h"
+#include "host.h"
+#include "log_ring.h"
+#include "overflow.h"
+
+#define BLOCK_FRAMES    512             // An a2d_data_cb request
+#define SIGNAL_FRAMES   (20 * AUDIO_SAMPLE_RATE)
+#define BYTES_PER_MS    (AUDIO_BYTES_PER_SEC / 1000)
+#define AMPLITUDE       12000
+
+static int16_t s_signal[SIGNAL_FRAMES * AUDIO_CHANNELS];
+static size_t s_head;                   // Frames queued so far
+static size_t s_tail;                   // Frames read so far
+
+static size_t buffered(void) {
+    return (s_head - s_tail) * AUDIO_BYTES_PER_FRAME;
+}
+
+static size_t fifo_read(void *buf, size_t n, void *ctx) {
+    size_t frames = n / AUDIO_BYTES_PER_FRAME;
+    if (frames > s_head - s_tail) {
+        frames = s_head - s_tail;
+    }
+    memcpy(buf, s_signal + s_tail * AUDIO_CHANNELS, frames * AUDIO_BYTES_PER_FRAME);
+    s_tail += frames;
+    return frames * AUDIO_BYTES_PER_FRAME;
+}
+
+// One a2d_data_cb call: a block read, then trimmed. Returns the bytes cut.
+static size_t pull(int16_t *block) {
+    size_t len = BLOCK_FRAMES * AUDIO_BYTES_PER_FRAME;
+    CHECK(fifo_read(block, len, NULL) == len);
+    return overflow_trim((uint8_t *)block, len, buffered(), fifo_read, NULL);
+}
+
+// Two tones summed into both channels: zero crossings at irregular places.
+static void make_signal(void) {
+    for (size_t f = 0; f < SIGNAL_FRAMES; f++) {
+        double t = (double)f / AUDIO_SAMPLE_RATE;
+        int16_t v = (int16_t)(AMPLITUDE * (0.7 * sin(2 * M_PI * 220 * t) + 0.3 * sin(2 * M_PI * 1370 * t)));
+        s_signal[2 * f] = v;
+        s_signal[2 * f + 1] = v;
+    }
+}
+
+// Largest sample-to-sample change in the left channel of a block.
+static int largest_step(const int16_t *block, int16_t before) {
+    int step = abs(block[0] - before);
+    for (int f = 1; f < BLOCK_FRAMES; f++) {
+        int d = abs(block[2 * f] - block[2 * f - 2]);
+        step = d > step ? d : step;
+    }
+    return step;
+}
+
+static void test_policy(void) {
+    int16_t block[BLOCK_FRAMES * AUDIO_CHANNELS];
+
+    // Lossless by default: a full buffer is never cut.
+    s_head = STREAM_BUFFER_SIZE / AUDIO_BYTES_PER_FRAME;
+    s_tail = 0;
+    CHECK(pull(block) == 0);
+
+    // Bounds outside 2 * margin up to what the buffer holds are refused.
+    CHECK(harness_exec("overflow live 5") != 0);
+    CHECK(harness_exec("overflow live 1000") != 0);
+    CHECK(harness_exec("overflow sometimes") != 0);
+    CHECK(harness_exec("overflow live 40") == 0);
+
+    // Selected, but not yet taken up by a session.
+    CHECK(pull(block) == 0);
+    overflow_session_begin();
+    // Under the bound: left alone.
+    s_head = 100000;
+    s_tail = s_head - 30 * BYTES_PER_MS / AUDIO_BYTES_PER_FRAME - BLOCK_FRAMES;
+    CHECK(pull(block) == 0);
+    overflow_session_end();
+
+    // Lossless again once the session is over.
+    s_tail = 0;
+    CHECK(pull(block) == 0);
+}
+
+static void test_cut(void) {
+    int16_t block[BLOCK_FRAMES * AUDIO_CHANNELS];
+    const size_t bound = 40 * BYTES_PER_MS;
+    const size_t keep = (40 - OVERFLOW_MARGIN_MS) * BYTES_PER_MS;
+    CHECK(harness_exec("overflow live 40") == 0);
+    overflow_session_begin();
+
+    // Cuts at different phases of the signal.
+    for (size_t start = 1000; start < 200000; start += 7919) {
+        s_tail = start;
+        s_head = start + STREAM_BUFFER_SIZE / AUDIO_BYTES_PER_FRAME;
+        int16_t before = s_signal[2 * start - 2];
+        size_t lost = pull(block);
+        CHECK(lost > 0);
+        CHECK(lost % AUDIO_BYTES_PER_FRAME == 0);
+        // Down to the margin below the bound, give or take a frame.
+        CHECK(buffered() <= keep);
+        CHECK(buffered() + AUDIO_BYTES_PER_FRAME > keep);
+        CHECK(buffered() < bound);
+        // Nothing lost but what was cut.
+        CHECK(s_tail - start == BLOCK_FRAMES + lost / AUDIO_BYTES_PER_FRAME);
+
+        // Played as queued up to the first zero crossing.
+        const int16_t *queued = s_signal + 2 * start;
+        int cut = 1;
+        while ((queued[2 * cut - 2] < 0) == (queued[2 * cut] < 0)) {
+            cut++;
+        }
+        CHECK(cut < BLOCK_FRAMES - OVERFLOW_FADE_FRAMES);
+        CHECK_MEM(block, queued, cut * AUDIO_BYTES_PER_FRAME);
+        // After the crossfade, the audio from past the cut as queued.
+        size_t resume = s_tail - BLOCK_FRAMES + cut;
+        for (int f = cut + OVERFLOW_FADE_FRAMES; f < BLOCK_FRAMES; f++) {
+            CHECK(block[2 * f] == s_signal[2 * (resume + f - cut)]);
+        }
+        // The signal steps by at most 2 pi (0.7 * 220 + 0.3 * 1370)
+        // AMPLITUDE / rate, under 1000; the fade adds a 1/65 share of the
+        // difference between the two sides each frame. Cut without it, the
+        // step could be anything up to 2 * AMPLITUDE.
+        int step = largest_step(block, before);
+        CHECK(step < 1000 + 2 * AMPLITUDE / (OVERFLOW_FADE_FRAMES + 1));
+        CHECK(block[1] == block[0]);
+    }
+    overflow_session_end();
+}
+
+static void test_fast_sender(void) {
+    // The sender gets 10 % ahead of the sink and stays there: the buffer
+    // never holds more than the bound after a call, and cuts are spaced
+    // out by the margin rather than coming every call.
+    int16_t block[BLOCK_FRAMES * AUDIO_CHANNELS];
+    const size_t bound = 60 * BYTES_PER_MS;
+    CHECK(harness_exec("overflow live") == 0);
+    overflow_session_begin();
+    s_head = 0;
+    s_tail = 0;
+    int calls = 0, cuts = 0;
+    while (s_head + 2 * BLOCK_FRAMES < SIGNAL_FRAMES) {
+        s_head += BLOCK_FRAMES * 11 / 10;
+        if (s_head - s_tail > STREAM_BUFFER_SIZE / AUDIO_BYTES_PER_FRAME) {
+            s_head = s_tail + STREAM_BUFFER_SIZE / AUDIO_BYTES_PER_FRAME;     // recv loop blocks
+        }
+        if (buffered() < BLOCK_FRAMES * AUDIO_BYTES_PER_FRAME) {
+            continue;
+        }
+        cuts += pull(block) > 0;
+        calls++;
+        CHECK(buffered() <= bound);
+    }
+    printf("%d calls, %d cuts\n", calls, cuts);
+    CHECK(cuts > 0);
+    // A cut leaves 10 ms in hand, which a 10 % fast sender takes 100 ms,
+    // about 8 calls, to use up.
+    CHECK(cuts < calls / 6);
+    overflow_session_end();
+}
+
+int main(void) {
+    host_log_quiet(true);
+    log_ring_init();
+    overflow_init();
+    make_signal();
+    test_policy();
+    test_cut();
+    test_fast_sender();
+    CHECK_DONE();
+}
@@ -0,0 +1,355 @@
+/*
+ * Play queue transitions: with the next item fetched and decoded ahead it
+ * follows the one before without a gap, a late one leaves a gap that is
+ * reported as long as the silence heard, and a skip moves straight on. The
+ * queue and the test generator take the playback buffer in turn.
+ *
+ * Items are tcp:// streams of WAV from loopback servers here (the host has
+ * no HTTP client), and a thread stands in for a2d_data_cb, pulling a block
+ * every block's worth of real time and recording what it got. Each item's
+ * frames carry its marker and their number, so the recording shows exactly
+ * what was heard when.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "lwip/sockets.h"
+#include "audio_bridge.h"
+#include "check.h"
+#include "fake_bridge.h"
+#include "harness.h"
+#include "host.h"
+#include "ingest.h"
+#include "a2d_cadence.h"
+#include "log_ring.h"
+#include "play_queue.h"
+#include "test_signal.h"
+
+#define BLOCK_FRAMES    512
+#define RECORD_FRAMES   (30 * AUDIO_SAMPLE_RATE)
+#define MAX_SEGMENTS    16
+
+typedef struct {
+    int listener;
+    int16_t marker;
+    uint32_t frames;
+    int hold_ms;            // Before sending anything
+    char uri[32];
+} item_server_t;
+
+typedef struct {
+    int16_t marker;         // 0 for silence
+    uint16_t first;         // Frame number it starts on
+    uint32_t frames;
+} segment_t;
+
+static int16_t s_record[RECORD_FRAMES * AUDIO_CHANNELS];
+static atomic_uint s_recorded;          // Frames
+static atomic_bool s_stop;
+
+// --- Output ---
+static void *player_thread(void *arg) {
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!atomic_load(&s_stop)) {
+        uint32_t at = atomic_load(&s_recorded);
+        if (at + BLOCK_FRAMES > RECORD_FRAMES) {
+            break;
+        }
+        fake_bridge_play((uint8_t *)(s_record + at * AUDIO_CHANNELS), BLOCK_FRAMES * AUDIO_BYTES_PER_FRAME);
+        atomic_store(&s_recorded, at + BLOCK_FRAMES);
+        next.tv_nsec += BLOCK_FRAMES * 1000000000LL / AUDIO_SAMPLE_RATE;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+// Splits frames [from, to) of the recording into runs of one item's frames
+// in order, and of silence. Returns how many.
+static int segments(uint32_t from, uint32_t to, segment_t *seg) {
+    int count = 0;
+    for (uint32_t f = from; f < to; f++) {
+        int16_t marker = s_record[2 * f];
+        uint16_t number = s_record[2 * f + 1];
+        segment_t *last = count > 0 ? &seg[count - 1] : NULL;
+        bool follows = last && last->marker == marker &&
+                       (marker == 0 || number == (uint16_t)(last->first + last->frames));
+        if (follows) {
+            last->frames++;
+        } else if (count < MAX_SEGMENTS) {
+            seg[count++] = (segment_t){ marker, marker ? number : 0, 1 };
+        } else {
+            return MAX_SEGMENTS + 1;
+        }
+    }
+    return count;
+}
+
+// --- Items ---
+static void put_le(uint8_t *p, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = v >> (8 * i);
+    }
+}
+
+static void *serve(void *arg) {
+    item_server_t *it = arg;
+    int sock = accept(it->listener, NULL, NULL);
+    close(it->listener);
+    if (sock < 0) {
+        return NULL;
+    }
+    if (it->hold_ms) {
+        usleep(it->hold_ms * 1000);
+    }
+    uint8_t header[44];
+    memcpy(header, "RIFF\xff\xff\xff\xffWAVEfmt ", 16);
+    put_le(header + 16, 16, 4);
+    put_le(header + 20, 1, 2);
+    put_le(header + 22, AUDIO_CHANNELS, 2);
+    put_le(header + 24, AUDIO_SAMPLE_RATE, 4);
+    put_le(header + 28, AUDIO_BYTES_PER_SEC, 4);
+    put_le(header + 32, AUDIO_BYTES_PER_FRAME, 2);
+    put_le(header + 34, 16, 2);
+    memcpy(header + 36, "data", 4);
+    put_le(header + 40, it->frames * AUDIO_BYTES_PER_FRAME, 4);
+    bool ok = send(sock, header, sizeof(header), 0) == sizeof(header);
+    int16_t block[2 * 1024];
+    for (uint32_t f = 0; ok && f < it->frames; f += 1024) {
+        uint32_t n = it->frames - f < 1024 ? it->frames - f : 1024;
+        for (uint32_t i = 0; i < n; i++) {
+            block[2 * i] = it->marker;
+            block[2 * i + 1] = (int16_t)(f + i);
+        }
+        ok = send(sock, block, n * AUDIO_BYTES_PER_FRAME, MSG_NOSIGNAL) == (ssize_t)(n * AUDIO_BYTES_PER_FRAME);
+    }
+    close(sock);
+    return NULL;
+}
+
+// Listens for the item's one connection and serves it from a thread.
+static void item_start(item_server_t *it, int16_t marker, uint32_t ms, int hold_ms) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    it->listener = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(bind(it->listener, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    CHECK(listen(it->listener, 1) == 0);
+    CHECK(getsockname(it->listener, (struct sockaddr *)&addr, &len) == 0);
+    it->marker = marker;
+    it->frames = (uint64_t)ms * AUDIO_SAMPLE_RATE / 1000;
+    it->hold_ms = hold_ms;
+    snprintf(it->uri, sizeof(it->uri), "tcp://127.0.0.1:%u", ntohs(addr.sin_port));
+    pthread_t t;
+    pthread_create(&t, NULL, serve, it);
+    pthread_detach(t);
+}
+
+// --- Console ---
+static int add(const char *uri) {
+    char line[96];
+    snprintf(line, sizeof(line), "queue add %s", uri);
+    return harness_exec(line);
+}
+
+// Waits for the queue to empty and what it wrote to be heard.
+static bool wait_empty(void) {
+    for (int i = 0; i < 400; i++) {
+        usleep(50000);
+        harness_exec("queue");
+        if (strstr(harness_output(), "Queue empty") != NULL) {
+            usleep(300000);
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    unsigned transitions, failed;
+    double gap_ms, worst_ms;
+} stats_t;
+
+static bool stats(stats_t *st) {
+    harness_exec("queue");
+    const char *out = harness_output();
+    const char *p = strstr(out, " transitions: ");
+    while (p > out && p[-1] != '\n') {
+        p--;
+    }
+    double handoff_ms;
+    return p && sscanf(p, "%u transitions: last gap %lf ms (worst %lf), handoff %lf ms; %u items failed",
+                       &st->transitions, &st->gap_ms, &st->worst_ms, &handoff_ms, &st->failed) == 5;
+}
+
+// Silence trimmed from both ends.
+static int heard(uint32_t from, segment_t *seg) {
+    int count = segments(from, atomic_load(&s_recorded), seg);
+    CHECK(count <= MAX_SEGMENTS);
+    if (count > 0 && seg[count - 1].marker == 0) {
+        count--;
+    }
+    if (count > 0 && seg[0].marker == 0) {
+        memmove(seg, seg + 1, --count * sizeof(seg[0]));
+    }
+    for (int i = 0; i < count; i++) {
+        printf("  %s %u frames from %u\n", seg[i].marker ? "item" : "silence", (unsigned)seg[i].frames,
+               (unsigned)seg[i].first);
+    }
+    return count;
+}
+
+static void test_refused(void) {
+    CHECK(add("ftp://127.0.0.1/a.wav") != 0);
+    CHECK(add("tcp://127.0.0.1") != 0);
+    CHECK(harness_exec("queue seek 5") != 0);       // Nothing playing
+}
+
+static void test_prefetched(void) {
+    // Three items queued at once: each follows the one before with not a
+    // frame missing, and the gaps reported are zero.
+    static item_server_t items[3];
+    item_start(&items[0], 1, 500, 0);
+    item_start(&items[1], 2, 400, 0);
+    item_start(&items[2], 3, 300, 0);
+    uint32_t from = atomic_load(&s_recorded);
+    for (int i = 0; i < 3; i++) {
+        CHECK(add(items[i].uri) == 0);
+    }
+    CHECK(wait_empty());
+
+    segment_t seg[MAX_SEGMENTS + 1];
+    CHECK(heard(from, seg) == 3);
+    for (int i = 0; i < 3; i++) {
+        CHECK(seg[i].marker == items[i].marker && seg[i].first == 0 && seg[i].frames == items[i].frames);
+    }
+    stats_t st;
+    CHECK(stats(&st));
+    CHECK(st.transitions == 2);
+    CHECK(st.gap_ms == 0 && st.worst_ms == 0);
+    CHECK(st.failed == 0);
+}
+
+static void test_late(void) {
+    // The second item's server sits on it for a second, well past the end
+    // of the first: the silence between them is the gap reported, to
+    // within a block.
+    static item_server_t items[2];
+    item_start(&items[0], 4, 300, 0);
+    item_start(&items[1], 5, 300, 1000);
+    uint32_t from = atomic_load(&s_recorded);
+    CHECK(add(items[0].uri) == 0);
+    CHECK(add(items[1].uri) == 0);
+    CHECK(wait_empty());
+
+    segment_t seg[MAX_SEGMENTS + 1];
+    CHECK(heard(from, seg) == 3);
+    CHECK(seg[0].marker == 4 && seg[0].frames == items[0].frames);
+    CHECK(seg[1].marker == 0);
+    CHECK(seg[2].marker == 5 && seg[2].first == 0 && seg[2].frames == items[1].frames);
+    double silence_ms = seg[1].frames * 1000.0 / AUDIO_SAMPLE_RATE;
+    stats_t st;
+    CHECK(stats(&st));
+    printf("silence %.1f ms, gap reported %.1f ms\n", silence_ms, st.gap_ms);
+    CHECK(silence_ms > 300);
+    CHECK_NEAR(st.gap_ms, silence_ms, 1000.0 * BLOCK_FRAMES / AUDIO_SAMPLE_RATE);
+    CHECK(st.worst_ms == st.gap_ms);
+    CHECK(st.transitions == 3);
+}
+
+static void test_skip(void) {
+    // Skipping a long item: what it had buffered plays out, then the next
+    // from its first frame with nothing missing in between.
+    static item_server_t items[2];
+    item_start(&items[0], 6, 5000, 0);
+    item_start(&items[1], 7, 200, 0);
+    uint32_t from = atomic_load(&s_recorded);
+    CHECK(add(items[0].uri) == 0);
+    CHECK(add(items[1].uri) == 0);
+    usleep(500000);
+    CHECK(harness_exec("queue skip") == 0);
+    CHECK(wait_empty());
+
+    segment_t seg[MAX_SEGMENTS + 1];
+    CHECK(heard(from, seg) == 2);
+    CHECK(seg[0].marker == 6 && seg[0].first == 0 && seg[0].frames < items[0].frames);
+    CHECK(seg[1].marker == 7 && seg[1].first == 0 && seg[1].frames == items[1].frames);
+    stats_t st;
+    CHECK(stats(&st));
+    CHECK(st.transitions == 4);
+    CHECK(st.gap_ms == 0);
+    CHECK(st.failed == 0);
+}
+
+static void test_unreachable(void) {
+    // An item that cannot be fetched is counted as failed and passed over.
+    static item_server_t item;
+    item_start(&item, 8, 200, 0);
+    CHECK(add("http://127.0.0.1:1/none.wav") == 0);
+    CHECK(add(item.uri) == 0);
+    uint32_t from = atomic_load(&s_recorded);
+    CHECK(wait_empty());
+    segment_t seg[MAX_SEGMENTS + 1];
+    CHECK(heard(from, seg) == 1);
+    CHECK(seg[0].marker == 8 && seg[0].frames == item.frames);
+    stats_t st;
+    CHECK(stats(&st));
+    CHECK(st.failed == 1);
+}
+
+static void test_generator(void) {
+    // Queued while the generator runs, the items wait for it without a
+    // frame heard or lost; the generator cannot start while they play, and
+    // once the queue is empty the network has the buffer again.
+    static item_server_t items[2];
+    item_start(&items[0], 9, 300, 0);
+    item_start(&items[1], 10, 1500, 0);
+    CHECK(harness_exec("gen silence") == 0);
+    uint32_t from = atomic_load(&s_recorded);
+    CHECK(add(items[0].uri) == 0);
+    CHECK(add(items[1].uri) == 0);
+    usleep(500000);
+    segment_t seg[MAX_SEGMENTS + 1];
+    CHECK(heard(from, seg) == 0);
+    CHECK(!audio_bridge_claim(AUDIO_SOURCE_QUEUE));
+
+    CHECK(harness_exec("gen off") == 0);
+    usleep(600000);
+    CHECK(harness_exec("gen pink") != 0);
+    CHECK(wait_empty());
+    CHECK(heard(from, seg) == 2);
+    for (int i = 0; i < 2; i++) {
+        CHECK(seg[i].marker == items[i].marker && seg[i].first == 0 && seg[i].frames == items[i].frames);
+    }
+    CHECK(audio_bridge_claim(AUDIO_SOURCE_NETWORK));
+}
+
+int main(void) {
+    host_log_quiet(true);
+    log_ring_init();
+    ingest_init();
+    a2d_cadence_init();
+    test_signal_init();
+    play_queue_init();
+    play_queue_start();
+    pthread_t player;
+    pthread_create(&player, NULL, player_thread, NULL);
+
+    test_refused();
+    test_prefetched();
+    test_late();
+    test_skip();
+    test_unreachable();
+    test_generator();
+
+    atomic_store(&s_stop, true);
+    pthread_join(player, NULL);
+    CHECK_DONE();
+}
@@ -0,0 +1,299 @@
+/*
+ * SBC encoder and decoder: every preset round-trips tones at a
+ * signal-to-noise ratio fitting its bitpool, frames parse back to the
+ * parameters they were made with, and damaged frames are refused.
+ *
+ * Against a reference: frames this encoder made are checked in with the PCM
+ * ffmpeg's SBC decoder produced from them (fixtures/make_fixtures.sh). The
+ * decoder has to come within rounding of it, and the reference decoder's
+ * output within the round trip's SNR of the input. "test_sbc
+ * --write-fixtures" writes the frames again.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "sbc_codec.h"
+
+#define FRAMES      64
+#define SKIP        4           // Frames left out of the SNR while the filters fill
+
+static int16_t s_in[FRAMES * SBC_MAX_SAMPLES * 2];
+static int16_t s_out[FRAMES * SBC_MAX_SAMPLES * 2];
+static sbc_encoder_t s_enc;
+static sbc_decoder_t s_dec;
+
+// Two tones, or (noisy) one tone plus filtered noise that differs between
+// the channels as "bench sbc" uses, which leaves the bitpool far less to
+// spare.
+static void fill_input(size_t frames, bool noisy) {
+    uint32_t seed = 12345;
+    int32_t lp[2] = { 0, 0 };
+    for (size_t i = 0; i < frames; i++) {
+        double tone = 6000.0 * sin(2 * M_PI * 1000.0 * i / 44100.0);
+        for (int ch = 0; ch < 2; ch++) {
+            seed = seed * 1664525u + 1013904223u;
+            lp[ch] += (((int32_t)(seed >> 16) - 32768) - lp[ch]) >> 2;
+            double other = noisy ? lp[ch] / 2 : 3000.0 * sin(2 * M_PI * 3100.0 * i / 44100.0 + ch);
+            s_in[2 * i + ch] = (int16_t)(tone * (ch ? 0.5 : 1.0) + other);
+        }
+    }
+}
+
+// Encodes and decodes FRAMES frames with p and returns the SNR in dB.
+static double round_trip(const sbc_params_t *p) {
+    const int per_frame = p->blocks * p->subbands;
+    const int channels = sbc_channels(p);
+    const int flen = sbc_frame_length(p);
+    uint8_t frame[SBC_MAX_FRAME_LEN + 2];
+    int16_t in[SBC_MAX_SAMPLES * 2];
+    sbc_encoder_init(&s_enc, p);
+    sbc_decoder_init(&s_dec);
+    for (int f = 0; f < FRAMES; f++) {
+        for (int n = 0; n < per_frame; n++) {
+            for (int ch = 0; ch < channels; ch++) {
+                in[n * channels + ch] = s_in[2 * (f * per_frame + n) + ch];
+            }
+        }
+        CHECK(sbc_encode_frame(&s_enc, in, frame) == flen);
+        sbc_params_t parsed;
+        CHECK(sbc_parse_header(frame, flen, &parsed) == flen);
+        CHECK_MEM(&parsed, p, sizeof(parsed));
+        CHECK(sbc_check_crc(frame, flen, p));
+        CHECK(sbc_decode_frame(&s_dec, frame, flen, s_out + f * per_frame * channels) == per_frame);
+    }
+
+    // Analysis plus synthesis delays the output by 9M + 1 samples.
+    const int delay = 9 * p->subbands + 1;
+    double signal = 0, noise = 0;
+    for (int n = SKIP * per_frame; n < FRAMES * per_frame; n++) {
+        for (int ch = 0; ch < channels; ch++) {
+            double x = s_in[2 * (n - delay) + ch];
+            double e = s_out[n * channels + ch] - x;
+            signal += x * x;
+            noise += e * e;
+        }
+    }
+    return noise > 0 ? 10 * log10(signal / noise) : 99.0;
+}
+
+static void test_presets(void) {
+    static const struct {
+        const char *name;
+        int kbps;
+        double min_snr_db;      // Two tones; the filter bank tops out near 66 dB
+    } presets[] = {
+        { "mq", 229, 42 },
+        { "sq", 328, 60 },
+        { "xq", 452, 60 },
+        { "xq+", 551, 60 },
+    };
+    double last_noisy = 0;
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        sbc_params_t p;
+        CHECK(sbc_preset(presets[i].name, &p));
+        CHECK((sbc_bitrate(&p) + 500) / 1000 == presets[i].kbps);
+        fill_input(FRAMES * SBC_MAX_SAMPLES, false);
+        double snr = round_trip(&p);
+        fill_input(FRAMES * SBC_MAX_SAMPLES, true);
+        double noisy = round_trip(&p);
+        printf("%-4s %3d kbit/s  %3d bytes  snr %5.1f dB, with noise %5.1f dB\n", presets[i].name,
+               sbc_bitrate(&p) / 1000, sbc_frame_length(&p), snr, noisy);
+        CHECK(snr >= presets[i].min_snr_db);
+        // Each step up in bitrate buys at least a few dB on a hard signal.
+        CHECK(noisy > last_noisy + 3);
+        last_noisy = noisy;
+    }
+    sbc_params_t p;
+    CHECK(!sbc_preset("hq", &p));
+    CHECK(sbc_preset_name(4) == NULL);
+}
+
+// Other shapes the encoder accepts: 4 subbands, fewer blocks, mono, plain
+// stereo, SNR allocation.
+static void test_shapes(void) {
+    static const sbc_params_t shapes[] = {
+        { 2, 16, SBC_MODE_STEREO, SBC_ALLOC_SNR, 8, 53 },
+        { 2, 8, SBC_MODE_JOINT_STEREO, SBC_ALLOC_LOUDNESS, 4, 35 },
+        { 2, 4, SBC_MODE_DUAL_CHANNEL, SBC_ALLOC_LOUDNESS, 8, 32 },
+        { 2, 16, SBC_MODE_MONO, SBC_ALLOC_LOUDNESS, 8, 31 },
+    };
+    fill_input(FRAMES * SBC_MAX_SAMPLES, false);
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        double snr = round_trip(&shapes[i]);
+        printf("mode %d alloc %d %2d blocks %d subbands bitpool %2d  snr %5.1f dB\n", shapes[i].mode,
+               shapes[i].allocation, shapes[i].blocks, shapes[i].subbands, shapes[i].bitpool, snr);
+        CHECK(snr >= 40);
+    }
+}
+
+static void test_damage(void) {
+    sbc_params_t p;
+    sbc_preset("sq", &p);
+    const int flen = sbc_frame_length(&p);
+    uint8_t frame[SBC_MAX_FRAME_LEN + 2];
+    sbc_encoder_init(&s_enc, &p);
+    CHECK(sbc_encode_frame(&s_enc, s_in, frame) == flen);
+
+    // The CRC covers the header and scale factors.
+    uint8_t bad[SBC_MAX_FRAME_LEN + 2];
+    memcpy(bad, frame, flen);
+    bad[SBC_HEADER_LEN + 1] ^= 0x10;
+    CHECK(!sbc_check_crc(bad, flen, &p));
+
+    sbc_params_t parsed;
+    memcpy(bad, frame, flen);
+    bad[0] = 0x9d;
+    CHECK(sbc_parse_header(bad, flen, &parsed) < 0);
+    // Too short to hold a header.
+    CHECK(sbc_parse_header(frame, 2, &parsed) < 0);
+    // A whole frame is needed to decode.
+    sbc_decoder_init(&s_dec);
+    CHECK(sbc_decode_frame(&s_dec, frame, flen - 1, s_out) < 0);
+}
+
+// --- Reference decoder ---
+static const struct {
+    const char *name;
+    sbc_params_t params;
+    bool noisy;
+} s_fixtures[] = {
+    { "sbc_sq", { 2, 16, SBC_MODE_JOINT_STEREO, SBC_ALLOC_LOUDNESS, 8, 53 }, false },
+    { "sbc_xq_noise", { 2, 16, SBC_MODE_DUAL_CHANNEL, SBC_ALLOC_LOUDNESS, 8, 38 }, true },
+    { "sbc_mono4", { 2, 8, SBC_MODE_MONO, SBC_ALLOC_SNR, 4, 30 }, false },
+};
+
+static FILE *open_fixture(const char *name, const char *ext, const char *mode) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.%s", FIXTURE_DIR, name, ext);
+    FILE *f = fopen(path, mode);
+    if (f == NULL) {
+        printf("%s: cannot open\n", path);
+    }
+    return f;
+}
+
+static size_t read_fixture(const char *name, const char *ext, void *buf, size_t size) {
+    FILE *f = open_fixture(name, ext, "rb");
+    if (f == NULL) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, size, f);
+    fclose(f);
+    return n;
+}
+
+// The input of fixture i as the encoder takes it: all of s_in, in frames.
+static int fixture_input(int i, int16_t *in) {
+    const sbc_params_t *p = &s_fixtures[i].params;
+    const int channels = sbc_channels(p);
+    const int samples = FRAMES * SBC_MAX_SAMPLES;
+    fill_input(samples, s_fixtures[i].noisy);
+    for (int n = 0; n < samples; n++) {
+        for (int ch = 0; ch < channels; ch++) {
+            in[n * channels + ch] = s_in[2 * n + ch];
+        }
+    }
+    return samples / (p->blocks * p->subbands);
+}
+
+static int write_fixtures(void) {
+    static int16_t in[FRAMES * SBC_MAX_SAMPLES * 2];
+    for (size_t i = 0; i < sizeof(s_fixtures) / sizeof(s_fixtures[0]); i++) {
+        const sbc_params_t *p = &s_fixtures[i].params;
+        const int per_frame = p->blocks * p->subbands * sbc_channels(p);
+        int frames = fixture_input(i, in);
+        FILE *f = open_fixture(s_fixtures[i].name, "sbc", "wb");
+        if (f == NULL) {
+            return 1;
+        }
+        uint8_t frame[SBC_MAX_FRAME_LEN + 2];
+        sbc_encoder_init(&s_enc, p);
+        for (int n = 0; n < frames; n++) {
+            fwrite(frame, 1, sbc_encode_frame(&s_enc, in + n * per_frame, frame), f);
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+// SNR in dB of out against the input fixture_input() left in s_in.
+static double snr_db(const sbc_params_t *p, const int16_t *out, int samples) {
+    const int channels = sbc_channels(p);
+    const int delay = 9 * p->subbands + 1;
+    double signal = 0, noise = 0;
+    for (int n = SKIP * SBC_MAX_SAMPLES; n < samples; n++) {
+        for (int ch = 0; ch < channels; ch++) {
+            double x = s_in[2 * (n - delay) + ch];
+            double e = out[n * channels + ch] - x;
+            signal += x * x;
+            noise += e * e;
+        }
+    }
+    return 10 * log10(signal / noise);
+}
+
+static void test_reference(void) {
+    // The two decoders are both fixed point and round differently, by
+    // under an LSB rms; neither is the more accurate by more than 0.5 dB.
+    static uint8_t sbc[FRAMES * SBC_MAX_FRAME_LEN];
+    static int16_t in[FRAMES * SBC_MAX_SAMPLES * 2];
+    static int16_t ref[FRAMES * SBC_MAX_SAMPLES * 2];
+    for (size_t i = 0; i < sizeof(s_fixtures) / sizeof(s_fixtures[0]); i++) {
+        const sbc_params_t *p = &s_fixtures[i].params;
+        const int channels = sbc_channels(p);
+        size_t len = read_fixture(s_fixtures[i].name, "sbc", sbc, sizeof(sbc));
+        size_t ref_len = read_fixture(s_fixtures[i].name, "pcm", ref, sizeof(ref));
+        int frames = fixture_input(i, in);
+        CHECK(len == (size_t)frames * sbc_frame_length(p));
+        CHECK(ref_len == (size_t)frames * p->blocks * p->subbands * channels * sizeof(int16_t));
+
+        sbc_decoder_init(&s_dec);
+        int samples = 0;
+        for (size_t pos = 0; pos < len;) {
+            sbc_params_t parsed;
+            int flen = sbc_parse_header(sbc + pos, len - pos, &parsed);
+            CHECK(flen > 0);
+            if (flen <= 0) {
+                break;
+            }
+            CHECK_MEM(&parsed, p, sizeof(parsed));
+            CHECK(sbc_check_crc(sbc + pos, flen, &parsed));
+            samples += sbc_decode_frame(&s_dec, sbc + pos, flen, s_out + samples * channels);
+            pos += flen;
+        }
+        CHECK((size_t)samples * channels * sizeof(int16_t) == ref_len);
+
+        double sum = 0;
+        int worst = 0;
+        for (int n = 0; n < samples * channels; n++) {
+            int d = abs(s_out[n] - ref[n]);
+            worst = d > worst ? d : worst;
+            sum += (double)d * d;
+        }
+        double rms = sqrt(sum / (samples * channels));
+        double ours = snr_db(p, s_out, samples), theirs = snr_db(p, ref, samples);
+        printf("%-13s %.2f LSB rms, %d LSB peak from ffmpeg; snr %5.1f dB, ffmpeg's %5.1f dB\n",
+               s_fixtures[i].name, rms, worst, ours, theirs);
+        CHECK(rms < 1.0);
+        CHECK(worst <= 4);
+        CHECK(fabs(ours - theirs) < 0.5);
+        // Frames from this encoder decode as well elsewhere as here.
+        CHECK(s_fixtures[i].noisy || theirs > 60);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--write-fixtures") == 0) {
+        return write_fixtures();
+    }
+    test_presets();
+    test_shapes();
+    test_damage();
+    test_reference();
+    CHECK_DONE();
+}
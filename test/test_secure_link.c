@@ -0,0 +1,357 @@
+/*
+ * Secure link: sealed records reach ingest in order and nothing else does;
+ * the control channel lets a controller in only with the key.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+#include "mbedtls/sha256.h"
+#include "bridge_console.h"
+#include "chachapoly.h"
+#include "check.h"
+#include "control_channel.h"
+#include "harness.h"
+#include "host.h"
+#include "ingest.h"
+#include "secure_link.h"
+
+#define KEY_HEX     "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+#define PCM_BYTES   4096
+
+static uint8_t s_psk[SECURE_LINK_KEY_LEN];
+static uint8_t s_pcm[PCM_BYTES];
+static uint8_t s_out[2 * PCM_BYTES];
+static size_t s_out_len;
+
+static void sink(const int16_t *pcm, size_t frames, void *ctx) {
+    size_t n = frames * 4;
+    if (s_out_len + n <= sizeof(s_out)) {
+        memcpy(s_out + s_out_len, pcm, n);
+    }
+    s_out_len += n;
+}
+
+// --- Audio port ---
+typedef struct {
+    int peer;                   // The sender's end of the socket pair
+    secure_link_t link;
+    ingest_t in;
+    uint8_t key[SECURE_LINK_KEY_LEN];
+    uint64_t record;
+} session_t;
+
+// Hands bytes to the link as recv() would, in pieces of at most chunk.
+static bool deliver(session_t *s, const uint8_t *data, size_t len, size_t chunk) {
+    while (len > 0) {
+        size_t room;
+        uint8_t *buf = secure_link_rx_buffer(&s->link, &room);
+        size_t n = len < chunk ? len : chunk;
+        n = n < room ? n : room;
+        memcpy(buf, data, n);
+        if (!secure_link_received(&s->link, n)) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void session_open(session_t *s) {
+    int sv[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    s->peer = sv[1];
+    s->record = 0;
+    s_out_len = 0;
+    ingest_begin(&s->in, sink, NULL);
+    secure_link_begin(&s->link, sv[0], &s->in);
+}
+
+static void session_close(session_t *s) {
+    secure_link_end(&s->link);
+    ingest_end(&s->in);
+    close(s->link.sock);
+    close(s->peer);
+}
+
+// Says hello and derives the session key the bridge will use.
+static bool handshake(session_t *s, uint8_t cipher, size_t chunk) {
+    uint8_t hello[SECURE_LINK_HELLO_LEN] = SECURE_LINK_MAGIC;
+    hello[4] = cipher;
+    for (int i = 0; i < SECURE_LINK_NONCE_LEN; i++) {
+        hello[SECURE_LINK_HELLO_LEN - SECURE_LINK_NONCE_LEN + i] = 0xa0 + i;
+    }
+    if (!deliver(s, hello, sizeof(hello), chunk)) {
+        return false;
+    }
+    uint8_t nonce[SECURE_LINK_NONCE_LEN];
+    CHECK(recv(s->peer, nonce, sizeof(nonce), MSG_WAITALL) == sizeof(nonce));
+
+    uint8_t kdf[SECURE_LINK_KEY_LEN + sizeof(SECURE_LINK_LABEL) - 1 + 2 * SECURE_LINK_NONCE_LEN + 1];
+    uint8_t *p = kdf;
+    memcpy(p, s_psk, SECURE_LINK_KEY_LEN);
+    p += SECURE_LINK_KEY_LEN;
+    memcpy(p, SECURE_LINK_LABEL, sizeof(SECURE_LINK_LABEL) - 1);
+    p += sizeof(SECURE_LINK_LABEL) - 1;
+    memcpy(p, hello + SECURE_LINK_HELLO_LEN - SECURE_LINK_NONCE_LEN, SECURE_LINK_NONCE_LEN);
+    p += SECURE_LINK_NONCE_LEN;
+    memcpy(p, nonce, SECURE_LINK_NONCE_LEN);
+    p += SECURE_LINK_NONCE_LEN;
+    *p = cipher;
+    mbedtls_sha256(kdf, sizeof(kdf), s->key, 0);
+    return true;
+}
+
+// Seals len bytes of data as record number, into rec; returns its size.
+static size_t seal(const session_t *s, uint64_t number, const uint8_t *data, size_t len, uint8_t *rec) {
+    uint8_t nonce[CHACHAPOLY_NONCE_LEN] = { 0 };
+    for (int i = 0; i < 8; i++) {
+        nonce[4 + i] = (uint8_t)(number >> (8 * i));
+    }
+    rec[0] = (uint8_t)len;
+    rec[1] = (uint8_t)(len >> 8);
+    memcpy(rec + 2, data, len);
+    chachapoly_seal(s->key, nonce, rec, 2, rec + 2, len, rec + 2 + len);
+    return 2 + len + SECURE_LINK_TAG_LEN;
+}
+
+// Sends the next record of s_pcm.
+static bool send_record(session_t *s, size_t offset, size_t len, size_t chunk) {
+    uint8_t rec[SECURE_LINK_RECORD_BYTES];
+    size_t n = seal(s, s->record++, s_pcm + offset, len, rec);
+    return deliver(s, rec, n, chunk);
+}
+
+// Whatever reached the sink is s_pcm from the start, in order.
+static bool output_is_prefix(void) {
+    return s_out_len <= sizeof(s_pcm) && memcmp(s_out, s_pcm, s_out_len) == 0;
+}
+
+static void test_records(void) {
+    session_t s;
+    static const size_t chunks[] = { 1, 7, 600, 4096 };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        session_open(&s);
+        CHECK(handshake(&s, SECURE_LINK_CHACHA20_POLY1305, chunks[c]));
+        for (size_t off = 0; off < PCM_BYTES; off += 512) {
+            CHECK(send_record(&s, off, 512, chunks[c]));
+        }
+        CHECK(s_out_len == PCM_BYTES);
+        CHECK(output_is_prefix());
+        session_close(&s);
+    }
+}
+
+static void test_replay_reorder_tamper(void) {
+    session_t s;
+    uint8_t rec[SECURE_LINK_RECORD_BYTES];
+
+    // Replay: record 0 again where record 1 belongs.
+    session_open(&s);
+    CHECK(handshake(&s, SECURE_LINK_CHACHA20_POLY1305, 4096));
+    size_t n = seal(&s, 0, s_pcm, 1024, rec);
+    CHECK(deliver(&s, rec, n, 4096));
+    CHECK(!deliver(&s, rec, n, 4096));
+    CHECK(output_is_prefix());
+    session_close(&s);
+
+    // Reorder: record 1 first.
+    session_open(&s);
+    CHECK(handshake(&s, SECURE_LINK_CHACHA20_POLY1305, 4096));
+    n = seal(&s, 1, s_pcm + 1024, 1024, rec);
+    CHECK(!deliver(&s, rec, n, 4096));
+    CHECK(s_out_len == 0);
+    session_close(&s);
+
+    // Tamper with the length, the data or the tag.
+    const size_t flips[] = { 0, 2, 500, 2 + 1024 + 3 };
+    for (size_t f = 0; f < sizeof(flips) / sizeof(flips[0]); f++) {
+        session_open(&s);
+        CHECK(handshake(&s, SECURE_LINK_CHACHA20_POLY1305, 4096));
+        CHECK(send_record(&s, 0, 1024, 4096));
+        n = seal(&s, s.record, s_pcm + 1024, 1024, rec);
+        rec[flips[f]] ^= 0x04;
+        CHECK(!deliver(&s, rec, n, 4096));
+        CHECK(s_out_len == 1024);
+        CHECK(output_is_prefix());
+        session_close(&s);
+    }
+
+    // A record sealed under another key.
+    session_open(&s);
+    CHECK(handshake(&s, SECURE_LINK_CHACHA20_POLY1305, 4096));
+    s.key[0] ^= 1;
+    CHECK(!send_record(&s, 0, 1024, 4096));
+    CHECK(s_out_len == 0);
+    session_close(&s);
+}
+
+static void test_refused_sessions(void) {
+    session_t s;
+
+    // Plaintext while a key is set.
+    session_open(&s);
+    CHECK(!deliver(&s, s_pcm, 1024, 1024));
+    CHECK(s_out_len == 0);
+    session_close(&s);
+
+    // An unknown cipher.
+    session_open(&s);
+    CHECK(!handshake(&s, 7, 64));
+    session_close(&s);
+}
+
+// --- Control channel ---
+// Reads lines until one that is not telemetry or an event.
+static bool read_reply(int sock, char *line, size_t len) {
+    while (harness_read_line(sock, line, len)) {
+        if (strncmp(line, "T ", 2) != 0 && strncmp(line, "E ", 2) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void send_line(int sock, const char *line) {
+    CHECK(send(sock, line, strlen(line), 0) == (ssize_t)strlen(line));
+}
+
+static bool closed_by_peer(int sock) {
+    char line[128];
+    while (harness_read_line(sock, line, sizeof(line))) {
+    }
+    return true;
+}
+
+// Connects and reads the hello; the challenge in it, if any, goes to challenge.
+static int control_hello(bool *keyed, uint8_t challenge[SECURE_LINK_NONCE_LEN]) {
+    char line[128];
+    int sock = harness_control_connect();
+    CHECK(sock >= 0);
+    CHECK(harness_read_line(sock, line, sizeof(line)));
+    const char *c = strstr(line, "challenge=");
+    *keyed = c != NULL;
+    if (c) {
+        CHECK(strncmp(line, "E control hello auth=hmac-sha256 ", 33) == 0);
+        CHECK(strlen(c + 10) == 2 * SECURE_LINK_NONCE_LEN);
+        for (int i = 0; i < SECURE_LINK_NONCE_LEN; i++) {
+            unsigned v;
+            sscanf(c + 10 + 2 * i, "%2x", &v);
+            challenge[i] = v;
+        }
+    } else {
+        CHECK(strcmp(line, "E control hello auth=none") == 0);
+    }
+    return sock;
+}
+
+static void answer(int sock, const uint8_t *key, const uint8_t challenge[SECURE_LINK_NONCE_LEN]) {
+    uint8_t msg[sizeof(SECURE_LINK_CONTROL_LABEL) - 1 + SECURE_LINK_NONCE_LEN];
+    memcpy(msg, SECURE_LINK_CONTROL_LABEL, sizeof(SECURE_LINK_CONTROL_LABEL) - 1);
+    memcpy(msg + sizeof(SECURE_LINK_CONTROL_LABEL) - 1, challenge, SECURE_LINK_NONCE_LEN);
+    uint8_t mac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, SECURE_LINK_KEY_LEN, msg, sizeof(msg), mac);
+    char line[8 + 64 + 2] = "auth ";
+    for (int i = 0; i < 32; i++) {
+        sprintf(line + 5 + 2 * i, "%02x", mac[i]);
+    }
+    strcat(line, "\n");
+    send_line(sock, line);
+}
+
+static int s_runs;
+
+static int cmd_touch(int argc, char **argv) {
+    s_runs++;
+    console_printf("touched\n");
+    return 0;
+}
+
+static void test_control(void) {
+    char line[128];
+    uint8_t challenge[SECURE_LINK_NONCE_LEN];
+    bool keyed;
+    control_channel_start();
+
+    // A command instead of the answer: refused, not run, and dropped.
+    int sock = control_hello(&keyed, challenge);
+    CHECK(keyed);
+    send_line(sock, "touch\n");
+    CHECK(harness_read_line(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "ERR auth") == 0);
+    CHECK(closed_by_peer(sock));
+    CHECK(s_runs == 0);
+    close(sock);
+
+    // An answer under the wrong key, or to another challenge.
+    uint8_t wrong[SECURE_LINK_KEY_LEN];
+    memcpy(wrong, s_psk, sizeof(wrong));
+    wrong[31] ^= 1;
+    sock = control_hello(&keyed, challenge);
+    answer(sock, wrong, challenge);
+    CHECK(harness_read_line(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "ERR auth") == 0);
+    close(sock);
+    sock = control_hello(&keyed, challenge);
+    challenge[0] ^= 1;
+    answer(sock, s_psk, challenge);
+    CHECK(harness_read_line(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "ERR auth") == 0);
+    close(sock);
+    CHECK(s_runs == 0);
+
+    // The right answer; commands run, but the key cannot be changed remotely.
+    sock = control_hello(&keyed, challenge);
+    answer(sock, s_psk, challenge);
+    CHECK(read_reply(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "OK") == 0);
+    send_line(sock, "touch\n");
+    CHECK(read_reply(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "touched") == 0);
+    CHECK(read_reply(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "OK") == 0);
+    CHECK(s_runs == 1);
+    send_line(sock, "link off\n");
+    CHECK(read_reply(sock, line, sizeof(line)));
+    CHECK(strstr(line, "serial console") != NULL);
+    CHECK(read_reply(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "ERR -1") == 0);
+
+    // Clearing the key on the serial console drops the controller; the next
+    // one is let straight in.
+    char cmd[] = "link off";
+    CHECK(console_exec(cmd) == 0);
+    CHECK(closed_by_peer(sock));
+    close(sock);
+    sock = control_hello(&keyed, challenge);
+    CHECK(!keyed);
+    send_line(sock, "touch\n");
+    CHECK(read_reply(sock, line, sizeof(line)));
+    CHECK(strcmp(line, "touched") == 0);
+    CHECK(s_runs == 2);
+    close(sock);
+}
+
+int main(void) {
+    host_log_quiet(true);
+    for (int i = 0; i < SECURE_LINK_KEY_LEN; i++) {
+        s_psk[i] = i;
+    }
+    for (int i = 0; i < PCM_BYTES / 2; i++) {
+        ((int16_t *)s_pcm)[i] = (int16_t)(i * 37);
+    }
+    ingest_init();
+    secure_link_init();
+    console_register("touch", "Test command", cmd_touch);
+    char cmd[] = "link key " KEY_HEX;
+    CHECK(console_exec(cmd) == 0);
+
+    test_records();
+    test_replay_reorder_tamper();
+    test_refused_sessions();
+    test_control();
+    CHECK_DONE();
+}
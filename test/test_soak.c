@@ -0,0 +1,328 @@
+/*
+ * Soak test: a simulated day of streaming in a few minutes.
+ *
+ * A sender paced to its own clock, a little off the bridge's, numbers every
+ * other frame it makes, with a hash of the number in the frame after, and
+ * writes them to a modelled TCP connection that stalls now and then and is reconnected
+ * every half hour. The receiving end feeds ingest and the playback buffer
+ * as the TCP task does, blocking while the buffer is full, and the
+ * Bluetooth stack's reads happen on the bridge's clock through
+ * fake_bridge_play(). Everything runs on one thread under the manual clock.
+ *
+ * Latency is when a frame is played less when its number says it was made,
+ * so audio waiting in TCP counts as much as audio in the buffer. Each soak
+ * monitor period takes the lowest latency seen in it, which a stall and its
+ * burst do not lift but drift does, and the monitor's heap and drift checks
+ * run on the day as they would on the device.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "audio_bridge.h"
+#include "bridge_console.h"
+#include "catchup.h"
+#include "check.h"
+#include "fake_bridge.h"
+#include "host.h"
+#include "ingest.h"
+#include "overflow.h"
+#include "sdkconfig.h"
+#include "soak_monitor.h"
+
+#define SEND_FRAMES         256         // Per write by the sender
+#define PLAY_FRAMES         512         // Per a2d_data_cb call
+#define RECV_BYTES          1460        // Per recv() by the TCP task
+#define RECONNECT_GAP_S     2
+#define SETTLE_S            5           // After a connect or a stall, left out of the latency bound
+
+typedef struct {
+    const char *name;
+    double hours;
+    double skew_ppm;            // Sender's clock against the bridge's
+    const char *overflow;       // "overflow" command arguments
+    const char *catchup;        // "catchup" command arguments
+    int reconnect_min;          // 0: one session throughout
+    int stall_every_s;          // 0: no stalls
+    int stall_ms;
+} scenario_t;
+
+typedef struct {
+    double sx, sxx, sy, sxy;
+    int n;
+} fit_t;
+
+typedef struct {
+    fit_t latency;              // Floor of each sample period, ms against hours
+    fit_t heap;                 // Heap in use after each session, bytes against hours
+    double latency_max_ms;      // Settled periods only
+    double first_ms, last_ms;   // First and last period's floor
+    double fill_max_ms;         // Most the playback buffer held
+    int warnings;               // Raised by the soak monitor
+    uint64_t frames_played;
+} result_t;
+
+// --- The sender's side of the connection ---
+// Static, so growing it does not look like a leak to the heap checks.
+#define TCP_QUEUE_BYTES     (4 << 20)
+
+typedef struct {
+    uint8_t buf[TCP_QUEUE_BYTES];
+    size_t off, len;
+} fifo_t;
+
+static fifo_t s_tcp;
+
+static void fifo_put(fifo_t *q, const void *data, size_t len) {
+    if (q->off + q->len + len > sizeof(q->buf)) {
+        memmove(q->buf, q->buf + q->off, q->len);
+        q->off = 0;
+    }
+    CHECK(q->len + len <= sizeof(q->buf));
+    if (q->len + len <= sizeof(q->buf)) {
+        memcpy(q->buf + q->off + q->len, data, len);
+        q->len += len;
+    }
+}
+
+static void fifo_take(fifo_t *q, size_t len) {
+    q->off += len;
+    q->len -= len;
+}
+
+static void fit_add(fit_t *f, double x, double y) {
+    f->sx += x;
+    f->sxx += x * x;
+    f->sy += y;
+    f->sxy += x * y;
+    f->n++;
+}
+
+static double fit_slope(const fit_t *f) {
+    double denom = f->n * f->sxx - f->sx * f->sx;
+    return denom > 0 ? (f->n * f->sxy - f->sx * f->sy) / denom : 0;
+}
+
+static void network_sink(const int16_t *pcm, size_t frames, void *ctx) {
+    audio_bridge_write(AUDIO_SOURCE_NETWORK, pcm, frames * AUDIO_BYTES_PER_FRAME, portMAX_DELAY);
+}
+
+static void put_wav_header(fifo_t *q) {
+    static const uint8_t header[44] = {
+        'R', 'I', 'F', 'F', 0xff, 0xff, 0xff, 0xff, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 2, 0,
+        0x44, 0xac, 0, 0, 0x10, 0xb1, 0x02, 0, 4, 0, 16, 0,
+        'd', 'a', 't', 'a', 0xff, 0xff, 0xff, 0xff,
+    };
+    fifo_put(q, header, sizeof(header));
+}
+
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    return x ^ (x >> 16) ^ 0x5bd1e995;     // Silence is no stamp
+}
+
+static void put_frame(int16_t *frame, uint32_t v) {
+    frame[0] = (int16_t)(v & 0xffff);
+    frame[1] = (int16_t)(v >> 16);
+}
+
+static uint32_t get_frame(const int16_t *frame) {
+    return (uint16_t)frame[0] | (uint32_t)(uint16_t)frame[1] << 16;
+}
+
+// Frame number of frame f of pcm, if it carries one: time-stretched or
+// crossfaded audio does not survive the hashes. Two numbered frames are
+// checked, so that of billions of tries none passes by chance.
+static bool stamp(const int16_t *pcm, int f, uint32_t *number) {
+    *number = get_frame(pcm + 2 * f);
+    return get_frame(pcm + 2 * f + 2) == mix(*number) && get_frame(pcm + 2 * f + 4) == *number + 2 &&
+           get_frame(pcm + 2 * f + 6) == mix(*number + 2);
+}
+
+// Time since the last stall began. Stalls fall in the middle of each
+// period, so none lands on a connect: a sender held back before catch-up
+// has seen it arrive at real time is not caught up with.
+static int64_t since_stall_us(const scenario_t *sc, int64_t now_us) {
+    if (sc->stall_every_s == 0) {
+        return INT64_MAX;
+    }
+    int64_t every_us = sc->stall_every_s * 1000000LL;
+    return (now_us + every_us / 2) % every_us;
+}
+
+static void run(const scenario_t *sc, result_t *r) {
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "overflow %s", sc->overflow);
+    CHECK(console_exec(cmd) == 0);
+    snprintf(cmd, sizeof(cmd), "catchup %s", sc->catchup);
+    CHECK(console_exec(cmd) == 0);
+    memset(r, 0, sizeof(*r));
+    r->first_ms = -1;
+    // Nothing left over from the last scenario, whose clock ran on.
+    audio_bridge_flush(AUDIO_SOURCE_NETWORK);
+
+    const double send_rate = AUDIO_SAMPLE_RATE * (1 + sc->skew_ppm * 1e-6);
+    const int64_t end_us = (int64_t)(sc->hours * 3600e6);
+    const int64_t period_us = CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S * 1000000LL;
+    int64_t now_us = 0;
+    int64_t next_send_us = 0, next_play_us = 0, next_sample_us = period_us;
+    int64_t session_start_us = 0, next_connect_us = 0, session_end_us = INT64_MAX;
+    uint32_t next_frame = 0;
+    uint64_t sent_frames = 0, played_blocks = 0;
+    bool connected = false;
+    fifo_t *tcp = &s_tcp;
+    static ingest_t in;
+    int16_t chunk[SEND_FRAMES * 2];
+    int16_t block[PLAY_FRAMES * 2];
+    double period_floor = INFINITY;
+    double last_latency_ms = 0;
+
+    host_clock_manual(0);
+    while (now_us < end_us) {
+        int64_t t = next_send_us < next_play_us ? next_send_us : next_play_us;
+        t = t < next_sample_us ? t : next_sample_us;
+        t = t < next_connect_us ? t : next_connect_us;
+        t = t < session_end_us ? t : session_end_us;
+        host_clock_advance(t - now_us);
+        now_us = t;
+
+        if (now_us == session_end_us) {
+            ingest_end(&in);
+            overflow_session_end();
+            fake_bridge_set_connected(false);
+            connected = false;
+            soak_monitor_note_session_end();
+            fit_add(&r->heap, now_us / 3600e6, host_heap_used());
+            fifo_take(tcp, tcp->len);
+            session_end_us = INT64_MAX;
+            next_connect_us = now_us + RECONNECT_GAP_S * 1000000LL;
+        }
+        if (now_us == next_connect_us) {
+            ingest_begin(&in, network_sink, NULL);
+            overflow_session_begin();
+            catchup_session_begin();
+            fake_bridge_set_connected(true);
+            connected = true;
+            put_wav_header(tcp);
+            session_start_us = now_us;
+            session_end_us = sc->reconnect_min ? now_us + sc->reconnect_min * 60000000LL : INT64_MAX;
+            next_connect_us = INT64_MAX;
+        }
+        if (now_us == next_send_us) {
+            // Made whether or not anyone is connected: a live source.
+            for (int f = 0; f < SEND_FRAMES; f += 2, next_frame += 2) {
+                put_frame(chunk + 2 * f, next_frame);
+                put_frame(chunk + 2 * f + 2, mix(next_frame));
+            }
+            if (connected) {
+                fifo_put(tcp, chunk, sizeof(chunk));
+            }
+            sent_frames += SEND_FRAMES;
+            next_send_us = (int64_t)(sent_frames * 1e6 / send_rate);
+        }
+        if (now_us == next_play_us) {
+            size_t fill = audio_bridge_buffered_bytes();
+            double fill_ms = fill * 1000.0 / AUDIO_BYTES_PER_SEC;
+            r->fill_max_ms = fill_ms > r->fill_max_ms ? fill_ms : r->fill_max_ms;
+            fake_bridge_play((uint8_t *)block, sizeof(block));
+            r->frames_played += PLAY_FRAMES;
+            for (int f = 0; f < PLAY_FRAMES - 3; f++) {
+                uint32_t number;
+                if (stamp(block, f, &number)) {
+                    double made_us = number * 1e6 / send_rate;
+                    double latency_ms = (now_us + f * 1e6 / AUDIO_SAMPLE_RATE - made_us) / 1000;
+                    period_floor = latency_ms < period_floor ? latency_ms : period_floor;
+                    bool stalled_lately = since_stall_us(sc, now_us) < (sc->stall_ms + SETTLE_S * 1000) * 1000LL;
+                    if (now_us - session_start_us > SETTLE_S * 1000000LL && !stalled_lately &&
+                        latency_ms > r->latency_max_ms) {
+                        r->latency_max_ms = latency_ms;
+                    }
+                    break;
+                }
+            }
+            played_blocks++;
+            next_play_us = (int64_t)(played_blocks * PLAY_FRAMES * 1e6 / AUDIO_SAMPLE_RATE);
+        }
+        if (now_us == next_sample_us) {
+            if (period_floor < INFINITY) {
+                last_latency_ms = period_floor;
+                if (r->first_ms < 0) {
+                    r->first_ms = last_latency_ms;
+                }
+                fit_add(&r->latency, now_us / 3600e6, last_latency_ms);
+            }
+            r->last_ms = last_latency_ms;
+            period_floor = INFINITY;
+            r->warnings += soak_monitor_sample((uint32_t)last_latency_ms);
+            next_sample_us += period_us;
+        }
+
+        // The TCP task: reads while the writer is not blocked, unless the
+        // network is holding everything back.
+        bool stalled = since_stall_us(sc, now_us) < sc->stall_ms * 1000LL;
+        while (connected && !stalled && tcp->len > 0 && !fake_bridge_blocked()) {
+            size_t n = tcp->len < RECV_BYTES ? tcp->len : RECV_BYTES;
+            CHECK(ingest_feed(&in, tcp->buf + tcp->off, n));
+            fifo_take(tcp, n);
+        }
+    }
+    if (connected) {
+        ingest_end(&in);
+        overflow_session_end();
+        fake_bridge_set_connected(false);
+        soak_monitor_note_session_end();
+    }
+    fifo_take(tcp, tcp->len);
+
+    printf("%-9s %5.1f h  latency %6.1f ms -> %6.1f ms, max %6.1f ms, slope %+7.2f ms/h  fill max %5.1f ms  "
+           "heap slope %+6.1f B/h  monitor warnings %d\n", sc->name, sc->hours, r->first_ms, r->last_ms,
+           r->latency_max_ms, fit_slope(&r->latency), r->fill_max_ms, fit_slope(&r->heap), r->warnings);
+}
+
+int main(void) {
+    host_log_quiet(true);
+    overflow_init();
+    catchup_init();
+    ingest_init();
+    fake_bridge_use_catchup(true);
+    result_t r;
+    // Before any heap is measured: stdout takes its buffer on first use.
+    printf("simulated soak, sampled every %d s\n", CONFIG_BRIDGE_SOAK_SAMPLE_PERIOD_S);
+
+    // The live policy with the sender's clock fast, network stalls and a
+    // reconnect every half hour: latency stays near the bound all day and
+    // nothing leaks across 48 sessions.
+    const scenario_t live = { "live", 24, 100, "live 60", "on", 30, 7 * 60, 300 };
+    run(&live, &r);
+    CHECK(r.frames_played >= 24 * 3600.0 * AUDIO_SAMPLE_RATE - PLAY_FRAMES);
+    CHECK(r.latency_max_ms < 60 + 2 * PLAY_FRAMES * 1000.0 / AUDIO_SAMPLE_RATE);
+    CHECK_NEAR(fit_slope(&r.latency), 0, 0.5);
+    CHECK(r.heap.n >= 47);
+    CHECK_NEAR(fit_slope(&r.heap), 0, 64);
+    CHECK(r.warnings == 0);
+
+    // Lossless, the default: after each stall catch-up plays the backlog
+    // out, so latency does not build up stall by stall.
+    const scenario_t lossless = { "lossless", 24, 0, "lossless", "on", 30, 7 * 60, 300 };
+    run(&lossless, &r);
+    CHECK(r.latency_max_ms < STREAM_BUFFER_SIZE * 1000.0 / AUDIO_BYTES_PER_SEC + 50);
+    CHECK_NEAR(fit_slope(&r.latency), 0, 0.5);
+    CHECK_NEAR(fit_slope(&r.heap), 0, 64);
+    CHECK(r.warnings == 0);
+
+    // A sender whose clock runs 200 ppm fast under the lossless policy and
+    // without catch-up queues more in TCP by the minute. The buffer fill never shows more
+    // than a full buffer, but latency from the timestamps does, and so does
+    // the monitor fed with it.
+    const scenario_t drift = { "drift", 2, 200, "lossless", "off", 0, 0, 0 };
+    run(&drift, &r);
+    CHECK(r.fill_max_ms <= STREAM_BUFFER_SIZE * 1000.0 / AUDIO_BYTES_PER_SEC + 1);
+    CHECK(r.last_ms - r.first_ms > 1000);
+    CHECK_NEAR(fit_slope(&r.latency), 200e-6 * 3600e3, 100);
+    CHECK(r.warnings > 0);
+    CHECK_DONE();
+}
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Pack sounds into an image for the bridge's "assets" flash partition.
+
+Each sound is NAME=SOURCE[:CODING], where SOURCE is a WAV file (44.1 kHz,
+mono or stereo, 16/24/32-bit PCM or 32-bit float) or tone:HZ:MS for a sine
+test tone, and CODING is
+
+  adpcm  IMA ADPCM, 4 bits per sample (the default; a quarter of the flash)
+  pcm    16-bit PCM, bit exact
+
+    python asset_pack.py assets.bin startup=chime.wav beep=tone:1000:200 click=click.wav:pcm
+    parttool.py --port /dev/ttyUSB0 write_partition --partition-name assets --input assets.bin
+
+"startup" plays whenever Bluetooth audio starts; play any of them on the
+console with `asset play beep -12`.
+"""
+
+import argparse
+import math
+import struct
+import sys
+
+from ir_pack import read_wav
+
+IMAGE_MAGIC = 0x31534141        # "AAS1"
+HEADER = struct.Struct("<II")
+ENTRY = struct.Struct("<16sIIIIBBH")
+NAME_LEN = 16
+SAMPLE_RATE = 44100
+PARTITION_SIZE = 0x39000        # Size of "assets" in partitions.csv
+CODINGS = {"pcm": 0, "adpcm": 1}
+TONE_LEVEL_DB = -6
+TONE_FADE_MS = 5                # Ramps at both ends so the tone does not click
+
+STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+    4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767,
+]
+INDEX_STEP = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+class ImaEncoder:
+    """IMA ADPCM for one channel, starting from the state the device starts from."""
+
+    def __init__(self):
+        self.predictor = 0
+        self.index = 0
+
+    def decode(self, nibble):
+        # Must match ima_decode() in main/asset_mix.c step for step.
+        step = STEPS[self.index]
+        diff = step >> 3
+        if nibble & 4:
+            diff += step
+        if nibble & 2:
+            diff += step >> 1
+        if nibble & 1:
+            diff += step >> 2
+        p = self.predictor - diff if nibble & 8 else self.predictor + diff
+        self.predictor = max(-32768, min(32767, p))
+        self.index = max(0, min(88, self.index + INDEX_STEP[nibble & 7]))
+        return self.predictor
+
+    def encode(self, sample):
+        step = STEPS[self.index]
+        delta = sample - self.predictor
+        nibble = 0
+        if delta < 0:
+            nibble = 8
+            delta = -delta
+        if delta >= step:
+            nibble |= 4
+            delta -= step
+        if delta >= step >> 1:
+            nibble |= 2
+            delta -= step >> 1
+        if delta >= step >> 2:
+            nibble |= 1
+        self.decode(nibble)
+        return nibble
+
+
+def to_pcm16(samples):
+    return [max(-32768, min(32767, round(v * 32768))) for v in samples]
+
+
+def load_sound(source):
+    """Returns the sound's channels as lists of 16-bit samples."""
+    if source.startswith("tone:"):
+        try:
+            _, hz, ms = source.split(":")
+            hz, ms = float(hz), float(ms)
+        except ValueError:
+            sys.exit(f"{source}: expected tone:HZ:MS")
+        n = int(SAMPLE_RATE * ms / 1000)
+        fade = int(SAMPLE_RATE * TONE_FADE_MS / 1000)
+        level = 10 ** (TONE_LEVEL_DB / 20)
+        tone = [level * math.sin(2 * math.pi * hz * i / SAMPLE_RATE) * min(1.0, i / fade, (n - 1 - i) / fade)
+                for i in range(n)]
+        return [to_pcm16(tone)]
+    rate, chans = read_wav(source)
+    if rate != SAMPLE_RATE:
+        sys.exit(f"{source}: {rate} Hz; resample to {SAMPLE_RATE} Hz first")
+    if len(chans) > 2:
+        sys.exit(f"{source}: {len(chans)} channels; use mono or stereo")
+    return [to_pcm16(c) for c in chans]
+
+
+def encode(chans, coding):
+    """Returns the payload, laid out the way asset_voice_mix() reads it."""
+    if coding == CODINGS["pcm"]:
+        samples = [v for frame in zip(*chans) for v in frame]
+        return struct.pack(f"<{len(samples)}h", *samples)
+    encoders = [ImaEncoder() for _ in chans]
+    if len(chans) == 2:
+        # One byte per frame, left in the low nibble.
+        return bytes(encoders[0].encode(l) | encoders[1].encode(r) << 4 for l, r in zip(*chans))
+    nibbles = [encoders[0].encode(v) for v in chans[0]]
+    nibbles += [0] * (len(nibbles) & 1)
+    return bytes(nibbles[i] | nibbles[i + 1] << 4 for i in range(0, len(nibbles), 2))
+
+
+def snr_db(chans, payload):
+    """Decodes an ADPCM payload back and compares it with the input."""
+    decoders = [ImaEncoder() for _ in chans]
+    if len(chans) == 2:
+        decoded = [[decoders[0].decode(b & 15) for b in payload], [decoders[1].decode(b >> 4) for b in payload]]
+    else:
+        decoded = [[decoders[0].decode(b >> s & 15) for b in payload for s in (0, 4)][:len(chans[0])]]
+    signal = sum(v * v for c in chans for v in c)
+    noise = sum((a - b) ** 2 for c, d in zip(chans, decoded) for a, b in zip(c, d))
+    return 10 * math.log10(signal / noise) if noise and signal else math.inf
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("output", help="image file to write")
+    ap.add_argument("sounds", nargs="+", metavar="NAME=SOURCE[:pcm|adpcm]")
+    ap.add_argument("--size", type=lambda s: int(s, 0), default=PARTITION_SIZE, help="partition size")
+    args = ap.parse_args()
+
+    entries = []
+    for spec in args.sounds:
+        name, sep, source = spec.partition("=")
+        if not sep or not name or len(name.encode()) > NAME_LEN - 1 or " " in name:
+            sys.exit(f"{spec}: expected NAME=SOURCE with a name of up to {NAME_LEN - 1} characters")
+        coding = CODINGS["adpcm"]
+        base, _, suffix = source.rpartition(":")
+        if base and suffix in CODINGS:
+            source, coding = base, CODINGS[suffix]
+        chans = load_sound(source)
+        if not chans[0]:
+            sys.exit(f"{source}: no samples")
+        entries.append((name, chans, coding, encode(chans, coding)))
+
+    offset = HEADER.size + ENTRY.size * len(entries)
+    table = HEADER.pack(IMAGE_MAGIC, len(entries))
+    payload = b""
+    for name, chans, coding, data in entries:
+        payload += b"\0" * (-(offset + len(payload)) % 4)
+        frames = len(chans[0])
+        table += ENTRY.pack(name.encode(), SAMPLE_RATE, frames, offset + len(payload), len(data), coding,
+                            len(chans), 0)
+        payload += data
+        quality = "bit exact" if coding == CODINGS["pcm"] else f"SNR {snr_db(chans, data):.1f} dB"
+        print(f"{name}: {frames * 1000 / SAMPLE_RATE:.0f} ms {'stereo' if len(chans) == 2 else 'mono'}, "
+              f"{len(data)} bytes, {quality}")
+
+    image = table + payload
+    if len(image) > args.size:
+        sys.exit(f"{len(image)} bytes do not fit the {args.size}-byte partition")
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print(f"{len(image)} of {args.size} bytes written to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Stream a WAV to the bridge in real time and keep video in step with it.
+
+The bridge reports its output delay on the control port as
+
+    E delay total=<ms> buffer=<ms> pipeline=<ms> bt=<ms> sink=<ms> sink_from=avdtp|estimate
+
+counted from when it reads the audio off the socket. This sender adds the
+audio still in its own socket queue and keeps an audio clock: the position in
+the file that is coming out of the headphones right now. Run
+
+    python av_sync_sender.py 192.168.1.50 movie.wav
+
+to print the clock and the video offset it implies once a second, or start a
+muted player on the video with `mpv --no-audio --pause --input-ipc-server=/tmp/mpv movie.mkv`
+and add `--mpv /tmp/mpv` to have it follow the clock: playback starts once the
+first report is in, and the video is moved whenever it is more than
+--tolerance away from the audio.
+"""
+
+import argparse
+import hashlib
+import hmac
+import json
+import socket
+import sys
+import threading
+import time
+import wave
+
+AUDIO_PORT = 8080
+CONTROL_PORT = 8081
+CONTROL_LABEL = b"ASL1 control"
+SAMPLE_RATE = 44100
+FRAME_BYTES = 4
+CHUNK_FRAMES = 1024
+SEND_BUFFER = 16 * 1024     # Keeps the unmeasurable part of our own queue small
+
+
+def read_line(sock):
+    """One line from the control channel, a byte at a time so nothing after it is taken."""
+    line = b""
+    while not line.endswith(b"\n"):
+        got = sock.recv(1)
+        if not got:
+            sys.exit("control channel closed")
+        line += got
+    return line.decode(errors="replace").strip()
+
+
+def open_control(host, key=None):
+    """Connects to the control port and, if the bridge has a link key set,
+    answers its challenge with HMAC-SHA256 under the key."""
+    sock = socket.create_connection((host, CONTROL_PORT))
+    hello = read_line(sock)
+    if "auth=hmac-sha256" in hello:
+        if key is None:
+            sys.exit("the bridge has a link key set; pass it with --key")
+        challenge = bytes.fromhex(hello.rsplit("challenge=", 1)[1])
+        proof = hmac.new(key, CONTROL_LABEL + challenge, hashlib.sha256).hexdigest()
+        sock.sendall(f"auth {proof}\n".encode())
+        if read_line(sock) != "OK":
+            sys.exit("the bridge refused the key")
+    return sock
+
+
+class DelayReports:
+    """Follows "E delay" lines on the control channel."""
+
+    def __init__(self, host, key=None):
+        self.total_ms = None
+        self.fields = {}
+        self.sock = open_control(host, key)
+        threading.Thread(target=self._run, daemon=True).start()
+
+    def _run(self):
+        buf = b""
+        while True:
+            data = self.sock.recv(1024)
+            if not data:
+                print("control channel closed", file=sys.stderr)
+                return
+            buf += data
+            while b"\n" in buf:
+                line, buf = buf.split(b"\n", 1)
+                self._line(line.decode(errors="replace").strip())
+
+    def _line(self, line):
+        if not line.startswith("E delay "):
+            return
+        fields = dict(kv.split("=", 1) for kv in line[len("E delay "):].split() if "=" in kv)
+        if "total" in fields:
+            self.fields = fields
+            self.total_ms = float(fields["total"])
+
+
+def unsent_bytes(sock):
+    """Bytes still queued in our socket, where the OS can tell."""
+    try:
+        import fcntl
+        import termios
+        return int.from_bytes(fcntl.ioctl(sock, termios.TIOCOUTQ, b"\0\0\0\0"), sys.byteorder)
+    except (ImportError, AttributeError, OSError):
+        return 0
+
+
+class Mpv:
+    """Just enough of mpv's JSON IPC to read and move the video position."""
+
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.file = self.sock.makefile("rb")
+        self.request_id = 0
+
+    def command(self, *args):
+        self.request_id += 1
+        self.sock.sendall(json.dumps({"command": list(args), "request_id": self.request_id}).encode() + b"\n")
+        while True:
+            reply = json.loads(self.file.readline())
+            if reply.get("request_id") == self.request_id:
+                return reply.get("data")
+
+    def follow(self, clock_s, tolerance_s):
+        if self.command("get_property", "pause"):
+            self.command("set_property", "time-pos", max(clock_s, 0))
+            self.command("set_property", "pause", False)
+            return True
+        pos = self.command("get_property", "time-pos")
+        if pos is not None and abs(pos - clock_s) > tolerance_s:
+            self.command("set_property", "time-pos", max(clock_s, 0))
+            return True
+        return False
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host", help="bridge IP address")
+    ap.add_argument("wav", help="16-bit stereo 44.1 kHz WAV to stream")
+    ap.add_argument("--lead", type=float, default=60, help="ms of audio to send ahead of real time (default 60)")
+    ap.add_argument("--mpv", metavar="SOCKET", help="mpv IPC socket of a muted player showing the video")
+    ap.add_argument("--tolerance", type=float, default=40, help="ms the video may drift before it is moved (default 40)")
+    ap.add_argument("--key", help="link key set on the bridge, 64 hex digits, to authenticate the control channel")
+    args = ap.parse_args()
+
+    with wave.open(args.wav, "rb") as w:
+        if (w.getsampwidth(), w.getnchannels(), w.getframerate()) != (2, 2, SAMPLE_RATE):
+            sys.exit(f"{args.wav}: expected 16-bit stereo at {SAMPLE_RATE} Hz")
+        pcm = w.readframes(w.getnframes())
+
+    reports = DelayReports(args.host, bytes.fromhex(args.key) if args.key else None)
+    mpv = Mpv(args.mpv) if args.mpv else None
+    audio = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    audio.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, SEND_BUFFER)
+    audio.connect((args.host, AUDIO_PORT))
+
+    chunk = CHUNK_FRAMES * FRAME_BYTES
+    bytes_per_s = SAMPLE_RATE * FRAME_BYTES
+    sent = 0
+    moves = 0
+    start = time.monotonic()
+    next_status = start
+    try:
+        while sent < len(pcm):
+            now = time.monotonic()
+            due = ((now - start) + args.lead / 1000) * bytes_per_s
+            if sent < due:
+                sent += audio.send(pcm[sent:sent + chunk])
+            else:
+                time.sleep(CHUNK_FRAMES / SAMPLE_RATE / 4)
+
+            if reports.total_ms is None or now < next_status:
+                continue
+            # The bridge has read everything we sent but what is still queued
+            # here; that plays total ms after it was read.
+            queued_ms = unsent_bytes(audio) * 1000 / bytes_per_s
+            clock_s = (sent / bytes_per_s) - (queued_ms + reports.total_ms) / 1000
+            if mpv and mpv.follow(clock_s, args.tolerance / 1000):
+                moves += 1
+            f = reports.fields
+            print(f"audio clock {clock_s:8.3f} s  video offset +{queued_ms + reports.total_ms:.0f} ms "
+                  f"(queue {queued_ms:.0f}, buffer {f.get('buffer')}, pipeline {f.get('pipeline')}, "
+                  f"bt {f.get('bt')}, sink {f.get('sink')} {f.get('sink_from')})"
+                  + (f", video moved {moves}x" if mpv else ""))
+            next_status = now + 1
+    except KeyboardInterrupt:
+        pass
+    audio.close()
+
+
+if __name__ == "__main__":
+    main()
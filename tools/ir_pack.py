@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Pack impulse responses into an image for the bridge's "ir" flash partition.
+
+Each response is NAME=FILE.wav (44.1 kHz, 16/24/32-bit PCM or 32-bit float):
+
+  mono WAV         one response for both channels
+  stereo WAV       left channel filters left, right filters right
+  NAME=A.wav,B.wav a 2x2 matrix for binaural virtualization: A holds the left
+                   speaker's responses at the left and right ear, B the right
+                   speaker's
+
+    python ir_pack.py irs.bin hd650=hd650_eq.wav room=left_spk.wav,right_spk.wav
+    parttool.py --port /dev/ttyUSB0 write_partition --partition-name ir --input irs.bin
+
+then load one on the console with `ir load hd650`.
+"""
+
+import argparse
+import array
+import cmath
+import math
+import struct
+import sys
+
+IMAGE_MAGIC = 0x31425249        # "IRB1"
+HEADER = struct.Struct("<II")
+ENTRY = struct.Struct("<16sIIII")
+NAME_LEN = 16
+SAMPLE_RATE = 44100
+PARTITION_SIZE = 0x40000        # Size of "ir" in partitions.csv
+HEADROOM_DB = 12                # Filter gain the device handles before saturating
+
+
+def read_wav(path):
+    """Returns (rate, channels as lists of floats in [-1, 1))."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"RIFF" or data[8:12] != b"WAVE":
+        sys.exit(f"{path}: not a WAV file")
+    fmt = None
+    pos = 12
+    while pos + 8 <= len(data):
+        cid, size = data[pos:pos + 4], struct.unpack_from("<I", data, pos + 4)[0]
+        body = data[pos + 8:pos + 8 + size]
+        if cid == b"fmt ":
+            tag, channels, rate = struct.unpack_from("<HHI", body)
+            bits = struct.unpack_from("<H", body, 14)[0]
+            if tag == 0xFFFE:
+                tag = struct.unpack_from("<H", body, 24)[0]
+            fmt = (tag, channels, rate, bits)
+        elif cid == b"data":
+            break
+        pos += 8 + size + (size & 1)
+    else:
+        sys.exit(f"{path}: no data chunk")
+    if fmt is None:
+        sys.exit(f"{path}: no fmt chunk")
+
+    tag, channels, rate, bits = fmt
+    if tag == 3 and bits == 32:
+        samples = array.array("f", body[:len(body) // 4 * 4])
+    elif tag == 1 and bits in (16, 24, 32):
+        width = bits // 8
+        scale = 1.0 / (1 << (bits - 1))
+        samples = [int.from_bytes(body[i:i + width], "little", signed=True) * scale
+                   for i in range(0, len(body) // width * width, width)]
+    else:
+        sys.exit(f"{path}: unsupported sample format (tag {tag}, {bits} bits)")
+    if sys.byteorder != "little" and isinstance(samples, array.array):
+        samples.byteswap()
+    return rate, [list(samples[c::channels]) for c in range(channels)]
+
+
+def fft(x):
+    n = len(x)
+    if n == 1:
+        return x
+    even, odd = fft(x[0::2]), fft(x[1::2])
+    tw = [cmath.exp(-2j * math.pi * k / n) * odd[k] for k in range(n // 2)]
+    return [even[k] + tw[k] for k in range(n // 2)] + [even[k] - tw[k] for k in range(n // 2)]
+
+
+def peak_gain_db(paths):
+    """Largest magnitude of the frequency response seen by one output."""
+    n = 1 << (len(paths[0]) - 1).bit_length()
+    spectra = [fft([complex(v) for v in p] + [0j] * (n - len(p))) for p in paths]
+    if len(spectra) == 4:
+        # Both inputs feed each output; in phase is the worst case.
+        mags = [abs(a) + abs(b) for out in ((0, 2), (1, 3)) for a, b in zip(spectra[out[0]], spectra[out[1]])]
+    else:
+        mags = [abs(v) for s in spectra for v in s]
+    peak = max(mags)
+    return 20 * math.log10(peak) if peak > 0 else -math.inf
+
+
+def load_response(spec, max_taps, gain):
+    """Returns the response's paths as lists of floats."""
+    files = spec.split(",")
+    paths = []
+    for path in files:
+        rate, chans = read_wav(path)
+        if rate != SAMPLE_RATE:
+            sys.exit(f"{path}: {rate} Hz; resample to {SAMPLE_RATE} Hz first")
+        if len(files) == 2 and len(chans) != 2:
+            sys.exit(f"{path}: a matrix needs stereo files (left ear, right ear)")
+        if len(chans) > 2:
+            sys.exit(f"{path}: {len(chans)} channels; use mono or stereo")
+        paths += chans
+    if len(files) > 2:
+        sys.exit(f"{spec}: at most two files per response")
+
+    taps = max(len(p) for p in paths)
+    if max_taps:
+        taps = min(taps, max_taps)
+    return [[v * gain for v in p[:taps]] + [0.0] * (taps - len(p[:taps])) for p in paths]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("output", help="image file to write")
+    ap.add_argument("responses", nargs="+", metavar="NAME=WAV[,WAV]")
+    ap.add_argument("--max-taps", type=int, default=0, help="truncate longer responses")
+    ap.add_argument("--gain", type=float, default=0.0, help="gain in dB applied to every response")
+    ap.add_argument("--size", type=lambda s: int(s, 0), default=PARTITION_SIZE, help="partition size")
+    args = ap.parse_args()
+
+    gain = 10 ** (args.gain / 20)
+    entries = []
+    for spec in args.responses:
+        name, sep, files = spec.partition("=")
+        if not sep or not name or len(name.encode()) > NAME_LEN - 1 or " " in name:
+            sys.exit(f"{spec}: expected NAME=FILE with a name of up to {NAME_LEN - 1} characters")
+        entries.append((name, load_response(files, args.max_taps, gain)))
+
+    offset = HEADER.size + ENTRY.size * len(entries)
+    table = HEADER.pack(IMAGE_MAGIC, len(entries))
+    payload = b""
+    for name, paths in entries:
+        taps = len(paths[0])
+        table += ENTRY.pack(name.encode(), SAMPLE_RATE, taps, len(paths), offset + len(payload))
+        for p in paths:
+            payload += struct.pack(f"<{taps}f", *p)
+        peak = peak_gain_db(paths)
+        print(f"{name}: {taps} taps ({taps * 1000 / SAMPLE_RATE:.1f} ms), {len(paths)} path(s), "
+              f"peak gain {peak:+.1f} dB")
+        if peak > HEADROOM_DB:
+            print(f"  warning: more than {HEADROOM_DB} dB of gain saturates on the device; "
+                  f"lower it with --gain")
+
+    image = table + payload
+    if len(image) > args.size:
+        sys.exit(f"{len(image)} bytes do not fit the {args.size}-byte partition")
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print(f"{len(image)} of {args.size} bytes written to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
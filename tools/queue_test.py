@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Serve files to the bridge's play queue and measure the gaps between them.
+
+Starts a small HTTP server for the files (with range requests, for seeking),
+optionally slowed down to look like a poor network, queues them on the
+bridge over the control port and follows its reports:
+
+    E queue start id=<n> head_ms=<ms> ahead=<bytes> uri=<uri>
+    E queue gap id=<n> ms=<silence at the output> handoff_ms=<ms>
+    E queue seek id=<n> to_ms=<ms> landed_ms=<ms> exact=0|1 ms=<command to new audio queued>
+    E queue seek id=<n> to_ms=<ms> failed=unsupported|past-end|no-range|ended
+    E queue end id=<n> reason=eof|skipped|connect|network|format|memory played_ms=<ms>
+    E queue empty
+
+Run
+
+    python queue_test.py 192.168.1.50 a.ogg b.wav c.aac --rate-kbps 400 --ttfb-ms 800
+
+to play the three in turn with each response delayed by 800 ms and sent at
+no more than 400 kbit/s, then print the gap at every transition. Without
+prefetch each transition would cost at least the TTFB. Add
+
+    --seek 2:30 --seek 5:1.5
+
+to move each item, 2 s after it starts, to 30 s in, and 5 s after it starts
+back to 1.5 s, then print how long the seeks took to reach the output and
+how far from the target they landed.
+"""
+
+import argparse
+import hashlib
+import hmac
+import http.server
+import os
+import re
+import socket
+import sys
+import threading
+import time
+import urllib.parse
+
+CONTROL_PORT = 8081
+CONTROL_LABEL = b"ASL1 control"
+CHUNK = 1024
+
+
+def read_line(sock):
+    """One line from the control channel, a byte at a time so nothing after it is taken."""
+    line = b""
+    while not line.endswith(b"\n"):
+        got = sock.recv(1)
+        if not got:
+            sys.exit("control channel closed")
+        line += got
+    return line.decode(errors="replace").strip()
+
+
+def open_control(host, key=None):
+    """Connects to the control port and, if the bridge has a link key set,
+    answers its challenge with HMAC-SHA256 under the key."""
+    sock = socket.create_connection((host, CONTROL_PORT))
+    hello = read_line(sock)
+    if "auth=hmac-sha256" in hello:
+        if key is None:
+            sys.exit("the bridge has a link key set; pass it with --key")
+        challenge = bytes.fromhex(hello.rsplit("challenge=", 1)[1])
+        proof = hmac.new(key, CONTROL_LABEL + challenge, hashlib.sha256).hexdigest()
+        sock.sendall(f"auth {proof}\n".encode())
+        if read_line(sock) != "OK":
+            sys.exit("the bridge refused the key")
+    return sock
+
+
+def make_server(files, port, rate_kbps=0, ttfb_ms=0):
+    """Returns an HTTP server for files (by base name), not yet serving."""
+    by_name = {os.path.basename(f): f for f in files}
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_GET(self):
+            path = by_name.get(urllib.parse.unquote(self.path.lstrip("/")))
+            if path is None:
+                self.send_error(404)
+                return
+            with open(path, "rb") as f:
+                data = f.read()
+            first = 0
+            wanted = self.headers.get("Range")
+            if wanted:
+                m = re.fullmatch(r"bytes=(\d+)-", wanted.strip())
+                if not m or int(m.group(1)) >= len(data):
+                    self.send_error(416)
+                    return
+                first = int(m.group(1))
+            time.sleep(ttfb_ms / 1000)
+            self.send_response(206 if wanted else 200)
+            self.send_header("Content-Type", "application/octet-stream")
+            if wanted:
+                self.send_header("Content-Range", f"bytes {first}-{len(data) - 1}/{len(data)}")
+            data = data[first:]
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            start = time.monotonic()
+            for pos in range(0, len(data), CHUNK):
+                if rate_kbps:
+                    ahead = pos * 8 / (rate_kbps * 1000) - (time.monotonic() - start)
+                    if ahead > 0:
+                        time.sleep(ahead)
+                try:
+                    self.wfile.write(data[pos:pos + CHUNK])
+                except (BrokenPipeError, ConnectionResetError):
+                    return     # Skipped or cleared on the bridge
+
+        def log_message(self, fmt, *args):
+            pass
+
+    return http.server.ThreadingHTTPServer(("", port), Handler)
+
+
+def fields(line):
+    return dict(kv.split("=", 1) for kv in line.split()[2:] if "=" in kv)
+
+
+def seek_spec(text):
+    at, sep, to = text.partition(":")
+    if not sep:
+        raise argparse.ArgumentTypeError("expected AT:TO in seconds")
+    return float(at), float(to)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host", help="bridge address")
+    ap.add_argument("files", nargs="+", help="files to queue, in order")
+    ap.add_argument("--port", type=int, default=8090, help="HTTP port to serve on")
+    ap.add_argument("--rate-kbps", type=float, default=0, help="cap each response's rate (0: no cap)")
+    ap.add_argument("--ttfb-ms", type=float, default=0, help="delay before each response")
+    ap.add_argument("--seek", type=seek_spec, action="append", default=[], metavar="AT:TO",
+                    help="AT seconds into each item, seek it to TO seconds (repeatable)")
+    ap.add_argument("--key", help="link key set on the bridge, 64 hex digits, to authenticate the control channel")
+    args = ap.parse_args()
+
+    server = make_server(args.files, args.port, args.rate_kbps, args.ttfb_ms)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    ctl = open_control(args.host, bytes.fromhex(args.key) if args.key else None)
+    local_ip = ctl.getsockname()[0]
+    for f in args.files:
+        uri = f"http://{local_ip}:{args.port}/{urllib.parse.quote(os.path.basename(f))}"
+        ctl.sendall(f"queue add {uri}\n".encode())
+
+    gaps = []
+    seeks = []
+    buf = b""
+    while True:
+        data = ctl.recv(1024)
+        if not data:
+            sys.exit("control channel closed")
+        buf += data
+        while b"\n" in buf:
+            raw, buf = buf.split(b"\n", 1)
+            line = raw.decode(errors="replace").strip()
+            if line.startswith("ERR"):
+                print(f"bridge refused a command: {line}", file=sys.stderr)
+            if not line.startswith("E queue "):
+                continue
+            print(line)
+            if line.startswith("E queue start "):
+                for at, to in args.seek:
+                    threading.Timer(at, ctl.sendall, [f"queue seek {to}\n".encode()]).start()
+            elif line.startswith("E queue seek ") and "failed=" not in line:
+                f = fields(line)
+                seeks.append((float(f["ms"]), abs(float(f["landed_ms"]) - float(f["to_ms"]))))
+            elif line.startswith("E queue gap "):
+                f = fields(line)
+                gaps.append((float(f["ms"]), float(f["handoff_ms"])))
+            elif line == "E queue empty":
+                if gaps:
+                    silence = [g for g, _ in gaps]
+                    handoff = [h for _, h in gaps]
+                    print(f"{len(gaps)} transitions: gap mean {sum(silence) / len(gaps):.1f} ms, "
+                          f"max {max(silence):.1f} ms; handoff mean {sum(handoff) / len(gaps):.1f} ms, "
+                          f"max {max(handoff):.1f} ms")
+                if seeks:
+                    took = [t for t, _ in seeks]
+                    off = [o for _, o in seeks]
+                    print(f"{len(seeks)} seeks: new audio queued after {sum(took) / len(seeks):.1f} ms on average, "
+                          f"max {max(took):.1f} ms; landed {sum(off) / len(seeks):.1f} ms from the target on "
+                          f"average, max {max(off):.1f} ms")
+                return
+
+
+if __name__ == "__main__":
+    main()
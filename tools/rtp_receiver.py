@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Receive the reverse bridge's RTP stream, measure jitter and loss, and play or record it.
+
+In reverse mode, start forwarding on the ESP32 console with `rtp <this PC's IP> [port]`, then run
+
+    python rtp_receiver.py --wav phone.wav
+    python rtp_receiver.py --stdout | aplay -f cd
+    python rtp_receiver.py --stdout | ffplay -nodisp -f s16le -ar 48000 -ac 2 -
+
+(the rate is whatever the phone chose; the first report shows it). Once a
+second it prints packets received, lost, late and duplicated, the
+interarrival jitter as RFC 3550 defines it and the spread of transit times,
+which is what a jitter buffer has to absorb. Lost packets and frames the
+device dropped are written as silence, so the output keeps time.
+"""
+
+import argparse
+import array
+import socket
+import sys
+import time
+import wave
+
+DEFAULT_PORT = 5004
+HEADER_BYTES = 12
+FRAME_BYTES = 4
+RATES = {10: 44100, 96: 48000, 97: 32000, 98: 16000}
+MAX_GAP_S = 1.0         # Longer gaps restart the output instead of being filled
+
+
+class Stats:
+    """Loss and jitter of one RTP source, per RFC 3550 section 6.4 and A.8."""
+
+    def __init__(self, ssrc, seq, rate):
+        self.ssrc = ssrc
+        self.rate = rate
+        self.base_seq = seq
+        self.max_seq = seq          # Extended with wraps
+        self.received = 0
+        self.late = 0
+        self.duplicates = 0
+        self.starts = 0
+        self.jitter = 0.0           # Timestamp units
+        self.transit = None
+        self.seen = set()
+        self.period()
+
+    def period(self):
+        self.period_received = 0
+        self.period_expected_base = self.max_seq
+        self.period_received_base = self.received
+        self.transit_min = None
+        self.transit_max = None
+
+    def update(self, seq, ts, arrival, marker):
+        # Extend the 16-bit sequence number to the one closest to the highest so far.
+        ext = (self.max_seq & ~0xFFFF) | seq
+        if ext < self.max_seq - 0x8000:
+            ext += 0x10000
+        elif ext > self.max_seq + 0x8000:
+            ext -= 0x10000
+        if ext in self.seen:
+            self.duplicates += 1
+            return False
+        self.seen.add(ext)
+        if len(self.seen) > 4096:
+            self.seen = {s for s in self.seen if s > self.max_seq - 2048}
+        if ext > self.max_seq:
+            self.max_seq = ext
+        elif ext != self.base_seq:
+            self.late += 1
+        self.received += 1
+        self.starts += marker
+
+        transit = arrival * self.rate - ts
+        if self.transit is not None and not marker:
+            d = abs(transit - self.transit)
+            self.jitter += (d - self.jitter) / 16
+        self.transit = transit
+        if self.transit_min is None or transit < self.transit_min:
+            self.transit_min = transit
+        if self.transit_max is None or transit > self.transit_max:
+            self.transit_max = transit
+        return True
+
+    def report(self, written_s):
+        expected = self.max_seq - self.base_seq + 1
+        lost = expected - self.received
+        period_expected = self.max_seq - self.period_expected_base
+        period_received = self.received - self.period_received_base
+        period_lost = max(period_expected - period_received, 0)
+        spread = (self.transit_max - self.transit_min) / self.rate * 1000 if self.transit_min is not None else 0
+        print(f"{self.rate} Hz  packets {self.received}  lost {lost} ({100 * lost / max(expected, 1):.2f}%, "
+              f"{period_lost} this second)  late {self.late}  dup {self.duplicates}  "
+              f"jitter {self.jitter / self.rate * 1000:.2f} ms  transit spread {spread:.1f} ms  "
+              f"starts {self.starts}  audio {written_s:.1f} s", file=sys.stderr)
+        self.period()
+
+
+class Output:
+    """Writes PCM in timestamp order, filling holes with silence."""
+
+    def __init__(self, wav_path, stdout):
+        self.wav_path = wav_path
+        self.wav = None
+        self.stdout = sys.stdout.buffer if stdout else None
+        self.next_ts = None
+        self.frames = 0
+        self.late = 0
+
+    def write(self, ts, rate, marker, payload):
+        if self.wav_path and self.wav is None:
+            self.wav = wave.open(self.wav_path, "wb")
+            self.wav.setnchannels(2)
+            self.wav.setsampwidth(2)
+            self.wav.setframerate(rate)
+        pcm = array.array("h", payload)
+        if sys.byteorder == "little":
+            pcm.byteswap()      # L16 is big endian
+        gap = (ts - self.next_ts) & 0xFFFFFFFF if self.next_ts is not None else None
+        if gap is not None and gap >= 0x80000000:
+            self.late += 1      # Behind what was already written
+            return
+        if gap is not None and 0 < gap <= MAX_GAP_S * rate:
+            self._emit(bytes(gap * FRAME_BYTES))
+        self._emit(pcm.tobytes())
+        self.next_ts = (ts + len(payload) // FRAME_BYTES) & 0xFFFFFFFF
+
+    def _emit(self, data):
+        self.frames += len(data) // FRAME_BYTES
+        if self.wav:
+            self.wav.writeframes(data)
+        if self.stdout:
+            self.stdout.write(data)
+            self.stdout.flush()
+
+    def close(self):
+        if self.wav:
+            self.wav.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--port", type=int, default=DEFAULT_PORT)
+    ap.add_argument("--wav", metavar="FILE", help="record the stream to a WAV file")
+    ap.add_argument("--stdout", action="store_true", help="write 16-bit little-endian stereo PCM to stdout")
+    ap.add_argument("--seconds", type=float, default=0, help="stop after this long (default: Ctrl+C)")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("", args.port))
+    sock.settimeout(0.2)
+    out = Output(args.wav, args.stdout)
+    stats = None
+    deadline = time.monotonic() + args.seconds if args.seconds else None
+    next_report = time.monotonic() + 1
+    print(f"Listening on UDP {args.port}; Ctrl+C to stop", file=sys.stderr)
+    try:
+        while deadline is None or time.monotonic() < deadline:
+            try:
+                data, _ = sock.recvfrom(2048)
+                arrival = time.monotonic()
+            except socket.timeout:
+                data = None
+            if data and len(data) > HEADER_BYTES and data[0] >> 6 == 2:
+                marker = data[1] >> 7
+                pt = data[1] & 0x7F
+                seq = int.from_bytes(data[2:4], "big")
+                ts = int.from_bytes(data[4:8], "big")
+                ssrc = int.from_bytes(data[8:12], "big")
+                rate = RATES.get(pt)
+                if rate is not None:
+                    if stats is None or stats.ssrc != ssrc or stats.rate != rate:
+                        if stats is not None:
+                            print("new stream", file=sys.stderr)
+                        stats = Stats(ssrc, seq, rate)
+                        out.next_ts = None
+                    if stats.update(seq, ts, arrival, marker):
+                        out.write(ts, rate, marker, data[HEADER_BYTES:])
+            now = time.monotonic()
+            if now >= next_report:
+                if stats:
+                    stats.report(out.frames / stats.rate)
+                next_report = now + 1
+    except KeyboardInterrupt:
+        pass
+    if stats:
+        stats.report(out.frames / stats.rate)
+    out.close()
+
+
+if __name__ == "__main__":
+    main()
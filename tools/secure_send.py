@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Stream audio to the bridge over the secure link.
+
+Once a key is set on the bridge's serial console,
+
+    link key <64 hex digits>
+
+port 8080 only takes sealed streams. This sender opens with the hello,
+derives the session key from the bridge's reply and sends the file in
+records of up to 1024 bytes sealed with ChaCha20-Poly1305 (built in) or
+AES-256-GCM (needs the `cryptography` package). Any format ingest
+understands works; the bridge paces the stream by reading it. Run
+
+    python secure_send.py 192.168.1.50 song.ogg --key 00112233...
+
+or `--new-key` to print a fresh key and its fingerprint, which `link` on
+the bridge shows too. `--corrupt N` flips a bit in record N to check that
+the bridge refuses it; refusals are printed as the bridge reports them,
+on a control connection authenticated with the same key:
+
+    E link reject cipher=<name> reason=auth|length|plaintext|no-key|cipher|hello record=<n>
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+AUDIO_PORT = 8080
+CONTROL_PORT = 8081
+MAGIC = b"ASL1"
+LABEL = b"ASL1 session key"
+CONTROL_LABEL = b"ASL1 control"
+CIPHERS = {"chacha20-poly1305": 1, "aes-256-gcm": 2}
+MAX_RECORD = 1024
+
+
+# --- ChaCha20-Poly1305 (RFC 8439) ---
+def _chacha_block(key_words, counter, nonce_words):
+    state = [0x61707865, 0x3320646E, 0x79622D32, 0x6B206574, *key_words, counter, *nonce_words]
+    x = list(state)
+    for _ in range(10):
+        for a, b, c, d in ((0, 4, 8, 12), (1, 5, 9, 13), (2, 6, 10, 14), (3, 7, 11, 15),
+                           (0, 5, 10, 15), (1, 6, 11, 12), (2, 7, 8, 13), (3, 4, 9, 14)):
+            x[a] = (x[a] + x[b]) & 0xFFFFFFFF; x[d] ^= x[a]; x[d] = (x[d] << 16 | x[d] >> 16) & 0xFFFFFFFF
+            x[c] = (x[c] + x[d]) & 0xFFFFFFFF; x[b] ^= x[c]; x[b] = (x[b] << 12 | x[b] >> 20) & 0xFFFFFFFF
+            x[a] = (x[a] + x[b]) & 0xFFFFFFFF; x[d] ^= x[a]; x[d] = (x[d] << 8 | x[d] >> 24) & 0xFFFFFFFF
+            x[c] = (x[c] + x[d]) & 0xFFFFFFFF; x[b] ^= x[c]; x[b] = (x[b] << 7 | x[b] >> 25) & 0xFFFFFFFF
+    return struct.pack("<16I", *((x[i] + state[i]) & 0xFFFFFFFF for i in range(16)))
+
+
+def _poly1305(key, msg):
+    r = int.from_bytes(key[:16], "little") & 0x0FFFFFFC0FFFFFFC0FFFFFFC0FFFFFFF
+    s = int.from_bytes(key[16:], "little")
+    p = (1 << 130) - 5
+    acc = 0
+    for i in range(0, len(msg), 16):
+        acc = (acc + int.from_bytes(msg[i:i + 16] + b"\x01", "little")) * r % p
+    return ((acc + s) & ((1 << 128) - 1)).to_bytes(16, "little")
+
+
+def _pad16(data):
+    return b"\0" * (-len(data) % 16)
+
+
+class ChaChaPoly:
+    def __init__(self, key):
+        self.key_words = struct.unpack("<8I", key)
+
+    def encrypt(self, nonce, data, aad):
+        nonce_words = struct.unpack("<3I", nonce)
+        stream = b"".join(_chacha_block(self.key_words, 1 + i, nonce_words) for i in range((len(data) + 63) // 64))
+        ct = (int.from_bytes(data, "little") ^ int.from_bytes(stream[:len(data)], "little")).to_bytes(len(data), "little")
+        otk = _chacha_block(self.key_words, 0, nonce_words)[:32]
+        mac = aad + _pad16(aad) + ct + _pad16(ct) + struct.pack("<QQ", len(aad), len(ct))
+        return ct + _poly1305(otk, mac)
+
+
+def make_cipher(name, key):
+    if name == "chacha20-poly1305":
+        try:
+            from cryptography.hazmat.primitives.ciphers.aead import ChaCha20Poly1305
+            return ChaCha20Poly1305(key)
+        except ImportError:
+            return ChaChaPoly(key)
+    try:
+        from cryptography.hazmat.primitives.ciphers.aead import AESGCM
+    except ImportError:
+        sys.exit("aes-256-gcm needs the cryptography package (pip install cryptography)")
+    return AESGCM(key)
+
+
+def fingerprint(key):
+    return hashlib.sha256(key).hexdigest()[:8]
+
+
+def session_key(psk, client_nonce, bridge_nonce, cipher_id):
+    return hashlib.sha256(psk + LABEL + client_nonce + bridge_nonce + bytes([cipher_id])).digest()
+
+
+def seal(cipher, number, chunk):
+    header = struct.pack("<H", len(chunk))
+    return header + cipher.encrypt(b"\0\0\0\0" + struct.pack("<Q", number), chunk, header)
+
+
+def read_line(sock):
+    """One line from the control channel, a byte at a time so nothing after it is taken."""
+    line = b""
+    while not line.endswith(b"\n"):
+        got = sock.recv(1)
+        if not got:
+            sys.exit("control channel closed")
+        line += got
+    return line.decode(errors="replace").strip()
+
+
+def open_control(host, key):
+    """Connects to the control port and answers its challenge with
+    HMAC-SHA256 under the key."""
+    sock = socket.create_connection((host, CONTROL_PORT), timeout=5)
+    hello = read_line(sock)
+    if "auth=hmac-sha256" in hello:
+        challenge = bytes.fromhex(hello.rsplit("challenge=", 1)[1])
+        proof = hmac.new(key, CONTROL_LABEL + challenge, hashlib.sha256).hexdigest()
+        sock.sendall(f"auth {proof}\n".encode())
+        if read_line(sock) != "OK":
+            sys.exit("the bridge refused the key on the control channel")
+    sock.settimeout(None)
+    return sock
+
+
+def follow_rejects(host, key):
+    """Prints the bridge's refusals from the control channel."""
+    try:
+        ctl = open_control(host, key)
+    except OSError:
+        return
+    buf = b""
+    while True:
+        data = ctl.recv(1024)
+        if not data:
+            return
+        buf += data
+        while b"\n" in buf:
+            line, buf = buf.split(b"\n", 1)
+            line = line.decode(errors="replace").strip()
+            if line.startswith(("E link reject", "E ingest reject")):
+                print(line, file=sys.stderr)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host", nargs="?", help="bridge IP address")
+    ap.add_argument("file", nargs="?", help="audio file to stream (WAV, raw PCM, SBC, Ogg Vorbis, AAC)")
+    ap.add_argument("--key", help="pre-shared key, 64 hex digits")
+    ap.add_argument("--cipher", choices=CIPHERS, default="chacha20-poly1305")
+    ap.add_argument("--new-key", action="store_true", help="print a random key and its fingerprint, then exit")
+    ap.add_argument("--corrupt", type=int, metavar="N", help="flip a bit in record N")
+    args = ap.parse_args()
+
+    if args.new_key:
+        key = os.urandom(32)
+        print(f"link key {key.hex()}\nfingerprint {fingerprint(key)}")
+        return
+    if not (args.host and args.file and args.key):
+        ap.error("host, file and --key are needed")
+    psk = bytes.fromhex(args.key)
+    if len(psk) != 32:
+        ap.error("--key must be 64 hex digits")
+    with open(args.file, "rb") as f:
+        data = f.read()
+
+    threading.Thread(target=follow_rejects, args=(args.host, psk), daemon=True).start()
+    time.sleep(0.2)     # Let the control connection come up first
+    audio = socket.create_connection((args.host, AUDIO_PORT))
+    cipher_id = CIPHERS[args.cipher]
+    client_nonce = os.urandom(16)
+    audio.sendall(MAGIC + bytes([cipher_id]) + b"\0" * 11 + client_nonce)
+    bridge_nonce = b""
+    while len(bridge_nonce) < 16:
+        got = audio.recv(16 - len(bridge_nonce))
+        if not got:
+            time.sleep(0.5)     # For the reason to arrive
+            sys.exit("bridge closed the connection during the hello")
+        bridge_nonce += got
+    cipher = make_cipher(args.cipher, session_key(psk, client_nonce, bridge_nonce, cipher_id))
+    print(f"{args.cipher} session, key fingerprint {fingerprint(psk)}")
+
+    start = time.monotonic()
+    number = 0
+    try:
+        for pos in range(0, len(data), MAX_RECORD):
+            record = bytearray(seal(cipher, number, data[pos:pos + MAX_RECORD]))
+            if number == args.corrupt:
+                record[2] ^= 1
+            audio.sendall(record)
+            number += 1
+    except (BrokenPipeError, ConnectionResetError):
+        time.sleep(0.5)
+        sys.exit(f"bridge closed the connection at record {number}")
+    except KeyboardInterrupt:
+        pass
+    audio.close()
+    took = time.monotonic() - start
+    print(f"{number} records, {len(data)} bytes in {took:.1f} s ({len(data) * 8 / took / 1000:.0f} kbit/s)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""Capture the bridge's output tap and optionally diff it against the source.
+
+Enable the tap on the ESP32 console with `tap <this PC's IP> [port]`, then run
+
+    python tap_capture.py capture.wav --seconds 30 --diff song.wav
+
+Datagrams carry the byte offset of their payload in the stream returned by
+a2d_data_cb, so blocks the device dropped under pressure and datagrams lost on
+Wi-Fi are both written as silence and reported, keeping the WAV time-aligned.
+
+Datagrams also carry a sequence number. The diff compares each run of
+consecutive datagrams on its own and leaves out the holes between runs. After
+a hole it finds the source position again, so an underrun inside a hole does
+not turn everything after it into mismatches.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+import wave
+
+TAP_MAGIC = 0x31504154
+HEADER = struct.Struct("<IIQ")
+SAMPLE_RATE = 44100
+FRAME_BYTES = 4
+ALIGN_WINDOW = 1024     # Bytes of non-silent capture used to locate it in the source
+
+
+def capture(port, seconds):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("", port))
+    sock.settimeout(0.5)
+
+    chunks = {}
+    seqs = {}
+    first_offset = None
+    packets = 0
+    deadline = time.monotonic() + seconds if seconds else None
+    print(f"Listening on UDP {port}; Ctrl+C to stop")
+    try:
+        while deadline is None or time.monotonic() < deadline:
+            try:
+                data, _ = sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+            if len(data) < HEADER.size:
+                continue
+            magic, seq, offset = HEADER.unpack_from(data)
+            if magic != TAP_MAGIC:
+                continue
+            if first_offset is None:
+                first_offset = offset
+            if offset >= first_offset:
+                chunks[offset - first_offset] = data[HEADER.size:]
+                seqs[offset - first_offset] = seq
+                packets += 1
+    except KeyboardInterrupt:
+        pass
+
+    if not chunks:
+        return b"", packets, 0, []
+    end = max(off + len(payload) for off, payload in chunks.items())
+    pcm = bytearray(end)
+    covered = 0
+    runs = []
+    prev_seq = prev_end = None
+    for off in sorted(chunks):
+        payload = chunks[off]
+        pcm[off:off + len(payload)] = payload
+        covered += len(payload)
+        # A datagram lost on Wi-Fi skips a sequence number; a block dropped on
+        # the device skips offsets.
+        if runs and seqs[off] == (prev_seq + 1) & 0xFFFFFFFF and off == prev_end:
+            runs[-1][1] = off + len(payload)
+        else:
+            runs.append([off, off + len(payload)])
+        prev_seq, prev_end = seqs[off], off + len(payload)
+    return bytes(pcm), packets, end - covered, runs
+
+
+def write_wav(path, pcm):
+    with wave.open(path, "wb") as w:
+        w.setnchannels(2)
+        w.setsampwidth(2)
+        w.setframerate(SAMPLE_RATE)
+        w.writeframes(pcm)
+
+
+def read_pcm(path):
+    with wave.open(path, "rb") as w:
+        if w.getsampwidth() != 2 or w.getnchannels() != 2:
+            sys.exit(f"{path}: only 16-bit stereo sources can be diffed")
+        return w.readframes(w.getnframes())
+
+
+def locate(captured, source, start, end):
+    """Finds captured[start:end] in the source by exact match.
+
+    Returns (source byte, capture byte) of the first window that matched, or
+    None. Silent windows are skipped, since they match anywhere."""
+    tries = 0
+    while start + ALIGN_WINDOW <= end and tries < 64:
+        window = captured[start:start + ALIGN_WINDOW]
+        if any(window):
+            # The first non-silent bytes may be a WAV header the sender streamed raw.
+            tries += 1
+            pos = source.find(window)
+            while pos >= 0 and pos % 2:
+                pos = source.find(window, pos + 1)
+            if pos >= 0:
+                return pos, start
+        start += ALIGN_WINDOW
+    return None
+
+
+def diff(captured, source, runs):
+    """Locates each run of the capture in the source, then compares sample by sample."""
+    cap_all = memoryview(captured).cast("h")
+    src_all = memoryview(source).cast("h")
+    shift = None            # Source byte less capture byte, from the last run aligned
+    compared = 0
+    mismatched = 0
+    max_err = 0
+    err_energy = 0
+    sig_energy = 0
+    unaligned = 0
+    realigned = 0
+    for start, end in runs:
+        start -= start % FRAME_BYTES
+        end = min(end - end % FRAME_BYTES, len(captured))
+        if end <= start:
+            continue
+        # Most holes are Wi-Fi losses that leave the alignment as it was.
+        check = min(end - start, ALIGN_WINDOW)
+        if shift is not None and 0 <= start + shift and start + shift + check <= len(source) and \
+                captured[start:start + check] == source[start + shift:start + shift + check]:
+            first = start
+        else:
+            found = locate(captured, source, start, end)
+            if found is None:
+                unaligned += (end - start) // FRAME_BYTES
+                continue
+            pos, first = found
+            if shift is not None and pos - first != shift:
+                realigned += 1
+            if shift is None:
+                print(f"aligned at source byte {pos} (capture byte {first})")
+            shift = pos - first
+
+        n = min(end, len(source) - shift) - first
+        if n <= 0:
+            continue
+        cap = cap_all[first // 2:(first + n) // 2]
+        src = src_all[(first + shift) // 2:(first + shift + n) // 2]
+        for i in range(len(cap)):
+            e = cap[i] - src[i]
+            if e:
+                mismatched += 1
+                max_err = max(max_err, abs(e))
+                err_energy += e * e
+            sig_energy += src[i] * src[i]
+        compared += len(cap)
+
+    if compared == 0:
+        print("diff: no bit-exact match for the capture in the source; "
+              "the pipeline changed the samples or the wrong file was given")
+        return 1
+
+    print(f"compared {compared // 2} frames in {len(runs)} runs, re-aligned {realigned} times after a hole, "
+          f"{unaligned} frames not found in the source")
+    print(f"mismatched samples: {mismatched}, max abs error: {max_err}")
+    if err_energy:
+        import math
+        print(f"SNR: {10 * math.log10(max(sig_energy, 1) / err_energy):.1f} dB")
+    else:
+        print("bit-exact")
+    return 0 if mismatched == 0 else 2
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("output", help="WAV file to write")
+    ap.add_argument("--port", type=int, default=9100)
+    ap.add_argument("--seconds", type=float, default=0, help="stop after this long (default: Ctrl+C)")
+    ap.add_argument("--diff", metavar="SOURCE", help="source WAV that was streamed to the bridge")
+    args = ap.parse_args()
+
+    pcm, packets, missing, runs = capture(args.port, args.seconds)
+    pcm = pcm[:len(pcm) - len(pcm) % FRAME_BYTES]
+    write_wav(args.output, pcm)
+    print(f"{packets} packets, {len(pcm) // FRAME_BYTES / SAMPLE_RATE:.2f} s written to {args.output}, "
+          f"{missing // FRAME_BYTES} frames missing (dropped on device or lost on Wi-Fi)")
+    if args.diff:
+        sys.exit(diff(pcm, read_pcm(args.diff), runs))
+
+
+if __name__ == "__main__":
+    main()